@@ -96,54 +96,35 @@ bool user_defined_homing() {
 
 #ifdef USE_KINEMATICS
 /*
-  Inverse Kinematics converts X,Y,Z cartesian coordinate to the steps
-  on your "joint" motors.  It requires the following three functions:
+  Kinematics converts X,Y,Z cartesian coordinates to the positions of your
+  "joint" motors.  Moves are planned in cartesian space and the stepper
+  converts each short step segment with inverse().  Positions are reported
+  with forward().  See Kinematics.h for all of the methods.
 */
-
-/*
-  inverse_kinematics() looks at incoming move commands and modifies
-  them before Grbl_ESP32 puts them in the motion planner.
-
-  Grbl_ESP32 processes arcs by converting them into tiny little line segments.
-  Kinematics in Grbl_ESP32 works the same way. Search for this function across
-  Grbl_ESP32 for examples. You are basically converting cartesian X,Y,Z... targets to
-
-    target = an N_AXIS array of target positions (where the move is supposed to go)
-    pl_data = planner data (see the definition of this type to see what it is)
-    position = an N_AXIS array of where the machine is starting from for this move
-*/
-void inverse_kinematics(float* target, plan_line_data_t* pl_data, float* position) {
-    // this simply moves to the target. Replace with your kinematics.
-    mc_line(target, pl_data);
-}
-
-/*
-  kinematics_pre_homing() is called before normal homing
-  You can use it to do special homing or just to set stuff up
-
-  cycle_mask is a bit mask of the axes being homed this time.
-*/
-bool kinematics_pre_homing(uint8_t cycle_mask))
-{
-    return false;  // finish normal homing cycle
-}
-
-/*
-  kinematics_post_homing() is called at the end of normal homing
-*/
-void kinematics_post_homing() {}
-#endif
-
-#ifdef USE_FWD_KINEMATICS
-/*
-  The status command uses forward_kinematics() to convert
-  your motor positions to cartesian X,Y,Z... coordinates.
-
-  Convert the N_AXIS array of motor positions to cartesian in your code.
-*/
-void forward_kinematics(float* position) {
-    // position[X_AXIS] =
-    // position[Y_AXIS] =
+class MyKinematics : public Kinematics {
+public:
+    // Convert the cartesian position to joint positions. Return false if it
+    // cannot be reached.
+    bool inverse(const float* cartesian, float* joints) override {
+        memcpy(joints, cartesian, sizeof(float) * N_AXIS);  // Replace with your kinematics.
+        return true;
+    }
+
+    // Convert the joint positions back to cartesian.
+    void forward(const float* joints, float* cartesian) override { memcpy(cartesian, joints, sizeof(float) * N_AXIS); }
+
+    // pre_homing() is called before normal homing. Return true to skip it.
+    bool pre_homing(uint8_t cycle_mask) override {
+        return false;  // finish normal homing cycle
+    }
+
+    const char* name() override { return "My Kinematics"; }
+};
+
+static MyKinematics my_kinematics;
+
+Kinematics* machine_kinematics() {
+    return &my_kinematics;
 }
 #endif
 
@@ -11,15 +11,15 @@
 
   On a delta machine, Grbl axis units are in radians
   The kinematics converts the cartesian moves in gcode into
-  the radians to move the arms. The Grbl motion planner never sees
-  the actual cartesian values.
+  the radians to move the arms. The planner works on the cartesian
+  moves and the stepper prep converts each step segment to arm angles.
 
-  To make the moves straight and smooth on a delta, the cartesian moves
-  are broken into small segments where the non linearity will not be noticed.
-  This is similar to how Grgl draws arcs.
+  To make the moves straight and smooth on a delta, the stepper
+  segments are kept short enough that the non linearity will not be
+  noticed: at most SEGMENT_LENGTH, and shorter where the arms bend the
+  path by more than $Kinematics/Tolerance.
 
-  If you request MPos status it will tell you the position in
-  arm angles. The MPos will report in cartesian values using forward kinematics. 
+  MPos and WPos are reported in cartesian values using forward kinematics.
 
   The arm 0 values (angle) are the arms at horizontal.
   Positive angles are below horizontal.
@@ -27,9 +27,7 @@
   Delta_z_offset is the offset to the end effector joints at arm angle zero.
   The is calculated at startup and used in the forward kinematics
 
-  Feedrate in gcode is in the cartesian uints. This must be converted to the
-  angles. This is done by calculating the segment move distance and the angle 
-  move distance and applying that ration to the feedrate. 
+  Feedrate in gcode is in the cartesian uints and is planned as such.
 
   TODO Cleanup
   Update so extra axes get delt with ... passed through properly
@@ -71,14 +69,43 @@ const float re = RADIUS_EFF;         // radius of end effector side (length of l
 const float f  = LENGTH_FIXED_SIDE;  // sized of fixed side triangel
 const float e  = LENGTH_EFF_SIDE;    // size of end effector side triangle
 
-static float last_angle[N_AXIS] = { 0.0, 0.0, 0.0 };  // A place to save the previous motor angles for distance/feed rate calcs
-float        delta_z_offset;                          // Z offset of the effector from the arm centers
+float delta_z_offset;  // Z offset of the effector from the arm centers
 
 // prototypes for helper functions
-int            calc_forward_kinematics(float* angles, float* cartesian);
-KinematicError delta_calcInverse(float* cartesian, float* angles);
-KinematicError delta_calcAngleYZ(float x0, float y0, float z0, float& theta);
-float          three_axis_dist(float* point1, float* point2);
+int            calc_forward_kinematics(const float* angles, float* cartesian);
+KinematicError delta_calcInverse(const float* cartesian, float* angles);
+
+class ParallelDelta : public Kinematics {
+public:
+    bool inverse(const float* cartesian, float* joints) override {
+        memcpy(joints, cartesian, sizeof(float) * N_AXIS);  // Axes after Z pass through
+        return delta_calcInverse(cartesian, joints) == KinematicError::NONE;
+    }
+
+    void forward(const float* joints, float* cartesian) override {
+        memcpy(cartesian, joints, sizeof(float) * N_AXIS);
+        if (calc_forward_kinematics(joints, cartesian) != 0) {
+            grbl_msg_deferf(CLIENT_SERIAL, MsgLevel::Info, "Fwd Kin Error");  // Also called by the segment prep
+        }
+    }
+
+    bool reachable(const float* cartesian) override {
+        float angles[N_AXIS];
+        return delta_calcInverse(cartesian, angles) == KinematicError::NONE;
+    }
+
+    float segment_length() override { return SEGMENT_LENGTH; }
+
+    bool pre_homing(uint8_t cycle_mask) override { return true; }
+
+    const char* name() override { return "Parallel Delta"; }
+};
+
+static ParallelDelta delta;
+
+Kinematics* machine_kinematics() {
+    return &delta;
+}
 
 void machine_init() {
     // Calculate the Z offset at the motor zero angles ...
@@ -96,131 +123,64 @@ bool user_defined_homing() {  // true = do not continue with normal Grbl homing
     return true;
 }
 
-void inverse_kinematics(float* target, plan_line_data_t* pl_data, float* position)  //The target and position are provided in MPos
-{
-    float dx, dy, dz;  // distances in each cartesian axis
-    float motor_angles[N_AXIS];
-
-    float seg_target[N_AXIS];                         // The target of the current segment
-    float feed_rate            = pl_data->feed_rate;  // save original feed rate
-    bool  start_position_erorr = false;
-    bool  show_error           = true;  // shows error once
-
-    // see if start is in work area...if not skip segments and try to go to target
-    KinematicError status = delta_calcInverse(position, motor_angles);
-
-    if (status == KinematicError::OUT_OF_RANGE) {
-        grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Start position error");
-        start_position_erorr = true;
-    }
-
-    // Check the destination to see if it is in work area
-    status = delta_calcInverse(target, motor_angles);
-
-    if (status == KinematicError::OUT_OF_RANGE) {
-        grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Target unreachable");
-        return;
-    }
-
-    position[X_AXIS] += gc_state.coord_offset[X_AXIS];
-    position[Y_AXIS] += gc_state.coord_offset[Y_AXIS];
-    position[Z_AXIS] += gc_state.coord_offset[Z_AXIS];
-
-    // calculate cartesian move distance for each axis
-
-    dx         = target[X_AXIS] - position[X_AXIS];
-    dy         = target[Y_AXIS] - position[Y_AXIS];
-    dz         = target[Z_AXIS] - position[Z_AXIS];
-    float dist = sqrt((dx * dx) + (dy * dy) + (dz * dz));
-
-    // determine the number of segments we need	... round up so there is at least 1 (except when dist is 0)
-    uint32_t segment_count = ceil(dist / SEGMENT_LENGTH);
-
-    float segment_dist = dist / ((float)segment_count);  // distance of each segment...will be used for feedrate conversion
-
-    for (uint32_t segment = 1; segment <= segment_count; segment++) {
-        // determine this segment's target
-        seg_target[X_AXIS] = position[X_AXIS] + (dx / float(segment_count) * segment);
-        seg_target[Y_AXIS] = position[Y_AXIS] + (dy / float(segment_count) * segment);
-        seg_target[Z_AXIS] = position[Z_AXIS] + (dz / float(segment_count) * segment);
-
-        // calculate the delta motor angles
-        KinematicError status = delta_calcInverse(seg_target, motor_angles);
-
-        if (status == KinematicError ::NONE) {
-            float delta_distance = three_axis_dist(motor_angles, last_angle);
-
-            // save angles for next distance calc
-            memcpy(last_angle, motor_angles, sizeof(motor_angles));
-
-            if (pl_data->motion.rapidMotion) {
-                pl_data->feed_rate = feed_rate;
-            } else {
-                pl_data->feed_rate = (feed_rate * delta_distance / segment_dist);
-            }
-
-            mc_line(motor_angles, pl_data);
-
-        } else {
-            if (show_error) {
-                grbl_msg_sendf(CLIENT_SERIAL,
-                               MsgLevel::Info,
-                               "Error:%d, Angs X:%4.3f Y:%4.3f Z:%4.3f]\r\n\r\n",
-                               status,
-                               motor_angles[0],
-                               motor_angles[1],
-                               motor_angles[2]);
-                show_error = false;
-            }
-        }
-    }
+// Geometry terms of the inverse kinematics, folded into constants at compile time. The kernel below
+// runs once per stepper segment, so it is float only (sqrtf/atanf, f-suffixed literals) and computes
+// all three arms without early exits.
+const float arm_y    = -0.5f * tan30 * f;                                  // Y of the crank axis in an arm's YZ plane
+const float eff_y    = 0.5f * tan30 * e;                                   // Effector center to the end of its linkages
+const float rf_sq    = rf * rf;                                            // Crank circle
+const float arm_k    = rf * rf - re * re - arm_y * arm_y + eff_y * eff_y;  // Constant part of the circle intersection
+const float pi_float = M_PI;                                               // Keeps the angle math in single precision
+const float fwd_t    = (f - e) * tan30 * 0.5f;                             // Forward kinematics offset of the crank ends
+
+// Angle of one arm from the effector center (y0, z0) in the arm's YZ plane. r2_k is x^2+y^2+z^2+arm_k,
+// the same for all arms because the rotation into each arm's plane keeps the distance. Returns the
+// discriminant, negative when the linkage cannot reach the crank circle.
+static inline float delta_arm_angle(float y0, float r2_k, float inv_z0, float& theta) {
+    float a  = (0.5f * r2_k - eff_y * y0) * inv_z0;  // z = a + b*y
+    float b  = (arm_y - y0 + eff_y) * inv_z0;
+    float b1 = b * b + 1.0f;
+    float ab = a + b * arm_y;
+    float d  = rf_sq * b1 - ab * ab;
+    float yj = (arm_y - a * b - sqrtf(fmaxf(d, 0.0f))) / b1;  // choosing outer point
+    float zj = a + b * yj;
+    theta    = atanf(-zj / (arm_y - yj)) + ((yj > arm_y) ? pi_float : 0.0f);
+    return d;
 }
 
 // inverse kinematics: cartesian -> angles
-// returned status: 0=OK, -1=non-existing position
-KinematicError delta_calcInverse(float* cartesian, float* angles) {
-    angles[0] = angles[1] = angles[2] = 0;
-    KinematicError status             = KinematicError::NONE;
-
-    status = delta_calcAngleYZ(cartesian[X_AXIS], cartesian[Y_AXIS], cartesian[Z_AXIS], angles[0]);
-    if (status != KinematicError ::NONE) {
-        return status;
-    }
-
-    status = delta_calcAngleYZ(cartesian[X_AXIS] * cos120 + cartesian[Y_AXIS] * sin120,
-                               cartesian[Y_AXIS] * cos120 - cartesian[X_AXIS] * sin120,
-                               cartesian[Z_AXIS],
-                               angles[1]);  // rotate coords to +120 deg
-    if (status != KinematicError ::NONE) {
-        return status;
+KinematicError delta_calcInverse(const float* cartesian, float* angles) {
+    float x      = cartesian[X_AXIS];
+    float y      = cartesian[Y_AXIS];
+    float z      = cartesian[Z_AXIS];
+    float r2_k   = x * x + y * y + z * z + arm_k;
+    float inv_z0 = 1.0f / z;
+
+    float d0 = delta_arm_angle(y, r2_k, inv_z0, angles[0]);
+    float d1 = delta_arm_angle(y * cos120 - x * sin120, r2_k, inv_z0, angles[1]);  // rotate coords to +120 deg
+    float d2 = delta_arm_angle(y * cos120 + x * sin120, r2_k, inv_z0, angles[2]);  // rotate coords to -120 deg
+
+    if (fminf(d0, fminf(d1, d2)) < 0.0f) {
+        return KinematicError::OUT_OF_RANGE;  // non-existing point
     }
-
-    status = delta_calcAngleYZ(cartesian[X_AXIS] * cos120 - cartesian[Y_AXIS] * sin120,
-                               cartesian[Y_AXIS] * cos120 + cartesian[X_AXIS] * sin120,
-                               cartesian[Z_AXIS],
-                               angles[2]);  // rotate coords to -120 deg
-    if (status != KinematicError ::NONE) {
-        return status;
+    if (fminf(angles[0], fminf(angles[1], angles[2])) < MAX_NEGATIVE_ANGLE) {
+        return KinematicError::ANGLE_TOO_NEGATIVE;
     }
-
-    //grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "xyx (%4.3f,%4.3f,%4.3f) ang (%4.3f,%4.3f,%4.3f)", x0, y0, z0, theta1, theta2, theta3);
-    return status;
+    return KinematicError::NONE;
 }
 
 // inverse kinematics: angles -> cartesian
-int calc_forward_kinematics(float* angles, float* catesian) {
-    float t = (f - e) * tan30 / 2;
-
-    float y1 = -(t + rf * cos(angles[0]));
-    float z1 = -rf * sin(angles[0]);
+int calc_forward_kinematics(const float* angles, float* catesian) {
+    float y1 = -(fwd_t + rf * cosf(angles[0]));
+    float z1 = -rf * sinf(angles[0]);
 
-    float y2 = (t + rf * cos(angles[1])) * sin30;
+    float y2 = (fwd_t + rf * cosf(angles[1])) * sin30;
     float x2 = y2 * tan60;
-    float z2 = -rf * sin(angles[1]);
+    float z2 = -rf * sinf(angles[1]);
 
-    float y3 = (t + rf * cos(angles[2])) * sin30;
+    float y3 = (fwd_t + rf * cosf(angles[2])) * sin30;
     float x3 = -y3 * tan60;
-    float z3 = -rf * sin(angles[2]);
+    float z3 = -rf * sinf(angles[2]);
 
     float dnm = (y2 - y1) * x3 - (y3 - y1) * x2;
 
@@ -230,11 +190,11 @@ int calc_forward_kinematics(float* angles, float* catesian) {
 
     // x = (a1*z + b1)/dnm
     float a1 = (z2 - z1) * (y3 - y1) - (z3 - z1) * (y2 - y1);
-    float b1 = -((w2 - w1) * (y3 - y1) - (w3 - w1) * (y2 - y1)) / 2.0;
+    float b1 = -((w2 - w1) * (y3 - y1) - (w3 - w1) * (y2 - y1)) * 0.5f;
 
     // y = (a2*z + b2)/dnm;
     float a2 = -(z2 - z1) * x3 + (z3 - z1) * x2;
-    float b2 = ((w2 - w1) * x3 - (w3 - w1) * x2) / 2.0;
+    float b2 = ((w2 - w1) * x3 - (w3 - w1) * x2) * 0.5f;
 
     // a*z^2 + b*z + c = 0
     float a = a1 * a1 + a2 * a2 + dnm * dnm;
@@ -246,67 +206,10 @@ int calc_forward_kinematics(float* angles, float* catesian) {
     if (d < 0)
         return -1;  // non-existing point
 
-    catesian[Z_AXIS] = -(float)0.5 * (b + sqrt(d)) / a;
+    catesian[Z_AXIS] = -0.5f * (b + sqrtf(d)) / a;
     catesian[X_AXIS] = (a1 * catesian[Z_AXIS] + b1) / dnm;
     catesian[Y_AXIS] = (a2 * catesian[Z_AXIS] + b2) / dnm;
     return 0;
 }
-// helper functions, calculates angle theta1 (for YZ-pane)
-KinematicError delta_calcAngleYZ(float x0, float y0, float z0, float& theta) {
-    float y1 = -0.5 * 0.57735 * f;  // f/2 * tg 30
-    y0 -= 0.5 * 0.57735 * e;        // shift center to edge
-    // z = a + b*y
-    float a = (x0 * x0 + y0 * y0 + z0 * z0 + rf * rf - re * re - y1 * y1) / (2 * z0);
-    float b = (y1 - y0) / z0;
-    // discriminant
-    float d = -(a + b * y1) * (a + b * y1) + rf * (b * b * rf + rf);
-    if (d < 0)
-        return KinematicError::OUT_OF_RANGE;          // non-existing point
-    float yj = (y1 - a * b - sqrt(d)) / (b * b + 1);  // choosing outer point
-    float zj = a + b * yj;
-    //theta    = 180.0 * atan(-zj / (y1 - yj)) / M_PI + ((yj > y1) ? 180.0 : 0.0);
-    theta = atan(-zj / (y1 - yj)) + ((yj > y1) ? M_PI : 0.0);
-
-    if (theta < MAX_NEGATIVE_ANGLE) {
-        return KinematicError::ANGLE_TOO_NEGATIVE;
-    }
-
-    return KinematicError::NONE;
-}
-
-// Determine the unit distance between (2) 3D points
-float three_axis_dist(float* point1, float* point2) {
-    return sqrt(((point1[0] - point2[0]) * (point1[0] - point2[0])) + ((point1[1] - point2[1]) * (point1[1] - point2[1])) +
-                ((point1[2] - point2[2]) * (point1[2] - point2[2])));
-}
-// called by reporting for WPos status
-void forward_kinematics(float* position) {
-    float calc_fwd[N_AXIS];
-    int   status;
-
-    // convert the system position in steps to radians
-    float   position_radians[N_AXIS];
-    int32_t position_steps[N_AXIS];  // Copy current state of the system position variable
-    memcpy(position_steps, sys_position, sizeof(sys_position));
-    system_convert_array_steps_to_mpos(position_radians, position_steps);
-
-    // detmine the position of the end effector joint center.
-    status = calc_forward_kinematics(position_radians, calc_fwd);
-
-    if (status == 0) {
-        // apply offsets and set the returned values
-        position[X_AXIS] = calc_fwd[X_AXIS] - gc_state.coord_system[X_AXIS] + gc_state.coord_offset[X_AXIS];
-        position[Y_AXIS] = calc_fwd[Y_AXIS] - gc_state.coord_system[Y_AXIS] + gc_state.coord_offset[Y_AXIS];
-        position[Z_AXIS] = calc_fwd[Z_AXIS] - gc_state.coord_system[Z_AXIS] + gc_state.coord_offset[Z_AXIS];
-    } else {
-        grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "MSG:Fwd Kin Error");
-    }
-}
-
-bool kinematics_pre_homing(uint8_t cycle_mask) {
-    return true;
-}
-
-void kinematics_post_homing() {}
 
 void user_m30() {}
@@ -22,8 +22,7 @@
 	in 3D space. Grbl will still work as 3 axes of steps, but these steps could
 	represent angles, etc instead of linear units.
 
-	Unless forward kinematics are applied to the reporting, Grbl will report raw joint
-	values instead of the normal Cartesian positions
+	Positions are reported in Cartesian space using the forward kinematics.
 
 	How it works...
 
@@ -32,16 +31,15 @@
 	Y represents the polar degrees and Z would be unchanged.
 
 	In most cases, a straight line in Cartesian space could cause a curve in the new system.
-	To fix this, the line is broken into very small segments and each segment is converted
-	to the new space. While each segment is also distorted, the amount is so small it cannot be seen.
-
-	This segmentation is how normal Grbl draws arcs.
+	To fix this, the stepper prep converts every short step segment (at most SEGMENT_LENGTH, and
+	shorter near the center where the deviation would exceed $Kinematics/Tolerance) to the new space. While each segment is also distorted, the amount is so small it cannot be seen.
 
 	Feed Rate
 
-	Feed rate is given in steps/time. Due to the new coordinate units and non linearity issues, the
-	feed rate may need to be adjusted. The ratio of the step distances in the original coordinate system
-	determined and applied to the feed rate.
+	The planner works in Cartesian space, so the feed rate is the Cartesian feed rate.
+
+	The polar center is at machine X0 Y0. Work coordinate offsets are applied before the
+	kinematics like on any other machine.
 
 	TODO:
 		Add y offset, for completeness
@@ -54,123 +52,34 @@
 // in Machines/polar_coaster.h, thus causing this file to be included
 // from ../custom_code.cpp
 
-void  calc_polar(float* target_xyz, float* polar, float last_angle);
+void  calc_polar(const float* target_xyz, float* polar, float last_angle);
 float abs_angle(float ang);
 
-static float last_angle  = 0;
-static float last_radius = 0;
-
-// this get called before homing
-// return false to complete normal home
-// return true to exit normal homing
-bool kinematics_pre_homing(uint8_t cycle_mask) {
-    return false;  // finish normal homing cycle
-}
-
-void kinematics_post_homing() {
-    // sync the X axis (do not need sync but make it for the fail safe)
-    last_radius = sys_position[X_AXIS];
-    // reset the internal angle value
-    last_angle = 0;
-}
-
-/*
- Apply inverse kinematics for a polar system
-
- float target: 					The desired target location in machine space
- plan_line_data_t *pl_data:		Plan information like feed rate, etc
- float *position:				The previous "from" location of the move
-
- Note: It is assumed only the radius axis (X) is homed and only X and Z have offsets
-
-
-*/
-void inverse_kinematics(float* target, plan_line_data_t* pl_data, float* position) {
-    //static float last_angle = 0;
-    //static float last_radius = 0;
-    float    dx, dy, dz;          // distances in each cartesian axis
-    float    p_dx, p_dy, p_dz;    // distances in each polar axis
-    float    dist, polar_dist;    // the distances in both systems...used to determine feed rate
-    uint32_t segment_count;       // number of segments the move will be broken in to.
-    float    seg_target[N_AXIS];  // The target of the current segment
-    float    polar[N_AXIS];       // target location in polar coordinates
-    float    x_offset = gc_state.coord_system[X_AXIS] + gc_state.coord_offset[X_AXIS];  // offset from machine coordinate system
-    float    z_offset = gc_state.coord_system[Z_AXIS] + gc_state.coord_offset[Z_AXIS];  // offset from machine coordinate system
-    //grbl_sendf(CLIENT_SERIAL, "Position: %4.2f %4.2f %4.2f \r\n", position[X_AXIS] - x_offset, position[Y_AXIS], position[Z_AXIS]);
-    //grbl_sendf(CLIENT_SERIAL, "Target: %4.2f %4.2f %4.2f \r\n", target[X_AXIS] - x_offset, target[Y_AXIS], target[Z_AXIS]);
-    // calculate cartesian move distance for each axis
-    dx = target[X_AXIS] - position[X_AXIS];
-    dy = target[Y_AXIS] - position[Y_AXIS];
-    dz = target[Z_AXIS] - position[Z_AXIS];
-    // calculate the total X,Y axis move distance
-    // Z axis is the same in both coord systems, so it is ignored
-    dist = sqrt((dx * dx) + (dy * dy) + (dz * dz));
-    if (pl_data->motion.rapidMotion) {
-        segment_count = 1;  // rapid G0 motion is not used to draw, so skip the segmentation
-    } else {
-        segment_count = ceil(dist / SEGMENT_LENGTH);  // determine the number of segments we need	... round up so there is at least 1
+class PolarCoaster : public Kinematics {
+public:
+    // The previous angle picks the turn closest to it, so the angle can run past 360 degrees.
+    bool inverse(const float* cartesian, float* joints) override {
+        float last_angle = joints[POLAR_AXIS];
+        memcpy(joints, cartesian, sizeof(float) * N_AXIS);
+        calc_polar(cartesian, joints, last_angle);
+        return true;
     }
-    dist /= segment_count;  // segment distance
-    for (uint32_t segment = 1; segment <= segment_count; segment++) {
-        // determine this segment's target
-        seg_target[X_AXIS] = position[X_AXIS] + (dx / float(segment_count) * segment) - x_offset;
-        seg_target[Y_AXIS] = position[Y_AXIS] + (dy / float(segment_count) * segment);
-        seg_target[Z_AXIS] = position[Z_AXIS] + (dz / float(segment_count) * segment) - z_offset;
-        calc_polar(seg_target, polar, last_angle);
-        // begin determining new feed rate
-        // calculate move distance for each axis
-        p_dx                      = polar[RADIUS_AXIS] - last_radius;
-        p_dy                      = polar[POLAR_AXIS] - last_angle;
-        p_dz                      = dz;
-        polar_dist                = sqrt((p_dx * p_dx) + (p_dy * p_dy) + (p_dz * p_dz));  // calculate the total move distance
-        float polar_rate_multiply = 1.0;                                                  // fail safe rate
-        if (polar_dist == 0 || dist == 0) {
-            // prevent 0 feed rate and division by 0
-            polar_rate_multiply = 1.0;  // default to same feed rate
-        } else {
-            // calc a feed rate multiplier
-            polar_rate_multiply = polar_dist / dist;
-            if (polar_rate_multiply < 0.5) {
-                // prevent much slower speed
-                polar_rate_multiply = 0.5;
-            }
-        }
-        pl_data->feed_rate *= polar_rate_multiply;  // apply the distance ratio between coord systems
-        // end determining new feed rate
-        polar[RADIUS_AXIS] += x_offset;
-        polar[Z_AXIS] += z_offset;
-        last_radius = polar[RADIUS_AXIS];
-        last_angle  = polar[POLAR_AXIS];
-        mc_line(polar, pl_data);
+
+    void forward(const float* joints, float* cartesian) override {
+        memcpy(cartesian, joints, sizeof(float) * N_AXIS);
+        cartesian[X_AXIS] = cos(radians(joints[POLAR_AXIS])) * joints[RADIUS_AXIS];
+        cartesian[Y_AXIS] = sin(radians(joints[POLAR_AXIS])) * joints[RADIUS_AXIS];
     }
-    // TO DO don't need a feedrate for rapids
-}
 
-/*
-Forward kinematics converts position back to the original cartesian system. It is
-typically used for reporting
+    float segment_length() override { return SEGMENT_LENGTH; }
 
-For example, on a polar machine, you tell it to go to a place like X10Y10. It
-converts to a radius and angle using inverse kinematics. The machine posiiton is now
-in those units X14.14 (radius) and Y45 (degrees). If you want to report those units as
-X10,Y10, you would use forward kinematics
+    const char* name() override { return "Polar Coaster"; }
+};
 
-position = the current machine position
-converted = position with forward kinematics applied.
+static PolarCoaster polar_coaster;
 
-*/
-void forward_kinematics(float* position) {
-    float   original_position[N_AXIS];  // temporary storage of original
-    float   print_position[N_AXIS];
-    int32_t current_position[N_AXIS];  // Copy current state of the system position variable
-    memcpy(current_position, sys_position, sizeof(sys_position));
-    system_convert_array_steps_to_mpos(print_position, current_position);
-    original_position[X_AXIS] = print_position[X_AXIS] - gc_state.coord_system[X_AXIS] + gc_state.coord_offset[X_AXIS];
-    original_position[Y_AXIS] = print_position[Y_AXIS] - gc_state.coord_system[Y_AXIS] + gc_state.coord_offset[Y_AXIS];
-    original_position[Z_AXIS] = print_position[Z_AXIS] - gc_state.coord_system[Z_AXIS] + gc_state.coord_offset[Z_AXIS];
-    position[X_AXIS]          = cos(radians(original_position[Y_AXIS])) * original_position[X_AXIS] * -1;
-    position[Y_AXIS]          = sin(radians(original_position[Y_AXIS])) * original_position[X_AXIS];
-    position[Z_AXIS]          = original_position[Z_AXIS];  // unchanged
+Kinematics* machine_kinematics() {
+    return &polar_coaster;
 }
 
 // helper functions
@@ -188,7 +97,7 @@ void forward_kinematics(float* position) {
 *   a long job.
 *
 */
-void calc_polar(float* target_xyz, float* polar, float last_angle) {
+void calc_polar(const float* target_xyz, float* polar, float last_angle) {
     float delta_ang;  // the difference from the last and next angle
     polar[RADIUS_AXIS] = hypot_f(target_xyz[X_AXIS], target_xyz[Y_AXIS]);
     if (polar[RADIUS_AXIS] == 0) {
@@ -0,0 +1,335 @@
+/*
+  AuxStream.cpp - an auxiliary axis run from its own planner and segment stream
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_AUX_STREAM
+
+enum class AuxOverride : uint8_t {
+    None = 0,
+    Feed,
+    Rapid,
+};
+
+typedef struct {
+    int32_t     steps;  // Negative for the - direction
+    float       rate;   // Programmed, in steps/sec
+    AuxOverride override;
+} aux_move_t;
+
+typedef struct {
+    uint32_t cycles;  // Step timer ticks the segment lasts
+    uint32_t period;  // Step timer ticks between its steps
+    uint16_t n_step;
+    int8_t   dir;
+} aux_segment_t;
+
+// Moves queued by the parser and taken by the task once they are done
+static aux_move_t       aux_moves[AUX_STREAM_BUFFER_SIZE];
+static volatile uint8_t aux_move_head = 0;
+static volatile uint8_t aux_move_tail = 0;
+
+// Segments queued by the task and taken by the step ISR
+static aux_segment_t    aux_segments[AUX_STREAM_SEGMENTS];
+static volatile uint8_t aux_segment_head = 0;
+static volatile uint8_t aux_segment_tail = 0;
+
+static volatile bool aux_aborted = false;
+
+static TaskHandle_t      auxStreamTaskHandle = 0;
+static SemaphoreHandle_t aux_mutex           = NULL;
+
+// Only used by the parser
+static int32_t aux_target = 0;  // Where the queued moves end, in steps
+
+// Constants of the axis in steps, set by the parser with each move. Settings cannot change while it moves.
+static volatile float aux_acceleration;  // steps/sec^2
+static volatile float aux_max_rate;      // steps/sec
+
+// Only used by the task
+static bool     aux_loaded = false;  // The move at aux_move_tail is being executed
+static uint32_t aux_remaining;       // Steps of that move not in a segment yet
+static float    aux_speed = 0.0;     // At the end of the last segment, in steps/sec
+static float    aux_carry = 0.0;     // Fraction of a step the last segment left over
+
+// Only used by the step ISR
+static aux_segment_t* aux_exec = NULL;
+static uint32_t       aux_elapsed;
+static uint32_t       aux_phase;
+static uint16_t       aux_exec_steps;
+
+static const float aux_dt = AUX_STREAM_SEGMENT_MS / 1000.0f;
+
+static inline uint8_t IRAM_ATTR aux_next(uint8_t index, uint8_t size) {
+    return index + 1 == size ? 0 : index + 1;
+}
+
+static bool aux_holding() {
+    switch (sys.state) {
+        case State::Hold:
+        case State::SafetyDoor:
+        case State::Sleep:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static float aux_move_rate(const aux_move_t& move) {
+    float rate = move.rate;
+    if (move.override == AuxOverride::Feed) {
+        rate *= sys.f_override * 0.01f;
+    } else if (move.override == AuxOverride::Rapid) {
+        rate *= sys.r_override * 0.01f;
+    }
+    return MIN(rate, aux_max_rate);
+}
+
+// Fastest speed the axis may have at the end of the next segment: that of the move, and slow enough to
+// reach the rate of each following move that goes the same way, and to stop where the next one reverses
+// or the queue ends.
+static float aux_speed_limit(float accel) {
+    const aux_move_t& current = aux_moves[aux_move_tail];
+    float             limit   = aux_holding() ? 0.0f : aux_move_rate(current);
+    float             ahead   = MAX(float(aux_remaining) - aux_speed * aux_dt, 0.0f);
+    uint8_t           index   = aux_next(aux_move_tail, AUX_STREAM_BUFFER_SIZE);
+    while (true) {
+        float reach = 2.0f * accel * ahead;
+        if (reach >= limit * limit) {
+            return limit;  // Whatever comes next is far enough away
+        }
+        if (index == aux_move_head || (aux_moves[index].steps < 0) != (current.steps < 0)) {
+            return sqrtf(reach);
+        }
+        float rate = aux_move_rate(aux_moves[index]);
+        limit      = MIN(limit, sqrtf(rate * rate + reach));
+        ahead += labs(aux_moves[index].steps);
+        index = aux_next(index, AUX_STREAM_BUFFER_SIZE);
+    }
+}
+
+// Queues the next segment of the current move. Returns false when there is nothing to queue.
+static bool aux_prep_segment() {
+    if (!aux_loaded) {
+        if (aux_move_tail == aux_move_head) {
+            aux_speed = 0.0;
+            aux_carry = 0.0;
+            return false;
+        }
+        aux_remaining = labs(aux_moves[aux_move_tail].steps);
+        aux_loaded    = true;
+    }
+    float accel = aux_acceleration;
+    float limit = aux_speed_limit(accel);
+    float speed;
+    if (aux_speed < limit) {
+        speed = MIN(aux_speed + accel * aux_dt, limit);
+    } else {
+        speed = MAX(aux_speed - accel * aux_dt, limit);
+    }
+    if (speed == 0.0f && aux_speed == 0.0f) {
+        return false;  // Held
+    }
+    float    steps = (aux_speed + speed) * 0.5f * aux_dt + aux_carry;
+    uint32_t n     = uint32_t(steps);
+    aux_carry      = steps - n;
+    if (n >= aux_remaining) {
+        n         = aux_remaining;
+        aux_carry = 0.0;
+    }
+    aux_speed = speed;
+
+    aux_segment_t& segment = aux_segments[aux_segment_head];
+    segment.cycles         = AUX_STREAM_SEGMENT_CYCLES;
+    segment.period         = n ? AUX_STREAM_SEGMENT_CYCLES / n : AUX_STREAM_SEGMENT_CYCLES;
+    segment.n_step         = n;
+    segment.dir            = aux_moves[aux_move_tail].steps < 0 ? -1 : 1;
+    aux_segment_head       = aux_next(aux_segment_head, AUX_STREAM_SEGMENTS);
+
+    aux_remaining -= n;
+    if (aux_remaining == 0) {
+        int32_t done  = aux_moves[aux_move_tail].steps;
+        aux_move_tail = aux_next(aux_move_tail, AUX_STREAM_BUFFER_SIZE);
+        aux_loaded    = false;
+        if (aux_move_tail == aux_move_head || (aux_moves[aux_move_tail].steps < 0) != (done < 0)) {
+            aux_speed = 0.0;  // Within a step per segment of a stop, the limit saw to that
+            aux_carry = 0.0;
+        }
+    }
+    return true;
+}
+
+static void aux_prep_buffer() {
+    xSemaphoreTake(aux_mutex, portMAX_DELAY);
+    while (!aux_aborted && aux_next(aux_segment_head, AUX_STREAM_SEGMENTS) != aux_segment_tail && aux_prep_segment()) {}
+    xSemaphoreGive(aux_mutex);
+}
+
+// Woken by the step ISR when its segments run low and by new moves. It also looks every segment time, for
+// the overrides and a feed hold.
+static void auxStreamTask(void* pvParameters) {
+    while (true) {
+        task_stats_block();
+        ulTaskNotifyTake(pdTRUE, AUX_STREAM_SEGMENT_MS / portTICK_PERIOD_MS);
+        task_stats_unblock();
+        aux_prep_buffer();
+    }
+}
+
+void aux_stream_init() {
+    aux_mutex = xSemaphoreCreateMutex();
+    xTaskCreatePinnedToCore(auxStreamTask,    // task
+                            "auxStreamTask",  // name for task
+                            AUX_STREAM_TASK_STACK,
+                            NULL,  // parameters
+                            AUX_STREAM_TASK_PRIORITY,
+                            &auxStreamTaskHandle,
+                            AUX_STREAM_TASK_CORE  // core
+    );
+}
+
+void aux_stream_line(const float* target, const plan_line_data_t* pl_data) {
+    if (AUX_STREAM_AXIS >= motion_config.n_axis) {
+        return;
+    }
+    float   steps_per_mm = motion_config.steps_per_mm[AUX_STREAM_AXIS];
+    int32_t target_steps = lroundf(target[AUX_STREAM_AXIS] * steps_per_mm);
+    int32_t steps        = target_steps - aux_target;
+    if (steps == 0) {
+        return;
+    }
+    aux_acceleration = motion_config.acceleration[AUX_STREAM_AXIS] * steps_per_mm;
+    aux_max_rate     = MIN(motion_config.max_rate[AUX_STREAM_AXIS] * steps_per_mm / 60.0f, 1000000.0f / AUX_STREAM_TICK_US);
+
+    aux_move_t move;
+    move.steps = steps;
+    if (pl_data->motion.rapidMotion) {
+        move.rate     = aux_max_rate;
+        move.override = AuxOverride::Rapid;
+    } else {
+        float feed_rate = pl_data->feed_rate;
+        if (pl_data->motion.inverseTime) {
+            feed_rate *= labs(steps) / steps_per_mm;  // The move takes 1/F minutes
+        }
+        move.rate     = feed_rate * steps_per_mm / 60.0f;
+        move.override = pl_data->motion.noFeedOverride ? AuxOverride::None : AuxOverride::Feed;
+    }
+    // Wait for room, as for the planner buffer
+    uint8_t next = aux_next(aux_move_head, AUX_STREAM_BUFFER_SIZE);
+    while (next == aux_move_tail) {
+        protocol_execute_realtime();
+        if (sys.abort) {
+            return;
+        }
+    }
+    aux_moves[aux_move_head] = move;
+    aux_move_head            = next;
+    aux_target               = target_steps;
+    xTaskNotifyGive(auxStreamTaskHandle);
+}
+
+bool aux_stream_busy() {
+    return aux_move_head != aux_move_tail || aux_stream_ready();
+}
+
+void aux_stream_synchronize() {
+    while (aux_stream_busy()) {
+        protocol_execute_realtime();
+        if (sys.abort) {
+            return;
+        }
+    }
+}
+
+int32_t aux_stream_target() {
+    return aux_target;
+}
+
+void aux_stream_jogged(int32_t target_steps) {
+    aux_target = target_steps;
+}
+
+void aux_stream_sync_position() {
+    if (!aux_stream_busy()) {
+        aux_target = sys_position[AUX_STREAM_AXIS];
+    }
+}
+
+bool IRAM_ATTR aux_stream_abort() {
+    bool moving = aux_stream_ready();
+    aux_aborted = true;
+    return moving;
+}
+
+void aux_stream_reset() {
+    xSemaphoreTake(aux_mutex, portMAX_DELAY);
+    aux_move_tail    = aux_move_head;
+    aux_segment_tail = aux_segment_head;
+    aux_exec         = NULL;
+    aux_loaded       = false;
+    aux_speed        = 0.0;
+    aux_carry        = 0.0;
+    aux_aborted      = false;
+    xSemaphoreGive(aux_mutex);
+}
+
+bool IRAM_ATTR aux_stream_ready() {
+    return !aux_aborted && (aux_exec != NULL || aux_segment_tail != aux_segment_head);
+}
+
+int8_t IRAM_ATTR aux_stream_step(uint32_t cycles) {
+    if (aux_aborted) {
+        return 0;  // Until aux_stream_reset()
+    }
+    if (aux_exec == NULL) {
+        if (aux_segment_tail == aux_segment_head) {
+            return 0;
+        }
+        aux_exec       = &aux_segments[aux_segment_tail];
+        aux_elapsed    = 0;
+        aux_phase      = aux_exec->period / 2;  // Steps centered in their periods
+        aux_exec_steps = aux_exec->n_step;
+    }
+    int8_t step = 0;
+    aux_elapsed += cycles;
+    aux_phase += cycles;
+    if (aux_exec_steps && aux_phase >= aux_exec->period) {
+        aux_phase -= aux_exec->period;
+        aux_exec_steps--;
+        step = aux_exec->dir;
+    }
+    // A segment the ticks were too long for lasts until its last step
+    if (aux_exec_steps == 0 && aux_elapsed >= aux_exec->cycles) {
+        aux_exec         = NULL;
+        aux_segment_tail = aux_next(aux_segment_tail, AUX_STREAM_SEGMENTS);
+        uint8_t queued   = aux_segment_head - aux_segment_tail;
+        if (queued > AUX_STREAM_SEGMENTS) {
+            queued += AUX_STREAM_SEGMENTS;  // Head has wrapped around
+        }
+        if (queued <= AUX_STREAM_SEGMENTS / 2) {
+            BaseType_t higherPriorityTaskWoken = pdFALSE;
+            vTaskNotifyGiveFromISR(auxStreamTaskHandle, &higherPriorityTaskWoken);
+            if (higherPriorityTaskWoken && xPortInIsrContext()) {
+                portYIELD_FROM_ISR();
+            }
+        }
+    }
+    return step;
+}
+
+#endif
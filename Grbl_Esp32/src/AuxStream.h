@@ -0,0 +1,107 @@
+#pragma once
+
+/*
+  AuxStream.h - an auxiliary axis run from its own planner and segment stream
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  With ENABLE_AUX_STREAM the AUX_STREAM_AXIS, A by default, is taken out of the planner blocks. A conveyor
+  or rotary table on it then no longer makes the tool path slow down when it changes speed, nor waits for
+  the other axes. mc_line() hands its part of each g-code move to a queue of AUX_STREAM_BUFFER_SIZE moves,
+  and the planner plans the rest as if the axis did not move.
+
+  auxStreamTask runs the queue through its own trapezoid planner, with the acceleration and max rate of
+  the axis. It looks ahead along the moves that go the same way and slows down to the rate of the next
+  one, or to a stop before a reversal or the end of the queue. A G1 move runs at its feed rate and a G0
+  move at the max rate, with the feed and rapid overrides applied as they change. The task cuts the
+  profile into segments of AUX_STREAM_SEGMENT_MS, each a step count and an even step period.
+
+  The step ISR puts those steps out between the ticks of the other axes. While they move slower than
+  one tick per AUX_STREAM_TICK_US, each of their ticks is split into periods of about that length, and
+  once they stop the ISR ticks at that rate for the auxiliary axis alone. The axis steps at most once per
+  tick, so its rate is limited to one step per AUX_STREAM_TICK_US. sys_position follows it, so reports
+  show where it is.
+
+  The auxiliary axis is independent of the cycle: the machine reports Idle once the other axes stop, and
+  the end of a program, a dwell or M-codes do not wait for it. A feed hold stops it with its own
+  deceleration and the hold completes when it has stopped. Homing waits for it, and a jog may only move
+  it when its queue is empty. A reset stops it at once and raises ALARM:3 as for any motion, as the
+  position is lost. Arcs and height map compensated moves move it to their end points.
+*/
+
+#include "Grbl.h"
+
+#if defined(STEP_BURST) || defined(USE_KINEMATICS) || defined(JOG_VELOCITY_MODE)
+#    error "ENABLE_AUX_STREAM cannot be used with RMT_STEP_BURST, USE_MCPWM_STEPS, USE_KINEMATICS or JOG_VELOCITY_MODE"
+#endif
+
+// Axis taken out of the planner. Not X or Y, which CoreXY mixes.
+#ifndef AUX_STREAM_AXIS
+#    define AUX_STREAM_AXIS A_AXIS
+#endif
+static_assert(AUX_STREAM_AXIS > Y_AXIS && AUX_STREAM_AXIS < MAX_N_AXIS, "AUX_STREAM_AXIS must be one of Z, A, B or C");
+
+// Moves queued for the auxiliary axis. mc_line() waits when it is full.
+#ifndef AUX_STREAM_BUFFER_SIZE
+#    define AUX_STREAM_BUFFER_SIZE 16
+#endif
+// Segments queued ahead of the step ISR, and the time each one lasts.
+#ifndef AUX_STREAM_SEGMENTS
+#    define AUX_STREAM_SEGMENTS 8
+#endif
+#ifndef AUX_STREAM_SEGMENT_MS
+#    define AUX_STREAM_SEGMENT_MS 5
+#endif
+// Longest step ISR period while the auxiliary axis moves
+#ifndef AUX_STREAM_TICK_US
+#    define AUX_STREAM_TICK_US 20
+#endif
+
+const uint32_t AUX_STREAM_TICK_CYCLES    = AUX_STREAM_TICK_US * (F_STEPPER_TIMER / 1000000);
+const uint32_t AUX_STREAM_SEGMENT_CYCLES = AUX_STREAM_SEGMENT_MS * (F_STEPPER_TIMER / 1000);
+
+// Sets up the queues and starts the task.
+void aux_stream_init();
+
+// Queues the move of the auxiliary axis to target, in mm, at the rate of pl_data. Called by mc_line().
+void aux_stream_line(const float* target, const plan_line_data_t* pl_data);
+
+// Whether the auxiliary axis has moves queued or is still moving.
+bool aux_stream_busy();
+
+// Waits until the auxiliary axis has stopped at the end of its queue.
+void aux_stream_synchronize();
+
+// Position the queued moves end at, in steps. Where jogs of the axis start from.
+int32_t aux_stream_target();
+
+// Called by the planner for a jog that moves the axis with the other ones, with its target in steps.
+void aux_stream_jogged(int32_t target_steps);
+
+// Makes the queue start from sys_position again after a jog cancel, a probe or homing. Only when it is empty.
+void aux_stream_sync_position();
+
+// Stops the axis without deceleration. Safe in an ISR. Returns whether it was moving.
+bool aux_stream_abort();
+
+// Drops the queued moves and segments after an abort.
+void aux_stream_reset();
+
+// For the step ISR. Whether there is a segment to execute, and the step of the next cycles step timer
+// ticks: 1, -1 or 0.
+bool   aux_stream_ready();
+int8_t aux_stream_step(uint32_t cycles);
@@ -0,0 +1,224 @@
+/*
+  AxisEncoder.cpp - quadrature encoders that verify the position of the stepper axes
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_AXIS_ENCODERS
+
+#    include <driver/pcnt.h>
+#    include <soc/pcnt_struct.h>
+
+// The counter resets to 0 at either limit, so raw counts are taken modulo this.
+static const int16_t ENCODER_COUNT_LIMIT = 32767;
+
+typedef struct {
+    uint8_t     axis;
+    uint8_t     a_pin;
+    uint8_t     b_pin;
+    pcnt_unit_t unit;
+    float       counts_per_mm;
+    int16_t     raw;         // Counter value at the last sample
+    int32_t     position;    // Counts since startup
+    int32_t     ref_counts;  // position when the comparison started
+    int32_t     ref_steps;   // sys_position of the axis then
+    float       error;
+    float       max_error;
+} axis_encoder_t;
+
+static axis_encoder_t encoders[] = {
+#    ifdef X_ENCODER_A_PIN
+    { X_AXIS, X_ENCODER_A_PIN, X_ENCODER_B_PIN, X_ENCODER_PCNT_UNIT, X_ENCODER_COUNTS_PER_MM },
+#    endif
+#    ifdef Y_ENCODER_A_PIN
+    { Y_AXIS, Y_ENCODER_A_PIN, Y_ENCODER_B_PIN, Y_ENCODER_PCNT_UNIT, Y_ENCODER_COUNTS_PER_MM },
+#    endif
+#    ifdef Z_ENCODER_A_PIN
+    { Z_AXIS, Z_ENCODER_A_PIN, Z_ENCODER_B_PIN, Z_ENCODER_PCNT_UNIT, Z_ENCODER_COUNTS_PER_MM },
+#    endif
+#    ifdef A_ENCODER_A_PIN
+    { A_AXIS, A_ENCODER_A_PIN, A_ENCODER_B_PIN, A_ENCODER_PCNT_UNIT, A_ENCODER_COUNTS_PER_MM },
+#    endif
+#    ifdef B_ENCODER_A_PIN
+    { B_AXIS, B_ENCODER_A_PIN, B_ENCODER_B_PIN, B_ENCODER_PCNT_UNIT, B_ENCODER_COUNTS_PER_MM },
+#    endif
+#    ifdef C_ENCODER_A_PIN
+    { C_AXIS, C_ENCODER_A_PIN, C_ENCODER_B_PIN, C_ENCODER_PCNT_UNIT, C_ENCODER_COUNTS_PER_MM },
+#    endif
+};
+static const uint8_t n_encoders = sizeof(encoders) / sizeof(encoders[0]);
+
+static portMUX_TYPE encoder_spinlock = portMUX_INITIALIZER_UNLOCKED;
+
+// Difference of two raw counts, for moves of less than half the count limit.
+static int32_t encoder_delta(int16_t to, int16_t from) {
+    int32_t delta = (int32_t(to) - from) % ENCODER_COUNT_LIMIT;
+    if (delta > ENCODER_COUNT_LIMIT / 2) {
+        delta -= ENCODER_COUNT_LIMIT;
+    } else if (delta < -ENCODER_COUNT_LIMIT / 2) {
+        delta += ENCODER_COUNT_LIMIT;
+    }
+    return delta;
+}
+
+// Whether the steppers must be where sys_position says. Otherwise the encoders follow it.
+static bool encoder_verify_state() {
+    switch (sys.state) {
+        case State::Cycle:
+        case State::Jog:
+        case State::Hold:
+            return true;
+        case State::Idle:
+            return stepper_idle_lock_time->get() == 0xff;
+        default:
+            return false;
+    }
+}
+
+static void encoder_following_error(axis_encoder_t& encoder) {
+    if (sys_rt_exec_alarm != ExecAlarm::None) {
+        return;  // Already stopping
+    }
+    mc_reset();
+    system_set_exec_alarm(ExecAlarm::FollowingError);
+    grbl_msg_sendf(CLIENT_ALL, MsgLevel::Info, "Following error %c %4.3fmm", report_get_axis_letter(encoder.axis), encoder.error);
+}
+
+static void encoder_check() {
+    int32_t position[MAX_N_AXIS];
+    system_get_position(position);
+    bool verify = encoder_verify_state();
+
+    for (uint8_t i = 0; i < n_encoders; i++) {
+        axis_encoder_t& encoder = encoders[i];
+        uint8_t         axis    = encoder.axis;
+        int16_t         raw     = int16_t(PCNT.cnt_unit[encoder.unit].cnt_val);
+
+        portENTER_CRITICAL(&encoder_spinlock);
+        encoder.position += encoder_delta(raw, encoder.raw);
+        encoder.raw = raw;
+        if (!verify) {
+            encoder.ref_counts = encoder.position;
+            encoder.ref_steps  = position[axis];
+            encoder.error      = 0.0;
+        }
+        portEXIT_CRITICAL(&encoder_spinlock);
+
+        float steps_per_mm = axis_settings[axis]->steps_per_mm->get();
+        if (verify) {
+            float commanded = (position[axis] - encoder.ref_steps) / steps_per_mm;
+            float measured  = (encoder.position - encoder.ref_counts) / encoder.counts_per_mm;
+            encoder.error   = commanded - measured;
+            if (fabsf(encoder.error) > fabsf(encoder.max_error)) {
+                encoder.max_error = encoder.error;
+            }
+            if (fabsf(encoder.error) > AXIS_ENCODER_MAX_ERROR) {
+                encoder_following_error(encoder);
+            }
+        }
+#    ifdef AXIS_ENCODER_CORRECTION
+        int32_t steps = 0;
+        if (fabsf(encoder.error) * encoder.counts_per_mm > AXIS_ENCODER_DEADBAND_COUNTS) {
+            steps = lroundf(encoder.error * steps_per_mm);
+        }
+        st_set_correction(axis, steps);
+#    endif
+    }
+}
+
+static void axisEncoderTask(void* pvParameters) {
+    TickType_t last_wake = xTaskGetTickCount();
+    while (true) {
+        encoder_check();
+        task_stats_block();
+        vTaskDelayUntil(&last_wake, AXIS_ENCODER_SAMPLE_MS / portTICK_PERIOD_MS);
+        task_stats_unblock();
+    }
+}
+
+static void encoder_unit_init(const axis_encoder_t& encoder) {
+    // Channel 0 counts the edges of A and channel 1 those of B, each with the other as the direction.
+    pcnt_config_t config  = {};
+    config.pulse_gpio_num = encoder.a_pin;
+    config.ctrl_gpio_num  = encoder.b_pin;
+    config.channel        = PCNT_CHANNEL_0;
+    config.unit           = encoder.unit;
+    config.pos_mode       = PCNT_COUNT_DEC;
+    config.neg_mode       = PCNT_COUNT_INC;
+    config.lctrl_mode     = PCNT_MODE_REVERSE;
+    config.hctrl_mode     = PCNT_MODE_KEEP;
+    config.counter_h_lim  = ENCODER_COUNT_LIMIT;
+    config.counter_l_lim  = -ENCODER_COUNT_LIMIT;
+    pcnt_unit_config(&config);
+
+    config.pulse_gpio_num = encoder.b_pin;
+    config.ctrl_gpio_num  = encoder.a_pin;
+    config.channel        = PCNT_CHANNEL_1;
+    config.pos_mode       = PCNT_COUNT_INC;
+    config.neg_mode       = PCNT_COUNT_DEC;
+    pcnt_unit_config(&config);
+
+    pcnt_set_filter_value(encoder.unit, 100);  // Ignore glitches shorter than 1.25us (APB cycles)
+    pcnt_filter_enable(encoder.unit);
+    pcnt_counter_pause(encoder.unit);
+    pcnt_counter_clear(encoder.unit);
+    pcnt_counter_resume(encoder.unit);
+}
+
+void axis_encoder_init() {
+    for (uint8_t i = 0; i < n_encoders; i++) {
+        axis_encoder_t& encoder = encoders[i];
+        encoder_unit_init(encoder);
+        grbl_msg_sendf(CLIENT_SERIAL,
+                       MsgLevel::Info,
+                       "%c encoder A:%s B:%s %4.3f counts/mm",
+                       report_get_axis_letter(encoder.axis),
+                       pinName(encoder.a_pin).c_str(),
+                       pinName(encoder.b_pin).c_str(),
+                       encoder.counts_per_mm);
+    }
+    xTaskCreatePinnedToCore(axisEncoderTask,
+                            "axisEncoderTask",
+                            AXIS_ENCODER_TASK_STACK,
+                            NULL,
+                            AXIS_ENCODER_TASK_PRIORITY,
+                            NULL,
+                            AXIS_ENCODER_TASK_CORE);
+}
+
+bool axis_encoder_get(uint8_t index, axis_encoder_info_t* info) {
+    if (index >= n_encoders) {
+        return false;
+    }
+    const axis_encoder_t& encoder = encoders[index];
+    portENTER_CRITICAL(&encoder_spinlock);
+    int32_t position = encoder.position;
+    portEXIT_CRITICAL(&encoder_spinlock);
+    info->axis      = encoder.axis;
+    info->position  = position / encoder.counts_per_mm;
+    info->error     = encoder.error;
+    info->max_error = encoder.max_error;
+    return true;
+}
+
+void axis_encoder_reset_stats() {
+    for (uint8_t i = 0; i < n_encoders; i++) {
+        encoders[i].max_error = 0.0;
+    }
+}
+
+#endif
@@ -0,0 +1,118 @@
+#pragma once
+
+/*
+  AxisEncoder.h - quadrature encoders that verify the position of the stepper axes
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Each axis with an encoder has a pulse counter unit that decodes its A and B channels on all four
+  edges. A low priority task unwraps the counters every AXIS_ENCODER_SAMPLE_MS and compares the
+  distance each encoder moved with the distance sys_position moved, which is what the steppers were
+  told to do. The difference is the following error, positive when the axis lags behind.
+
+  The comparison runs while the machine moves, holds, or stands with the motors locked by $1=255.
+  In any other state, and in Idle when the motors may be released, the encoders only follow the
+  machine position, so a homing cycle, an alarm or turning an axis by hand is not an error. When the
+  error of an axis exceeds AXIS_ENCODER_MAX_ERROR the machine is reset as for a hard limit and
+  ALARM:11 is raised.
+
+  With AXIS_ENCODER_CORRECTION the task also hands the error, in steps, to the step ISR, which adds
+  the missing steps to the axis on the ticks it does not step anyway. Errors within
+  AXIS_ENCODER_DEADBAND_COUNTS are left alone.
+
+  Machine definitions set X_ENCODER_A_PIN, X_ENCODER_B_PIN and X_ENCODER_COUNTS_PER_MM (four counts
+  per line), and the same for the other axes. Swapping A and B reverses the count. On CoreXY machines
+  the X and Y encoders belong on the A and B motors. With BACKLASH_COMPENSATION the encoders must read
+  the axis, not the motor, as the take-up steps are not in sys_position.
+*/
+
+#include "Grbl.h"
+
+#if !defined(X_ENCODER_A_PIN) && !defined(Y_ENCODER_A_PIN) && !defined(Z_ENCODER_A_PIN) && !defined(A_ENCODER_A_PIN) &&            \
+    !defined(B_ENCODER_A_PIN) && !defined(C_ENCODER_A_PIN)
+#    error "ENABLE_AXIS_ENCODERS requires at least one encoder, such as X_ENCODER_A_PIN"
+#endif
+
+#if defined(X_ENCODER_A_PIN) && (!defined(X_ENCODER_B_PIN) || !defined(X_ENCODER_COUNTS_PER_MM))
+#    error "X_ENCODER_A_PIN requires X_ENCODER_B_PIN and X_ENCODER_COUNTS_PER_MM"
+#endif
+#if defined(Y_ENCODER_A_PIN) && (!defined(Y_ENCODER_B_PIN) || !defined(Y_ENCODER_COUNTS_PER_MM))
+#    error "Y_ENCODER_A_PIN requires Y_ENCODER_B_PIN and Y_ENCODER_COUNTS_PER_MM"
+#endif
+#if defined(Z_ENCODER_A_PIN) && (!defined(Z_ENCODER_B_PIN) || !defined(Z_ENCODER_COUNTS_PER_MM))
+#    error "Z_ENCODER_A_PIN requires Z_ENCODER_B_PIN and Z_ENCODER_COUNTS_PER_MM"
+#endif
+#if defined(A_ENCODER_A_PIN) && (!defined(A_ENCODER_B_PIN) || !defined(A_ENCODER_COUNTS_PER_MM))
+#    error "A_ENCODER_A_PIN requires A_ENCODER_B_PIN and A_ENCODER_COUNTS_PER_MM"
+#endif
+#if defined(B_ENCODER_A_PIN) && (!defined(B_ENCODER_B_PIN) || !defined(B_ENCODER_COUNTS_PER_MM))
+#    error "B_ENCODER_A_PIN requires B_ENCODER_B_PIN and B_ENCODER_COUNTS_PER_MM"
+#endif
+#if defined(C_ENCODER_A_PIN) && (!defined(C_ENCODER_B_PIN) || !defined(C_ENCODER_COUNTS_PER_MM))
+#    error "C_ENCODER_A_PIN requires C_ENCODER_B_PIN and C_ENCODER_COUNTS_PER_MM"
+#endif
+
+// Pulse counter units of the encoders. Units 0 and 1 are the defaults of the spindle tachometer and
+// the spindle encoder.
+#ifndef X_ENCODER_PCNT_UNIT
+#    define X_ENCODER_PCNT_UNIT PCNT_UNIT_2
+#endif
+#ifndef Y_ENCODER_PCNT_UNIT
+#    define Y_ENCODER_PCNT_UNIT PCNT_UNIT_3
+#endif
+#ifndef Z_ENCODER_PCNT_UNIT
+#    define Z_ENCODER_PCNT_UNIT PCNT_UNIT_4
+#endif
+#ifndef A_ENCODER_PCNT_UNIT
+#    define A_ENCODER_PCNT_UNIT PCNT_UNIT_5
+#endif
+#ifndef B_ENCODER_PCNT_UNIT
+#    define B_ENCODER_PCNT_UNIT PCNT_UNIT_6
+#endif
+#ifndef C_ENCODER_PCNT_UNIT
+#    define C_ENCODER_PCNT_UNIT PCNT_UNIT_7
+#endif
+
+// Period of the comparison. A counter must not move more than 16383 counts in it.
+#ifndef AXIS_ENCODER_SAMPLE_MS
+#    define AXIS_ENCODER_SAMPLE_MS 5
+#endif
+
+// Largest following error in mm before the alarm
+#ifndef AXIS_ENCODER_MAX_ERROR
+#    define AXIS_ENCODER_MAX_ERROR 0.5
+#endif
+
+// Errors AXIS_ENCODER_CORRECTION leaves alone, in encoder counts
+#ifndef AXIS_ENCODER_DEADBAND_COUNTS
+#    define AXIS_ENCODER_DEADBAND_COUNTS 2
+#endif
+
+typedef struct {
+    uint8_t axis;
+    float   position;   // Measured since startup, in mm
+    float   error;      // Following error at the last sample, in mm
+    float   max_error;  // Largest error since startup or $Encoders/Stats=0, in mm, signed
+} axis_encoder_info_t;
+
+// Sets up the counters and starts the task.
+void axis_encoder_init();
+
+// Copies the state of an encoder. Returns false past the last one.
+bool axis_encoder_get(uint8_t index, axis_encoder_info_t* info);
+
+void axis_encoder_reset_stats();
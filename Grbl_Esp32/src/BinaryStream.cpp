@@ -0,0 +1,395 @@
+/*
+  BinaryStream.cpp - framed binary motion records for high-rate senders
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_BINARY_STREAM
+
+#    include <cmath>
+#    include <freertos/queue.h>
+
+// TYPE, seq, flags, axis_mask, feed and power, followed by the axis values.
+const uint8_t BINARY_MOTION_HEADER = 13;
+#    ifdef ENABLE_LASER_RASTER
+// TYPE, seq, flags, axis, pitch, feed and power, followed by the pixels.
+const uint8_t BINARY_RASTER_HEADER = 17;
+const uint8_t BINARY_MAX_FRAME     = BINARY_RASTER_HEADER + RASTER_MAX_PIXELS;
+#    else
+const uint8_t BINARY_MAX_FRAME = BINARY_MOTION_HEADER + MAX_N_AXIS * sizeof(float);
+#    endif
+
+const uint8_t BINARY_FLAG_RAPID   = bit(0);
+const uint8_t BINARY_FLAG_REVERSE = bit(0);  // Raster records
+
+enum class FrameState : uint8_t {
+    Idle = 0,
+    Length,
+    Body,
+    CrcHigh,
+    CrcLow,
+};
+
+typedef struct {
+    FrameState state;
+    uint8_t    len;  // Bytes of TYPE and payload
+    uint8_t    pos;
+    uint16_t   crc;
+    uint16_t   received_crc;
+    int64_t    last_us;
+    uint8_t    buf[BINARY_MAX_FRAME];
+} binary_frame_t;
+
+typedef struct {
+    uint16_t seq;
+    uint8_t  client;
+    uint8_t  flags;
+    uint8_t  axis_mask;
+    float    feed_rate;
+    float    power;
+    float    target[MAX_N_AXIS];
+#    ifdef ENABLE_LASER_RASTER
+    raster_line_t* raster;  // Scanline of a raster record, else NULL. axis_mask then holds the axis.
+    float          pitch;
+#    endif
+} binary_record_t;
+
+static binary_frame_t        frames[CLIENT_COUNT];
+static QueueHandle_t         binary_queue[CLIENT_COUNT];
+static binary_stream_stats_t binary_stats;
+static uint8_t               unacked[CLIENT_COUNT];
+static uint16_t              last_seq[CLIENT_COUNT];
+
+static uint16_t crc16_update(uint16_t crc, uint8_t data) {
+    crc ^= uint16_t(data) << 8;
+    for (uint8_t i = 0; i < 8; i++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+static uint16_t get_u16(const uint8_t* p) { return p[0] | (uint16_t(p[1]) << 8); }
+
+static float get_f32(const uint8_t* p) {
+    float value;
+    memcpy(&value, p, sizeof(float));  // The ESP32 is little-endian like the wire format
+    return value;
+}
+
+static void reply(const char* what, uint8_t client, uint16_t seq) { grbl_sendf(client, "[BIN:%s,%u]\r\n", what, seq); }
+
+// Queues a checked record and leaves an STX in the client's text input where the frame was received, so
+// the main loop runs it between the text lines before and after it. The serial task is the only writer
+// of both, so the room checked here is still there when the record and its marker are written.
+static bool queue_record(uint8_t client, const binary_record_t* record) {
+    if (uxQueueSpacesAvailable(binary_queue[client]) == 0 || serial_get_rx_buffer_available(client) == 0) {
+        return false;
+    }
+    xQueueSend(binary_queue[client], record, 0);
+    serial_write_bulk(client, &BINARY_STX, 1);
+    return true;
+}
+
+// Checks a motion record from a complete frame and queues it. Runs in the serial task.
+static void queue_motion(uint8_t client, const uint8_t* buf, uint8_t len) {
+    uint16_t seq = (len >= 3) ? get_u16(&buf[1]) : 0;
+    if (len < BINARY_MOTION_HEADER) {
+        binary_stats.rejected++;
+        reply("ERR", client, seq);
+        return;
+    }
+    binary_record_t record = {};
+    record.seq       = seq;
+    record.client    = client;
+    record.flags     = buf[3];
+    record.axis_mask = buf[4];
+    record.feed_rate = get_f32(&buf[5]);
+    record.power     = get_f32(&buf[9]);
+
+    auto    n_axis = number_axis->get();
+    uint8_t pos    = BINARY_MOTION_HEADER;
+    bool    valid  = (record.axis_mask >> n_axis) == 0 && std::isfinite(record.feed_rate) && std::isfinite(record.power) &&
+                 record.power >= 0.0;
+    if (bit_isfalse(record.flags, BINARY_FLAG_RAPID) && !(record.feed_rate > 0.0)) {
+        valid = false;
+    }
+    for (uint8_t idx = 0; valid && idx < n_axis; idx++) {
+        if (bit_isfalse(record.axis_mask, bit(idx))) {
+            continue;
+        }
+        if (pos + sizeof(float) > len) {
+            valid = false;
+            break;
+        }
+        record.target[idx] = get_f32(&buf[pos]);
+        valid              = std::isfinite(record.target[idx]);
+        pos += sizeof(float);
+    }
+    if (!valid || pos != len) {
+        binary_stats.rejected++;
+        reply("ERR", client, seq);
+        return;
+    }
+    if (!queue_record(client, &record)) {
+        binary_stats.overflows++;
+        reply("OVF", client, seq);
+    }
+}
+
+#    ifdef ENABLE_LASER_RASTER
+// Checks a raster record, copies its pixels to a scanline buffer and queues it. Runs in the serial task.
+static void queue_raster(uint8_t client, const uint8_t* buf, uint8_t len) {
+    uint16_t seq = (len >= 3) ? get_u16(&buf[1]) : 0;
+    if (len <= BINARY_RASTER_HEADER) {
+        binary_stats.rejected++;
+        reply("ERR", client, seq);
+        return;
+    }
+    binary_record_t record = {};
+    record.seq             = seq;
+    record.client          = client;
+    record.flags           = buf[3];
+    record.axis_mask       = buf[4];
+    record.pitch           = get_f32(&buf[5]);
+    record.feed_rate       = get_f32(&buf[9]);
+    record.power           = get_f32(&buf[13]);
+    if (record.axis_mask >= number_axis->get() || !(record.pitch > 0.0) || !(record.feed_rate > 0.0) ||
+        !std::isfinite(record.pitch) || !std::isfinite(record.feed_rate) || !std::isfinite(record.power) || record.power < 0.0) {
+        binary_stats.rejected++;
+        reply("ERR", client, seq);
+        return;
+    }
+    record.raster = raster_alloc();
+    if (record.raster == NULL) {
+        binary_stats.overflows++;
+        reply("OVF", client, seq);
+        return;
+    }
+    record.raster->axis     = record.axis_mask;
+    record.raster->n_pixels = len - BINARY_RASTER_HEADER;
+    memcpy(record.raster->pixels, &buf[BINARY_RASTER_HEADER], record.raster->n_pixels);
+    if (!queue_record(client, &record)) {
+        raster_release(record.raster);
+        binary_stats.overflows++;
+        reply("OVF", client, seq);
+    }
+}
+#    endif
+
+static void frame_done(uint8_t client, binary_frame_t* frame) {
+    frame->state = FrameState::Idle;
+    if (frame->crc != frame->received_crc) {
+        binary_stats.crc_errors++;
+        reply("ERR", client, (frame->len >= 3) ? get_u16(&frame->buf[1]) : 0);
+        return;
+    }
+    switch (frame->buf[0]) {
+        case BINARY_TYPE_MOTION:
+            queue_motion(client, frame->buf, frame->len);
+            break;
+#    ifdef ENABLE_LASER_RASTER
+        case BINARY_TYPE_RASTER:
+            queue_raster(client, frame->buf, frame->len);
+            break;
+#    endif
+        default:
+            binary_stats.rejected++;
+            reply("ERR", client, 0);
+            break;
+    }
+}
+
+void binary_stream_init() {
+    for (uint8_t client = 0; client < CLIENT_COUNT; client++) {
+        binary_queue[client] = xQueueCreate(BINARY_STREAM_QUEUE_SIZE, sizeof(binary_record_t));
+    }
+    memset(frames, 0, sizeof(frames));
+    binary_stream_reset_stats();
+}
+
+void binary_stream_reset() {
+    for (uint8_t client = 0; client < CLIENT_COUNT; client++) {
+        xQueueReset(binary_queue[client]);  // Markers left in the text input then find no record
+    }
+    memset(unacked, 0, sizeof(unacked));
+#    ifdef ENABLE_LASER_RASTER
+    raster_reset();  // The dropped records held their scanlines
+#    endif
+}
+
+bool binary_stream_feed(uint8_t client, uint8_t data) {
+    binary_frame_t* frame = &frames[client];
+    int64_t         now   = esp_timer_get_time();
+    if (frame->state != FrameState::Idle && (now - frame->last_us) > BINARY_STREAM_TIMEOUT_MS * 1000) {
+        binary_stats.timeouts++;
+        frame->state = FrameState::Idle;
+    }
+    frame->last_us = now;
+    switch (frame->state) {
+        case FrameState::Idle:
+            if (data != BINARY_STX) {
+                return false;
+            }
+            frame->state = FrameState::Length;
+            break;
+        case FrameState::Length:
+            if (data == 0 || data > BINARY_MAX_FRAME) {
+                binary_stats.rejected++;
+                frame->state = FrameState::Idle;
+                break;
+            }
+            frame->len   = data;
+            frame->pos   = 0;
+            frame->crc   = crc16_update(0xFFFF, data);
+            frame->state = FrameState::Body;
+            break;
+        case FrameState::Body:
+            frame->buf[frame->pos++] = data;
+            frame->crc               = crc16_update(frame->crc, data);
+            if (frame->pos == frame->len) {
+                frame->state = FrameState::CrcHigh;
+            }
+            break;
+        case FrameState::CrcHigh:
+            frame->received_crc = uint16_t(data) << 8;
+            frame->state        = FrameState::CrcLow;
+            break;
+        case FrameState::CrcLow:
+            frame->received_crc |= data;
+            frame_done(client, frame);
+            break;
+    }
+    return true;
+}
+
+// Acknowledges the records of client run so far, every BINARY_STREAM_ACK_EVERY and once its queue drains.
+static void send_acks(uint8_t client) {
+    uint32_t free = uxQueueSpacesAvailable(binary_queue[client]);
+    if (unacked[client] && (free == BINARY_STREAM_QUEUE_SIZE || unacked[client] >= BINARY_STREAM_ACK_EVERY)) {
+        char ack[32];
+        snprintf(ack, sizeof(ack), "[BIN:ACK,%u,%u]\r\n", last_seq[client], free);
+        grbl_send(client, ack, OutputClass::Response);  // Lost credits would stall the sender
+        unacked[client] = 0;
+    }
+}
+
+#    ifdef ENABLE_LASER_RASTER
+// Plans a scanline from the current position. Returns false if the motion was aborted.
+static bool execute_raster(binary_record_t* record) {
+    raster_line_t* line = record->raster;
+    if (!laser_mode->get() || spindle->fast_output() == nullptr) {
+        raster_release(line);
+        binary_stats.rejected++;
+        reply("ERR", record->client, record->seq);
+        return true;
+    }
+    float target[MAX_N_AXIS];
+    memcpy(target, gc_state.position, sizeof(target));
+    float length = line->n_pixels * record->pitch;
+    target[line->axis] += bit_istrue(record->flags, BINARY_FLAG_REVERSE) ? -length : length;
+
+    plan_line_data_t plan_data;
+    memset(&plan_data, 0, sizeof(plan_line_data_t));
+    plan_data.feed_rate     = record->feed_rate;
+    plan_data.spindle_speed = gc_state.spindle_speed;
+    plan_data.spindle       = gc_state.modal.spindle;
+    plan_data.coolant       = gc_state.modal.coolant;
+    plan_data.raster        = line;
+#        ifdef USE_LINE_NUMBERS
+    plan_data.line_number = record->seq;
+#        endif
+    gc_state.feed_rate = record->feed_rate;
+    raster_prepare(line, record->power, gc_state.modal.spindle != SpindleState::Disable);
+    mc_line_kins(target, &plan_data, gc_state.position);
+    if (plan_data.raster) {
+        raster_release(line);  // Not planned: check mode or no raster axis steps
+    }
+    if (sys.abort) {
+        return false;
+    }
+    memcpy(gc_state.position, target, sizeof(target));
+    binary_stats.records++;
+    return true;
+}
+#    endif
+
+void binary_stream_execute(uint8_t client) {
+    binary_record_t record;
+    if (xQueueReceive(binary_queue[client], &record, 0) != pdTRUE) {
+        return;  // Dropped by a reset
+    }
+    unacked[client]++;
+    last_seq[client] = record.seq;
+    // Same lockout as text g-code in execute_line().
+    if (sys.state == State::Alarm || sys.state == State::Jog) {
+#    ifdef ENABLE_LASER_RASTER
+        if (record.raster) {
+            raster_release(record.raster);
+        }
+#    endif
+        binary_stats.rejected++;
+        reply("LOCK", client, record.seq);
+        send_acks(client);
+        return;
+    }
+#    ifdef ENABLE_LASER_RASTER
+    if (record.raster) {
+        if (execute_raster(&record)) {
+            send_acks(client);
+        }
+        return;
+    }
+#    endif
+    auto n_axis = number_axis->get();
+    for (uint8_t idx = 0; idx < n_axis; idx++) {
+        if (bit_isfalse(record.axis_mask, bit(idx))) {
+            record.target[idx] = gc_state.position[idx];
+        }
+    }
+    plan_line_data_t plan_data;
+    memset(&plan_data, 0, sizeof(plan_line_data_t));
+    if (bit_istrue(record.flags, BINARY_FLAG_RAPID)) {
+        plan_data.motion.rapidMotion = 1;
+    } else {
+        plan_data.feed_rate = record.feed_rate;
+        gc_state.feed_rate  = record.feed_rate;
+    }
+    if (laser_mode->get()) {
+        gc_state.spindle_speed = record.power;
+    }
+    plan_data.spindle_speed = gc_state.spindle_speed;
+    plan_data.spindle       = gc_state.modal.spindle;
+    plan_data.coolant       = gc_state.modal.coolant;
+#    ifdef USE_LINE_NUMBERS
+    plan_data.line_number = record.seq;
+#    endif
+    mc_line_kins(record.target, &plan_data, gc_state.position);
+    if (sys.abort) {
+        return;
+    }
+    memcpy(gc_state.position, record.target, sizeof(record.target));
+    binary_stats.records++;
+    send_acks(client);
+}
+
+uint8_t binary_stream_window() { return BINARY_STREAM_QUEUE_SIZE; }
+
+const binary_stream_stats_t* binary_stream_get_stats() { return &binary_stats; }
+
+void binary_stream_reset_stats() { memset(&binary_stats, 0, sizeof(binary_stats)); }
+
+#endif
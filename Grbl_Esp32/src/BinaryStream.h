@@ -0,0 +1,101 @@
+#pragma once
+
+/*
+  BinaryStream.h - framed binary motion records for high-rate senders
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Frames can be sent on any client between text lines:
+
+      STX(0x02) LEN TYPE payload[LEN-1] CRC_HI CRC_LO
+
+  LEN counts TYPE and the payload. The CRC is CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) over LEN,
+  TYPE and the payload. Bytes inside a frame are never taken as realtime commands; realtime commands
+  still work between frames. All multi-byte fields are little-endian.
+
+  TYPE 'M' is a motion record:
+
+      seq u16, flags u8, axis_mask u8, feed f32, power f32, then one f32 per bit set in axis_mask
+
+  Targets are absolute machine coordinates in mm, feed is mm/min and power is the S value. Axes not in
+  axis_mask keep their position. Flag bit 0 makes the move a rapid. Power is applied per block like
+  S in laser mode; without laser mode it is ignored and the modal spindle speed is used.
+
+  With ENABLE_LASER_RASTER, TYPE 'R' is a raster record, one laser scanline:
+
+      seq u16, flags u8, axis u8, pitch f32, feed f32, power f32, then one u8 per pixel
+
+  The line starts at the current position and runs pixels * pitch mm along axis at feed mm/min. Flag
+  bit 0 runs it in the negative direction. Pixel value 255 is power, 0 is off. A frame holds up to
+  RASTER_MAX_PIXELS pixels. Raster records share the queue, the sequence numbers and the replies with
+  motion records, and are also answered with [BIN:OVF,<seq>] when no scanline buffer is free. They
+  need a laser spindle and are rejected outside laser mode. See Raster.h.
+
+  Each client's records are queued for the main loop, which hands them straight to the motion planner
+  in the order they arrived between that client's text lines. The queue is the flow control window.
+  Each consumed record returns one credit, reported as [BIN:ACK,<seq>,<free>] every
+  BINARY_STREAM_ACK_EVERY records and whenever the queue drains. A record that cannot be
+  queued is answered with [BIN:OVF,<seq>], a bad frame or record with [BIN:ERR,<seq>] and a record
+  received in alarm or jog state with [BIN:LOCK,<seq>]. Dropped records are not executed.
+*/
+
+#include "Grbl.h"
+
+// Depth of the record queue, which is also the credit window a sender starts with.
+#ifndef BINARY_STREAM_QUEUE_SIZE
+#    define BINARY_STREAM_QUEUE_SIZE 32
+#endif
+
+// Consumed records are acknowledged in groups of this many.
+#ifndef BINARY_STREAM_ACK_EVERY
+#    define BINARY_STREAM_ACK_EVERY 8
+#endif
+
+// A frame that stalls for this long is dropped so a stray STX cannot swallow a text line.
+#ifndef BINARY_STREAM_TIMEOUT_MS
+#    define BINARY_STREAM_TIMEOUT_MS 100
+#endif
+
+const uint8_t BINARY_STX         = 0x02;
+const uint8_t BINARY_TYPE_MOTION = 'M';
+const uint8_t BINARY_TYPE_RASTER = 'R';
+
+// Counters reported by $Binary/Stats.
+typedef struct {
+    uint32_t records;     // Motion and raster records executed
+    uint32_t crc_errors;  // Frames dropped for a bad CRC
+    uint32_t rejected;    // Records dropped for bad contents or a locked state
+    uint32_t overflows;   // Records dropped because the queue was full
+    uint32_t timeouts;    // Partial frames dropped after BINARY_STREAM_TIMEOUT_MS
+} binary_stream_stats_t;
+
+void binary_stream_init();
+
+// Drops queued records. Called on reset.
+void binary_stream_reset();
+
+// Offers one received byte to the client's deframer. Returns true if the byte is part of a frame and
+// must not be processed as text or as a realtime command. Called by the serial task.
+bool binary_stream_feed(uint8_t client, uint8_t data);
+
+// Plans the next queued record of client. Called by the main loop when it reads the STX the serial
+// task left in the client's text input in place of the frame.
+void binary_stream_execute(uint8_t client);
+
+uint8_t                      binary_stream_window();
+const binary_stream_stats_t* binary_stream_get_stats();
+void                         binary_stream_reset_stats();
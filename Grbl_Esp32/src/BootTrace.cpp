@@ -0,0 +1,94 @@
+/*
+  BootTrace.cpp - times the stages of grbl_init() and brings the network up in the background
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+typedef struct {
+    const char* name;
+    int64_t     time_us;  // Since power-on
+} boot_stage_t;
+
+static boot_stage_t  boot_stages[BOOT_TRACE_STAGES];
+static uint8_t       boot_stage_count = 0;
+static int64_t       boot_network_us  = 0;
+static volatile bool network_ready    = false;
+
+void boot_stage(const char* name) {
+    if (boot_stage_count < BOOT_TRACE_STAGES) {
+        boot_stages[boot_stage_count].name    = name;
+        boot_stages[boot_stage_count].time_us = esp_timer_get_time();
+        boot_stage_count++;
+    }
+}
+
+static void boot_network_task(void* pvParameters) {
+#ifdef ENABLE_ETHERNET
+    // First, so the services WiFi starts listen on it too
+    WebUI::eth_config.begin();
+#endif
+#ifdef ENABLE_WIFI
+    WebUI::wifi_config.begin();
+#endif
+#ifdef ENABLE_BLUETOOTH
+    WebUI::bt_config.begin();
+#endif
+    boot_network_us = esp_timer_get_time();
+    network_ready   = true;
+    vTaskDelete(NULL);
+}
+
+void boot_start_network() {
+#if defined(ENABLE_WIFI) || defined(ENABLE_BLUETOOTH)
+    xTaskCreatePinnedToCore(boot_network_task,  // task
+                            "bootNetworkTask",  // name for task
+                            BOOT_NETWORK_TASK_STACK,
+                            NULL,  // parameters
+                            BOOT_NETWORK_TASK_PRIORITY,
+                            NULL,
+                            BOOT_NETWORK_TASK_CORE  // core
+    );
+#else
+    boot_network_us = esp_timer_get_time();
+    network_ready   = true;
+#endif
+}
+
+bool boot_network_ready() {
+    return network_ready;
+}
+
+void boot_report(uint8_t client) {
+    if (boot_stage_count == 0) {
+        return;
+    }
+    char    stages[BOOT_TRACE_STAGES * 20];
+    int     len  = 0;
+    int64_t from = 0;
+    for (uint8_t i = 0; i < boot_stage_count && len < int(sizeof(stages)); i++) {
+        uint32_t ms = uint32_t((boot_stages[i].time_us - from) / 1000);
+        len += snprintf(stages + len, sizeof(stages) - len, i ? " %s:%u" : "%s:%u", boot_stages[i].name, ms);
+        from = boot_stages[i].time_us;
+    }
+    grbl_msg_sendf(client, MsgLevel::Info, "Boot stages ms %s", stages);
+    uint32_t ready_ms = uint32_t(boot_stages[boot_stage_count - 1].time_us / 1000);
+    if (network_ready) {
+        grbl_msg_sendf(client, MsgLevel::Info, "Boot ready at %u ms, network at %u ms", ready_ms, uint32_t(boot_network_us / 1000));
+    } else {
+        grbl_msg_sendf(client, MsgLevel::Info, "Boot ready at %u ms, network starting", ready_ms);
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+/*
+  BootTrace.h - times the stages of grbl_init() and brings the network up in the background
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  grbl_init() marks the end of each of its stages, and $I prints how long each took and when Grbl was
+  ready for motion. Wi-Fi and Bluetooth are started by a task of their own once everything else is
+  set up, so connecting to an access point, which can take many seconds, no longer holds up the main
+  loop. Until they are up, the serial task leaves them alone.
+
+  The device inits themselves stay in sequence: the motors and the spindle share the PWM channel
+  allocation and the I2S output expander, and their messages would interleave.
+*/
+
+#include "Grbl.h"
+
+#ifndef BOOT_TRACE_STAGES
+#    define BOOT_TRACE_STAGES 16
+#endif
+
+// Marks the end of a boot stage. name must be a string literal.
+void boot_stage(const char* name);
+
+// Starts Wi-Fi and Bluetooth in the background.
+void boot_start_network();
+
+// True once Wi-Fi and Bluetooth have been started.
+bool boot_network_ready();
+
+// Prints the boot stages for $I.
+void boot_report(uint8_t client);
@@ -0,0 +1,179 @@
+/*
+  ClientOutput.cpp - queued output to the client transports
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_ASYNC_OUTPUT
+
+#    include <freertos/queue.h>
+
+typedef struct {
+    uint8_t  refs;  // Transports that have not written the message yet
+    uint16_t len;
+    char     text[];
+} output_msg_t;
+
+static QueueHandle_t         output_queue[CLIENT_COUNT];  // NULL for clients that have no transport task
+static client_output_stats_t output_stats[CLIENT_COUNT];
+static bool                  output_stalled[CLIENT_COUNT];  // Dropped normal output and has not caught up
+
+static void release(output_msg_t* msg) {
+    if (__atomic_sub_fetch(&msg->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        free(msg);
+    }
+}
+
+static void clientOutputTask(void* pvParameters) {
+    uint8_t       client = uint32_t(pvParameters);
+    output_msg_t* msg;
+    for (;;) {
+        task_stats_block();
+        BaseType_t received = xQueueReceive(output_queue[client], &msg, portMAX_DELAY);
+        task_stats_unblock();
+        if (received == pdTRUE) {
+            grbl_write(client, msg->text);
+            release(msg);
+        }
+    }
+}
+
+static void start_transport(uint8_t client, const char* name) {
+    output_queue[client] = xQueueCreate(CLIENT_OUTPUT_QUEUE_SIZE, sizeof(output_msg_t*));
+    xTaskCreatePinnedToCore(clientOutputTask,             // task
+                            name,                         // name for task
+                            CLIENT_OUTPUT_TASK_STACK,     // size of task stack
+                            (void*)uint32_t(client),      // parameters
+                            CLIENT_OUTPUT_TASK_PRIORITY,  // priority
+                            NULL,
+                            CLIENT_OUTPUT_TASK_CORE  // core
+    );
+}
+
+void client_output_init() {
+    start_transport(CLIENT_SERIAL, "outSerialTask");
+#    ifdef ENABLE_BLUETOOTH
+    start_transport(CLIENT_BT, "outBTTask");
+#    endif
+#    if defined(ENABLE_WIFI) && defined(ENABLE_HTTP) && defined(ENABLE_SERIAL2SOCKET_OUT)
+    start_transport(CLIENT_WEBUI, "outWebUITask");
+#    endif
+#    if defined(ENABLE_WIFI) && defined(ENABLE_TELNET)
+    start_transport(CLIENT_TELNET, "outTelnetTask");
+#    endif
+#    if defined(ENABLE_WIFI) && defined(ENABLE_UDP_STREAM)
+    start_transport(CLIENT_UDP, "outUdpTask");
+#    endif
+}
+
+const client_output_stats_t* client_output_get_stats(uint8_t client) {
+    return output_queue[client] ? &output_stats[client] : NULL;
+}
+
+void client_output_reset_stats() {
+    memset(output_stats, 0, sizeof(output_stats));
+}
+
+// Queues msg for one transport according to its class. Returns false if it was dropped.
+static bool queue_message(uint8_t transport, output_msg_t* msg, OutputClass output_class) {
+    QueueHandle_t          queue = output_queue[transport];
+    client_output_stats_t* stats = &output_stats[transport];
+    switch (output_class) {
+        case OutputClass::Response:
+            if (!uxQueueSpacesAvailable(queue)) {
+                stats->full++;
+            }
+            xQueueSend(queue, &msg, portMAX_DELAY);
+            break;
+        case OutputClass::Droppable:
+            if (uxQueueSpacesAvailable(queue) <= CLIENT_OUTPUT_RESERVED || xQueueSend(queue, &msg, 0) != pdTRUE) {
+                stats->dropped_status++;
+                return false;
+            }
+            break;
+        default: {
+            // Only the first message to a stalled transport waits, so a long listing cannot add up.
+            int64_t give_up = esp_timer_get_time() + (output_stalled[transport] ? 0 : CLIENT_OUTPUT_WAIT_MS * 1000);
+            while (uxQueueSpacesAvailable(queue) <= CLIENT_OUTPUT_RESERVED) {
+                if (esp_timer_get_time() >= give_up) {
+                    output_stalled[transport] = true;
+                    stats->dropped++;
+                    return false;
+                }
+                vTaskDelay(1);
+            }
+            output_stalled[transport] = false;
+            if (xQueueSend(queue, &msg, 0) != pdTRUE) {
+                stats->dropped++;
+                return false;
+            }
+            break;
+        }
+    }
+    stats->queued++;
+    uint8_t depth = uxQueueMessagesWaiting(queue);
+    if (depth > stats->max_depth) {
+        stats->max_depth = depth;
+    }
+    return true;
+}
+
+static bool wanted(uint8_t client, uint8_t transport) {
+    if (!output_queue[transport] || (client != transport && client != CLIENT_ALL)) {
+        return false;
+    }
+#    ifdef ENABLE_BLUETOOTH
+    // Same check as the synchronous path, so nothing piles up while no one is connected.
+    if (transport == CLIENT_BT && !WebUI::SerialBT.hasClient()) {
+        return false;
+    }
+#    endif
+    return true;
+}
+
+bool client_output_queue(uint8_t client, const char* text, size_t len, OutputClass output_class) {
+    if (!output_queue[CLIENT_SERIAL] || len > UINT16_MAX) {
+        return false;
+    }
+    // Decide the transports once, so the reference count matches the queues the message goes to.
+    uint8_t targets = 0;
+    uint8_t refs    = 0;
+    for (uint8_t transport = 0; transport < CLIENT_COUNT; transport++) {
+        if (wanted(client, transport)) {
+            targets |= bit(transport);
+            refs++;
+        }
+    }
+    if (!refs) {
+        return true;
+    }
+    output_msg_t* msg = (output_msg_t*)malloc(sizeof(output_msg_t) + len + 1);
+    if (!msg) {
+        return false;
+    }
+    msg->refs = refs;
+    msg->len  = len;
+    memcpy(msg->text, text, len + 1);
+    for (uint8_t transport = 0; transport < CLIENT_COUNT; transport++) {
+        if (bit_istrue(targets, bit(transport)) && !queue_message(transport, msg, output_class)) {
+            release(msg);
+        }
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,73 @@
+#pragma once
+
+/*
+  ClientOutput.h - queued output to the client transports
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  With ENABLE_ASYNC_OUTPUT, grbl_send() copies each message once into a reference counted buffer
+  and queues a pointer to it for every transport it goes to. Each transport has its own task that
+  writes its queue out and drops its reference, so a slow link only holds up its own queue.
+  Messages to one transport stay in order.
+
+  Queues are bounded and a message that finds its queue full is handled by its OutputClass, so the
+  main loop is never held up for long by a stalled link. The last CLIENT_OUTPUT_RESERVED slots are
+  kept for responses, which are never dropped: ok and error replies, alarms, listings such as $$,
+  delta status reports and flow control credits. Droppable messages such as full status reports need
+  more room than that and are dropped at once without it. Other messages, which the host can afford
+  to lose, wait up to CLIENT_OUTPUT_WAIT_MS for room and are then dropped. Drops are counted per
+  transport.
+*/
+
+#include "Grbl.h"
+
+// Messages each transport can have waiting.
+#ifndef CLIENT_OUTPUT_QUEUE_SIZE
+#    define CLIENT_OUTPUT_QUEUE_SIZE 32
+#endif
+
+// Queue slots only ok and error responses may use.
+#ifndef CLIENT_OUTPUT_RESERVED
+#    define CLIENT_OUTPUT_RESERVED 8
+#endif
+
+// How long a normal message waits for room before it is dropped.
+#ifndef CLIENT_OUTPUT_WAIT_MS
+#    define CLIENT_OUTPUT_WAIT_MS 20
+#endif
+
+static_assert(CLIENT_OUTPUT_RESERVED < CLIENT_OUTPUT_QUEUE_SIZE, "CLIENT_OUTPUT_RESERVED must leave room for other output");
+
+// Per transport counters reported by $Output/Stats.
+typedef struct {
+    uint32_t queued;
+    uint32_t dropped_status;  // Droppable messages dropped
+    uint32_t dropped;         // Normal messages dropped after waiting
+    uint32_t full;            // Responses that found the queue full and had to wait
+    uint8_t  max_depth;       // Most messages seen waiting
+} client_output_stats_t;
+
+// Starts the transport tasks. Output before this is written synchronously.
+void client_output_init();
+
+// Returns NULL for a client without a transport task.
+const client_output_stats_t* client_output_get_stats(uint8_t client);
+void                         client_output_reset_stats();
+
+// Queues text for client, or for every transport with CLIENT_ALL. Returns false if the text was not
+// queued, in which case the caller should write it synchronously.
+bool client_output_queue(uint8_t client, const char* text, size_t len, OutputClass output_class);
@@ -57,7 +57,17 @@ Some features should not be changed. See notes below.
 #define ENABLE_CONTROL_SW_DEBOUNCE     // Default disabled. Uncomment to enable.
 #define CONTROL_SW_DEBOUNCE_PERIOD 32  // in milliseconds default 32 microseconds
 
+// Acts on a control pin in its interrupt, on the first edge that is still there after a glitch filter of
+// a few microseconds, instead of reading it again CONTROL_SW_DEBOUNCE_PERIOD later. The bounces after it
+// are ignored, as an edge only counts after the pin has been quiet for a lockout time. Reset, feed hold
+// and the safety door use CONTROL_SW_SAFETY_GLITCH_US and CONTROL_SW_SAFETY_LOCKOUT_MS, cycle start and
+// the macro buttons the longer CONTROL_SW_CONVENIENCE_GLITCH_US and CONTROL_SW_CONVENIENCE_LOCKOUT_MS.
+// Replaces ENABLE_CONTROL_SW_DEBOUNCE. ENABLE_REALTIME_TRACE times the pins from the edge, either way.
+// #define CONTROL_SW_FAST_PATH // Default disabled. Uncomment to enable.
+// #define CONTROL_SW_SAFETY_GLITCH_US 2 // Uncomment to override default in system.h.
+
 #define USE_RMT_STEPS
+// #define USE_MCPWM_STEPS // Default disabled. Uncomment to enable. Replaces USE_RMT_STEPS, see below.
 
 // Include the file that loads the machine-specific config file.
 // machine.h must be edited to choose the desired file.
@@ -71,6 +81,14 @@ Some features should not be changed. See notes below.
 #    ifdef USE_RMT_STEPS
 #        undef USE_RMT_STEPS
 #    endif
+#    ifdef USE_MCPWM_STEPS
+#        undef USE_MCPWM_STEPS
+#    endif
+#endif
+#ifdef USE_MCPWM_STEPS
+#    ifdef USE_RMT_STEPS
+#        undef USE_RMT_STEPS
+#    endif
 #endif
 
 const int MAX_N_AXIS = 6;
@@ -92,6 +110,20 @@ const int MAX_N_AXIS = 6;
 // serial monitor, sender, etc uses a different value than 115200
 #define BAUD_RATE 115200
 
+// Runs the serial port on the ESP-IDF UART driver instead of HardwareSerial. Input lands in a ring of
+// UART_RX_BUFFER_SIZE bytes that serialCheckTask reads in bulk, and the driver's event queue wakes the
+// task as soon as data arrives instead of at the next SERIAL_POLL_MS. Together with a larger BAUD_RATE,
+// up to 2000000, a USB serial host can stream as fast as the planner takes it.
+// #define USE_UART_DRIVER // Default disabled. Uncomment to enable.
+// #define UART_RX_BUFFER_SIZE 8192 // Uncomment to override default in Serial.h
+
+// With USE_UART_DRIVER, RTS/CTS hardware flow control on UART_RTS_PIN and UART_CTS_PIN. The UART
+// raises RTS when its FIFO is nearly full, so the host pauses instead of overrunning it, and holds its
+// own output while CTS is high. The bridge must wire both lines; most USB boards do not.
+// #define UART_FLOW_CONTROL // Default disabled. Uncomment to enable.
+// #define UART_RTS_PIN GPIO_NUM_19
+// #define UART_CTS_PIN GPIO_NUM_22
+
 //Connect to your local AP with these credentials
 //#define CONNECT_TO_SSID  "your SSID"
 //#define SSID_PASSWORD  "your SSID password"
@@ -102,6 +134,13 @@ const int MAX_N_AXIS = 6;
 
 #define ENABLE_WIFI  //enable wifi
 
+// Wired Ethernet through the EMAC of the ESP32 and an RMII PHY, a LAN8720 unless the machine file
+// defines the ETH_PHY_* and ETH_CLK_MODE values of <ETH.h>. Telnet, the web server and the
+// websocket listen on it as well as on WiFi, with their usual clients, and keep running when the
+// radio is off. The link is not shared with anything else, so the latency of a stream does not
+// depend on the radio. Requires ENABLE_WIFI for the services.
+// #define ENABLE_ETHERNET // Default disabled. Uncomment to enable.
+
 #if defined(ENABLE_WIFI) || defined(ENABLE_BLUETOOTH)
 #    define WIFI_OR_BLUETOOTH
 #endif
@@ -117,6 +156,27 @@ const int MAX_N_AXIS = 6;
 #define ENABLE_SERIAL2SOCKET_IN
 #define ENABLE_SERIAL2SOCKET_OUT
 
+// Adds a client that streams over UDP on $UDP/Port, with sequenced data packets, a receive window
+// and selective acknowledgements, and realtime commands and status reports outside the sequence.
+// A lost packet does not hold the ones behind it the way it does on telnet. See WebUI/UdpStream.h
+// for the protocol. $UDP/Enable turns it on.
+// #define ENABLE_UDP_STREAM // Default disabled. Uncomment to enable.
+
+// Starts the cycle at the same moment on several controllers on one network. $Sync/Arm holds the
+// cycle start while a program is loaded, and $Sync/Start=<ms> on one of them schedules the start
+// there and, over UDP, on all the others, with their clocks matched to its own. See WebUI/NetworkSync.h.
+// #define ENABLE_NETWORK_SYNC // Default disabled. Uncomment to enable.
+
+// Lets a websocket connection subscribe, with POS:<hz>, to binary frames of machine position and feed
+// samples taken up to 100 times a second, for drawing the toolpath live without polling '?'. The
+// samples are taken and sent by the web server task, not the protocol loop. See WebUI/WebServer.cpp.
+// #define ENABLE_POSITION_STREAM // Default disabled. Uncomment to enable.
+
+// Writes firmware updates from /updatefw to flash in a background task, so the web server keeps
+// serving during an update, and accepts images compressed with gzip, which are inflated on the way.
+// Sending firmware.bin.gz instead of firmware.bin cuts the upload to about a third. See WebUI/OtaWriter.h.
+// #define ENABLE_OTA_STREAM // Default disabled. Uncomment to enable.
+
 // Captive portal is used when WiFi is in access point mode.  It lets the
 // WebUI come up automatically in the browser, instead of requiring the user
 // to browse manually to a default URL.  It works like airport and hotel
@@ -131,6 +191,14 @@ const int MAX_N_AXIS = 6;
 //#define ENABLE_AUTHENTICATION
 //CONFIGURE_EYECATCH_END (DO NOT MODIFY THIS LINE)
 
+#ifndef USE_UART_DRIVER
+#    undef UART_FLOW_CONTROL
+#endif
+
+#ifdef CONTROL_SW_FAST_PATH
+#    undef ENABLE_CONTROL_SW_DEBOUNCE
+#endif
+
 #ifdef ENABLE_AUTHENTICATION
 const char* const DEFAULT_ADMIN_PWD   = "admin";
 const char* const DEFAULT_USER_PWD    = "user";
@@ -153,6 +221,11 @@ const int DEFAULT_RADIO_MODE = ESP_WIFI_AP;
 #    endif  //CONNECT_TO_SSID
 #else
 #    undef ENABLE_NOTIFICATIONS
+#    undef ENABLE_ETHERNET
+#    undef ENABLE_UDP_STREAM
+#    undef ENABLE_NETWORK_SYNC
+#    undef ENABLE_POSITION_STREAM
+#    undef ENABLE_OTA_STREAM
 #    ifdef ENABLE_BLUETOOTH
 const int DEFAULT_RADIO_MODE = ESP_BT;
 #    else
@@ -207,10 +280,16 @@ const uint8_t CMD_COOLANT_MIST_OVR_TOGGLE  = 0xA1;
 // mainly a safety feature to remind the user to home, since position is unknown to Grbl.
 #define HOMING_INIT_LOCK  // Comment to disable
 
+// Keeps the machine position in RTC memory while it can be trusted, so after a restart of the CPU by a
+// watchdog, a panic or [ESP444]RESTART the machine is ready without homing again. Requires $1=255 and
+// stepper drivers that stay enabled while the CPU restarts. See WarmRestart.h.
+// #define ENABLE_WARM_RESTART // Default disabled. Uncomment to enable.
+
 // Number of homing cycles performed after when the machine initially jogs to limit switches.
-// This help in preventing overshoot and should improve repeatability. This value should be one or
-// greater.
-static const uint8_t NHomingLocateCycle = 1;  // Integer (1-128)
+// This help in preventing overshoot and should improve repeatability. The limit switch interrupt
+// latches the step position at the switch edge and homing corrects for the overshoot, so on pins
+// with interrupts 0 gives a single pass at the seek rate.
+static const uint8_t NHomingLocateCycle = 1;  // Integer (0-128)
 
 // Enables single axis homing commands. $HX, $HY, and $HZ for X, Y, and Z-axis homing. The full homing
 // cycle is still invoked by the $H command. This is disabled by default. It's here only to address
@@ -218,6 +297,18 @@ static const uint8_t NHomingLocateCycle = 1;  // Integer (1-128)
 // If you have a two-axis machine, DON'T USE THIS. Instead, just alter the homing cycle for two-axes.
 #define HOMING_SINGLE_AXIS_COMMANDS  // Default disabled. Uncomment to enable.
 
+// Squares the axes in $Homing/Squared in the homing cycle itself instead of in three cycles, one with
+// both motors and one per motor. During every approach each motor of a squared axis stops at its own
+// switch while the other keeps going, so the gantry is square when both have stopped. Every squared
+// axis needs a switch per motor. The distance between the two switch edges is reported after homing.
+// #define HOMING_PARALLEL_SQUARING // Default disabled. Uncomment to enable.
+
+// Adds $<axis>/Home/Seek and $<axis>/Home/Feed so that every axis homes at its own rate. The axes of
+// a cycle still move together, but each one covers its own search distance (from its own max travel)
+// at its own rate and pulls off on its own, so a slow Z can share a cycle with fast X and Y axes.
+// A rate of 0 uses $Homing/Seek or $Homing/Feed. CoreXY machines keep the shared rate and distance.
+// #define HOMING_PER_AXIS_RATES // Default disabled. Uncomment to enable.
+
 // Number of blocks Grbl executes upon startup. These blocks are stored in EEPROM, where the size
 // and addresses are defined in settings.h. With the current settings, up to 2 startup blocks may
 // be stored and executed in order. These startup blocks would typically be used to set the g-code
@@ -266,11 +357,18 @@ static const uint8_t NHomingLocateCycle = 1;  // Integer (1-128)
 const double SAFETY_DOOR_SPINDLE_DELAY = 4.0;  // Float (seconds)
 const double SAFETY_DOOR_COOLANT_DELAY = 1.0;  // Float (seconds)
 
-// Enable CoreXY kinematics. Use ONLY with CoreXY machines.
-// NOTE: This configuration option alters the motion of the X and Y axes to principle of operation
-// defined at (http://corexy.com/theory.html). Motors are assumed to positioned and wired exactly as
+// Restores the spindle and coolant at the start of a safety door resume, before the restore motion to the
+// pull-out position, and then waits only for what is left of the two delays, together instead of one after
+// the other. A spindle with speed feedback ends its delay as soon as it is within $Spindle/AtSpeed/Tolerance.
+// The plunge back to the resume position still waits for both.
+// #define SAFETY_DOOR_OVERLAP_RESTORE // Default disabled. Uncomment to enable.
+
+// Make CoreXY kinematics the default of $Kinematics/Type. The type is a setting, so one firmware
+// image runs Cartesian, CoreXY and H-bot machines; this only picks the value after a settings reset.
+// NOTE: CoreXY alters the motion of the X and Y axes to principle of operation defined at
+// (http://corexy.com/theory.html). Motors are assumed to positioned and wired exactly as
 // described, if not, motions may move in strange directions. Grbl requires the CoreXY A and B motors
-// have the same steps per mm internally.
+// have the same steps per mm internally. Re-home after changing $Kinematics/Type.
 // #define COREXY // Default disabled. Uncomment to enable.
 
 // Inverts select limit pin states based on the following mask. This effects all limit pin functions,
@@ -326,6 +424,14 @@ const int MIN_SPINDLE_SPEED_OVERRIDE        = 10;   // Percent of programmed spi
 const int SPINDLE_OVERRIDE_COARSE_INCREMENT = 10;   // (1-99). Usually 10%.
 const int SPINDLE_OVERRIDE_FINE_INCREMENT   = 1;    // (1-99). Usually 1%.
 
+// Queues the realtime override commands instead of setting bits in a flag byte. A burst of the same
+// command, like the steps of a pendant encoder, then counts every step, in the order received, rather
+// than collapsing into one. The queue is lock free, so serial, WebUI and pin handlers on either core
+// can all feed it. If it is full, commands fall back to the flag bits. Feed hold, cycle start, reset
+// and the other state commands keep their flags, since repeating them has no further effect.
+// #define REALTIME_EVENT_QUEUE // Default disabled. Uncomment to enable.
+// #define REALTIME_EVENT_QUEUE_SIZE 32 // Uncomment to override default in system.h.
+
 // When a M2 or M30 program end command is executed, most g-code states are restored to their defaults.
 // This compile-time option includes the restoring of the feed, rapid, and spindle speed override values
 // to their default values at program end.
@@ -418,6 +524,88 @@ const int TOOL_LENGTH_OFFSET_AXIS = Z_AXIS;  // Default z-axis. Valid values are
 // received, including not only GCode lines, but also $ and [ESP commands.
 //#define REPORT_ECHO_RAW_LINE_RECEIVED // Default disabled. Uncomment to enable.
 
+// Accepts framed binary motion records on every client alongside text g-code. Records carry the target,
+// feed, laser power and flags, are CRC checked, and go straight to the planner without the g-code parser.
+// Senders are paced by the acknowledgements instead of character counting. See BinaryStream.h for the
+// frame format.
+// #define ENABLE_BINARY_STREAM // Default disabled. Uncomment to enable.
+
+// Adds raster records to the binary stream. A record is one laser scanline of 8-bit power values with a
+// pixel pitch and direction. It is planned as a single block and the step generator sets the power of
+// each pixel, so engraving a photo does not go through the g-code parser line by line. Requires
+// ENABLE_BINARY_STREAM and a laser spindle. See Raster.h.
+// #define ENABLE_LASER_RASTER // Default disabled. Uncomment to enable.
+
+// Counts a spindle encoder with a pulse counter and adds G33 spindle synchronized motion, for threading
+// and rigid tapping at full speed. The machine definition sets the encoder pins and counts per revolution.
+// See SpindleSync.h.
+// #define ENABLE_SPINDLE_SYNC // Default disabled. Uncomment to enable.
+
+// Counts quadrature encoders on the axes with pulse counters and compares them with the machine position
+// while the machine moves, so lost steps raise ALARM:11 instead of ruining the part. AXIS_ENCODER_CORRECTION
+// also has the step ISR put the missing steps out. The machine definition sets the encoder pins and counts
+// per mm. See AxisEncoder.h.
+// #define ENABLE_AXIS_ENCODERS // Default disabled. Uncomment to enable.
+// #define AXIS_ENCODER_CORRECTION // Default disabled. Uncomment to enable.
+// #define AXIS_ENCODER_MAX_ERROR 0.5 // Uncomment to override default in AxisEncoder.h.
+
+// Runs one axis, A unless AUX_STREAM_AXIS says otherwise, from its own queue, planner and segment stream
+// that share the step ISR with the other axes, so a conveyor or rotary table on it changes speed without
+// slowing the tool path down. Not with RMT_STEP_BURST, USE_MCPWM_STEPS, USE_KINEMATICS or
+// JOG_VELOCITY_MODE. See AuxStream.h.
+// #define ENABLE_AUX_STREAM // Default disabled. Uncomment to enable.
+// #define AUX_STREAM_AXIS A_AXIS // Uncomment to override default in AuxStream.h.
+
+// Adds $Probe/Scan, which records the machine position at every contact and release of the probe while
+// ordinary moves go on, and streams the points to the client, for digitizing a surface without a G38
+// cycle per point. Requires PROBE_PIN. See ProbeScan.h.
+// #define ENABLE_PROBE_SCAN // Default disabled. Uncomment to enable.
+
+// Measures how long each Grbl task runs and waits, and reports it with the stack high-water mark, priority
+// and core of the task in $Tasks/Stats and the WebUI /tasks page. Costs about a microsecond per wait.
+// See TaskStats.h.
+// #define ENABLE_TASK_STATS // Default disabled. Uncomment to enable.
+
+// Reports the memory the planner, segment, client and WebUI buffers take, with the free heap, its
+// largest free block and the least free heap since the reset, in $Memory/Stats. WebUI requests that
+// push the heap to a new low are logged with their URI. See MemoryStats.h.
+// #define ENABLE_MEMORY_STATS // Default disabled. Uncomment to enable.
+
+// Times feed hold, cycle start, reset and jog cancel at each hop from their arrival to their effect, for a
+// feed hold up to the planning of the deceleration, and keeps histograms of the latencies. $Realtime/Trace
+// reports them and $Realtime/Trace=0 clears them. See RealtimeTrace.h.
+// #define ENABLE_REALTIME_TRACE // Default disabled. Uncomment to enable.
+
+// Records the receive buffer, planner and segment buffer levels, the feed rate and the segment underruns
+// every TIMELINE_SAMPLE_MS, keeping the last TIMELINE_SAMPLES samples. $Timeline/Dump and the WebUI
+// /timeline.csv page send them as CSV. Uses 24 bytes per sample. See Timeline.h.
+// #define ENABLE_TIMELINE // Default disabled. Uncomment to enable.
+
+// Serves counters for fleet monitoring at the WebUI /metrics page, in the Prometheus text format:
+// parser lines, planner blocks, segments, segment underruns, bytes received and output dropped per
+// client, heap, task CPU and Wi-Fi reconnects. $Metrics sends the same lines. See Metrics.h.
+// #define ENABLE_METRICS // Default disabled. Uncomment to enable.
+
+// Sends a performance summary when an SD job is done: lines/s, blocks planned, planner fill, segment
+// underruns, time in feed hold, realized against programmed feed rate and parser and planner CPU time.
+// Each summary is also appended to JOB_STATS_LOG on the card with the file name and the firmware
+// version. See JobStats.h.
+// #define ENABLE_JOB_STATS // Default disabled. Uncomment to enable.
+
+// Queues output for each client transport and writes it from a task per transport, so a slow serial,
+// Bluetooth, telnet or websocket link does not hold up the main loop. See ClientOutput.h.
+// #define ENABLE_ASYNC_OUTPUT // Default disabled. Uncomment to enable.
+
+// Messages sent from motion, spindle and stepper code with grbl_msg_deferf() are stored with their
+// format and arguments in a ring and formatted and sent later by a low priority task, so the caller
+// does not wait for vsnprintf() or the output. Without it they are sent at once. See DeferredMsg.h.
+// #define ENABLE_DEFERRED_MSG // Default disabled. Uncomment to enable.
+
+// Lowers the CPU clock to IDLE_POWER_CPU_MHZ and lets the main loop wait instead of polling once the
+// machine has stood idle with the stepper drivers released for IDLE_POWER_DELAY_MS. Input on any
+// client brings the clock back up before the line is parsed. See IdlePower.h.
+// #define ENABLE_IDLE_POWER_SAVE // Default disabled. Uncomment to enable.
+
 // Minimum planner junction speed. Sets the default minimum junction speed the planner plans to at
 // every buffer block junction, except for starting from rest and end of the buffer, which are always
 // zero. This value controls how fast the machine moves through junctions with no regard for acceleration
@@ -438,6 +626,10 @@ const double MINIMUM_FEED_RATE = 1.0;  // (mm/min)
 // bogged down by too many trig calculations.
 const int N_ARC_CORRECTION = 12;  // Integer (1-255)
 
+// mc_arc() generates arc segments in batches of up to this many, bounded by the free planner blocks,
+// and plans each batch with a single recalculation pass rather than one per segment.
+const int ARC_BATCH_SIZE = 16;  // Integer (1-255)
+
 // The arc G2/3 g-code standard is problematic by definition. Radius-based arcs have horrible numerical
 // errors when arc at semi-circles(pi) or full-circles(2*pi). Offset-based arcs are much more accurate
 // but still have a problem when arcs are full-circles (2*pi). This define accounts for the floating
@@ -463,6 +655,22 @@ const int DWELL_TIME_STEP = 50;  // Integer (1-255) (milliseconds)
 // While this is experimental, it is intended to be the future default method after testing
 //#define USE_RMT_STEPS
 
+// With RMT steps, lets the RMT channels generate runs of up to RMT_BURST_MAX_STEPS steps on their own,
+// so the step ISR wakes once per run instead of once per step. Used where every moving axis of a block
+// steps on every ISR tick, i.e. single axis moves and exact diagonals, outside of AMASS, which covers
+// cruising at high step rates. Not while probing or homing. The machine position counts a run when it
+// starts, so it can lead the motors by one run, about 1.3 ms at 50kHz. $Stepper/Stats counts the runs.
+// #define RMT_STEP_BURST // Default disabled. Uncomment to enable.
+// #define RMT_BURST_MAX_STEPS 63 // Uncomment to override default in Stepper.h.
+
+// Generates the step pulses with the ESP32's MCPWM peripherals instead of the RMT, one timer per axis,
+// enabled near the top of this file. Runs of steps are handled as with RMT_STEP_BURST, except that the
+// timers repeat the pulse at the step period on their own, so a run can last a whole segment and a
+// rotary or conveyor axis can step at a few hundred kHz with two ISR wakes per segment. The ISR stops
+// a run in its last period. If it is too late for that, the extra steps are counted in the machine
+// position and by $Stepper/Stats. Runs need a step period of at most 3.2 ms, about 305 Hz.
+// #define MCPWM_BURST_MAX_STEPS 4096 // Uncomment to override default in Stepper.h.
+
 // Creates a delay between the direction pin setting and corresponding step pulse by creating
 // another interrupt (Timer2 compare) to manage it. The main Grbl interrupt (Timer1 compare)
 // sets the direction pins, and does not immediately set the stepper pins, as it would in
@@ -480,7 +688,83 @@ const int DWELL_TIME_STEP = 50;  // Integer (1-255) (milliseconds)
 // available RAM, like when re-compiling for a Mega2560. Or decrease if the Arduino begins to
 // crash due to the lack of available RAM or if the CPU is having trouble keeping up with planning
 // new incoming motions as they are executed.
+// ESP32 Note: Dense 3D surfacing and raster jobs with sub-millimeter segments benefit from a much
+// deeper planner, e.g. 64 to 256 blocks. Each block is roughly 90 bytes. On WROVER boards the buffer
+// can be placed in PSRAM with PLANNER_USE_PSRAM (the board must be built with -DBOARD_HAS_PSRAM).
+// If no PSRAM is found at startup, the buffer is allocated from internal RAM instead.
+// PLANNER_RECALC_LIMIT bounds how many blocks are replanned when a new block is added.
 // #define BLOCK_BUFFER_SIZE 16 // Uncomment to override default in planner.h.
+// #define PLANNER_USE_PSRAM // Default disabled. Uncomment to enable.
+// #define PLANNER_RECALC_LIMIT 32 // Uncomment to override default in planner.h.
+
+// Stops the planner's reverse pass at the first block whose entry speed does not change when a new
+// block is appended, instead of walking all the way back to the last optimally planned block. Keeps the
+// cost of adding a block roughly constant with deep planner buffers. See $Planner/Stats.
+#define PLANNER_INCREMENTAL_RECALC  // Default enabled. Comment to disable.
+
+// Applies a feed or rapid override change to the executing block at once and replans the rest of the
+// buffer only after the override has stopped changing for PLANNER_OVERRIDE_SETTLE_MS. A pendant encoder
+// sending many override steps then costs one replan instead of one per step. Until the replan, blocks
+// keep their old speeds. The segment generator slows down to the new speed in each block it loads.
+// #define PLANNER_LAZY_OVERRIDES // Default disabled. Uncomment to enable.
+// #define PLANNER_OVERRIDE_SETTLE_MS 100 // Uncomment to override default in planner.h.
+
+// Merges a straight move into the block before it when the joint stays within PLANNER_MERGE_TOLERANCE
+// (mm) of the merged line and turns by less than PLANNER_MERGE_MAX_ANGLE (degrees), as in the runs of
+// tiny, nearly colinear segments CAM output has on 3D surfaces. Each merged move saves a block, a
+// junction and a replan, so the planner looks further ahead with the same memory. Only blocks the
+// stepper has not started on are merged. The moves merged are counted by $Planner/Stats.
+// #define PLANNER_MERGE_LINES // Default disabled. Uncomment to enable.
+// #define PLANNER_MERGE_TOLERANCE 0.002 // Uncomment to override default in planner.h.
+// #define PLANNER_MERGE_MAX_ANGLE 5.0 // Uncomment to override default in planner.h.
+
+// Runs st_prep_buffer() in its own high priority task pinned to the other core than the g-code parser.
+// The stepper interrupt wakes the task when the segment buffer drains to STEPPER_PREP_WATERMARK segments,
+// half of SEGMENT_BUFFER_SIZE by default, so slow g-code lines, WebUI requests or SD card reads cannot
+// starve segment preparation. Segment buffer underruns are counted either way and shown by $I.
+// #define USE_STEPPER_PREP_TASK // Default disabled. Uncomment to enable.
+// #define STEPPER_PREP_WATERMARK (SEGMENT_BUFFER_SIZE / 2) // Uncomment to override default in stepper.h.
+
+// Splits motion between the cores. The g-code parser queues each line motion, arcs segments included,
+// in a ring of MOTION_PIPELINE_SIZE moves and goes on to the next line, while a motion task on the
+// segment prep core plans them. Jogs, parking, homing and spindle synchronized moves are still planned
+// by the parser after the queue drains. Requires USE_STEPPER_PREP_TASK.
+// #define MOTION_PIPELINE // Default disabled. Uncomment to enable.
+// #define MOTION_PIPELINE_SIZE 16 // Uncomment to override default in motioncontrol.h.
+
+// Runs the motion tasks, segment prep, motion pipeline, serial, SD reads and the RS485 bus, on the core
+// of the protocol loop, and the network, notification and output tasks on the other core with Wi-Fi
+// and Bluetooth. The segment prep task then shares its core with the parser and preempts it. The core,
+// priority and stack of each task can also be set one by one. See TaskConfig.h.
+// #define ISOLATE_MOTION_CORE // Default disabled. Uncomment to enable.
+// #define STEPPER_PREP_TASK_PRIORITY 20 // Uncomment to override default in TaskConfig.h
+
+// Measures the CPU cycles spent in every step timer interrupt. $Stepper/Stats reports the minimum,
+// average, worst case and a histogram, overall, by the work done (plain step, new segment, new block)
+// and by AMASS level, and the largest part of a timer period one interrupt used. $Stepper/Stats=0
+// clears them. Costs some tens of cycles per interrupt.
+// #define ENABLE_STEPPER_ISR_PROFILING // Default disabled. Uncomment to enable.
+
+// Links the functions of the motion pipeline marked MOTION_IRAM, from mc_line() and the planner to the
+// segment prep and the PWM spindle, into IRAM, so they do not stall on flash cache misses while Wi-Fi
+// is busy. Uses IRAM other options may need. See HotPath.h.
+// #define MOTION_IRAM_PLACEMENT // Default disabled. Uncomment to enable.
+
+// Counts the calls, CPU cycles and flash cache misses of the motion pipeline functions. $Profile/Cache
+// reports them, $Profile/Cache=0 clears them. Needs the perfmon component of ESP-IDF. See HotPath.h.
+// #define ENABLE_CACHE_PROFILING // Default disabled. Uncomment to enable.
+
+// Records the time of each step pulse during a short move. $Steps/Capture=<n> arms a capture of the
+// next n step events, $Steps/Capture reports the jitter against the planned step timing, and
+// $Steps/Capture/Segments and $Steps/Capture/Events send the planned against the achieved feed rate of
+// each segment and the raw events as CSV. Keeps the events in internal RAM, 16 bytes each.
+// #define ENABLE_STEP_CAPTURE // Default disabled. Uncomment to enable.
+
+// $SD/Simulate=<file> runs a file from the SD card through the parser, planner and segment prep without
+// moving, with the current settings and overrides, then reports the planned cycle time, the average feed
+// rate, the time spent below the nominal feed rate and how much of it the planner depth costs, and the
+// CPU cycles per line and per segment. The files in src/tests serve as benchmarks. Needs ENABLE_SD_CARD.
+// #define ENABLE_SIMULATOR // Default disabled. Uncomment to enable.
 
 // Governs the size of the intermediary step segment buffer between the step execution algorithm
 // and the planner blocks. Each segment is set of steps executed at a constant velocity over a
@@ -488,8 +772,153 @@ const int DWELL_TIME_STEP = 50;  // Integer (1-255) (milliseconds)
 // block velocity profile is traced exactly. The size of this buffer governs how much step
 // execution lead time there is for other Grbl processes have to compute and do their thing
 // before having to come back and refill this buffer, currently at ~50msec of step moves.
+// ESP32 Note: At very high step rates, e.g. I2S machines stepping at 100kHz or more, 6 segments only
+// hold a few milliseconds of motion. Up to 255 segments are supported; each costs about 40 bytes.
 // #define SEGMENT_BUFFER_SIZE 6 // Uncomment to override default in stepper.h.
 
+// I2S machines queue their step samples in DMA buffers, which is motion that can no longer be changed,
+// about 12 ms with the default 5 buffers of 2000 bytes. Feed holds, probes and limits act that much late.
+// I2S_OUT_LOW_LATENCY uses 4 buffers of 256 bytes, about 1.3 ms, at the cost of 8 times as many refills.
+// I2S_OUT_ISR_REFILL fills the buffers in the DMA interrupt instead of a task, which saves a task switch
+// per refill and keeps the refill from waiting behind other tasks. I2S_PROBE_TRUNCATE drops the samples
+// the DMA has not played yet when the probe hits and stops the motion there, the probe position being
+// where the motors stopped. $I2S/Stats reports the latency and the CPU time the refills take.
+// #define I2S_OUT_LOW_LATENCY // Default disabled. Uncomment to enable.
+// #define I2S_OUT_ISR_REFILL // Default disabled. Uncomment to enable.
+// #define I2S_PROBE_TRUNCATE // Default disabled. Uncomment to enable.
+// #define I2S_OUT_DMABUF_COUNT 5 // Uncomment to override default in I2SOut.h.
+// #define I2S_OUT_DMABUF_LEN 2000 // Uncomment to override default in I2SOut.h.
+
+// Machines that define USE_I2S_IN read up to 32 more inputs, I2SI(0) to I2SI(31), from a chain of
+// 74HC165 shift registers clocked by the I2S1 peripheral on I2S_IN_WS (SH/LD), I2S_IN_BCK (CLK) and
+// I2S_IN_DATA (QH). The hardware samples them every 32 us into DMA buffers without any CPU time, and a
+// change calls the pin's attachInterrupt() handler from the buffer's interrupt, so limit, probe and
+// control pins work there as on GPIOs. A change is handled within I2S_IN_LATENCY_US, the sample period
+// plus the time of one buffer, 288 us with the default 8 samples per buffer. $I2SIn/Stats reports it.
+// #define I2S_IN_DMABUF_SAMPLES 8 // Uncomment to override default in I2SIn.h.
+
+// Lengthens step segments while cruising at constant speed, up to SEGMENT_CRUISE_MULTIPLIER times the
+// normal segment time. Acceleration and deceleration ramps keep the normal segment time, so the velocity
+// profile is traced just as closely, but the stepper ISR loads and prep work per second drop during
+// long cruises. Feed holds may take up to that many segment times longer to begin decelerating.
+// #define ADAPTIVE_SEGMENT_TIMING // Default disabled. Uncomment to enable.
+// #define SEGMENT_CRUISE_MULTIPLIER 4 // Uncomment to override default in stepper.h.
+
+// Shapes the acceleration and deceleration ramps of the segment generator into jerk-limited S-curves,
+// limited by the $<axis>/Jerk settings in mm/sec^3. Each ramp keeps the distance, the duration and the
+// entry and exit speeds the planner gave it, so junction speeds stay as planned and $12x becomes the
+// average acceleration of a ramp. The acceleration rises and falls at the jerk limit and holds in
+// between, peaking above $12x; ramps too short for the jerk limit peak at twice $12x with a higher
+// jerk. A ramp the planner replans while it runs restarts its S-curve from the current speed. Feed
+// override decelerations stay linear. A jerk of 0 leaves the axis unlimited, blocks moving only such
+// axes keep linear ramps.
+// #define JERK_LIMITED_PROFILE // Default disabled. Uncomment to enable.
+
+// Shapes the commanded motion of each axis with a ZV or ZVD input shaper in the segment prep, which
+// cancels the ringing of the axis at the frequency set by $<axis>/Shaper/Frequency, so acceleration
+// and feed can be raised without losing surface quality. Every stop is held for the shaper duration,
+// up to one period of the resonance. $Shaper/Test=<axis> writes a test file to the SD card to find the
+// frequency without an accelerometer. See InputShaper.h.
+// #define INPUT_SHAPING // Default disabled. Uncomment to enable.
+
+// Takes up the backlash of lead screws and gear trains when an axis reverses. $<axis>/Backlash sets the
+// play in mm. The step ISR adds the extra steps to the first block in the new direction, on the ticks the
+// axis does not step anyway and at most at BACKLASH_RATE_PERCENT of its max rate, so the motion does not
+// slow down for them and the planner never sees them. They are not counted in the machine position.
+// Homing only keeps track of the directions. On CoreXY machines the X and Y settings apply to the A and
+// B motors.
+// #define BACKLASH_COMPENSATION // Default disabled. Uncomment to enable.
+// #define BACKLASH_RATE_PERCENT 25 // Uncomment to override default in stepper.h.
+
+// Adds the G64 P<tolerance> path blending mode. Between two G0 or G1 moves the parser holds back the
+// corner and replaces it with a short curve that stays within the tolerance, so the machine keeps its
+// speed through the corner instead of slowing down to the junction deviation limit. G64 without P
+// uses $11 as the tolerance, G61 goes back to exact path. See PathBlending.h.
+// #define PATH_BLENDING // Default disabled. Uncomment to enable.
+
+// Compensates Z for uneven stock, as for PCB milling or engraving, from a grid probed by
+// $HeightMap/Probe=<x0>,<y0>,<x1>,<y1>,<nx>,<ny>[,<depth>[,<feed>]]. Moves are split only where the
+// interpolated surface bends away from a straight line by more than HEIGHT_MAP_TOLERANCE mm. See
+// HeightMap.h.
+// #define ENABLE_HEIGHT_MAP // Default disabled. Uncomment to enable.
+// #define HEIGHT_MAP_MAX_POINTS 256 // Uncomment to override default in heightmap.h.
+// #define HEIGHT_MAP_TOLERANCE 0.005 // Uncomment to override default in heightmap.h.
+
+// Adds the canned drilling cycles G81 (drill), G82 (drill and dwell P seconds), G83 (peck drill, out of
+// the hole after every Q) and G73 (chip break, backs off CANNED_CYCLE_PECK_CLEARANCE after every Q), with
+// G98/G99 to retract to the start height or the R plane, and L repeats in G91. The parser plans all moves
+// of a hole, so a drilling program needs one short line per hole. Holes are drilled along the axis normal
+// to the G17/G18/G19 plane. R, Q, P and the depth carry over to the following lines until G80.
+// #define CANNED_CYCLES // Default disabled. Uncomment to enable.
+// #define CANNED_CYCLE_PECK_CLEARANCE 0.254 // Uncomment to override default in motioncontrol.h.
+
+// Adds numbered parameters #1..#OCODE_PARAMETERS, [expressions] in place of numbers, and O-word subs,
+// loops and conditionals in SD jobs (O100 sub/endsub/call, while/endwhile, do/while, repeat/endrepeat,
+// if/elseif/else/endif, break, continue). Loops and calls seek within the file, so a short program can
+// run a long job without streaming. Requires ENABLE_SD_CARD. See OCode.h.
+// #define ENABLE_O_CODES // Default disabled. Uncomment to enable.
+// #define OCODE_PARAMETERS 100 // Uncomment to override default in ocode.h.
+
+// Adds a queue of SD jobs run back to back. $SD/Queue=P=<path> [W=1] appends a job, and starts it when
+// no job is running; W=1 holds before the job until cycle start, as M0 does. $SD/Queue lists the queue
+// and $SD/Queue/Clear empties it. The next file is opened as soon as the last line of the previous one
+// is read, so the planner does not run dry between jobs. An error or a reset clears the queue.
+// #define SD_JOB_QUEUE // Default disabled. Uncomment to enable.
+// #define SD_JOB_QUEUE_SIZE 8 // Uncomment to override default in sdcard.h.
+
+// Records a streamed job to the SD card for running it again from the card. $SD/Capture=<path> starts
+// writing every g-code line the sending client streams after it, once it has executed without error, and
+// $SD/Capture from the same client closes the file. The lines are stored as the parser collapsed them,
+// without spaces or comments, through the same background writer as web uploads, so the stream does not
+// wait for the card. $ commands are not recorded. The card is busy while capturing. Requires
+// ENABLE_SD_CARD. See SDCard.h.
+// #define SD_CAPTURE // Default disabled. Uncomment to enable.
+
+// Saves a checkpoint of the running SD job to NVS every SD_CHECKPOINT_INTERVAL_MS: the line the steppers
+// are on, its offset in the file, and the modal state and position before it. After a power loss, home
+// the machine and send $SD/Recover to restore the modal state, spindle and coolant, move to the start of
+// that line and go on with the job. The checkpoint is dropped when the job finishes. Jobs resumed inside
+// O-word loops or subs, and G92 or tool length offsets, are not recovered.
+// #define SD_CHECKPOINT // Default disabled. Uncomment to enable.
+// #define SD_CHECKPOINT_INTERVAL_MS 5000 // Uncomment to override default in sdcard.h.
+
+// Uses LittleFS instead of SPIFFS for the local file system on the internal flash, which opens and
+// seeks much faster once it holds more than a few files. The partition has to be formatted again,
+// with $LocalFS/Format, when switching. $LocalFS/Job=<path> runs a local file through the SD job
+// runner, with the same read-ahead, whichever file system is used. See LocalFS.h.
+// #define USE_LITTLEFS // Default disabled. Uncomment to enable.
+
+// Adds $Macros/Macro0..3, each holding lines separated by &, and $Macros/Run=<n>. The G-code lines are
+// split into words when the setting changes, so a macro only executes them. With this enabled, the
+// MACRO_BUTTON_<n>_PIN inputs run the stored macros instead of calling user_defined_macro(). See Macros.h.
+// #define ENABLE_MACROS // Default disabled. Uncomment to enable.
+
+// Adds $JV=<axis words> F<speed>, a velocity jog for pendants and joysticks. The axis words give the
+// direction and F the speed along it in mm/min. The segment prep steps the jog directly, without planner
+// blocks, and keeps only JOG_VELOCITY_SEGMENTS queued, so a new velocity or a jog cancel reaches the
+// motors within that many segments. Repeat the line within JOG_VELOCITY_KEEPALIVE_MS to keep moving,
+// otherwise the jog decelerates to a stop. $JV= without axis words or with F0 stops it. Soft limits stop
+// the jog in time. Not available on CoreXY machines.
+// #define JOG_VELOCITY_MODE // Default disabled. Uncomment to enable.
+// #define JOG_VELOCITY_SEGMENTS 3 // Uncomment to override default in stepper.h.
+// #define JOG_VELOCITY_KEEPALIVE_MS 250 // Uncomment to override default in jog.h.
+
+// Switches the synchronized user outputs, M62, M63 and M67, at the start of the next move instead of
+// draining the planner first, so the motion does not stop for them. The events ride on the planner block
+// of that move and the step ISR sets the outputs when it starts the block. Events with no move after
+// them switch once the motion is done, as at program end or a dwell. Up to SYNC_OUTPUT_EVENTS events
+// can wait at a time, more make the parser wait for the motion.
+// #define SYNC_USER_OUTPUTS // Default disabled. Uncomment to enable.
+// #define SYNC_OUTPUT_EVENTS 16 // Uncomment to override default in system.h.
+
+// Lets M3, M4, M5, S words and coolant changes take effect at the start of the next move instead of
+// draining the planner first, when they come while the machine is moving. The state rides on the planner
+// block of that move and the step ISR switches the spindle and coolant when it starts the block. Only
+// spindles that can switch from the ISR take part, the PWM based ones. A change that must wait for a
+// spin-up or spin-down delay, or for a speed feedback, still drains the planner. A change with no move
+// after it applies once the motion is done.
+// #define SPINDLE_STATE_IN_PLANNER // Default disabled. Uncomment to enable.
+
 // Line buffer size from the serial input stream to be executed. Also, governs the size of
 // each of the startup blocks, as they are each stored as a string of this size. Make sure
 // to account for the available EEPROM at the defined memory address in settings.h and for
@@ -510,14 +939,30 @@ const int DWELL_TIME_STEP = 50;  // Integer (1-255) (milliseconds)
 // 115200 baud will take 5 msec to transmit a typical 55 character report. Worst case reports are
 // around 90-100 characters. As long as the serial TX buffer doesn't get continually maxed, Grbl
 // will continue operating efficiently. Size the TX buffer around the size of a worst-case report.
-// #define RX_BUFFER_SIZE 128 // (1-254) Uncomment to override defaults in serial.h
+// The telnet and WebUI clients have their own, deeper receive buffers. All sizes must be powers of 2.
+// #define RX_BUFFER_SIZE 128 // (16-32768) Uncomment to override defaults in serial.h
+// #define RX_BUFFER_SIZE_TELNET 1024 // (16-32768)
+// #define RX_BUFFER_SIZE_WEBUI 1024 // (16-32768)
+// Each telnet connection also has a receive buffer of its own, ahead of the telnet client buffer.
+// #define TELNET_RX_BUFFER_SIZE 2048 // (16-32768) Uncomment to override default in TelnetServer.h
+// #define TELNET_MAX_CLIENTS 1
+// The WebUI builds its responses in a pool of fixed buffers instead of the heap. See ResponsePool.h.
+// #define RESPONSE_POOL_BUFFERS 2 // Uncomment to override default in ResponsePool.h
+// #define RESPONSE_POOL_BUFFER_SIZE 1200
 // #define TX_BUFFER_SIZE 100 // (1-254)
 
-// A simple software debouncing feature for hard limit switches. When enabled, the limit
-// switch interrupt unblock a waiting task which will recheck the limit switch pins after
-// a short delay. Default disabled
+// The VFD spindle, Dynamixel servos and any other RS485 devices share one bus on UART 2, served by one
+// task. Each device queues its requests without waiting; the bus sends them back to back. See Rs485Bus.h.
+// #define RS485_BUS_QUEUE_SIZE 8 // Uncomment to override default in Rs485Bus.h
+// #define RS485_BUS_TASK_PRIORITY 1 // Uncomment to override default in TaskConfig.h
+
+// A simple software debouncing feature for hard limit switches. When enabled, every limit switch
+// edge restarts a LIMIT_DEBOUNCE_US timer, and the hard limit alarm is raised when it expires with a
+// switch still triggered, i.e. as soon as the pins have been stable that long. Edges stop putting the
+// check off LIMIT_DEBOUNCE_MAX_US after the first one, so a chattering switch still raises it. Default disabled
 //#define ENABLE_SOFTWARE_DEBOUNCE // Default disabled. Uncomment to enable.
-const int DEBOUNCE_PERIOD = 32;  // in milliseconds default 32 microseconds
+#define LIMIT_DEBOUNCE_US 2000  // in microseconds
+// #define LIMIT_DEBOUNCE_MAX_US 8000 // Uncomment to override default in Limits.h
 
 // Configures the position after a probing cycle during Grbl's check mode. Disabled sets
 // the position to the probe target, when enabled sets the position to the start position.
@@ -565,6 +1010,15 @@ const int DEBOUNCE_PERIOD = 32;  // in milliseconds default 32 microseconds
 // Default is off to limit support issues...you can enable here or in your machine definition file
 // #define SHOW_EXTENDED_SETTINGS
 
+// Keeps the stored values of all numeric settings in one checksummed NVS blob as well, so the boot
+// loads them with a single NVS read instead of one lookup per setting. Every setting is still written
+// to its own key, and the blob is rewritten whenever settings are committed. A missing or corrupt blob,
+// or one written by a firmware with other settings, is ignored: the settings are loaded key by key and
+// the blob is rebuilt. Settings changed by a firmware without this option do not update the blob, so
+// after going back to such a firmware and changing settings there, erase the blob with $NVX or a
+// settings restore. The settings stage of the boot timings in $I shows the difference.
+// #define SETTINGS_NVS_BLOB // Default disabled. Uncomment to enable.
+
 // Enable the '$I=(string)' build info write command. If disabled, any existing build info data must
 // be placed into EEPROM via external means with a valid checksum value. This macro option is useful
 // to prevent this data from being over-written by a user, when used to store OEM product data.
@@ -587,6 +1041,15 @@ const int DEBOUNCE_PERIOD = 32;  // in milliseconds default 32 microseconds
 // job. At this time, this option only forces a planner buffer sync with these g-code commands.
 #define FORCE_BUFFER_SYNC_DURING_EEPROM_WRITE  // Default enabled. Comment to disable.
 
+// Keeps the coordinate systems and G28/G30 positions set by G10 L2/L20, G28.1 and G30.1 in RAM and
+// writes them to NVS later, all changed ones in one commit. The write waits until Grbl is idle or in
+// alarm and no coordinates changed for COORDINATES_WRITE_DELAY_MS, so a probing macro that sets
+// offsets over and over neither stalls for flash writes nor wears the flash. $Coordinates/Save writes
+// them right away. Coordinates changed less than the delay before a power loss are lost. The buffer
+// sync above is not needed then, and is skipped.
+// #define COORDINATES_DEFERRED_WRITE // Default disabled. Uncomment to enable.
+// #define COORDINATES_WRITE_DELAY_MS 2000 // Uncomment to override default in settings.h.
+
 // In Grbl v0.9 and prior, there is an old outstanding bug where the `WPos:` work position reported
 // may not correlate to what is executing, because `WPos:` is based on the g-code parser state, which
 // can be several motions behind. This option forces the planner buffer to empty, sync, and stop
@@ -602,6 +1065,14 @@ const int DEBOUNCE_PERIOD = 32;  // in milliseconds default 32 microseconds
 // repeatable. If needed, you can disable this behavior by uncommenting the define below.
 // #define ALLOW_FEED_OVERRIDE_DURING_PROBE_CYCLES // Default disabled. Uncomment to enable.
 
+// Runs G38.2 and G38.3 as a two stage probe in firmware. The programmed move seeks the contact at the
+// programmed feed, then the probe backs off along its path by $Probe/Retract mm at the rapid rate and
+// approaches again, no further than $Probe/Retract past the first contact, at $Probe/SlowFeed mm/min.
+// The position latched by the slow approach is the result, reported once, so a tool setter needs one
+// line and one buffer sync instead of three. $Probe/SlowFeed=0 or a seek no faster than it probes in one
+// stage. G38.4 and G38.5 always probe in one stage.
+// #define PROBE_TWO_STAGE // Default disabled. Uncomment to enable.
+
 // Enables and configures parking motion methods upon a safety door state. Primarily for OEMs
 // that desire this feature for their integrated machines. At the moment, Grbl assumes that
 // the parking motion only involves one axis, although the parking implementation was written
@@ -637,9 +1108,22 @@ const double PARKING_PULLOUT_INCREMENT = 5.0;    // Spindle pull-out and plunge
 // to ensure the laser doesn't inadvertently remain powered while at a stop and cause a fire.
 #define DISABLE_LASER_DURING_HOLD  // Default enabled. Comment to disable.
 
-// Enables a piecewise linear model of the spindle PWM/speed output. Requires a solution by the
-// 'fit_nonlinear_spindle.py' script in the /doc/script folder of the repo. See file comments
-// on how to gather spindle data and run the script to generate a solution.
+// In laser mode (M4) the power follows the speed. Without this option it is set once per step
+// segment, from the speed at the segment end. With it the step ISR ramps the PWM duty linearly over
+// every step of the segment, so power tracks the speed through acceleration and deceleration. Only
+// spindles whose output the ISR writes directly (lasers) are ramped.
+// #define LASER_POWER_RAMP // Default disabled. Uncomment to enable.
+
+// Adds $Laser/PPI, which fires the laser as pulses of a fixed width at a fixed spacing along the tool path,
+// whatever the speed, for cutting thin material. The step generator places the pulses and an RMT channel
+// times them on LASER_PPI_PIN, set by the machine definition. See LaserPPI.h.
+// #define ENABLE_LASER_PPI // Default disabled. Uncomment to enable.
+
+// Limits a PWM spindle to the RPM_MIN and RPM_MAX of a piecewise linear model of its PWM/speed
+// output, instead of $Spindle/MinRPM and MaxRPM. The pieces between them are the rpm:percent points
+// of $Spindle/PWM/Curve, which PWM spindles interpolate into a lookup table whenever a setting changes.
+// The 'fit_nonlinear_spindle.py' script in the /doc/script folder of the repo fits a model to
+// measured spindle data. See file comments on how to gather the data and run the script.
 // #define ENABLE_PIECEWISE_LINEAR_SPINDLE  // Default disabled. Uncomment to enable.
 
 // N_PIECES, RPM_MAX, RPM_MIN, RPM_POINTxx, and RPM_LINE_XX constants are all set and given by
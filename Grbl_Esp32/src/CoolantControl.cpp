@@ -62,14 +62,15 @@ CoolantState coolant_get_state() {
 }
 
 static inline void coolant_write(CoolantState state) {
-    bool pinState;
+    bool     pinState;
+    PinBatch batch;
 
 #ifdef COOLANT_FLOOD_PIN
     pinState = state.Flood;
 #    ifdef INVERT_COOLANT_FLOOD_PIN
     pinState = !pinState;
 #    endif
-    digitalWrite(COOLANT_FLOOD_PIN, pinState);
+    batch.write(COOLANT_FLOOD_PIN, pinState);
 #endif
 
 #ifdef COOLANT_MIST_PIN
@@ -77,8 +78,9 @@ static inline void coolant_write(CoolantState state) {
 #    ifdef INVERT_COOLANT_MIST_PIN
     pinState = !pinState;
 #    endif
-    digitalWrite(COOLANT_MIST_PIN, pinState);
+    batch.write(COOLANT_MIST_PIN, pinState);
 #endif
+    batch.commit();
 }
 
 // Directly called by coolant_init(), coolant_set_state(), and mc_reset(), which can be at
@@ -101,6 +103,11 @@ void coolant_set_state(CoolantState state) {
     sys.report_ovr_counter = 0;  // Set to report change immediately
 }
 
+void coolant_set_state_isr(CoolantState state) {
+    coolant_write(state);
+    sys.report_ovr_counter = 0;
+}
+
 void coolant_off() {
     CoolantState disable = {};
     coolant_set_state(disable);
@@ -36,5 +36,8 @@ void coolant_stop();
 void coolant_off();
 void coolant_set_state(CoolantState state);
 
+// Sets the coolant pins from the step ISR, when a block with a new state starts.
+void coolant_set_state_isr(CoolantState state);
+
 // G-code parser entry-point for setting coolant states. Checks for and executes additional conditions.
 void coolant_sync(CoolantState state);
@@ -42,6 +42,10 @@
 #    define DEFAULT_STEP_PULSE_MICROSECONDS 3  // $0
 #endif
 
+#ifndef DEFAULT_DIRECTION_DELAY_MICROSECONDS
+#    define DEFAULT_DIRECTION_DELAY_MICROSECONDS 0  // Direction setup time before the first step after a change
+#endif
+
 #ifndef DEFAULT_STEPPER_IDLE_LOCK_TIME
 #    define DEFAULT_STEPPER_IDLE_LOCK_TIME 250  // $1 msec (0-254, 255 keeps steppers enabled)
 #endif
@@ -66,6 +70,14 @@
 #    define DEFAULT_INVERT_PROBE_PIN 0  // $6 boolean
 #endif
 
+#ifndef DEFAULT_PROBE_SLOW_FEED
+#    define DEFAULT_PROBE_SLOW_FEED 25.0  // mm/min, 0 probes in one stage
+#endif
+
+#ifndef DEFAULT_PROBE_RETRACT
+#    define DEFAULT_PROBE_RETRACT 1.0  // mm
+#endif
+
 #ifndef DEFAULT_STATUS_REPORT_MASK
 #    define DEFAULT_STATUS_REPORT_MASK 1  // $10
 #endif
@@ -78,6 +90,18 @@
 #    define DEFAULT_ARC_TOLERANCE 0.002  // $12 mm
 #endif
 
+#ifndef DEFAULT_KINEMATICS_TOLERANCE
+#    define DEFAULT_KINEMATICS_TOLERANCE 0.01  // mm, 0 disables adaptive segments
+#endif
+
+#ifndef DEFAULT_KINEMATICS_TYPE
+#    ifdef COREXY
+#        define DEFAULT_KINEMATICS_TYPE KinematicsType::CoreXY
+#    else
+#        define DEFAULT_KINEMATICS_TYPE KinematicsType::Cartesian
+#    endif
+#endif
+
 #ifndef DEFAULT_REPORT_INCHES
 #    define DEFAULT_REPORT_INCHES 0  // $13 false
 #endif
@@ -159,6 +183,12 @@
 #    define DEFAULT_SPINDLE_DELAY_SPINDOWN 0
 #endif
 
+// Percent of the target RPM. Spindles with speed feedback end the delays above once within it. 0 always
+// waits the full delay.
+#ifndef DEFAULT_SPINDLE_AT_SPEED_TOLERANCE
+#    define DEFAULT_SPINDLE_AT_SPEED_TOLERANCE 5.0
+#endif
+
 #ifndef DEFAULT_INVERT_SPINDLE_OUTPUT_PIN
 #    define DEFAULT_INVERT_SPINDLE_OUTPUT_PIN 0
 #endif
@@ -171,6 +201,10 @@
 #    define DEFAULT_SPINDLE_ENABLE_OFF_WITH_ZERO_SPEED 0
 #endif
 
+#ifndef DEFAULT_SPINDLE_PWM_CURVE
+#    define DEFAULT_SPINDLE_PWM_CURVE ""  // rpm:percent calibration points, none is linear
+#endif
+
 // ================  user settings =====================
 #ifndef DEFAULT_USER_INT_80
 #    define DEFAULT_USER_INT_80 0  // $80 User integer setting
@@ -276,6 +310,91 @@
 #    define DEFAULT_C_ACCELERATION 200.0
 #endif
 
+// ============== Axis Jerk =========
+#define SEC_PER_MIN_CU (60.0 * 60.0 * 60.0)  // Seconds Per Minute Cubed, for jerk conversion
+// Default jerks are expressed in mm/sec^3. Used with JERK_LIMITED_PROFILE, 0 is unlimited.
+#ifndef DEFAULT_X_JERK
+#    define DEFAULT_X_JERK 0.0
+#endif
+#ifndef DEFAULT_Y_JERK
+#    define DEFAULT_Y_JERK 0.0
+#endif
+#ifndef DEFAULT_Z_JERK
+#    define DEFAULT_Z_JERK 0.0
+#endif
+#ifndef DEFAULT_A_JERK
+#    define DEFAULT_A_JERK 0.0
+#endif
+#ifndef DEFAULT_B_JERK
+#    define DEFAULT_B_JERK 0.0
+#endif
+#ifndef DEFAULT_C_JERK
+#    define DEFAULT_C_JERK 0.0
+#endif
+
+// ============== Input Shaping =========
+// Used with INPUT_SHAPING. A frequency of 0 leaves the axis unshaped.
+#ifndef DEFAULT_SHAPER_TYPE
+#    define DEFAULT_SHAPER_TYPE ShaperType::ZV
+#endif
+#ifndef DEFAULT_X_SHAPER_FREQUENCY
+#    define DEFAULT_X_SHAPER_FREQUENCY 0.0  // Hz
+#endif
+#ifndef DEFAULT_Y_SHAPER_FREQUENCY
+#    define DEFAULT_Y_SHAPER_FREQUENCY 0.0  // Hz
+#endif
+#ifndef DEFAULT_Z_SHAPER_FREQUENCY
+#    define DEFAULT_Z_SHAPER_FREQUENCY 0.0  // Hz
+#endif
+#ifndef DEFAULT_A_SHAPER_FREQUENCY
+#    define DEFAULT_A_SHAPER_FREQUENCY 0.0  // Hz
+#endif
+#ifndef DEFAULT_B_SHAPER_FREQUENCY
+#    define DEFAULT_B_SHAPER_FREQUENCY 0.0  // Hz
+#endif
+#ifndef DEFAULT_C_SHAPER_FREQUENCY
+#    define DEFAULT_C_SHAPER_FREQUENCY 0.0  // Hz
+#endif
+#ifndef DEFAULT_X_SHAPER_DAMPING
+#    define DEFAULT_X_SHAPER_DAMPING 0.1  // Damping ratio
+#endif
+#ifndef DEFAULT_Y_SHAPER_DAMPING
+#    define DEFAULT_Y_SHAPER_DAMPING 0.1  // Damping ratio
+#endif
+#ifndef DEFAULT_Z_SHAPER_DAMPING
+#    define DEFAULT_Z_SHAPER_DAMPING 0.1  // Damping ratio
+#endif
+#ifndef DEFAULT_A_SHAPER_DAMPING
+#    define DEFAULT_A_SHAPER_DAMPING 0.1  // Damping ratio
+#endif
+#ifndef DEFAULT_B_SHAPER_DAMPING
+#    define DEFAULT_B_SHAPER_DAMPING 0.1  // Damping ratio
+#endif
+#ifndef DEFAULT_C_SHAPER_DAMPING
+#    define DEFAULT_C_SHAPER_DAMPING 0.1  // Damping ratio
+#endif
+
+// ============== Backlash =========
+// Used with BACKLASH_COMPENSATION
+#ifndef DEFAULT_X_BACKLASH
+#    define DEFAULT_X_BACKLASH 0.0  // mm
+#endif
+#ifndef DEFAULT_Y_BACKLASH
+#    define DEFAULT_Y_BACKLASH 0.0  // mm
+#endif
+#ifndef DEFAULT_Z_BACKLASH
+#    define DEFAULT_Z_BACKLASH 0.0  // mm
+#endif
+#ifndef DEFAULT_A_BACKLASH
+#    define DEFAULT_A_BACKLASH 0.0  // mm
+#endif
+#ifndef DEFAULT_B_BACKLASH
+#    define DEFAULT_B_BACKLASH 0.0  // mm
+#endif
+#ifndef DEFAULT_C_BACKLASH
+#    define DEFAULT_C_BACKLASH 0.0  // mm
+#endif
+
 // ========= AXIS MAX TRAVEL ============
 
 #ifndef DEFAULT_X_MAX_TRAVEL
@@ -316,6 +435,44 @@
 #    define DEFAULT_C_HOMING_MPOS 0.0
 #endif
 
+// Homing rates of each axis in mm/min, used with HOMING_PER_AXIS_RATES. 0 takes $Homing/Seek and $Homing/Feed.
+#ifndef DEFAULT_X_HOMING_SEEK_RATE
+#    define DEFAULT_X_HOMING_SEEK_RATE 0.0
+#endif
+#ifndef DEFAULT_Y_HOMING_SEEK_RATE
+#    define DEFAULT_Y_HOMING_SEEK_RATE 0.0
+#endif
+#ifndef DEFAULT_Z_HOMING_SEEK_RATE
+#    define DEFAULT_Z_HOMING_SEEK_RATE 0.0
+#endif
+#ifndef DEFAULT_A_HOMING_SEEK_RATE
+#    define DEFAULT_A_HOMING_SEEK_RATE 0.0
+#endif
+#ifndef DEFAULT_B_HOMING_SEEK_RATE
+#    define DEFAULT_B_HOMING_SEEK_RATE 0.0
+#endif
+#ifndef DEFAULT_C_HOMING_SEEK_RATE
+#    define DEFAULT_C_HOMING_SEEK_RATE 0.0
+#endif
+#ifndef DEFAULT_X_HOMING_FEED_RATE
+#    define DEFAULT_X_HOMING_FEED_RATE 0.0
+#endif
+#ifndef DEFAULT_Y_HOMING_FEED_RATE
+#    define DEFAULT_Y_HOMING_FEED_RATE 0.0
+#endif
+#ifndef DEFAULT_Z_HOMING_FEED_RATE
+#    define DEFAULT_Z_HOMING_FEED_RATE 0.0
+#endif
+#ifndef DEFAULT_A_HOMING_FEED_RATE
+#    define DEFAULT_A_HOMING_FEED_RATE 0.0
+#endif
+#ifndef DEFAULT_B_HOMING_FEED_RATE
+#    define DEFAULT_B_HOMING_FEED_RATE 0.0
+#endif
+#ifndef DEFAULT_C_HOMING_FEED_RATE
+#    define DEFAULT_C_HOMING_FEED_RATE 0.0
+#endif
+
 // ========== Motor current (SPI Drivers ) =============
 #ifndef DEFAULT_X_CURRENT
 #    define DEFAULT_X_CURRENT 0.25  // $140 current in amps (extended set)
@@ -527,6 +684,13 @@
 #    define SERVO_TIMER_INTERVAL 75.0  // Hz This is the update inveral in milliseconds
 #endif
 
+// Servos are commanded where the queued step segments will have taken the axis this many
+// milliseconds from now, so they move towards the next update instead of trailing the last one.
+// 0 commands the current position.
+#ifndef SERVO_LOOKAHEAD_MS
+#    define SERVO_LOOKAHEAD_MS SERVO_TIMER_INTERVAL
+#endif
+
 #ifndef DYNAMIXEL_TXD
 #    define DYNAMIXEL_TXD UNDEFINED_PIN
 #endif
@@ -0,0 +1,333 @@
+/*
+  DeferredMsg.cpp - messages formatted and sent after the caller has moved on
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_DEFERRED_MSG
+
+#    include <atomic>
+
+enum class ArgType : uint8_t {
+    None,  // %% or a conversion this does not know, which takes no argument
+    Int,
+    LongLong,
+    Double,
+    String,
+    Pointer,
+};
+
+// One conversion of a format, from its % to its conversion character
+typedef struct {
+    ArgType type;
+    uint8_t stars;   // * widths and precisions, each an int argument ahead of the value
+    uint8_t length;  // Characters of the conversion
+} conversion_t;
+
+// A slot is free for the writer of message n when its seq is n, and holds message n for the task
+// when it is n + 1.
+typedef struct {
+    std::atomic<uint32_t> seq;
+    const char*           format;
+    uint8_t               client;
+    uint8_t               arg_bytes;
+    uint8_t               args[DEFERRED_MSG_ARG_BYTES];  // Packed in the order of the format
+} deferred_msg_t;
+
+static deferred_msg_t        msg_ring[DEFERRED_MSG_QUEUE_SIZE];
+static std::atomic<uint32_t> msg_head(0);  // Next message to be written
+static uint32_t              msg_tail = 0;  // Next message to be sent, only used by the task
+static std::atomic<uint32_t> msg_dropped(0);
+static bool                  msg_started = false;
+
+static conversion_t parse_conversion(const char* s) {
+    conversion_t conv  = { ArgType::None, 0, 0 };
+    const char*  p     = s + 1;
+    uint8_t      longs = 0;
+    while (*p && strchr("-+ #0123456789.*", *p)) {
+        if (*p == '*') {
+            conv.stars++;
+        }
+        p++;
+    }
+    while (*p && strchr("hlLqjzt", *p)) {
+        if (*p == 'l') {
+            longs++;
+        }
+        p++;
+    }
+    switch (*p) {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+        case 'c':
+            conv.type = longs >= 2 ? ArgType::LongLong : ArgType::Int;
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            conv.type = ArgType::Double;
+            break;
+        case 's':
+            conv.type = ArgType::String;
+            break;
+        case 'p':
+            conv.type = ArgType::Pointer;
+            break;
+    }
+    if (*p) {
+        p++;
+    }
+    conv.length = p - s;
+    return conv;
+}
+
+static bool pack(uint8_t* args, uint8_t& used, const void* value, size_t size) {
+    if (used + size > DEFERRED_MSG_ARG_BYTES) {
+        return false;
+    }
+    memcpy(args + used, value, size);
+    used += size;
+    return true;
+}
+
+// Packs the arguments the format asks for. False if they do not fit.
+static bool pack_args(const char* format, va_list arg, uint8_t* args, uint8_t& used) {
+    used = 0;
+    for (const char* s = strchr(format, '%'); s; s = strchr(s, '%')) {
+        conversion_t conv = parse_conversion(s);
+        s += conv.length;
+        for (int i = 0; i < conv.stars; i++) {
+            int star = va_arg(arg, int);
+            if (!pack(args, used, &star, sizeof(star))) {
+                return false;
+            }
+        }
+        bool fits = true;
+        switch (conv.type) {
+            case ArgType::None:
+                break;
+            case ArgType::Int: {
+                int value = va_arg(arg, int);
+                fits      = pack(args, used, &value, sizeof(value));
+                break;
+            }
+            case ArgType::LongLong: {
+                long long value = va_arg(arg, long long);
+                fits            = pack(args, used, &value, sizeof(value));
+                break;
+            }
+            case ArgType::Double: {
+                double value = va_arg(arg, double);
+                fits         = pack(args, used, &value, sizeof(value));
+                break;
+            }
+            case ArgType::Pointer: {
+                void* value = va_arg(arg, void*);
+                fits        = pack(args, used, &value, sizeof(value));
+                break;
+            }
+            case ArgType::String: {
+                const char* value = va_arg(arg, const char*);
+                if (value == nullptr) {
+                    value = "(null)";
+                }
+                fits = pack(args, used, value, strlen(value) + 1);
+                break;
+            }
+        }
+        if (!fits) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+static T unpack(const uint8_t* args, uint8_t& used) {
+    T value;
+    memcpy(&value, args + used, sizeof(value));
+    used += sizeof(value);
+    return value;
+}
+
+template <typename T>
+static int format_one(char* out, size_t size, const char* spec, const int* stars, uint8_t n_stars, T value) {
+    switch (n_stars) {
+        case 0:
+            return snprintf(out, size, spec, value);
+        case 1:
+            return snprintf(out, size, spec, stars[0], value);
+        default:
+            return snprintf(out, size, spec, stars[0], stars[1], value);
+    }
+}
+
+// Formats a message from its packed arguments, one conversion at a time
+static void format_msg(const deferred_msg_t& msg, char* out, size_t size) {
+    size_t  len  = 0;
+    uint8_t used = 0;
+    for (const char* s = msg.format; *s && len < size - 1;) {
+        if (*s != '%') {
+            out[len++] = *s++;
+            continue;
+        }
+        conversion_t conv = parse_conversion(s);
+        char         spec[16];
+        if (conv.length >= sizeof(spec) || conv.stars > 2) {
+            break;
+        }
+        memcpy(spec, s, conv.length);
+        spec[conv.length] = '\0';
+        s += conv.length;
+
+        int stars[2];
+        for (int i = 0; i < conv.stars; i++) {
+            stars[i] = unpack<int>(msg.args, used);
+        }
+        int n = 0;
+        switch (conv.type) {
+            case ArgType::None:
+                n = conv.length == 2 && spec[1] == '%' ? snprintf(out + len, size - len, "%%") : 0;
+                break;
+            case ArgType::Int:
+                n = format_one(out + len, size - len, spec, stars, conv.stars, unpack<int>(msg.args, used));
+                break;
+            case ArgType::LongLong:
+                n = format_one(out + len, size - len, spec, stars, conv.stars, unpack<long long>(msg.args, used));
+                break;
+            case ArgType::Double:
+                n = format_one(out + len, size - len, spec, stars, conv.stars, unpack<double>(msg.args, used));
+                break;
+            case ArgType::Pointer:
+                n = format_one(out + len, size - len, spec, stars, conv.stars, unpack<void*>(msg.args, used));
+                break;
+            case ArgType::String: {
+                const char* value = (const char*)(msg.args + used);
+                used += strlen(value) + 1;
+                n = format_one(out + len, size - len, spec, stars, conv.stars, value);
+                break;
+            }
+        }
+        if (n > 0) {
+            len = len + n < size - 1 ? len + n : size - 1;
+        }
+    }
+    out[len] = '\0';
+}
+
+static void deferredMsgTask(void* pvParameters) {
+    char text[128];
+    for (;;) {
+        task_stats_block();
+        vTaskDelay(DEFERRED_MSG_PERIOD_MS / portTICK_PERIOD_MS);
+        task_stats_unblock();
+        for (;;) {
+            deferred_msg_t& msg = msg_ring[msg_tail & (DEFERRED_MSG_QUEUE_SIZE - 1)];
+            if (msg.seq.load(std::memory_order_acquire) != msg_tail + 1) {
+                break;
+            }
+            bool empty = msg.format[0] == '\0';
+            if (!empty) {
+                format_msg(msg, text, sizeof(text));
+            }
+            uint8_t client = msg.client;
+            msg.seq.store(msg_tail + DEFERRED_MSG_QUEUE_SIZE, std::memory_order_release);
+            msg_tail++;
+            if (!empty) {
+                grbl_sendf(client, "[MSG:%s]\r\n", text);
+            }
+        }
+        uint32_t dropped = msg_dropped.exchange(0);
+        if (dropped) {
+            grbl_sendf(CLIENT_ALL, "[MSG:%d messages dropped]\r\n", dropped);
+        }
+    }
+}
+
+void deferred_msg_init() {
+    for (uint32_t i = 0; i < DEFERRED_MSG_QUEUE_SIZE; i++) {
+        msg_ring[i].seq.store(i, std::memory_order_relaxed);
+    }
+    xTaskCreatePinnedToCore(deferredMsgTask,             // task
+                            "deferredMsgTask",           // name for task
+                            DEFERRED_MSG_TASK_STACK,     // size of task stack
+                            NULL,                        // parameters
+                            DEFERRED_MSG_TASK_PRIORITY,  // priority
+                            NULL,
+                            DEFERRED_MSG_TASK_CORE  // core
+    );
+    msg_started = true;
+}
+
+void grbl_msg_deferf(uint8_t client, MsgLevel level, const char* format, ...) {
+    if (client == CLIENT_INPUT) {
+        return;
+    }
+    if (level > GRBL_MSG_LEVEL) {
+        return;
+    }
+    va_list arg;
+    va_start(arg, format);
+    if (!msg_started) {
+        grbl_msg_vsendf(client, format, arg);
+        va_end(arg);
+        return;
+    }
+
+    uint32_t        head = msg_head.load(std::memory_order_relaxed);
+    deferred_msg_t* msg;
+    for (;;) {
+        msg          = &msg_ring[head & (DEFERRED_MSG_QUEUE_SIZE - 1)];
+        uint32_t seq = msg->seq.load(std::memory_order_acquire);
+        if (seq == head) {
+            if (msg_head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (int32_t(seq - head) < 0) {
+            // The task has not sent the message a whole ring ago yet
+            msg_dropped++;
+            va_end(arg);
+            return;
+        } else {
+            head = msg_head.load(std::memory_order_relaxed);
+        }
+    }
+
+    va_list copy;
+    va_copy(copy, arg);
+    msg->format = format;
+    msg->client = client;
+    if (!pack_args(format, copy, msg->args, msg->arg_bytes)) {
+        // Sent at once, leaving the slot for the task as a message with nothing to say
+        msg->format = "";
+        grbl_msg_vsendf(client, format, arg);
+    }
+    va_end(copy);
+    va_end(arg);
+    msg->seq.store(head + 1, std::memory_order_release);
+}
+
+#endif
@@ -0,0 +1,62 @@
+#pragma once
+
+/*
+  DeferredMsg.h - messages formatted and sent after the caller has moved on
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  With ENABLE_DEFERRED_MSG, grbl_msg_deferf() does not format its message. It stores the format
+  pointer and the arguments, packed the way the format asks for them, in one slot of a ring and
+  returns. A low priority task takes the slots out in order, formats them and sends them like
+  grbl_msg_sendf(). The format must therefore be a string that lives for ever, a literal as it is
+  everywhere in Grbl. %s arguments are copied into the slot, since they may not.
+
+  Any task may write to the ring; slots are claimed with a compare and swap, so no lock is taken.
+  Messages that find the ring full are counted and the count is reported in their place. A message
+  whose arguments do not fit DEFERRED_MSG_ARG_BYTES is sent at once instead. Not for use in ISRs.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_DEFERRED_MSG
+
+// Messages the ring can hold, a power of 2
+#    ifndef DEFERRED_MSG_QUEUE_SIZE
+#        define DEFERRED_MSG_QUEUE_SIZE 32
+#    endif
+
+// Room for the arguments of one message. An int or pointer takes 4 bytes, a float or a long long 8,
+// a string its length and the NUL.
+#    ifndef DEFERRED_MSG_ARG_BYTES
+#        define DEFERRED_MSG_ARG_BYTES 24
+#    endif
+
+// How often the task looks at the ring
+#    ifndef DEFERRED_MSG_PERIOD_MS
+#        define DEFERRED_MSG_PERIOD_MS 20
+#    endif
+
+static_assert((DEFERRED_MSG_QUEUE_SIZE & (DEFERRED_MSG_QUEUE_SIZE - 1)) == 0, "DEFERRED_MSG_QUEUE_SIZE must be a power of 2");
+
+// Starts the task. Messages before this are sent at once.
+void deferred_msg_init();
+
+void grbl_msg_deferf(uint8_t client, MsgLevel level, const char* format, ...);
+
+#else
+#    define grbl_msg_deferf grbl_msg_sendf
+#endif
@@ -21,62 +21,139 @@
 
 #include "Error.h"
 
-std::map<Error, const char*> ErrorCodes = {
-    { Error::Ok, "No error" },
-    { Error::ExpectedCommandLetter, "Expected GCodecommand letter" },
-    { Error::BadNumberFormat, "Bad GCode number format" },
-    { Error::InvalidStatement, "Invalid $ statement" },
-    { Error::NegativeValue, "Negative value" },
-    { Error::SettingDisabled, "Setting disabled" },
-    { Error::SettingStepPulseMin, "Step pulse too short" },
-    { Error::SettingReadFail, "Failed to read settings" },
-    { Error::IdleError, "Command requires idle state" },
-    { Error::SystemGcLock, "GCode cannot be executed in lock or alarm state" },
-    { Error::SoftLimitError, "Soft limit error" },
-    { Error::Overflow, "Line too long" },
-    { Error::MaxStepRateExceeded, "Max step rate exceeded" },
-    { Error::CheckDoor, "Check door" },
-    { Error::LineLengthExceeded, "Startup line too long" },
-    { Error::TravelExceeded, "Max travel exceeded during jog" },
-    { Error::InvalidJogCommand, "Invalid jog command" },
-    { Error::SettingDisabledLaser, "Laser mode requires PWM output" },
-    { Error::HomingNoCycles, "No Homing/Cycle defined in settings" },
-    { Error::GcodeUnsupportedCommand, "Unsupported GCode command" },
-    { Error::GcodeModalGroupViolation, "Gcode modal group violation" },
-    { Error::GcodeUndefinedFeedRate, "Gcode undefined feed rate" },
-    { Error::GcodeCommandValueNotInteger, "Gcode command value not integer" },
-    { Error::GcodeAxisCommandConflict, "Gcode axis command conflict" },
-    { Error::GcodeWordRepeated, "Gcode word repeated" },
-    { Error::GcodeNoAxisWords, "Gcode no axis words" },
-    { Error::GcodeInvalidLineNumber, "Gcode invalid line number" },
-    { Error::GcodeValueWordMissing, "Gcode value word missing" },
-    { Error::GcodeUnsupportedCoordSys, "Gcode unsupported coordinate system" },
-    { Error::GcodeG53InvalidMotionMode, "Gcode G53 invalid motion mode" },
-    { Error::GcodeAxisWordsExist, "Gcode extra axis words" },
-    { Error::GcodeNoAxisWordsInPlane, "Gcode no axis words in plane" },
-    { Error::GcodeInvalidTarget, "Gcode invalid target" },
-    { Error::GcodeArcRadiusError, "Gcode arc radius error" },
-    { Error::GcodeNoOffsetsInPlane, "Gcode no offsets in plane" },
-    { Error::GcodeUnusedWords, "Gcode unused words" },
-    { Error::GcodeG43DynamicAxisError, "Gcode G43 dynamic axis error" },
-    { Error::GcodeMaxValueExceeded, "Gcode max value exceeded" },
-    { Error::PParamMaxExceeded, "P param max exceeded" },
-    { Error::SdFailedMount, "SD failed mount" },
-    { Error::SdFailedRead, "SD failed read" },
-    { Error::SdFailedOpenDir, "SD failed to open directory" },
-    { Error::SdDirNotFound, "SD directory not found" },
-    { Error::SdFileEmpty, "SD file empty" },
-    { Error::SdFileNotFound, "SD file not found" },
-    { Error::SdFailedOpenFile, "SD failed to open file" },
-    { Error::SdFailedBusy, "SD is busy" },
-    { Error::SdFailedDelDir, "SD failed to delete directory" },
-    { Error::SdFailedDelFile, "SD failed to delete file" },
-    { Error::BtFailBegin, "Bluetooth failed to start" },
-    { Error::WifiFailBegin, "WiFi failed to start" },
-    { Error::NumberRange, "Number out of range for setting" },
-    { Error::InvalidValue, "Invalid value for setting" },
-    { Error::MessageFailed, "Failed to send message" },
-    { Error::NvsSetFailed, "Failed to store setting" },
-    { Error::NvsGetStatsFailed, "Failed to get setting status" },
-    { Error::AuthenticationFailed, "Authentication failed!" },
-};
+const char* errorString(Error errorNumber) {
+    switch (errorNumber) {
+        case Error::Ok:
+            return "No error";
+        case Error::ExpectedCommandLetter:
+            return "Expected GCodecommand letter";
+        case Error::BadNumberFormat:
+            return "Bad GCode number format";
+        case Error::InvalidStatement:
+            return "Invalid $ statement";
+        case Error::NegativeValue:
+            return "Negative value";
+        case Error::SettingDisabled:
+            return "Setting disabled";
+        case Error::SettingStepPulseMin:
+            return "Step pulse too short";
+        case Error::SettingReadFail:
+            return "Failed to read settings";
+        case Error::IdleError:
+            return "Command requires idle state";
+        case Error::SystemGcLock:
+            return "GCode cannot be executed in lock or alarm state";
+        case Error::SoftLimitError:
+            return "Soft limit error";
+        case Error::Overflow:
+            return "Line too long";
+        case Error::MaxStepRateExceeded:
+            return "Max step rate exceeded";
+        case Error::CheckDoor:
+            return "Check door";
+        case Error::LineLengthExceeded:
+            return "Startup line too long";
+        case Error::TravelExceeded:
+            return "Max travel exceeded during jog";
+        case Error::InvalidJogCommand:
+            return "Invalid jog command";
+        case Error::SettingDisabledLaser:
+            return "Laser mode requires PWM output";
+        case Error::HomingNoCycles:
+            return "No Homing/Cycle defined in settings";
+        case Error::GcodeUnsupportedCommand:
+            return "Unsupported GCode command";
+        case Error::GcodeModalGroupViolation:
+            return "Gcode modal group violation";
+        case Error::GcodeUndefinedFeedRate:
+            return "Gcode undefined feed rate";
+        case Error::GcodeCommandValueNotInteger:
+            return "Gcode command value not integer";
+        case Error::GcodeAxisCommandConflict:
+            return "Gcode axis command conflict";
+        case Error::GcodeWordRepeated:
+            return "Gcode word repeated";
+        case Error::GcodeNoAxisWords:
+            return "Gcode no axis words";
+        case Error::GcodeInvalidLineNumber:
+            return "Gcode invalid line number";
+        case Error::GcodeValueWordMissing:
+            return "Gcode value word missing";
+        case Error::GcodeUnsupportedCoordSys:
+            return "Gcode unsupported coordinate system";
+        case Error::GcodeG53InvalidMotionMode:
+            return "Gcode G53 invalid motion mode";
+        case Error::GcodeAxisWordsExist:
+            return "Gcode extra axis words";
+        case Error::GcodeNoAxisWordsInPlane:
+            return "Gcode no axis words in plane";
+        case Error::GcodeInvalidTarget:
+            return "Gcode invalid target";
+        case Error::GcodeArcRadiusError:
+            return "Gcode arc radius error";
+        case Error::GcodeNoOffsetsInPlane:
+            return "Gcode no offsets in plane";
+        case Error::GcodeUnusedWords:
+            return "Gcode unused words";
+        case Error::GcodeG43DynamicAxisError:
+            return "Gcode G43 dynamic axis error";
+        case Error::GcodeMaxValueExceeded:
+            return "Gcode max value exceeded";
+        case Error::PParamMaxExceeded:
+            return "P param max exceeded";
+        case Error::SdFailedMount:
+            return "SD failed mount";
+        case Error::SdFailedRead:
+            return "SD failed read";
+        case Error::SdFailedOpenDir:
+            return "SD failed to open directory";
+        case Error::SdDirNotFound:
+            return "SD directory not found";
+        case Error::SdFileEmpty:
+            return "SD file empty";
+        case Error::SdFileNotFound:
+            return "SD file not found";
+        case Error::SdFailedOpenFile:
+            return "SD failed to open file";
+        case Error::SdFailedBusy:
+            return "SD is busy";
+        case Error::SdFailedDelDir:
+            return "SD failed to delete directory";
+        case Error::SdFailedDelFile:
+            return "SD failed to delete file";
+        case Error::BtFailBegin:
+            return "Bluetooth failed to start";
+        case Error::WifiFailBegin:
+            return "WiFi failed to start";
+        case Error::NumberRange:
+            return "Number out of range for setting";
+        case Error::InvalidValue:
+            return "Invalid value for setting";
+        case Error::MessageFailed:
+            return "Failed to send message";
+        case Error::NvsSetFailed:
+            return "Failed to store setting";
+        case Error::NvsGetStatsFailed:
+            return "Failed to get setting status";
+        case Error::AuthenticationFailed:
+            return "Authentication failed!";
+        case Error::ExpressionSyntaxError:
+            return "Bad expression";
+        case Error::ExpressionDivideByZero:
+            return "Division by zero in expression";
+        case Error::ExpressionInvalidArgument:
+            return "Expression result out of range";
+        case Error::ExpressionUnknownParameter:
+            return "Parameter number out of range";
+        case Error::OCodeUnknownWord:
+            return "Unknown O-word";
+        case Error::OCodeUnknownSub:
+            return "O-word call of undefined sub";
+        case Error::OCodeStackOverflow:
+            return "O-word subs and loops nested too deep";
+        case Error::OCodeUnmatched:
+            return "O-word without matching start";
+        default:
+            return nullptr;
+    }
+}
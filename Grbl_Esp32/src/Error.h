@@ -21,7 +21,7 @@
   along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <map>
+#include <cstdint>
 
 // Grbl error codes. Valid values (0-255)
 enum class Error : uint8_t {
@@ -83,6 +83,16 @@ enum class Error : uint8_t {
     NvsGetStatsFailed           = 101,
     AuthenticationFailed        = 110,
     Eol                         = 111,
+    ExpressionSyntaxError       = 120,
+    ExpressionDivideByZero      = 121,
+    ExpressionInvalidArgument   = 122,
+    ExpressionUnknownParameter  = 123,
+    OCodeUnknownWord            = 124,
+    OCodeUnknownSub             = 125,
+    OCodeStackOverflow          = 126,
+    OCodeUnmatched              = 127,
 };
 
-extern std::map<Error, const char*> ErrorCodes;
+// Text of an error code, or nullptr for codes without one. The texts are in flash and the lookup is a
+// switch, which compiles to a table indexed by the code.
+const char* errorString(Error errorNumber);
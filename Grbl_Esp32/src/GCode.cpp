@@ -24,6 +24,8 @@
 
 #include "Grbl.h"
 
+#include <xtensa/hal.h>
+
 // NOTE: Max line number is defined by the g-code standard to be 99999. It seems to be an
 // arbitrary value, and some GUIs may require more. So we increased it based on a max safe
 // value when converting a float (7.2 digit precision)s to an integer.
@@ -34,6 +36,12 @@ static const uint8_t MaxToolNumber = 255;  // Limited by max unsigned 8-bit valu
 parser_state_t gc_state;
 parser_block_t gc_block;
 
+// Words of the line being parsed, filled by gc_tokenize(). Every word takes at least two characters.
+static const uint8_t GC_MAX_WORDS = 128;
+static gc_word_t     gc_words[GC_MAX_WORDS];
+
+static gc_stats_t gc_stats;
+
 #define FAIL(status) return (status);
 
 void gc_init() {
@@ -42,23 +50,108 @@ void gc_init() {
     // Load default G54 coordinate system.
     gc_state.modal.coord_select = CoordIndex::G54;
     coords[gc_state.modal.coord_select]->get(gc_state.coord_system);
+#ifdef PATH_BLENDING
+    blend_reset();  // A move held before the reset is gone with the planner buffer
+#endif
 }
 
 // Sets g-code parser position in mm. Input in steps. Called by the system abort and hard
 // limit pull-off routines.
 void gc_sync_position() {
     system_convert_array_steps_to_mpos(gc_state.position, sys_position);
+#ifdef ENABLE_AUX_STREAM
+    if (aux_stream_busy()) {
+        // The auxiliary axis is still on its way. The next moves start where it goes.
+        gc_state.position[AUX_STREAM_AXIS] = aux_stream_target() * motion_config.mm_per_step[AUX_STREAM_AXIS];
+    }
+#endif
+#ifdef ENABLE_HEIGHT_MAP
+    height_map_uncompensate(gc_state.position);
+#endif
+}
+
+// Plans a G0 or G1 move, blended with the one before in G64 mode.
+static void gc_straight_line(float* target, plan_line_data_t* pl_data) {
+#ifdef PATH_BLENDING
+    if (gc_state.modal.control == ControlMode::Blend) {
+        float tolerance = gc_state.blend_tolerance > 0.0 ? gc_state.blend_tolerance : motion_config.junction_deviation;
+        blend_line(target, pl_data, gc_state.position, tolerance);
+        return;
+    }
+#endif
+    mc_line_kins(target, pl_data, gc_state.position);
 }
 
-// Edit GCode line in-place, removing whitespace and comments and
-// converting to uppercase
-void collapseGCode(char* line) {
+#ifdef SPINDLE_STATE_IN_PLANNER
+// True when a spindle change to state can ride on the next move instead of draining the planner: the
+// machine is moving, the spindle switches from the step ISR and nothing has to wait for it.
+static bool gc_defer_spindle(SpindleState state) {
+    if (sys.state != State::Cycle || !spindle->state_in_planner()) {
+        return false;
+    }
+    if (spindle->use_delays) {
+        if (spindle->has_speed_feedback()) {
+            return false;
+        }
+        if (state != gc_state.modal.spindle) {
+            float delay = (state == SpindleState::Disable) ? spindle_delay_spindown->get() : spindle_delay_spinup->get();
+            if (delay > 0.0) {
+                return false;
+            }
+        }
+    }
+    plan_defer_state();
+    return true;
+}
+
+// Coolant pins can always be switched from the step ISR.
+static bool gc_defer_coolant() {
+    if (sys.state != State::Cycle) {
+        return false;
+    }
+    plan_defer_state();
+    return true;
+}
+#endif
+
+// Splits the collapsed text from *scan up to end into words, with the same checks as a scan over
+// the whole line. end is a word letter or the terminating NUL, so no number can run past it.
+static Error gc_split_words(char* line, uint8_t* scan, uint8_t end, uint8_t* n_words) {
+    while (*scan < end) {
+        char letter = line[*scan];
+        if ((letter < 'A') || (letter > 'Z')) {
+            return Error::ExpectedCommandLetter;  // [Expected word letter]
+        }
+        (*scan)++;
+        float value;
+        if (!read_float(line, scan, &value)) {
+            return Error::BadNumberFormat;  // [Expected word value]
+        }
+        if (*n_words == GC_MAX_WORDS) {
+            return Error::Overflow;
+        }
+        gc_words[*n_words].letter = letter;
+        gc_words[*n_words].value  = value;
+        (*n_words)++;
+    }
+    return Error::Ok;
+}
+
+// Edits the GCode line in-place, removing whitespace and comments and converting to uppercase,
+// and splits it into gc_words in the same pass. Each time a letter is written, the text before it
+// is complete and is converted to words while it is still in cache.
+// The words up to the first bad one are kept in gc_words and the error is returned with
+// *n_words set, so the caller can check those words first and report errors in line order.
+static Error gc_tokenize(char* line, uint8_t* n_words) {
     // parenPtr, if non-NULL, is the address of the character after (
     char* parenPtr = NULL;
     // outPtr is the address where newly-processed characters will be placed.
     // outPtr is alway less than or equal to inPtr.
-    char* outPtr = line;
-    char  c;
+    char*   outPtr = line;
+    char    c;
+    uint8_t scan   = 0;  // Start of the collapsed text not yet split into words
+    Error   status = Error::Ok;
+    *n_words       = 0;
     for (char* inPtr = line; (c = *inPtr) != '\0'; inPtr++) {
         if (isspace(c)) {
             continue;
@@ -82,8 +175,7 @@ void collapseGCode(char* line) {
 #ifdef REPORT_SEMICOLON_COMMENTS
                 report_gcode_comment(inPtr + 1);
 #endif
-                *outPtr = '\0';
-                return;
+                goto done;
             case '%':
                 // TODO: Install '%' feature
                 // Program start-end percent sign NOT SUPPORTED.
@@ -97,7 +189,13 @@ void collapseGCode(char* line) {
                 break;
             default:
                 if (!parenPtr) {
-                    *outPtr++ = toupper(c);  // make upper case
+                    c         = toupper(c);  // make upper case
+                    *outPtr++ = c;
+                    if (outPtr == line + 1 && c == '$') {
+                        scan = 3;  // Start parsing after `$J=`
+                    } else if (c >= 'A' && c <= 'Z' && status == Error::Ok) {
+                        status = gc_split_words(line, &scan, outPtr - 1 - line, n_words);
+                    }
                 }
         }
     }
@@ -106,30 +204,220 @@ void collapseGCode(char* line) {
         // Handle unterminated ( comments
         report_gcode_comment(parenPtr);
     }
+done:
     *outPtr = '\0';
+    if (status == Error::Ok) {
+        status = gc_split_words(line, &scan, outPtr - line, n_words);
+    }
+    return status;
 }
 
+const gc_stats_t* gc_get_stats() {
+    return &gc_stats;
+}
+
+void gc_reset_stats() {
+    memset(&gc_stats, 0, sizeof(gc_stats_t));
+}
+
+#ifdef CANNED_CYCLES
+static bool gc_is_canned_cycle(Motion motion) {
+    return motion == Motion::ChipBreakCycle || motion == Motion::DrillCycle || motion == Motion::DwellCycle || motion == Motion::PeckCycle;
+}
+#endif
+
+// Fast path for the lines that make up most laser raster files, like G1 X.. S.., when the motion
+// mode is already G1 in G94, and for the G0 X.. Y.. moves between the passes of raster and
+// engraving files outside laser mode. Only the axis words, F, S and a repeated G0 or G1 of the
+// current mode are accepted, since they cannot change any modal state, so the block, the copy of
+// the modal state and the checks of the full parser are skipped. Lines with anything else, or that
+// would fail any check, return false and go through the full parser, so errors are reported
+// exactly as before.
+static bool gc_execute_fast_line(uint8_t n_words, uint32_t parse_start) {
+    if (gc_state.modal.feed_rate != FeedRate::UnitsPerMin) {
+        return false;
+    }
+    // Laser mode turns the beam off for G0, which is left to the full parser.
+    bool  rapid = gc_state.modal.motion == Motion::Seek;
+    float mode  = rapid ? 0.0 : 1.0;
+    if (!(gc_state.modal.motion == Motion::Linear || (rapid && !laser_mode->get()))) {
+        return false;
+    }
+    auto    n_axis             = number_axis->get();
+    float   target[MAX_N_AXIS] = {};
+    float   feed_rate          = gc_state.feed_rate;
+    float   speed              = gc_state.spindle_speed;
+    uint8_t axis_words         = 0;
+    uint8_t seen               = 0;  // G, F and S words
+    for (uint8_t word = 0; word < n_words; word++) {
+        float   value = gc_words[word].value;
+        uint8_t axis;
+        switch (gc_words[word].letter) {
+            case 'G':
+                if (value != mode || bit_istrue(seen, bit(0))) {
+                    return false;
+                }
+                seen |= bit(0);
+                continue;
+            case 'F':
+                if (value < 0.0 || bit_istrue(seen, bit(1))) {
+                    return false;
+                }
+                seen |= bit(1);
+                feed_rate = (gc_state.modal.units == Units::Inches) ? value * MM_PER_INCH : value;
+                continue;
+            case 'S':
+                if (value < 0.0 || bit_istrue(seen, bit(2))) {
+                    return false;
+                }
+                seen |= bit(2);
+                speed = value;
+                continue;
+            case 'X':
+                axis = X_AXIS;
+                break;
+            case 'Y':
+                axis = Y_AXIS;
+                break;
+            case 'Z':
+                axis = Z_AXIS;
+                break;
+            case 'A':
+                axis = A_AXIS;
+                break;
+            case 'B':
+                axis = B_AXIS;
+                break;
+            case 'C':
+                axis = C_AXIS;
+                break;
+            default:
+                return false;
+        }
+        if (axis >= n_axis || bit_istrue(axis_words, bit(axis))) {
+            return false;
+        }
+        axis_words |= bit(axis);
+        target[axis] = value;
+    }
+    // Lines without axis words, G1 with an undefined feed rate, and spindle speed changes that need a
+    // sync are left to the full parser.
+    if (!axis_words || (feed_rate == 0.0 && !rapid)) {
+        return false;
+    }
+    if (speed != gc_state.spindle_speed && gc_state.modal.spindle != SpindleState::Disable && !laser_mode->get()) {
+        return false;
+    }
+    for (uint8_t idx = 0; idx < n_axis; idx++) {
+        if (bit_isfalse(axis_words, bit(idx))) {
+            target[idx] = gc_state.position[idx];
+            continue;
+        }
+        if (gc_state.modal.units == Units::Inches) {
+            target[idx] *= MM_PER_INCH;
+        }
+        if (gc_state.modal.distance == Distance::Absolute) {
+            target[idx] += gc_state.coord_system[idx] + gc_state.coord_offset[idx];
+            if (idx == TOOL_LENGTH_OFFSET_AXIS) {
+                target[idx] += gc_state.tool_length_offset;
+            }
+        } else {
+            target[idx] += gc_state.position[idx];
+        }
+    }
+    gc_stats.fast_cycles += xthal_get_ccount() - parse_start;
+    plan_line_data_t plan_data;
+    memset(&plan_data, 0, sizeof(plan_line_data_t));
+    gc_state.line_number    = 0;
+    gc_state.feed_rate      = feed_rate;
+    gc_state.spindle_speed  = speed;
+    plan_data.feed_rate     = feed_rate;
+    plan_data.spindle_speed = speed;
+    plan_data.spindle       = gc_state.modal.spindle;
+    plan_data.coolant       = gc_state.modal.coolant;
+    if (rapid) {
+        plan_data.motion.rapidMotion = 1;
+    }
+#ifdef SYNC_USER_OUTPUTS
+    plan_data.output_events = sys_output_events_pending();  // The next move switches the synchronized outputs
+#endif
+    gc_straight_line(target, &plan_data);  // Blended in G64 like the lines of the full parser
+    memcpy(gc_state.position, target, sizeof(target));
+    return true;
+}
+
+static Error gc_execute_block(uint8_t n_words, Error tokenize_status, bool jog, uint32_t parse_start, uint8_t client);
+
 // Executes one line of NUL-terminated G-Code.
-// The line may contain whitespace and comments, which are first removed,
+// The line may contain whitespace and comments, which are removed as it is split into words,
 // and lower case characters, which are converted to upper case.
 // In this function, all units and positions are converted and
 // exported to grbl's internal functions in terms of (mm, mm/min) and absolute machine
 // coordinates, respectively.
 Error gc_execute_line(char* line, uint8_t client) {
-    // Step 0 - remove whitespace and comments and convert to upper case
-    collapseGCode(line);
+    HOT_PATH_PROFILE(HotPath::GCodeLine);
+    // Step 0 - remove whitespace and comments, convert to upper case and split into words
+    uint32_t parse_start = xthal_get_ccount();
+    uint8_t  n_words;
+#ifdef ENABLE_O_CODES
+    if (line[0] != '$') {
+        Error expand_status = ocode_expand(&line);
+        if (expand_status != Error::Ok) {
+            return expand_status;
+        }
+    }
+#endif
+    Error tokenize_status = gc_tokenize(line, &n_words);
 #ifdef REPORT_ECHO_LINE_RECEIVED
     report_echo_line_received(line, client);
 #endif
+    if (tokenize_status == Error::Ok && line[0] != '$' && gc_execute_fast_line(n_words, parse_start)) {
+        gc_stats.fast_lines++;
+        return Error::Ok;
+    }
+    return gc_execute_block(n_words, tokenize_status, line[0] == '$', parse_start, client);
+}
 
+#ifdef ENABLE_MACROS
+Error gc_tokenize_line(char* line, gc_word_t* words, uint8_t max_words, uint8_t* n_words) {
+    Error status = gc_tokenize(line, n_words);
+    if (status == Error::Ok && *n_words > max_words) {
+        status = Error::Overflow;
+    }
+    if (status == Error::Ok) {
+        memcpy(words, gc_words, *n_words * sizeof(gc_word_t));
+    }
+    return status;
+}
+
+Error gc_execute_words(const gc_word_t* words, uint8_t n_words, uint8_t client) {
+    uint32_t parse_start = xthal_get_ccount();
+    memcpy(gc_words, words, n_words * sizeof(gc_word_t));
+    if (gc_execute_fast_line(n_words, parse_start)) {
+        gc_stats.fast_lines++;
+        return Error::Ok;
+    }
+    return gc_execute_block(n_words, Error::Ok, false, parse_start, client);
+}
+#endif
+
+// Checks and executes the words split out of a line by gc_tokenize(), which are in gc_words.
+// jog is set for the words of a $J= line.
+static Error gc_execute_block(uint8_t n_words, Error tokenize_status, bool jog, uint32_t parse_start, uint8_t client) {
     /* -------------------------------------------------------------------------------------
        STEP 1: Initialize parser block struct and copy current g-code state modes. The parser
        updates these modes and commands as the block line is parser and will only be used and
        executed after successful error-checking. The parser block struct also contains a block
        values struct, word tracking variables, and a non-modal commands tracker for the new
        block. This struct contains all of the necessary information to execute the block. */
-    memset(&gc_block, 0, sizeof(parser_block_t));                  // Initialize the parser block struct.
+    // Initialize the parser block struct. The modal part is copied over, so it is not cleared first.
+    gc_block.non_modal_command = NonModal::NoAction;
+    gc_block.coolant           = GCodeCoolant::None;
+    memset(&gc_block.values, 0, sizeof(gc_values_t));
     memcpy(&gc_block.modal, &gc_state.modal, sizeof(gc_modal_t));  // Copy current modes
+#ifdef CANNED_CYCLES
+    gc_block.cycle = gc_state.cycle;
+#endif
     AxisCommand axis_command = AxisCommand::None;
     uint8_t     axis_0, axis_1, axis_linear;
     CoordIndex  coord_select = CoordIndex::G54;  // Tracks G10 P coordinate selection for execution
@@ -143,9 +431,12 @@ Error gc_execute_line(char* line, uint8_t client) {
     auto     n_axis          = number_axis->get();
     float    coord_data[MAX_N_AXIS];  // Used by WCO-related commands
     uint8_t  pValue;  // Integer value of P word
+#ifdef CANNED_CYCLES
+    mc_drill_t drill;  // Hole of a canned cycle, set up by the error checks
+#endif
 
     // Determine if the line is a jogging motion or a normal g-code block.
-    if (line[0] == '$') {  // NOTE: `$J=` already parsed when passed to this function.
+    if (jog) {  // NOTE: `$J=` already parsed when passed to this function.
         // Set G1 and G94 enforced modes to ensure accurate error checks.
         gc_parser_flags |= GCParserJogMotion;
         gc_block.modal.motion    = Motion::Linear;
@@ -162,26 +453,13 @@ Error gc_execute_line(char* line, uint8_t client) {
        words, and for negative values set for the value words F, N, P, T, and S. */
     ModalGroup mg_word_bit;  // Bit-value for assigning tracking variables
     uint32_t   bitmask = 0;
-    uint8_t    char_counter;
     char       letter;
     float      value;
     uint8_t    int_value = 0;
     uint16_t   mantissa  = 0;
-    if (gc_parser_flags & GCParserJogMotion) {
-        char_counter = 3;  // Start parsing after `$J=`
-    } else {
-        char_counter = 0;
-    }
-    while (line[char_counter] != 0) {  // Loop until no more g-code words in line.
-        // Import the next g-code word, expecting a letter followed by a value. Otherwise, error out.
-        letter = line[char_counter];
-        if ((letter < 'A') || (letter > 'Z')) {
-            FAIL(Error::ExpectedCommandLetter);  // [Expected word letter]
-        }
-        char_counter++;
-        if (!read_float(line, &char_counter, &value)) {
-            FAIL(Error::BadNumberFormat);  // [Expected word value]
-        }
+    for (uint8_t word = 0; word < n_words; word++) {  // Loop over the words split out by gc_tokenize().
+        letter = gc_words[word].letter;
+        value  = gc_words[word].value;
         // Convert values to smaller uint8 significand and mantissa values for parsing this word.
         // NOTE: Mantissa is multiplied by 100 to catch non-integer command values. This is more
         // accurate than the NIST gcode requirement of x10 when used for commands, but not quite
@@ -270,6 +548,13 @@ Error gc_execute_line(char* line, uint8_t client) {
                         gc_block.modal.motion = Motion::CcwArc;
                         mg_word_bit           = ModalGroup::MG1;
                         break;
+#ifdef ENABLE_SPINDLE_SYNC
+                    case 33:  // G33 - spindle synchronized motion
+                        axis_command          = AxisCommand::MotionMode;
+                        gc_block.modal.motion = Motion::SpindleSync;
+                        mg_word_bit           = ModalGroup::MG1;
+                        break;
+#endif
                     case 38:  // G38 - probe
 #ifndef PROBE_PIN             //only allow G38 "Probe" commands if a probe pin is defined.
                         grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "No probe pin defined");
@@ -306,6 +591,36 @@ Error gc_execute_line(char* line, uint8_t client) {
                         gc_block.modal.motion = Motion::None;
                         mg_word_bit           = ModalGroup::MG1;
                         break;
+#ifdef CANNED_CYCLES
+                    case 73:  // G73 - chip breaking drill cycle
+                        axis_command          = AxisCommand::MotionMode;
+                        gc_block.modal.motion = Motion::ChipBreakCycle;
+                        mg_word_bit           = ModalGroup::MG1;
+                        break;
+                    case 81:  // G81 - drill cycle
+                        axis_command          = AxisCommand::MotionMode;
+                        gc_block.modal.motion = Motion::DrillCycle;
+                        mg_word_bit           = ModalGroup::MG1;
+                        break;
+                    case 82:  // G82 - drill cycle with dwell
+                        axis_command          = AxisCommand::MotionMode;
+                        gc_block.modal.motion = Motion::DwellCycle;
+                        mg_word_bit           = ModalGroup::MG1;
+                        break;
+                    case 83:  // G83 - peck drill cycle
+                        axis_command          = AxisCommand::MotionMode;
+                        gc_block.modal.motion = Motion::PeckCycle;
+                        mg_word_bit           = ModalGroup::MG1;
+                        break;
+                    case 98:
+                        gc_block.modal.retract = RetractMode::OldZ;
+                        mg_word_bit            = ModalGroup::MG10;
+                        break;
+                    case 99:
+                        gc_block.modal.retract = RetractMode::RPlane;
+                        mg_word_bit            = ModalGroup::MG10;
+                        break;
+#endif
                     case 17:
                         gc_block.modal.plane_select = Plane::XY;
                         mg_word_bit                 = ModalGroup::MG2;
@@ -422,9 +737,19 @@ Error gc_execute_line(char* line, uint8_t client) {
                         if (mantissa != 0) {
                             FAIL(Error::GcodeUnsupportedCommand);  // [G61.1 not supported]
                         }
+#ifdef PATH_BLENDING
+                        gc_block.modal.control = ControlMode::ExactPath;  // G61
+#else
                         // gc_block.modal.control = ControlMode::ExactPath; // G61
+#endif
                         mg_word_bit = ModalGroup::MG13;
                         break;
+#ifdef PATH_BLENDING
+                    case 64:
+                        gc_block.modal.control = ControlMode::Blend;
+                        mg_word_bit            = ModalGroup::MG13;
+                        break;
+#endif
                     default:
                         FAIL(Error::GcodeUnsupportedCommand);  // [Unsupported G command]
                 }
@@ -691,6 +1016,17 @@ Error gc_execute_line(char* line, uint8_t client) {
                 value_words |= bitmask;  // Flag to indicate parameter assigned.
         }
     }
+    // A word that could not be split out is reported after the words before it have been checked.
+    if (tokenize_status != Error::Ok) {
+        FAIL(tokenize_status);
+    }
+    uint32_t parse_cycles = xthal_get_ccount() - parse_start;
+    gc_stats.lines++;
+    gc_stats.words += n_words;
+    gc_stats.cycles += parse_cycles;
+    if (parse_cycles > gc_stats.max_cycles) {
+        gc_stats.max_cycles = parse_cycles;
+    }
     // Parsing complete!
     /* -------------------------------------------------------------------------------------
        STEP 3: Error-check all commands and values passed in this block. This step ensures all of
@@ -888,9 +1224,31 @@ Error gc_execute_line(char* line, uint8_t client) {
             coords[gc_block.modal.coord_select]->get(block_coord_system);
         }
     }
+#ifdef PATH_BLENDING
+    // [16. Set path control mode ]: P is negative. G61.1 NOT SUPPORTED.
+    float blend_tolerance = gc_state.blend_tolerance;
+    if (bit_istrue(command_words, bit(ModalGroup::MG13)) && gc_block.modal.control == ControlMode::Blend) {
+        blend_tolerance = 0.0;  // No P follows $11
+        if (bit_istrue(value_words, bit(GCodeWord::P))) {
+            if (gc_block.values.p < 0.0) {
+                FAIL(Error::NegativeValue);  // [P is negative]
+            }
+            blend_tolerance = gc_block.values.p;
+            if (gc_block.modal.units == Units::Inches) {
+                blend_tolerance *= MM_PER_INCH;
+            }
+            bit_false(value_words, bit(GCodeWord::P));
+        }
+    }
+#else
     // [16. Set path control mode ]: N/A. Only G61. G61.1 and G64 NOT SUPPORTED.
+#endif
     // [17. Set distance mode ]: N/A. Only G91.1. G90.1 NOT SUPPORTED.
+#ifdef CANNED_CYCLES
+    // [18. Set retract mode ]: N/A. The canned cycles are checked with the motion modes.
+#else
     // [18. Set retract mode ]: NOT SUPPORTED.
+#endif
     // [19. Remaining non-modal actions ]: Check go to predefined position, set G10, or set axis offsets.
     // NOTE: We need to separate the non-modal commands that are axis word-using (G10/G28/G30/G92), as these
     // commands all treat axis words differently. G10 as absolute offsets or computes current position as
@@ -1056,8 +1414,8 @@ Error gc_execute_line(char* line, uint8_t client) {
             // All remaining motion modes (all but G0 and G80), require a valid feed rate value. In units per mm mode,
             // the value must be positive. In inverse time mode, a positive value must be passed with each block.
         } else {
-            // Check if feed rate is defined for the motion modes that require it.
-            if (gc_block.values.f == 0.0) {
+            // Check if feed rate is defined for the motion modes that require it. G33 takes it from the spindle.
+            if (gc_block.values.f == 0.0 && gc_block.modal.motion != Motion::SpindleSync) {
                 FAIL(Error::GcodeUndefinedFeedRate);  // [Feed rate undefined]
             }
             switch (gc_block.modal.motion) {
@@ -1235,6 +1593,101 @@ Error gc_execute_line(char* line, uint8_t client) {
                         FAIL(Error::GcodeInvalidTarget);  // [Invalid target]
                     }
                     break;
+                case Motion::SpindleSync:
+                    // [G33 Errors]: No axis words. K, the distance per revolution, missing or not positive.
+                    if (!axis_words) {
+                        FAIL(Error::GcodeNoAxisWords);  // [No axis words]
+                    }
+                    if (bit_isfalse(value_words, bit(GCodeWord::K))) {
+                        FAIL(Error::GcodeValueWordMissing);  // [K word missing]
+                    }
+                    if (gc_block.modal.units == Units::Inches) {
+                        gc_block.values.ijk[Z_AXIS] *= MM_PER_INCH;
+                    }
+                    if (gc_block.values.ijk[Z_AXIS] <= 0.0) {
+                        FAIL(Error::NegativeValue);  // [K not positive]
+                    }
+                    bit_false(value_words, bit(GCodeWord::K));
+                    break;
+#ifdef CANNED_CYCLES
+                case Motion::ChipBreakCycle:
+                case Motion::DrillCycle:
+                case Motion::DwellCycle:
+                case Motion::PeckCycle: {
+                    // [G73/G81/G82/G83 Errors]: Feed rate undefined. Inverse time mode. No axis words. R or depth
+                    //   missing, in this block and the ones before it in the cycle. G73/G83 Q missing or not positive.
+                    //   R plane below the bottom of the hole. L is zero.
+                    if (gc_block.modal.feed_rate == FeedRate::InverseTime) {
+                        FAIL(Error::GcodeUnsupportedCommand);  // [G93 canned cycle]
+                    }
+                    if (!axis_words) {
+                        FAIL(Error::GcodeNoAxisWords);  // [No axis words]
+                    }
+                    gc_cycle_t* cycle = &gc_block.cycle;
+                    if (!gc_is_canned_cycle(gc_state.modal.motion)) {
+                        cycle->words = 0;  // Nothing carries over from before the cycle
+                    }
+                    float scale = (gc_block.modal.units == Units::Inches) ? MM_PER_INCH : 1.0;
+                    if (bit_istrue(value_words, bit(GCodeWord::R))) {
+                        cycle->r = gc_block.values.r * scale;
+                    }
+                    if (bit_istrue(value_words, bit(GCodeWord::Q))) {
+                        cycle->q = gc_block.values.q * scale;
+                    }
+                    if (bit_istrue(value_words, bit(GCodeWord::P))) {
+                        cycle->p = gc_block.values.p;
+                    }
+                    cycle->words |= value_words & (bit(GCodeWord::R) | bit(GCodeWord::Q) | bit(GCodeWord::P));
+                    // The depth is already a target. Take the offsets or the start off again to get the word.
+                    float offset = block_coord_system[axis_linear] + gc_state.coord_offset[axis_linear];
+                    float start  = gc_state.position[axis_linear];
+                    if (axis_linear == TOOL_LENGTH_OFFSET_AXIS) {
+                        offset += gc_state.tool_length_offset;
+                    }
+                    bool absolute = gc_block.modal.distance == Distance::Absolute;
+                    if (bit_istrue(axis_words, bit(axis_linear))) {
+                        cycle->depth = gc_block.values.xyz[axis_linear] - (absolute ? offset : start);
+                        cycle->words |= bit(GCodeWord::Z);
+                    }
+                    if (bit_isfalse(cycle->words, bit(GCodeWord::R)) || bit_isfalse(cycle->words, bit(GCodeWord::Z))) {
+                        FAIL(Error::GcodeValueWordMissing);  // [R or depth missing]
+                    }
+                    drill.peck       = 0.0;
+                    drill.dwell      = 0.0;
+                    drill.chip_break = gc_block.modal.motion == Motion::ChipBreakCycle;
+                    drill.axis       = axis_linear;
+                    if (gc_block.modal.motion == Motion::ChipBreakCycle || gc_block.modal.motion == Motion::PeckCycle) {
+                        if (bit_isfalse(cycle->words, bit(GCodeWord::Q))) {
+                            FAIL(Error::GcodeValueWordMissing);  // [Q missing]
+                        }
+                        if (cycle->q <= 0.0) {
+                            FAIL(Error::NegativeValue);  // [Q not positive]
+                        }
+                        drill.peck = cycle->q;
+                    } else if (gc_block.modal.motion == Motion::DwellCycle) {
+                        drill.dwell = cycle->p;
+                    }
+                    // In G91, R is above the start and the depth below R.
+                    if (absolute) {
+                        drill.r_plane = cycle->r + offset;
+                        drill.bottom  = cycle->depth + offset;
+                    } else {
+                        drill.r_plane = start + cycle->r;
+                        drill.bottom  = drill.r_plane + cycle->depth;
+                    }
+                    if (drill.bottom > drill.r_plane) {
+                        FAIL(Error::GcodeInvalidTarget);  // [R below the bottom]
+                    }
+                    drill.retract = (gc_block.modal.retract == RetractMode::OldZ) ? MAX(start, drill.r_plane) : drill.r_plane;
+                    if (bit_isfalse(value_words, bit(GCodeWord::L))) {
+                        gc_block.values.l = 1;
+                    } else if (gc_block.values.l == 0) {
+                        FAIL(Error::GcodeValueWordMissing);  // [L is zero]
+                    }
+                    bit_false(value_words, (bit(GCodeWord::R) | bit(GCodeWord::Q) | bit(GCodeWord::P) | bit(GCodeWord::L)));
+                    break;
+                }
+#endif
             }
         }
     }
@@ -1335,7 +1788,11 @@ Error gc_execute_line(char* line, uint8_t client) {
     // [4. Set spindle speed ]:
     if ((gc_state.spindle_speed != gc_block.values.s) || bit_istrue(gc_parser_flags, GCParserLaserForceSync)) {
         if (gc_state.modal.spindle != SpindleState::Disable) {
+#ifdef SPINDLE_STATE_IN_PLANNER
+            if (bit_isfalse(gc_parser_flags, GCParserLaserIsMotion) && !gc_defer_spindle(gc_state.modal.spindle)) {
+#else
             if (bit_isfalse(gc_parser_flags, GCParserLaserIsMotion)) {
+#endif
                 if (bit_istrue(gc_parser_flags, GCParserLaserDisable)) {
                     spindle->sync(gc_state.modal.spindle, 0);
                 } else {
@@ -1362,7 +1819,13 @@ Error gc_execute_line(char* line, uint8_t client) {
         // Update spindle control and apply spindle speed when enabling it in this block.
         // NOTE: All spindle state changes are synced, even in laser mode. Also, pl_data,
         // rather than gc_state, is used to manage laser state for non-laser motions.
+#ifdef SPINDLE_STATE_IN_PLANNER
+        if (!gc_defer_spindle(gc_block.modal.spindle)) {
+            spindle->sync(gc_block.modal.spindle, (uint32_t)pl_data->spindle_speed);
+        }
+#else
         spindle->sync(gc_block.modal.spindle, (uint32_t)pl_data->spindle_speed);
+#endif
         gc_state.modal.spindle = gc_block.modal.spindle;
     }
     pl_data->spindle = gc_state.modal.spindle;
@@ -1377,17 +1840,21 @@ Error gc_execute_line(char* line, uint8_t client) {
             break;
         case GCodeCoolant::M7:
             gc_state.modal.coolant.Mist = 1;
-            coolant_sync(gc_state.modal.coolant);
             break;
         case GCodeCoolant::M8:
             gc_state.modal.coolant.Flood = 1;
-            coolant_sync(gc_state.modal.coolant);
             break;
         case GCodeCoolant::M9:
             gc_state.modal.coolant = {};
-            coolant_sync(gc_state.modal.coolant);
             break;
     }
+#ifdef SPINDLE_STATE_IN_PLANNER
+    if (gc_block.coolant != GCodeCoolant::None && !gc_defer_coolant()) {
+#else
+    if (gc_block.coolant != GCodeCoolant::None) {
+#endif
+        coolant_sync(gc_state.modal.coolant);
+    }
     pl_data->coolant = gc_state.modal.coolant;  // Set state for planner use.
     // turn on/off an i/o pin
     if ((gc_block.modal.io_control == IoControl::DigitalOnSync) || (gc_block.modal.io_control == IoControl::DigitalOffSync) ||
@@ -1451,11 +1918,26 @@ Error gc_execute_line(char* line, uint8_t client) {
         memcpy(gc_state.coord_system, block_coord_system, sizeof(gc_state.coord_system));
         system_flag_wco_change();
     }
+#ifdef PATH_BLENDING
+    // [16. Set path control mode ]: G61.1 NOT SUPPORTED
+    gc_state.modal.control   = gc_block.modal.control;
+    gc_state.blend_tolerance = blend_tolerance;
+#else
     // [16. Set path control mode ]: G61.1/G64 NOT SUPPORTED
     // gc_state.modal.control = gc_block.modal.control; // NOTE: Always default.
+#endif
     // [17. Set distance mode ]:
     gc_state.modal.distance = gc_block.modal.distance;
+#ifdef CANNED_CYCLES
+    // [18. Set retract mode ]:
+    gc_state.modal.retract = gc_block.modal.retract;
+    gc_state.cycle         = gc_block.cycle;
+#else
     // [18. Set retract mode ]: NOT SUPPORTED
+#endif
+#ifdef SYNC_USER_OUTPUTS
+    pl_data->output_events = sys_output_events_pending();  // The next move switches the synchronized outputs
+#endif
     // [19. Go to predefined position, Set G10, or Set axis offsets ]:
     switch (gc_block.non_modal_command) {
         case NonModal::SetCoordinateData:
@@ -1506,11 +1988,11 @@ Error gc_execute_line(char* line, uint8_t client) {
 #endif
             if (gc_state.modal.motion == Motion::Linear) {
                 //mc_line(gc_block.values.xyz, pl_data);
-                mc_line_kins(gc_block.values.xyz, pl_data, gc_state.position);
+                gc_straight_line(gc_block.values.xyz, pl_data);
             } else if (gc_state.modal.motion == Motion::Seek) {
                 pl_data->motion.rapidMotion = 1;  // Set rapid motion flag.
                 //mc_line(gc_block.values.xyz, pl_data);
-                mc_line_kins(gc_block.values.xyz, pl_data, gc_state.position);
+                gc_straight_line(gc_block.values.xyz, pl_data);
             } else if ((gc_state.modal.motion == Motion::CwArc) || (gc_state.modal.motion == Motion::CcwArc)) {
                 mc_arc(gc_block.values.xyz,
                        pl_data,
@@ -1521,6 +2003,31 @@ Error gc_execute_line(char* line, uint8_t client) {
                        axis_1,
                        axis_linear,
                        bit_istrue(gc_parser_flags, GCParserArcIsClockwise));
+#ifdef ENABLE_SPINDLE_SYNC
+            } else if (gc_state.modal.motion == Motion::SpindleSync) {
+                mc_spindle_sync_line(gc_block.values.xyz, pl_data, gc_block.values.ijk[Z_AXIS]);
+#endif
+#ifdef CANNED_CYCLES
+            } else if (gc_is_canned_cycle(gc_state.modal.motion)) {
+                // In G91 each repeat moves on by the axis words again, at the R plane and depth of the first hole.
+                float spacing[MAX_N_AXIS] = {};
+                if (gc_state.modal.distance == Distance::Incremental) {
+                    for (idx = 0; idx < n_axis; idx++) {
+                        if (idx != drill.axis) {
+                            spacing[idx] = gc_block.values.xyz[idx] - gc_state.position[idx];
+                        }
+                    }
+                }
+                for (uint8_t hole = 0; hole < gc_block.values.l && !sys.abort; hole++) {
+                    if (hole > 0) {
+                        for (idx = 0; idx < n_axis; idx++) {
+                            gc_block.values.xyz[idx] += spacing[idx];
+                        }
+                    }
+                    mc_drill(gc_block.values.xyz, pl_data, gc_state.position, &drill);
+                    memcpy(gc_state.position, gc_block.values.xyz, sizeof(gc_block.values.xyz));
+                }
+#endif
             } else {
                 // NOTE: gc_block.values.xyz is returned from mc_probe_cycle with the updated position value. So
                 // upon a successful probing cycle, the machine position and the returned value should be the same.
@@ -1619,7 +2126,7 @@ Error gc_execute_line(char* line, uint8_t client) {
 /*
   Not supported:
 
-  - Canned cycles
+  - Canned cycles, unless CANNED_CYCLES is defined
   - Tool radius compensation
   - A,B,C-axes
   - Evaluation of expressions
@@ -1638,5 +2145,5 @@ Error gc_execute_line(char* line, uint8_t client) {
    group 8 = {M7*} enable mist coolant (* Compile-option)
    group 9 = {M48, M49} enable/disable feed and speed override switches
    group 10 = {G98, G99} return mode canned cycles
-   group 13 = {G61.1, G64} path control mode (G61 is supported)
+   group 13 = {G61.1} path control mode (G61 is supported, G64 with PATH_BLENDING)
 */
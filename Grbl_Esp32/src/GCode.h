@@ -33,7 +33,7 @@
 
 enum class ModalGroup : uint8_t {
     MG0  = 0,   // [G4,G10,G28,G28.1,G30,G30.1,G53,G92,G92.1] Non-modal
-    MG1  = 1,   // [G0,G1,G2,G3,G38.2,G38.3,G38.4,G38.5,G80] Motion
+    MG1  = 1,   // [G0,G1,G2,G3,G38.2,G38.3,G38.4,G38.5,G73,G80,G81,G82,G83] Motion
     MG2  = 2,   // [G17,G18,G19] Plane selection
     MG3  = 3,   // [G90,G91] Distance mode
     MG4  = 4,   // [G91.1] Arc IJK distance mode
@@ -49,6 +49,7 @@ enum class ModalGroup : uint8_t {
     MM8  = 13,  // [M7,M8,M9] Coolant control
     MM9  = 14,  // [M56] Override control
     MM10 = 15,  // [M62, M63, M64, M65, M67, M68] User Defined http://linuxcnc.org/docs/html/gcode/overview.html#_modal_groups
+    MG10 = 16,  // [G98,G99] Canned cycle return mode
 };
 
 // Command actions for within execution-type modal groups (motion, stopping, non-modal). Used
@@ -83,7 +84,12 @@ enum class Motion : uint8_t {
     ProbeTowardNoError = 141,  // G38.3 (Do not alter value)
     ProbeAway          = 142,  // G38.4 (Do not alter value)
     ProbeAwayNoError   = 143,  // G38.5 (Do not alter value)
+    SpindleSync        = 33,   // G33 (Do not alter value)
     None               = 80,   // G80 (Do not alter value)
+    ChipBreakCycle     = 73,   // G73 (Do not alter value)
+    DrillCycle         = 81,   // G81 (Do not alter value)
+    DwellCycle         = 82,   // G82 (Do not alter value)
+    PeckCycle          = 83,   // G83 (Do not alter value)
 };
 
 // Modal Group G2: Plane select
@@ -135,6 +141,13 @@ enum class CutterCompensation : uint8_t {
 // Modal Group G13: Control mode
 enum class ControlMode : uint8_t {
     ExactPath = 0,  // G61 (Default: Must be zero)
+    Blend     = 1,  // G64
+};
+
+// Modal Group G10: Canned cycle return mode
+enum class RetractMode : uint8_t {
+    OldZ   = 0,  // G98 (Default: Must be zero)
+    RPlane = 1,  // G99
 };
 
 // Modal Group M7: Spindle control
@@ -252,7 +265,14 @@ typedef struct {
     // CutterCompensation cutter_comp;  // {G40} NOTE: Don't track. Only default supported.
     ToolLengthOffset tool_length;   // {G43.1,G49}
     CoordIndex       coord_select;  // {G54,G55,G56,G57,G58,G59}
+#ifdef PATH_BLENDING
+    ControlMode control;  // {G61,G64}
+#else
     // uint8_t control;      // {G61} NOTE: Don't track. Only default supported.
+#endif
+#ifdef CANNED_CYCLES
+    RetractMode retract;  // {G98,G99}
+#endif
     ProgramFlow  program_flow;  // {M0,M1,M2,M30}
     CoolantState coolant;       // {M7,M8,M9}
     SpindleState spindle;       // {M3,M4,M5}
@@ -275,6 +295,18 @@ typedef struct {
     float   xyz[MAX_N_AXIS];  // X,Y,Z Translational axes
 } gc_values_t;
 
+#ifdef CANNED_CYCLES
+// Words of a canned cycle, in mm and seconds. They carry over to the following blocks until G80 or a
+// motion mode other than a cycle. R and the depth are kept as programmed, for each block's distance mode.
+typedef struct {
+    float    r;      // R plane
+    float    depth;  // Axis word of the drilling axis
+    float    q;      // Peck increment
+    float    p;      // Dwell at the bottom
+    uint32_t words;  // GCodeWord bits of the words set so far. Z stands for the drilling axis.
+} gc_cycle_t;
+#endif
+
 typedef struct {
     gc_modal_t modal;
 
@@ -290,6 +322,12 @@ typedef struct {
     float coord_offset[MAX_N_AXIS];  // Retains the G92 coordinate offset (work coordinates) relative to
     // machine zero in mm. Non-persistent. Cleared upon reset and boot.
     float tool_length_offset;  // Tracks tool length offset value when enabled.
+#ifdef PATH_BLENDING
+    float blend_tolerance;  // G64 P in mm, 0 follows $11
+#endif
+#ifdef CANNED_CYCLES
+    gc_cycle_t cycle;
+#endif
 } parser_state_t;
 extern parser_state_t gc_state;
 
@@ -298,6 +336,9 @@ typedef struct {
     gc_modal_t   modal;
     gc_values_t  values;
     GCodeCoolant coolant;
+#ifdef CANNED_CYCLES
+    gc_cycle_t cycle;
+#endif
 } parser_block_t;
 
 enum class AxisCommand : uint8_t {
@@ -307,11 +348,38 @@ enum class AxisCommand : uint8_t {
     ToolLengthOffset = 3,
 };
 
+// A letter and its value, as split out of a line by the tokenizer.
+typedef struct {
+    char  letter;
+    float value;
+} gc_word_t;
+
+// Time spent tokenizing and importing words (STEP 0 to 2 of gc_execute_line), in CPU cycles.
+typedef struct {
+    uint32_t lines;        // Lines parsed without error
+    uint32_t words;        // Words in those lines
+    uint64_t cycles;       // Total CPU cycles spent parsing them
+    uint32_t max_cycles;   // Slowest single line
+    uint32_t fast_lines;   // Lines run by the G0/G1 fast path, which skips the counters above
+    uint64_t fast_cycles;  // CPU cycles spent parsing them, up to planning the move
+} gc_stats_t;
+
 // Initialize the parser
 void gc_init();
 
 // Execute one block of rs275/ngc/g-code
 Error gc_execute_line(char* line, uint8_t client);
 
+#ifdef ENABLE_MACROS
+// Splits a line into at most max_words words, for gc_execute_words() to execute later without parsing
+// the text again. The line is collapsed in place.
+Error gc_tokenize_line(char* line, gc_word_t* words, uint8_t max_words, uint8_t* n_words);
+Error gc_execute_words(const gc_word_t* words, uint8_t n_words, uint8_t client);
+#endif
+
+// Parser throughput counters. Reported by $GCode/Stats.
+const gc_stats_t* gc_get_stats();
+void              gc_reset_stats();
+
 // Set g-code parser position. Input in steps.
 void gc_sync_position();
@@ -24,6 +24,9 @@
 void grbl_init() {
 #ifdef USE_I2S_OUT
     i2s_out_init();  // The I2S out must be initialized before it can access the expanded GPIO port
+#endif
+#ifdef USE_I2S_IN
+    i2s_in_init();  // Before the limit, probe and control inputs on the expander are read or attached
 #endif
     WiFi.persistent(false);
     WiFi.disconnect(true);
@@ -31,6 +34,16 @@ void grbl_init() {
     WiFi.enableAP(false);
     WiFi.mode(WIFI_OFF);
     serial_init();  // Setup serial baud rate and interrupts
+#ifdef ENABLE_CACHE_PROFILING
+    cache_profile_init();  // On the core of the main loop, which runs the parser and the planner
+#endif
+#ifdef ENABLE_ASYNC_OUTPUT
+    client_output_init();
+#endif
+#ifdef ENABLE_DEFERRED_MSG
+    deferred_msg_init();
+#endif
+    boot_stage("serial");
     grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Grbl_ESP32 Ver %s Date %s", GRBL_VERSION, GRBL_VERSION_BUILD);  // print grbl_esp32 verion info
     grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Compiled with ESP32 SDK:%s", ESP.getSdkVersion());              // print the SDK version
 // show the map name at startup
@@ -38,13 +51,48 @@ void grbl_init() {
     report_machine_type(CLIENT_SERIAL);
 #endif
     settings_init();  // Load Grbl settings from EEPROM
-    stepper_init();   // Configure stepper pins and interrupt timers
+    boot_stage("settings");
+    plan_init();  // Allocate the planner buffer
+#ifdef ENABLE_BINARY_STREAM
+    binary_stream_init();
+#endif
+    stepper_init();  // Configure stepper pins and interrupt timers
+    boot_stage("stepper");
+#ifdef MOTION_PIPELINE
+    mc_pipeline_init();
+#endif
+#ifdef USE_MCPWM_STEPS
+    mcpwm_steps_init();  // The motors attach their step pins to it
+#endif
     init_motors();
+    boot_stage("motors");
     system_ini();  // Configure pinout pins and pin-change interrupt (Renamed due to conflict with esp32 files)
     memset(sys_position, 0, sizeof(sys_position));  // Clear machine position.
+    bool position_kept = warm_restart_restore();    // Unless it survived a restart of the CPU
 
 #ifdef USE_MACHINE_INIT
     machine_init();  // user supplied function for special initialization
+#endif
+#ifdef USE_KINEMATICS
+    kinematics_init();
+#endif
+#ifdef ENABLE_SPINDLE_SYNC
+    spindle_encoder_init();
+#endif
+#ifdef ENABLE_AXIS_ENCODERS
+    axis_encoder_init();
+#endif
+#ifdef ENABLE_AUX_STREAM
+    aux_stream_init();
+#endif
+#ifdef ENABLE_PROBE_SCAN
+    probe_scan_init();
+#endif
+#ifdef ENABLE_LASER_PPI
+    laser_ppi_init();
+#endif
+#ifdef ENABLE_TIMELINE
+    timeline_init();
 #endif
     // Initialize system state.
 #ifdef FORCE_INITIALIZATION_ALARM
@@ -61,21 +109,23 @@ void grbl_init() {
     // not after disabling the alarm locks. Prevents motion startup blocks from crashing into
     // things uncontrollably. Very bad.
 #ifdef HOMING_INIT_LOCK
-    if (homing_enable->get()) {
+    if (homing_enable->get() && !position_kept) {
         sys.state = State::Alarm;
     }
 #endif
+    boot_stage("system");
     Spindles::Spindle::select();
-#ifdef ENABLE_WIFI
-    WebUI::wifi_config.begin();
-#endif
-#ifdef ENABLE_BLUETOOTH
-    WebUI::bt_config.begin();
-#endif
+    boot_stage("spindle");
     WebUI::inputBuffer.begin();
+    boot_stage("ready");
+    // Connecting to an access point can take seconds. Motion doesn't have to wait for it.
+    boot_start_network();
 }
 
 static void reset_variables() {
+#ifdef MOTION_PIPELINE
+    mc_pipeline_reset();  // Drop queued moves while sys.abort still keeps the motion task from planning
+#endif
     // Reset system variables.
     State prior_state = sys.state;
     memset(&sys, 0, sizeof(system_t));  // Clear system struct variable.
@@ -89,9 +139,24 @@ static void reset_variables() {
     cycle_stop                     = false;
     sys_rt_exec_motion_override    = 0;
     sys_rt_exec_accessory_override = 0;
+#ifdef REALTIME_EVENT_QUEUE
+    system_reset_exec_events();
+#endif
     system_clear_exec_alarm();
     // Reset Grbl primary systems.
     serial_reset_read_buffer(CLIENT_ALL);  // Clear serial read buffer
+#ifdef ENABLE_BINARY_STREAM
+    binary_stream_reset();  // Drop queued binary motion records
+#endif
+#ifdef SYNC_USER_OUTPUTS
+    sys_output_events_reset(true);  // Drop synchronized output events
+#endif
+#if defined(ENABLE_WIFI) && defined(ENABLE_NETWORK_SYNC)
+    WebUI::network_sync.cancel();  // Drop a held or scheduled cycle start
+#endif
+#ifdef ENABLE_PROBE_SCAN
+    probe_scan_stop();
+#endif
     gc_init();                             // Set g-code parser to default state
     spindle->stop();
     coolant_init();
@@ -99,6 +164,9 @@ static void reset_variables() {
     probe_init();
     plan_reset();  // Clear block buffer and planner variables
     st_reset();    // Clear stepper subsystem variables
+#ifdef ENABLE_AUX_STREAM
+    aux_stream_reset();  // Stopped by mc_reset() with the other axes
+#endif
     // Sync cleared gcode and planner positions to current system position.
     plan_sync_position();
     gc_sync_position();
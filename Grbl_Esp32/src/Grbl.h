@@ -37,9 +37,12 @@ const char* const GRBL_VERSION_BUILD = "20200928";
 
 // Define the Grbl system include files. NOTE: Do not alter organization.
 #include "Config.h"
+#include "TaskConfig.h"
 #include "NutsBolts.h"
 
 #include "Defaults.h"
+#include "MachineTraits.h"
+#include "HotPath.h"
 #include "Error.h"
 #include "SettingsStorage.h"
 #include "WebUI/Authentication.h"
@@ -55,15 +58,79 @@ const char* const GRBL_VERSION_BUILD = "20200928";
 #include "Probe.h"
 #include "Protocol.h"
 #include "Report.h"
+#include "ClientOutput.h"
+#include "DeferredMsg.h"
+#include "Metrics.h"
 #include "Serial.h"
+#include "Rs485Bus.h"
 #include "Pins.h"
 #include "Spindles/Spindle.h"
 #include "Motors/Motors.h"
 #include "Stepper.h"
 #include "Jog.h"
+#ifdef USE_KINEMATICS
+#    include "Kinematics.h"
+#endif
+#ifdef ENABLE_BINARY_STREAM
+#    include "BinaryStream.h"
+#endif
+#ifdef ENABLE_LASER_RASTER
+#    include "Raster.h"
+#endif
+#ifdef ENABLE_SPINDLE_SYNC
+#    include "SpindleSync.h"
+#endif
+#ifdef ENABLE_AXIS_ENCODERS
+#    include "AxisEncoder.h"
+#endif
+#ifdef ENABLE_AUX_STREAM
+#    include "AuxStream.h"
+#endif
+#ifdef ENABLE_PROBE_SCAN
+#    include "ProbeScan.h"
+#endif
+#ifdef ENABLE_LASER_PPI
+#    include "LaserPPI.h"
+#endif
+#include "TaskStats.h"
+#ifdef ENABLE_MEMORY_STATS
+#    include "MemoryStats.h"
+#endif
+#include "BootTrace.h"
+#include "Simulator.h"
+#include "IdlePower.h"
+#include "WarmRestart.h"
+#ifdef ENABLE_REALTIME_TRACE
+#    include "RealtimeTrace.h"
+#endif
+#ifdef ENABLE_TIMELINE
+#    include "Timeline.h"
+#endif
+#ifdef ENABLE_STEP_CAPTURE
+#    include "StepCapture.h"
+#endif
+#ifdef ENABLE_JOB_STATS
+#    include "JobStats.h"
+#endif
+#ifdef INPUT_SHAPING
+#    include "InputShaper.h"
+#endif
+#ifdef PATH_BLENDING
+#    include "PathBlending.h"
+#endif
+#ifdef ENABLE_HEIGHT_MAP
+#    include "HeightMap.h"
+#endif
+#ifdef ENABLE_O_CODES
+#    include "OCode.h"
+#endif
+#ifdef ENABLE_MACROS
+#    include "Macros.h"
+#endif
 #include "WebUI/InputBuffer.h"
 #include "Settings.h"
 #include "SettingsDefinitions.h"
+#include "MotionConfig.h"
 #include "WebUI/WebSettings.h"
 
 #include "UserOutput.h"
@@ -77,12 +144,21 @@ const char* const GRBL_VERSION_BUILD = "20200928";
 
 #ifdef ENABLE_WIFI
 #    include "WebUI/WifiConfig.h"
+#    ifdef ENABLE_ETHERNET
+#        include "WebUI/EthConfig.h"
+#    endif
 #    ifdef ENABLE_HTTP
 #        include "WebUI/Serial2Socket.h"
 #    endif
 #    ifdef ENABLE_TELNET
 #        include "WebUI/TelnetServer.h"
 #    endif
+#    ifdef ENABLE_UDP_STREAM
+#        include "WebUI/UdpStream.h"
+#    endif
+#    ifdef ENABLE_NETWORK_SYNC
+#        include "WebUI/NetworkSync.h"
+#    endif
 #    ifdef ENABLE_NOTIFICATIONS
 #        include "WebUI/NotificationsService.h"
 #    endif
@@ -91,6 +167,12 @@ const char* const GRBL_VERSION_BUILD = "20200928";
 #ifdef USE_I2S_OUT
 #    include "I2SOut.h"
 #endif
+#ifdef USE_I2S_IN
+#    include "I2SIn.h"
+#endif
+#ifdef USE_MCPWM_STEPS
+#    include "McpwmSteps.h"
+#endif
 
 void grbl_init();
 void run_once();
@@ -102,12 +184,8 @@ void machine_init();
 bool user_defined_homing();
 
 // Called if USE_KINEMATICS is defined
-void inverse_kinematics(float* target, plan_line_data_t* pl_data, float* position);
-bool kinematics_pre_homing(uint8_t cycle_mask);
-void kinematics_post_homing();
-
-// Called if USE_FWD_KINEMATICS is defined
-void forward_kinematics(float* position);
+class Kinematics;
+Kinematics* machine_kinematics();
 
 // Called if MACRO_BUTTON_0_PIN or MACRO_BUTTON_1_PIN or MACRO_BUTTON_2_PIN is defined
 void user_defined_macro(uint8_t index);
@@ -0,0 +1,414 @@
+/*
+  HeightMap.cpp - Z compensation from a probed grid
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_HEIGHT_MAP
+
+static const char*    HEIGHT_MAP_KEY     = "heightmap";
+static const uint16_t HEIGHT_MAP_VERSION = 1;
+
+// Grid lines closer than this to a point, in cells, are taken as passed
+const float HEIGHT_MAP_EPSILON = 1e-4;
+
+// The part after nx and ny is stored in NVS as far as the grid goes.
+typedef struct {
+    uint16_t version;
+    uint8_t  nx;
+    uint8_t  ny;
+    float    x0;  // Machine position of the first point
+    float    y0;
+    float    dx;  // Spacing of the points
+    float    dy;
+    float    z[HEIGHT_MAP_MAX_POINTS];  // Row by row, relative to the first point
+} height_map_t;
+
+static height_map_t map;
+static bool         active    = false;
+static bool         splitting = false;  // mc_line() is planning the pieces of a move
+static bool         synced    = false;  // position[] is where the next move starts
+static float        position[MAX_N_AXIS];  // Uncompensated target of the last move
+
+// Coefficients of the last cell looked up, z = a + b * u + c * v + d * u * v
+static struct {
+    int   ix;
+    int   iy;
+    float a;
+    float b;
+    float c;
+    float d;
+} cell = { -1, -1 };
+
+static size_t height_map_size(uint8_t nx, uint8_t ny) {
+    return offsetof(height_map_t, z) + nx * ny * sizeof(float);
+}
+
+// Finds the cell of a point, clamped to the grid, and its position u, v in the cell, 0 to 1.
+static void height_map_cell(float x, float y, float& u, float& v) {
+    float fx = constrain((x - map.x0) / map.dx, 0.0f, float(map.nx - 1));
+    float fy = constrain((y - map.y0) / map.dy, 0.0f, float(map.ny - 1));
+    int   ix = MIN(int(fx), map.nx - 2);
+    int   iy = MIN(int(fy), map.ny - 2);
+    u        = fx - ix;
+    v        = fy - iy;
+    if (ix != cell.ix || iy != cell.iy) {
+        const float* z = &map.z[iy * map.nx + ix];
+        cell.a         = z[0];
+        cell.b         = z[1] - z[0];
+        cell.c         = z[map.nx] - z[0];
+        cell.d         = z[map.nx + 1] - z[map.nx] - z[1] + z[0];
+        cell.ix        = ix;
+        cell.iy        = iy;
+    }
+}
+
+static float height_map_offset(float x, float y) {
+    float u, v;
+    height_map_cell(x, y, u, v);
+    return cell.a + cell.b * u + cell.c * v + cell.d * u * v;
+}
+
+// The next t after t at which p0 + t * dp crosses one of the n grid lines from g0 on, 1 if none does.
+static float height_map_crossing(float t, float p0, float dp, float g0, float spacing, int n) {
+    if (dp == 0.0) {
+        return 1.0;
+    }
+    float f = (p0 + t * dp - g0) / spacing;
+    int   k;
+    if (dp > 0.0) {
+        k = MAX(int(floorf(f + HEIGHT_MAP_EPSILON)) + 1, 0);
+        if (k > n - 1) {
+            return 1.0;
+        }
+    } else {
+        k = MIN(int(ceilf(f - HEIGHT_MAP_EPSILON)) - 1, n - 1);
+        if (k < 0) {
+            return 1.0;
+        }
+    }
+    float tk = (g0 + k * spacing - p0) / dp;
+    return tk < 1.0 ? tk : 1.0;
+}
+
+// Plans the move from t0 to t1, with its end point raised by z. The feed of an inverse time move is a
+// time for the whole move, so the piece gets its share of it.
+static void height_map_piece(const float* from, const float* delta, float t0, float t1, float z, plan_line_data_t* pl_data, float feed) {
+    float piece[MAX_N_AXIS];
+    for (uint8_t axis = 0; axis < MAX_N_AXIS; axis++) {
+        piece[axis] = t1 < 1.0 ? from[axis] + t1 * delta[axis] : from[axis] + delta[axis];
+    }
+    piece[Z_AXIS] += z;
+    if (pl_data->motion.inverseTime) {
+        pl_data->feed_rate = feed / (t1 - t0);
+    }
+    mc_line(piece, pl_data);
+}
+
+// Walks the cells the move passes, from grid line to grid line, extending one chord over them as long
+// as the offset at the points passed stays within the tolerance of it.
+static void height_map_split(const float* from, const float* delta, plan_line_data_t* pl_data) {
+    float feed = pl_data->feed_rate;
+    float ts   = 0.0;  // Start of the chord
+    float zs   = height_map_offset(from[X_AXIS], from[Y_AXIS]);
+    float tp   = 0.0;  // End of the pieces it covers so far
+    float zp   = zs;
+    float check_t[HEIGHT_MAP_CHECK_POINTS];
+    float check_z[HEIGHT_MAP_CHECK_POINTS];
+    int   n_check = 0;
+    // Rate of u and v along the move. d * du * dv is the t^2 term of the offset inside a cell.
+    float du = delta[X_AXIS] / map.dx;
+    float dv = delta[Y_AXIS] / map.dy;
+
+    float t = 0.0;
+    while (t < 1.0 && !sys.abort) {
+        float te = MIN(height_map_crossing(t, from[X_AXIS], delta[X_AXIS], map.x0, map.dx, map.nx),
+                       height_map_crossing(t, from[Y_AXIS], delta[Y_AXIS], map.y0, map.dy, map.ny));
+        float tm = 0.5 * (t + te);
+        float u, v;
+        height_map_cell(from[X_AXIS] + tm * delta[X_AXIS], from[Y_AXIS] + tm * delta[Y_AXIS], u, v);
+        float zm = cell.a + cell.b * u + cell.c * v + cell.d * u * v;
+        // Outside the grid the offset does not change along the clamped direction
+        float curve = cell.d * (u > 0.0 && u < 1.0 ? du : 0.0) * (v > 0.0 && v < 1.0 ? dv : 0.0);
+        float bend  = fabsf(curve) * (te - t) * (te - t) * 0.25;  // Largest distance of the chord
+        float ze    = height_map_offset(from[X_AXIS] + te * delta[X_AXIS], from[Y_AXIS] + te * delta[Y_AXIS]);
+
+        if (bend > HEIGHT_MAP_TOLERANCE) {
+            // A twisted cell. Plan the chord so far, then the piece in parts short enough to follow it.
+            if (tp > ts) {
+                height_map_piece(from, delta, ts, tp, zp, pl_data, feed);
+                ts = tp;
+            }
+            int parts = ceilf(sqrtf(bend / HEIGHT_MAP_TOLERANCE));
+            for (int i = 1; i <= parts && !sys.abort; i++) {
+                float ti = i < parts ? t + (te - t) * i / parts : te;
+                float zi = i < parts ? height_map_offset(from[X_AXIS] + ti * delta[X_AXIS], from[Y_AXIS] + ti * delta[Y_AXIS]) : ze;
+                height_map_piece(from, delta, ts, ti, zi, pl_data, feed);
+                ts = ti;
+            }
+            zs      = ze;
+            tp      = te;
+            zp      = ze;
+            n_check = 0;
+            t       = te;
+            continue;
+        }
+
+        bool fits = n_check + 2 <= HEIGHT_MAP_CHECK_POINTS;
+        if (fits) {
+            if (tp > ts) {
+                check_t[n_check]   = tp;
+                check_z[n_check++] = zp;
+            }
+            check_t[n_check]   = tm;
+            check_z[n_check++] = zm;
+            float slope        = (ze - zs) / (te - ts);
+            for (int i = 0; fits && i < n_check; i++) {
+                fits = fabsf(zs + slope * (check_t[i] - ts) - check_z[i]) <= HEIGHT_MAP_TOLERANCE;
+            }
+        }
+        if (!fits && tp > ts) {
+            // The chord ends where the last piece did, and a new one starts with this piece
+            height_map_piece(from, delta, ts, tp, zp, pl_data, feed);
+            ts         = tp;
+            zs         = zp;
+            check_t[0] = tm;
+            check_z[0] = zm;
+            n_check    = 1;
+        }
+        tp = te;
+        zp = ze;
+        t  = te;
+    }
+    if (ts < 1.0 && !sys.abort) {
+        height_map_piece(from, delta, ts, 1.0, zp, pl_data, feed);
+    }
+    pl_data->feed_rate = feed;
+}
+
+bool height_map_line(float* target, plan_line_data_t* pl_data) {
+    if (!active || splitting) {
+        return false;
+    }
+    if (!synced) {
+        system_convert_array_steps_to_mpos(position, sys_position);
+        height_map_uncompensate(position);
+        synced = true;
+    }
+    float from[MAX_N_AXIS];
+    float delta[MAX_N_AXIS];
+    memcpy(from, position, sizeof(from));
+    for (uint8_t axis = 0; axis < MAX_N_AXIS; axis++) {
+        delta[axis] = target[axis] - from[axis];
+    }
+    memcpy(position, target, sizeof(position));
+
+    splitting  = true;
+    bool whole = false;
+#    ifdef ENABLE_LASER_RASTER
+    whole = whole || pl_data->raster != NULL;  // The scanline is laid out along the one block
+#    endif
+#    ifdef ENABLE_SPINDLE_SYNC
+    whole = whole || pl_data->sync_pitch != 0.0;  // The caller reads sync_start back
+#    endif
+    if (whole) {
+        height_map_piece(from, delta, 0.0, 1.0, height_map_offset(target[X_AXIS], target[Y_AXIS]), pl_data, pl_data->feed_rate);
+    } else {
+        height_map_split(from, delta, pl_data);
+    }
+    splitting = false;
+    return true;
+}
+
+void height_map_uncompensate(float* position) {
+    if (active) {
+        position[Z_AXIS] -= height_map_offset(position[X_AXIS], position[Y_AXIS]);
+    }
+}
+
+void height_map_sync() {
+    synced = false;
+}
+
+// Switches the compensation with the machine at rest. The parser position takes the change, so the
+// next move continues from where the tool is.
+static void height_map_activate(bool on) {
+    active  = on;
+    cell.ix = -1;
+    synced  = false;
+    gc_sync_position();
+}
+
+// Reads the comma separated numbers of value. Returns how many there were, or -1 on a bad one.
+static int height_map_parse(const char* value, float* numbers, int max) {
+    int n = 0;
+    while (*value) {
+        char* end;
+        if (n == max) {
+            return -1;
+        }
+        numbers[n++] = strtof(value, &end);
+        if (end == value || (*end != ',' && *end != '\0')) {
+            return -1;
+        }
+        value = *end ? end + 1 : end;
+    }
+    return n;
+}
+
+Error height_map_probe(const char* value, uint8_t client) {
+    float args[8];
+    int   n = value ? height_map_parse(value, args, 8) : -1;
+    if (n < 6) {
+        return Error::InvalidValue;
+    }
+    int   nx    = int(args[4]);
+    int   ny    = int(args[5]);
+    float depth = n > 6 ? args[6] : HEIGHT_MAP_PROBE_DEPTH;
+    float feed  = n > 7 ? args[7] : HEIGHT_MAP_PROBE_FEED;
+    if (nx < 2 || ny < 2 || nx * ny > HEIGHT_MAP_MAX_POINTS || args[2] <= args[0] || args[3] <= args[1] || depth <= 0.0 ||
+        feed <= 0.0) {
+        return Error::InvalidValue;
+    }
+    if (sys.state != State::Idle) {
+        return Error::IdleError;
+    }
+    protocol_buffer_synchronize();
+    if (sys.abort) {
+        return Error::Ok;
+    }
+    height_map_activate(false);  // The probe moves go where they are sent
+
+    height_map_t& grid = map;  // Not used while the compensation is off
+    grid.version       = HEIGHT_MAP_VERSION;
+    grid.nx            = nx;
+    grid.ny            = ny;
+    grid.x0            = args[0] + gc_state.coord_system[X_AXIS] + gc_state.coord_offset[X_AXIS];
+    grid.y0            = args[1] + gc_state.coord_system[Y_AXIS] + gc_state.coord_offset[Y_AXIS];
+    grid.dx            = (args[2] - args[0]) / (nx - 1);
+    grid.dy            = (args[3] - args[1]) / (ny - 1);
+
+    float start[MAX_N_AXIS];
+    system_convert_array_steps_to_mpos(start, sys_position);
+    float clear_z = start[Z_AXIS];
+
+    plan_line_data_t move;
+    memset(&move, 0, sizeof(move));
+    move.spindle       = gc_state.modal.spindle;
+    move.spindle_speed = gc_state.spindle_speed;
+    move.coolant       = gc_state.modal.coolant;
+    plan_line_data_t probe_move;
+
+    float target[MAX_N_AXIS];
+    memcpy(target, start, sizeof(target));
+    for (int iy = 0; iy < ny; iy++) {
+        for (int k = 0; k < nx; k++) {
+            int ix = (iy & 1) ? nx - 1 - k : k;  // Back and forth
+            // Rapid over the point, probe down and back up
+            target[X_AXIS]          = grid.x0 + ix * grid.dx;
+            target[Y_AXIS]          = grid.y0 + iy * grid.dy;
+            target[Z_AXIS]          = clear_z;
+            move.motion.rapidMotion = 1;
+            mc_line(target, &move);
+            if (sys.abort) {
+                gc_sync_position();
+                return Error::Ok;
+            }
+            probe_move                    = move;
+            probe_move.motion.rapidMotion = 0;
+            probe_move.feed_rate          = feed;
+            target[Z_AXIS]                = clear_z - depth;
+            mc_probe_cycle(target, &probe_move, 0);  // Waits for the moves before it
+            gc_sync_position();
+            if (sys.abort || !sys.probe_succeeded) {
+                return sys.abort ? Error::Ok : Error::SystemGcLock;  // The failed probe raised an alarm
+            }
+            float contact[MAX_N_AXIS];
+            system_convert_array_steps_to_mpos(contact, sys_probe_position);
+            grid.z[iy * nx + ix] = contact[Z_AXIS];
+            target[Z_AXIS]       = clear_z;
+            mc_line(target, &move);
+        }
+    }
+    protocol_buffer_synchronize();
+    if (sys.abort) {
+        gc_sync_position();
+        return Error::Ok;
+    }
+
+    float low  = 0.0;
+    float high = 0.0;
+    for (int i = nx * ny - 1; i >= 0; i--) {
+        grid.z[i] -= grid.z[0];
+        low  = MIN(low, grid.z[i]);
+        high = MAX(high, grid.z[i]);
+    }
+    height_map_activate(true);
+    grbl_sendf(client, "[MSG: Height map %dx%d probed, Z %.3f to %.3f]\r\n", nx, ny, low, high);
+    return Error::Ok;
+}
+
+Error height_map_show(uint8_t client) {
+    if (!active) {
+        grbl_sendf(client, "[MSG: Height map off]\r\n");
+        return Error::Ok;
+    }
+    grbl_sendf(client, "[HM:%.3f,%.3f,%.3f,%.3f,%d,%d]\r\n", map.x0, map.y0, map.dx, map.dy, map.nx, map.ny);
+    for (int iy = 0; iy < map.ny; iy++) {
+        static char line[16 + 10 * HEIGHT_MAP_MAX_POINTS / 2];  // The longest row, off the stack
+        int         len = snprintf(line, sizeof(line), "[HM%d:", iy);
+        for (int ix = 0; ix < map.nx && len < int(sizeof(line)); ix++) {
+            len += snprintf(line + len, sizeof(line) - len, ix ? ",%.3f" : "%.3f", map.z[iy * map.nx + ix]);
+        }
+        grbl_sendf(client, "%s]\r\n", line);
+    }
+    return Error::Ok;
+}
+
+Error height_map_save() {
+    if (!active) {
+        return Error::InvalidValue;
+    }
+    if (nvs_set_blob(Setting::_handle, HEIGHT_MAP_KEY, &map, height_map_size(map.nx, map.ny)) || nvs_commit(Setting::_handle)) {
+        return Error::NvsSetFailed;
+    }
+    return Error::Ok;
+}
+
+Error height_map_load(uint8_t client) {
+    height_map_t grid;
+    size_t       length = sizeof(grid);
+    if (nvs_get_blob(Setting::_handle, HEIGHT_MAP_KEY, &grid, &length) != ESP_OK) {
+        return Error::SettingReadFail;
+    }
+    if (length < offsetof(height_map_t, z) || grid.version != HEIGHT_MAP_VERSION || grid.nx < 2 || grid.ny < 2 ||
+        grid.nx * grid.ny > HEIGHT_MAP_MAX_POINTS || length != height_map_size(grid.nx, grid.ny)) {
+        return Error::SettingReadFail;
+    }
+    protocol_buffer_synchronize();
+    memcpy(&map, &grid, length);
+    height_map_activate(true);
+    grbl_sendf(client, "[MSG: Height map %dx%d loaded]\r\n", map.nx, map.ny);
+    return Error::Ok;
+}
+
+void height_map_clear() {
+    protocol_buffer_synchronize();
+    height_map_activate(false);
+}
+
+#endif
@@ -0,0 +1,78 @@
+#pragma once
+
+/*
+  HeightMap.h - Z compensation from a probed grid
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  $HeightMap/Probe=<x0>,<y0>,<x1>,<y1>,<nx>,<ny>[,<depth>[,<feed>]] probes a grid of nx by ny points
+  over the rectangle from x0,y0 to x1,y1, in the current work coordinates. It starts at the current Z
+  and returns to it between the points; each point is probed down by depth mm at feed mm/min. The
+  heights are kept relative to the first point, so Z zero is set there.
+
+  While the map is active, mc_line() adds the height of the surface under the tool to the Z of every
+  move, interpolated bilinearly between the four points around it. Along a straight move the offset
+  is linear within a cell only when the cell is flat or tilted; a twisted cell bends it into a
+  parabola, and at the grid lines its slope changes. The move is split where these differences exceed
+  HEIGHT_MAP_TOLERANCE and nowhere else, so moves over flat parts of the map, and moves of Z only, stay
+  one planner block. Moves outside the grid get the height of its nearest edge.
+
+  The reports show the compensated machine position. gc_sync_position() takes the offset off again,
+  so the parser works in the coordinates of the program with and without the map. Laser scanlines and
+  spindle synchronized moves are only compensated at their end points.
+
+  $HeightMap/Save stores the map in NVS, where it survives a restart, and $HeightMap/Load makes the
+  stored map active. $HeightMap/Clear turns the compensation off. $HeightMap/Show lists the heights.
+*/
+
+#include "Grbl.h"
+
+// Largest grid, in points
+#ifndef HEIGHT_MAP_MAX_POINTS
+#    define HEIGHT_MAP_MAX_POINTS 256
+#endif
+// Largest error of the compensated path against the interpolated surface, in mm
+#ifndef HEIGHT_MAP_TOLERANCE
+#    define HEIGHT_MAP_TOLERANCE 0.005
+#endif
+// Points of a move checked against one chord before the chord is planned anyway
+#ifndef HEIGHT_MAP_CHECK_POINTS
+#    define HEIGHT_MAP_CHECK_POINTS 16
+#endif
+// Defaults of the optional $HeightMap/Probe parameters
+#ifndef HEIGHT_MAP_PROBE_DEPTH
+#    define HEIGHT_MAP_PROBE_DEPTH 5.0  // mm
+#endif
+#ifndef HEIGHT_MAP_PROBE_FEED
+#    define HEIGHT_MAP_PROBE_FEED 100.0  // mm/min
+#endif
+
+// Plans the move from the last target to this one as compensated pieces, through mc_line(). Returns
+// false if the map is off or the move is one of those pieces, for mc_line() to plan it as is.
+bool height_map_line(float* target, plan_line_data_t* pl_data);
+
+// Removes the offset from a compensated machine position.
+void height_map_uncompensate(float* position);
+
+// The planner position was set from sys_position, the next move starts there.
+void height_map_sync();
+
+Error height_map_probe(const char* value, uint8_t client);
+Error height_map_show(uint8_t client);
+Error height_map_save();
+Error height_map_load(uint8_t client);
+void  height_map_clear();
@@ -0,0 +1,78 @@
+/*
+  HotPath.cpp - placement and cache profiling of the motion pipeline
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_CACHE_PROFILING
+
+#    include <perfmon.h>  // ESP-IDF perfmon component
+
+// The performance counter used for the cache misses
+static const int CACHE_MISS_COUNTER = 0;
+
+static hot_path_stats_t hot_path_stats[int(HotPath::Count)];
+static int              profile_core = -1;
+
+static const char* const hot_path_names[int(HotPath::Count)] = {
+    "gc_execute_line", "mc_line", "plan_buffer_line", "planner_recalculate", "st_prep_buffer", "spindle set_rpm",
+};
+
+void cache_profile_init() {
+    xtensa_perfmon_stop();
+    xtensa_perfmon_init(CACHE_MISS_COUNTER, XTPERF_CNT_I_MEM, XTPERF_MASK_I_MEM_CACHE_MISS, 0, -1);
+    xtensa_perfmon_reset(CACHE_MISS_COUNTER);
+    xtensa_perfmon_start();
+    profile_core = xPortGetCoreID();
+}
+
+const hot_path_stats_t* cache_profile_get(HotPath path) {
+    return &hot_path_stats[int(path)];
+}
+
+const char* cache_profile_name(HotPath path) {
+    return hot_path_names[int(path)];
+}
+
+void cache_profile_reset() {
+    memset(hot_path_stats, 0, sizeof(hot_path_stats));
+}
+
+HotPathProfile::HotPathProfile(HotPath path) : _path(path) {
+    _counted = xPortGetCoreID() == profile_core;
+    if (_counted) {
+        _start_misses = xtensa_perfmon_value(CACHE_MISS_COUNTER);
+        _start_cycles = xthal_get_ccount();
+    }
+}
+
+HotPathProfile::~HotPathProfile() {
+    if (!_counted) {
+        return;
+    }
+    uint32_t          cycles = xthal_get_ccount() - _start_cycles;
+    uint32_t          misses = xtensa_perfmon_value(CACHE_MISS_COUNTER) - _start_misses;
+    hot_path_stats_t& stats  = hot_path_stats[int(_path)];
+    stats.calls++;
+    stats.cycles += cycles;
+    stats.cache_misses += misses;
+    if (cycles > stats.max_cycles) {
+        stats.max_cycles = cycles;
+    }
+}
+
+#endif
@@ -0,0 +1,85 @@
+#pragma once
+
+/*
+  HotPath.h - placement and cache profiling of the motion pipeline
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  The functions that run for every line, block or segment between the parser and the step ISR are
+  marked MOTION_IRAM. With MOTION_IRAM_PLACEMENT they are linked into IRAM and no longer wait for the
+  flash cache, which Wi-Fi and SD card traffic keep evicting. Only the code moves: the constants and
+  strings these functions read, and the library functions they call, stay in flash.
+
+  With ENABLE_CACHE_PROFILING, HOT_PATH_PROFILE(id) at the top of one of these functions counts its
+  calls, CPU cycles and instruction fetches that missed the flash cache until it returns. The misses
+  come from an Xtensa performance counter of the core that ran cache_profile_init(); calls on the
+  other core are not counted. The counts include the functions called and the interrupts taken in
+  between. $Profile/Cache lists them and $Profile/Cache=0 clears them. Comparing a build with and
+  without MOTION_IRAM_PLACEMENT under the same load shows what the placement buys.
+*/
+
+#include "Grbl.h"
+
+#ifdef MOTION_IRAM_PLACEMENT
+#    define MOTION_IRAM IRAM_ATTR
+#else
+#    define MOTION_IRAM
+#endif
+
+#ifdef ENABLE_CACHE_PROFILING
+
+enum class HotPath : uint8_t {
+    GCodeLine = 0,    // gc_execute_line()
+    McLine,           // mc_line()
+    PlanBufferLine,   // plan_buffer_line()
+    PlanRecalculate,  // planner_recalculate()
+    StPrepBuffer,     // st_prep_buffer()
+    SpindleSetRpm,    // PWM::set_rpm()
+    Count,
+};
+
+typedef struct {
+    uint32_t calls;
+    uint64_t cycles;
+    uint32_t max_cycles;
+    uint64_t cache_misses;  // Instruction fetches that missed the flash cache
+} hot_path_stats_t;
+
+// Sets up the performance counter on the calling core.
+void cache_profile_init();
+
+const hot_path_stats_t* cache_profile_get(HotPath path);
+const char*             cache_profile_name(HotPath path);
+void                    cache_profile_reset();
+
+// Counts from its construction to the end of the scope.
+class HotPathProfile {
+public:
+    HotPathProfile(HotPath path);
+    ~HotPathProfile();
+
+private:
+    HotPath  _path;
+    bool     _counted;  // Running on the core with the counter
+    uint32_t _start_cycles;
+    uint32_t _start_misses;
+};
+
+#    define HOT_PATH_PROFILE(path) HotPathProfile hot_path_profile(path)
+#else
+#    define HOT_PATH_PROFILE(path)
+#endif
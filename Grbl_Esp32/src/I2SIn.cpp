@@ -0,0 +1,308 @@
+/*
+    I2SIn.cpp
+    Part of Grbl_ESP32
+
+    GPIO input expander using the ESP32 I2S peripheral (input)
+
+    A chain of 74HC165 shift registers is read by the I2S1 receiver in master mode.
+    The word select loads the parallel inputs and the bit clock shifts them out, so
+    the inputs are sampled by the hardware at a fixed rate into a ring of DMA buffers.
+    Each filled buffer raises an interrupt which looks for changes in its samples and
+    calls the callbacks attached to the pins that changed.
+
+    Grbl_ESP32 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Grbl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Grbl_ESP32.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "Config.h"
+
+#ifdef USE_I2S_IN
+
+#    include <FreeRTOS.h>
+#    include <driver/periph_ctrl.h>
+#    include <rom/lldesc.h>
+#    include <soc/i2s_struct.h>
+
+#    include "Pins.h"
+#    include "I2SIn.h"
+
+// Each sample is a left word, received while the inputs are loaded, and a right word
+// holding the inputs. The receiver keeps both, which does not depend on how the
+// single channel modes pick a channel.
+const int I2S_IN_WORDS_PER_SAMPLE = 2;
+const int I2S_IN_DMABUF_WORDS     = I2S_IN_DMABUF_SAMPLES * I2S_IN_WORDS_PER_SAMPLE;
+const int I2S_IN_DMABUF_LEN       = I2S_IN_DMABUF_WORDS * sizeof(uint32_t);
+
+static uint32_t*      i_dma_buffers[I2S_IN_DMABUF_COUNT];
+static lldesc_t*      i_dma_desc[I2S_IN_DMABUF_COUNT];
+static int            i_dma_scan_index;  // Next buffer to scan
+static intr_handle_t  i2s_in_isr_handle;
+static i2s_in_stats_t i2s_in_stats;
+
+typedef struct {
+    i2s_in_callback_t func;
+    int               mode;
+} i2s_in_attach_t;
+
+static i2s_in_attach_t   i2s_in_callbacks[I2S_IN_NUM_BITS];
+static volatile uint32_t i2s_in_attached;  // Bit n set when pin n has a callback
+static volatile uint32_t i2s_in_port_data;
+static volatile bool     i2s_in_primed;  // The first buffer sets the state without calling back
+
+static int i2s_in_initialized = 0;
+
+static inline uint32_t IRAM_ATTR i2s_in_sample_value(uint32_t word) {
+#    if I2S_IN_NUM_BITS == 32
+    return word;
+#    else
+    // The inputs are shifted in first, the bits after them read the SER of the last chip
+    return word >> (32 - I2S_IN_NUM_BITS);
+#    endif
+}
+
+static void IRAM_ATTR i2s_in_dispatch(uint32_t changed, uint32_t value) {
+    while (changed) {
+        int      pin  = __builtin_ctz(changed);
+        uint32_t mask = bit(pin);
+        changed &= ~mask;
+        i2s_in_attach_t& cb = i2s_in_callbacks[pin];
+        if ((cb.mode == CHANGE) || (cb.mode == RISING && (value & mask)) || (cb.mode == FALLING && !(value & mask))) {
+            cb.func();
+        }
+    }
+}
+
+static void IRAM_ATTR i2s_in_scan(const uint32_t* buffer) {
+    uint32_t last = i2s_in_port_data;
+    if (!i2s_in_primed) {
+        i2s_in_port_data = i2s_in_sample_value(buffer[I2S_IN_DMABUF_WORDS - 1]);
+        i2s_in_primed    = true;
+        return;
+    }
+    for (int i = 1; i < I2S_IN_DMABUF_WORDS; i += I2S_IN_WORDS_PER_SAMPLE) {
+        uint32_t value = i2s_in_sample_value(buffer[i]);
+        uint32_t diff  = value ^ last;
+        if (diff == 0) {
+            continue;
+        }
+        // Updated first, the callbacks read the pins of this sample
+        i2s_in_port_data = value;
+        last             = value;
+        i2s_in_stats.changes++;
+        i2s_in_dispatch(diff & i2s_in_attached, value);
+    }
+}
+
+static inline int IRAM_ATTR i2s_in_desc_index(lldesc_t* desc) {
+    for (int buf_idx = 0; buf_idx < I2S_IN_DMABUF_COUNT; buf_idx++) {
+        if (i_dma_desc[buf_idx] == desc) {
+            return buf_idx;
+        }
+    }
+    return 0;
+}
+
+//
+// I2S in DMA interrupt, once per filled buffer
+//
+static void IRAM_ATTR i2s_in_intr_handler(void* arg) {
+    if (I2S1.int_st.in_suc_eof) {
+        uint32_t start = xthal_get_ccount();
+        int      done  = i2s_in_desc_index((lldesc_t*)I2S1.in_eof_des_addr);
+        if (done != i_dma_scan_index) {
+            i2s_in_stats.late++;
+        }
+        // Scan in order up to the buffer just filled, in case an interrupt came late
+        while (true) {
+            int buf_idx      = i_dma_scan_index;
+            i_dma_scan_index = (buf_idx + 1) % I2S_IN_DMABUF_COUNT;
+            i2s_in_scan(i_dma_buffers[buf_idx]);
+            i2s_in_stats.buffers++;
+            if (buf_idx == done) {
+                break;
+            }
+        }
+        uint32_t cycles = xthal_get_ccount() - start;
+        if (cycles > i2s_in_stats.max_isr_cycles) {
+            i2s_in_stats.max_isr_cycles = cycles;
+        }
+    }
+    I2S1.int_clr.val = I2S1.int_st.val;  //clear pending interrupt
+}
+
+uint8_t IRAM_ATTR i2s_in_read(uint8_t pin) {
+    return !!(i2s_in_port_data & bit(pin));
+}
+
+void i2s_in_attach(uint8_t pin, i2s_in_callback_t func, int mode) {
+    if (pin >= I2S_IN_NUM_BITS) {
+        return;
+    }
+    i2s_in_detach(pin);
+    i2s_in_callbacks[pin].func = func;
+    i2s_in_callbacks[pin].mode = mode;
+    // The interrupt reads the mask before the callback, which is now in place
+    i2s_in_attached |= bit(pin);
+}
+
+void i2s_in_detach(uint8_t pin) {
+    if (pin >= I2S_IN_NUM_BITS) {
+        return;
+    }
+    i2s_in_attached &= ~bit(pin);
+}
+
+const i2s_in_stats_t* i2s_in_get_stats() {
+    return i2s_in_initialized ? &i2s_in_stats : nullptr;
+}
+
+void i2s_in_reset_stats() {
+    i2s_in_stats = {};
+}
+
+static int i2s_in_gpio_attach(uint8_t ws, uint8_t bck, uint8_t data) {
+    // The receiver is the master, it drives the clocks
+    pinMode(ws, OUTPUT);
+    pinMode(bck, OUTPUT);
+    pinMode(data, INPUT);
+    gpio_matrix_out(ws, I2S1I_WS_OUT_IDX, 0, 0);
+    gpio_matrix_out(bck, I2S1I_BCK_OUT_IDX, 0, 0);
+    gpio_matrix_in(data, I2S1I_DATA_IN15_IDX, 0);
+    return 0;
+}
+
+int i2s_in_init(i2s_in_init_t& init_param) {
+    if (i2s_in_initialized) {
+        // already initialized
+        return -1;
+    }
+
+    // Allocate the buffers and the DMA descriptors, linked in a ring
+    for (int buf_idx = 0; buf_idx < I2S_IN_DMABUF_COUNT; buf_idx++) {
+        i_dma_buffers[buf_idx] = (uint32_t*)heap_caps_calloc(1, I2S_IN_DMABUF_LEN, MALLOC_CAP_DMA);
+        i_dma_desc[buf_idx]    = (lldesc_t*)heap_caps_malloc(sizeof(lldesc_t), MALLOC_CAP_DMA);
+        if (i_dma_buffers[buf_idx] == nullptr || i_dma_desc[buf_idx] == nullptr) {
+            return -1;
+        }
+    }
+    for (int buf_idx = 0; buf_idx < I2S_IN_DMABUF_COUNT; buf_idx++) {
+        lldesc_t* desc     = i_dma_desc[buf_idx];
+        desc->owner        = 1;
+        desc->eof          = 0;
+        desc->sosf         = 0;
+        desc->length       = 0;
+        desc->size         = I2S_IN_DMABUF_LEN;
+        desc->buf          = (uint8_t*)i_dma_buffers[buf_idx];
+        desc->offset       = 0;
+        desc->qe.stqe_next = i_dma_desc[(buf_idx + 1) % I2S_IN_DMABUF_COUNT];
+    }
+    i_dma_scan_index = 0;
+    i2s_in_port_data = 0;
+    i2s_in_primed    = false;
+    i2s_in_attached  = 0;
+
+    // To make sure hardware is enabled before any hardware register operations.
+    periph_module_reset(PERIPH_I2S1_MODULE);
+    periph_module_enable(PERIPH_I2S1_MODULE);
+
+    i2s_in_gpio_attach(init_param.ws_pin, init_param.bck_pin, init_param.data_pin);
+
+    I2S1.conf.rx_start = 0;
+    I2S1.in_link.stop  = 1;
+    I2S1.int_ena.val   = 0;
+    I2S1.int_clr.val   = I2S1.int_st.val;  //clear pending interrupt
+
+    //reset i2s
+    I2S1.conf.rx_reset      = 1;
+    I2S1.conf.rx_reset      = 0;
+    I2S1.conf.rx_fifo_reset = 1;
+    I2S1.conf.rx_fifo_reset = 0;
+
+    //reset dma
+    I2S1.lc_conf.in_rst = 1;  // Set this bit to reset in DMA FSM. (R/W)
+    I2S1.lc_conf.in_rst = 0;
+
+    //Enable and configure DMA
+    I2S1.lc_conf.check_owner      = 0;
+    I2S1.lc_conf.indscr_burst_en  = 0;
+    I2S1.conf2.lcd_en             = 0;
+    I2S1.conf2.camera_en          = 0;
+    I2S1.pdm_conf.rx_pdm_en       = 0;
+    I2S1.pdm_conf.pdm2pcm_conv_en = 0;
+
+    I2S1.fifo_conf.rx_fifo_mod          = 2;  // 2: 32-bit dual channel data
+    I2S1.fifo_conf.rx_fifo_mod_force_en = 1;  //The bit should always be set to 1.
+    I2S1.fifo_conf.dscr_en              = 1;  //connect DMA to fifo
+    I2S1.conf_chan.rx_chan_mod          = 0;  // 0: dual channel
+    I2S1.sample_rate_conf.rx_bits_mod   = 32;
+    I2S1.conf.rx_mono                   = 0;
+
+    I2S1.conf.rx_slave_mod   = 0;  // Master
+    I2S1.conf.rx_msb_right   = 0;
+    I2S1.conf.rx_right_first = 0;  // The left word comes first in the buffer
+    I2S1.conf.rx_short_sync  = 0;
+    I2S1.conf.rx_msb_shift   = 0;  // The first input is on the data pin as soon as ws goes High
+
+    // fi2s = 160 MHz / I2S_IN_CLKM_DIV, fbck = fi2s / I2S_IN_BCK_DIV
+    I2S1.clkm_conf.clka_en               = 0;  // Use 160 MHz PLL_D2_CLK as reference
+    I2S1.clkm_conf.clkm_div_num          = I2S_IN_CLKM_DIV;
+    I2S1.clkm_conf.clkm_div_b            = 0;
+    I2S1.clkm_conf.clkm_div_a            = 0;
+    I2S1.sample_rate_conf.rx_bck_div_num = I2S_IN_BCK_DIV;
+
+    // An EOF each time a buffer is filled
+    I2S1.rx_eof_num         = I2S_IN_DMABUF_WORDS;
+    I2S1.int_ena.in_suc_eof = 1;
+
+    // Allocate and Enable the I2S interrupt on this core, the one that also runs the stepper
+    // timer and the GPIO interrupts, so the callbacks see the same ordering as with GPIO pins
+    esp_intr_alloc(ETS_I2S1_INTR_SOURCE, 0, i2s_in_intr_handler, nullptr, &i2s_in_isr_handle);
+    esp_intr_enable(i2s_in_isr_handle);
+
+    // Start the DMA and the receiver
+    I2S1.in_link.addr  = (uint32_t)i_dma_desc[0];
+    I2S1.in_link.start = 1;
+    I2S1.conf.rx_start = 1;
+
+    i2s_in_initialized = 1;
+
+    // The pins read 0 until the first buffer is in
+    for (int wait_ms = 0; !i2s_in_primed && wait_ms < 10; wait_ms++) {
+        delay(1);
+    }
+    return 0;
+}
+
+#    ifndef I2S_IN_WS
+#        define I2S_IN_WS GPIO_NUM_25
+#    endif
+#    ifndef I2S_IN_BCK
+#        define I2S_IN_BCK GPIO_NUM_26
+#    endif
+#    ifndef I2S_IN_DATA
+#        define I2S_IN_DATA GPIO_NUM_35
+#    endif
+/*
+  Initialize I2S in by default parameters.
+
+  return -1 ... already initialized or not enough memory
+*/
+int i2s_in_init() {
+    i2s_in_init_t default_param = {
+        .ws_pin   = I2S_IN_WS,
+        .bck_pin  = I2S_IN_BCK,
+        .data_pin = I2S_IN_DATA,
+    };
+    return i2s_in_init(default_param);
+}
+
+#endif
@@ -0,0 +1,129 @@
+#pragma once
+
+/*
+    I2SIn.h
+    Part of Grbl_ESP32
+    Header for a GPIO input expander using the ESP32 I2S peripheral
+    Grbl_ESP32 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    Grbl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with Grbl_ESP32.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// It should be included at the outset to know the machine configuration.
+#include "Config.h"
+
+#ifdef USE_I2S_IN
+
+#    include <stdint.h>
+
+/* Assert */
+#    if defined(I2S_IN_NUM_BITS)
+#        if (I2S_IN_NUM_BITS != 8) && (I2S_IN_NUM_BITS != 16) && (I2S_IN_NUM_BITS != 24) && (I2S_IN_NUM_BITS != 32)
+#            error "I2S_IN_NUM_BITS should be 8, 16, 24 or 32"
+#        endif
+#    else
+#        define I2S_IN_NUM_BITS 32 /* inputs of the 74HC165 chain, 8 per chip */
+#    endif
+
+#    define I2SI(n) (I2S_IN_PIN_BASE + n)
+
+/* The I2S1 receiver clocks the chain continuously, no CPU time is spent to sample it. */
+/*   fi2s = 160 MHz / I2S_IN_CLKM_DIV, fbck = fi2s / I2S_IN_BCK_DIV, 64 bck per sample */
+/*   1000000 usec / ((160000000 Hz) / 10 / 8) x 64 bit/sample = 32 usec/sample */
+#    ifndef I2S_IN_CLKM_DIV
+#        define I2S_IN_CLKM_DIV 10
+#    endif
+#    ifndef I2S_IN_BCK_DIV
+#        define I2S_IN_BCK_DIV 8 /* 2 MHz shift clock */
+#    endif
+const int I2S_IN_USEC_PER_SAMPLE = (64 * I2S_IN_CLKM_DIV * I2S_IN_BCK_DIV / 160);
+
+/* The samples are scanned for changes each time the DMA has filled a buffer with them. */
+#    ifndef I2S_IN_DMABUF_COUNT
+#        define I2S_IN_DMABUF_COUNT 3 /* number of DMA buffers to store samples */
+#    endif
+#    ifndef I2S_IN_DMABUF_SAMPLES
+#        define I2S_IN_DMABUF_SAMPLES 8 /* samples per buffer, one interrupt per buffer */
+#    endif
+
+/* Bound on the time from an input change to its callback, apart from the interrupt latency: */
+/* the change is latched by the next sample, which waits for its buffer to be filled. */
+const int I2S_IN_DELAY_DMABUF_US = (I2S_IN_DMABUF_SAMPLES * I2S_IN_USEC_PER_SAMPLE);
+const int I2S_IN_LATENCY_US      = (I2S_IN_DELAY_DMABUF_US + I2S_IN_USEC_PER_SAMPLE);
+
+typedef void (*i2s_in_callback_t)(void);
+
+typedef struct {
+    /*
+        I2S bitstream (one sample, 64 bck)
+        ------------------time line------------------------>
+             Left Channel                    Right Channel
+        ws   ________________________________~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+        bck  _~_~_~_~_~_~_~_~_~_~_~_~_~_~_~_~_~_~_~_~_~_~_~_~_~_~_~_~_~_~_~_~
+        data XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXvutsrqponmlkjihgfedcba9876543210
+             ^                               ^
+             Loads the inputs while ws is Low (SH/LD)
+                                             Shifts them out while ws is High (CLK)
+        The QH output of the 74HC165 next to the ESP32 drives the data pin, the QH of
+        each other chip drives the SER of the chip before it.
+        If I2S_IN_PIN_BASE is set to 192,
+        bit0: input A of the chip at the end of the chain, Expanded GPIO 192, ...
+    */
+    uint8_t ws_pin;
+    uint8_t bck_pin;
+    uint8_t data_pin;
+} i2s_in_init_t;
+
+/*
+  Initialize I2S in by parameters, and wait for the first samples.
+  return -1 ... already initialized or not enough memory
+*/
+int i2s_in_init(i2s_in_init_t& init_param);
+
+/*
+  Initialize I2S in by default parameters.
+    i2s_in_init_t default_param = {
+        .ws_pin = I2S_IN_WS,
+        .bck_pin = I2S_IN_BCK,
+        .data_pin = I2S_IN_DATA,
+    };
+  return -1 ... already initialized or not enough memory
+*/
+int i2s_in_init();
+
+/*
+  Read a bit state from the last sample.
+  pin: expanded pin No. (0..I2S_IN_NUM_BITS-1)
+*/
+uint8_t i2s_in_read(uint8_t pin);
+
+/*
+  Call func from the I2S interrupt when the pin changes.
+  pin:  expanded pin No. (0..I2S_IN_NUM_BITS-1)
+  mode: RISING, FALLING or CHANGE, as for attachInterrupt()
+  While func runs, i2s_in_read() returns the sample with the change.
+*/
+void i2s_in_attach(uint8_t pin, i2s_in_callback_t func, int mode);
+void i2s_in_detach(uint8_t pin);
+
+typedef struct {
+    uint32_t buffers;         // DMA buffers scanned
+    uint32_t changes;         // Samples that differed from the one before
+    uint32_t max_isr_cycles;  // Longest scan, callbacks included
+    uint32_t late;            // Interrupts that found more than one buffer to scan
+} i2s_in_stats_t;
+
+/*
+   Get the sampling statistics, or reset them.
+ */
+const i2s_in_stats_t* i2s_in_get_stats();
+void                  i2s_in_reset_stats();
+
+#endif
@@ -66,6 +66,7 @@
 //   = 2000 / 4 x 4
 //   = 2000us = 2ms
 // If I2S_OUT_DMABUF_COUNT is 5, it will take about 10 ms for all the DMA buffer transfers to finish.
+// With I2S_OUT_LOW_LATENCY, 4 buffers of 256 bytes take about 1 ms, refilled every 256 us.
 //
 // Increasing I2S_OUT_DMABUF_COUNT has the effect of preventing buffer underflow,
 // but on the other hand, it leads to a delay with pulse and/or non-pulse-generated I/Os.
@@ -83,12 +84,15 @@ typedef struct {
     uint32_t**   buffers;
     uint32_t*    current;
     uint32_t     rw_pos;
+    int          fill_index;  // Index of the buffer "current" points to
     lldesc_t**   desc;
+    lldesc_t*    tail_desc;  // Last buffer with step data while WAITING
     xQueueHandle queue;
 } i2s_out_dma_t;
 
-static i2s_out_dma_t o_dma;
-static intr_handle_t i2s_out_isr_handle;
+static i2s_out_dma_t   o_dma;
+static intr_handle_t   i2s_out_isr_handle;
+static i2s_out_stats_t i2s_out_stats;
 #    endif
 
 // output value
@@ -120,6 +124,7 @@ static int i2s_out_initialized = 0;
 #    ifdef USE_I2S_OUT_STREAM_IMPL
 static volatile uint64_t             i2s_out_pulse_period;
 static uint64_t                      i2s_out_remain_time_until_next_pulse;  // Time remaining until the next pulse (μsec)
+static uint32_t                      i2s_out_stream_samples;                // Samples filled into the DMA buffers before the current one
 static volatile i2s_out_pulse_func_t i2s_out_pulse_func;
 #    endif
 
@@ -172,6 +177,21 @@ static inline void i2s_out_single_data() {
 #    endif
 }
 
+#    ifdef USE_I2S_OUT_STREAM_IMPL
+// Switches the expanded outputs between the constant of conf_single_data, which i2s_out_write() updates
+// at once, and the DMA stream, without stopping the I2S. The DMA keeps running in both, filled with the
+// current outputs while static, so either switch is glitch free and takes no time.
+static inline void IRAM_ATTR i2s_out_select_static(bool is_static) {
+    if (is_static) {
+        i2s_out_single_data();
+        I2S0.conf_chan.tx_chan_mod = 3;  // 3:right+constant 4:left+constant (when tx_msb_right = 1)
+    } else {
+        I2S0.conf_chan.tx_chan_mod = 4;  // 3:right+constant 4:left+constant (when tx_msb_right = 1)
+        I2S0.conf_single_data      = 0;
+    }
+}
+#    endif
+
 static inline void i2s_out_reset_fifo_without_lock() {
     I2S0.conf.rx_fifo_reset = 1;
     I2S0.conf.rx_fifo_reset = 0;
@@ -371,12 +391,7 @@ static int IRAM_ATTR i2s_fillout_dma_buffer(lldesc_t* dma_desc) {
                         I2S_OUT_PULSER_ENTER_CRITICAL();  // Lock again.
                         // Calculate pulse period.
                         i2s_out_remain_time_until_next_pulse += i2s_out_pulse_period - I2S_OUT_USEC_PER_PULSE * (o_dma.rw_pos - old_rw_pos);
-                        if (i2s_out_pulser_status == WAITING) {
-                            // i2s_out_set_passthrough() has called from the pulse function.
-                            // It needs to go into pass-through mode.
-                            // This DMA descriptor must be a tail of the chain.
-                            dma_desc->qe.stqe_next = NULL;  // Cut the DMA descriptor ring. This allow us to identify the tail of the buffer.
-                        } else if (i2s_out_pulser_status == PASSTHROUGH) {
+                        if (i2s_out_pulser_status == PASSTHROUGH) {
                             // i2s_out_reset() has called during the execution of the pulse function.
                             // I2S has already in static mode, and buffers has cleared to zero.
                             // To prevent the pulse function from being called back,
@@ -390,21 +405,29 @@ static int IRAM_ATTR i2s_fillout_dma_buffer(lldesc_t* dma_desc) {
                 }
             }
             // no pulse data in push buffer (pulse off or idle or callback is not defined)
-            buf[o_dma.rw_pos++] = atomic_load(&i2s_out_port_data);
+            // Fill the whole gap until the next pulse, or up to the end of this buffer, in one run
+            // rather than going around this loop once per sample.
+            uint32_t n_samples = 1;
             if (i2s_out_remain_time_until_next_pulse >= I2S_OUT_USEC_PER_PULSE) {
-                i2s_out_remain_time_until_next_pulse -= I2S_OUT_USEC_PER_PULSE;
+                uint32_t room = DMA_SAMPLE_COUNT - SAMPLE_SAFE_COUNT - o_dma.rw_pos;
+                n_samples     = MIN(i2s_out_remain_time_until_next_pulse / I2S_OUT_USEC_PER_PULSE, room);
+                i2s_out_remain_time_until_next_pulse -= I2S_OUT_USEC_PER_PULSE * n_samples;
             }
+            uint32_t  port_data = atomic_load(&i2s_out_port_data);
+            uint32_t* sample    = &buf[o_dma.rw_pos];
+            uint32_t* end       = sample + n_samples;
+            while (sample < end) {
+                *sample++ = port_data;
+            }
+            o_dma.rw_pos += n_samples;
         }
         // set filled length to the DMA descriptor
         dma_desc->length = o_dma.rw_pos * I2S_SAMPLE_SIZE;
-    } else if (i2s_out_pulser_status == WAITING) {
-        i2s_clear_dma_buffer(dma_desc, 0);  // Essentially, no clearing is required. I'll make sure I know when I've written something.
-        o_dma.rw_pos           = 0;         // If someone calls i2s_out_push_sample, make sure there is no buffer overflow
-        dma_desc->qe.stqe_next = NULL;      // Cut the DMA descriptor ring. This allow us to identify the tail of the buffer.
+        i2s_out_stream_samples += o_dma.rw_pos;
     } else {
-        // Stepper paused (passthrough state, static I2S control mode)
-        // In the passthrough mode, there is no need to fill the buffer with port_data.
-        i2s_clear_dma_buffer(dma_desc, 0);  // Essentially, no clearing is required. I'll make sure I know when I've written something.
+        // Waiting for the step data to play out, or paused (passthrough state, static I2S control mode).
+        // The buffer carries the current outputs, so the stream can take over from the static outputs.
+        i2s_clear_dma_buffer(dma_desc, atomic_load(&i2s_out_port_data));
         o_dma.rw_pos                         = 0;  // If someone calls i2s_out_push_sample, make sure there is no buffer overflow
         i2s_out_remain_time_until_next_pulse = 0;
     }
@@ -413,6 +436,30 @@ static int IRAM_ATTR i2s_fillout_dma_buffer(lldesc_t* dma_desc) {
     return 0;
 }
 
+static int IRAM_ATTR i2s_out_desc_index(lldesc_t* dma_desc) {
+    for (int buf_idx = 0; buf_idx < I2S_OUT_DMABUF_COUNT; buf_idx++) {
+        if (o_dma.desc[buf_idx] == dma_desc) {
+            return buf_idx;
+        }
+    }
+    return -1;
+}
+
+// Fills a buffer the DMA has finished with the next step data, and counts the cycles it took.
+static void IRAM_ATTR i2s_out_refill(lldesc_t* dma_desc) {
+    uint32_t start   = xthal_get_ccount();
+    o_dma.current    = (uint32_t*)(dma_desc->buf);
+    o_dma.fill_index = i2s_out_desc_index(dma_desc);
+    i2s_fillout_dma_buffer(dma_desc);
+    dma_desc->length = o_dma.rw_pos * I2S_SAMPLE_SIZE;
+    uint32_t cycles  = xthal_get_ccount() - start;
+    i2s_out_stats.refills++;
+    i2s_out_stats.refill_cycles += cycles;
+    if (cycles > i2s_out_stats.max_refill_cycles) {
+        i2s_out_stats.max_refill_cycles = cycles;
+    }
+}
+
 //
 // I2S out DMA Interrupts handler
 //
@@ -435,18 +482,26 @@ static void IRAM_ATTR i2s_out_intr_handler(void* arg) {
         // Get the descriptor of the last item in the linkedlist
         finish_desc = (lldesc_t*)I2S0.out_eof_des_addr;
 
+#    ifdef I2S_OUT_ISR_REFILL
+        // While stepping, the buffer is filled right here instead of in the task, which saves the task
+        // switch and keeps the refill from waiting behind other tasks. The status is read without the
+        // lock, the fill takes it and handles a status that has just changed. The tail of a stopping
+        // stream still goes to the task, which restarts the I2S.
+        if (i2s_out_pulser_status == STEPPING && !I2S0.int_st.out_total_eof) {
+            i2s_out_refill(finish_desc);
+            I2S0.int_clr.val = I2S0.int_st.val;  //clear pending interrupt
+            return;
+        }
+#    endif
+
         // If the queue is full it's because we have an underflow,
         // more than buf_count isr without new data, remove the front buffer
         if (xQueueIsQueueFullFromISR(o_dma.queue)) {
             lldesc_t* front_desc;
             // Remove a descriptor from the DMA complete event queue
             xQueueReceiveFromISR(o_dma.queue, &front_desc, &high_priority_task_awoken);
-            I2S_OUT_PULSER_ENTER_CRITICAL_ISR();
-            uint32_t port_data = 0;
-            if (i2s_out_pulser_status == STEPPING) {
-                port_data = atomic_load(&i2s_out_port_data);
-            }
-            I2S_OUT_PULSER_EXIT_CRITICAL_ISR();
+            i2s_out_stats.underflows++;
+            uint32_t port_data = atomic_load(&i2s_out_port_data);
             for (int i = 0; i < DMA_SAMPLE_COUNT; i++) {
                 front_desc->buf[i] = port_data;
             }
@@ -489,30 +544,34 @@ static void IRAM_ATTR i2sOutTask(void* parameter) {
             // the generation of the buffer is interrupted (the buffer length is shortened slightly)
             // and the pulse generation is postponed until the next buffer is filled.
             //
-            i2s_fillout_dma_buffer(dma_desc);
-            dma_desc->length = o_dma.rw_pos * I2S_SAMPLE_SIZE;
+            i2s_out_refill(dma_desc);
         } else if (i2s_out_pulser_status == WAITING) {
+            uint32_t port_data = atomic_load(&i2s_out_port_data);
             if (dma_desc->qe.stqe_next == NULL) {
-                // Tail of the DMA descriptor found
+                // Tail of a ring cut by i2s_out_truncate()
                 // I2S TX module has alrewdy stopped by ISR
                 i2s_out_stop();
-                i2s_clear_o_dma_buffers(0);  // 0 for static I2S control mode (right ch. data is always 0)
+                i2s_clear_o_dma_buffers(port_data);
                 // You need to set the status before calling i2s_out_start()
                 // because the process in i2s_out_start() is different depending on the status.
                 i2s_out_pulser_status = PASSTHROUGH;
                 i2s_out_start();
             } else {
-                // Processing a buffer slightly ahead of the tail buffer.
-                // We don't need to fill up the buffer by port_data any more.
-                i2s_clear_dma_buffer(dma_desc, 0);  // Essentially, no clearing is required. I'll make sure I know when I've written something.
-                o_dma.rw_pos           = 0;         // If someone calls i2s_out_push_sample, make sure there is no buffer overflow
-                dma_desc->qe.stqe_next = NULL;      // Cut the DMA descriptor ring. This allow us to identify the tail of the buffer.
+                i2s_clear_dma_buffer(dma_desc, port_data);
+                o_dma.rw_pos = 0;  // If someone calls i2s_out_push_sample, make sure there is no buffer overflow
+                if (dma_desc == o_dma.tail_desc) {
+                    // The last step data has played. Go static without stopping the stream.
+                    I2S_OUT_ENTER_CRITICAL();
+                    i2s_out_select_static(true);
+                    I2S_OUT_EXIT_CRITICAL();
+                    i2s_out_pulser_status = PASSTHROUGH;
+                }
             }
         } else {
             // Stepper paused (passthrough state, static I2S control mode)
-            // In the passthrough mode, there is no need to fill the buffer with port_data.
-            i2s_clear_dma_buffer(dma_desc, 0);  // Essentially, no clearing is required. I'll make sure I know when I've written something.
-            o_dma.rw_pos = 0;                   // If someone calls i2s_out_push_sample, make sure there is no buffer overflow
+            // The buffer carries the current outputs, so the stream can take over from the static outputs.
+            i2s_clear_dma_buffer(dma_desc, atomic_load(&i2s_out_port_data));
+            o_dma.rw_pos = 0;  // If someone calls i2s_out_push_sample, make sure there is no buffer overflow
         }
         I2S_OUT_PULSER_EXIT_CRITICAL();  // Unlock pulser status
     }
@@ -558,6 +617,20 @@ void IRAM_ATTR i2s_out_write(uint8_t pin, uint8_t val) {
 #    endif
 }
 
+void IRAM_ATTR i2s_out_write_mask(uint32_t set_mask, uint32_t clear_mask) {
+    uint32_t port_data = atomic_load(&i2s_out_port_data);
+    while (!atomic_compare_exchange_weak(&i2s_out_port_data, &port_data, (port_data & ~clear_mask) | set_mask)) {
+        // port_data was reloaded, try again
+    }
+#    ifdef USE_I2S_OUT_STREAM_IMPL
+    if (i2s_out_pulser_status == PASSTHROUGH) {
+        i2s_out_single_data();
+    }
+#    else
+    i2s_out_single_data();
+#    endif
+}
+
 uint8_t IRAM_ATTR i2s_out_read(uint8_t pin) {
     uint32_t port_data = atomic_load(&i2s_out_port_data);
     return (!!(port_data & bit(pin)));
@@ -581,6 +654,60 @@ uint32_t IRAM_ATTR i2s_out_push_sample(uint32_t num) {
 #    endif
 }
 
+int IRAM_ATTR i2s_out_get_fill_index() {
+#    ifdef USE_I2S_OUT_STREAM_IMPL
+    return o_dma.fill_index;
+#    else
+    return 0;
+#    endif
+}
+
+int IRAM_ATTR i2s_out_truncate() {
+#    ifdef USE_I2S_OUT_STREAM_IMPL
+    int first = -1;
+    I2S_OUT_ENTER_CRITICAL();
+    int playing = i2s_out_desc_index((lldesc_t*)I2S0.out_link_dscr);
+    if (playing >= 0) {
+        // Buffers from the one playing to the one being filled, in DMA order
+        int ahead = (o_dma.fill_index - playing + I2S_OUT_DMABUF_COUNT) % I2S_OUT_DMABUF_COUNT;
+        if (ahead > I2S_OUT_TRUNCATE_MARGIN) {
+            int last = (playing + I2S_OUT_TRUNCATE_MARGIN) % I2S_OUT_DMABUF_COUNT;
+            // The DMA stops after the last buffer kept, as at the tail of a stopping stream.
+            // i2s_out_set_stepping() links the dropped buffers back into the ring.
+            o_dma.desc[last]->qe.stqe_next = NULL;
+            first                          = (last + 1) % I2S_OUT_DMABUF_COUNT;
+            i2s_out_stats.truncations++;
+        }
+    }
+    I2S_OUT_EXIT_CRITICAL();
+    return first;
+#    else
+    return -1;
+#    endif
+}
+
+const i2s_out_stats_t* i2s_out_get_stats() {
+#    ifdef USE_I2S_OUT_STREAM_IMPL
+    return &i2s_out_stats;
+#    else
+    return NULL;
+#    endif
+}
+
+void i2s_out_reset_stats() {
+#    ifdef USE_I2S_OUT_STREAM_IMPL
+    memset(&i2s_out_stats, 0, sizeof(i2s_out_stats));
+#    endif
+}
+
+uint32_t IRAM_ATTR i2s_out_get_stream_position() {
+#    ifdef USE_I2S_OUT_STREAM_IMPL
+    return i2s_out_stream_samples + o_dma.rw_pos;
+#    else
+    return 0;
+#    endif
+}
+
 i2s_out_pulser_status_t IRAM_ATTR i2s_out_get_pulser_status() {
     I2S_OUT_PULSER_ENTER_CRITICAL();
     i2s_out_pulser_status_t s = i2s_out_pulser_status;
@@ -592,7 +719,9 @@ int IRAM_ATTR i2s_out_set_passthrough() {
     I2S_OUT_PULSER_ENTER_CRITICAL();
 #    ifdef USE_I2S_OUT_STREAM_IMPL
     if (i2s_out_pulser_status == STEPPING) {
-        i2s_out_pulser_status = WAITING;  // Start stopping the pulser
+        // Start stopping the pulser. The outputs go static once the last buffer filled with steps has played.
+        o_dma.tail_desc       = o_dma.desc[o_dma.fill_index];
+        i2s_out_pulser_status = WAITING;
     }
 #    else
     i2s_out_pulser_status = PASSTHROUGH;
@@ -630,14 +759,28 @@ int IRAM_ATTR i2s_out_set_stepping() {
     }
 
     // Change I2S state from PASSTHROUGH to STEPPING
-    i2s_out_stop();
     uint32_t port_data = atomic_load(&i2s_out_port_data);
-    i2s_clear_o_dma_buffers(port_data);
+    if (I2S0.conf.tx_start) {
+        // The stream is running with the static outputs in its buffers. Bring them up to date, in case
+        // i2s_out_write() was called since they were filled, and switch over.
+        I2S_OUT_ENTER_CRITICAL();
+        for (int buf_idx = 0; buf_idx < I2S_OUT_DMABUF_COUNT; buf_idx++) {
+            i2s_clear_dma_buffer(o_dma.desc[buf_idx], port_data);
+        }
+        i2s_out_remain_time_until_next_pulse = 0;
+        i2s_out_pulser_status                = STEPPING;
+        i2s_out_select_static(false);
+        I2S_OUT_EXIT_CRITICAL();
+    } else {
+        // Stopped at the tail of a truncated stream
+        i2s_out_stop();
+        i2s_clear_o_dma_buffers(port_data);
 
-    // You need to set the status before calling i2s_out_start()
-    // because the process in i2s_out_start() is different depending on the status.
-    i2s_out_pulser_status = STEPPING;
-    i2s_out_start();
+        // You need to set the status before calling i2s_out_start()
+        // because the process in i2s_out_start() is different depending on the status.
+        i2s_out_pulser_status = STEPPING;
+        i2s_out_start();
+    }
 #    else
     i2s_out_pulser_status = STEPPING;
 #    endif
@@ -667,8 +810,9 @@ int IRAM_ATTR i2s_out_reset() {
     if (i2s_out_pulser_status == STEPPING) {
         uint32_t port_data = atomic_load(&i2s_out_port_data);
         i2s_clear_o_dma_buffers(port_data);
-    } else if (i2s_out_pulser_status == WAITING) {
-        i2s_clear_o_dma_buffers(0);
+    } else {
+        uint32_t port_data = atomic_load(&i2s_out_port_data);
+        i2s_clear_o_dma_buffers(port_data);
         i2s_out_pulser_status = PASSTHROUGH;
     }
 #    endif
@@ -753,9 +897,10 @@ int IRAM_ATTR i2s_out_init(i2s_out_init_t& init_param) {
 
     // Initialize
     i2s_clear_o_dma_buffers(init_param.init_val);
-    o_dma.rw_pos  = 0;
-    o_dma.current = NULL;
-    o_dma.queue   = xQueueCreate(I2S_OUT_DMABUF_COUNT, sizeof(uint32_t*));
+    o_dma.rw_pos     = 0;
+    o_dma.current    = NULL;
+    o_dma.fill_index = 0;
+    o_dma.queue      = xQueueCreate(I2S_OUT_DMABUF_COUNT, sizeof(uint32_t*));
 
     // Set the first DMA descriptor
     I2S0.out_link.addr = (uint32_t)o_dma.desc[0];
@@ -895,9 +1040,9 @@ int IRAM_ATTR i2s_out_init(i2s_out_init_t& init_param) {
     // Create the task that will feed the buffer
     xTaskCreatePinnedToCore(i2sOutTask,
                             "I2SOutTask",
-                            1024 * 10,
+                            I2S_OUT_TASK_STACK,
                             NULL,
-                            1,
+                            I2S_OUT_TASK_PRIORITY,
                             nullptr,
                             CONFIG_ARDUINO_RUNNING_CORE  // must run the task on same core
     );
@@ -60,11 +60,34 @@
 /* 32-bit mode: 1000000 usec / ((160000000 Hz) /  5 / 2) x 32 bit/pulse x 2(stereo) = 4 usec/pulse */
 const int I2S_OUT_USEC_PER_PULSE = 4;
 
-const int I2S_OUT_DMABUF_COUNT = 5;    /* number of DMA buffers to store data */
-const int I2S_OUT_DMABUF_LEN   = 2000; /* maximum size in bytes (4092 is DMA's limit) */
+/* The samples queued in the DMA buffers are motion that can no longer be changed, so they delay */
+/* the response to a feed hold, a probe or a limit. I2S_OUT_LOW_LATENCY trades them for more refills. */
+#    ifdef I2S_OUT_LOW_LATENCY
+#        ifndef I2S_OUT_DMABUF_COUNT
+#            define I2S_OUT_DMABUF_COUNT 4 /* number of DMA buffers to store data */
+#        endif
+#        ifndef I2S_OUT_DMABUF_LEN
+#            define I2S_OUT_DMABUF_LEN 256 /* maximum size in bytes (4092 is DMA's limit) */
+#        endif
+#    else
+#        ifndef I2S_OUT_DMABUF_COUNT
+#            define I2S_OUT_DMABUF_COUNT 5 /* number of DMA buffers to store data */
+#        endif
+#        ifndef I2S_OUT_DMABUF_LEN
+#            define I2S_OUT_DMABUF_LEN 2000 /* maximum size in bytes (4092 is DMA's limit) */
+#        endif
+#    endif
 
-const int I2S_OUT_DELAY_DMABUF_MS = (I2S_OUT_DMABUF_LEN / sizeof(uint32_t) * I2S_OUT_USEC_PER_PULSE / 1000);
-const int I2S_OUT_DELAY_MS        = (I2S_OUT_DELAY_DMABUF_MS * (I2S_OUT_DMABUF_COUNT + 1));
+/* Buffers kept after the one the DMA is playing when the queued samples are truncated */
+#    ifndef I2S_OUT_TRUNCATE_MARGIN
+#        define I2S_OUT_TRUNCATE_MARGIN 1
+#    endif
+
+const int I2S_OUT_DELAY_DMABUF_US = (I2S_OUT_DMABUF_LEN / sizeof(uint32_t) * I2S_OUT_USEC_PER_PULSE);
+const int I2S_OUT_DELAY_US        = (I2S_OUT_DELAY_DMABUF_US * (I2S_OUT_DMABUF_COUNT + 1));
+/* Rounded up, small buffers must still wait */
+const int I2S_OUT_DELAY_DMABUF_MS = ((I2S_OUT_DELAY_DMABUF_US + 999) / 1000);
+const int I2S_OUT_DELAY_MS        = ((I2S_OUT_DELAY_US + 999) / 1000);
 
 typedef void (*i2s_out_pulse_func_t)(void);
 
@@ -123,6 +146,13 @@ uint8_t i2s_out_read(uint8_t pin);
 */
 void i2s_out_write(uint8_t pin, uint8_t val);
 
+/*
+   Set and clear several bits of the internal pin state var. in one atomic update.
+   set_mask:   bits to set (bit n is expanded pin No. n)
+   clear_mask: bits to clear, set_mask wins where both have a bit
+*/
+void i2s_out_write_mask(uint32_t set_mask, uint32_t clear_mask);
+
 /*
     Set current pin state to the I2S bitstream buffer
     (This call will generate a future I2S_OUT_USEC_PER_PULSE μs x N bitstream)
@@ -133,11 +163,46 @@ void i2s_out_write(uint8_t pin, uint8_t val);
  */
 uint32_t i2s_out_push_sample(uint32_t num);
 
+/*
+   Get the position in the step stream, in samples of I2S_OUT_USEC_PER_PULSE μs,
+   at which the next pushed sample goes out. Only counts while stepping.
+ */
+uint32_t i2s_out_get_stream_position();
+
+/*
+   Get the index of the DMA buffer the step stream is filling.
+ */
+int i2s_out_get_fill_index();
+
+/*
+   Drop the step samples queued for the DMA after the buffer it is playing and
+   I2S_OUT_TRUNCATE_MARGIN more, including the buffer being filled.
+   Call only from the pulse callback, which must then stop stepping.
+   return: index of the first dropped buffer
+           -1 .. the DMA is too close to the buffer being filled, nothing dropped
+ */
+int i2s_out_truncate();
+
+typedef struct {
+    uint32_t refills;            // DMA buffers filled with step data
+    uint64_t refill_cycles;      // CPU cycles spent filling them
+    uint32_t max_refill_cycles;  // Longest fill
+    uint32_t underflows;         // Buffers the DMA played again before they were refilled
+    uint32_t truncations;        // i2s_out_truncate() calls that dropped samples
+} i2s_out_stats_t;
+
+/*
+   Get the refill statistics, or reset them.
+ */
+const i2s_out_stats_t* i2s_out_get_stats();
+void                   i2s_out_reset_stats();
+
 /*
    Set pulser mode to passtrough
    After this function is called,
    the callback function to generate the pulse data
-   will not be called.
+   will not be called. The outputs go static once the queued
+   step data has played, without stopping the I2S.
  */
 int i2s_out_set_passthrough();
 
@@ -145,7 +210,7 @@ int i2s_out_set_passthrough();
    Set pulser mode to stepping
    After this function is called,
    the callback function to generate stepping pulse data
-   will be called.
+   will be called. The running stream switches over at once.
  */
 int i2s_out_set_stepping();
 
@@ -0,0 +1,97 @@
+/*
+  IdlePower.cpp - lower CPU clock and a waiting main loop while the machine stands idle
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_IDLE_POWER_SAVE
+
+static volatile TaskHandle_t idle_power_task = NULL;  // The main loop, while it may wait
+static uint32_t              full_mhz        = 0;     // Clock to go back to, 0 while at it
+static int64_t               idle_since      = 0;
+static int64_t               saving_since;
+static idle_power_stats_t    stats;
+
+// Whether nothing would happen in the next pass of the main loop anyway
+static bool idle_power_allowed(int64_t now) {
+    if (sys.state != State::Idle || sys_rt_exec_state || plan_get_current_block() != NULL || sim_active()) {
+        return false;
+    }
+    if (!stepper_idle || now < stepper_idle_counter || stepper_idle_lock_time->get() == 0xff) {
+        return false;  // The drivers hold the motors
+    }
+#    ifdef ENABLE_SD_CARD
+    if (get_sd_state(false) != SDCARD_IDLE) {
+        return false;
+    }
+#    endif
+    for (uint8_t client = 0; client < CLIENT_COUNT; client++) {
+        if (serial_has_data(client)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void idle_power_leave(int64_t now) {
+    idle_power_task = NULL;
+    if (full_mhz) {
+        setCpuFrequencyMhz(full_mhz);
+        full_mhz = 0;
+        stats.us += now - saving_since;
+    }
+}
+
+void idle_power_poll() {
+    int64_t now = esp_timer_get_time();
+    if (!idle_power_allowed(now)) {
+        idle_since = now;
+        idle_power_leave(now);
+        return;
+    }
+    if (!full_mhz) {
+        if (now - idle_since < IDLE_POWER_DELAY_MS * 1000LL) {
+            return;
+        }
+        full_mhz     = getCpuFrequencyMhz();
+        saving_since = now;
+        stats.entries++;
+        setCpuFrequencyMhz(IDLE_POWER_CPU_MHZ);
+        ulTaskNotifyTake(pdTRUE, 0);  // Drop wakes left from the last time
+        idle_power_task = xTaskGetCurrentTaskHandle();
+    }
+    task_stats_block();
+    uint32_t woken = ulTaskNotifyTake(pdTRUE, IDLE_POWER_POLL_MS / portTICK_PERIOD_MS);
+    task_stats_unblock();
+    if (woken) {
+        idle_since = esp_timer_get_time();
+        idle_power_leave(idle_since);  // Before the loop reads the input
+    }
+}
+
+void idle_power_wake() {
+    TaskHandle_t task = idle_power_task;
+    if (task) {
+        xTaskNotifyGive(task);
+    }
+}
+
+const idle_power_stats_t* idle_power_get_stats() {
+    return &stats;
+}
+
+#endif
@@ -0,0 +1,75 @@
+#pragma once
+
+/*
+  IdlePower.h - lower CPU clock and a waiting main loop while the machine stands idle
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  The main loop never waits; it polls the clients, the SD card and the realtime flags as fast as it
+  can, at the full CPU clock, also when there is nothing to do. With ENABLE_IDLE_POWER_SAVE, once the
+  machine has been Idle with the stepper drivers released ($1 less than 255), no planner block and
+  no input for IDLE_POWER_DELAY_MS, idle_power_poll() lowers the CPU clock to IDLE_POWER_CPU_MHZ and
+  from then on waits in each pass of the loop, for IDLE_POWER_POLL_MS or until serialCheckTask
+  passes on input, so the idle task gets the core. The clock goes back up before the loop reads the
+  input, so the first line is parsed at full speed, and the wait ends at once, so it sees no more
+  delay than the task switch. Realtime commands are acted on by serialCheckTask as before. Control
+  pins and other flags are seen within IDLE_POWER_POLL_MS.
+
+  80 MHz is the lowest clock that keeps the APB clock, and with it the UART baud rate, the timers
+  and Wi-Fi, unchanged. Light sleep is not used, as it needs the power management the Arduino core
+  is built without and would stop the step timer.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_IDLE_POWER_SAVE
+
+// How long the machine must stand idle first
+#    ifndef IDLE_POWER_DELAY_MS
+#        define IDLE_POWER_DELAY_MS 5000
+#    endif
+
+// CPU clock while it does. 80, 160 or 240.
+#    ifndef IDLE_POWER_CPU_MHZ
+#        define IDLE_POWER_CPU_MHZ 80
+#    endif
+
+// Longest wait of the main loop then, which is how late a control pin is seen
+#    ifndef IDLE_POWER_POLL_MS
+#        define IDLE_POWER_POLL_MS 10
+#    endif
+
+static_assert(IDLE_POWER_CPU_MHZ >= 80, "IDLE_POWER_CPU_MHZ below 80 changes the APB clock");
+
+typedef struct {
+    uint32_t entries;  // Times the clock was lowered
+    uint64_t us;       // Time spent at the lower clock, not counting the current stretch
+} idle_power_stats_t;
+
+// Called once per pass of the main loop. Lowers the clock or waits when the machine is idle, and
+// restores the clock when it is not.
+void idle_power_poll();
+
+// Ends the wait of the main loop, which then restores the clock before it reads the input. For
+// serialCheckTask.
+void idle_power_wake();
+
+const idle_power_stats_t* idle_power_get_stats();
+#else
+inline void idle_power_poll() {}
+inline void idle_power_wake() {}
+#endif
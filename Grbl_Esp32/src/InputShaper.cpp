@@ -0,0 +1,173 @@
+/*
+  InputShaper.cpp - shapes the commanded motion of each axis to cancel its resonance
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef INPUT_SHAPING
+
+const int SHAPER_MAX_IMPULSES = 3;
+
+typedef struct {
+    uint8_t impulses;  // 0 when the axis is not shaped
+    float   amplitude[SHAPER_MAX_IMPULSES];
+    float   delay[SHAPER_MAX_IMPULSES];  // min
+} shaper_axis_t;
+
+typedef struct {
+    float dt;                    // Duration of the piece ending here (min)
+    float position[MAX_N_AXIS];  // Commanded position at its end (steps)
+} shaper_piece_t;
+
+static shaper_axis_t  shaper_axes[MAX_N_AXIS];
+static float          shaper_max_delay  = 0.0;
+static bool           shaper_enabled    = false;
+static uint32_t       shaper_generation = 0;  // motion_config.generation starts at 1, forcing the first build
+static shaper_piece_t history[SHAPER_HISTORY];
+static uint16_t       history_head  = 0;  // Newest piece
+static uint16_t       history_count = 0;
+
+bool shaper_refresh() {
+    if (shaper_generation == motion_config.generation) {
+        return shaper_enabled;
+    }
+    shaper_generation = motion_config.generation;
+    shaper_enabled    = false;
+    shaper_max_delay  = 0.0;
+    for (uint8_t axis = 0; axis < MAX_N_AXIS; axis++) {
+        shaper_axis_t* shaper = &shaper_axes[axis];
+        shaper->impulses      = 0;
+        float frequency       = motion_config.shaper_frequency[axis];
+        if (axis >= motion_config.n_axis || frequency <= 0.0) {
+            continue;
+        }
+        float damping = motion_config.shaper_damping[axis];
+        float root    = sqrtf(1.0 - damping * damping);
+        float k       = expf(-damping * M_PI / root);
+        float half    = 0.5 / (frequency * root) / 60.0;  // Half the damped period (min)
+        if (motion_config.shaper_type == int8_t(ShaperType::ZV)) {
+            shaper->impulses     = 2;
+            shaper->amplitude[0] = 1.0 / (1.0 + k);
+            shaper->amplitude[1] = k / (1.0 + k);
+        } else {
+            float sum            = (1.0 + k) * (1.0 + k);
+            shaper->impulses     = 3;
+            shaper->amplitude[0] = 1.0 / sum;
+            shaper->amplitude[1] = 2.0 * k / sum;
+            shaper->amplitude[2] = k * k / sum;
+        }
+        for (uint8_t i = 0; i < shaper->impulses; i++) {
+            shaper->delay[i] = i * half;
+        }
+        shaper_max_delay = MAX(shaper_max_delay, shaper->delay[shaper->impulses - 1]);
+        shaper_enabled   = true;
+    }
+    return shaper_enabled;
+}
+
+float shaper_duration() {
+    return shaper_max_delay;
+}
+
+void shaper_reset(const float* position) {
+    history_head  = 0;
+    history_count = 1;
+    history[0].dt = 0.0;
+    memcpy(history[0].position, position, sizeof(history[0].position));
+}
+
+void shaper_add(float dt, const float* position) {
+    if (dt <= 0.0) {
+        return;
+    }
+    if (++history_head == SHAPER_HISTORY) {
+        history_head = 0;
+    }
+    if (history_count < SHAPER_HISTORY) {
+        history_count++;
+    }
+    history[history_head].dt = dt;
+    memcpy(history[history_head].position, position, sizeof(history[0].position));
+}
+
+// Commanded position of an axis the given time before the end of the newest piece. Before the oldest
+// piece kept, the command rests where that piece starts.
+static float shaper_position_at(uint8_t axis, float age) {
+    uint16_t index = history_head;
+    float    end   = 0.0;  // Age of the end of the piece at index
+    for (uint16_t n = 1; n < history_count; n++) {
+        uint16_t older = index ? index - 1 : SHAPER_HISTORY - 1;
+        float    start = end + history[index].dt;
+        if (age < start) {
+            float to_end = history[index].position[axis];
+            return to_end + (history[older].position[axis] - to_end) * (age - end) / history[index].dt;
+        }
+        end   = start;
+        index = older;
+    }
+    return history[index].position[axis];
+}
+
+void shaper_output(float* position) {
+    for (uint8_t axis = 0; axis < motion_config.n_axis; axis++) {
+        shaper_axis_t* shaper = &shaper_axes[axis];
+        if (shaper->impulses == 0) {
+            position[axis] = history[history_head].position[axis];
+            continue;
+        }
+        float sum = 0.0;
+        for (uint8_t i = 0; i < shaper->impulses; i++) {
+            sum += shaper->amplitude[i] * shaper_position_at(axis, shaper->delay[i]);
+        }
+        position[axis] = sum;
+    }
+}
+
+Error shaper_write_test(uint8_t axis, uint8_t client) {
+    int8_t state = get_sd_state(true);
+    if (state != SDCARD_IDLE) {
+        return state == SDCARD_NOT_PRESENT ? Error::SdFailedMount : Error::SdFailedBusy;
+    }
+    char letter = report_get_axis_letter(axis);
+    char cross  = report_get_axis_letter(axis == X_AXIS ? Y_AXIS : X_AXIS);
+    char path[16];
+    snprintf(path, sizeof(path), "/shaper_%c.nc", letter);
+    File file = SD.open(path, FILE_WRITE);
+    if (!file) {
+        return Error::SdFailedOpenFile;
+    }
+    file.printf("; Input shaper test of %c, written by $Shaper/Test\n", letter);
+    file.printf("; 1. Set $%c/Shaper/Frequency=0 and trace this file with a pen, a laser or a shallow cut.\n", letter);
+    file.printf("; 2. Every %c move ends in a sharp corner. %c rings while %c moves on, which leaves ripples\n", letter, letter, cross);
+    file.printf(";    on the %c lines. Measure the distance d between two ripple crests in mm.\n", cross);
+    file.printf(";    The resonance of %c is %.1f / d Hz.\n", letter, SHAPER_TEST_FEED / 60.0);
+    file.printf("; 3. For the damping, measure the heights a1 and a2 of two neighbouring crests. It is\n");
+    file.printf(";    ln(a1 / a2) / 6.28. If they are too small to tell apart, keep the default.\n");
+    file.printf("; 4. Set $%c/Shaper/Frequency and $%c/Shaper/Damping and trace the file again.\n", letter, letter);
+    file.printf(";    The ripples should be gone. Otherwise try $Shaper/Type=ZVD, which tolerates more error.\n");
+    file.printf("G21\nG91\nG1 F%.0f\n", SHAPER_TEST_FEED);
+    for (int row = 0; row < SHAPER_TEST_ROWS; row++) {
+        file.printf("%c%.1f\n%c%.1f\n", letter, SHAPER_TEST_LENGTH, cross, SHAPER_TEST_SPACING);
+        file.printf("%c%.1f\n%c%.1f\n", letter, -SHAPER_TEST_LENGTH, cross, SHAPER_TEST_SPACING);
+    }
+    file.printf("G90\n");
+    file.close();
+    grbl_sendf(client, "[MSG: Shaper test of %c written to %s]\r\n", letter, path);
+    return Error::Ok;
+}
+
+#endif
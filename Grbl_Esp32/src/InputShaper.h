@@ -0,0 +1,94 @@
+#pragma once
+
+/*
+  InputShaper.h - shapes the commanded motion of each axis to cancel its resonance
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  The segment prep keeps a short history of the commanded position of every axis, the straight pieces
+  traced by the prepped segments. The position an axis is stepped to is that history convolved with
+  the impulses of its shaper: a ZV shaper sums two copies of the command, the second delayed by half
+  the damped period of the resonance, a ZVD shaper three. Each copy excites the resonance and the
+  next one cancels it. The frequency and damping are set per axis by $<axis>/Shaper/Frequency and
+  $<axis>/Shaper/Damping, the type by $Shaper/Type; a frequency of 0 leaves the axis as commanded.
+
+  Shaping works on motors, so on CoreXY machines the X and Y settings apply to the A and B motors.
+  The shaped motion lags the command by up to the shaper duration, half the damped period for ZV and a
+  whole one for ZVD. Wherever the commanded motion comes to a stop, the segment prep holds it there
+  until the shaped motion has arrived, so every stop takes that much longer. Homing and parking
+  motions are not shaped.
+
+  Tuning needs no accelerometer. $Shaper/Test=<axis> writes a test file to the SD card that moves the
+  axis back and forth with sharp corners. Traced with the shaper off, the ringing after every corner
+  leaves ripples whose spacing gives the frequency and whose decay gives the damping, as described in
+  the file. Traced again with the settings in place, the ripples should be gone.
+*/
+
+#include "Grbl.h"
+
+#ifdef USE_KINEMATICS
+#    error "INPUT_SHAPING does not support USE_KINEMATICS"
+#endif
+#ifdef ENABLE_LASER_RASTER
+#    error "INPUT_SHAPING does not support ENABLE_LASER_RASTER"
+#endif
+#ifdef ENABLE_SPINDLE_SYNC
+#    error "INPUT_SHAPING does not support ENABLE_SPINDLE_SYNC"
+#endif
+
+// Pieces of commanded motion kept. They have to cover the longest shaper duration, also when short
+// blocks make the segments short.
+#ifndef SHAPER_HISTORY
+#    define SHAPER_HISTORY 64
+#endif
+
+// Pattern of the $Shaper/Test file
+#ifndef SHAPER_TEST_FEED
+#    define SHAPER_TEST_FEED 1500.0  // mm/min
+#endif
+#ifndef SHAPER_TEST_LENGTH
+#    define SHAPER_TEST_LENGTH 40.0  // mm, moves along the tested axis
+#endif
+#ifndef SHAPER_TEST_SPACING
+#    define SHAPER_TEST_SPACING 10.0  // mm, moves across it, which show the ringing
+#endif
+#ifndef SHAPER_TEST_ROWS
+#    define SHAPER_TEST_ROWS 4
+#endif
+
+enum class ShaperType : int8_t {
+    ZV = 0,
+    ZVD,
+};
+
+// Rebuilds the shapers after a setting change. Returns true when any axis is shaped.
+bool shaper_refresh();
+
+// Longest time an axis lags the command (min).
+float shaper_duration();
+
+// Forgets the history. The command rests at position, in steps.
+void shaper_reset(const float* position);
+
+// Adds a straight piece of commanded motion, dt minutes long and ending at position, in steps.
+void shaper_add(float dt, const float* position);
+
+// Shaped position at the end of the newest piece, in steps.
+void shaper_output(float* position);
+
+// Writes the test file of an axis to the SD card.
+Error shaper_write_test(uint8_t axis, uint8_t client);
@@ -0,0 +1,167 @@
+/*
+  JobStats.cpp - performance summary of an SD card job
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_JOB_STATS
+
+typedef struct {
+    int64_t  time_us;
+    uint32_t lines;         // Lines read from the file
+    uint32_t appends;       // Planner blocks appended
+    uint32_t underruns;     // Segment buffer underruns
+    uint64_t parse_cycles;  // CPU cycles in the parser
+    uint64_t plan_cycles;   // CPU cycles in plan_buffer_line()
+} job_counters_t;
+
+typedef struct {
+    uint32_t samples;
+    uint32_t hold_samples;   // In a feed hold or at an open door
+    uint32_t cycle_samples;  // In a cycle. The fill and the feed rates are only sampled then.
+    uint32_t planner_sum;
+    uint16_t planner_min;
+    float    feed_sum;        // Realized, mm/min
+    float    programmed_sum;  // Programmed rate of the executing block, mm/min
+} job_samples_t;
+
+static job_counters_t     job_start;
+static job_counters_t     job_end;
+static job_samples_t      job_samples;
+static esp_timer_handle_t job_timer   = NULL;
+static bool               job_running = false;
+
+static void job_stats_sample(void* arg) {
+    job_samples.samples++;
+    switch (sys.state) {
+        case State::Hold:
+        case State::SafetyDoor:
+            job_samples.hold_samples++;
+            break;
+        case State::Cycle: {
+            plan_block_t* block = plan_get_current_block();
+            uint16_t      fill  = plan_get_block_buffer_count();
+            if (job_samples.cycle_samples == 0 || fill < job_samples.planner_min) {
+                job_samples.planner_min = fill;
+            }
+            job_samples.cycle_samples++;
+            job_samples.planner_sum += fill;
+            job_samples.feed_sum += st_get_realtime_rate();
+            if (block) {
+                job_samples.programmed_sum += block->programmed_rate;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void job_stats_snapshot(job_counters_t* counters) {
+    counters->time_us      = esp_timer_get_time();
+    counters->lines        = sd_get_current_line_number();
+    counters->appends      = plan_get_stats()->appends;
+    counters->underruns    = st_get_underrun_count();
+    counters->parse_cycles = gc_get_stats()->cycles;
+    counters->plan_cycles  = plan_get_stats()->cycles;
+}
+
+void job_stats_begin() {
+    if (job_timer == NULL) {
+        esp_timer_create_args_t args = {};
+        args.callback                = job_stats_sample;
+        args.name                    = "jobstats";
+        esp_timer_create(&args, &job_timer);
+    }
+    if (job_running) {
+        esp_timer_stop(job_timer);
+    }
+    memset(&job_samples, 0, sizeof(job_samples));
+    job_stats_snapshot(&job_start);
+    esp_timer_start_periodic(job_timer, JOB_STATS_SAMPLE_MS * 1000);
+    job_running = true;
+}
+
+void job_stats_end() {
+    if (!job_running) {
+        return;
+    }
+    esp_timer_stop(job_timer);
+    job_running = false;
+    job_stats_snapshot(&job_end);
+}
+
+void job_stats_report(const char* name, uint8_t client) {
+    // readFileLine() also counts the call that found the end of the file.
+    uint32_t lines      = job_end.lines ? job_end.lines - 1 : 0;
+    float    seconds    = (job_end.time_us - job_start.time_us) / 1000000.0f;
+    uint32_t blocks     = job_end.appends - job_start.appends;
+    uint32_t underruns  = job_end.underruns - job_start.underruns;
+    float    mhz        = getCpuFrequencyMhz();
+    float    parse_ms   = (job_end.parse_cycles - job_start.parse_cycles) / (mhz * 1000.0f);
+    float    plan_ms    = (job_end.plan_cycles - job_start.plan_cycles) / (mhz * 1000.0f);
+    float    hold       = job_samples.hold_samples * (JOB_STATS_SAMPLE_MS / 1000.0f);
+    uint32_t cycles     = job_samples.cycle_samples;
+    float    fill       = cycles ? float(job_samples.planner_sum) / cycles : 0.0f;
+    float    feed       = cycles ? job_samples.feed_sum / cycles : 0.0f;
+    float    programmed = cycles ? job_samples.programmed_sum / cycles : 0.0f;
+
+    grbl_sendf(client,
+               "[MSG: Job %s: %u lines in %.1f s, %.0f lines/s, %u blocks planned, %u underruns, %.1f s in hold]\r\n",
+               name,
+               lines,
+               seconds,
+               seconds > 0 ? lines / seconds : 0.0f,
+               blocks,
+               underruns,
+               hold);
+    grbl_sendf(client,
+               "[MSG: Job planner fill avg:%.1f min:%u of %u, feed %.0f of programmed %.0f mm/min, CPU parse:%.0f plan:%.0f ms]\r\n",
+               fill,
+               job_samples.planner_min,
+               BLOCK_BUFFER_SIZE - 1,
+               feed,
+               programmed,
+               parse_ms,
+               plan_ms);
+
+    File log = SD.open(JOB_STATS_LOG, FILE_APPEND);
+    if (!log) {
+        return;
+    }
+    if (log.size() == 0) {
+        log.print("file,version,build,lines,seconds,blocks,planner_avg,planner_min,underruns,hold_s,feed,programmed,parse_ms,plan_ms\n");
+    }
+    log.printf("%s,%s,%s,%u,%.2f,%u,%.2f,%u,%u,%.2f,%.1f,%.1f,%.1f,%.1f\n",
+               name,
+               GRBL_VERSION,
+               GRBL_VERSION_BUILD,
+               lines,
+               seconds,
+               blocks,
+               fill,
+               job_samples.planner_min,
+               underruns,
+               hold,
+               feed,
+               programmed,
+               parse_ms,
+               plan_ms);
+    log.close();
+}
+
+#endif
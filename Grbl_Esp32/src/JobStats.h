@@ -0,0 +1,48 @@
+#pragma once
+
+/*
+  JobStats.h - performance summary of an SD card job
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  While an SD job runs, a periodic timer samples the planner fill, the machine state and, during a
+  cycle, the realized and the programmed feed rate. The counters of the parser, the planner and the
+  step segment buffer are taken at the start and the end of the job.
+
+  When the job is done the summary goes to the client that started it: lines per second, blocks
+  planned, the average and the lowest planner fill, segment underruns, time in feed hold, the average
+  realized against the average programmed feed rate, and the CPU time of the parser and the planner.
+  It is also appended as a line to JOB_STATS_LOG on the card, with the file name and the firmware
+  version, so runs of the same part can be compared across firmware versions.
+*/
+
+#include "Grbl.h"
+
+#ifndef JOB_STATS_SAMPLE_MS
+#    define JOB_STATS_SAMPLE_MS 10
+#endif
+#ifndef JOB_STATS_LOG
+#    define JOB_STATS_LOG "/jobstats.csv"
+#endif
+
+// Called by openFile() and closeFile(). The end snapshot includes the lines read, so it is taken
+// before closeFile() forgets them.
+void job_stats_begin();
+void job_stats_end();
+
+// Sends the summary of the last job to client and appends it to JOB_STATS_LOG.
+void job_stats_report(const char* name, uint8_t client);
@@ -29,14 +29,22 @@ Error jog_execute(plan_line_data_t* pl_data, parser_block_t* gc_block) {
     // NOTE: Spindle and coolant are allowed to fully function with overrides during a jog.
     pl_data->feed_rate             = gc_block->values.f;
     pl_data->motion.noFeedOverride = 1;
+    pl_data->motion.jogMotion      = 1;
 #ifdef USE_LINE_NUMBERS
     pl_data->line_number = gc_block->values.n;
 #endif
-    if (soft_limits->get()) {
+    if (motion_config.soft_limits) {
         if (system_check_travel_limits(gc_block->values.xyz)) {
             return Error::TravelExceeded;
         }
     }
+#ifdef ENABLE_AUX_STREAM
+    // The auxiliary axis can only be jogged when its own moves are done
+    if (AUX_STREAM_AXIS < motion_config.n_axis && aux_stream_busy() &&
+        lroundf(gc_block->values.xyz[AUX_STREAM_AXIS] * motion_config.steps_per_mm[AUX_STREAM_AXIS]) != aux_stream_target()) {
+        return Error::InvalidJogCommand;
+    }
+#endif
     // Valid jog command. Plan, set state, and execute.
     mc_line(gc_block->values.xyz, pl_data);
     if (sys.state == State::Idle) {
@@ -48,3 +56,82 @@ Error jog_execute(plan_line_data_t* pl_data, parser_block_t* gc_block) {
     }
     return Error::Ok;
 }
+
+#ifdef JOG_VELOCITY_MODE
+Error jog_velocity(const char* line) {
+    if (motion_config.corexy) {
+        return Error::InvalidJogCommand;  // The segment prep steps the axes, not the CoreXY motors
+    }
+    static const char axis_letters[]        = "XYZABC";
+    auto              n_axis                = motion_config.n_axis;
+    float             direction[MAX_N_AXIS] = { 0.0 };
+    float             speed                 = -1.0;
+    uint8_t           char_counter          = 0;
+    while (line[char_counter]) {
+        char letter = toupper(line[char_counter++]);
+        if (letter == ' ') {
+            continue;
+        }
+        float value;
+        if (!read_float(line, &char_counter, &value)) {
+            return Error::BadNumberFormat;
+        }
+        if (letter == 'F') {
+            speed = value;
+            continue;
+        }
+        const char* axis = strchr(axis_letters, letter);
+        if (!axis || (axis - axis_letters) >= n_axis) {
+            return Error::InvalidJogCommand;
+        }
+        direction[axis - axis_letters] = value;
+    }
+    if (speed < 0.0) {
+        return Error::GcodeUndefinedFeedRate;
+    }
+
+    // Velocity of each axis along the direction, slowed down as a whole to the axis max rates.
+    float   velocity[MAX_N_AXIS] = { 0.0 };
+    float   length               = 0.0;
+    uint8_t idx;
+    for (idx = 0; idx < n_axis; idx++) {
+        length += direction[idx] * direction[idx];
+    }
+    if (length > 0.0) {
+        float scale = speed / sqrtf(length);
+        for (idx = 0; idx < n_axis; idx++) {
+            float max_rate = motion_config.max_rate[idx];
+            if (fabsf(direction[idx] * scale) > max_rate) {
+                scale = max_rate / fabsf(direction[idx]);
+            }
+        }
+        for (idx = 0; idx < n_axis; idx++) {
+            velocity[idx] = direction[idx] * scale;
+        }
+    }
+
+    if (sys.state == State::Jog) {
+        if (!st_jog_velocity_active()) {
+            return Error::InvalidJogCommand;  // A $J= jog is running
+        }
+        if (st_jog_velocity(velocity, JOG_VELOCITY_KEEPALIVE_MS)) {
+            return Error::Ok;
+        }
+        // The jog is coming to a stop. Let it finish, then start over.
+        while (sys.state == State::Jog) {
+            protocol_execute_realtime();
+            if (sys.abort) {
+                return Error::Ok;
+            }
+        }
+    }
+    if (sys.state != State::Idle || length == 0.0 || speed == 0.0) {
+        return Error::Ok;  // Nothing to stop, or a hold or cancel came in while waiting
+    }
+    st_jog_velocity(velocity, JOG_VELOCITY_KEEPALIVE_MS);
+    sys.state = State::Jog;
+    st_prep_buffer();
+    st_wake_up();
+    return Error::Ok;
+}
+#endif
@@ -29,3 +29,17 @@ const int JOG_LINE_NUMBER = 0;
 
 // Sets up valid jog motion received from g-code parser, checks for soft-limits, and executes the jog.
 Error jog_execute(plan_line_data_t* pl_data, parser_block_t* gc_block);
+
+#ifdef JOG_VELOCITY_MODE
+#    ifdef USE_KINEMATICS
+#        error "JOG_VELOCITY_MODE does not support USE_KINEMATICS"
+#    endif
+// Time a velocity jog keeps its velocity without a new $JV= line. Then it decelerates to a stop.
+#    ifndef JOG_VELOCITY_KEEPALIVE_MS
+#        define JOG_VELOCITY_KEEPALIVE_MS 250
+#    endif
+
+// Runs a velocity jog from a $JV= line: the axis words give the direction and F the speed along it.
+// Repeating the line keeps the jog going, a line without axis words or with F0 stops it.
+Error jog_velocity(const char* line);
+#endif
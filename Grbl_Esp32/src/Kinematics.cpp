@@ -0,0 +1,155 @@
+/*
+  Kinematics.cpp - joint space conversion for machines whose motors do not move along the machine axes
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef USE_KINEMATICS
+
+Kinematics* kinematics = NULL;
+
+static bool joint_motion = false;
+
+// Last forward() result. Reports run on several tasks, so the cache is copied under a spinlock.
+static portMUX_TYPE cache_spinlock   = portMUX_INITIALIZER_UNLOCKED;
+static bool         cache_valid      = false;
+static uint32_t     cache_generation;  // motion_config.generation the cache was computed with
+static int32_t      cache_steps[MAX_N_AXIS];
+static float        cache_mpos[MAX_N_AXIS];
+
+void kinematics_init() {
+    kinematics = machine_kinematics();
+    grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Kinematics %s", kinematics->name());
+}
+
+void kinematics_set_joint_motion(bool on) { joint_motion = on; }
+
+bool kinematics_joint_motion() { return joint_motion; }
+
+void kinematics_steps_to_mpos(float* position, const int32_t* live_steps) {
+    auto   n_axis = motion_config.n_axis;
+    size_t size   = n_axis * sizeof(int32_t);
+    bool   hit;
+    // The caller may pass sys_position, which the step ISR changes in place. The key and the result must
+    // come from the same step counts, so both are taken from one copy.
+    int32_t steps[MAX_N_AXIS];
+    memcpy(steps, live_steps, size);
+    portENTER_CRITICAL(&cache_spinlock);
+    hit = cache_valid && cache_generation == motion_config.generation && memcmp(cache_steps, steps, size) == 0;
+    if (hit) {
+        memcpy(position, cache_mpos, n_axis * sizeof(float));
+    }
+    portEXIT_CRITICAL(&cache_spinlock);
+    if (hit) {
+        return;
+    }
+    float joints[MAX_N_AXIS];
+    for (uint8_t idx = 0; idx < n_axis; idx++) {
+        joints[idx] = steps[idx] * motion_config.mm_per_step[idx];
+    }
+    kinematics->forward(joints, position);
+    portENTER_CRITICAL(&cache_spinlock);
+    cache_valid      = true;
+    cache_generation = motion_config.generation;
+    memcpy(cache_steps, steps, size);
+    memcpy(cache_mpos, position, n_axis * sizeof(float));
+    portEXIT_CRITICAL(&cache_spinlock);
+}
+
+float kinematics_chord_length(const float* start, const float* start_joints, const float* unit_vec, float length) {
+    float tolerance = motion_config.kinematics_tolerance;
+    if (tolerance <= 0.0 || length <= 0.0) {
+        return length;
+    }
+    float   end[MAX_N_AXIS];
+    float   joints[MAX_N_AXIS];
+    float   chord[MAX_N_AXIS];
+    uint8_t idx;
+    auto    n_axis = motion_config.n_axis;
+    for (idx = 0; idx < n_axis; idx++) {
+        end[idx] = start[idx] + unit_vec[idx] * length;
+    }
+    memcpy(joints, start_joints, sizeof(joints));
+    if (!kinematics->inverse(end, joints)) {
+        return length;  // Out of reach. The prep holds the joints there anyway.
+    }
+    for (idx = 0; idx < n_axis; idx++) {
+        joints[idx] = 0.5f * (start_joints[idx] + joints[idx]);
+    }
+    kinematics->forward(joints, chord);
+    float error = 0.0;
+    for (idx = 0; idx < n_axis; idx++) {
+        float deviation = chord[idx] - (start[idx] + unit_vec[idx] * length * 0.5f);
+        error += deviation * deviation;
+    }
+    error = sqrtf(error);
+    if (error <= tolerance) {
+        return length;
+    }
+    return MAX(length * sqrtf(tolerance / error), length / KINEMATICS_MIN_SEGMENT_DIVISOR);
+}
+
+void kinematics_benchmark(uint8_t client, uint32_t count) {
+    float   start[MAX_N_AXIS];
+    float   mpos[MAX_N_AXIS];
+    float   joints[MAX_N_AXIS];
+    int32_t position[MAX_N_AXIS];
+    uint8_t idx;
+    auto    n_axis = motion_config.n_axis;
+    system_get_position(position);
+    system_convert_array_steps_to_mpos(start, position);
+    for (idx = 0; idx < n_axis; idx++) {
+        joints[idx] = position[idx] * motion_config.mm_per_step[idx];
+    }
+    // Walk a short line from the current position, one 0.01 mm step per segment like a slow feed.
+    uint32_t unreachable = 0;
+    int64_t  inverse_us  = 0;
+    int64_t  forward_us  = 0;
+    uint32_t done        = 0;
+    while (done < count) {
+        uint32_t end = MIN(count, done + KINEMATICS_BENCH_CHUNK);
+        int64_t  t0  = esp_timer_get_time();
+        for (uint32_t i = done; i < end; i++) {
+            memcpy(mpos, start, sizeof(mpos));
+            mpos[X_AXIS] += (i & 0xff) * 0.01f;
+            if (!kinematics->inverse(mpos, joints)) {
+                unreachable++;
+            }
+        }
+        int64_t t1 = esp_timer_get_time();
+        for (uint32_t i = done; i < end; i++) {
+            kinematics->forward(joints, mpos);
+        }
+        int64_t t2 = esp_timer_get_time();
+        inverse_us += t1 - t0;
+        forward_us += t2 - t1;
+        done = end;
+        protocol_execute_realtime();  // Status reports and resets go on meanwhile
+        if (sys.abort) {
+            return;
+        }
+    }
+    grbl_sendf(client,
+               "[MSG: Kinematics %s segments:%u inverse:%.2f us forward:%.2f us unreachable:%u]\r\n",
+               kinematics->name(),
+               count,
+               float(inverse_us) / count,
+               float(forward_us) / count,
+               unreachable);
+}
+
+#endif
@@ -0,0 +1,98 @@
+#pragma once
+
+/*
+  Kinematics.h - joint space conversion for machines whose motors do not move along the machine axes
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  With USE_KINEMATICS the machine's custom code supplies a Kinematics object through
+  machine_kinematics(). The g-code parser and the planner work in Cartesian machine coordinates, so
+  a long move is one planner block and is planned with Cartesian feed, acceleration and junction
+  speeds. The stepper prep converts the end of each step segment to joint positions, and the step
+  ISR runs each segment as a straight line in joint space. The axis settings (steps/mm, max rate,
+  acceleration) are in joint units per unit, and the rates are applied to the Cartesian move.
+
+  sys_position counts joint steps. Machine positions for reports and for syncing the parser and the
+  planner are computed from it with forward(). The homing cycle moves the joints directly.
+*/
+
+#include "Grbl.h"
+
+// Adaptive segments are never shortened below this fraction of their time based length, so a path
+// close to a singularity cannot starve the segment buffer.
+#ifndef KINEMATICS_MIN_SEGMENT_DIVISOR
+#    define KINEMATICS_MIN_SEGMENT_DIVISOR 8
+#endif
+
+// $Kinematics/Bench runs on the main task, so it times this many segments at a time and handles the
+// realtime commands in between, and accepts at most KINEMATICS_BENCH_MAX segments.
+#ifndef KINEMATICS_BENCH_CHUNK
+#    define KINEMATICS_BENCH_CHUNK 500
+#endif
+#ifndef KINEMATICS_BENCH_MAX
+#    define KINEMATICS_BENCH_MAX 100000
+#endif
+
+class Kinematics {
+public:
+    // Converts a machine position in mm to joint positions. On entry joints holds the joint position of
+    // the previous point, for kinematics with more than one solution. Axes that are not transformed
+    // must be copied through. Returns false if the position cannot be reached.
+    virtual bool inverse(const float* cartesian, float* joints) = 0;
+
+    // Converts joint positions to a machine position in mm.
+    virtual void forward(const float* joints, float* cartesian) = 0;
+
+    // Checked for every programmed target. An unreachable move is dropped before it is planned.
+    virtual bool reachable(const float* cartesian) { return true; }
+
+    // Longest distance in mm the stepper prep runs as one straight joint segment. Within it, segments
+    // are shortened where the mapping bends, see kinematics_chord_length(). Zero leaves the maximum to
+    // DT_SEGMENT.
+    virtual float segment_length() { return 0.0; }
+
+    // Called before normal homing with the axes being homed. Returning true skips normal homing.
+    virtual bool pre_homing(uint8_t cycle_mask) { return false; }
+
+    // Called after normal homing, once the parser and the planner have been synced.
+    virtual void post_homing() {}
+
+    virtual const char* name() = 0;
+};
+
+extern Kinematics* kinematics;
+
+void kinematics_init();
+
+// Shortens a segment of length mm, from start (at start_joints) along unit_vec, until the midpoint of
+// its straight joint space chord is within $Kinematics/Tolerance of the line. The error grows with the
+// square of the length, so one inverse() at the end and one forward() at the chord midpoint give the
+// length directly. Called by the stepper prep for every segment of a kinematic block.
+float kinematics_chord_length(const float* start, const float* start_joints, const float* unit_vec, float length);
+
+// Converts joint steps to a machine position with forward(). The last result is cached by step
+// count, so repeated status reports of a machine at rest do not redo the forward kinematics. steps may
+// change while this runs, the result is that of a copy taken first.
+void kinematics_steps_to_mpos(float* position, const int32_t* steps);
+
+// While set, planned motion and position conversions are in joint space. Set by the homing cycle.
+void kinematics_set_joint_motion(bool on);
+bool kinematics_joint_motion();
+
+// Times inverse() and forward() over count segments near the current position. Run by $Kinematics/Bench.
+// Stops early on an abort.
+void kinematics_benchmark(uint8_t client, uint32_t count);
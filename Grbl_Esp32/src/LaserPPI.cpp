@@ -0,0 +1,89 @@
+/*
+  LaserPPI.cpp - laser pulses per distance, placed by the step generator
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_LASER_PPI
+
+#    include <driver/rmt.h>
+#    include <soc/rmt_struct.h>
+
+float laser_ppi_pulses_per_mm = 0.0f;
+
+static float    ppi_value    = 0.0f;
+static uint32_t ppi_pulse_us = LASER_PPI_PULSE_US;
+static int8_t   ppi_channel  = -1;
+
+// Writes the pulse, then the end marker, to the memory of the channel.
+static void laser_ppi_fill() {
+    rmt_item32_t items[2] = {};
+    items[0].level0       = 1;
+    items[0].duration0    = ppi_pulse_us;
+    items[0].level1       = 0;
+    items[0].duration1    = 1;
+    rmt_fill_tx_items(rmt_channel_t(ppi_channel), items, 2, 0);
+}
+
+void laser_ppi_init() {
+    ppi_channel = sys_get_next_RMT_chan_num();
+    if (ppi_channel < 0) {
+        return;
+    }
+    rmt_config_t config             = {};
+    config.rmt_mode                 = RMT_MODE_TX;
+    config.channel                  = rmt_channel_t(ppi_channel);
+    config.gpio_num                 = gpio_num_t(LASER_PPI_PIN);
+    config.clk_div                  = 80;  // 1us ticks from the 80MHz APB clock
+    config.mem_block_num            = 1;
+    config.tx_config.loop_en        = false;
+    config.tx_config.carrier_en     = false;
+    config.tx_config.idle_level     = RMT_IDLE_LEVEL_LOW;
+    config.tx_config.idle_output_en = true;
+    rmt_set_source_clk(config.channel, RMT_BASECLK_APB);
+    rmt_config(&config);
+    laser_ppi_fill();
+    laser_ppi_set(LASER_PPI_DEFAULT, ppi_pulse_us);
+    grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Laser PPI on Pin:%s", pinName(LASER_PPI_PIN).c_str());
+}
+
+void laser_ppi_set(float ppi, uint32_t pulse_us) {
+    if (ppi_channel < 0) {
+        return;
+    }
+    ppi_value               = ppi;
+    laser_ppi_pulses_per_mm = ppi / MM_PER_INCH;
+    if (pulse_us != ppi_pulse_us) {
+        ppi_pulse_us = pulse_us;
+        laser_ppi_fill();
+    }
+}
+
+float laser_ppi_get() {
+    return ppi_value;
+}
+
+uint32_t laser_ppi_pulse_us() {
+    return ppi_pulse_us;
+}
+
+void IRAM_ATTR laser_ppi_fire() {
+    RMT.conf_ch[ppi_channel].conf1.mem_rd_rst = 1;
+    RMT.conf_ch[ppi_channel].conf1.tx_start   = 1;
+}
+
+#endif
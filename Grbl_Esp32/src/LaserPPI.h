@@ -0,0 +1,67 @@
+#pragma once
+
+/*
+  LaserPPI.h - laser pulses per distance, placed by the step generator
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  In PPI mode the laser fires one pulse of a fixed width every 1/PPI inch of the tool path, whatever
+  the speed, so thin material is cut with evenly spaced holes through acceleration and corners. The
+  pulses come out on LASER_PPI_PIN, the fire input of the laser supply, while the spindle output
+  keeps setting the power as usual.
+
+  The segment prep computes, for each segment, the fraction of a pulse that each step ISR tick
+  travels. The ISR adds it to a 32-bit phase and starts the RMT channel of the pin when the phase
+  wraps, which is all the work a pulse costs it. The RMT channel times the pulse. The phase carries
+  over from segment to segment and block to block, so the spacing holds across them. Segments fire
+  only with the laser on at a power above zero, so G0 moves and M5 leave the pin idle.
+
+  $Laser/PPI=<pulses per inch>[,<pulse us>] sets the mode, 0 turns it off. $Laser/PPI reports it.
+  The mode starts off, or at LASER_PPI_DEFAULT, on every boot.
+*/
+
+#include "Grbl.h"
+
+#ifndef LASER_PPI_PIN
+#    error "ENABLE_LASER_PPI requires LASER_PPI_PIN"
+#endif
+
+// Pulses per inch at boot, 0 for off
+#ifndef LASER_PPI_DEFAULT
+#    define LASER_PPI_DEFAULT 0
+#endif
+
+// Width of a pulse in microseconds, up to 32767
+#ifndef LASER_PPI_PULSE_US
+#    define LASER_PPI_PULSE_US 200
+#endif
+
+// Pulses per mm of the tool path, 0 when the mode is off. Read by the segment prep.
+extern float laser_ppi_pulses_per_mm;
+
+// Sets up the RMT channel of the pin.
+void laser_ppi_init();
+
+// Sets the pulses per inch and the pulse width. Must not be called while the machine moves.
+void  laser_ppi_set(float ppi, uint32_t pulse_us);
+float laser_ppi_get();
+
+// The pulse width set
+uint32_t laser_ppi_pulse_us();
+
+// Starts a pulse. Called by the step ISR.
+void laser_ppi_fire();
@@ -27,9 +27,61 @@
 
 #include "Grbl.h"
 
+using MachineTraits::limit_pins;
+
 uint8_t n_homing_locate_cycle = NHomingLocateCycle;
 
-xQueueHandle limit_sw_queue;  // used by limit switch debouncing
+static limit_trigger_t limit_trigger;
+static int64_t         limit_edge_us;  // Time of the first edge of the current event, 0 if none
+static int32_t         limit_edge_position[MAX_N_AXIS];
+
+#ifdef ENABLE_SOFTWARE_DEBOUNCE
+static esp_timer_handle_t limit_debounce_timer = NULL;
+#endif
+
+// While homing approaches the switches, the limit interrupt latches the position of each armed axis
+// at its switch edge and locks the axis right away.
+static volatile uint8_t limit_latch_armed = 0;  // Axes that are still waiting for their edge
+static volatile uint8_t limit_latched     = 0;  // Axes whose edge position has been latched
+static int32_t          limit_latch_position[MAX_N_AXIS];
+static uint8_t          limit_latch_step_mask[MAX_N_AXIS];
+
+// The native GPIO switches of each axis as bits of gpio_read_inputs(), and the axes with a switch on an
+// expander, which is read pin by pin. Set by limits_init(), as the pins never change after boot.
+static uint64_t limit_gpio_masks[MAX_N_AXIS];
+static uint8_t  limit_expander_axes = 0;
+
+static void IRAM_ATTR limits_latch_edge() {
+#ifdef HOMING_PARALLEL_SQUARING
+    uint8_t triggered = limits_square(limits_get_state()) & limit_latch_armed;
+#else
+    uint8_t triggered = limits_get_state() & limit_latch_armed;
+#endif
+    if (!triggered) {
+        return;
+    }
+    uint8_t lock = sys.homing_axis_lock;
+    for (uint8_t idx = 0; idx < MAX_N_AXIS; idx++) {
+        if (bit_istrue(triggered, bit(idx))) {
+            limit_latch_position[idx] = sys_position[idx];
+            lock &= ~limit_latch_step_mask[idx];
+        }
+    }
+    sys.homing_axis_lock = lock;
+    limit_latched |= triggered;
+    limit_latch_armed &= ~triggered;
+}
+
+static void limits_attach(bool attach);
+
+#ifdef HOMING_PARALLEL_SQUARING
+// While homing approaches the switches, each motor of a squared axis stops at its own switch.
+static volatile uint8_t limit_square_armed = 0;  // Squared axes whose motors are still approaching
+static int32_t          limit_square_position[MAX_GANGED][MAX_N_AXIS];  // Axis position when each motor stopped
+static portMUX_TYPE     limit_square_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static uint8_t limits_square(uint8_t state);
+#endif
 
 // Homing axis search distance multiplier. Computed by this value times the cycle travel.
 #ifndef HOMING_AXIS_SEARCH_SCALAR
@@ -39,28 +91,71 @@ xQueueHandle limit_sw_queue;  // used by limit switch debouncing
 #    define HOMING_AXIS_LOCATE_SCALAR 5.0  // Must be > 1 to ensure limit switch is cleared.
 #endif
 
+static void IRAM_ATTR limits_capture_edge() {
+    if (!limit_edge_us) {
+        limit_edge_us = esp_timer_get_time();
+        memcpy(limit_edge_position, sys_position, sizeof(sys_position));
+    }
+}
+
+static void IRAM_ATTR limits_trip(uint8_t state) {
+    mc_reset();                                   // Initiate system kill.
+    system_set_exec_alarm(ExecAlarm::HardLimit);  // Indicate hard limit critical event
+    limit_trigger.count++;
+    limit_trigger.latency_us = uint32_t(esp_timer_get_time() - limit_edge_us);
+    limit_trigger.state      = state;
+    memcpy(limit_trigger.position, limit_edge_position, sizeof(limit_edge_position));
+    limit_edge_us = 0;
+}
+
+const limit_trigger_t* limits_get_trigger() {
+    return &limit_trigger;
+}
+
+#ifdef ENABLE_SOFTWARE_DEBOUNCE
+// Runs LIMIT_DEBOUNCE_US after the last edge, so the pins have been stable for that long, or
+// LIMIT_DEBOUNCE_MAX_US after the first one if they have not settled by then.
+static void limits_debounce_done(void* arg) {
+    uint8_t state = limits_get_state();
+    if (state && sys.state != State::Alarm && sys.state != State::Homing && sys_rt_exec_alarm == ExecAlarm::None) {
+        limits_trip(state);
+    }
+    limit_edge_us = 0;
+}
+#endif
+
 void IRAM_ATTR isr_limit_switches() {
     // Ignore limit switches if already in an alarm state or in-process of executing an alarm.
     // When in the alarm state, Grbl should have been reset or will force a reset, so any pending
     // moves in the planner and serial buffers are all cleared and newly sent blocks will be
     // locked out until a homing cycle or a kill lock command. Allows the user to disable the hard
     // limit setting if their limits are constantly triggering after a reset and move their axes.
-    if (sys.state != State::Alarm && sys.state != State::Homing) {
+    if (sys.state == State::Homing) {
+        limits_latch_edge();
+        return;
+    }
+    if (sys.state != State::Alarm) {
         if (sys_rt_exec_alarm == ExecAlarm::None) {
+            limits_capture_edge();
 #ifdef ENABLE_SOFTWARE_DEBOUNCE
-            // we will start a task that will recheck the switches after a small delay
-            int evt;
-            xQueueSendFromISR(limit_sw_queue, &evt, NULL);
+            // Every edge restarts the timer, which rechecks the switches once they have settled, but not
+            // past LIMIT_DEBOUNCE_MAX_US from the first edge, so chatter cannot postpone the check forever.
+            int64_t left = limit_edge_us + LIMIT_DEBOUNCE_MAX_US - esp_timer_get_time();
+            if (left > 0) {
+                esp_timer_stop(limit_debounce_timer);
+                esp_timer_start_once(limit_debounce_timer, MIN(left, int64_t(LIMIT_DEBOUNCE_US)));
+            }
 #else
 #    ifdef HARD_LIMIT_FORCE_STATE_CHECK
             // Check limit pin state.
-            if (limits_get_state()) {
-                mc_reset();                                   // Initiate system kill.
-                system_set_exec_alarm(ExecAlarm::HardLimit);  // Indicate hard limit critical event
+            uint8_t state = limits_get_state();
+            if (state) {
+                limits_trip(state);
+            } else {
+                limit_edge_us = 0;
             }
 #    else
-            mc_reset();                                   // Initiate system kill.
-            system_set_exec_alarm(ExecAlarm::HardLimit);  // Indicate hard limit critical event
+            limits_trip(limits_get_state());
 #    endif
 #endif
         }
@@ -110,24 +205,43 @@ void limits_go_home(uint8_t cycle_mask) {
     uint8_t step_pin[MAX_N_AXIS];
     float   target[MAX_N_AXIS];
     float   max_travel = 0.0;
+    int32_t overshoot[MAX_N_AXIS] = { 0 };  // Steps travelled past the latched edge by the last approach
+    bool    corexy                = motion_config.corexy;
+#ifdef HOMING_PARALLEL_SQUARING
+    // Ganged axes with a switch per motor are squared in every approach
+    uint8_t squaring = 0;
+    int32_t skew[MAX_N_AXIS];  // Steps between the switch edges of the two motors
+    if (!corexy) {
+        for (uint8_t idx = 0; idx < n_axis; idx++) {
+            if (limit_pins[idx][PRIMARY_MOTOR] != UNDEFINED_PIN && limit_pins[idx][GANGED_MOTOR] != UNDEFINED_PIN) {
+                squaring |= bit(idx);
+            }
+        }
+        squaring &= cycle_mask & homing_squared_axes->get() & st_get_ganged_axes();
+    }
+#endif
 
     for (uint8_t idx = 0; idx < n_axis; idx++) {
         // Initialize step pin masks
         step_pin[idx] = get_step_pin_mask(idx);
-#ifdef COREXY
-        if ((idx == A_MOTOR) || (idx == B_MOTOR)) {
+        if (corexy && ((idx == A_MOTOR) || (idx == B_MOTOR))) {
             step_pin[idx] = (get_step_pin_mask(X_AXIS) | get_step_pin_mask(Y_AXIS));
         }
-#endif
         if (bit_istrue(cycle_mask, bit(idx))) {
             // Set target based on max_travel setting. Ensure homing switches engaged with search scalar.
             max_travel = MAX(max_travel, (HOMING_AXIS_SEARCH_SCALAR)*axis_settings[idx]->max_travel->get());
         }
+        limit_latch_step_mask[idx] = step_pin[idx];
     }
+    limits_attach(true);  // Latching needs the interrupt even with hard limits off
     // Set search mode with approach at seek rate to quickly engage the specified cycle_mask limit switches.
     bool    approach    = true;
     float   homing_rate = homing_seek_rate->get();
     uint8_t limit_state, axislock, n_active_axis;
+#ifdef HOMING_PER_AXIS_RATES
+    bool    searching = true;  // First approach, before any switch has been found
+    int32_t travel_steps[MAX_N_AXIS];
+#endif
     do {
         system_convert_array_steps_to_mpos(target, sys_position);
         // Initialize and declare variables needed for homing routine.
@@ -137,20 +251,19 @@ void limits_go_home(uint8_t cycle_mask) {
             // Set target location for active axes and setup computation for homing rate.
             if (bit_istrue(cycle_mask, bit(idx))) {
                 n_active_axis++;
-#ifdef COREXY
-                if (idx == X_AXIS) {
+                // Zero the axis being homed. CoreXY keeps the other axis of the motor pair where it is.
+                system_position_write_begin();
+                if (corexy && idx == X_AXIS) {
                     int32_t axis_position = system_convert_corexy_to_y_axis_steps(sys_position);
                     sys_position[A_MOTOR] = axis_position;
                     sys_position[B_MOTOR] = -axis_position;
-                } else if (idx == Y_AXIS) {
+                } else if (corexy && idx == Y_AXIS) {
                     int32_t axis_position = system_convert_corexy_to_x_axis_steps(sys_position);
                     sys_position[A_MOTOR] = sys_position[B_MOTOR] = axis_position;
                 } else {
-                    sys_position[Z_AXIS] = 0;
+                    sys_position[idx] = 0;
                 }
-#else
-                sys_position[idx] = 0;
-#endif
+                system_position_write_end();
                 // Set target direction based on cycle mask and homing cycle approach state.
                 // NOTE: This happens to compile smaller than any other implementation tried.
                 auto mask = homing_dir_mask->get();
@@ -171,8 +284,50 @@ void limits_go_home(uint8_t cycle_mask) {
                 axislock |= step_pin[idx];
             }
         }
+#ifdef HOMING_PER_AXIS_RATES
+        if (!corexy) {
+            // Each axis covers its own distance at its own rate. The line lasts as long as the slowest
+            // axis needs, so every axis is stretched to run at exactly its rate for that time and the
+            // axes that are done early are locked out by distance in the loop below.
+            float axis_rate[MAX_N_AXIS];
+            float duration = 0.0;
+            bool  locating = approach && !searching;
+            homing_rate    = 0.0;
+            for (uint8_t idx = 0; idx < n_axis; idx++) {
+                if (bit_istrue(cycle_mask, bit(idx))) {
+                    float rate = locating ? axis_settings[idx]->homing_feed_rate->get() : axis_settings[idx]->homing_seek_rate->get();
+                    if (rate <= 0.0) {
+                        rate = locating ? homing_feed_rate->get() : homing_seek_rate->get();
+                    }
+                    axis_rate[idx] = MAX(rate, 1.0);
+                    float travel = searching ? HOMING_AXIS_SEARCH_SCALAR * axis_settings[idx]->max_travel->get() : max_travel;
+                    travel_steps[idx] = lround(travel * axis_settings[idx]->steps_per_mm->get());
+                    duration          = MAX(duration, travel / axis_rate[idx]);
+                }
+            }
+            for (uint8_t idx = 0; idx < n_axis; idx++) {
+                if (bit_istrue(cycle_mask, bit(idx))) {
+                    target[idx] = copysignf(axis_rate[idx] * duration, target[idx]);
+                    homing_rate += axis_rate[idx] * axis_rate[idx];
+                }
+            }
+            homing_rate = sqrtf(homing_rate);
+        } else {
+            homing_rate *= sqrt(n_active_axis);
+        }
+#else
         homing_rate *= sqrt(n_active_axis);  // [sqrt(number of active axis)] Adjust so individual axes all move at homing rate.
+#endif
         sys.homing_axis_lock = axislock;
+        limit_latched        = 0;
+        motors_stall_mask    = 0;
+        motors_stall_armed   = approach ? cycle_mask : 0;
+        if (!corexy) {
+            limit_latch_armed = approach ? cycle_mask : 0;  // CoreXY axes share motors, so they stay polled
+        }
+#ifdef HOMING_PARALLEL_SQUARING
+        limit_square_armed = approach ? squaring : 0;
+#endif
         // Perform homing cycle. Planner buffer should be empty, as required to initiate the homing cycle.
         pl_data->feed_rate = homing_rate;                    // Set current homing rate.
         plan_buffer_line(target, pl_data);                   // Bypass mc_line(). Directly plan homing motion.
@@ -182,24 +337,43 @@ void limits_go_home(uint8_t cycle_mask) {
         do {
             if (approach) {
                 // Check limit state. Lock out cycle axes when they change.
+#ifdef HOMING_PARALLEL_SQUARING
+                limit_state = limits_square(limits_get_state());
+#else
                 limit_state = limits_get_state();
+#endif
                 for (uint8_t idx = 0; idx < n_axis; idx++) {
                     if (axislock & step_pin[idx]) {
                         if (limit_state & bit(idx)) {
-#ifdef COREXY
-                            if (idx == Z_AXIS) {
-                                axislock &= ~(step_pin[Z_AXIS]);
-                            } else {
+                            if (corexy && (idx == X_AXIS || idx == Y_AXIS)) {
                                 axislock &= ~(step_pin[A_MOTOR] | step_pin[B_MOTOR]);
+                            } else {
+                                axislock &= ~(step_pin[idx]);
                             }
-#else
-                            axislock &= ~(step_pin[idx]);
-#endif
+                        }
+                    }
+                }
+                axislock &= sys.homing_axis_lock;  // Keep the axes the limit interrupt has already locked
+                sys.homing_axis_lock = axislock;
+            }
+#ifdef HOMING_PER_AXIS_RATES
+            if (!corexy) {
+                // An axis that has covered its own distance stops there. On an approach that means its
+                // switch was never found; on a pull-off the cycle ends once every axis is clear.
+                for (uint8_t idx = 0; idx < n_axis; idx++) {
+                    if ((axislock & step_pin[idx]) && labs(sys_position[idx]) >= travel_steps[idx]) {
+                        axislock &= ~(step_pin[idx]);
+                        if (approach) {
+                            cycle_stop = true;
                         }
                     }
                 }
                 sys.homing_axis_lock = axislock;
+                if (!approach && !(STEP_MASK & axislock)) {
+                    cycle_stop = true;
+                }
             }
+#endif
             st_prep_buffer();  // Check and prep segment buffer. NOTE: Should take no longer than 200us.
             // Exit routines: No time to run protocol_execute_realtime() in this loop.
             if ((sys_rt_exec_state & (EXEC_SAFETY_DOOR | EXEC_RESET)) || cycle_stop) {
@@ -222,6 +396,12 @@ void limits_go_home(uint8_t cycle_mask) {
                 }
 
                 if (sys_rt_exec_alarm != ExecAlarm::None) {
+                    limit_latch_armed  = 0;
+                    motors_stall_armed = 0;
+#ifdef HOMING_PARALLEL_SQUARING
+                    limit_square_armed = 0;
+#endif
+                    limits_attach(hard_limits->get());
                     motors_set_homing_mode(cycle_mask, false);  // tell motors homing is done...failed
                     mc_reset();                                 // Stop motors, if they are running.
                     protocol_execute_realtime();
@@ -240,10 +420,28 @@ void limits_go_home(uint8_t cycle_mask) {
             }
         }
 #endif
-        st_reset();                        // Immediately force kill steppers and reset step segment buffer.
+#ifdef HOMING_PARALLEL_SQUARING
+        limit_square_armed = 0;  // Before st_reset() releases the stopped motors
+#endif
+        st_reset();  // Immediately force kill steppers and reset step segment buffer.
+        limit_latch_armed  = 0;
+        motors_stall_armed = 0;
+        if (approach) {
+            // How far each axis went past its switch edge before it stopped. Polled axes stop on the
+            // switch, as before. A squared axis counts the steps of the motor that stopped last.
+            for (uint8_t idx = 0; idx < n_axis; idx++) {
+                overshoot[idx] = bit_istrue(limit_latched, bit(idx)) ? sys_position[idx] - limit_latch_position[idx] : 0;
+#ifdef HOMING_PARALLEL_SQUARING
+                skew[idx] = limit_square_position[GANGED_MOTOR][idx] - limit_square_position[PRIMARY_MOTOR][idx];
+#endif
+            }
+        }
         delay_ms(homing_debounce->get());  // Delay to allow transient dynamics to dissipate.
         // Reverse direction and reset homing rate for locate cycle(s).
         approach = !approach;
+#ifdef HOMING_PER_AXIS_RATES
+        searching = false;
+#endif
         // After first cycle, homing enters locating phase. Shorten search to pull-off distance.
         if (approach) {
             max_travel  = homing_pulloff->get() * HOMING_AXIS_LOCATE_SCALAR;
@@ -259,60 +457,52 @@ void limits_go_home(uint8_t cycle_mask) {
     // set up pull-off maneuver from axes limit switches that have been homed. This provides
     // some initial clearance off the switches and should also help prevent them from falsely
     // triggering when hard limits are enabled or when more than one axes shares a limit pin.
-    int32_t set_axis_position;
     // Set machine positions for homed limit switches. Don't update non-homed axes.
-    auto mask    = homing_dir_mask->get();
-    auto pulloff = homing_pulloff->get();
+    system_position_write_begin();
     for (uint8_t idx = 0; idx < n_axis; idx++) {
         auto steps = axis_settings[idx]->steps_per_mm->get();
         if (cycle_mask & bit(idx)) {
-            float travel = axis_settings[idx]->max_travel->get();
-            float mpos   = axis_settings[idx]->home_mpos->get();
-
-            if (bit_istrue(homing_dir_mask->get(), bit(idx))) {
-                sys_position[idx] = (mpos + pulloff) * steps;
-            } else {
-                sys_position[idx] = (mpos - pulloff) * steps;
-            }
-
-#ifdef COREXY
-            if (idx == X_AXIS) {
-                int32_t off_axis_position = system_convert_corexy_to_y_axis_steps(sys_position);
-                sys_position[A_MOTOR]     = set_axis_position + off_axis_position;
-                sys_position[B_MOTOR]     = set_axis_position - off_axis_position;
-            } else if (idx == Y_AXIS) {
-                int32_t off_axis_position = system_convert_corexy_to_x_axis_steps(sys_position);
-                sys_position[A_MOTOR]     = off_axis_position + set_axis_position;
-                sys_position[B_MOTOR]     = off_axis_position - set_axis_position;
-            } else {
-                sys_position[idx] = set_axis_position;
-            }
-#else
-            //sys_position[idx] = set_axis_position;
-            /*
-            float max_mpos, min_mpos;
-
-            if (bit_istrue(homing_dir_mask->get(), bit(idx))) {
-                min_mpos = mpos;
-                max_mpos = mpos + travel;
+            float mpos = axis_settings[idx]->home_mpos->get();
+            // The switch edge is at mpos. The last pull-off started overshoot steps past it and the
+            // axis position counts the pull-off itself.
+            if (corexy && (idx == X_AXIS || idx == Y_AXIS)) {
+                int32_t x_steps = system_convert_corexy_to_x_axis_steps(sys_position);
+                int32_t y_steps = system_convert_corexy_to_y_axis_steps(sys_position);
+                if (idx == X_AXIS) {
+                    x_steps += lround(mpos * steps) + overshoot[idx];
+                } else {
+                    y_steps += lround(mpos * steps) + overshoot[idx];
+                }
+                sys_position[A_MOTOR] = x_steps + y_steps;
+                sys_position[B_MOTOR] = x_steps - y_steps;
             } else {
-                min_mpos = mpos - travel;
-                max_mpos = mpos;
+                sys_position[idx] = lround(mpos * steps) + overshoot[idx] + sys_position[idx];
             }
-            */
-#endif
         }
     }
-    sys.step_control = STEP_CONTROL_NORMAL_OP;  // Return step control to normal operation.
+    system_position_write_end();
+    sys.step_control   = STEP_CONTROL_NORMAL_OP;  // Return step control to normal operation.
+    motors_stall_mask  = 0;
+    motors_stall_armed = 0;
+    limits_attach(hard_limits->get());
     motors_set_homing_mode(cycle_mask, false);  // tell motors homing is done
+#ifdef HOMING_PARALLEL_SQUARING
+    for (uint8_t idx = 0; idx < n_axis; idx++) {
+        if (squaring & bit(idx)) {
+            grbl_msg_sendf(CLIENT_SERIAL,
+                           MsgLevel::Info,
+                           "%c squared, second switch %.3f mm past the first",
+                           report_get_axis_letter(idx),
+                           skew[idx] / axis_settings[idx]->steps_per_mm->get());
+        }
+    }
+#endif
 }
 
-uint8_t limit_pins[MAX_N_AXIS][2] = { { X_LIMIT_PIN, X2_LIMIT_PIN }, { Y_LIMIT_PIN, Y2_LIMIT_PIN }, { Z_LIMIT_PIN, Z2_LIMIT_PIN },
-                                      { A_LIMIT_PIN, A2_LIMIT_PIN }, { B_LIMIT_PIN, B2_LIMIT_PIN }, { C_LIMIT_PIN, C2_LIMIT_PIN } };
-
 uint8_t limit_mask = 0;
 
 void limits_init() {
+    static bool reported = false;  // Pins are listed on the first call only
     limit_mask = 0;
     int mode   = INPUT_PULLUP;
 #ifdef DISABLE_LIMIT_PIN_PULL_UP
@@ -325,13 +515,8 @@ void limits_init() {
             if ((pin = limit_pins[axis][gang_index]) != UNDEFINED_PIN) {
                 pinMode(pin, mode);
                 limit_mask |= bit(axis);
-                if (hard_limits->get()) {
-                    attachInterrupt(pin, isr_limit_switches, CHANGE);
-                } else {
-                    detachInterrupt(pin);
-                }
 
-                if (limit_sw_queue == NULL) {
+                if (!reported) {
                     grbl_msg_sendf(CLIENT_SERIAL,
                                    MsgLevel::Info,
                                    "%c%s Axis limit switch on pin %s",
@@ -343,15 +528,50 @@ void limits_init() {
         }
     }
 
-    // setup task used for debouncing
-    if (limit_sw_queue == NULL) {
-        limit_sw_queue = xQueueCreate(10, sizeof(int));
-        xTaskCreate(limitCheckTask,
-                    "limitCheckTask",
-                    2048,
-                    NULL,
-                    5,  // priority
-                    NULL);
+    reported = true;
+
+    // The same switches as limits_get_state() read before, on every axis of the machine definition
+    memset(limit_gpio_masks, 0, sizeof(limit_gpio_masks));
+    limit_expander_axes = 0;
+    for (int axis = 0; axis < MachineTraits::n_axis; axis++) {
+        for (int gang_index = 0; gang_index < MAX_GANGED; gang_index++) {
+            uint8_t pin = limit_pins[axis][gang_index];
+            if (!(MachineTraits::limit_axes[gang_index] & bit(axis))) {
+                continue;
+            }
+            if (pin < NATIVE_GPIO_PINS) {
+                limit_gpio_masks[axis] |= 1ULL << pin;
+            } else {
+                limit_expander_axes |= bit(axis);
+            }
+        }
+    }
+    limits_attach(hard_limits->get());
+
+#ifdef ENABLE_SOFTWARE_DEBOUNCE
+    // setup timer used for debouncing
+    if (limit_debounce_timer == NULL) {
+        esp_timer_create_args_t args = {};
+        args.callback                = limits_debounce_done;
+        args.name                    = "limitDebounce";
+        esp_timer_create(&args, &limit_debounce_timer);
+    }
+#endif
+}
+
+static void limits_attach(bool attach) {
+    auto n_axis = number_axis->get();
+    for (int axis = 0; axis < n_axis; axis++) {
+        for (int gang_index = 0; gang_index < 2; gang_index++) {
+            uint8_t pin = limit_pins[axis][gang_index];
+            if (pin != UNDEFINED_PIN) {
+                if (attach) {
+                    attachInterrupt(pin, isr_limit_switches, CHANGE);
+                } else {
+                    detachInterrupt(pin);
+                }
+            }
+        }
     }
 }
 
@@ -371,17 +591,25 @@ void limits_disable() {
 // Returns limit state as a bit-wise uint8 variable. Each bit indicates an axis limit, where
 // triggered is 1 and not triggered is 0. Invert mask is applied. Axes are defined by their
 // number in bit position, i.e. Z_AXIS is bit(2), and Y_AXIS is bit(1).
-uint8_t limits_get_state() {
-    uint8_t pinMask = 0;
-    auto    n_axis  = number_axis->get();
-    for (int axis = 0; axis < n_axis; axis++) {
-        for (int gang_index = 0; gang_index < 2; gang_index++) {
+// The native pins are taken in one read of the GPIO inputs, so the cost does not grow with the switches.
+uint8_t IRAM_ATTR limits_get_state() {
+    uint8_t  pinMask = 0;
+    bool     invert  = limit_invert->get();
+    uint64_t inputs  = gpio_read_inputs();
+    if (invert) {
+        inputs = ~inputs;
+    }
+    for (int axis = 0; axis < MachineTraits::n_axis; axis++) {
+        if (inputs & limit_gpio_masks[axis]) {
+            pinMask |= bit(axis);
+        }
+    }
+    for (uint8_t axes = limit_expander_axes; axes; axes &= axes - 1) {
+        int axis = __builtin_ctz(axes);
+        for (int gang_index = 0; gang_index < MAX_GANGED; gang_index++) {
             uint8_t pin = limit_pins[axis][gang_index];
-            if (pin != UNDEFINED_PIN) {
-                if (limit_invert->get())
-                    pinMask |= (!digitalRead(pin) << axis);
-                else
-                    pinMask |= (digitalRead(pin) << axis);
+            if (pin >= NATIVE_GPIO_PINS && pin != UNDEFINED_PIN) {
+                pinMask |= ((digitalRead(pin) != 0) != invert) << axis;
             }
         }
     }
@@ -389,10 +617,52 @@ uint8_t limits_get_state() {
 #ifdef INVERT_LIMIT_PIN_MASK  // not normally used..unless you have both normal and inverted switches
     pinMask ^= INVERT_LIMIT_PIN_MASK;
 #endif
+    pinMask |= motors_stall_mask;  // Software StallGuard detection, only set while homing
     return pinMask;
 }
 
-// Performs a soft limit check. Called from mc_line() only. Assumes the machine has been homed,
+#ifdef HOMING_PARALLEL_SQUARING
+// State of the switches of one gang index, like limits_get_state().
+static uint8_t IRAM_ATTR limits_get_gang_state(int gang_index) {
+    uint8_t pinMask = 0;
+    uint8_t defined = MachineTraits::limit_axes[gang_index];
+    bool    invert  = limit_invert->get();
+    for (int axis = 0; axis < MachineTraits::n_axis; axis++) {
+        if (defined & bit(axis)) {
+            pinMask |= ((digitalRead(limit_pins[axis][gang_index]) != 0) != invert) << axis;
+        }
+    }
+#    ifdef INVERT_LIMIT_PIN_MASK
+    pinMask ^= INVERT_LIMIT_PIN_MASK & defined;
+#    endif
+    return pinMask;
+}
+
+// Stops each motor of the armed squared axes when its own switch triggers. Takes the limits_get_state()
+// of all axes and returns it with a squared axis set only once both of its motors have stopped.
+static uint8_t IRAM_ATTR limits_square(uint8_t state) {
+    uint8_t armed = limit_square_armed;
+    if (!armed) {
+        return state;
+    }
+    portENTER_CRITICAL_ISR(&limit_square_mux);
+    for (uint8_t motor = 0; motor < MAX_GANGED; motor++) {
+        uint8_t hit = limits_get_gang_state(motor) & armed & ~st_get_locked_motors(motor);
+        for (uint8_t idx = 0; hit; idx++) {
+            if (hit & bit(idx)) {
+                limit_square_position[motor][idx] = sys_position[idx];
+                st_lock_ganged_motor(idx, motor);
+                hit &= ~bit(idx);
+            }
+        }
+    }
+    uint8_t squared = armed & st_get_locked_motors(PRIMARY_MOTOR) & st_get_locked_motors(GANGED_MOTOR);
+    portEXIT_CRITICAL_ISR(&limit_square_mux);
+    return (state & ~armed) | squared;
+}
+#endif
+
+// Performs a soft limit check. Called from mc_line(), and once per arc from mc_arc(). Assumes the machine has been homed,
 // the workspace volume is in all negative space, and the system is in normal operation.
 // NOTE: Used by jogging to limit travel within soft-limit volume.
 void limits_soft_check(float* target) {
@@ -416,19 +686,3 @@ void limits_soft_check(float* target) {
         return;
     }
 }
-
-// this is the task
-void limitCheckTask(void* pvParameters) {
-    while (true) {
-        int evt;
-        xQueueReceive(limit_sw_queue, &evt, portMAX_DELAY);  // block until receive queue
-        vTaskDelay(DEBOUNCE_PERIOD / portTICK_PERIOD_MS);    // delay a while
-        uint8_t switch_state;
-        switch_state = limits_get_state();
-        if (switch_state) {
-            //grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Limit Switch State %08d", switch_state);
-            mc_reset();                                   // Initiate system kill.
-            system_set_exec_alarm(ExecAlarm::HardLimit);  // Indicate hard limit critical event
-        }
-    }
-}
@@ -29,6 +29,12 @@
 
 extern uint8_t n_homing_locate_cycle;
 
+// Longest a chattering switch can put off the hard limit check, from the first edge. See
+// ENABLE_SOFTWARE_DEBOUNCE.
+#ifndef LIMIT_DEBOUNCE_MAX_US
+#    define LIMIT_DEBOUNCE_MAX_US (4 * LIMIT_DEBOUNCE_US)
+#endif
+
 // Initialize the limits module
 void limits_init();
 
@@ -46,5 +52,12 @@ void limits_soft_check(float* target);
 
 void isr_limit_switches();
 
-// A task that runs after a limit switch interrupt.
-void limitCheckTask(void* pvParameters);
+// The last hard limit trip, with the time and machine position of the first edge that led to it.
+typedef struct {
+    uint32_t count;
+    uint32_t latency_us;  // First edge to alarm
+    uint8_t  state;       // limits_get_state() when the alarm was raised
+    int32_t  position[MAX_N_AXIS];
+} limit_trigger_t;
+
+const limit_trigger_t* limits_get_trigger();
@@ -0,0 +1,38 @@
+#pragma once
+
+/*
+  LocalFS.h - the file system on the internal flash
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  LocalFS is SPIFFS, or LittleFS with USE_LITTLEFS. Both use the partition labelled "spiffs", so the
+  partition table stays the same, but a partition written by one has to be formatted for the other.
+  LittleFS has real directories and opens and seeks in a number of reads that does not grow with the
+  number of files, where SPIFFS scans its pages.
+*/
+
+#include <FS.h>
+
+#ifdef USE_LITTLEFS
+#    include <LittleFS.h>
+#    define LocalFS LittleFS
+#    define LOCALFS_NAME "LittleFS"
+#else
+#    include <SPIFFS.h>
+#    define LocalFS SPIFFS
+#    define LOCALFS_NAME "SPIFFS"
+#endif
@@ -0,0 +1,73 @@
+#pragma once
+
+/*
+  MachineTraits.h - what the machine definition fixes at compile time
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  The axis count, the ganged axes and the limit switch pins come from Machines/*.h and cannot change
+  at runtime. The stepper, motor and limit code loops over these constants instead of asking the
+  settings, so the compiler drops the axes and gangs the machine does not have. Values that can be
+  tuned, such as the invert masks and steps per mm, stay in the settings and motion_config.
+*/
+
+#include "Grbl.h"
+
+namespace MachineTraits {
+    constexpr uint8_t n_axis = N_AXIS;
+
+    // Axes that have a second motor
+    constexpr uint8_t ganged_axes = 0
+#ifdef X2_STEP_PIN
+                                    | bit(X_AXIS)
+#endif
+#ifdef Y2_STEP_PIN
+                                    | bit(Y_AXIS)
+#endif
+#ifdef Z2_STEP_PIN
+                                    | bit(Z_AXIS)
+#endif
+#ifdef A2_STEP_PIN
+                                    | bit(A_AXIS)
+#endif
+#ifdef B2_STEP_PIN
+                                    | bit(B_AXIS)
+#endif
+#ifdef C2_STEP_PIN
+                                    | bit(C_AXIS)
+#endif
+        ;
+
+    // Motors per axis the loops have to visit, 1 when no axis is ganged
+    constexpr uint8_t n_gangs = ganged_axes ? MAX_GANGED : 1;
+
+    constexpr uint8_t limit_pins[MAX_N_AXIS][MAX_GANGED] = {
+        { X_LIMIT_PIN, X2_LIMIT_PIN }, { Y_LIMIT_PIN, Y2_LIMIT_PIN }, { Z_LIMIT_PIN, Z2_LIMIT_PIN },
+        { A_LIMIT_PIN, A2_LIMIT_PIN }, { B_LIMIT_PIN, B2_LIMIT_PIN }, { C_LIMIT_PIN, C2_LIMIT_PIN },
+    };
+
+    // Axes of the first axis..n_axis - 1 that have a switch on the gang index
+    constexpr uint8_t limit_axes_from(int gang_index, int axis) {
+        return axis >= n_axis ? 0
+                              : (limit_pins[axis][gang_index] != UNDEFINED_PIN ? bit(axis) : 0) | limit_axes_from(gang_index, axis + 1);
+    }
+
+    // Axes with a limit switch, per gang index
+    constexpr uint8_t limit_axes[MAX_GANGED] = { limit_axes_from(0, 0), limit_axes_from(1, 0) };
+
+    static_assert(n_axis <= MAX_N_AXIS, "N_AXIS exceeds MAX_N_AXIS");
+}
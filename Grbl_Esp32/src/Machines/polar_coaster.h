@@ -36,9 +36,8 @@
 #define RADIUS_AXIS 0
 #define POLAR_AXIS 1
 
-#define SEGMENT_LENGTH 0.5 // segment length in mm
+#define SEGMENT_LENGTH 5.0 // longest segment in mm, shortened to $Kinematics/Tolerance
 #define USE_KINEMATICS
-#define USE_FWD_KINEMATICS // report in cartesian
 #define USE_M30
 
 #define X_STEP_PIN              GPIO_NUM_15
@@ -26,7 +26,6 @@
 // ================= Firmware Customization ===================
 
 #define USE_KINEMATICS				// there are kinematic equations for this machine
-#define USE_FWD_KINEMATICS   // report in cartesian
 #define USE_MACHINE_INIT			// There is some custom initialization for this machine	
 	
 // ================== Delta Geometry ===========================
@@ -35,7 +34,7 @@
 #define RADIUS_EFF      133.5;  // radius of end effector side (length of linkages)
 #define LENGTH_FIXED_SIDE   179.437f;  // sized of fixed side triangel
 #define LENGTH_EFF_SIDE     86.6025f;  // size of end effector side triangle
-#define SEGMENT_LENGTH 0.5 // segment length in mm
+#define SEGMENT_LENGTH 5.0 // longest segment in mm, shortened to $Kinematics/Tolerance
 #define MAX_NEGATIVE_ANGLE -45 // in negative radians how far can the arms go up before damaging machine (max pi/2) 
 
 // =================== Machine Hardware Definition =============
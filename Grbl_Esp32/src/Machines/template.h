@@ -188,16 +188,12 @@
 // that can implement an arbitrary homing sequence.
 // #define USE_CUSTOM_HOMING
 
-// USE_KINEMATICS enables the functions inverse_kinematics(),
-// kinematics_pre_homing(), and kinematics_post_homing(),
-// so non-Cartesian machines can be implemented.
+// USE_KINEMATICS enables the machine_kinematics() function
+// that returns the Kinematics object (see Kinematics.h) of a
+// non-Cartesian machine. Moves are planned in Cartesian space
+// and converted to joint motion per step segment.
 // #define USE_KINEMATICS
 
-// USE_FWD_KINEMATICS enables the forward_kinematics() function
-// that converts motor positions in non-Cartesian coordinate
-// systems back to Cartesian form, for status reports.
-//#define USE_FWD_KINEMATICS
-
 // USE_TOOL_CHANGE enables the user_tool_change() function
 // that implements custom tool change procedures.
 // #define USE_TOOL_CHANGE
@@ -0,0 +1,157 @@
+/*
+  Macros.cpp - stored macros run from buttons and commands
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_MACROS
+
+#    include <atomic>
+
+typedef struct {
+    uint8_t offset;   // Of the text of the line
+    uint8_t first;    // Of its words
+    uint8_t n_words;  // 0 for a $ line
+    bool    system;
+} macro_line_t;
+
+typedef struct {
+    bool         valid;
+    uint8_t      n_lines;
+    macro_line_t lines[MACRO_MAX_LINES];
+    gc_word_t    words[MACRO_MAX_WORDS];
+    char         text[MACRO_MAX_LENGTH + 1];  // The lines, each ended by a NUL. G-code lines are collapsed.
+} macro_t;
+
+static macro_t              macros[N_MACROS];
+static uint32_t             macros_generation = 0;  // Setting::Generation starts at 1, forcing the first split
+static std::atomic<uint8_t> macros_pending(0);      // bit(index)
+
+static void macro_split(uint8_t index) {
+    macro_t* macro = &macros[index];
+    macro->valid   = false;
+    macro->n_lines = 0;
+    strlcpy(macro->text, macro_settings[index]->get(), sizeof(macro->text));
+    uint8_t n_words = 0;
+    char*   next    = macro->text;
+    while (*next) {
+        char* line = next;
+        next       = strchr(line, '&');
+        if (next) {
+            *next++ = '\0';
+        } else {
+            next = line + strlen(line);
+        }
+        while (isspace(*line)) {
+            line++;
+        }
+        if (*line == '\0') {
+            continue;
+        }
+        if (macro->n_lines == MACRO_MAX_LINES) {
+            grbl_msg_sendf(CLIENT_ALL, MsgLevel::Info, "Macro %d has too many lines", index);
+            return;
+        }
+        macro_line_t* entry = &macro->lines[macro->n_lines++];
+        entry->offset       = line - macro->text;
+        entry->first        = n_words;
+        entry->n_words      = 0;
+        entry->system       = *line == '$';
+        if (!entry->system) {
+            Error status = gc_tokenize_line(line, &macro->words[n_words], MACRO_MAX_WORDS - n_words, &entry->n_words);
+            if (status != Error::Ok) {
+                grbl_msg_sendf(CLIENT_ALL, MsgLevel::Info, "Macro %d line %d: error %d", index, macro->n_lines, static_cast<int>(status));
+                return;
+            }
+            n_words += entry->n_words;
+        }
+    }
+    macro->valid = true;
+}
+
+void macros_refresh() {
+    if (macros_generation == Setting::Generation) {
+        return;
+    }
+    macros_generation = Setting::Generation;
+    for (uint8_t index = 0; index < N_MACROS; index++) {
+        macro_split(index);
+    }
+}
+
+void IRAM_ATTR macro_request(uint8_t index) {
+    if (index < N_MACROS) {
+        macros_pending.fetch_or(bit(index));
+    }
+}
+
+static Error macro_run(uint8_t index, uint8_t client) {
+    const macro_t* macro = &macros[index];
+    if (!macro->valid) {
+        return Error::InvalidValue;
+    }
+    for (uint8_t i = 0; i < macro->n_lines && !sys.abort; i++) {
+        const macro_line_t* line = &macro->lines[i];
+        Error               status;
+        if (line->system) {
+            char text[MACRO_MAX_LENGTH + 1];
+            strcpy(text, &macro->text[line->offset]);  // system_execute_line() edits the line
+            status = system_execute_line(text, client, WebUI::AuthenticationLevel::LEVEL_ADMIN);
+        } else {
+            status = gc_execute_words(&macro->words[line->first], line->n_words, client);
+        }
+        if (status != Error::Ok) {
+            grbl_msg_sendf(client, MsgLevel::Info, "Macro %d line %d: error %d", index, i + 1, static_cast<int>(status));
+            return status;
+        }
+    }
+    return Error::Ok;
+}
+
+void macros_execute_pending() {
+    if (macros_pending.load() == 0) {
+        return;
+    }
+    uint8_t pending = macros_pending.exchange(0);
+    bool    busy    = sys.state != State::Idle;
+#    ifdef ENABLE_SD_CARD
+    busy = busy || get_sd_state(false) == SDCARD_BUSY_PRINTING;
+#    endif
+    for (uint8_t index = 0; index < N_MACROS && !sys.abort; index++) {
+        if (bit_isfalse(pending, bit(index))) {
+            continue;
+        }
+        if (busy) {
+            grbl_msg_sendf(CLIENT_ALL, MsgLevel::Info, "Macro %d ignored, machine busy", index);
+            continue;
+        }
+        macro_run(index, CLIENT_ALL);
+    }
+}
+
+// $Macros/Run=<n>
+Error macro_run_command(const char* value, uint8_t client) {
+    char*    end;
+    uint32_t index = value ? strtoul(value, &end, 10) : N_MACROS;
+    if (value == nullptr || end == value || *end || index >= N_MACROS) {
+        return Error::InvalidValue;
+    }
+    macro_request(index);
+    return Error::Ok;
+}
+
+#endif
@@ -0,0 +1,54 @@
+#pragma once
+
+/*
+  Macros.h - stored macros run from buttons and commands
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  $Macros/Macro0 to $Macros/Macro<N_MACROS-1> hold lines separated by &, like G91G0Z5&G90G53G0X0Y0.
+  The settings are kept in RAM like all others, and when one of them changes the G-code lines are split
+  into words right away, in the main loop. Running a macro then only executes the words; lines that
+  start with $ are kept as text and go through system_execute_line().
+
+  MACRO_BUTTON_<n>_PIN, or $Macros/Run=<n>, asks for macro n. protocol_main_loop() runs it on its next
+  pass if the machine is idle and no SD job runs, and drops the request otherwise.
+*/
+
+#include "Grbl.h"
+
+#ifndef N_MACROS
+#    define N_MACROS 4
+#endif
+// Lines and words of all G-code lines of one macro, and its length in characters
+#ifndef MACRO_MAX_LINES
+#    define MACRO_MAX_LINES 16
+#endif
+#ifndef MACRO_MAX_WORDS
+#    define MACRO_MAX_WORDS 64
+#endif
+const int MACRO_MAX_LENGTH = 255;
+
+// Splits the macros again after their settings changed.
+void macros_refresh();
+
+// Asks for the macro to run. Safe to call from an ISR.
+void macro_request(uint8_t index);
+
+// Runs the macros asked for. Called by protocol_main_loop().
+void macros_execute_pending();
+
+Error macro_run_command(const char* value, uint8_t client);
@@ -0,0 +1,179 @@
+/*
+    McpwmSteps.cpp
+    Part of Grbl_ESP32
+
+    Step pulse generation by the ESP32 MCPWM peripherals
+
+    The generators of the MCPWM operators shape the step pulses in hardware, one timer per axis. A
+    single step starts the timer for one period. A run of steps lets it run freely at the step period,
+    so a rotary or conveyor axis can step at a few hundred kHz while the step ISR only wakes to start
+    the run and to stop it.
+
+    Grbl_ESP32 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Grbl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Grbl_ESP32.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "Config.h"
+
+#ifdef USE_MCPWM_STEPS
+
+#    include <driver/periph_ctrl.h>
+#    include <soc/mcpwm_struct.h>
+#    include <soc/gpio_sig_map.h>
+
+#    include "Grbl.h"
+#    include "McpwmSteps.h"
+
+// The MCPWM clock is 160 MHz. Dividing it by 1 and the timer clock by 8 counts at F_STEPPER_TIMER.
+const uint32_t MCPWM_CLK_PRESCALE   = 0;
+const uint32_t MCPWM_TIMER_PRESCALE = 7;
+static_assert(160000000 / (MCPWM_CLK_PRESCALE + 1) / (MCPWM_TIMER_PRESCALE + 1) == F_STEPPER_TIMER,
+              "The MCPWM timers must count step timer ticks");
+
+// Timer mode register values
+const uint32_t MCPWM_MODE_UP          = 1;  // Count up from 0 to the period register, then restart
+const uint32_t MCPWM_START_STOP_TEP   = 1;  // Stop when the counter reaches the period
+const uint32_t MCPWM_START_FREE       = 2;  // Run until told otherwise
+const uint32_t MCPWM_START_ONE_SHOT   = 4;  // Start, and stop when the counter reaches the period
+const uint32_t MCPWM_ACTION_LOW       = 1;
+const uint32_t MCPWM_ACTION_HIGH      = 2;
+const uint32_t MCPWM_UPDATE_IMMEDIATE = 0;
+
+static mcpwm_dev_t* const mcpwm_units[2] = { &MCPWM0, &MCPWM1 };
+
+static const uint8_t mcpwm_signals[MAX_N_AXIS][MAX_GANGED] = {
+    { PWM0_OUT0A_IDX, PWM0_OUT0B_IDX }, { PWM0_OUT1A_IDX, PWM0_OUT1B_IDX }, { PWM0_OUT2A_IDX, PWM0_OUT2B_IDX },
+    { PWM1_OUT0A_IDX, PWM1_OUT0B_IDX }, { PWM1_OUT1A_IDX, PWM1_OUT1B_IDX }, { PWM1_OUT2A_IDX, PWM1_OUT2B_IDX },
+};
+
+static uint8_t  mcpwm_attached[MAX_GANGED];     // Axes with a generator attached, per motor
+static uint8_t  mcpwm_running = 0;              // Axes whose timer runs freely
+static uint16_t mcpwm_pulse_ticks[MAX_N_AXIS];  // Step pulse length
+static uint16_t mcpwm_delay[MAX_N_AXIS];        // Start of the pulse the comparators are set for
+
+static inline mcpwm_dev_t* IRAM_ATTR mcpwm_unit(uint8_t axis) {
+    return mcpwm_units[axis / 3];
+}
+
+// Moves the pulse of an axis to start delay_ticks after its timer starts
+static inline void IRAM_ATTR mcpwm_steps_delay(uint8_t axis, uint32_t delay_ticks) {
+    if (mcpwm_delay[axis] == delay_ticks) {
+        return;
+    }
+    mcpwm_dev_t* unit                              = mcpwm_unit(axis);
+    unit->channel[axis % 3].cmpr_value[0].cmpr_val = delay_ticks;
+    unit->channel[axis % 3].cmpr_value[1].cmpr_val = delay_ticks + mcpwm_pulse_ticks[axis];
+    mcpwm_delay[axis]                              = delay_ticks;
+}
+
+void mcpwm_steps_init() {
+    periph_module_enable(PERIPH_PWM0_MODULE);
+    periph_module_enable(PERIPH_PWM1_MODULE);
+    for (int u = 0; u < 2; u++) {
+        mcpwm_dev_t* unit             = mcpwm_units[u];
+        unit->clk_cfg.prescale        = MCPWM_CLK_PRESCALE;
+        unit->timer_sel.operator0_sel = 0;
+        unit->timer_sel.operator1_sel = 1;
+        unit->timer_sel.operator2_sel = 2;
+    }
+}
+
+void mcpwm_steps_attach(uint8_t axis, uint8_t motor, uint8_t pin, bool invert, uint32_t pulse_ticks) {
+    if (axis >= MAX_N_AXIS || pin == UNDEFINED_PIN) {
+        return;
+    }
+    mcpwm_dev_t* unit = mcpwm_unit(axis);
+    int          t    = axis % 3;
+
+    unit->timer[t].mode.start       = MCPWM_START_STOP_TEP;
+    unit->timer[t].mode.mode        = MCPWM_MODE_UP;
+    unit->timer[t].period.prescale  = MCPWM_TIMER_PRESCALE;
+    unit->timer[t].period.upmethod  = MCPWM_UPDATE_IMMEDIATE;
+    unit->timer[t].sync.timer_phase = 0;
+    unit->timer[t].sync.in_en       = 1;  // A software sync restarts the counter from 0
+
+    unit->channel[t].cmpr_cfg.a_upmethod   = MCPWM_UPDATE_IMMEDIATE;
+    unit->channel[t].cmpr_cfg.b_upmethod   = MCPWM_UPDATE_IMMEDIATE;
+    unit->channel[t].generator[motor].val  = 0;
+    unit->channel[t].generator[motor].utea = MCPWM_ACTION_HIGH;
+    unit->channel[t].generator[motor].uteb = MCPWM_ACTION_LOW;
+    mcpwm_pulse_ticks[axis]                = pulse_ticks;
+    mcpwm_delay[axis]                      = 0;
+    mcpwm_steps_delay(axis, MCPWM_STEP_DELAY_TICKS);
+
+    pinMode(pin, OUTPUT);
+    gpio_matrix_out(pin, mcpwm_signals[axis][motor], invert, false);
+    mcpwm_attached[motor] |= bit(axis);
+}
+
+uint8_t IRAM_ATTR mcpwm_steps_ganged_axes() {
+    return mcpwm_attached[GANGED_MOTOR];
+}
+
+// Enables the generators of the stepping motors and disables the others, so a motor held still by
+// squaring does not see the pulses of its axis. Returns the axes to start.
+static inline uint8_t IRAM_ATTR mcpwm_steps_select(uint8_t primary, uint8_t ganged) {
+    primary &= mcpwm_attached[PRIMARY_MOTOR];
+    ganged &= mcpwm_attached[GANGED_MOTOR];
+    uint8_t axes = primary | ganged;
+    for (uint8_t todo = axes; todo; todo &= todo - 1) {
+        int          axis = __builtin_ctz(todo);
+        mcpwm_dev_t* unit = mcpwm_unit(axis);
+        int          t    = axis % 3;
+        unit->channel[t].generator[PRIMARY_MOTOR].utea = (primary & bit(axis)) ? MCPWM_ACTION_HIGH : 0;
+        unit->channel[t].generator[GANGED_MOTOR].utea  = (ganged & bit(axis)) ? MCPWM_ACTION_HIGH : 0;
+    }
+    return axes;
+}
+
+// Restarts the counters of the axes from 0 and starts the timers, one right after the other.
+static inline void IRAM_ATTR mcpwm_steps_start(uint8_t axes, uint32_t start) {
+    for (uint8_t todo = axes; todo; todo &= todo - 1) {
+        int          axis = __builtin_ctz(todo);
+        mcpwm_dev_t* unit = mcpwm_unit(axis);
+        int          t    = axis % 3;
+        unit->timer[t].sync.sync_sw = !unit->timer[t].sync.sync_sw;  // Toggling it syncs
+        unit->timer[t].mode.start   = start;
+    }
+}
+
+void IRAM_ATTR mcpwm_steps_pulse(uint8_t primary, uint8_t ganged, uint32_t delay_ticks) {
+    uint8_t axes = mcpwm_steps_select(primary, ganged);
+    for (uint8_t todo = axes; todo; todo &= todo - 1) {
+        int axis = __builtin_ctz(todo);
+        mcpwm_steps_delay(axis, delay_ticks);
+        // Counts 0 to period, the pulse ends before
+        mcpwm_unit(axis)->timer[axis % 3].period.period = delay_ticks + mcpwm_pulse_ticks[axis] + 1;
+    }
+    mcpwm_steps_start(axes, MCPWM_START_ONE_SHOT);
+}
+
+void IRAM_ATTR mcpwm_steps_run(uint8_t primary, uint8_t ganged, uint32_t period_ticks) {
+    uint8_t axes = mcpwm_steps_select(primary, ganged);
+    for (uint8_t todo = axes; todo; todo &= todo - 1) {
+        int axis = __builtin_ctz(todo);
+        mcpwm_steps_delay(axis, MCPWM_STEP_DELAY_TICKS);
+        mcpwm_unit(axis)->timer[axis % 3].period.period = period_ticks - 1;  // Counts 0 to period
+    }
+    mcpwm_steps_start(axes, MCPWM_START_FREE);
+    mcpwm_running |= axes;
+}
+
+void IRAM_ATTR mcpwm_steps_stop() {
+    while (mcpwm_running) {
+        int axis = __builtin_ctz(mcpwm_running);
+        mcpwm_running &= mcpwm_running - 1;
+        mcpwm_unit(axis)->timer[axis % 3].mode.start = MCPWM_START_STOP_TEP;
+    }
+}
+
+#endif
@@ -0,0 +1,83 @@
+#pragma once
+
+/*
+    McpwmSteps.h
+    Part of Grbl_ESP32
+    Header for step pulse generation by the ESP32 MCPWM peripherals
+    Grbl_ESP32 is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    Grbl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with Grbl_ESP32.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// It should be included at the outset to know the machine configuration.
+#include "Config.h"
+
+#ifdef USE_MCPWM_STEPS
+
+#    include <stdint.h>
+
+/*
+    Each axis has a timer and an operator of its own, axes X, Y and Z on MCPWM0, A, B and C on MCPWM1.
+    The operator's generator A drives the step pin of the primary motor, generator B the one of the
+    ganged motor. The timers count at F_STEPPER_TIMER, so their periods are step timer ticks.
+
+        counter  0    delay      delay+pulse         period
+        step     ______|~~~~~~~~~~|___________________|   ... repeats while the timer runs
+
+    A single step runs the timer for one period. A run of steps lets it run freely until the step
+    ISR asks it to stop at the end of the period it is in.
+*/
+
+// Longest step period of a run, the timer period is 16 bits
+const uint32_t MCPWM_MAX_PERIOD_TICKS = 65536;
+
+#    ifdef STEP_PULSE_DELAY
+const uint32_t MCPWM_STEP_DELAY_TICKS = STEP_PULSE_DELAY * TICKS_PER_MICROSECOND;
+#    else
+const uint32_t MCPWM_STEP_DELAY_TICKS = 1;
+#    endif
+
+/*
+  Enable the MCPWM peripherals. Called once at startup, before the motors attach their pins.
+*/
+void mcpwm_steps_init();
+
+/*
+  Route the output of an axis' generator to the step pin of one of its motors.
+  motor: PRIMARY_MOTOR or GANGED_MOTOR
+  The pulse starts MCPWM_STEP_DELAY_TICKS after the timer starts, unless told otherwise, and lasts
+  pulse_ticks.
+*/
+void mcpwm_steps_attach(uint8_t axis, uint8_t motor, uint8_t pin, bool invert, uint32_t pulse_ticks);
+
+/*
+  Ganged axes, i.e. axes with a generator attached for GANGED_MOTOR
+*/
+uint8_t mcpwm_steps_ganged_axes();
+
+/*
+  Pulse the step pins of the given axes once.
+  primary, ganged: axes whose primary, ganged motor steps. Generators not attached are ignored.
+  delay_ticks:     start of the pulse, at least MCPWM_STEP_DELAY_TICKS, more for the direction setup time
+*/
+void mcpwm_steps_pulse(uint8_t primary, uint8_t ganged, uint32_t delay_ticks);
+
+/*
+  Start a run of pulses, period_ticks apart, on the step pins of the given axes. The timers start
+  one right after the other. The run goes on until mcpwm_steps_stop().
+*/
+void mcpwm_steps_run(uint8_t primary, uint8_t ganged, uint32_t period_ticks);
+
+/*
+  End the runs at the end of the period they are in, so a pulse already started is not cut short.
+*/
+void mcpwm_steps_stop();
+
+#endif
@@ -0,0 +1,123 @@
+/*
+  MemoryStats.cpp - memory budget of the Grbl buffers and heap low-water tracking
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_MEMORY_STATS
+
+#    include <esp_heap_caps.h>
+
+typedef struct {
+    char     what[32];  // URI of the request
+    uint32_t bytes;     // Drop below the free heap when it started
+    uint32_t min_free;  // New low it made
+    uint32_t time_ms;
+} memory_spike_t;
+
+static memory_spike_t spikes[MEMORY_SPIKE_LOG];
+static uint32_t       spike_count = 0;  // Logged since the reset, the newest is at (spike_count - 1) % MEMORY_SPIKE_LOG
+static uint32_t       watch_free  = 0;
+static uint32_t       watch_min   = 0;
+
+void memory_watch_begin() {
+    watch_free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    watch_min  = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+}
+
+uint32_t memory_watch_end() {
+    uint32_t min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    if (min_free >= watch_min || watch_free < min_free + MEMORY_SPIKE_BYTES) {
+        return 0;
+    }
+    return watch_free - min_free;
+}
+
+void memory_log_spike(const char* what, uint32_t bytes) {
+    memory_spike_t* spike = &spikes[spike_count++ % MEMORY_SPIKE_LOG];
+    strncpy(spike->what, what, sizeof(spike->what) - 1);
+    spike->what[sizeof(spike->what) - 1] = '\0';
+    spike->bytes                         = bytes;
+    spike->min_free                      = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    spike->time_ms                       = millis();
+    grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Heap spike %s: %u bytes, least free %u", spike->what, bytes, spike->min_free);
+}
+
+static void memory_heap_report(uint8_t client, const char* name, uint32_t caps) {
+    grbl_sendf(client,
+               "[MSG: Heap %s free:%u largest block:%u least free:%u total:%u]\r\n",
+               name,
+               heap_caps_get_free_size(caps),
+               heap_caps_get_largest_free_block(caps),
+               heap_caps_get_minimum_free_size(caps),
+               heap_caps_get_total_size(caps));
+}
+
+void memory_stats_report(uint8_t client) {
+    uint32_t planner = BLOCK_BUFFER_SIZE * sizeof(plan_block_t);
+    uint32_t clients = 0;
+    for (uint8_t client_num = 0; client_num < CLIENT_COUNT; client_num++) {
+        clients += serial_get_rx_buffer_size(client_num);
+    }
+    uint32_t socket = 0;
+    uint32_t telnet = 0;
+#    if defined(ENABLE_WIFI) && defined(ENABLE_HTTP)
+    socket = sizeof(WebUI::Serial2Socket);
+#    endif
+#    if defined(ENABLE_WIFI) && defined(ENABLE_TELNET)
+    telnet = sizeof(WebUI::telnet_server);
+#    endif
+    grbl_sendf(client,
+               "[MSG: Memory planner:%u segments:%u client buffers:%u socket:%u telnet:%u]\r\n",
+               planner,
+               st_get_buffer_memory(),
+               clients,
+               socket,
+               telnet);
+#    if defined(ENABLE_WIFI) && defined(ENABLE_HTTP)
+    const WebUI::response_pool_stats_t* pool = WebUI::response_pool_get_stats();
+    grbl_sendf(client,
+               "[MSG: Response pool %u x %u bytes, in use:%u most:%u, responses:%u unbuffered:%u]\r\n",
+               RESPONSE_POOL_BUFFERS,
+               RESPONSE_POOL_BUFFER_SIZE,
+               pool->in_use,
+               pool->most_in_use,
+               pool->acquired,
+               pool->misses);
+#    endif
+    memory_heap_report(client, "internal", MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (heap_caps_get_total_size(MALLOC_CAP_SPIRAM)) {
+        memory_heap_report(client, "PSRAM", MALLOC_CAP_SPIRAM);
+    }
+    uint32_t first = spike_count > MEMORY_SPIKE_LOG ? spike_count - MEMORY_SPIKE_LOG : 0;
+    uint32_t now   = millis();
+    for (uint32_t i = first; i < spike_count; i++) {
+        memory_spike_t* spike = &spikes[i % MEMORY_SPIKE_LOG];
+        grbl_sendf(client,
+                   "[MSG: Heap spike %s: %u bytes, least free %u, %u s ago]\r\n",
+                   spike->what,
+                   spike->bytes,
+                   spike->min_free,
+                   (now - spike->time_ms) / 1000);
+    }
+}
+
+void memory_stats_reset() {
+    spike_count = 0;
+}
+
+#endif
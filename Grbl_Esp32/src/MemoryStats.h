@@ -0,0 +1,57 @@
+#pragma once
+
+/*
+  MemoryStats.h - memory budget of the Grbl buffers and heap low-water tracking
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  $Memory/Stats reports the memory the fixed buffers of each subsystem take, and the free heap, its
+  largest free block and the least free heap since the reset, for internal RAM and PSRAM, and the use
+  of the response pool the WebUI builds its responses in.
+
+  The web server brackets each request and the websocket work with memory_watch_begin() and
+  memory_watch_end(). When the heap falls to a new low while it runs, by MEMORY_SPIKE_BYTES or more
+  below what was free when it started, the spike is logged with the URI. Only new lows are seen,
+  since the heap keeps no low-water mark that can be reset, and a task running at the same time can
+  be blamed for the spike of another. The last MEMORY_SPIKE_LOG spikes are listed by $Memory/Stats.
+*/
+
+#include "Grbl.h"
+
+// Least drop of the free heap that is logged as a spike, in bytes
+#ifndef MEMORY_SPIKE_BYTES
+#    define MEMORY_SPIKE_BYTES 4096
+#endif
+
+// Spikes kept for $Memory/Stats
+#ifndef MEMORY_SPIKE_LOG
+#    define MEMORY_SPIKE_LOG 8
+#endif
+
+#ifdef ENABLE_MEMORY_STATS
+void memory_watch_begin();
+
+// Returns the bytes the free heap fell below what was free at memory_watch_begin(), when that made a
+// new low of at least MEMORY_SPIKE_BYTES, else 0.
+uint32_t memory_watch_end();
+
+// Logs a spike returned by memory_watch_end().
+void memory_log_spike(const char* what, uint32_t bytes);
+
+void memory_stats_report(uint8_t client);
+void memory_stats_reset();
+#endif
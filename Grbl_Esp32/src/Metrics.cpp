@@ -0,0 +1,116 @@
+/*
+  Metrics.cpp - counters for monitoring, in the Prometheus text format
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_METRICS
+
+uint32_t metric_counters[int(Metric::Count)];
+uint32_t metric_rx_bytes[CLIENT_COUNT];
+
+static const char* const client_names[CLIENT_COUNT] = { "serial", "bt", "webui", "telnet", "input", "udp" };
+
+typedef struct {
+    void (*write)(const char* line, void* arg);
+    void* arg;
+    char  line[120];
+} metrics_out_t;
+
+static void metric_header(metrics_out_t& out, const char* name, const char* type, const char* help) {
+    snprintf(out.line, sizeof(out.line), "# HELP %s %s", name, help);
+    out.write(out.line, out.arg);
+    snprintf(out.line, sizeof(out.line), "# TYPE %s %s", name, type);
+    out.write(out.line, out.arg);
+}
+
+static void metric_value(metrics_out_t& out, const char* name, uint64_t value) {
+    snprintf(out.line, sizeof(out.line), "%s %llu", name, value);
+    out.write(out.line, out.arg);
+}
+
+static void metric_labeled(metrics_out_t& out, const char* name, const char* label, const char* label_value, int64_t value) {
+    snprintf(out.line, sizeof(out.line), "%s{%s=\"%s\"} %lld", name, label, label_value, value);
+    out.write(out.line, out.arg);
+}
+
+static void metric(metrics_out_t& out, const char* name, const char* type, const char* help, uint64_t value) {
+    metric_header(out, name, type, help);
+    metric_value(out, name, value);
+}
+
+void metrics_write(void (*write)(const char* line, void* arg), void* arg) {
+    metrics_out_t out;
+    out.write = write;
+    out.arg   = arg;
+
+    metric(out, "grbl_uptime_seconds", "counter", "Time since boot", esp_timer_get_time() / 1000000);
+
+    const gc_stats_t* gc = gc_get_stats();
+    metric(out, "grbl_gcode_lines_total", "counter", "G-code lines parsed", uint64_t(gc->lines) + gc->fast_lines);
+    metric(out, "grbl_planner_blocks_total", "counter", "Blocks added to the planner", plan_get_stats()->appends);
+    metric(out,
+           "grbl_segments_total",
+           "counter",
+           "Segments prepared for the step ISR",
+           __atomic_load_n(&metric_counters[int(Metric::Segments)], __ATOMIC_RELAXED));
+    metric(out, "grbl_segment_underruns_total", "counter", "Times the step ISR found no segment", st_get_underrun_count());
+
+    metric_header(out, "grbl_rx_bytes_total", "counter", "Bytes received per client");
+    for (uint8_t client = 0; client < CLIENT_COUNT; client++) {
+        uint32_t bytes = __atomic_load_n(&metric_rx_bytes[client], __ATOMIC_RELAXED);
+        metric_labeled(out, "grbl_rx_bytes_total", "client", client_names[client], bytes);
+    }
+
+#    ifdef ENABLE_ASYNC_OUTPUT
+    metric_header(out, "grbl_tx_dropped_total", "counter", "Output messages dropped per client");
+    for (uint8_t client = 0; client < CLIENT_COUNT; client++) {
+        const client_output_stats_t* stats = client_output_get_stats(client);
+        if (stats) {
+            metric_labeled(out, "grbl_tx_dropped_total", "client", client_names[client], stats->dropped + stats->dropped_status);
+        }
+    }
+#    endif
+
+    metric(out, "grbl_heap_free_bytes", "gauge", "Free heap", heap_caps_get_free_size(MALLOC_CAP_8BIT));
+    metric(out, "grbl_heap_min_free_bytes", "gauge", "Least free heap since boot", heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT));
+
+#    ifdef ENABLE_TASK_STATS
+    metric_header(out, "grbl_task_cpu_permille", "gauge", "CPU time per task since $Tasks/Stats was cleared");
+    task_info_t info;
+    for (uint8_t i = 0; task_stats_get(i, &info); i++) {
+        metric_labeled(out, "grbl_task_cpu_permille", "task", info.name, info.run_permille);
+    }
+#    endif
+
+#    ifdef ENABLE_IDLE_POWER_SAVE
+    const idle_power_stats_t* power = idle_power_get_stats();
+    metric(out, "grbl_idle_power_entries_total", "counter", "Times the CPU clock was lowered for idle", power->entries);
+    metric(out, "grbl_idle_power_seconds_total", "counter", "Time at the lower idle CPU clock", power->us / 1000000);
+#    endif
+
+#    ifdef ENABLE_WIFI
+    const WebUI::wifi_stats_t* wifi = WebUI::WiFiConfig::stats();
+    metric(out, "grbl_wifi_connects_total", "counter", "Wi-Fi station connections", wifi->connects);
+    metric(out, "grbl_wifi_disconnects_total", "counter", "Wi-Fi station disconnects, each followed by a retry", wifi->disconnects);
+    metric_header(out, "grbl_wifi_rssi_dbm", "gauge", "Last Wi-Fi signal sample, 0 when not connected");
+    snprintf(out.line, sizeof(out.line), "grbl_wifi_rssi_dbm %d", wifi->rssi);
+    out.write(out.line, out.arg);
+#    endif
+}
+
+#endif
@@ -0,0 +1,60 @@
+#pragma once
+
+/*
+  Metrics.h - counters for monitoring, in the Prometheus text format
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  With ENABLE_METRICS the web server answers /metrics in the Prometheus text format, and $Metrics
+  sends the same lines. Nothing is formatted until then. The counters Grbl keeps anyway, parser
+  lines, planner blocks, segment underruns, dropped output, Wi-Fi disconnects and task CPU time, are
+  read where they are. The few that had no counter are in the Metric table below and are bumped with
+  a relaxed atomic add on their paths.
+
+  The counters count up from boot and the scraper derives the rates, such as segments or lines per
+  second. A $.../Stats=0 command clears the counters it reports, which the scraper sees as a reset.
+*/
+
+#include "Grbl.h"
+
+// Counters kept only for the metrics
+enum class Metric : uint8_t {
+    Segments = 0,  // Segments prepared for the step ISR
+    Count,
+};
+
+#ifdef ENABLE_METRICS
+extern uint32_t metric_counters[int(Metric::Count)];
+extern uint32_t metric_rx_bytes[CLIENT_COUNT];
+
+inline void metric_inc(Metric metric, uint32_t n = 1) {
+    __atomic_add_fetch(&metric_counters[int(metric)], n, __ATOMIC_RELAXED);
+}
+
+// Bytes received from a client, realtime commands included
+inline void metric_rx(uint8_t client, uint32_t n = 1) {
+    if (client < CLIENT_COUNT) {
+        __atomic_add_fetch(&metric_rx_bytes[client], n, __ATOMIC_RELAXED);
+    }
+}
+
+// Formats the metrics one line at a time and hands each line to write.
+void metrics_write(void (*write)(const char* line, void* arg), void* arg);
+#else
+inline void metric_inc(Metric metric, uint32_t n = 1) {}
+inline void metric_rx(uint8_t client, uint32_t n = 1) {}
+#endif
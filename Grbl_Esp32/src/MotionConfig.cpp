@@ -0,0 +1,89 @@
+/*
+  MotionConfig.cpp - plain copy of the settings read by the motion code
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+DRAM_ATTR motion_config_t motion_config;
+
+static uint32_t settings_generation = 0;  // Setting::Generation starts at 1, forcing the first build
+
+void motion_config_refresh() {
+    if (settings_generation == Setting::Generation) {
+        return;
+    }
+    st_prep_lock();  // The planner may refresh from the motion task while the protocol loop does
+    if (settings_generation == Setting::Generation) {
+        st_prep_unlock();
+        return;
+    }
+    settings_generation = Setting::Generation;
+
+    motion_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));  // Padding too, for the memcmp() below
+    cfg.n_axis                 = number_axis->get();
+    cfg.dir_invert_mask        = dir_invert_mask->get();
+    cfg.step_invert_mask       = step_invert_mask->get();
+    cfg.homing_dir_mask        = homing_dir_mask->get();
+    cfg.pulse_microseconds     = pulse_microseconds->get();
+    cfg.dir_delay_microseconds = dir_delay_microseconds->get();
+    cfg.junction_deviation     = junction_deviation->get();
+    cfg.soft_limits            = soft_limits->get();
+    for (uint8_t idx = 0; idx < cfg.n_axis; idx++) {
+        cfg.steps_per_mm[idx] = axis_settings[idx]->steps_per_mm->get();
+        cfg.max_rate[idx]     = axis_settings[idx]->max_rate->get();
+        cfg.acceleration[idx] = axis_settings[idx]->acceleration->get();
+        // The settings have lower bounds above zero.
+        cfg.mm_per_step[idx]      = 1.0f / cfg.steps_per_mm[idx];
+        cfg.inv_max_rate[idx]     = 1.0f / cfg.max_rate[idx];
+        cfg.inv_acceleration[idx] = 1.0f / cfg.acceleration[idx];
+#ifdef JERK_LIMITED_PROFILE
+        cfg.jerk[idx]     = axis_settings[idx]->jerk->get();
+        cfg.inv_jerk[idx] = cfg.jerk[idx] > 0.0f ? 1.0f / cfg.jerk[idx] : 0.0f;
+#endif
+#ifdef INPUT_SHAPING
+        cfg.shaper_frequency[idx] = axis_settings[idx]->shaper_frequency->get();
+        cfg.shaper_damping[idx]   = axis_settings[idx]->shaper_damping->get();
+#endif
+#ifdef BACKLASH_COMPENSATION
+        cfg.backlash[idx] = axis_settings[idx]->backlash->get();
+#endif
+        float travel = axis_settings[idx]->max_travel->get();
+        float mpos   = axis_settings[idx]->home_mpos->get();
+        if (bit_istrue(cfg.homing_dir_mask, bit(idx))) {
+            cfg.travel_min[idx] = mpos;
+            cfg.travel_max[idx] = mpos + travel;
+        } else {
+            cfg.travel_min[idx] = mpos - travel;
+            cfg.travel_max[idx] = mpos;
+        }
+    }
+#ifdef INPUT_SHAPING
+    cfg.shaper_type = shaper_type->get();
+#endif
+#ifdef USE_KINEMATICS
+    cfg.kinematics_tolerance = kinematics_tolerance->get();
+#else
+    cfg.corexy = kinematics_type->get() != int8_t(KinematicsType::Cartesian);
+#endif
+    cfg.generation = motion_config.generation;
+    if (memcmp(&cfg, &motion_config, sizeof(cfg)) != 0) {
+        cfg.generation++;
+        memcpy(&motion_config, &cfg, sizeof(cfg));
+    }
+    st_prep_unlock();
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+/*
+  MotionConfig.h - plain copy of the settings read by the motion code
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+// Motor arrangement of the X and Y axes, set by $Kinematics/Type. CoreXY and H-bot machines mix the
+// A and B motors the same way, A = X + Y and B = X - Y, only the belt routing differs. The planner
+// mixes the steps once per block, so the stepper ISR is the same for every type. Machines built with
+// USE_KINEMATICS bring their own transform instead.
+enum class KinematicsType : int8_t {
+    Cartesian = 0,
+    CoreXY,
+    HBot,
+};
+
+// The planner, stepper, limits and position conversions read these fields instead of going through
+// the setting objects for every block. The snapshot is rebuilt by motion_config_refresh() after a
+// setting changes, and generation is bumped only when one of the copied values actually differs, so
+// modules that derive their own constants can rebuild them when generation moves.
+typedef struct {
+    uint32_t generation;
+    uint8_t  n_axis;
+    uint8_t  dir_invert_mask;
+    uint8_t  step_invert_mask;
+    uint8_t  homing_dir_mask;
+    uint32_t pulse_microseconds;
+    uint32_t dir_delay_microseconds;  // Setup time of the direction pins before a step
+    float    junction_deviation;
+    float    steps_per_mm[MAX_N_AXIS];
+    float    max_rate[MAX_N_AXIS];      // mm/min
+    float    acceleration[MAX_N_AXIS];  // mm/sec^2, as stored
+    // Reciprocals of the above, so the planner and the step to mm conversions multiply instead of dividing.
+    float mm_per_step[MAX_N_AXIS];
+    float inv_max_rate[MAX_N_AXIS];
+    float inv_acceleration[MAX_N_AXIS];
+#ifdef JERK_LIMITED_PROFILE
+    float jerk[MAX_N_AXIS];      // mm/sec^3, as stored. 0 is unlimited.
+    float inv_jerk[MAX_N_AXIS];  // 0 where the jerk is unlimited
+#endif
+#ifdef INPUT_SHAPING
+    int8_t shaper_type;                   // ShaperType
+    float  shaper_frequency[MAX_N_AXIS];  // Hz, 0 is unshaped
+    float  shaper_damping[MAX_N_AXIS];
+#endif
+#ifdef BACKLASH_COMPENSATION
+    float backlash[MAX_N_AXIS];  // mm
+#endif
+    // Soft limit box in machine coordinates, from the max travel, home position and homing direction.
+    float travel_min[MAX_N_AXIS];
+    float travel_max[MAX_N_AXIS];
+    bool  soft_limits;  // $Limits/Soft
+#ifdef USE_KINEMATICS
+    float kinematics_tolerance;  // mm
+#endif
+    bool corexy;  // X and Y are driven by the A and B motors, see KinematicsType
+} motion_config_t;
+
+extern motion_config_t motion_config;
+
+// Rebuilds motion_config if any setting has been set since the last call. Cheap when nothing changed.
+// Called from the main task, and with MOTION_PIPELINE from the motion task too, so the rebuild holds the
+// prep lock; settings can only change when idle, so readers never see a partial copy of a running job's
+// configuration.
+void motion_config_refresh();
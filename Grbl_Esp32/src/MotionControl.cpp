@@ -33,13 +33,40 @@
 
 SquaringMode ganged_mode = SquaringMode::Dual;
 
-// this allows kinematics to be used.
+#ifdef ENABLE_SPINDLE_SYNC
+static bool sync_chained = false;  // The last planned move was synchronized to the spindle
+#endif
+
+// Set while mc_arc() plans the segments of an arc it has already checked as a whole.
+static bool arc_checked = false;
+
+#ifdef MOTION_PIPELINE
+// A line motion queued by the parser for the motion task to plan.
+typedef struct {
+    float            target[MAX_N_AXIS];
+    plan_line_data_t pl_data;
+} motion_record_t;
+
+// Single producer, single consumer ring. Only the parser task advances the head and only the motion
+// task advances the tail, so the indexes need no lock. The motion task plans under the prep lock, which
+// also keeps the reset and parking code from changing the planner under it.
+static motion_record_t  motion_queue[MOTION_PIPELINE_SIZE];
+static volatile uint8_t motion_queue_head = 0;
+static volatile uint8_t motion_queue_tail = 0;
+static TaskHandle_t     motionTaskHandle  = 0;
+static void             motionTask(void* pvParameters);
+#endif
+
+// Entry point for programmed moves. With kinematics the move is still planned in machine coordinates,
+// the stepper prep converts it to joint motion, so only the target has to be checked here.
 void mc_line_kins(float* target, plan_line_data_t* pl_data, float* position) {
-#ifndef USE_KINEMATICS
-    mc_line(target, pl_data);
-#else  // else use kinematics
-    inverse_kinematics(target, pl_data, position);
+#ifdef USE_KINEMATICS
+    if (!kinematics->reachable(target)) {
+        grbl_msg_deferf(CLIENT_SERIAL, MsgLevel::Info, "Target unreachable");
+        return;
+    }
 #endif
+    mc_line(target, pl_data);
 }
 
 // Execute linear motion in absolute millimeter coordinates. Feed rate given in millimeters/second
@@ -49,19 +76,37 @@ void mc_line_kins(float* target, plan_line_data_t* pl_data, float* position) {
 // segments, must pass through this routine before being passed to the planner. The seperation of
 // mc_line and plan_buffer_line is done primarily to place non-planner-type functions from being
 // in the planner and to let backlash compensation or canned cycle integration simple and direct.
-void mc_line(float* target, plan_line_data_t* pl_data) {
+void MOTION_IRAM mc_line(float* target, plan_line_data_t* pl_data) {
+    HOT_PATH_PROFILE(HotPath::McLine);
+#ifdef PATH_BLENDING
+    blend_flush();  // A G64 move held back for blending goes first
+#endif
+#ifdef ENABLE_SPINDLE_SYNC
+    if (pl_data->sync_pitch == 0.0) {
+        sync_chained = false;
+    }
+#endif
     // If enabled, check for soft limit violations. Placed here all line motions are picked up
-    // from everywhere in Grbl.
-    if (soft_limits->get()) {
+    // from everywhere in Grbl. Arc segments are covered by the check of the whole arc.
+    if (motion_config.soft_limits && !arc_checked) {
         // NOTE: Block jog state. Jogging is a special case and soft limits are handled independently.
         if (sys.state != State::Jog) {
             limits_soft_check(target);
         }
     }
     // If in check gcode mode, prevent motion by blocking planner. Soft limits still work.
-    if (sys.state == State::CheckMode) {
+    // A simulation plans the motion, see Simulator.h.
+    if (sys.state == State::CheckMode && !sim_active()) {
         return;
     }
+#ifdef SD_CHECKPOINT
+    pl_data->sd_line = (get_sd_state(false) == SDCARD_BUSY_PRINTING) ? sd_get_current_line_number() : 0;
+#endif
+#ifdef ENABLE_HEIGHT_MAP
+    if (height_map_line(target, pl_data)) {
+        return;  // Planned as compensated pieces, each through here
+    }
+#endif
     // NOTE: Backlash compensation may be installed here. It will need direction info to track when
     // to insert a backlash line motion(s) before the intended line motion and will require its own
     // plan_check_full_buffer() and check for system abort loop. Also for position reporting
@@ -75,6 +120,26 @@ void mc_line(float* target, plan_line_data_t* pl_data) {
     // indicates to Grbl what is a backlash compensation motion, so that Grbl executes the move but
     // doesn't update the machine position values. Since the position values used by the g-code
     // parser and planner are separate from the system machine positions, this is doable.
+#ifdef SPINDLE_STATE_IN_PLANNER
+    pl_data->motion.applyState = plan_take_deferred_state();
+#endif
+#ifdef ENABLE_AUX_STREAM
+    if (!pl_data->motion.jogMotion) {
+        aux_stream_line(target, pl_data);  // The planner leaves the auxiliary axis out
+        if (sys.abort) {
+            return;
+        }
+    }
+#endif
+#ifdef MOTION_PIPELINE
+    if (mc_pipeline_queue(target, pl_data)) {
+        return;
+    }
+    mc_pipeline_drain();  // Moves the motion task cannot plan go after the queued ones
+    if (sys.abort) {
+        return;
+    }
+#endif
     // If the buffer is full: good! That means we are well ahead of the robot.
     // Remain in this loop until there is room in the buffer.
     do {
@@ -83,6 +148,11 @@ void mc_line(float* target, plan_line_data_t* pl_data) {
             return;  // Bail, if system abort.
         }
         if (plan_check_full_buffer()) {
+            if (sim_active()) {
+                sim_drain(false);
+                break;
+            }
+            plan_flush_batch();           // Plan any batched blocks before the stepper runs into them.
             protocol_auto_cycle_start();  // Auto-cycle start when buffer is full.
         } else {
             break;
@@ -93,6 +163,148 @@ void mc_line(float* target, plan_line_data_t* pl_data) {
     plan_buffer_line(target, pl_data);
 }
 
+#ifdef ENABLE_SPINDLE_SYNC
+// Spindle synchronized move (G33) of pitch mm per spindle revolution. The first move of a chain waits
+// for the motion to stop and for the spindle reference. See SpindleSync.h.
+void mc_spindle_sync_line(float* target, plan_line_data_t* pl_data, float pitch) {
+    if (sys.state == State::CheckMode) {
+        return;
+    }
+    if (!sync_chained || plan_get_current_block() == NULL) {
+        protocol_buffer_synchronize();
+        if (sys.abort) {
+            return;
+        }
+        if (!spindle_sync_begin()) {
+            if (!sys.abort) {
+                system_set_exec_alarm(ExecAlarm::SpindleControl);
+            }
+            return;
+        }
+        pl_data->sync_start = true;
+    }
+    // The planner plans for the current spindle speed, the stepper prep follows the spindle.
+    pl_data->sync_pitch            = pitch;
+    pl_data->feed_rate             = fabsf(spindle_encoder_rpm()) * pitch;
+    pl_data->motion.inverseTime    = 0;
+    pl_data->motion.noFeedOverride = 1;
+    mc_line(target, pl_data);
+    sync_chained = !pl_data->sync_start;  // Still set if the move was too short to plan
+}
+#endif
+
+#ifdef MOTION_PIPELINE
+void mc_pipeline_init() {
+    xTaskCreatePinnedToCore(motionTask,    // task
+                            "motionTask",  // name for task
+                            MOTION_TASK_STACK,
+                            NULL,  // parameters
+                            MOTION_TASK_PRIORITY,
+                            &motionTaskHandle,
+                            MOTION_TASK_CORE  // core
+    );
+}
+
+// States in which the motion task may add blocks to the planner. Parking, homing, jogging and the
+// simulation plan their own blocks from the parser task.
+static bool mc_pipeline_open() {
+    switch (sys.state) {
+        case State::Idle:
+        case State::Cycle:
+        case State::Hold:
+            return !(sys.step_control & STEP_CONTROL_EXECUTE_SYS_MOTION);
+        default:
+            return false;
+    }
+}
+
+bool mc_pipeline_queue(float* target, plan_line_data_t* pl_data) {
+    if (!mc_pipeline_open() || sim_active() || pl_data->motion.jogMotion) {
+        return false;  // A jog is started by jog_execute() right after it is planned
+    }
+#    ifdef ENABLE_LASER_RASTER
+    if (pl_data->raster) {
+        return false;  // The caller frees a scanline that was not planned
+    }
+#    endif
+#    ifdef ENABLE_SPINDLE_SYNC
+    if (pl_data->sync_pitch != 0.0) {
+        return false;  // The caller reads sync_start back
+    }
+#    endif
+    uint8_t next_head = (motion_queue_head + 1) % MOTION_PIPELINE_SIZE;
+    while (next_head == motion_queue_tail) {
+        // Full: the motion task is well ahead of the robot.
+        protocol_execute_realtime();
+        if (sys.abort) {
+            return true;  // Bail, the move is dropped with the rest.
+        }
+        protocol_auto_cycle_start();
+    }
+    motion_record_t* record = &motion_queue[motion_queue_head];
+    memcpy(record->target, target, sizeof(record->target));
+    record->pl_data = *pl_data;
+#    ifdef SYNC_USER_OUTPUTS
+    pl_data->output_events = 0;  // The record hands them to its block
+#    endif
+    __sync_synchronize();  // The record is complete before the motion task can see it
+    motion_queue_head = next_head;
+    xTaskNotifyGive(motionTaskHandle);
+    return true;
+}
+
+void mc_pipeline_drain() {
+    while (motion_queue_head != motion_queue_tail) {
+        protocol_execute_realtime();
+        if (sys.abort) {
+            return;
+        }
+    }
+}
+
+bool mc_pipeline_empty() {
+    return motion_queue_head == motion_queue_tail;
+}
+
+void mc_pipeline_reset() {
+    st_prep_lock();  // Waits for a move being planned
+    motion_queue_tail = motion_queue_head;
+    st_prep_unlock();
+}
+
+// Plans the next queued move. Returns false if there is none or it has to wait.
+static bool mc_pipeline_plan() {
+    if (motion_queue_tail == motion_queue_head || sys.abort || !mc_pipeline_open()) {
+        return false;
+    }
+    if (plan_check_full_buffer()) {
+        plan_flush_batch();           // Plan any batched blocks before the stepper runs into them.
+        protocol_auto_cycle_start();  // Auto-cycle start when buffer is full.
+        return false;
+    }
+    motion_record_t* record = &motion_queue[motion_queue_tail];
+    plan_buffer_line(record->target, &record->pl_data);
+    motion_queue_tail = (motion_queue_tail + 1) % MOTION_PIPELINE_SIZE;
+    return true;
+}
+
+// Moves queued line motions into the planner on the core the parser does not run on. Woken for each
+// queued move, and polls every tick while the planner is full or a state keeps it from planning.
+static void motionTask(void* pvParameters) {
+    while (true) {
+        task_stats_block();
+        ulTaskNotifyTake(pdTRUE, 1);
+        task_stats_unblock();
+        bool planned;
+        do {
+            st_prep_lock();
+            planned = mc_pipeline_plan();
+            st_prep_unlock();
+        } while (planned);
+    }
+}
+#endif
+
 // Execute an arc in offset mode format. position == current xyz, target == target xyz,
 // offset == offset from current xyz, axis_X defines circle plane in tool space, axis_linear is
 // the direction of helical travel, radius == circle radius, isclockwise boolean. Used
@@ -100,6 +312,79 @@ void mc_line(float* target, plan_line_data_t* pl_data) {
 // The arc is approximated by generating a huge number of tiny, linear segments. The chordal tolerance
 // of each segment is configured in the arc_tolerance setting, which is defined to be the maximum normal
 // distance from segment to the circle when the end points both lie on the circle.
+// Checks a whole arc once, before any of its segments are planned, instead of every segment in mc_line().
+// The arc stays inside the box of its end points and of the extremes of the arc axes it sweeps through,
+// so the soft limits only need the two corners of that box. Kinematic machines check that the end point
+// and those extremes are reachable. Returns false if the arc must not be run.
+static bool mc_arc_check(float*  target,
+                         float*  position,
+                         float   center_axis0,
+                         float   center_axis1,
+                         float   radius,
+                         float   angular_travel,
+                         uint8_t axis_0,
+                         uint8_t axis_1,
+                         uint8_t axis_linear) {
+    static const int8_t axis0_dir[4] = { 1, 0, -1, 0 };  // Unit vectors at 0, 90, 180 and 270 degrees
+    static const int8_t axis1_dir[4] = { 0, 1, 0, -1 };
+
+    auto  n_axis = motion_config.n_axis;
+    float box_min[MAX_N_AXIS];
+    float box_max[MAX_N_AXIS];
+    float point[MAX_N_AXIS];
+    for (uint8_t idx = 0; idx < n_axis; idx++) {
+        box_min[idx] = MIN(position[idx], target[idx]);
+        box_max[idx] = MAX(position[idx], target[idx]);
+        point[idx]   = target[idx];
+    }
+    float start_angle = atan2f(position[axis_1] - center_axis1, position[axis_0] - center_axis0);
+    float sweep       = fabsf(angular_travel);
+    for (uint8_t quadrant = 0; quadrant < 4; quadrant++) {
+        // Angle from the start point to this extreme, in the direction of travel
+        float offset = quadrant * float(M_PI / 2) - start_angle;
+        if (angular_travel < 0) {
+            offset = -offset;
+        }
+        offset = fmodf(offset, float(2 * M_PI));
+        if (offset < 0) {
+            offset += float(2 * M_PI);
+        }
+        if (offset > sweep) {
+            continue;
+        }
+        point[axis_0]      = center_axis0 + radius * axis0_dir[quadrant];
+        point[axis_1]      = center_axis1 + radius * axis1_dir[quadrant];
+        point[axis_linear] = position[axis_linear] + (target[axis_linear] - position[axis_linear]) * (offset / sweep);
+        box_min[axis_0]    = MIN(box_min[axis_0], point[axis_0]);
+        box_max[axis_0]    = MAX(box_max[axis_0], point[axis_0]);
+        box_min[axis_1]    = MIN(box_min[axis_1], point[axis_1]);
+        box_max[axis_1]    = MAX(box_max[axis_1], point[axis_1]);
+#ifdef USE_KINEMATICS
+        if (!kinematics->reachable(point)) {
+            grbl_msg_deferf(CLIENT_SERIAL, MsgLevel::Info, "Target unreachable");
+            return false;
+        }
+#endif
+    }
+#ifdef USE_KINEMATICS
+    if (!kinematics->reachable(target)) {
+        grbl_msg_deferf(CLIENT_SERIAL, MsgLevel::Info, "Target unreachable");
+        return false;
+    }
+#endif
+    if (motion_config.soft_limits) {
+        limits_soft_check(box_min);
+        if (!sys.abort) {
+            limits_soft_check(box_max);
+        }
+    }
+    return !sys.abort;
+}
+
+// The chords stay planner blocks rather than one curved block the segment prep expands. The stepper runs
+// one straight Bresenham line per block, with its steps and direction bits fixed, so the prep would have
+// to cut a curved block back into chords with their own step bookkeeping. Instead the chords are
+// planned in batches, each with one recalculation pass, see plan_begin_batch().
 void mc_arc(float*            target,
             plan_line_data_t* pl_data,
             float*            position,
@@ -115,14 +400,6 @@ void mc_arc(float*            target,
     float r_axis1      = -offset[axis_1];
     float rt_axis0     = target[axis_0] - center_axis0;
     float rt_axis1     = target[axis_1] - center_axis1;
-#ifdef USE_KINEMATICS
-    float    previous_position[MAX_N_AXIS];
-    uint16_t n;
-    auto     n_axis = number_axis->get();
-    for (n = 0; n < n_axis; n++) {
-        previous_position[n] = position[n];
-    }
-#endif
     // CCW angle between position and target from circle center. Only one atan2() trig computation required.
     float angular_travel = atan2(r_axis0 * rt_axis1 - r_axis1 * rt_axis0, r_axis0 * rt_axis0 + r_axis1 * rt_axis1);
     if (is_clockwise_arc) {  // Correct atan2 output per direction
@@ -134,6 +411,10 @@ void mc_arc(float*            target,
             angular_travel += 2 * M_PI;
         }
     }
+    if (!mc_arc_check(target, position, center_axis0, center_axis1, radius, angular_travel, axis_0, axis_1, axis_linear)) {
+        return;
+    }
+    arc_checked = true;
     // NOTE: Segment end points are on the arc, which can lead to the arc diameter being smaller by up to
     // (2x) arc_tolerance. For 99% of users, this is just fine. If a different arc segment fit
     // is desired, i.e. least-squares, midpoint on arc, just change the mm_per_arc_segment calculation.
@@ -181,52 +462,121 @@ void mc_arc(float*            target,
         float    sin_Ti;
         float    cos_Ti;
         float    r_axisi;
-        uint16_t i;
-        uint8_t  count = 0;
-        for (i = 1; i < segments; i++) {  // Increment (segments-1).
-            if (count < N_ARC_CORRECTION) {
-                // Apply vector rotation matrix. ~40 usec
-                r_axisi = r_axis0 * sin_T + r_axis1 * cos_T;
-                r_axis0 = r_axis0 * cos_T - r_axis1 * sin_T;
-                r_axis1 = r_axisi;
-                count++;
-            } else {
-                // Arc correction to radius vector. Computed only every N_ARC_CORRECTION increments. ~375 usec
-                // Compute exact location by applying transformation matrix from initial radius vector(=-offset).
-                cos_Ti  = cos(i * theta_per_segment);
-                sin_Ti  = sin(i * theta_per_segment);
-                r_axis0 = -offset[axis_0] * cos_Ti + offset[axis_1] * sin_Ti;
-                r_axis1 = -offset[axis_0] * sin_Ti - offset[axis_1] * cos_Ti;
-                count   = 0;
+        uint16_t i           = 1;
+        uint8_t  count       = 0;
+        float    linear_axis = position[axis_linear];
+        float    batch_target[ARC_BATCH_SIZE][3];  // axis_0, axis_1 and axis_linear of each segment end
+        while (i < segments) {  // Generate (segments-1) segments, one batch at a time.
+            // Size the batch to the free planner blocks, so it is normally planned in one pass without
+            // waiting. A full planner falls back to one segment at a time, as the stepper frees blocks.
+            uint16_t     batch     = MIN(ARC_BATCH_SIZE, segments - i);
+            plan_index_t available = plan_get_block_buffer_available();
+            batch                  = MAX(1, MIN(batch, available));
+            for (uint16_t n = 0; n < batch; n++, i++) {
+                if (count < N_ARC_CORRECTION) {
+                    // Apply vector rotation matrix. ~40 usec
+                    r_axisi = r_axis0 * sin_T + r_axis1 * cos_T;
+                    r_axis0 = r_axis0 * cos_T - r_axis1 * sin_T;
+                    r_axis1 = r_axisi;
+                    count++;
+                } else {
+                    // Arc correction to radius vector. Computed only every N_ARC_CORRECTION increments. ~375 usec
+                    // Compute exact location by applying transformation matrix from initial radius vector(=-offset).
+                    cos_Ti  = cos(i * theta_per_segment);
+                    sin_Ti  = sin(i * theta_per_segment);
+                    r_axis0 = -offset[axis_0] * cos_Ti + offset[axis_1] * sin_Ti;
+                    r_axis1 = -offset[axis_0] * sin_Ti - offset[axis_1] * cos_Ti;
+                    count   = 0;
+                }
+                linear_axis += linear_per_segment;
+                batch_target[n][0] = center_axis0 + r_axis0;
+                batch_target[n][1] = center_axis1 + r_axis1;
+                batch_target[n][2] = linear_axis;
             }
-            // Update arc_target location
-            position[axis_0] = center_axis0 + r_axis0;
-            position[axis_1] = center_axis1 + r_axis1;
-            position[axis_linear] += linear_per_segment;
-#ifdef USE_KINEMATICS
-            mc_line_kins(position, pl_data, previous_position);
-            previous_position[axis_0]      = position[axis_0];
-            previous_position[axis_1]      = position[axis_1];
-            previous_position[axis_linear] = position[axis_linear];
-#else
-            mc_line(position, pl_data);
+#ifndef MOTION_PIPELINE
+            plan_begin_batch();  // The motion task appends the queued segments, each planned as it arrives
 #endif
-            // Bail mid-circle on system abort. Runtime command check already performed by mc_line.
-            if (sys.abort) {
-                return;
+            for (uint16_t n = 0; n < batch; n++) {
+                // Update arc_target location
+                position[axis_0]      = batch_target[n][0];
+                position[axis_1]      = batch_target[n][1];
+                position[axis_linear] = batch_target[n][2];
+                mc_line(position, pl_data);
+                // Bail mid-circle on system abort. Runtime command check already performed by mc_line.
+                if (sys.abort) {
+#ifndef MOTION_PIPELINE
+                    plan_end_batch();
+#endif
+                    arc_checked = false;
+                    return;
+                }
             }
+#ifndef MOTION_PIPELINE
+            plan_end_batch();
+#endif
         }
     }
     // Ensure last segment arrives at target location.
-#ifdef USE_KINEMATICS
-    mc_line_kins(target, pl_data, previous_position);
-#else
     mc_line(target, pl_data);
-#endif
+    arc_checked = false;
+}
+
+#ifdef CANNED_CYCLES
+// The moves of a hole go through mc_line() like any others, so soft limits, check mode and everything
+// else there applies to each of them. Only the dwell of G82 waits for the moves before it.
+void mc_drill(float* target, plan_line_data_t* pl_data, float* position, const mc_drill_t* drill) {
+    uint8_t axis = drill->axis;
+    float   point[MAX_N_AXIS];
+    memcpy(point, position, sizeof(point));
+    pl_data->motion.rapidMotion = 1;
+    if (point[axis] < drill->r_plane) {
+        point[axis] = drill->r_plane;
+        mc_line(point, pl_data);
+    }
+    float height = point[axis];
+    memcpy(point, target, sizeof(point));
+    point[axis] = height;
+    mc_line(point, pl_data);
+    point[axis] = drill->r_plane;
+    mc_line(point, pl_data);
+
+    float depth = drill->r_plane;
+    while (!sys.abort) {
+        depth                       = drill->peck > 0.0 ? MAX(depth - drill->peck, drill->bottom) : drill->bottom;
+        pl_data->motion.rapidMotion = 0;
+        point[axis]                 = depth;
+        mc_line(point, pl_data);
+        if (depth <= drill->bottom) {
+            break;
+        }
+        pl_data->motion.rapidMotion = 1;
+        if (!drill->chip_break) {
+            point[axis] = drill->r_plane;  // Out of the hole to clear the chips
+            mc_line(point, pl_data);
+        }
+        point[axis] = MIN(depth + CANNED_CYCLE_PECK_CLEARANCE, drill->r_plane);
+        mc_line(point, pl_data);
+    }
+    if (drill->dwell > 0.0) {
+        mc_dwell(drill->dwell);
+    }
+    pl_data->motion.rapidMotion = 1;
+    point[axis]                 = drill->retract;
+    mc_line(point, pl_data);
+    memcpy(target, point, sizeof(point));
 }
+#endif
 
 // Execute dwell in seconds.
 void mc_dwell(float seconds) {
+#ifdef PATH_BLENDING
+    blend_flush();
+#endif
+    if (sim_active()) {
+        sim_drain(true);
+        sim_dwell(seconds);
+        return;
+    }
     if (sys.state == State::CheckMode) {
         return;
     }
@@ -256,8 +606,13 @@ static bool mask_has_squared_axis(uint8_t axis_mask) {
 }
 
 // return true if axis_mask refers to a single squared axis
+// With HOMING_PARALLEL_SQUARING, limits_go_home() squares the axes itself.
 static bool axis_is_squared(uint8_t axis_mask) {
+#ifdef HOMING_PARALLEL_SQUARING
+    return false;
+#else
     return mask_is_single_axis(axis_mask) && mask_has_squared_axis(axis_mask);
+#endif
 }
 
 // Perform homing cycle to locate and set machine zero. Only '$H' executes this command.
@@ -265,6 +620,12 @@ static bool axis_is_squared(uint8_t axis_mask) {
 // executing the homing cycle. This prevents incorrect buffered plans after homing.
 void mc_homing_cycle(uint8_t cycle_mask) {
     bool no_cycles_defined = true;
+#ifdef ENABLE_AUX_STREAM
+    aux_stream_synchronize();  // Homing steps every axis itself
+    if (sys.abort) {
+        return;
+    }
+#endif
 #ifdef USE_CUSTOM_HOMING
     if (user_defined_homing()) {
         return;
@@ -273,7 +634,7 @@ void mc_homing_cycle(uint8_t cycle_mask) {
     // This give kinematics a chance to do something before normal homing
     // if it returns true, the homing is canceled.
 #ifdef USE_KINEMATICS
-    if (kinematics_pre_homing(cycle_mask)) {
+    if (kinematics->pre_homing(cycle_mask)) {
         return;
     }
 #endif
@@ -288,6 +649,9 @@ void mc_homing_cycle(uint8_t cycle_mask) {
     }
 #endif
     limits_disable();  // Disable hard limits pin change register for cycle duration
+#ifdef USE_KINEMATICS
+    kinematics_set_joint_motion(true);  // Homing moves the joints directly
+#endif
     // -------------------------------------------------------------------------------------
     // Perform homing routine. NOTE: Special motion case. Only system reset works.
     n_homing_locate_cycle = NHomingLocateCycle;
@@ -338,6 +702,9 @@ void mc_homing_cycle(uint8_t cycle_mask) {
             report_status_message(Error::HomingNoCycles, CLIENT_ALL);
         }
     }
+#ifdef USE_KINEMATICS
+    kinematics_set_joint_motion(false);
+#endif
     protocol_execute_realtime();  // Check for reset and set system abort.
     if (sys.abort) {
         return;  // Did not complete. Alarm state set by mc_alarm.
@@ -347,9 +714,15 @@ void mc_homing_cycle(uint8_t cycle_mask) {
     // Sync gcode parser and planner positions to homed position.
     gc_sync_position();
     plan_sync_position();
+#ifdef USE_KINEMATICS
+    st_sync_joint_steps();  // The joints were homed, sys_position no longer matches the prep
+#endif
+    if (!cycle_mask) {
+        warm_restart_homed();  // All the axes are known
+    }
 #ifdef USE_KINEMATICS
     // This give kinematics a chance to do something after normal homing
-    kinematics_post_homing();
+    kinematics->post_homing();
 #endif
     // If hard limits feature enabled, re-enable hard limits pin change register after homing cycle.
     limits_init();
@@ -357,6 +730,99 @@ void mc_homing_cycle(uint8_t cycle_mask) {
 
 // Perform tool length probe cycle. Requires probe switch.
 // NOTE: Upon probe failure, the program will be stopped and placed into ALARM state.
+// Queues a probing move and runs it until the probe trips or the move ends. Returns false on abort.
+static bool mc_probe_move(float* target, plan_line_data_t* pl_data) {
+    // Setup and queue probing motion. Auto cycle-start should not start the cycle.
+    mc_line(target, pl_data);
+#ifdef MOTION_PIPELINE
+    mc_pipeline_drain();  // The cycle start below needs the move in the planner
+#endif
+    // Activate the probe pin interrupt. An edge may have come between the check before and now, so
+    // look at the pin once more.
+    sys_probe_state = PROBE_ACTIVE;
+    probe_state_monitor();
+    // Perform probing cycle. Wait here until probe is triggered or motion completes.
+    system_set_exec_state_flag(EXEC_CYCLE_START);
+    do {
+        protocol_execute_realtime();
+        if (sys.abort) {
+            return false;  // Check for system abort
+        }
+    } while (sys.state != State::Idle);
+    return true;
+}
+
+#ifdef PROBE_TWO_STAGE
+// Backs off from the contact found by the seek from start to target and probes it again slowly. The
+// probe position latched by the slow approach replaces the one of the seek. Returns false on abort or
+// if the probe is still tripped after backing off.
+static bool mc_probe_measure(int32_t* start_steps, float* target, plan_line_data_t* pl_data) {
+    auto  n_axis  = motion_config.n_axis;
+    float retract = probe_retract->get();
+    float start[MAX_N_AXIS];
+    float contact[MAX_N_AXIS];
+    float unit_vec[MAX_N_AXIS];
+    system_convert_array_steps_to_mpos(start, start_steps);
+    system_convert_array_steps_to_mpos(contact, sys_probe_position);
+    float length  = 0.0;
+    float reached = 0.0;  // Distance to the contact along the path
+    for (uint8_t idx = 0; idx < n_axis; idx++) {
+        unit_vec[idx] = target[idx] - start[idx];
+        length += unit_vec[idx] * unit_vec[idx];
+    }
+    length = sqrtf(length);
+    if (length == 0.0) {
+        return true;  // Tripped as the seek started, nothing to back off along
+    }
+    for (uint8_t idx = 0; idx < n_axis; idx++) {
+        unit_vec[idx] /= length;
+        reached += (contact[idx] - start[idx]) * unit_vec[idx];
+    }
+    // Remove the rest of the seek, which stopped a little past the contact.
+    st_reset();
+    plan_reset();
+    plan_sync_position();
+
+    plan_line_data_t retract_data = *pl_data;
+    retract_data.motion.rapidMotion = 1;
+    float back[MAX_N_AXIS];
+    memcpy(back, target, sizeof(back));  // Axes beyond n_axis don't move
+    for (uint8_t idx = 0; idx < n_axis; idx++) {
+        back[idx] = contact[idx] - unit_vec[idx] * MIN(retract, reached);
+    }
+    mc_line(back, &retract_data);
+    protocol_buffer_synchronize();
+    if (sys.abort) {
+        return false;
+    }
+    if (probe_get_state()) {
+        system_set_exec_alarm(ExecAlarm::ProbeFailInitial);
+        protocol_execute_realtime();
+        return false;
+    }
+
+    plan_line_data_t slow_data   = *pl_data;
+    slow_data.feed_rate          = probe_slow_feed->get();
+    slow_data.motion.inverseTime = 0;
+    float slow_end[MAX_N_AXIS];
+    memcpy(slow_end, target, sizeof(slow_end));
+    float slow_to = MIN(length, reached + retract);
+    for (uint8_t idx = 0; idx < n_axis; idx++) {
+        slow_end[idx] = start[idx] + unit_vec[idx] * slow_to;
+    }
+    return mc_probe_move(slow_end, &slow_data);
+}
+
+// Only a seek toward the work, faster than the slow approach, is worth a second stage.
+static bool mc_probe_two_stage(uint8_t is_probe_away, plan_line_data_t* pl_data) {
+    float slow_feed = probe_slow_feed->get();
+    if (is_probe_away || slow_feed <= 0.0 || probe_retract->get() <= 0.0) {
+        return false;
+    }
+    return pl_data->motion.inverseTime || pl_data->feed_rate > slow_feed;
+}
+#endif
+
 GCUpdatePos mc_probe_cycle(float* target, plan_line_data_t* pl_data, uint8_t parser_flags) {
     // TODO: Need to update this cycle so it obeys a non-auto cycle start.
     if (sys.state == State::CheckMode) {
@@ -384,18 +850,22 @@ GCUpdatePos mc_probe_cycle(float* target, plan_line_data_t* pl_data, uint8_t par
         probe_configure_invert_mask(false);  // Re-initialize invert mask before returning.
         return GCUpdatePos::None;            // Nothing else to do but bail.
     }
-    // Setup and queue probing motion. Auto cycle-start should not start the cycle.
-    mc_line(target, pl_data);
-    // Activate the probing state monitor in the stepper module.
-    sys_probe_state = PROBE_ACTIVE;
-    // Perform probing cycle. Wait here until probe is triggered or motion completes.
-    system_set_exec_state_flag(EXEC_CYCLE_START);
-    do {
-        protocol_execute_realtime();
-        if (sys.abort) {
-            return GCUpdatePos::None;  // Check for system abort
+#ifdef PROBE_TWO_STAGE
+    int32_t start_steps[MAX_N_AXIS];
+    system_get_position(start_steps);
+#endif
+    if (!mc_probe_move(target, pl_data)) {
+        return GCUpdatePos::None;
+    }
+#ifdef PROBE_TWO_STAGE
+    if (sys_probe_state != PROBE_ACTIVE && mc_probe_two_stage(is_probe_away, pl_data)) {
+        if (!mc_probe_measure(start_steps, target, pl_data)) {
+            sys_probe_state = PROBE_OFF;
+            probe_configure_invert_mask(false);
+            return GCUpdatePos::None;
         }
-    } while (sys.state != State::Idle);
+    }
+#endif
     // Probing cycle complete!
     // Set state variables and error out, if the probe failed and cycle with error is enabled.
     if (sys_probe_state == PROBE_ACTIVE) {
@@ -431,9 +901,11 @@ void mc_parking_motion(float* parking_target, plan_line_data_t* pl_data) {
     if (sys.abort) {
         return;  // Block during abort.
     }
+    st_prep_lock();  // Keeps the motion task off the planner head the parking motion uses
     uint8_t plan_status = plan_buffer_line(parking_target, pl_data);
     if (plan_status) {
         bit_true(sys.step_control, STEP_CONTROL_EXECUTE_SYS_MOTION);
+        st_prep_unlock();
         bit_false(sys.step_control, STEP_CONTROL_END_MOTION);  // Allow parking motion to execute, if feed hold is active.
         st_parking_setup_buffer();                             // Setup step segment buffer for special parking motion case
         st_prep_buffer();
@@ -447,6 +919,7 @@ void mc_parking_motion(float* parking_target, plan_line_data_t* pl_data) {
         st_parking_restore_buffer();  // Restore step segment buffer to normal run state.
     } else {
         bit_false(sys.step_control, STEP_CONTROL_EXECUTE_SYS_MOTION);
+        st_prep_unlock();
         protocol_exec_rt_system();
     }
 }
@@ -485,6 +958,9 @@ void mc_reset() {
             report_feedback_message(Message::SdFileQuit);
             closeFile();
         }
+#    ifdef SD_JOB_QUEUE
+        sd_queue_clear();
+#    endif
 #endif
         // Kill steppers only if in any motion state, i.e. cycle, actively holding, or homing.
         // NOTE: If steppers are kept enabled via the step idle delay setting, this also keeps
@@ -500,7 +976,15 @@ void mc_reset() {
                 system_set_exec_alarm(ExecAlarm::AbortCycle);
             }
             st_go_idle();  // Force kill steppers. Position has likely been lost.
+            warm_restart_lost();
         }
+#ifdef ENABLE_AUX_STREAM
+        // The auxiliary axis may be moving in any state
+        if (aux_stream_abort() && sys_rt_exec_alarm == ExecAlarm::None) {
+            system_set_exec_alarm(ExecAlarm::AbortCycle);
+            st_go_idle();
+        }
+#endif
         ganged_mode = SquaringMode::Dual;  // in case an error occurred during squaring
 
 #ifdef USE_I2S_STEPS
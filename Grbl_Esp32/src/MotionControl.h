@@ -32,12 +32,44 @@ const int PARKING_MOTION_LINE_NUMBER = 0;
 
 #define HOMING_CYCLE_ALL 0  // Must be zero.
 
+#ifdef MOTION_PIPELINE
+#    ifndef USE_STEPPER_PREP_TASK
+#        error "MOTION_PIPELINE requires USE_STEPPER_PREP_TASK"
+#    endif
+#    ifndef MOTION_PIPELINE_SIZE
+#        define MOTION_PIPELINE_SIZE 16
+#    endif
+#endif
+
+#ifdef CANNED_CYCLES
+// Distance G73 backs off between pecks, and G83 stops above the last peck before it feeds again, in mm
+#    ifndef CANNED_CYCLE_PECK_CLEARANCE
+#        define CANNED_CYCLE_PECK_CLEARANCE 0.254
+#    endif
+
+// One hole of a canned cycle, in machine coordinates of the drilling axis
+typedef struct {
+    float   r_plane;     // Where the feed starts
+    float   bottom;      // Depth of the hole
+    float   retract;     // Where the tool goes at the end, the R plane or the start height
+    float   peck;        // Feed per peck, 0 to drill in one pass
+    float   dwell;       // At the bottom, in seconds
+    bool    chip_break;  // Back off by CANNED_CYCLE_PECK_CLEARANCE between pecks instead of leaving the hole
+    uint8_t axis;        // Drilling axis
+} mc_drill_t;
+#endif
+
 // Execute linear motion in absolute millimeter coordinates. Feed rate given in millimeters/second
 // unless invert_feed_rate is true. Then the feed_rate means that the motion should be completed in
 // (1 minute)/feed_rate time.
 void mc_line_kins(float* target, plan_line_data_t* pl_data, float* position);
 void mc_line(float* target, plan_line_data_t* pl_data);
 
+#ifdef ENABLE_SPINDLE_SYNC
+// Spindle synchronized line (G33) of pitch mm per spindle revolution.
+void mc_spindle_sync_line(float* target, plan_line_data_t* pl_data, float pitch);
+#endif
+
 // Execute an arc in offset mode format. position == current xyz, target == target xyz,
 // offset == offset from current xyz, axis_XXX defines circle plane in tool space, axis_linear is
 // the direction of helical travel, radius == circle radius, is_clockwise_arc boolean. Used
@@ -52,6 +84,13 @@ void mc_arc(float*            target,
             uint8_t           axis_linear,
             uint8_t           is_clockwise_arc);
 
+#ifdef CANNED_CYCLES
+// Drills a hole at target, which the other axes move to at the current height of the drilling axis, first
+// raised to the R plane if below it. position is the current position. Returns with target at the retract
+// position the tool ends at.
+void mc_drill(float* target, plan_line_data_t* pl_data, float* position, const mc_drill_t* drill);
+#endif
+
 // Dwell for a specific number of seconds
 void mc_dwell(float seconds);
 
@@ -70,6 +109,19 @@ void mc_parking_motion(float* parking_target, plan_line_data_t* pl_data);
 // Performs system reset. If in motion state, kills all motion and sets system alarm.
 void mc_reset();
 
+#ifdef MOTION_PIPELINE
+// Starts the motion task that plans the moves mc_line() queues.
+void mc_pipeline_init();
+// Queues a line motion for the motion task, waiting while the queue is full. Returns false if the move
+// has to be planned directly, in a state the motion task does not plan in or for a move the caller reads back.
+bool mc_pipeline_queue(float* target, plan_line_data_t* pl_data);
+// Waits until the motion task has planned every queued move, or for an abort.
+void mc_pipeline_drain();
+bool mc_pipeline_empty();
+// Drops the queued moves. Called on reset.
+void mc_pipeline_reset();
+#endif
+
 enum class SquaringMode : uint8_t {
     Dual,  // both motors run
     A,     // A motor runs
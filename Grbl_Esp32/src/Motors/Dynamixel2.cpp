@@ -27,6 +27,31 @@
 #include "Dynamixel2.h"
 
 namespace Motors {
+    // Motors that answered a ping, by axis and gang. The first of them runs the bus for all of them
+    // once per servo cycle.
+    static Dynamixel2* bus_motors[MAX_N_AXIS][2] = {};
+    static Dynamixel2* bus_master                = nullptr;
+
+    // The position and servo count ranges of an axis. The count range is swapped for an inverted axis.
+    static void dxl_axis_range(uint8_t axis, float& position_min, float& position_max, float& count_min, float& count_max) {
+        float travel = axis_settings[axis]->max_travel->get();
+        float mpos   = axis_settings[axis]->home_mpos->get();
+
+        if (bit_istrue(homing_dir_mask->get(), bit(axis))) {
+            position_min = mpos;
+            position_max = mpos + travel;
+        } else {
+            position_min = mpos - travel;
+            position_max = mpos;
+        }
+
+        count_min = DXL_COUNT_MIN;
+        count_max = DXL_COUNT_MAX;
+
+        if (bit_istrue(dir_invert_mask->get(), bit(axis)))  // normal direction
+            swap(count_min, count_max);
+    }
+
     Dynamixel2::Dynamixel2() {}
 
     Dynamixel2::Dynamixel2(uint8_t axis_index, uint8_t id, uint8_t tx_pin, uint8_t rx_pin, uint8_t rts_pin) {
@@ -65,6 +90,10 @@ namespace Motors {
             return;
         }
 
+        bus_motors[_axis_index][_dual_axis_index] = this;
+        if (bus_master == nullptr)
+            bus_master = this;
+
         set_disable(true);                              // turn off torque so we can set EEPROM registers
         set_operating_mode(DXL_CONTROL_MODE_POSITION);  // set it in the right control mode
 
@@ -91,9 +120,9 @@ namespace Motors {
 
         _dxl_tx_message[DXL_MSG_INSTR] = DXL_INSTR_PING;
 
-        dxl_finish_message(_id, _dxl_tx_message, len);
+        len = dxl_finish_message(_id, _dxl_tx_message, len);
 
-        len = dxl_get_response(PING_RSP_LEN);  // wait for and get response
+        len = dxl_get_response(len, PING_RSP_LEN);  // wait for and get response
 
         if (len == PING_RSP_LEN) {
             uint16_t model_num = _dxl_rx_message[10] << 8 | _dxl_rx_message[9];
@@ -149,6 +178,7 @@ namespace Motors {
             return;
 
         _disabled = disable;
+        _has_goal = false;
 
         if (_disabled)
             dxl_write(DXL_ADDR_TORQUE_EN, param_count, 0);
@@ -161,15 +191,12 @@ namespace Motors {
         dxl_write(DXL_OPERATING_MODE, param_count, mode);
     }
 
+    // Every motor gets called each servo cycle, but the bus master does the work for all of them.
     void Dynamixel2::update() {
-        if (!is_active)
+        if (!is_active || this != bus_master)
             return;
 
-        if (_disabled) {
-            dxl_read_position();
-        } else {
-            dxl_bulk_goal_position();  // call the static method that updates all at once
-        }
+        dxl_bus_update();
     }
 
     /*
@@ -187,9 +214,7 @@ namespace Motors {
 
         grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Dynamixel UART TX:%d RX:%d RTS:%d", DYNAMIXEL_TXD, DYNAMIXEL_RXD, DYNAMIXEL_RTS);
 
-        uart_driver_delete(UART_NUM_2);
-
-        // setup the comm port as half duplex
+        // The comm port is half duplex, shared with the other devices on the RS485 bus
         uart_config_t uart_config = {
             .baud_rate           = DYNAMIXEL_BAUD_RATE,
             .data_bits           = UART_DATA_8_BITS,
@@ -199,13 +224,8 @@ namespace Motors {
             .rx_flow_ctrl_thresh = 122,
         };
 
-        // Configure UART parameters
-        uart_param_config(UART_NUM_2, &uart_config);
-        uart_set_pin(UART_NUM_2, DYNAMIXEL_TXD, DYNAMIXEL_RXD, DYNAMIXEL_RTS, UART_PIN_NO_CHANGE);
-        uart_driver_install(UART_NUM_2, DYNAMIXEL_BUF_SIZE * 2, 0, 0, NULL, 0);
-        uart_set_mode(UART_NUM_2, UART_MODE_RS485_HALF_DUPLEX);
-
-        uart_ready = true;
+        // The servos wait their return delay time before answering, so the bus needs no turnaround gap
+        uart_ready = RS485::bus.begin(uart_config, DYNAMIXEL_TXD, DYNAMIXEL_RXD, DYNAMIXEL_RTS, 0);
     }
 
     void Dynamixel2::set_location() {}
@@ -231,46 +251,6 @@ namespace Motors {
                   (position & 0xFF000000) >> 24);
     }
 
-    uint32_t Dynamixel2::dxl_read_position() {
-        uint8_t data_len = 4;
-
-        dxl_read(DXL_PRESENT_POSITION, data_len);
-
-        data_len = dxl_get_response(15);
-
-        if (data_len == 15) {
-            uint32_t dxl_position = _dxl_rx_message[9] | (_dxl_rx_message[10] << 8) | (_dxl_rx_message[11] << 16) |
-                                    (_dxl_rx_message[12] << 24);
-
-            read_settings();
-
-            int32_t pos_min_steps = lround(_position_min * axis_settings[_axis_index]->steps_per_mm->get());
-            int32_t pos_max_steps = lround(_position_max * axis_settings[_axis_index]->steps_per_mm->get());
-
-            int32_t temp = map(dxl_position, DXL_COUNT_MIN, DXL_COUNT_MAX, pos_min_steps, pos_max_steps);
-
-            sys_position[_axis_index] = temp;
-
-            plan_sync_position();
-
-            return dxl_position;
-        } else {
-            return 0;
-        }
-    }
-
-    void Dynamixel2::dxl_read(uint16_t address, uint16_t data_len) {
-        uint8_t msg_len = 3 + 4;
-
-        _dxl_tx_message[DXL_MSG_INSTR]     = DXL_READ;
-        _dxl_tx_message[DXL_MSG_START]     = (address & 0xFF);            // low-order address value
-        _dxl_tx_message[DXL_MSG_START + 1] = ((address & 0xFF00) >> 8);   // High-order address value
-        _dxl_tx_message[DXL_MSG_START + 2] = (data_len & 0xFF);           // low-order data length value
-        _dxl_tx_message[DXL_MSG_START + 3] = ((data_len & 0xFF00) >> 8);  // high-order address value
-
-        dxl_finish_message(_id, _dxl_tx_message, msg_len);
-    }
-
     void Dynamixel2::LED_on(bool on) {
         uint8_t param_count = 1;
 
@@ -280,9 +260,10 @@ namespace Motors {
             dxl_write(DXL_ADDR_LED_ON, param_count, 0);
     }
 
-    // wait for and get the servo response
-    uint16_t Dynamixel2::dxl_get_response(uint16_t length) {
-        length = uart_read_bytes(UART_NUM_2, _dxl_rx_message, length, DXL_RESPONSE_WAIT_TICKS);
+    // send the message and wait for and get the servo response
+    uint16_t Dynamixel2::dxl_get_response(uint16_t tx_length, uint16_t length) {
+        length = RS485::bus.transact(
+            reinterpret_cast<const uint8_t*>(_dxl_tx_message), tx_length, _dxl_rx_message, length, DXL_RESPONSE_WAIT_TICKS);
         return length;
     }
 
@@ -304,10 +285,9 @@ namespace Motors {
         }
         va_end(valist);  // Cleans up the list
 
-        dxl_finish_message(_id, _dxl_tx_message, msg_offset + 4);
+        uint16_t len = dxl_finish_message(_id, _dxl_tx_message, msg_offset + 4);
 
-        uint16_t len = 11;  // response length
-        len          = dxl_get_response(len);
+        len = dxl_get_response(len, 11);  // response length is 11
 
         if (len == 11) {
             uint8_t err = _dxl_rx_message[8];
@@ -345,57 +325,71 @@ namespace Motors {
     /*
         Static
 
-        This will sync all the motors in one command
-        It looks for IDs in the array of axes
+        One bus cycle. One SYNC_WRITE sets the goals of the enabled motors and one SYNC_READ asks the
+        disabled ones where they are. Both are queued for the RS485 bus task, which parses the position
+        responses as they arrive. Nothing here blocks on the bus.
+    */
+    void Dynamixel2::dxl_bus_update() {
+        dxl_bulk_goal_position();
+        dxl_bulk_read_position();
+    }
+
+    /*
+        Static
+
+        This will sync all the enabled motors in one command
+
+        The goal is where the axis will be SERVO_LOOKAHEAD_MS from now. The profile velocity, which
+        the servo reads just ahead of the goal, is set so it gets from the last goal to this one in one
+        servo interval instead of jumping there at full speed.
 
     */
     void Dynamixel2::dxl_bulk_goal_position() {
-        char  tx_message[100];  // outgoing to dynamixel
-        float position_min, position_max;
-        float dxl_count_min, dxl_count_max;
+        RS485::Request request;
+        char*          tx_message = reinterpret_cast<char*>(request.msg);  // outgoing to dynamixel
+        float          position_min, position_max;
+        float          dxl_count_min, dxl_count_max;
 
         uint16_t msg_index = DXL_MSG_INSTR;  // index of the byte in the message we are currently filling
         uint32_t dxl_position;
         uint8_t  count = 0;
-        uint8_t  current_id;
 
         tx_message[msg_index]   = DXL_SYNC_WRITE;
-        tx_message[++msg_index] = DXL_GOAL_POSITION & 0xFF;           // low order address
-        tx_message[++msg_index] = (DXL_GOAL_POSITION & 0xFF00) >> 8;  // high order address
-        tx_message[++msg_index] = 4;                                  // low order data length
-        tx_message[++msg_index] = 0;                                  // high order data length
+        tx_message[++msg_index] = DXL_PROFILE_VELOCITY & 0xFF;           // low order address
+        tx_message[++msg_index] = (DXL_PROFILE_VELOCITY & 0xFF00) >> 8;  // high order address
+        tx_message[++msg_index] = 8;                                     // low order data length
+        tx_message[++msg_index] = 0;                                     // high order data length
 
         auto n_axis = number_axis->get();
         for (uint8_t axis = X_AXIS; axis < n_axis; axis++) {
             for (uint8_t gang_index = 0; gang_index < 2; gang_index++) {
-                current_id = ids[axis][gang_index];
-                if (current_id != 0) {
+                Dynamixel2* motor = bus_motors[axis][gang_index];
+                if (motor != nullptr && !motor->_disabled) {
                     count++;  // keep track of the count for the message length
 
                     //determine the location of the axis
-                    float target = system_convert_axis_steps_to_mpos(sys_position, axis);  // get the axis machine position in mm
-
-                    float travel = axis_settings[axis]->max_travel->get();
-                    float mpos   = axis_settings[axis]->home_mpos->get();
-
-                    if (bit_istrue(homing_dir_mask->get(), bit(axis))) {
-                        position_min = mpos;
-                        position_max = mpos + travel;
-                    } else {
-                        position_min = mpos - travel;
-                        position_max = mpos;
-                    }
-
-                    dxl_count_min = DXL_COUNT_MIN;
-                    dxl_count_max = DXL_COUNT_MAX;
+                    float target = system_convert_axis_steps_to_mpos(servo_target_steps, axis);  // get the axis machine position in mm
 
-                    if (bit_istrue(dir_invert_mask->get(), bit(axis)))  // normal direction
-                        swap(dxl_count_min, dxl_count_max);
+                    dxl_axis_range(axis, position_min, position_max, dxl_count_min, dxl_count_max);
 
                     // map the mm range to the servo range
                     dxl_position = (uint32_t)mapConstrain(target, position_min, position_max, dxl_count_min, dxl_count_max);
 
-                    tx_message[++msg_index] = current_id;                         // ID of the servo
+                    // 0 is no limit, used for the first goal and when standing still
+                    uint32_t velocity = 0;
+                    if (motor->_has_goal && dxl_position != motor->_last_goal) {
+                        float counts = abs(int32_t(dxl_position - motor->_last_goal));
+                        float rpm    = counts * (1000.0 / SERVO_TIMER_INTERVAL) * 60.0 / DXL_COUNTS_PER_REV;
+                        velocity     = constrain(lround(rpm / DXL_PROFILE_VELOCITY_UNIT), 1, DXL_PROFILE_VELOCITY_LIMIT);
+                    }
+                    motor->_last_goal = dxl_position;
+                    motor->_has_goal  = true;
+
+                    tx_message[++msg_index] = motor->_id;                         // ID of the servo
+                    tx_message[++msg_index] = velocity & 0xFF;                    // data
+                    tx_message[++msg_index] = (velocity & 0xFF00) >> 8;           // data
+                    tx_message[++msg_index] = (velocity & 0xFF0000) >> 16;        // data
+                    tx_message[++msg_index] = (velocity & 0xFF000000) >> 24;      // data
                     tx_message[++msg_index] = dxl_position & 0xFF;                // data
                     tx_message[++msg_index] = (dxl_position & 0xFF00) >> 8;       // data
                     tx_message[++msg_index] = (dxl_position & 0xFF0000) >> 16;    // data
@@ -403,19 +397,138 @@ namespace Motors {
                 }
             }
         }
-        dxl_finish_message(DXL_BROADCAST_ID, tx_message, (count * 5) + 7);
+        if (count == 0)
+            return;
+
+        request.tx_length = dxl_finish_message(DXL_BROADCAST_ID, tx_message, (count * 9) + 7);
+        dxl_submit(request, 0);
+    }
+
+    /*
+        Static
+
+        Asks all the disabled motors for their present position in one command. They answer one
+        after another in ID order and dxl_parse_responses() picks the answers up as they arrive.
+
+    */
+    void Dynamixel2::dxl_bulk_read_position() {
+        RS485::Request request;
+        char*          tx_message = reinterpret_cast<char*>(request.msg);  // outgoing to dynamixel
+
+        uint16_t msg_index = DXL_MSG_INSTR;  // index of the byte in the message we are currently filling
+        uint8_t  count     = 0;
+
+        tx_message[msg_index]   = DXL_SYNC_READ;
+        tx_message[++msg_index] = DXL_PRESENT_POSITION & 0xFF;           // low order address
+        tx_message[++msg_index] = (DXL_PRESENT_POSITION & 0xFF00) >> 8;  // high order address
+        tx_message[++msg_index] = 4;                                     // low order data length
+        tx_message[++msg_index] = 0;                                     // high order data length
+
+        auto n_axis = number_axis->get();
+        for (uint8_t axis = X_AXIS; axis < n_axis; axis++) {
+            for (uint8_t gang_index = 0; gang_index < 2; gang_index++) {
+                Dynamixel2* motor = bus_motors[axis][gang_index];
+                if (motor != nullptr && motor->_disabled) {
+                    count++;
+                    tx_message[++msg_index] = motor->_id;
+                }
+            }
+        }
+        if (count == 0)
+            return;
+
+        request.tx_length = dxl_finish_message(DXL_BROADCAST_ID, tx_message, count + 7);
+        dxl_submit(request, count * (DXL_STATUS_LEN + 7));
+    }
+
+    /*
+        Static
+
+        Queues a request for the RS485 bus task without waiting. A cycle that does not fit is dropped,
+        the next one supersedes it.
+
+    */
+    void Dynamixel2::dxl_submit(RS485::Request& request, uint16_t rx_length) {
+        request.device    = &bus_device;
+        request.context   = 0;
+        request.flags     = 0;
+        request.attempts  = 1;
+        request.rx_length = rx_length;
+        request.timeout   = DXL_RESPONSE_WAIT_TICKS;
+        RS485::bus.submit(request, RS485::Priority::High);
+    }
+
+    // Called by the RS485 bus task with the status packets that answer a SYNC_READ
+    bool Dynamixel2::BusDevice::response(const RS485::Request& request, const uint8_t* response, int length) {
+        dxl_parse_responses(response, length);
+        return true;
+    }
+
+    /*
+        Static
+
+        Parses the complete status packets among the bytes received. The answers of motors that did
+        not make it before the timeout are skipped.
+
+    */
+    void Dynamixel2::dxl_parse_responses(const uint8_t* bus_rx, int bus_rx_len) {
+        bool     moved = false;
+        uint16_t pos   = 0;
+        while (bus_rx_len - pos > DXL_MSG_INSTR) {
+            const uint8_t* msg = &bus_rx[pos];
+            if (msg[DXL_MSG_HDR1] != 0xFF || msg[DXL_MSG_HDR2] != 0xFF || msg[DXL_MSG_HDR3] != 0xFD || msg[DXL_MSG_RSRV] != 0x00) {
+                pos++;  // resync on the next header
+                continue;
+            }
+            uint16_t msg_len = msg[DXL_MSG_LEN_L] | (msg[DXL_MSG_LEN_H] << 8);
+            if (bus_rx_len - pos < msg_len + 7)
+                break;  // the rest did not arrive
+
+            uint16_t crc = dxl_update_crc(0, (char*)msg, 5 + msg_len);
+            if (msg_len == DXL_STATUS_LEN && msg[DXL_MSG_INSTR] == DXL_STATUS && msg[DXL_MSG_START] == 0 &&
+                crc == (msg[msg_len + 5] | (msg[msg_len + 6] << 8))) {
+                uint32_t dxl_position = msg[DXL_MSG_START + 1] | (msg[DXL_MSG_START + 2] << 8) | (msg[DXL_MSG_START + 3] << 16) |
+                                        (msg[DXL_MSG_START + 4] << 24);
+                moved |= dxl_set_read_position(msg[DXL_MSG_ID], dxl_position);
+            }
+            pos += msg_len + 7;
+        }
+        if (moved)
+            plan_sync_position();
+    }
+
+    // Static. Sets the axis position of a disabled motor from its servo count.
+    bool Dynamixel2::dxl_set_read_position(uint8_t id, uint32_t dxl_position) {
+        float position_min, position_max;
+        float dxl_count_min, dxl_count_max;
+
+        auto n_axis = number_axis->get();
+        for (uint8_t axis = X_AXIS; axis < n_axis; axis++) {
+            for (uint8_t gang_index = 0; gang_index < 2; gang_index++) {
+                Dynamixel2* motor = bus_motors[axis][gang_index];
+                if (motor != nullptr && motor->_id == id && motor->_disabled) {
+                    dxl_axis_range(axis, position_min, position_max, dxl_count_min, dxl_count_max);
+                    // The count range may be swapped, so constrain the result rather than the count
+                    float mm           = map_float(float(dxl_position), dxl_count_min, dxl_count_max, position_min, position_max);
+                    mm                 = constrain_float(mm, position_min, position_max);
+                    sys_position[axis] = lround(mm * axis_settings[axis]->steps_per_mm->get());
+                    return true;
+                }
+            }
+        }
+        return false;
     }
 
     /*
     Static
 
-    This is a helper function to complete and send the message
+    This is a helper function to complete the message
     The body of the message should be in msg, at the correct location
     before calling this function.
     This function will add the header, length bytes and CRC
-    It will then send the message
+    It returns the length of the message to send
 */
-    void Dynamixel2::dxl_finish_message(uint8_t id, char* msg, uint16_t msg_len) {
+    uint16_t Dynamixel2::dxl_finish_message(uint8_t id, char* msg, uint16_t msg_len) {
         //uint16_t msg_len;
         uint16_t crc = 0;
         // header
@@ -437,8 +550,7 @@ namespace Motors {
         msg[msg_len + 5] = crc & 0xFF;  // CRC_L
         msg[msg_len + 6] = (crc & 0xFF00) >> 8;
 
-        uart_flush(UART_NUM_2);
-        uart_write_bytes(UART_NUM_2, msg, msg_len + 7);
+        return msg_len + 7;
     }
 
     // from http://emanual.robotis.com/docs/en/dxl/crc/
@@ -44,18 +44,27 @@ const int DXL_INSTR_PING = 0x01;
 const int PING_RSP_LEN   = 14;
 const int DXL_READ       = 0x02;
 const int DXL_WRITE      = 0x03;
+const int DXL_SYNC_READ  = 0x82;
 const int DXL_SYNC_WRITE = 0x83;
+const int DXL_STATUS     = 0x55;  // instruction byte of a status packet
+const int DXL_STATUS_LEN = 8;     // length field of a status packet carrying 4 bytes of data
 
 // protocol 2 register locations
 const int DXL_OPERATING_MODE   = 11;
 const int DXL_ADDR_TORQUE_EN   = 64;
 const int DXL_ADDR_LED_ON      = 65;
+const int DXL_PROFILE_VELOCITY = 112;  // 0x70, directly followed by the goal position
 const int DXL_GOAL_POSITION    = 116;  // 0x74
 const int DXL_PRESENT_POSITION = 132;  // 0x84
 
 // control modes
 const int DXL_CONTROL_MODE_POSITION = 3;
 
+// profile velocity units with the default velocity based profile
+const float DXL_COUNTS_PER_REV         = 4096.0;
+const float DXL_PROFILE_VELOCITY_UNIT  = 0.229;  // rpm
+const int   DXL_PROFILE_VELOCITY_LIMIT = 32767;
+
 #ifndef DXL_COUNT_MIN
 #    define DXL_COUNT_MIN 1024
 #endif
@@ -69,6 +78,7 @@ const int DXL_CONTROL_MODE_POSITION = 3;
 #endif
 
 #include "Motor.h"
+#include "../Rs485Bus.h"
 
 namespace Motors {
     class Dynamixel2 : public Motor {
@@ -95,22 +105,34 @@ namespace Motors {
         uint8_t _dxl_rx_message[50];  // received from dynamixel
 
         bool     test();
-        uint16_t dxl_get_response(uint16_t length);
-        uint32_t dxl_read_position();
-        void     dxl_read(uint16_t address, uint16_t data_len);
+        uint16_t dxl_get_response(uint16_t tx_length, uint16_t length);
         void     dxl_write(uint16_t address, uint8_t paramCount, ...);
         void     dxl_goal_position(int32_t position);  // set one motor
         void     set_operating_mode(uint8_t mode);
         void     LED_on(bool on);
 
         static void     init_uart(uint8_t id, uint8_t axis_index, uint8_t dual_axis_index);
-        static void     dxl_finish_message(uint8_t id, char* msg, uint16_t msg_len);
+        static uint16_t dxl_finish_message(uint8_t id, char* msg, uint16_t msg_len);
         static uint16_t dxl_update_crc(uint16_t crc_accum, char* data_blk_ptr, uint8_t data_blk_size);
-        static void     dxl_bulk_goal_position();  // set all motorsd init_uart(uint8_t id, uint8_t axis_index, uint8_t dual_axis_index);
+        static void     dxl_bus_update();          // one servo cycle for all motors on the bus
+        static void     dxl_bulk_goal_position();  // set all enabled motors
+        static void     dxl_bulk_read_position();  // ask all disabled motors for their position
+        static void     dxl_submit(RS485::Request& request, uint16_t rx_length);
+        static void     dxl_parse_responses(const uint8_t* bus_rx, int bus_rx_len);
+        static bool     dxl_set_read_position(uint8_t id, uint32_t dxl_position);
+
+        // The motors on the RS485 bus, for the responses to their SYNC_READ
+        class BusDevice : public RS485::Device {
+        public:
+            bool response(const RS485::Request& request, const uint8_t* response, int length) override;
+        };
+        static BusDevice bus_device;
 
-        
         float _homing_position;
 
+        uint32_t _last_goal;
+        bool     _has_goal = false;  // _last_goal was sent since the torque was last enabled
+
         float _dxl_count_min;
         float _dxl_count_max;
 
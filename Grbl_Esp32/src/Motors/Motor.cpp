@@ -55,7 +55,8 @@ namespace Motors {
     }
 
     void Motor::set_disable(bool disable) {}
-    void Motor::set_direction_pins(uint8_t onMask) {}
+    void Motor::set_disable(bool disable, PinBatch& batch) { set_disable(disable); }
+    void Motor::set_direction_pins(uint8_t onMask, PinBatch& batch) {}
     void Motor::step(uint8_t step_mask, uint8_t dir_mask) {}
     bool Motor::test() { return true; };  // true = OK
     void Motor::update() {}
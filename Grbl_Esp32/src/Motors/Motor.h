@@ -44,7 +44,8 @@ namespace Motors {
         virtual void read_settings();
         virtual void set_homing_mode(uint8_t homing_mask, bool isHoming);
         virtual void set_disable(bool disable);
-        virtual void set_direction_pins(uint8_t onMask);
+        virtual void set_disable(bool disable, PinBatch& batch);  // Pin writes go into the batch
+        virtual void set_direction_pins(uint8_t onMask, PinBatch& batch);
         virtual void step(uint8_t step_mask, uint8_t dir_mask);  // only used on Unipolar right now
         virtual bool test();
         virtual void set_axis_name();
@@ -45,10 +45,14 @@
 
 Motors::Motor*      myMotor[MAX_AXES][MAX_GANGED];  // number of axes (normal and ganged)
 static TaskHandle_t readSgTaskHandle      = 0;      // for realtime stallguard data diaplay
+static TaskHandle_t sgSampleTaskHandle    = 0;
 static TaskHandle_t servoUpdateTaskHandle = 0;
 
-bool    Motors::Dynamixel2::uart_ready         = false;
-uint8_t Motors::Dynamixel2::ids[MAX_N_AXIS][2] = { { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 } };
+static volatile bool cruise_wanted = false;  // Set by motors_set_cruise()
+
+bool                          Motors::Dynamixel2::uart_ready         = false;
+uint8_t                       Motors::Dynamixel2::ids[MAX_N_AXIS][2] = { { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 }, { 0, 0 } };
+Motors::Dynamixel2::BusDevice Motors::Dynamixel2::bus_device;
 
 uint8_t      rmt_chan_num[MAX_AXES][MAX_GANGED];
 rmt_item32_t rmtItem[2];
@@ -56,6 +60,15 @@ rmt_config_t rmtConfig;
 
 bool motor_class_steps;  // true if at least one motor class is handling steps
 
+// Motors that generate their own steps, so the step ISR only calls those
+static Motors::Motor* stepping_motors[MAX_AXES * MAX_GANGED];
+static uint8_t        n_stepping_motors = 0;
+
+int32_t servo_target_steps[MAX_N_AXIS];
+
+volatile uint8_t motors_stall_mask  = 0;
+volatile uint8_t motors_stall_armed = 0;
+
 void init_motors() {
     grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Init Motors");
 
@@ -290,10 +303,11 @@ void init_motors() {
     }
 
     // certain motors need features to be turned on. Check them here
+    n_stepping_motors = 0;
     for (uint8_t axis = X_AXIS; axis < n_axis; axis++) {
         for (uint8_t gang_index = 0; gang_index < 2; gang_index++) {
             if (myMotor[axis][gang_index]->type_id == UNIPOLAR_MOTOR) {
-                motor_class_steps = true;
+                stepping_motors[n_stepping_motors++] = myMotor[axis][gang_index];
             }
 
             // CS Pins of all TMC motors need to be setup before any can be talked to
@@ -305,17 +319,25 @@ void init_motors() {
     }
 
     // some motor objects require a step signal
-    motor_class_steps = motors_have_type_id(UNIPOLAR_MOTOR);
+    motor_class_steps = n_stepping_motors > 0;
 
     if (motors_have_type_id(TRINAMIC_SPI_MOTOR)) {
         grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "TMCStepper Library Ver. 0x%06x", TMCSTEPPER_VERSION);
         xTaskCreatePinnedToCore(readSgTask,    // task
                                 "readSgTask",  // name for task
-                                4096,          // size of task stack
-                                NULL,          // parameters
-                                1,             // priority
+                                STALLGUARD_DEBUG_TASK_STACK,
+                                NULL,  // parameters
+                                STALLGUARD_DEBUG_TASK_PRIORITY,
                                 &readSgTaskHandle,
-                                0  // core
+                                STALLGUARD_DEBUG_TASK_CORE  // core
+        );
+        xTaskCreatePinnedToCore(stallGuardSampleTask,    // task
+                                "stallGuardSampleTask",  // name for task
+                                STALLGUARD_SAMPLE_TASK_STACK,
+                                NULL,  // parameters
+                                STALLGUARD_SAMPLE_TASK_PRIORITY,
+                                &sgSampleTaskHandle,
+                                STALLGUARD_SAMPLE_TASK_CORE  // core
         );
         if (stallguard_debug_mask->get() != 0) {
             grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Stallguard debug enabled: %d", stallguard_debug_mask->get());
@@ -325,30 +347,53 @@ void init_motors() {
     if (motors_have_type_id(RC_SERVO_MOTOR) || motors_have_type_id(DYNAMIXEL2)) {
         xTaskCreatePinnedToCore(servoUpdateTask,    // task
                                 "servoUpdateTask",  // name for task
-                                4096,               // size of task stack
-                                NULL,               // parameters
-                                1,                  // priority
+                                SERVO_UPDATE_TASK_STACK,
+                                NULL,  // parameters
+                                SERVO_UPDATE_TASK_PRIORITY,
                                 &servoUpdateTaskHandle,
-                                0  // core
+                                SERVO_UPDATE_TASK_CORE  // core
         );
+        // RC servos also follow each segment that moves them. The Dynamixel bus keeps its interval.
+        uint8_t rc_servo_axes = 0;
+        for (uint8_t axis = X_AXIS; axis < n_axis; axis++) {
+            for (uint8_t gang_index = 0; gang_index < 2; gang_index++) {
+                if (myMotor[axis][gang_index]->type_id == RC_SERVO_MOTOR) {
+                    rc_servo_axes |= bit(axis);
+                }
+            }
+        }
+        st_set_segment_event(servoUpdateTaskHandle, rc_servo_axes);
     }
 }
 
+// Updates every servo each SERVO_TIMER_INTERVAL, and the RC servos also whenever the step ISR loads a
+// segment that moves them (see st_set_segment_event()), so a pen lift starts with its planned motion
+// instead of up to an interval later.
 void servoUpdateTask(void* pvParameters) {
-    TickType_t       xLastWakeTime;
     const TickType_t xUpdate = SERVO_TIMER_INTERVAL;  // in ticks (typically ms)
     auto             n_axis  = number_axis->get();
 
-    xLastWakeTime = xTaskGetTickCount();  // Initialise the xLastWakeTime variable with the current time.
-    vTaskDelay(2000);                     // initial delay
-    while (true) {                        // don't ever return from this or the task dies
+    vTaskDelay(2000);                              // initial delay
+    TickType_t next_update = xTaskGetTickCount();  // Time of the next update of every servo
+    while (true) {                                 // don't ever return from this or the task dies
+        bool all = int32_t(xTaskGetTickCount() - next_update) >= 0;
+        if (all) {
+            next_update += xUpdate;
+        }
+        servo_update_targets();
         for (uint8_t axis = X_AXIS; axis < n_axis; axis++) {
             for (uint8_t gang_index = 0; gang_index < 2; gang_index++) {
-                myMotor[axis][gang_index]->update();
+                if (all || myMotor[axis][gang_index]->type_id == RC_SERVO_MOTOR) {
+                    myMotor[axis][gang_index]->update();
+                }
             }
         }
 
-        vTaskDelayUntil(&xLastWakeTime, xUpdate);
+        TickType_t now  = xTaskGetTickCount();
+        TickType_t wait = int32_t(next_update - now) > 0 ? next_update - now : 0;
+        task_stats_block();
+        ulTaskNotifyTake(pdTRUE, wait);  // A segment event or the next update
+        task_stats_unblock();
     }
 }
 
@@ -365,6 +410,24 @@ bool motors_have_type_id(motor_class_id_t id) {
     return false;
 }
 
+// Called by the segment prep, which must not wait for SPI. The sampling task makes the change.
+void motors_set_cruise(bool cruising) {
+    cruise_wanted = cruising;
+    if (sgSampleTaskHandle) {
+        xTaskNotifyGive(sgSampleTaskHandle);
+    }
+}
+
+bool motors_have_idle_hold() {
+    return TRINAMIC_IDLE_HOLD_PERCENT < 100 && motors_have_type_id(TRINAMIC_SPI_MOTOR);
+}
+
+void motors_set_idle_hold(bool reduced) {
+    if (motors_have_idle_hold()) {
+        Motors::TrinamicDriver::set_idle_hold_all(reduced);
+    }
+}
+
 void motors_set_disable(bool disable) {
     static bool previous_state = true;
 
@@ -378,10 +441,11 @@ void motors_set_disable(bool disable) {
 */
 
     // now loop through all the motors to see if they can individually diable
-    auto n_axis = number_axis->get();
-    for (uint8_t gang_index = 0; gang_index < MAX_GANGED; gang_index++) {
-        for (uint8_t axis = X_AXIS; axis < n_axis; axis++) {
-            myMotor[axis][gang_index]->set_disable(disable);
+    // Second motors of axes that are not ganged are Nullmotors, skipped when no axis is ganged
+    PinBatch batch;
+    for (uint8_t gang_index = 0; gang_index < MachineTraits::n_gangs; gang_index++) {
+        for (uint8_t axis = X_AXIS; axis < MachineTraits::n_axis; axis++) {
+            myMotor[axis][gang_index]->set_disable(disable, batch);
         }
     }
 
@@ -389,7 +453,8 @@ void motors_set_disable(bool disable) {
     if (step_enable_invert->get()) {
         disable = !disable;  // Apply pin invert.
     }
-    digitalWrite(STEPPERS_DISABLE_PIN, disable);
+    batch.write(STEPPERS_DISABLE_PIN, disable);
+    batch.commit();  // All the expander pins at once
     
 }
 
@@ -414,6 +479,9 @@ void motors_set_homing_mode(uint8_t homing_mask, bool isHoming) {
             }
         }
     }
+    if (motors_have_type_id(TRINAMIC_SPI_MOTOR)) {
+        Motors::TrinamicDriver::flush_all();  // The thresholds of all daisy chained drivers at once
+    }
 }
 
 void motors_set_direction_pins(uint8_t onMask) {
@@ -425,12 +493,13 @@ void motors_set_direction_pins(uint8_t onMask) {
 
     //grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "motors_set_direction_pins:0x%02X", onMask);
 
-    auto n_axis = number_axis->get();
-    for (uint8_t gang_index = 0; gang_index < MAX_GANGED; gang_index++) {
-        for (uint8_t axis = X_AXIS; axis < n_axis; axis++) {
-            myMotor[axis][gang_index]->set_direction_pins(onMask);
+    PinBatch batch;
+    for (uint8_t gang_index = 0; gang_index < MachineTraits::n_gangs; gang_index++) {
+        for (uint8_t axis = X_AXIS; axis < MachineTraits::n_axis; axis++) {
+            myMotor[axis][gang_index]->set_direction_pins(onMask, batch);
         }
     }
+    batch.commit();
 }
 
 // returns the next spi index. We cannot preassign to axes because ganged (X2 type axes) might
@@ -445,14 +514,10 @@ uint8_t get_next_trinamic_driver_index() {
 }
 
 // some motor objects, like unipolar need step signals
+// Called by the step ISR only when motor_class_steps is set
 void motors_step(uint8_t step_mask, uint8_t dir_mask) {
-    if (motor_class_steps) {  // determined in init_motors if any motors need to handle steps
-        auto n_axis = number_axis->get();
-        for (uint8_t gang_index = 0; gang_index < 2; gang_index++) {
-            for (uint8_t axis = X_AXIS; axis < n_axis; axis++) {
-                myMotor[axis][gang_index]->step(step_mask, dir_mask);
-            }
-        }
+    for (uint8_t index = 0; index < n_stepping_motors; index++) {
+        stepping_motors[index]->step(step_mask, dir_mask);
     }
 }
 
@@ -473,6 +538,7 @@ void readSgTask(void* pvParameters) {
 
         if (stallguard_debug_mask->get() != 0) {
             if (sys.state == State::Cycle || sys.state == State::Homing || sys.state == State::Jog) {
+                Motors::TrinamicDriver::chain_read_status();  // one batch for all daisy chained drivers
                 for (uint8_t axis = X_AXIS; axis < n_axis; axis++) {
                     if (stallguard_debug_mask->get() & bit(axis)) {
                         //grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "SG:%d", stallguard_debug_mask->get());
@@ -483,7 +549,9 @@ void readSgTask(void* pvParameters) {
                 }
             }  // sys.state
         }      // if mask
+        task_stats_block();
         vTaskDelayUntil(&xLastWakeTime, xreadSg);
+        task_stats_unblock();
     }
 }
 
@@ -500,3 +568,85 @@ void TMC2130Stepper::switchCSpin(bool state) {
     i2s_out_delay();
 }
 #endif
+
+static void sg_sample_timer_cb(void* arg) {
+    xTaskNotifyGive(sgSampleTaskHandle);
+}
+
+/*
+	Samples StallGuard at TRINAMIC_SG_SAMPLE_US while the machine moves. The timer only runs then.
+	It also writes the cruise current motors_set_cruise() asks for, so all SPI traffic while moving
+	comes from this task and the segment prep never waits for it.
+*/
+void stallGuardSampleTask(void* pvParameters) {
+    const esp_timer_create_args_t timer_args = {
+        .callback        = sg_sample_timer_cb,
+        .arg             = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name            = "sg_sample",
+    };
+    esp_timer_handle_t timer;
+    bool               running  = false;
+    bool               cruising = false;  // Run current the drivers have
+
+    esp_timer_create(&timer_args, &timer);
+    while (true) {  // don't ever return from this or the task dies
+        if (cruise_wanted != cruising) {
+            cruising = cruise_wanted;
+            Motors::TrinamicDriver::set_cruise_all(cruising);
+        }
+        if (!(sys.state == State::Cycle || sys.state == State::Homing || sys.state == State::Jog)) {
+            if (running) {
+                esp_timer_stop(timer);
+                running = false;
+            }
+            task_stats_block();
+            vTaskDelay(10);
+            task_stats_unblock();
+            continue;
+        }
+        if (!running) {
+            esp_timer_start_periodic(timer, TRINAMIC_SG_SAMPLE_US);
+            running = true;
+        }
+        task_stats_block();
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        task_stats_unblock();
+        Motors::TrinamicDriver::sample_all();
+    }
+}
+
+void motors_report_stallguard(uint8_t client) {
+    auto n_axis = number_axis->get();
+    for (uint8_t axis = X_AXIS; axis < n_axis; axis++) {
+        if (bit_isfalse(stallguard_debug_mask->get(), bit(axis))) {
+            continue;
+        }
+        for (uint8_t gang_index = 0; gang_index < 2; gang_index++) {
+            if (myMotor[axis][gang_index]->type_id == TRINAMIC_SPI_MOTOR) {
+                static_cast<Motors::TrinamicDriver*>(myMotor[axis][gang_index])->report_samples(client);
+            }
+        }
+    }
+}
+
+void motors_reset_stallguard() {
+    auto n_axis = number_axis->get();
+    for (uint8_t axis = X_AXIS; axis < n_axis; axis++) {
+        for (uint8_t gang_index = 0; gang_index < 2; gang_index++) {
+            if (myMotor[axis][gang_index]->type_id == TRINAMIC_SPI_MOTOR) {
+                static_cast<Motors::TrinamicDriver*>(myMotor[axis][gang_index])->reset_samples();
+            }
+        }
+    }
+}
+
+void servo_update_targets() {
+    float   delta[MAX_N_AXIS];
+    int32_t position[MAX_N_AXIS];
+    st_get_lookahead(SERVO_LOOKAHEAD_MS * 1000, delta);
+    system_get_position(position);
+    for (uint8_t axis = 0; axis < MAX_N_AXIS; axis++) {
+        servo_target_steps[axis] = position[axis] + lround(delta[axis]);
+    }
+}
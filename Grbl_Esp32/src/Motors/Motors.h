@@ -55,9 +55,27 @@ void    readSgTask(void* pvParameters);
 void    motors_read_settings();
 void    motors_set_homing_mode(uint8_t homing_mask, bool isHoming);
 void    motors_set_disable(bool disable);
+void    motors_set_cruise(bool cruising);  // called by the segment prep when cruise starts and ends
+bool    motors_have_idle_hold();           // Trinamic drivers lower their hold current when idle
+void    motors_set_idle_hold(bool reduced);
 void    motors_set_direction_pins(uint8_t onMask);
 void    motors_step(uint8_t step_mask, uint8_t dir_mask);
 void    servoUpdateTask(void* pvParameters);
 bool    motor_can_home(uint8_t index);
 
+// Step positions SERVO_LOOKAHEAD_MS ahead of sys_position. Servo motors are commanded from these.
+extern int32_t servo_target_steps[MAX_N_AXIS];
+void           servo_update_targets();
+
 extern bool motor_class_steps;  // true if at least one motor class is handling steps
+
+// Axes whose Trinamic driver detected a stall in software during homing. Read as limit switches by
+// limits_get_state() and cleared at the start of each homing phase. Only the axes in
+// motors_stall_armed, set by homing while it approaches the switches, can trip.
+extern volatile uint8_t motors_stall_mask;
+extern volatile uint8_t motors_stall_armed;
+
+// StallGuard samples of the axes in $Report/StallGuard, for tuning.
+void motors_report_stallguard(uint8_t client);
+void motors_reset_stallguard();
+void stallGuardSampleTask(void* pvParameters);
@@ -94,6 +94,7 @@ namespace Motors {
         sys_position[_axis_index] =
             axis_settings[_axis_index]->home_mpos->get() * axis_settings[_axis_index]->steps_per_mm->get();  // convert to steps
 
+        servo_update_targets();
         set_location();  // force the PWM to update now
 
         vTaskDelay(750);  // give time to move
@@ -112,7 +113,7 @@ namespace Motors {
             return;
         }
 
-        mpos = system_convert_axis_steps_to_mpos(sys_position, _axis_index);  // get the axis machine position in mm
+        mpos = system_convert_axis_steps_to_mpos(servo_target_steps, _axis_index);  // get the axis machine position in mm
         // TBD working in MPos
         offset    = 0;  // gc_state.coord_system[axis_index] + gc_state.coord_offset[axis_index];  // get the current axis work offset
         servo_pos = mpos - offset;  // determine the current work position
@@ -52,7 +52,7 @@ namespace Motors {
 
 #ifdef USE_RMT_STEPS
         rmtConfig.rmt_mode                       = RMT_MODE_TX;
-        rmtConfig.clk_div                        = 20;
+        rmtConfig.clk_div                        = F_TIMERS / F_STEPPER_TIMER;  // Step timer ticks, so runs match the step ISR
         rmtConfig.mem_block_num                  = 2;
         rmtConfig.tx_config.loop_en              = false;
         rmtConfig.tx_config.carrier_en           = false;
@@ -61,13 +61,8 @@ namespace Motors {
         rmtConfig.tx_config.carrier_level        = RMT_CARRIER_LEVEL_LOW;
         rmtConfig.tx_config.idle_output_en       = true;
 
-#    ifdef STEP_PULSE_DELAY
-        rmtItem[0].duration0 = STEP_PULSE_DELAY * 4;
-#    else
-        rmtItem[0].duration0 = 1;
-#    endif
-
-        rmtItem[0].duration1 = 4 * pulse_microseconds->get();
+        rmtItem[0].duration0 = RMT_STEP_DELAY_TICKS;
+        rmtItem[0].duration1 = TICKS_PER_MICROSECOND * pulse_microseconds->get();
         rmtItem[1].duration0 = 0;
         rmtItem[1].duration1 = 0;
 
@@ -81,6 +76,8 @@ namespace Motors {
         rmt_config(&rmtConfig);
         rmt_fill_tx_items(rmtConfig.channel, &rmtItem[0], rmtConfig.mem_block_num, 0);
 
+#elif defined(USE_MCPWM_STEPS)
+        mcpwm_steps_attach(_axis_index, _dual_axis_index, step_pin, _invert_step_pin, TICKS_PER_MICROSECOND * pulse_microseconds->get());
 #else
         pinMode(step_pin, OUTPUT);
 
@@ -100,7 +97,13 @@ namespace Motors {
                        _position_max);
     }
 
-    void StandardStepper::set_direction_pins(uint8_t onMask) { digitalWrite(dir_pin, (onMask & bit(_axis_index))); }
+    void StandardStepper::set_direction_pins(uint8_t onMask, PinBatch& batch) { batch.write(dir_pin, (onMask & bit(_axis_index))); }
+
+    void StandardStepper::set_disable(bool disable) {
+        PinBatch batch;
+        set_disable(disable, batch);
+        batch.commit();
+    }
 
-    void StandardStepper::set_disable(bool disable) { digitalWrite(disable_pin, disable); }
+    void StandardStepper::set_disable(bool disable, PinBatch& batch) { batch.write(disable_pin, disable); }
 }
@@ -10,9 +10,10 @@ namespace Motors {
 
         virtual void config_message();
         virtual void init();
-        virtual void set_direction_pins(uint8_t onMask);
+        virtual void set_direction_pins(uint8_t onMask, PinBatch& batch);
         void         init_step_dir_pins();
         virtual void set_disable(bool disable);
+        virtual void set_disable(bool disable, PinBatch& batch);
         uint8_t      step_pin;
 
     protected:
@@ -22,6 +22,17 @@
 #include <TMCStepper.h>
 
 namespace Motors {
+    // Drivers on the daisy chain by chain position. Position 1 is wired to MOSI and the last one to MISO.
+    static TrinamicDriver* chain[MAX_AXES * MAX_GANGED + 1] = {};
+    static uint8_t         chain_cs_pin                     = UNDEFINED_PIN;
+    uint8_t                TrinamicDriver::chain_length     = 0;
+
+    // All drivers, chained or not
+    static TrinamicDriver* drivers[MAX_AXES * MAX_GANGED] = {};
+    static uint8_t         n_drivers                      = 0;
+
+    static bool idle_hold_reduced = false;  // By set_idle_hold_all()
+
     TrinamicDriver::TrinamicDriver(uint8_t  axis_index,
                                    uint8_t  step_pin,
                                    uint8_t  dir_pin,
@@ -56,6 +67,15 @@ namespace Motors {
             return;
         }
 
+        _sg_samples          = new sg_sample_t[TRINAMIC_SG_SAMPLES];
+        drivers[n_drivers++] = this;
+
+        if (spi_index > 0 && spi_index <= MAX_AXES * MAX_GANGED) {
+            chain[spi_index] = this;
+            chain_length     = MAX(chain_length, spi_index);
+            chain_cs_pin     = cs_pin;  // same pin for all drivers on the chain
+        }
+
         init_step_dir_pins();  // from StandardStepper
 
         digitalWrite(cs_pin, HIGH);
@@ -79,9 +99,12 @@ namespace Motors {
         SPI.begin();  // this will get called for each motor, but does not seem to hurt anything
 
         tmcstepper->begin();
+        _shadow_valid = 0;  // begin() wrote the defaults
+        _pending      = 0;
         test();           // Try communicating with motor. Prints an error if there is a problem.
         read_settings();  // pull info from settings
         set_mode(false);
+        flush_all();
 
         _homing_mask = 0;
         is_active    = true;
@@ -175,8 +198,93 @@ namespace Motors {
         }
         //grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "%s Current run %d hold %f", _axis_name, run_i_ma, hold_i_percent);
 
-        tmcstepper->microsteps(axis_settings[_axis_index]->microsteps->get());
-        tmcstepper->rms_current(run_i_ma, hold_i_percent);
+        uint16_t microsteps = axis_settings[_axis_index]->microsteps->get();
+        if (shadow_changed(Shadow::Microsteps, microsteps)) {
+            tmcstepper->microsteps(microsteps);
+        }
+        if (shadow_changed(Shadow::RunCurrent, run_i_ma | (uint32_t(hold_i_percent * 1000.0f) << 16))) {
+            tmcstepper->rms_current(run_i_ma, hold_i_percent);
+            _irun  = tmcstepper->irun();
+            _ihold = tmcstepper->ihold();
+        }
+    }
+
+    // Records value for reg and returns true if the driver does not have it yet.
+    bool TrinamicDriver::shadow_changed(Shadow reg, uint32_t value) {
+        uint16_t mask = bit(int(reg));
+        if ((_shadow_valid & mask) && _shadow[int(reg)] == value) {
+            return false;
+        }
+        _shadow[int(reg)] = value;
+        _shadow_valid |= mask;
+        return true;
+    }
+
+    // Chained drivers leave the velocity thresholds to flush_all(), which writes them to the whole chain
+    // at once. TMCStepper's copies of these write only registers are then out of date, but nothing reads them.
+    void TrinamicDriver::set_threshold(Shadow reg, uint32_t value) {
+        if (!shadow_changed(reg, value)) {
+            return;
+        }
+        if (spi_index > 0) {
+            _pending |= bit(int(reg));
+        } else {
+            write_threshold(reg);
+        }
+    }
+
+    void TrinamicDriver::write_threshold(Shadow reg) {
+        uint32_t value = _shadow[int(reg)];
+        switch (reg) {
+            case Shadow::TPWMTHRS:
+                tmcstepper->TPWMTHRS(value);
+                break;
+            case Shadow::TCOOLTHRS:
+                tmcstepper->TCOOLTHRS(value);
+                break;
+            case Shadow::THIGH:
+                tmcstepper->THIGH(value);
+                break;
+            default:
+                break;
+        }
+        _pending &= ~bit(int(reg));
+    }
+
+    void TrinamicDriver::flush_all() {
+        static const uint8_t addresses[SHADOW_THRESHOLDS] = { TRINAMIC_REG_TPWMTHRS, TRINAMIC_REG_TCOOLTHRS, TRINAMIC_REG_THIGH };
+
+        for (uint8_t reg = 0; reg < SHADOW_THRESHOLDS; reg++) {
+            uint32_t values[MAX_AXES * MAX_GANGED + 1] = {};
+            bool     pending                           = false;
+            bool     complete                          = true;  // Every chain position has a known value
+            for (uint8_t index = 1; index <= chain_length; index++) {
+                TrinamicDriver* driver = chain[index];
+                if (driver == nullptr || driver->has_errors || !(driver->_shadow_valid & bit(reg))) {
+                    complete = false;
+                    continue;
+                }
+                values[index] = driver->_shadow[reg];
+                pending |= (driver->_pending & bit(reg)) != 0;
+            }
+            if (!pending) {
+                continue;
+            }
+            if (complete) {
+                chain_write(addresses[reg], values);
+                for (uint8_t index = 1; index <= chain_length; index++) {
+                    chain[index]->_pending &= ~bit(reg);
+                }
+            } else {
+                // A position whose value is unknown would be overwritten, so each driver writes its own
+                for (uint8_t index = 1; index <= chain_length; index++) {
+                    TrinamicDriver* driver = chain[index];
+                    if (driver != nullptr && (driver->_pending & bit(reg))) {
+                        driver->write_threshold(Shadow(reg));
+                    }
+                }
+            }
+        }
     }
 
     void TrinamicDriver::set_homing_mode(uint8_t homing_mask, bool isHoming) {
@@ -207,32 +315,48 @@ namespace Motors {
         switch (_mode) {
             case TrinamicMode ::StealthChop:
                 //grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "StealthChop");
-                tmcstepper->en_pwm_mode(true);
-                tmcstepper->pwm_autoscale(true);
-                tmcstepper->diag1_stall(false);
+                set_pwm_mode(true);
+                if (shadow_changed(Shadow::Diag1Stall, false)) {
+                    tmcstepper->diag1_stall(false);
+                }
+                set_threshold(Shadow::TPWMTHRS, (TRINAMIC_HYBRID_THRESHOLD > 0) ? calc_tstep(TRINAMIC_HYBRID_THRESHOLD, 100.0) : 0);
                 break;
             case TrinamicMode :: CoolStep:
                 //grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Coolstep");
-                tmcstepper->en_pwm_mode(false);
-                tmcstepper->pwm_autoscale(false);
-                tmcstepper->TCOOLTHRS(NORMAL_TCOOLTHRS);  // when to turn on coolstep
-                tmcstepper->THIGH(NORMAL_THIGH);
+                set_pwm_mode(false);
+                set_threshold(Shadow::TCOOLTHRS, NORMAL_TCOOLTHRS);  // when to turn on coolstep
+                set_threshold(Shadow::THIGH, NORMAL_THIGH);
                 break;
             case TrinamicMode ::StallGuard:
                 //grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Stallguard");
-                tmcstepper->en_pwm_mode(false);
-                tmcstepper->pwm_autoscale(false);
-                tmcstepper->TCOOLTHRS(calc_tstep(homing_feed_rate->get(), 150.0));
-                tmcstepper->THIGH(calc_tstep(homing_feed_rate->get(), 60.0));
-                tmcstepper->sfilt(1);
-                tmcstepper->diag1_stall(true);  // stallguard i/o is on diag1
-                tmcstepper->sgt(axis_settings[_axis_index]->stallguard->get());
+                set_pwm_mode(false);
+                set_threshold(Shadow::TCOOLTHRS, calc_tstep(homing_feed_rate->get(), 150.0));
+                set_threshold(Shadow::THIGH, calc_tstep(homing_feed_rate->get(), 60.0));
+                if (shadow_changed(Shadow::Sfilt, 1)) {
+                    tmcstepper->sfilt(1);
+                }
+                if (shadow_changed(Shadow::Diag1Stall, true)) {
+                    tmcstepper->diag1_stall(true);  // stallguard i/o is on diag1
+                }
+                if (shadow_changed(Shadow::Sgt, axis_settings[_axis_index]->stallguard->get())) {
+                    tmcstepper->sgt(axis_settings[_axis_index]->stallguard->get());
+                }
                 break;
             default:
                 grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "TRINAMIC_MODE_UNDEFINED");
         }
     }
 
+    // StealthChop, with PWM autoscaling, or not
+    void TrinamicDriver::set_pwm_mode(bool enable) {
+        if (shadow_changed(Shadow::EnPwmMode, enable)) {
+            tmcstepper->en_pwm_mode(enable);
+        }
+        if (shadow_changed(Shadow::PwmAutoscale, enable)) {
+            tmcstepper->pwm_autoscale(enable);
+        }
+    }
+
     /*
     This is the stallguard tuning info. It is call debug, so it could be generic across all classes.
 */
@@ -240,23 +364,96 @@ namespace Motors {
         if (has_errors) {
             return;
         }
-        uint32_t tstep = tmcstepper->TSTEP();
+        // Chained drivers were read all at once by chain_read_status()
+        uint32_t tstep = (spi_index > 0) ? _chain_tstep : tmcstepper->TSTEP();
 
         if (tstep == 0xFFFFF || tstep < 1) {  // if axis is not moving return
             return;
         }
         float feedrate = st_get_realtime_rate();  //* settings.microsteps[axis_index] / 60.0 ; // convert mm/min to Hz
 
+        TMC2130_n ::DRV_STATUS_t status { 0 };
+        status.sr = (spi_index > 0) ? _chain_drv_status : tmcstepper->DRV_STATUS();
+
         grbl_msg_sendf(CLIENT_SERIAL,
                        MsgLevel::Info,
                        "%s Stallguard %d   SG_Val: %04d   Rate: %05.0f mm/min SG_Setting:%d",
                        _axis_name,
-                       tmcstepper->stallguard(),
-                       tmcstepper->sg_result(),
+                       status.stallGuard,
+                       status.sg_result,
                        feedrate,
                        axis_settings[_axis_index]->stallguard->get());
     }
 
+    /*
+    Daisy chain transfers
+
+    TMC drivers answer a read with the data of the previous transfer, so a read shifts the request
+    out to every driver and then shifts the replies back. The frame for the last driver on the chain
+    goes out first and its reply comes back first.
+*/
+    void TrinamicDriver::chain_select(bool select) {
+        digitalWrite(chain_cs_pin, select ? LOW : HIGH);
+#ifdef USE_I2S_OUT
+        i2s_out_delay();
+#endif
+    }
+
+    void TrinamicDriver::chain_shift(uint8_t address, const uint32_t* out, uint32_t* in) {
+        uint32_t speed = (chain_cs_pin >= I2S_OUT_PIN_BASE) ? TRINAMIC_SPI_FREQ : TRINAMIC_SPI_FREQ_FAST;
+
+        SPI.beginTransaction(SPISettings(speed, MSBFIRST, SPI_MODE3));
+        chain_select(true);
+        for (uint8_t index = chain_length; index >= 1; index--) {
+            uint32_t data  = (out != nullptr) ? out[index] : 0;
+            uint32_t reply = 0;
+            SPI.transfer(address);  // SPI status byte comes back
+            for (int8_t shift = 24; shift >= 0; shift -= 8) {
+                reply |= uint32_t(SPI.transfer((data >> shift) & 0xFF)) << shift;
+            }
+            if (in != nullptr) {
+                in[index] = reply;
+            }
+        }
+        chain_select(false);
+        SPI.endTransaction();
+    }
+
+    void TrinamicDriver::chain_read(uint8_t address, uint32_t* values) {
+        if (chain_length == 0) {
+            return;
+        }
+        chain_shift(address, nullptr, nullptr);
+        chain_shift(address, nullptr, values);
+    }
+
+    void TrinamicDriver::chain_write(uint8_t address, const uint32_t* values) {
+        if (chain_length == 0) {
+            return;
+        }
+        chain_shift(address | TRINAMIC_WRITE, values, nullptr);
+    }
+
+    void TrinamicDriver::chain_read_status() {
+        uint32_t drv_status[MAX_AXES * MAX_GANGED + 1];
+        uint32_t tstep[MAX_AXES * MAX_GANGED + 1];
+
+        if (chain_length == 0) {
+            return;
+        }
+        // The second shift of each read sends the next request, so these take three shifts, not four
+        chain_shift(TRINAMIC_REG_DRV_STATUS, nullptr, nullptr);
+        chain_shift(TRINAMIC_REG_TSTEP, nullptr, drv_status);
+        chain_shift(TRINAMIC_REG_TSTEP, nullptr, tstep);
+
+        for (uint8_t index = 1; index <= chain_length; index++) {
+            if (chain[index] != nullptr) {
+                chain[index]->_chain_drv_status = drv_status[index];
+                chain[index]->_chain_tstep      = tstep[index];
+            }
+        }
+    }
+
     // calculate a tstep from a rate
     // tstep = TRINAMIC_FCLK / (time between 1/256 steps)
     // This is used to set the stallguard window from the homing speed.
@@ -272,6 +469,12 @@ namespace Motors {
     // this can use the enable feature over SPI. The dedicated pin must be in the enable mode,
     // but that can be hardwired that way.
     void TrinamicDriver::set_disable(bool disable) {
+        PinBatch batch;
+        set_disable(disable, batch);
+        batch.commit();
+    }
+
+    void TrinamicDriver::set_disable(bool disable, PinBatch& batch) {
         if (has_errors)
             return;
 
@@ -280,7 +483,7 @@ namespace Motors {
 
         _disabled = disable;
 
-        digitalWrite(disable_pin, _disabled);
+        batch.write(disable_pin, _disabled);
 
 #ifdef USE_TRINAMIC_ENABLE
         if (_disabled) {
@@ -296,4 +499,123 @@ namespace Motors {
         // the pin based enable could be added here.
         // This would be for individual motors, not the single pin for all motors.
     }
+
+    /*
+    Cruise current
+
+    IHOLD_IRUN is write only. TMCStepper keeps a copy, which chained drivers leave at the full current
+    so it can be restored. Other drivers go through the library.
+*/
+    void TrinamicDriver::set_cruise_all(bool cruising) {
+        uint32_t values[MAX_AXES * MAX_GANGED + 1] = {};
+
+        if (TRINAMIC_CRUISE_CURRENT_PERCENT >= 100) {
+            return;
+        }
+        for (uint8_t index = 0; index < n_drivers; index++) {
+            TrinamicDriver* driver = drivers[index];
+            if (!driver->is_active || driver->has_errors) {
+                continue;
+            }
+            uint8_t irun = driver->_irun;
+            if (cruising) {
+                irun = MAX(irun * TRINAMIC_CRUISE_CURRENT_PERCENT / 100, 1);
+            }
+            if (driver->spi_index > 0) {
+                TMC2130Stepper* tmc       = driver->tmcstepper;
+                values[driver->spi_index] = tmc->ihold() | (uint32_t(irun) << 8) | (uint32_t(tmc->iholddelay()) << 16);
+            } else {
+                driver->tmcstepper->irun(irun);
+            }
+        }
+        chain_write(TRINAMIC_REG_IHOLD_IRUN, values);
+    }
+
+    // Only called while the machine stands still, when the run current is the full one.
+    void TrinamicDriver::set_idle_hold_all(bool reduced) {
+        uint32_t values[MAX_AXES * MAX_GANGED + 1] = {};
+
+        if (TRINAMIC_IDLE_HOLD_PERCENT >= 100 || idle_hold_reduced == reduced) {
+            return;
+        }
+        idle_hold_reduced = reduced;
+        for (uint8_t index = 0; index < n_drivers; index++) {
+            TrinamicDriver* driver = drivers[index];
+            if (!driver->is_active || driver->has_errors) {
+                continue;
+            }
+            uint8_t ihold = driver->_ihold;
+            if (reduced) {
+                ihold = ihold * TRINAMIC_IDLE_HOLD_PERCENT / 100;
+            }
+            if (driver->spi_index > 0) {
+                TMC2130Stepper* tmc       = driver->tmcstepper;
+                values[driver->spi_index] = ihold | (uint32_t(driver->_irun) << 8) | (uint32_t(tmc->iholddelay()) << 16);
+            } else {
+                driver->tmcstepper->ihold(ihold);
+            }
+        }
+        chain_write(TRINAMIC_REG_IHOLD_IRUN, values);
+    }
+
+    /*
+    StallGuard sampling
+*/
+    void TrinamicDriver::sample_all() {
+        uint32_t values[MAX_AXES * MAX_GANGED + 1];
+        uint32_t time_ms = esp_timer_get_time() / 1000;
+        float    rate    = st_get_realtime_rate();
+
+        chain_read(TRINAMIC_REG_DRV_STATUS, values);
+        for (uint8_t index = 0; index < n_drivers; index++) {
+            TrinamicDriver* driver = drivers[index];
+            if (!driver->is_active || driver->has_errors) {
+                continue;
+            }
+            if (driver->spi_index > 0) {
+                driver->sample(values[driver->spi_index], time_ms, rate);
+            } else {
+                driver->sample(driver->tmcstepper->DRV_STATUS(), time_ms, rate);
+            }
+        }
+    }
+
+    void TrinamicDriver::sample(uint32_t drv_status, uint32_t time_ms, float rate) {
+        TMC2130_n ::DRV_STATUS_t status { 0 };
+        status.sr = drv_status;
+
+        sg_sample_t* sample = &_sg_samples[_sg_head];
+        sample->time_ms     = time_ms;
+        sample->sg_result   = status.sg_result;
+        sample->rate        = MIN(rate, float(UINT16_MAX));
+        _sg_head            = (_sg_head + 1) % TRINAMIC_SG_SAMPLES;
+        _sg_count           = MIN(_sg_count + 1, TRINAMIC_SG_SAMPLES);
+
+        if (TRINAMIC_SG_STALL_LEVEL < 0 || _mode != TrinamicMode::StallGuard || bit_isfalse(motors_stall_armed, bit(_axis_index))) {
+            _sg_low = 0;
+            return;
+        }
+        if (rate < homing_feed_rate->get() * TRINAMIC_SG_MIN_RATE_PERCENT / 100.0 || status.sg_result > TRINAMIC_SG_STALL_LEVEL) {
+            _sg_low = 0;
+            return;
+        }
+        if (++_sg_low >= TRINAMIC_SG_STALL_SAMPLES) {
+            motors_stall_mask |= bit(_axis_index);  // homing sees this like a limit switch
+        }
+    }
+
+    // One line per sample, oldest first: [SG:<axis>,<ms>,<SG_RESULT>,<mm/min>]
+    void TrinamicDriver::report_samples(uint8_t client) {
+        uint16_t index = (_sg_head + TRINAMIC_SG_SAMPLES - _sg_count) % TRINAMIC_SG_SAMPLES;
+        for (uint16_t n = 0; n < _sg_count; n++) {
+            sg_sample_t* sample = &_sg_samples[index];
+            grbl_sendf(client, "[SG:%s,%u,%u,%u]\r\n", _axis_name, sample->time_ms, sample->sg_result, sample->rate);
+            index = (index + 1) % TRINAMIC_SG_SAMPLES;
+        }
+    }
+
+    void TrinamicDriver::reset_samples() {
+        _sg_head  = 0;
+        _sg_count = 0;
+    }
 }
@@ -34,7 +34,17 @@ const float TMC5160_RSENSE_DEFAULT = 0.075f;
 const int NORMAL_TCOOLTHRS = 0xFFFFF;  // 20 bit is max
 const int NORMAL_THIGH     = 0;
 
-const int TRINAMIC_SPI_FREQ = 100000;
+const int TRINAMIC_SPI_FREQ      = 100000;
+const int TRINAMIC_SPI_FREQ_FAST = 2000000;  // TMCStepper default, used when CS is not on I2S
+
+// register addresses used for whole chain transfers
+const uint8_t TRINAMIC_REG_IHOLD_IRUN = 0x10;
+const uint8_t TRINAMIC_REG_TSTEP      = 0x12;
+const uint8_t TRINAMIC_REG_TPWMTHRS   = 0x13;
+const uint8_t TRINAMIC_REG_TCOOLTHRS  = 0x14;
+const uint8_t TRINAMIC_REG_THIGH      = 0x15;
+const uint8_t TRINAMIC_REG_DRV_STATUS = 0x6F;
+const uint8_t TRINAMIC_WRITE          = 0x80;
 
 const double TRINAMIC_FCLK = 12700000.0;  // Internal clock Approx (Hz) used to calculate TSTEP from homing rate
 
@@ -60,6 +70,54 @@ const double TRINAMIC_FCLK = 12700000.0;  // Internal clock Approx (Hz) used to
 #    define TRINAMIC_TOFF_COOLSTEP 3
 #endif
 
+// In StealthChop run mode the driver changes to SpreadCycle by itself above this feed rate (mm/min),
+// through TPWMTHRS. StealthChop loses torque at speed. 0 keeps StealthChop at all speeds.
+#ifndef TRINAMIC_HYBRID_THRESHOLD
+#    define TRINAMIC_HYBRID_THRESHOLD 0
+#endif
+
+// Run current while cruising at constant speed, in percent of $<axis>/Current/Run. Full current is
+// restored before each acceleration or deceleration is executed. 100 disables the reduction.
+#ifndef TRINAMIC_CRUISE_CURRENT_PERCENT
+#    define TRINAMIC_CRUISE_CURRENT_PERCENT 100
+#endif
+
+// Hold current once the machine has stood still for TRINAMIC_IDLE_HOLD_MS, in percent of
+// $<axis>/Current/Hold, until the next motion or until $1 disables the drivers. This cuts the heat
+// of motors locked by $1=255. 100 disables the reduction.
+#ifndef TRINAMIC_IDLE_HOLD_PERCENT
+#    define TRINAMIC_IDLE_HOLD_PERCENT 100
+#endif
+#ifndef TRINAMIC_IDLE_HOLD_MS
+#    define TRINAMIC_IDLE_HOLD_MS 1000
+#endif
+
+// StallGuard sampling while the machine moves. Each driver keeps the last TRINAMIC_SG_SAMPLES
+// readings of SG_RESULT with the feed rate at the time, reported by $StallGuard/Samples.
+#ifndef TRINAMIC_SG_SAMPLE_US
+#    define TRINAMIC_SG_SAMPLE_US 1000  // 1 kHz. Daisy chains read all drivers at once and can go to 200us
+#endif
+
+#ifndef TRINAMIC_SG_SAMPLES
+#    define TRINAMIC_SG_SAMPLES 128
+#endif
+
+// Software stall detection on top of the DIAG pin. In StallGuard homing mode an axis is treated as
+// having hit its limit when SG_RESULT stays at or below this level for TRINAMIC_SG_STALL_SAMPLES
+// samples while the axis moves at no less than TRINAMIC_SG_MIN_RATE_PERCENT of the homing feed rate.
+// StallGuard readings are meaningless at low speed. -1 disables the detector.
+#ifndef TRINAMIC_SG_STALL_LEVEL
+#    define TRINAMIC_SG_STALL_LEVEL -1
+#endif
+
+#ifndef TRINAMIC_SG_STALL_SAMPLES
+#    define TRINAMIC_SG_STALL_SAMPLES 3
+#endif
+
+#ifndef TRINAMIC_SG_MIN_RATE_PERCENT
+#    define TRINAMIC_SG_MIN_RATE_PERCENT 50
+#endif
+
 namespace Motors {
 
     enum class TrinamicMode : uint8_t {
@@ -89,11 +147,83 @@ namespace Motors {
         void debug_message();
         void set_homing_mode(uint8_t homing_mask, bool ishoming);
         void set_disable(bool disable);
+        void set_disable(bool disable, PinBatch& batch);
         bool test();
 
+        // Daisy chain transfers. values[] is indexed by chain position (spi_index), 1 to chain_length.
+        // A read takes two chain shifts and a write one, however many drivers are on the chain.
+        static uint8_t chain_length;
+        static void    chain_read(uint8_t address, uint32_t* values);
+        static void    chain_write(uint8_t address, const uint32_t* values);
+        static void    chain_read_status();  // DRV_STATUS and TSTEP of all chained drivers for debug_message()
+
+        // Writes the velocity thresholds set_mode() left pending on chained drivers, one chain write per
+        // register for all of them. Called after the mode of every driver has been set.
+        static void flush_all();
+
+        // Lowers the run current to TRINAMIC_CRUISE_CURRENT_PERCENT or restores it. Daisy chained
+        // drivers get it in one chain write.
+        static void set_cruise_all(bool cruising);
+
+        // Lowers the hold current to TRINAMIC_IDLE_HOLD_PERCENT or restores it, the same way.
+        static void set_idle_hold_all(bool reduced);
+
+        // Reads SG_RESULT from every driver into its sample ring. Called by the sampling task.
+        static void sample_all();
+        void        report_samples(uint8_t client);
+        void        reset_samples();
+
     private:
         uint32_t calc_tstep(float speed, float percent);
 
+        // Registers and fields the driver sets, with the value last written to each, so that settings
+        // changes and mode switches only send those that change. Cleared by init(), since begin()
+        // writes the library defaults.
+        enum class Shadow : uint8_t {
+            TPWMTHRS = 0,  // The three velocity thresholds come first, as whole registers
+            TCOOLTHRS,
+            THIGH,
+            EnPwmMode,
+            PwmAutoscale,
+            Diag1Stall,
+            Sfilt,
+            Sgt,
+            Microsteps,
+            RunCurrent,  // mA and hold percent, packed
+            Count,
+        };
+        static const uint8_t SHADOW_THRESHOLDS = 3;
+
+        uint32_t _shadow[int(Shadow::Count)];
+        uint16_t _shadow_valid   = 0;  // Bit per Shadow entry
+        uint8_t  _pending        = 0;  // Thresholds set but not yet written, bit per Shadow entry
+        bool     shadow_changed(Shadow reg, uint32_t value);
+        void     set_threshold(Shadow reg, uint32_t value);
+        void     write_threshold(Shadow reg);
+        void     set_pwm_mode(bool enable);
+
+        static void chain_shift(uint8_t address, const uint32_t* out, uint32_t* in);
+        static void chain_select(bool select);
+
+        uint32_t _chain_drv_status = 0;  // last values from chain_read_status()
+        uint32_t _chain_tstep      = 0;
+
+        typedef struct {
+            uint32_t time_ms;
+            uint16_t sg_result;
+            uint16_t rate;  // mm/min
+        } sg_sample_t;
+
+        void sample(uint32_t drv_status, uint32_t time_ms, float rate);
+
+        sg_sample_t* _sg_samples = nullptr;
+        uint16_t     _sg_head    = 0;  // next slot to write
+        uint16_t     _sg_count   = 0;
+        uint8_t      _sg_low     = 0;  // consecutive samples at or below TRINAMIC_SG_STALL_LEVEL
+
+        uint8_t _irun  = 0;  // IRUN for the full run current, from read_settings()
+        uint8_t _ihold = 0;  // IHOLD for the full hold current
+
         TMC2130Stepper* tmcstepper;  // all other driver types are subclasses of this one
         TrinamicMode    _homing_mode;
         uint8_t         cs_pin = UNDEFINED_PIN;  // The chip select pin (can be the same for daisy chain)
@@ -1,6 +1,57 @@
 #include "UnipolarMotor.h"
 
+#include <soc/gpio_struct.h>
+#include <soc/ledc_struct.h>
+
 namespace Motors {
+    /*
+        Coil patterns, bit n drives phase pin n.
+
+        8 Step : A – AB – B – BC – C – CD – D – DA
+        4 Step : AB – BC – CD – DA
+
+        Step		IN4	IN3	IN2	IN1
+        A 		0 	0 	0 	1
+        AB		0	0	1	1
+        B		0	0	1	0
+        BC		0	1	1	0
+        C		0	1	0	0
+        CD		1	1	0	0
+        D		1	0	0	0
+        DA		1	0	0	1
+    */
+    static const uint8_t half_step_coils[8] = { 0x1, 0x3, 0x2, 0x6, 0x4, 0xC, 0x8, 0x9 };
+    static const uint8_t full_step_coils[4] = { 0x3, 0x6, 0xC, 0x9 };
+
+    // Microstep duties. Coils A and C carry the cosine of the electrical angle and B and D the sine,
+    // which passes through the half step sequence above every 45 degrees.
+    static uint16_t microstep_duty[4 * UNIPOLAR_MICROSTEPS][4];
+
+    // Same register sequence as ledcWrite(), but without its mutex, which cannot be taken in the step
+    // ISR. A zero duty disables the output, which then stays at its idle level, low.
+    static void IRAM_ATTR ledc_write_isr(uint8_t chan_num, uint32_t duty) {
+        uint8_t group   = chan_num / 8;
+        auto&   channel = LEDC.channel_group[group].channel[chan_num % 8];
+        channel.duty.duty = duty << 4;  // 25 bit (21.4)
+        if (duty) {
+            channel.conf0.sig_out_en = 1;
+            channel.conf1.duty_start = 1;
+            if (group) {
+                channel.conf0.val |= BIT(4);  // low_speed_update
+            } else {
+                channel.conf0.clk_en = 1;
+            }
+        } else {
+            channel.conf0.sig_out_en = 0;
+            channel.conf1.duty_start = 0;
+            if (group) {
+                channel.conf0.val &= ~BIT(4);
+            } else {
+                channel.conf0.clk_en = 0;
+            }
+        }
+    }
+
     UnipolarMotor::UnipolarMotor() {}
 
     UnipolarMotor::UnipolarMotor(uint8_t axis_index, uint8_t pin_phase0, uint8_t pin_phase1, uint8_t pin_phase2, uint8_t pin_phase3) {
@@ -12,138 +63,118 @@ namespace Motors {
         _pin_phase2            = pin_phase2;
         _pin_phase3            = pin_phase3;
 
-        _half_step = true;  // TODO read from settings ... microstep > 1 = half step
-
         set_axis_name();
         init();
         config_message();
     }
 
     void UnipolarMotor::init() {
-        pinMode(_pin_phase0, OUTPUT);
-        pinMode(_pin_phase1, OUTPUT);
-        pinMode(_pin_phase2, OUTPUT);
-        pinMode(_pin_phase3, OUTPUT);
-        _current_phase = 0;
+        uint8_t pins[4] = { _pin_phase0, _pin_phase1, _pin_phase2, _pin_phase3 };
+        _current_phase  = 0;
+
+        if (UNIPOLAR_MICROSTEPS >= 4) {
+            const uint16_t full = 1 << UNIPOLAR_PWM_RES_BITS;
+            for (uint8_t phase = 0; phase < phase_count; phase++) {
+                float angle              = 2.0 * M_PI * phase / phase_count;
+                float a                  = cos(angle) * full;
+                float b                  = sin(angle) * full;
+                microstep_duty[phase][0] = (a > 0) ? lround(a) : 0;
+                microstep_duty[phase][1] = (b > 0) ? lround(b) : 0;
+                microstep_duty[phase][2] = (a < 0) ? lround(-a) : 0;
+                microstep_duty[phase][3] = (b < 0) ? lround(-b) : 0;
+            }
+            for (uint8_t coil = 0; coil < 4; coil++) {
+                _channel[coil] = sys_get_next_PWM_chan_num();
+                ledcSetup(_channel[coil], UNIPOLAR_PWM_FREQ, UNIPOLAR_PWM_RES_BITS);
+                ledcAttachPin(pins[coil], _channel[coil]);
+                ledcWrite(_channel[coil], 0);
+            }
+            return;
+        }
+
+        _direct = true;
+        for (uint8_t coil = 0; coil < 4; coil++) {
+            pinMode(pins[coil], OUTPUT);
+            if (pins[coil] >= I2S_OUT_PIN_BASE) {
+                _direct = false;  // digitalWrite() knows how to reach the I2S expander
+            }
+        }
+        for (uint8_t phase = 0; phase < phase_count; phase++) {
+            uint8_t coils         = (phase_count == 8) ? half_step_coils[phase] : full_step_coils[phase];
+            _set_mask[0][phase]   = _set_mask[1][phase] = 0;
+            _clear_mask[0][phase] = _clear_mask[1][phase] = 0;
+            for (uint8_t coil = 0; coil < 4 && _direct; coil++) {
+                uint8_t   bank = pins[coil] / 32;
+                uint32_t  mask = bit(pins[coil] % 32);
+                uint32_t* out  = (coils & bit(coil)) ? _set_mask[bank] : _clear_mask[bank];
+                out[phase] |= mask;
+            }
+        }
     }
 
     void UnipolarMotor::config_message() {
         grbl_msg_sendf(CLIENT_SERIAL,
                        MsgLevel::Info,
-                       "%s Axis Unipolar Stepper Ph0:%s Ph1:%s Ph2:%s Ph3:%s Limits(%0.3f,%0.3f)",
+                       "%s Axis Unipolar Stepper Ph0:%s Ph1:%s Ph2:%s Ph3:%s Microsteps:%d Limits(%0.3f,%0.3f)",
                        _axis_name,
                        pinName(_pin_phase0).c_str(),
                        pinName(_pin_phase1).c_str(),
                        pinName(_pin_phase2).c_str(),
                        pinName(_pin_phase3).c_str(),
+                       UNIPOLAR_MICROSTEPS,
                        _position_min,
                        _position_max);
     }
 
     void UnipolarMotor::set_disable(bool disable) {
         if (disable) {
-            digitalWrite(_pin_phase0, 0);
-            digitalWrite(_pin_phase1, 0);
-            digitalWrite(_pin_phase2, 0);
-            digitalWrite(_pin_phase3, 0);
+            if (UNIPOLAR_MICROSTEPS >= 4) {
+                for (uint8_t coil = 0; coil < 4; coil++) {
+                    ledcWrite(_channel[coil], 0);
+                }
+            } else {
+                write_coils(0);
+            }
         }
         _enabled = !disable;
     }
 
     void UnipolarMotor::step(uint8_t step_mask, uint8_t dir_mask) {
-        uint8_t _phase[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };  // temporary phase values...all start as off
-        uint8_t phase_max;
-
         if (!(step_mask & bit(_axis_index)))
             return;  // a step is not required on this interrupt
 
         if (!_enabled)
             return;  // don't do anything, phase is not changed or lost
 
-        if (_half_step)
-            phase_max = 7;
-        else
-            phase_max = 3;
-
         if (dir_mask & bit(_axis_index)) {  // count up
-            if (_current_phase == phase_max)
-                _current_phase = 0;
-            else
-                _current_phase++;
+            _current_phase = (_current_phase == phase_count - 1) ? 0 : _current_phase + 1;
         } else {  // count down
-            if (_current_phase == 0)
-                _current_phase = phase_max;
-            else
-                _current_phase--;
+            _current_phase = (_current_phase == 0) ? phase_count - 1 : _current_phase - 1;
         }
-        /*
-			8 Step : A – AB – B – BC – C – CD – D – DA
-			4 Step : AB – BC – CD – DA
-
-			Step		IN4	IN3	IN2	IN1
-			A 		0 	0 	0 	1
-			AB		0	0	1	1
-			B		0	0	1	0
-			BC		0	1	1	0
-			C		0	1	0	0
-			CD		1	1	0	0
-			D		1	0	0	0
-			DA		1	0	0	1
-		*/
-        if (_half_step) {
-            switch (_current_phase) {
-                case 0:
-                    _phase[0] = 1;
-                    break;
-                case 1:
-                    _phase[0] = 1;
-                    _phase[1] = 1;
-                    break;
-                case 2:
-                    _phase[1] = 1;
-                    break;
-                case 3:
-                    _phase[1] = 1;
-                    _phase[2] = 1;
-                    break;
-                case 4:
-                    _phase[2] = 1;
-                    break;
-                case 5:
-                    _phase[2] = 1;
-                    _phase[3] = 1;
-                    break;
-                case 6:
-                    _phase[3] = 1;
-                    break;
-                case 7:
-                    _phase[3] = 1;
-                    _phase[0] = 1;
-                    break;
+        write_phase();
+    }
+
+    // Called from the step ISR through step().
+    void IRAM_ATTR UnipolarMotor::write_phase() {
+        if (UNIPOLAR_MICROSTEPS >= 4) {
+            for (uint8_t coil = 0; coil < 4; coil++) {
+                ledc_write_isr(_channel[coil], microstep_duty[_current_phase][coil]);
             }
+        } else if (_direct) {
+            // Clear before set, so a coil is never driven together with its opposite
+            GPIO.out_w1tc      = _clear_mask[0][_current_phase];
+            GPIO.out1_w1tc.val = _clear_mask[1][_current_phase];
+            GPIO.out_w1ts      = _set_mask[0][_current_phase];
+            GPIO.out1_w1ts.val = _set_mask[1][_current_phase];
         } else {
-            switch (_current_phase) {
-                case 0:
-                    _phase[0] = 1;
-                    _phase[1] = 1;
-                    break;
-                case 1:
-                    _phase[1] = 1;
-                    _phase[2] = 1;
-                    break;
-                case 2:
-                    _phase[2] = 1;
-                    _phase[3] = 1;
-                    break;
-                case 3:
-                    _phase[3] = 1;
-                    _phase[0] = 1;
-                    break;
-            }
+            write_coils((phase_count == 8) ? half_step_coils[_current_phase] : full_step_coils[_current_phase]);
         }
-        digitalWrite(_pin_phase0, _phase[0]);
-        digitalWrite(_pin_phase1, _phase[1]);
-        digitalWrite(_pin_phase2, _phase[2]);
-        digitalWrite(_pin_phase3, _phase[3]);
+    }
+
+    void UnipolarMotor::write_coils(uint8_t coils) {
+        digitalWrite(_pin_phase0, coils & bit(0) ? 1 : 0);
+        digitalWrite(_pin_phase1, coils & bit(1) ? 1 : 0);
+        digitalWrite(_pin_phase2, coils & bit(2) ? 1 : 0);
+        digitalWrite(_pin_phase3, coils & bit(3) ? 1 : 0);
     }
 }
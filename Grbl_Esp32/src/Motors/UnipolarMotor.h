@@ -2,6 +2,21 @@
 
 #include "Motor.h"
 
+// Step mode of all unipolar motors. 1 is full step, 2 is half step and 4 to 32 microstep the coils
+// with PWM, one LEDC channel per coil. Steps per mm scale with it.
+#ifndef UNIPOLAR_MICROSTEPS
+#    define UNIPOLAR_MICROSTEPS 2
+#endif
+
+static_assert(UNIPOLAR_MICROSTEPS == 1 || UNIPOLAR_MICROSTEPS == 2 || (UNIPOLAR_MICROSTEPS >= 4 && UNIPOLAR_MICROSTEPS <= 32),
+              "UNIPOLAR_MICROSTEPS must be 1, 2 or 4 to 32");
+
+#ifndef UNIPOLAR_PWM_FREQ
+#    define UNIPOLAR_PWM_FREQ 20000  // Hz, above hearing
+#endif
+
+const int UNIPOLAR_PWM_RES_BITS = 10;
+
 namespace Motors {
     class UnipolarMotor : public Motor {
     public:
@@ -13,12 +28,24 @@ namespace Motors {
         void step(uint8_t step_mask, uint8_t dir_mask);  // only used on Unipolar right now
 
     private:
+        static const uint8_t phase_count = (UNIPOLAR_MICROSTEPS == 1) ? 4 : (UNIPOLAR_MICROSTEPS == 2) ? 8 : 4 * UNIPOLAR_MICROSTEPS;
+
+        void write_phase();
+        void write_coils(uint8_t coils);
+
         uint8_t _pin_phase0;
         uint8_t _pin_phase1;
         uint8_t _pin_phase2;
         uint8_t _pin_phase3;
         uint8_t _current_phase;
-        bool    _half_step;
         bool    _enabled;
+
+        // Full and half step write each phase with GPIO set and clear registers, for each of the
+        // two GPIO banks, when none of the pins are on I2S.
+        bool     _direct;
+        uint32_t _set_mask[2][phase_count];
+        uint32_t _clear_mask[2][phase_count];
+
+        uint8_t _channel[4];  // LEDC channels of the coils in microstep mode
     };
 }
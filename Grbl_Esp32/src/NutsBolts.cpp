@@ -27,6 +27,10 @@
 
 const int MAX_INT_DIGITS = 8;  // Maximum number of digits in int32 (and float)
 
+// Powers of ten that are exact in single precision, used to scale the integer read_float() builds.
+static const float pow10_table[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+const int          MAX_POW10     = (sizeof(pow10_table) / sizeof(pow10_table[0])) - 1;
+
 // Extracts a floating point value from a string. The following code is based loosely on
 // the avr-libc strtod() function by Michael Stumpf and Dmitry Xmelkov and many freely
 // available conversion method examples, but has been highly optimized for Grbl. For known
@@ -79,22 +83,26 @@ uint8_t read_float(const char* line, uint8_t* char_counter, float* float_ptr) {
         return false;
     }
 
-    // Convert integer into floating point.
+    // Convert integer into floating point once, then apply the decimal with a single division by an
+    // exact power of ten, so values like 0.1 come out as the nearest float rather than 0.1 * 0.01
+    // rounding twice. Integers up to 2^24 are exact as floats. Longer ones, which need all eight
+    // digits, are scaled in double precision so they are still rounded only once.
     float fval;
-    fval = (float)intval;
-    // Apply decimal. Should perform no more than two floating point multiplications for the
-    // expected range of E0 to E-4.
-    if (fval != 0) {
-        while (exp <= -2) {
-            fval *= 0.01;
-            exp += 2;
+    if (exp < 0) {  // exp >= -MAX_INT_DIGITS, since it only counts kept decimal digits
+        if (intval < (1UL << 24)) {
+            fval = (float)intval / pow10_table[-exp];
+        } else {
+            fval = (float)((double)intval / pow10_table[-exp]);
         }
-        if (exp < 0) {
-            fval *= 0.1;
-        } else if (exp > 0) {
-            do {
-                fval *= 10.0;
-            } while (--exp > 0);
+    } else {
+        fval = (float)intval;
+        if (fval != 0) {
+            // Dropped integer digits. Only seen with more than MAX_INT_DIGITS digits before the point.
+            while (exp > MAX_POW10) {
+                fval *= pow10_table[MAX_POW10];
+                exp -= MAX_POW10;
+            }
+            fval *= pow10_table[exp];
         }
     }
     // Assign floating point value with correct sign.
@@ -138,48 +146,55 @@ float hypot_f(float x, float y) {
 
 float convert_delta_vector_to_unit_vector(float* vector) {
     uint8_t idx;
-    float   magnitude = 0.0;
-    auto    n_axis    = number_axis->get();
+    float   magnitude = 0.0f;
+    auto    n_axis    = motion_config.n_axis;
     for (idx = 0; idx < n_axis; idx++) {
-        if (vector[idx] != 0.0) {
-            magnitude += vector[idx] * vector[idx];
-        }
+        magnitude += vector[idx] * vector[idx];
     }
-    magnitude           = sqrt(magnitude);
-    float inv_magnitude = 1.0 / magnitude;
+    magnitude           = sqrtf(magnitude);
+    float inv_magnitude = 1.0f / magnitude;
     for (idx = 0; idx < n_axis; idx++) {
         vector[idx] *= inv_magnitude;
     }
     return magnitude;
 }
 
+// The axis limits below are the smallest of limit[idx] / |unit_vec[idx]| over the moving axes. That is
+// 1 / the largest |unit_vec[idx]| / limit[idx], so they take the precomputed reciprocals of the limits
+// and divide once.
+static float limit_by_axis_reciprocal(const float* unit_vec, const float* inv_limit) {
+    float largest = 0.0f;
+    auto  n_axis  = motion_config.n_axis;
+    for (uint8_t idx = 0; idx < n_axis; idx++) {
+        largest = MAX(largest, fabsf(unit_vec[idx]) * inv_limit[idx]);
+    }
+    return largest;
+}
+
 float limit_acceleration_by_axis_maximum(float* unit_vec) {
-    uint8_t idx;
-    float   limit_value = SOME_LARGE_VALUE;
-    auto    n_axis      = number_axis->get();
-    for (idx = 0; idx < n_axis; idx++) {
-        if (unit_vec[idx] != 0) {  // Avoid divide by zero.
-            limit_value = MIN(limit_value, fabs(axis_settings[idx]->acceleration->get() / unit_vec[idx]));
-        }
+    float largest = limit_by_axis_reciprocal(unit_vec, motion_config.inv_acceleration);
+    if (largest == 0.0f) {
+        return SOME_LARGE_VALUE;
     }
     // The acceleration setting is stored and displayed in units of mm/sec^2,
     // but used in units of mm/min^2.  It suffices to perform the conversion once on
     // exit, since the limit computation above is independent of units - it simply
     // finds the smallest value.
-    return limit_value * SEC_PER_MIN_SQ;
+    return float(SEC_PER_MIN_SQ) / largest;
 }
 
 float limit_rate_by_axis_maximum(float* unit_vec) {
-    uint8_t idx;
-    float   limit_value = SOME_LARGE_VALUE;
-    auto    n_axis      = number_axis->get();
-    for (idx = 0; idx < n_axis; idx++) {
-        if (unit_vec[idx] != 0) {  // Avoid divide by zero.
-            limit_value = MIN(limit_value, fabs(axis_settings[idx]->max_rate->get() / unit_vec[idx]));
-        }
-    }
-    return limit_value;
+    float largest = limit_by_axis_reciprocal(unit_vec, motion_config.inv_max_rate);
+    return largest == 0.0f ? float(SOME_LARGE_VALUE) : 1.0f / largest;
+}
+
+#ifdef JERK_LIMITED_PROFILE
+// Axes with a jerk of 0 do not limit the line. Returns 0 when no moving axis limits it.
+float limit_jerk_by_axis_maximum(float* unit_vec) {
+    float largest = limit_by_axis_reciprocal(unit_vec, motion_config.inv_jerk);
+    return largest == 0.0f ? 0.0f : float(SEC_PER_MIN_CU) / largest;  // mm/sec^3 to mm/min^3
 }
+#endif
 
 float map_float(float x, float in_min, float in_max, float out_min, float out_max) {  // DrawBot_Badge
     return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
@@ -99,6 +99,9 @@ float hypot_f(float x, float y);
 float convert_delta_vector_to_unit_vector(float* vector);
 float limit_acceleration_by_axis_maximum(float* unit_vec);
 float limit_rate_by_axis_maximum(float* unit_vec);
+#ifdef JERK_LIMITED_PROFILE
+float limit_jerk_by_axis_maximum(float* unit_vec);
+#endif
 
 float    mapConstrain(float x, float in_min, float in_max, float out_min, float out_max);
 float    map_float(float x, float in_min, float in_max, float out_min, float out_max);
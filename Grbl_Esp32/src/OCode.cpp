@@ -0,0 +1,800 @@
+/*
+  OCode.cpp - O-codes, numbered parameters and expressions
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_O_CODES
+
+// Bytecode of an expression. Op::Number is followed by the four bytes of its value.
+enum class Op : uint8_t {
+    Number,
+    Parameter,
+    Negate,
+    Power,
+    Multiply,
+    Divide,
+    Modulo,
+    Add,
+    Subtract,
+    Eq,
+    Ne,
+    Gt,
+    Ge,
+    Lt,
+    Le,
+    And,
+    Or,
+    Xor,
+    Abs,
+    Acos,
+    Asin,
+    Atan,
+    Cos,
+    Exp,
+    Fix,
+    Fup,
+    Ln,
+    Round,
+    Sin,
+    Sqrt,
+    Tan,
+};
+
+typedef struct {
+    uint8_t length;
+    uint8_t depth;  // Of the evaluation stack at the end of the code
+    uint8_t code[OCODE_MAX_CODE];
+} ocode_expr_t;
+
+typedef struct {
+    const char* name;
+    Op          op;
+    uint8_t     precedence;  // Of binary operators, higher binds tighter
+} ocode_word_t;
+
+// Longer names first where one starts with another
+static const ocode_word_t binary_ops[] = {
+    { "**", Op::Power, 4 }, { "*", Op::Multiply, 3 }, { "/", Op::Divide, 3 }, { "MOD", Op::Modulo, 3 }, { "+", Op::Add, 2 },
+    { "-", Op::Subtract, 2 }, { "EQ", Op::Eq, 1 },    { "NE", Op::Ne, 1 },    { "GT", Op::Gt, 1 },       { "GE", Op::Ge, 1 },
+    { "LT", Op::Lt, 1 },      { "LE", Op::Le, 1 },    { "AND", Op::And, 0 },  { "OR", Op::Or, 0 },        { "XOR", Op::Xor, 0 },
+};
+
+static const ocode_word_t functions[] = {
+    { "ABS", Op::Abs },   { "ACOS", Op::Acos }, { "ASIN", Op::Asin },   { "ATAN", Op::Atan }, { "COS", Op::Cos },
+    { "EXP", Op::Exp },   { "FIX", Op::Fix },   { "FUP", Op::Fup },     { "LN", Op::Ln },     { "ROUND", Op::Round },
+    { "SIN", Op::Sin },   { "SQRT", Op::Sqrt }, { "TAN", Op::Tan },
+};
+
+enum class OWord : uint8_t {
+    Sub,
+    EndSub,
+    Call,
+    Return,
+    Do,
+    While,
+    EndWhile,
+    Repeat,
+    EndRepeat,
+    If,
+    ElseIf,
+    Else,
+    EndIf,
+    Break,
+    Continue,
+};
+
+static const char* const oword_names[] = {
+    "SUB", "ENDSUB", "CALL", "RETURN", "DO", "WHILE", "ENDWHILE", "REPEAT",
+    "ENDREPEAT", "IF", "ELSEIF", "ELSE", "ENDIF", "BREAK", "CONTINUE",
+};
+
+enum class OFrame : uint8_t {
+    Call,
+    While,
+    Do,
+    Repeat,
+    If,
+};
+
+typedef struct {
+    OFrame   type;
+    bool     taken;  // If: one of its branches has run
+    uint32_t number;
+    uint32_t position;  // Start of the loop body, or where the call returns to
+    uint32_t line;      // Line number at position
+    union {
+        uint32_t     count;                 // Repeat: passes left
+        ocode_expr_t condition;             // While: kept compiled for every pass
+        float        args[OCODE_SUB_ARGS];  // Call: the caller's #1 and up
+    };
+} ocode_frame_t;
+
+typedef struct {
+    uint32_t number;
+    uint32_t position;  // Of the line after O<n> sub
+    uint32_t line;
+} ocode_sub_t;
+
+static float         ocode_params[OCODE_PARAMETERS + 1];  // #0 is not used
+static ocode_frame_t ocode_frames[OCODE_STACK_DEPTH];
+static uint8_t       ocode_n_frames;
+static ocode_sub_t   ocode_subs[OCODE_MAX_SUBS];
+static uint8_t       ocode_n_subs;
+static uint8_t       ocode_nesting;  // Of the value being compiled, bounds the recursion
+
+// Lines are skipped up to an O-word of this number and one of these kinds
+static struct {
+    bool     active;
+    bool     consume;  // The line that ends the skip is done with, instead of run
+    bool     pop;      // ... and closes the construct on top of the stack
+    uint32_t number;
+    uint16_t until;  // bit(OWord)
+} ocode_skip;
+
+// Result of ocode_expand(). gc_tokenize() takes up to 255 characters.
+static char ocode_line[256];
+
+static const char* skip_spaces(const char* s) {
+    while (*s == ' ' || *s == '\t' || *s == '\r') {
+        s++;
+    }
+    return s;
+}
+
+// The end of s after name, or nullptr if it does not start with it. Names of letters must not run on.
+static const char* match(const char* s, const char* name) {
+    size_t n = strlen(name);
+    if (strncasecmp(s, name, n) != 0 || (isalpha(name[0]) && isalpha(s[n]))) {
+        return nullptr;
+    }
+    return s + n;
+}
+
+static bool at_end(const char* s) {
+    s = skip_spaces(s);
+    return *s == '\0' || *s == '(' || *s == ';';
+}
+
+static bool emit(ocode_expr_t* expr, Op op, int8_t effect) {
+    if (expr->length == OCODE_MAX_CODE || expr->depth + effect > OCODE_EVAL_STACK) {
+        return false;
+    }
+    expr->code[expr->length++] = uint8_t(op);
+    expr->depth += effect;
+    return true;
+}
+
+static bool emit_number(ocode_expr_t* expr, float value) {
+    if (expr->length + 1 + sizeof(float) > OCODE_MAX_CODE || expr->depth == OCODE_EVAL_STACK) {
+        return false;
+    }
+    expr->code[expr->length++] = uint8_t(Op::Number);
+    memcpy(&expr->code[expr->length], &value, sizeof(float));
+    expr->length += sizeof(float);
+    expr->depth++;
+    return true;
+}
+
+static const char* compile_value(const char* s, ocode_expr_t* expr);
+
+// Compiles operands joined by binary operators of at least min_precedence, left to right.
+static const char* compile_binary(const char* s, ocode_expr_t* expr, uint8_t min_precedence) {
+    s = compile_value(s, expr);
+    while (s) {
+        s                      = skip_spaces(s);
+        const ocode_word_t* op = nullptr;
+        const char*         next;
+        for (const ocode_word_t& candidate : binary_ops) {
+            if ((next = match(s, candidate.name)) != nullptr) {
+                op = &candidate;
+                break;
+            }
+        }
+        if (op == nullptr || op->precedence < min_precedence) {
+            return s;
+        }
+        s = compile_binary(next, expr, op->precedence + 1);
+        if (s && !emit(expr, op->op, -1)) {
+            return nullptr;
+        }
+    }
+    return s;
+}
+
+static const char* compile_primary(const char* s, ocode_expr_t* expr) {
+    s = skip_spaces(s);
+    if (*s == '-' || *s == '+') {
+        bool negate = *s == '-';
+        s           = compile_value(s + 1, expr);
+        return (s && (!negate || emit(expr, Op::Negate, 0))) ? s : nullptr;
+    }
+    if (*s == '#') {
+        s = compile_value(s + 1, expr);
+        return (s && emit(expr, Op::Parameter, 0)) ? s : nullptr;
+    }
+    if (*s == '[') {
+        s = compile_binary(s + 1, expr, 0);
+        if (s == nullptr) {
+            return nullptr;
+        }
+        s = skip_spaces(s);
+        return *s == ']' ? s + 1 : nullptr;
+    }
+    if (isdigit(*s) || *s == '.') {
+        uint8_t counter = 0;
+        float   value;
+        if (!read_float(s, &counter, &value)) {
+            return nullptr;
+        }
+        return emit_number(expr, value) ? s + counter : nullptr;
+    }
+    for (const ocode_word_t& function : functions) {
+        const char* next = match(s, function.name);
+        if (next == nullptr) {
+            continue;
+        }
+        next = skip_spaces(next);
+        if (*next != '[') {
+            return nullptr;
+        }
+        next = compile_value(next, expr);
+        if (next && function.op == Op::Atan) {  // ATAN[y]/[x]
+            next = skip_spaces(next);
+            if (*next != '/') {
+                return nullptr;
+            }
+            next = skip_spaces(next + 1);
+            if (*next != '[') {
+                return nullptr;
+            }
+            next = compile_value(next, expr);
+        }
+        return (next && emit(expr, function.op, function.op == Op::Atan ? -1 : 0)) ? next : nullptr;
+    }
+    return nullptr;
+}
+
+// Compiles a value: a number, a parameter, a bracketed expression or a function, with an optional sign.
+// Returns the end of it, or nullptr for a syntax error or code too long.
+static const char* compile_value(const char* s, ocode_expr_t* expr) {
+    if (ocode_nesting == OCODE_EVAL_STACK) {
+        return nullptr;
+    }
+    ocode_nesting++;
+    s = compile_primary(s, expr);
+    ocode_nesting--;
+    return s;
+}
+
+static Error parameter_index(float value, int32_t* index) {
+    *index = lroundf(value);
+    return (*index < 1 || *index > OCODE_PARAMETERS) ? Error::ExpressionUnknownParameter : Error::Ok;
+}
+
+static Error evaluate(const ocode_expr_t* expr, float* result) {
+    const float deg = 180.0 / M_PI;
+    float       stack[OCODE_EVAL_STACK];
+    uint8_t     sp = 0;
+    for (uint8_t pc = 0; pc < expr->length;) {
+        Op op = Op(expr->code[pc++]);
+        if (op == Op::Number) {
+            memcpy(&stack[sp++], &expr->code[pc], sizeof(float));
+            pc += sizeof(float);
+            continue;
+        }
+        float& top = stack[sp - 1];
+        switch (op) {
+            case Op::Parameter: {
+                int32_t index;
+                Error   status = parameter_index(top, &index);
+                if (status != Error::Ok) {
+                    return status;
+                }
+                top = ocode_params[index];
+                break;
+            }
+            case Op::Negate:
+                top = -top;
+                break;
+            case Op::Abs:
+                top = fabsf(top);
+                break;
+            case Op::Acos:
+                top = acosf(top) * deg;
+                break;
+            case Op::Asin:
+                top = asinf(top) * deg;
+                break;
+            case Op::Cos:
+                top = cosf(top / deg);
+                break;
+            case Op::Exp:
+                top = expf(top);
+                break;
+            case Op::Fix:
+                top = floorf(top);
+                break;
+            case Op::Fup:
+                top = ceilf(top);
+                break;
+            case Op::Ln:
+                top = logf(top);
+                break;
+            case Op::Round:
+                top = roundf(top);
+                break;
+            case Op::Sin:
+                top = sinf(top / deg);
+                break;
+            case Op::Sqrt:
+                top = sqrtf(top);
+                break;
+            case Op::Tan:
+                top = tanf(top / deg);
+                break;
+            default: {  // Binary operators
+                float  b = stack[--sp];
+                float& a = stack[sp - 1];
+                switch (op) {
+                    case Op::Power:
+                        a = powf(a, b);
+                        break;
+                    case Op::Multiply:
+                        a = a * b;
+                        break;
+                    case Op::Divide:
+                    case Op::Modulo:
+                        if (b == 0.0) {
+                            return Error::ExpressionDivideByZero;
+                        }
+                        if (op == Op::Divide) {
+                            a = a / b;
+                        } else {
+                            a = fmodf(a, b);
+                            if (a < 0.0) {
+                                a += fabsf(b);  // Modulo is never negative
+                            }
+                        }
+                        break;
+                    case Op::Add:
+                        a = a + b;
+                        break;
+                    case Op::Subtract:
+                        a = a - b;
+                        break;
+                    case Op::Eq:
+                        a = a == b;
+                        break;
+                    case Op::Ne:
+                        a = a != b;
+                        break;
+                    case Op::Gt:
+                        a = a > b;
+                        break;
+                    case Op::Ge:
+                        a = a >= b;
+                        break;
+                    case Op::Lt:
+                        a = a < b;
+                        break;
+                    case Op::Le:
+                        a = a <= b;
+                        break;
+                    case Op::And:
+                        a = a != 0.0 && b != 0.0;
+                        break;
+                    case Op::Or:
+                        a = a != 0.0 || b != 0.0;
+                        break;
+                    case Op::Xor:
+                        a = (a != 0.0) != (b != 0.0);
+                        break;
+                    case Op::Atan:
+                        a = atan2f(a, b) * deg;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+    *result = stack[0];
+    return isfinite(*result) ? Error::Ok : Error::ExpressionInvalidArgument;
+}
+
+// Compiles and evaluates the one value an O-word takes, which only a comment may follow.
+static Error argument(const char* s, ocode_expr_t* expr, float* value) {
+    s = compile_value(s, expr);
+    if (s == nullptr || !at_end(s)) {
+        return Error::ExpressionSyntaxError;
+    }
+    return evaluate(expr, value);
+}
+
+Error ocode_expand(char** line) {
+    const char* in = *line;
+    if (strpbrk(in, "#[") == nullptr) {
+        return Error::Ok;
+    }
+    char* out = ocode_line;
+    char* end = ocode_line + sizeof(ocode_line) - 1;
+    struct {
+        int32_t index;
+        float   value;
+    } assigned[8];
+    uint8_t n_assigned = 0;
+    while (*in) {
+        if (*in == '(' || *in == ';') {  // Comments stay as they are, gc_tokenize() takes them out
+            const char* close  = (*in == '(') ? strchr(in, ')') : nullptr;
+            size_t      length = close ? close + 1 - in : strlen(in);
+            if (length > size_t(end - out)) {
+                return Error::LineLengthExceeded;
+            }
+            memcpy(out, in, length);
+            out += length;
+            in += length;
+            continue;
+        }
+        const char* value = in;
+        if (*in == '-' || *in == '+') {
+            value = skip_spaces(in + 1);
+        }
+        if (*value != '#' && *value != '[') {
+            if (out == end) {
+                return Error::LineLengthExceeded;
+            }
+            *out++ = *in++;
+            continue;
+        }
+        ocode_expr_t expr = {};
+        const char*  next = compile_value(in, &expr);
+        if (next == nullptr) {
+            return Error::ExpressionSyntaxError;
+        }
+        const char* equals = skip_spaces(next);
+        if (*in == '#' && *equals == '=') {
+            // An assignment. Without its last op, the code yields the index instead of the value.
+            ocode_expr_t rhs = {};
+            expr.length--;
+            next = compile_value(equals + 1, &rhs);
+            if (next == nullptr) {
+                return Error::ExpressionSyntaxError;
+            }
+            if (n_assigned == sizeof(assigned) / sizeof(assigned[0])) {
+                return Error::Overflow;
+            }
+            float index;
+            Error status = evaluate(&expr, &index);
+            if (status == Error::Ok) {
+                status = parameter_index(index, &assigned[n_assigned].index);
+            }
+            if (status == Error::Ok) {
+                status = evaluate(&rhs, &assigned[n_assigned].value);
+            }
+            if (status != Error::Ok) {
+                return status;
+            }
+            n_assigned++;
+            in = next;
+            continue;
+        }
+        float result;
+        Error status = evaluate(&expr, &result);
+        if (status != Error::Ok) {
+            return status;
+        }
+        int length = snprintf(out, end - out + 1, "%.4f", result);
+        if (length > end - out) {
+            return Error::LineLengthExceeded;
+        }
+        out += length;
+        in = next;
+    }
+    *out = '\0';
+    // Assignments take effect after the whole line is read.
+    for (uint8_t i = 0; i < n_assigned; i++) {
+        ocode_params[assigned[i].index] = assigned[i].value;
+    }
+    *line = ocode_line;
+    return Error::Ok;
+}
+
+static void skip_to(uint32_t number, uint16_t until, bool consume, bool pop) {
+    ocode_skip.active  = true;
+    ocode_skip.number  = number;
+    ocode_skip.until   = until;
+    ocode_skip.consume = consume;
+    ocode_skip.pop     = pop;
+}
+
+// Continues the job at position, the start of line number line.
+static Error jump(uint32_t position, uint32_t line) {
+    return seekFile(position, line) ? Error::Ok : Error::SdFailedRead;
+}
+
+// Opens a construct that starts after the current line.
+static ocode_frame_t* push(OFrame type, uint32_t number) {
+    if (ocode_n_frames == OCODE_STACK_DEPTH) {
+        return nullptr;
+    }
+    ocode_frame_t* frame = &ocode_frames[ocode_n_frames++];
+    frame->type          = type;
+    frame->taken         = false;
+    frame->number        = number;
+    frame->position      = sd_get_current_position();
+    frame->line          = sd_get_current_line_number() + 1;
+    return frame;
+}
+
+static ocode_frame_t* top(OFrame type, uint32_t number) {
+    if (ocode_n_frames == 0) {
+        return nullptr;
+    }
+    ocode_frame_t* frame = &ocode_frames[ocode_n_frames - 1];
+    return (frame->type == type && frame->number == number) ? frame : nullptr;
+}
+
+// Index of the innermost call, or loop if loop is set, numbered number. Loops are not looked for
+// outside the current sub. Returns -1 if there is none.
+static int find_frame(uint32_t number, bool loop) {
+    for (int i = ocode_n_frames - 1; i >= 0; i--) {
+        const ocode_frame_t* frame = &ocode_frames[i];
+        if (loop && frame->type == OFrame::Call) {
+            return -1;
+        }
+        bool is_loop = frame->type == OFrame::While || frame->type == OFrame::Do || frame->type == OFrame::Repeat;
+        if (frame->number == number && (loop ? is_loop : frame->type == OFrame::Call)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static ocode_sub_t* find_sub(uint32_t number) {
+    for (uint8_t i = 0; i < ocode_n_subs; i++) {
+        if (ocode_subs[i].number == number) {
+            return &ocode_subs[i];
+        }
+    }
+    return nullptr;
+}
+
+static Error call(uint32_t number, const char* s) {
+    ocode_sub_t* sub = find_sub(number);
+    if (sub == nullptr) {
+        return Error::OCodeUnknownSub;
+    }
+    // The arguments are evaluated with the caller's parameters.
+    float   args[OCODE_SUB_ARGS] = {};
+    uint8_t n_args               = 0;
+    while (!at_end(s)) {
+        if (n_args == OCODE_SUB_ARGS) {
+            return Error::Overflow;
+        }
+        ocode_expr_t expr = {};
+        s                 = compile_value(s, &expr);
+        if (s == nullptr) {
+            return Error::ExpressionSyntaxError;
+        }
+        Error status = evaluate(&expr, &args[n_args++]);
+        if (status != Error::Ok) {
+            return status;
+        }
+    }
+    ocode_frame_t* frame = push(OFrame::Call, number);
+    if (frame == nullptr) {
+        return Error::OCodeStackOverflow;
+    }
+    memcpy(frame->args, &ocode_params[1], sizeof(frame->args));
+    memcpy(&ocode_params[1], args, sizeof(args));
+    return jump(sub->position, sub->line);
+}
+
+static Error execute(OWord word, uint32_t number, const char* s) {
+    ocode_frame_t* frame;
+    ocode_expr_t   expr = {};
+    float          value;
+    Error          status;
+    switch (word) {
+        case OWord::Sub: {
+            ocode_sub_t* sub = find_sub(number);
+            if (sub == nullptr) {
+                if (ocode_n_subs == OCODE_MAX_SUBS) {
+                    return Error::Overflow;
+                }
+                sub = &ocode_subs[ocode_n_subs++];
+            }
+            sub->number   = number;
+            sub->position = sd_get_current_position();
+            sub->line     = sd_get_current_line_number() + 1;
+            skip_to(number, bit(OWord::EndSub), true, false);  // Only runs when called
+            return Error::Ok;
+        }
+        case OWord::EndSub:
+        case OWord::Return: {
+            int i = find_frame(number, false);
+            if (i < 0) {
+                return Error::OCodeUnmatched;
+            }
+            frame = &ocode_frames[i];
+            memcpy(&ocode_params[1], frame->args, sizeof(frame->args));
+            ocode_n_frames = i;  // Also leaves the loops and ifs open in the sub
+            return jump(frame->position, frame->line);
+        }
+        case OWord::Call:
+            return call(number, s);
+        case OWord::Do:
+            return push(OFrame::Do, number) ? Error::Ok : Error::OCodeStackOverflow;
+        case OWord::While:
+            if ((status = argument(s, &expr, &value)) != Error::Ok) {
+                return status;
+            }
+            if ((frame = top(OFrame::Do, number)) != nullptr) {  // The end of a do loop
+                if (value != 0.0) {
+                    return jump(frame->position, frame->line);
+                }
+                ocode_n_frames--;
+                return Error::Ok;
+            }
+            if (value == 0.0) {
+                skip_to(number, bit(OWord::EndWhile), true, false);
+                return Error::Ok;
+            }
+            if ((frame = push(OFrame::While, number)) == nullptr) {
+                return Error::OCodeStackOverflow;
+            }
+            frame->condition = expr;
+            return Error::Ok;
+        case OWord::EndWhile:
+            if ((frame = top(OFrame::While, number)) == nullptr) {
+                return Error::OCodeUnmatched;
+            }
+            if ((status = evaluate(&frame->condition, &value)) != Error::Ok) {
+                return status;
+            }
+            if (value != 0.0) {
+                return jump(frame->position, frame->line);
+            }
+            ocode_n_frames--;
+            return Error::Ok;
+        case OWord::Repeat:
+            if ((status = argument(s, &expr, &value)) != Error::Ok) {
+                return status;
+            }
+            if (lroundf(value) <= 0) {
+                skip_to(number, bit(OWord::EndRepeat), true, false);
+                return Error::Ok;
+            }
+            if ((frame = push(OFrame::Repeat, number)) == nullptr) {
+                return Error::OCodeStackOverflow;
+            }
+            frame->count = lroundf(value);
+            return Error::Ok;
+        case OWord::EndRepeat:
+            if ((frame = top(OFrame::Repeat, number)) == nullptr) {
+                return Error::OCodeUnmatched;
+            }
+            if (--frame->count > 0) {
+                return jump(frame->position, frame->line);
+            }
+            ocode_n_frames--;
+            return Error::Ok;
+        case OWord::If:
+            if ((status = argument(s, &expr, &value)) != Error::Ok) {
+                return status;
+            }
+            if ((frame = push(OFrame::If, number)) == nullptr) {
+                return Error::OCodeStackOverflow;
+            }
+            frame->taken = value != 0.0;
+            if (!frame->taken) {
+                skip_to(number, bit(OWord::ElseIf) | bit(OWord::Else) | bit(OWord::EndIf), false, false);
+            }
+            return Error::Ok;
+        case OWord::ElseIf:
+        case OWord::Else:
+            if ((frame = top(OFrame::If, number)) == nullptr) {
+                return Error::OCodeUnmatched;
+            }
+            if (frame->taken) {
+                skip_to(number, bit(OWord::EndIf), true, true);
+                return Error::Ok;
+            }
+            value = 1.0;
+            if (word == OWord::ElseIf && (status = argument(s, &expr, &value)) != Error::Ok) {
+                return status;
+            }
+            frame->taken = value != 0.0;
+            if (!frame->taken) {
+                skip_to(number, bit(OWord::ElseIf) | bit(OWord::Else) | bit(OWord::EndIf), false, false);
+            }
+            return Error::Ok;
+        case OWord::EndIf:
+            if (top(OFrame::If, number) == nullptr) {
+                return Error::OCodeUnmatched;
+            }
+            ocode_n_frames--;
+            return Error::Ok;
+        case OWord::Break:
+        case OWord::Continue: {
+            int i = find_frame(number, true);
+            if (i < 0) {
+                return Error::OCodeUnmatched;
+            }
+            ocode_n_frames = i + 1;  // Leaves the ifs inside the loop
+            // Continue runs the end of the loop, which decides about the next pass.
+            uint16_t until = (ocode_frames[i].type == OFrame::While)    ? bit(OWord::EndWhile)
+                             : (ocode_frames[i].type == OFrame::Repeat) ? bit(OWord::EndRepeat)
+                                                                        : bit(OWord::While);
+            skip_to(number, until, word == OWord::Break, word == OWord::Break);
+            return Error::Ok;
+        }
+    }
+    return Error::Ok;
+}
+
+Error ocode_file_line(char* line, uint8_t client) {
+    const char* s = skip_spaces(line);
+    if (*s != 'O' && *s != 'o') {
+        return ocode_skip.active ? Error::Ok : gc_execute_line(line, client);
+    }
+    s = skip_spaces(s + 1);
+    if (!isdigit(*s)) {
+        return ocode_skip.active ? Error::Ok : Error::ExpressionSyntaxError;
+    }
+    uint32_t number = 0;
+    while (isdigit(*s)) {
+        number = number * 10 + (*s++ - '0');
+    }
+    s                = skip_spaces(s);
+    const char* name = s;
+    while (isalpha(*s)) {
+        s++;
+    }
+    int word = -1;
+    for (int i = 0; i < int(sizeof(oword_names) / sizeof(oword_names[0])); i++) {
+        if (strlen(oword_names[i]) == size_t(s - name) && strncasecmp(name, oword_names[i], s - name) == 0) {
+            word = i;
+            break;
+        }
+    }
+    if (ocode_skip.active) {
+        if (word < 0 || number != ocode_skip.number || bit_isfalse(ocode_skip.until, bit(word))) {
+            return Error::Ok;
+        }
+        ocode_skip.active = false;
+        if (ocode_skip.pop) {
+            ocode_n_frames--;
+        }
+        if (ocode_skip.consume) {
+            return Error::Ok;
+        }
+    }
+    if (word < 0) {
+        return Error::OCodeUnknownWord;
+    }
+    return execute(OWord(word), number, s);
+}
+
+void ocode_reset() {
+    ocode_n_frames    = 0;
+    ocode_n_subs      = 0;
+    ocode_skip.active = false;
+}
+
+#endif
@@ -0,0 +1,86 @@
+#pragma once
+
+/*
+  OCode.h - O-codes, numbered parameters and expressions
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  A subset of the LinuxCNC language. #1 to #OCODE_PARAMETERS are numbered parameters, zero at boot.
+  #<n>=<value> sets one after the rest of the line is read, so #1=[#1+1] G1 X#1 moves to the old
+  value. Wherever a number goes, #<n>, #[<expression>] and [<expression>] may stand instead. In
+  expressions, ** binds tightest, then * / MOD, + -, EQ NE GT GE LT LE and last AND OR XOR. Functions
+  are ABS ACOS ASIN COS EXP FIX FUP LN ROUND SIN SQRT TAN of a [value], and ATAN[y]/[x], in degrees.
+  Expressions are compiled to a small stack bytecode and then evaluated, so a loop condition is
+  compiled once and not again on every pass.
+
+  In SD jobs, O-words control which lines run:
+
+    O<n> sub ... O<n> endsub     defines a sub, called by O<n> call [arg] [arg]..., which sets #1 and
+                                 up to the arguments. #1 to #OCODE_SUB_ARGS are back to the caller's
+                                 values after O<n> endsub or O<n> return.
+    O<n> while [cond] ... O<n> endwhile
+    O<n> do ... O<n> while [cond]
+    O<n> repeat [count] ... O<n> endrepeat
+    O<n> if [cond] ... O<n> elseif [cond] ... O<n> else ... O<n> endif
+    O<n> break, O<n> continue    leave the loop numbered n, or start its next pass
+
+  Loops and calls seek in the file, so they need no host and no memory for the lines they repeat.
+  Subs have to be defined before they are called. A job resumed in the middle does not know the subs
+  defined before that point.
+*/
+
+#include "Grbl.h"
+
+#ifndef ENABLE_SD_CARD
+#    error "ENABLE_O_CODES requires ENABLE_SD_CARD"
+#endif
+
+#ifndef OCODE_PARAMETERS
+#    define OCODE_PARAMETERS 100
+#endif
+// Parameters a sub call passes, starting at #1, and restores on return
+#ifndef OCODE_SUB_ARGS
+#    define OCODE_SUB_ARGS 30
+#endif
+// Calls, loops and ifs open at a time
+#ifndef OCODE_STACK_DEPTH
+#    define OCODE_STACK_DEPTH 10
+#endif
+#ifndef OCODE_MAX_SUBS
+#    define OCODE_MAX_SUBS 16
+#endif
+// Bytes of bytecode per expression, and values on the evaluation stack
+#ifndef OCODE_MAX_CODE
+#    define OCODE_MAX_CODE 64
+#endif
+#ifndef OCODE_EVAL_STACK
+#    define OCODE_EVAL_STACK 16
+#endif
+
+static_assert(OCODE_SUB_ARGS <= OCODE_PARAMETERS, "OCODE_SUB_ARGS must not exceed OCODE_PARAMETERS");
+
+// Replaces the parameters and expressions in a line by their values and takes out the assignments.
+// *line is left pointing to the result, or to the line itself if it has neither. Called by
+// gc_execute_line().
+Error ocode_expand(char** line);
+
+// Runs a line of the SD job. O-words are executed here, and the other lines go to gc_execute_line()
+// unless they are skipped.
+Error ocode_file_line(char* line, uint8_t client);
+
+// Forgets the subs and open loops of the job before. Called when a job starts.
+void ocode_reset();
@@ -0,0 +1,157 @@
+/*
+  PathBlending.cpp - rounds the corners between straight moves in G64 mode
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef PATH_BLENDING
+
+// Corners flatter than this, in cos of the turn, are left alone. Reversals can't be blended.
+const float BLEND_MIN_TURN_COS = 0.99999;
+const float BLEND_MAX_TURN_COS = -0.99999;
+
+static bool             held = false;
+static float            held_start[MAX_N_AXIS];   // Where the held move starts, after the blend before it
+static float            held_target[MAX_N_AXIS];  // The corner
+static plan_line_data_t held_data;
+
+static bool blend_compatible(const plan_line_data_t* a, const plan_line_data_t* b) {
+    if (a->motion.inverseTime || b->motion.inverseTime) {
+        return false;  // The feed rate is a time for the whole programmed move
+    }
+#ifdef ENABLE_LASER_RASTER
+    if (a->raster || b->raster) {
+        return false;
+    }
+#endif
+    return a->motion.rapidMotion == b->motion.rapidMotion && a->motion.noFeedOverride == b->motion.noFeedOverride &&
+           a->spindle == b->spindle && a->coolant.Mist == b->coolant.Mist && a->coolant.Flood == b->coolant.Flood;
+}
+
+// Unit vector from from to to. Returns the length.
+static float blend_direction(const float* from, const float* to, float* unit_vec) {
+    float length = 0.0;
+    for (uint8_t axis = 0; axis < MAX_N_AXIS; axis++) {
+        unit_vec[axis] = axis < motion_config.n_axis ? to[axis] - from[axis] : 0.0;
+        length += unit_vec[axis] * unit_vec[axis];
+    }
+    length = sqrtf(length);
+    if (length > 0.0) {
+        for (uint8_t axis = 0; axis < MAX_N_AXIS; axis++) {
+            unit_vec[axis] /= length;
+        }
+    }
+    return length;
+}
+
+// Plans the held move up to A and the curve from A over the corner to B.
+static void blend_corner(float* a, float* b, float turn_cos, float leg, plan_line_data_t* pl_data) {
+    mc_line(a, &held_data);
+    if (sys.abort) {
+        return;
+    }
+    // The curve is tightest at its middle, with a radius of leg * cos^2(turn/2) / sin(turn/2). Its
+    // chords are sized for that radius like the segments of an arc, see mc_arc().
+    float    sin_half  = sqrtf(0.5 * (1.0 - turn_cos));
+    float    cos_half  = sqrtf(0.5 * (1.0 + turn_cos));
+    float    radius    = leg * cos_half * cos_half / sin_half;
+    float    tolerance = MIN(arc_tolerance->get(), radius);
+    float    turn      = 2.0 * atan2f(sin_half, cos_half);
+    float    chord     = 2.0 * acosf(1.0 - tolerance / radius);  // Turn per segment
+    uint16_t segments  = chord > 0.0 ? ceilf(turn / chord) : BLEND_MAX_SEGMENTS;
+    segments           = MAX(1, MIN(segments, BLEND_MAX_SEGMENTS));
+    float point[MAX_N_AXIS];
+    for (uint16_t i = 1; i <= segments; i++) {
+        float t = float(i) / segments;
+        for (uint8_t axis = 0; axis < MAX_N_AXIS; axis++) {
+            point[axis] = (1.0 - t) * (1.0 - t) * a[axis] + 2.0 * t * (1.0 - t) * held_target[axis] + t * t * b[axis];
+        }
+        mc_line(point, pl_data);
+        if (sys.abort) {
+            return;
+        }
+    }
+}
+
+void blend_line(float* target, plan_line_data_t* pl_data, float* position, float tolerance) {
+#ifdef USE_KINEMATICS
+    if (!kinematics->reachable(target)) {
+        grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Target unreachable");
+        return;
+    }
+#endif
+    if (!held || !blend_compatible(&held_data, pl_data)) {
+        blend_flush();
+        if (sys.abort) {
+            return;
+        }
+        memcpy(held_start, position, sizeof(held_start));
+    } else {
+        held = false;
+        float in_vec[MAX_N_AXIS];
+        float out_vec[MAX_N_AXIS];
+        float in_length  = blend_direction(held_start, held_target, in_vec);
+        float out_length = blend_direction(held_target, target, out_vec);
+        float turn_cos   = 0.0;
+        for (uint8_t axis = 0; axis < MAX_N_AXIS; axis++) {
+            turn_cos += in_vec[axis] * out_vec[axis];
+        }
+        // The curve passes the corner at leg * sin(turn/2) / 2, where leg is the distance of A and B
+        // from the corner.
+        float leg = 0.0;
+        if (in_length > 0.0 && out_length > 0.0 && turn_cos < BLEND_MIN_TURN_COS && turn_cos > BLEND_MAX_TURN_COS) {
+            leg = MIN(2.0 * tolerance / sqrtf(0.5 * (1.0 - turn_cos)), MIN(in_length, 0.5 * out_length));
+        }
+        if (leg > 0.0) {
+            float a[MAX_N_AXIS];
+            for (uint8_t axis = 0; axis < MAX_N_AXIS; axis++) {
+                a[axis]          = held_target[axis] - leg * in_vec[axis];
+                held_start[axis] = held_target[axis] + leg * out_vec[axis];
+            }
+            blend_corner(a, held_start, turn_cos, leg, pl_data);
+        } else {
+            mc_line(held_target, &held_data);
+            memcpy(held_start, held_target, sizeof(held_start));
+        }
+        if (sys.abort) {
+            return;
+        }
+    }
+    // A move that can't be planned shouldn't wait for the next one to find out.
+    if (motion_config.soft_limits) {
+        limits_soft_check(target);
+    }
+    memcpy(held_target, target, sizeof(held_target));
+    held_data = *pl_data;
+    held      = true;
+}
+
+void blend_flush() {
+    if (!held) {
+        return;
+    }
+    held = false;
+    if (!sys.abort) {
+        mc_line(held_target, &held_data);
+    }
+}
+
+void blend_reset() {
+    held = false;
+}
+
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+
+/*
+  PathBlending.h - rounds the corners between straight moves in G64 mode
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  In G64 mode the last G0 or G1 move is held back until the next one arrives. If both are of the same
+  kind, the corner between them is cut: the held move ends early at A, a quadratic Bezier curve runs
+  from A to B with the corner as its control point, and the next move starts at B and is held in turn.
+  The curve is tangent to both moves and passes the corner at a quarter of |A - B|, which is kept
+  within the tolerance of G64 P, or $11 without P. A and B are at most the whole rest of the held move
+  and half of the next one away from the corner, so the curves of neighbouring corners do not overlap.
+
+  The curve is planned as short lines whose chords stay within $12, the arc tolerance. Their junctions
+  turn by small angles only, so the junction deviation of $11 lets the planner keep a much higher speed
+  through them than through the sharp corner.
+
+  The held move is planned before any other motion, before a buffer sync, and from the main loop when
+  the planner runs low, so a stream that stops does not leave it behind. Moves in inverse time mode and
+  moves that change the spindle or the coolant are not blended.
+*/
+
+#include "Grbl.h"
+
+// Most lines a blend curve is planned as
+#ifndef BLEND_MAX_SEGMENTS
+#    define BLEND_MAX_SEGMENTS 16
+#endif
+
+// The main loop plans the held move when fewer blocks than this are left in the planner
+#ifndef BLEND_FLUSH_BLOCKS
+#    define BLEND_FLUSH_BLOCKS 2
+#endif
+
+// Holds a straight move from position to target, blending the corner with the move held before.
+// tolerance is the largest distance of the curve from the corner, in mm.
+void blend_line(float* target, plan_line_data_t* pl_data, float* position, float tolerance);
+
+// Plans the held move, if there is one.
+void blend_flush();
+
+// Forgets the held move. Called on reset.
+void blend_reset();
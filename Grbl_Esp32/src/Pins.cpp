@@ -1,5 +1,8 @@
 #include "Grbl.h"
 #include "I2SOut.h"
+#include "I2SIn.h"
+
+#include <soc/gpio_struct.h>
 
 String pinName(uint8_t pin) {
     if (pin == UNDEFINED_PIN) {
@@ -7,8 +10,10 @@ String pinName(uint8_t pin) {
     }
     if (pin < I2S_OUT_PIN_BASE) {
         return String("GPIO(") + pin + ")";
-    } else {
+    } else if (pin < I2S_IN_PIN_BASE) {
         return String("I2SO(") + (pin - I2S_OUT_PIN_BASE) + ")";
+    } else {
+        return String("I2SI(") + (pin - I2S_IN_PIN_BASE) + ")";
     }
 }
 
@@ -25,11 +30,71 @@ void IRAM_ATTR digitalWrite(uint8_t pin, uint8_t val) {
         __digitalWrite(pin, val);
         return;
     }
+    if (pin >= I2S_IN_PIN_BASE) {
+        return;
+    }
 #ifdef USE_I2S_OUT
     i2s_out_write(pin - I2S_OUT_PIN_BASE, val);
 #endif
 }
 
+void IRAM_ATTR PinBatch::write(uint8_t pin, uint8_t val) {
+    if (pin == UNDEFINED_PIN) {
+        return;
+    }
+    if (pin < NATIVE_GPIO_PINS) {
+        uint32_t mask = bit(pin % 32);
+        if (val) {
+            gpio_set[pin / 32] |= mask;
+            gpio_clear[pin / 32] &= ~mask;
+        } else {
+            gpio_clear[pin / 32] |= mask;
+            gpio_set[pin / 32] &= ~mask;
+        }
+        return;
+    }
+    if (pin < I2S_OUT_PIN_BASE) {
+        return;  // Not a pin
+    }
+    if (pin >= I2S_IN_PIN_BASE) {
+        return;
+    }
+    uint32_t mask = bit(pin - I2S_OUT_PIN_BASE);
+    if (val) {
+        set_mask |= mask;
+        clear_mask &= ~mask;
+    } else {
+        clear_mask |= mask;
+        set_mask &= ~mask;
+    }
+}
+
+void IRAM_ATTR PinBatch::commit() {
+    if (gpio_set[0]) {
+        GPIO.out_w1ts = gpio_set[0];
+    }
+    if (gpio_clear[0]) {
+        GPIO.out_w1tc = gpio_clear[0];
+    }
+    if (gpio_set[1]) {
+        GPIO.out1_w1ts.val = gpio_set[1];
+    }
+    if (gpio_clear[1]) {
+        GPIO.out1_w1tc.val = gpio_clear[1];
+    }
+    gpio_set[0]   = 0;
+    gpio_set[1]   = 0;
+    gpio_clear[0] = 0;
+    gpio_clear[1] = 0;
+#ifdef USE_I2S_OUT
+    if (set_mask | clear_mask) {
+        i2s_out_write_mask(set_mask, clear_mask);
+    }
+#endif
+    set_mask   = 0;
+    clear_mask = 0;
+}
+
 void IRAM_ATTR pinMode(uint8_t pin, uint8_t mode) {
     if (pin == UNDEFINED_PIN) {
         return;
@@ -37,8 +102,9 @@ void IRAM_ATTR pinMode(uint8_t pin, uint8_t mode) {
     if (pin < I2S_OUT_PIN_BASE) {
         __pinMode(pin, mode);
     }
-    // I2S out pins cannot be configured, hence there
-    // is nothing to do here for them.
+    // I2S out and in pins cannot be configured, hence there
+    // is nothing to do here for them. The expander inputs
+    // need their pull-ups on the board.
 }
 
 int IRAM_ATTR digitalRead(uint8_t pin) {
@@ -48,9 +114,48 @@ int IRAM_ATTR digitalRead(uint8_t pin) {
     if (pin < I2S_OUT_PIN_BASE) {
         return __digitalRead(pin);
     }
+    if (pin >= I2S_IN_PIN_BASE) {
+#ifdef USE_I2S_IN
+        return i2s_in_read(pin - I2S_IN_PIN_BASE);
+#else
+        return 0;
+#endif
+    }
 #ifdef USE_I2S_OUT
     return i2s_out_read(pin - I2S_OUT_PIN_BASE);
 #else
     return 0;
 #endif
 }
+
+// The I2S expander inputs are sampled by the I2S interrupt, which calls
+// the handler on a change as a GPIO interrupt would.
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode) {
+    if (pin == UNDEFINED_PIN) {
+        return;
+    }
+    if (pin < I2S_OUT_PIN_BASE) {
+        __attachInterrupt(pin, handler, mode);
+        return;
+    }
+#ifdef USE_I2S_IN
+    if (pin >= I2S_IN_PIN_BASE) {
+        i2s_in_attach(pin - I2S_IN_PIN_BASE, handler, mode);
+    }
+#endif
+}
+
+void detachInterrupt(uint8_t pin) {
+    if (pin == UNDEFINED_PIN) {
+        return;
+    }
+    if (pin < I2S_OUT_PIN_BASE) {
+        __detachInterrupt(pin);
+        return;
+    }
+#ifdef USE_I2S_IN
+    if (pin >= I2S_IN_PIN_BASE) {
+        i2s_in_detach(pin - I2S_IN_PIN_BASE);
+    }
+#endif
+}
@@ -1,12 +1,42 @@
 #pragma once
 
 #include <Arduino.h>
+#include <soc/gpio_struct.h>
 
 const int UNDEFINED_PIN    = 255;  // Can be used to show a pin has no i/O assigned
 const int I2S_OUT_PIN_BASE = 128;
+const int I2S_IN_PIN_BASE  = 192;
+const int NATIVE_GPIO_PINS = 40;  // GPIO(0) to GPIO(39), 34 and up are inputs only
 
 extern "C" int  __digitalRead(uint8_t pin);
 extern "C" void __pinMode(uint8_t pin, uint8_t mode);
 extern "C" void __digitalWrite(uint8_t pin, uint8_t val);
+extern "C" void __attachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+extern "C" void __detachInterrupt(uint8_t pin);
 
 String pinName(uint8_t pin);
+
+// Levels of all the native GPIO inputs in two register reads, bit n is GPIO(n). Functions that test
+// several pins, such as the limit and control pin states of every status report, take this once
+// instead of a digitalRead() per pin.
+inline uint64_t IRAM_ATTR gpio_read_inputs() {
+    return GPIO.in | (uint64_t(GPIO.in1.data) << 32);
+}
+
+// Level of a pin in a gpio_read_inputs() word. Expander pins are not in it and are read as usual.
+inline int IRAM_ATTR gpio_input_level(uint64_t inputs, uint8_t pin) {
+    return pin < NATIVE_GPIO_PINS ? int(inputs >> pin) & 1 : digitalRead(pin);
+}
+
+// Pin writes gathered into one update. digitalWrite() of an I2S expander pin is an atomic read-modify-write
+// of the whole port, commit() sets and clears all the expander pins of the batch in a single one. GPIO pins
+// are gathered the same way, commit() writes them to the set and clear registers of the GPIO port.
+struct PinBatch {
+    uint32_t set_mask      = 0;         // Expander pins, bit n is I2SO(n)
+    uint32_t clear_mask    = 0;
+    uint32_t gpio_set[2]   = { 0, 0 };  // GPIO pins, bit n of word w is GPIO(32 * w + n)
+    uint32_t gpio_clear[2] = { 0, 0 };
+
+    void write(uint8_t pin, uint8_t val);
+    void commit();
+};
@@ -25,12 +25,17 @@
 
 #include "Grbl.h"
 #include <stdlib.h>  // PSoc Required for labs
+#include <esp_heap_caps.h>
+#include <xtensa/hal.h>
 
-static plan_block_t block_buffer[BLOCK_BUFFER_SIZE];  // A ring buffer for motion instructions
-static uint8_t      block_buffer_tail;                // Index of the block to process now
-static uint8_t      block_buffer_head;                // Index of the next block to be pushed
-static uint8_t      next_buffer_head;                 // Index of the next buffer head
-static uint8_t      block_buffer_planned;             // Index of the optimally planned block
+#ifndef PLANNER_USE_PSRAM
+static plan_block_t block_buffer_storage[BLOCK_BUFFER_SIZE];
+#endif
+static plan_block_t* block_buffer = NULL;   // A ring buffer for motion instructions
+static plan_index_t  block_buffer_tail;     // Index of the block to process now
+static plan_index_t  block_buffer_head;     // Index of the next block to be pushed
+static plan_index_t  next_buffer_head;      // Index of the next buffer head
+static plan_index_t  block_buffer_planned;  // Index of the optimally planned block
 
 // Define planner variables
 typedef struct {
@@ -43,7 +48,7 @@ typedef struct {
 static planner_t pl;
 
 // Returns the index of the next block in the ring buffer. Also called by stepper segment buffer.
-uint8_t plan_next_block_index(uint8_t block_index) {
+plan_index_t plan_next_block_index(plan_index_t block_index) {
     block_index++;
     if (block_index == BLOCK_BUFFER_SIZE) {
         block_index = 0;
@@ -52,7 +57,7 @@ uint8_t plan_next_block_index(uint8_t block_index) {
 }
 
 // Returns the index of the previous block in the ring buffer
-static uint8_t plan_prev_block_index(uint8_t block_index) {
+static plan_index_t plan_prev_block_index(plan_index_t block_index) {
     if (block_index == 0) {
         block_index = BLOCK_BUFFER_SIZE;
     }
@@ -124,12 +129,165 @@ static uint8_t plan_prev_block_index(uint8_t block_index) {
   to compute an optimal plan, so select carefully. The Arduino 328p memory is already maxed out, but future
   ARM versions should have enough memory and speed for look-ahead blocks numbering up to a hundred or more.
 
+  ESP32 Note: BLOCK_BUFFER_SIZE can be raised well beyond the AVR default, optionally with the buffer in
+  PSRAM (PLANNER_USE_PSRAM). To keep plan_buffer_line() from becoming O(N) with a deep buffer, the reverse
+  pass for a newly appended block walks back at most max_blocks blocks. Stopping early is safe: a new block
+  can only raise the entry speeds of the blocks before it, so the untouched blocks keep their older, more
+  conservative speeds. The forward pass then starts at the oldest untouched block so that its junction with
+  the first replanned block is checked for a feasible acceleration.
+
+  With PLANNER_INCREMENTAL_RECALC, an append also stops the reverse pass at the first block whose entry
+  speed comes out unchanged. Every block before it was computed from that same exit speed by the previous
+  plan, so none of them can change either. This only holds when the rest of the plan is already settled,
+  so feed holds and override changes still replan the whole buffer. The number of blocks visited by each
+  append is tracked in plan_stats, which shows the cost stays O(1) on long, mostly-straight toolpaths.
+
 */
-static void planner_recalculate() {
+static plan_stats_t plan_stats;
+
+// Between plan_begin_batch() and plan_end_batch(), appended blocks are only counted here and planned
+// together by the next plan_flush_batch().
+static bool         plan_batching = false;
+static plan_index_t plan_deferred = 0;
+
+#ifdef SPINDLE_STATE_IN_PLANNER
+static bool state_deferred = false;  // The next move carries a spindle or coolant change
+#endif
+
+#ifdef PLANNER_LAZY_OVERRIDES
+static bool    override_stale      = false;  // Blocks are planned for overrides that have since changed
+static int64_t override_changed_us = 0;
+#endif
+
+#ifdef PLANNER_MERGE_LINES
+// The last block appended, for as long as moves may be merged into it. A merge takes the block back
+// out of the buffer, restores the planner state from before it was appended and plans the block again
+// from its start to the end of the new move. The joints merged so far are kept to check that the
+// merged line stays within the tolerance of all of them.
+typedef struct {
+    bool             valid;
+    planner_t        before;
+    plan_line_data_t data;
+    float            start[MAX_N_AXIS];                        // mm
+    float            point[PLANNER_MERGE_POINTS][MAX_N_AXIS];  // Joints merged and the end of the block, mm
+    uint8_t          points;
+} plan_merge_t;
+
+static plan_merge_t merge;
+static const float  plan_merge_min_cos = cosf(PLANNER_MERGE_MAX_ANGLE * M_PI / 180.0);
+
+static bool plan_merge_compatible(const plan_line_data_t* a, const plan_line_data_t* b) {
+    if (a->motion.inverseTime || b->motion.inverseTime) {
+        return false;  // The feed rate is a time for the programmed move
+    }
+#    ifdef ENABLE_LASER_RASTER
+    if (a->raster || b->raster) {
+        return false;
+    }
+#    endif
+#    ifdef ENABLE_SPINDLE_SYNC
+    if (a->sync_pitch != 0.0 || b->sync_pitch != 0.0) {
+        return false;
+    }
+#    endif
+#    ifdef SYNC_USER_OUTPUTS
+    if (b->output_events) {
+        return false;  // The outputs switch at the start of b
+    }
+#    endif
+    return a->motion.rapidMotion == b->motion.rapidMotion && a->motion.noFeedOverride == b->motion.noFeedOverride &&
+           a->feed_rate == b->feed_rate && a->spindle_speed == b->spindle_speed && a->spindle == b->spindle &&
+           a->coolant.Mist == b->coolant.Mist && a->coolant.Flood == b->coolant.Flood;
+}
+
+// Takes the last block back out of the buffer if the move to target continues it within the merge
+// tolerance. Returns true with the prep lock held, which plan_buffer_line() releases once the merged
+// block is appended, so the stepper never sees the buffer without it.
+static bool plan_merge_last_block(const float* target, const plan_line_data_t* pl_data) {
+    if (!merge.valid || plan_batching || pl_data->motion.systemMotion || merge.points == PLANNER_MERGE_POINTS ||
+        !plan_merge_compatible(&merge.data, pl_data)) {
+        return false;
+    }
+    auto         n_axis     = motion_config.n_axis;
+    const float* end        = merge.point[merge.points - 1];
+    float        line_vec[MAX_N_AXIS];
+    float        block_sqr  = 0.0;
+    float        move_sqr   = 0.0;
+    float        line_sqr   = 0.0;
+    float        block_move = 0.0;
+    bool         steps      = false;  // The merged block has steps
+    for (uint8_t idx = 0; idx < n_axis; idx++) {
+        float block_mm = end[idx] - merge.start[idx];
+        float move_mm  = target[idx] - end[idx];
+        line_vec[idx]  = target[idx] - merge.start[idx];
+        block_sqr += block_mm * block_mm;
+        move_sqr += move_mm * move_mm;
+        line_sqr += line_vec[idx] * line_vec[idx];
+        block_move += block_mm * move_mm;
+        steps |= lround(target[idx] * motion_config.steps_per_mm[idx]) != merge.before.position[idx];
+    }
+    if (!steps || block_sqr == 0.0 || move_sqr == 0.0 || block_move < plan_merge_min_cos * sqrtf(block_sqr * move_sqr)) {
+        return false;
+    }
+    // Every joint has to lie beside the merged line, within the tolerance of it.
+    float line_length = sqrtf(line_sqr);
+    for (uint8_t n = 0; n < merge.points; n++) {
+        float along    = 0.0;
+        float away_sqr = 0.0;
+        for (uint8_t idx = 0; idx < n_axis; idx++) {
+            float offset = merge.point[n][idx] - merge.start[idx];
+            along += offset * line_vec[idx];
+            away_sqr += offset * offset;
+        }
+        along /= line_length;
+        away_sqr -= along * along;
+        if (along < 0.0 || along > line_length || away_sqr > PLANNER_MERGE_TOLERANCE * PLANNER_MERGE_TOLERANCE) {
+            return false;
+        }
+    }
+    st_prep_lock();
+    plan_index_t last = plan_prev_block_index(block_buffer_head);
+    if (block_buffer_head == block_buffer_tail || last == block_buffer_tail) {
+        st_prep_unlock();
+        merge.valid = false;  // The stepper has started on it
+        return false;
+    }
+    // The merged block has to be planned again, so the plan is no longer known to be optimal there.
+    if (block_buffer_planned == last) {
+        block_buffer_planned = plan_prev_block_index(last);
+    }
+    next_buffer_head  = block_buffer_head;
+    block_buffer_head = last;
+    pl                = merge.before;
+    plan_stats.merges++;
+    return true;
+}
+
+// Remembers the block just appended, or the move just merged into it.
+static void plan_merge_record(const float* target, const plan_line_data_t* pl_data, const planner_t* before, bool merged) {
+    if (!merged) {
+        merge.before = *before;
+        merge.data   = *pl_data;
+        merge.points = 0;
+        for (uint8_t idx = 0; idx < motion_config.n_axis; idx++) {
+            merge.start[idx] = before->position[idx] * motion_config.mm_per_step[idx];
+        }
+    }
+    memcpy(merge.point[merge.points++], target, sizeof(merge.point[0]));
+    merge.valid = true;
+}
+#endif
+
+static void MOTION_IRAM planner_recalculate(plan_index_t max_blocks, bool incremental) {
+    HOT_PATH_PROFILE(HotPath::PlanRecalculate);
     // Initialize block index to the last block in the planner buffer.
-    uint8_t block_index = plan_prev_block_index(block_buffer_head);
+    plan_index_t block_index = plan_prev_block_index(block_buffer_head);
     // Bail. Can't do anything with one only one plan-able block.
     if (block_index == block_buffer_planned) {
+        if (incremental) {
+            plan_stats.appends++;
+            plan_stats.last_touched = 0;
+        }
         return;
     }
     // Reverse Pass: Coarsely maximize all possible deceleration curves back-planning from the last
@@ -141,36 +299,49 @@ static void planner_recalculate() {
     // Calculate maximum entry speed for last block in buffer, where the exit speed is always zero.
     current->entry_speed_sqr = MIN(current->max_entry_speed_sqr, 2 * current->acceleration * current->millimeters);
     block_index              = plan_prev_block_index(block_index);
+    plan_index_t n_reversed  = 1;
     if (block_index == block_buffer_planned) {  // Only two plannable blocks in buffer. Reverse pass complete.
         // Check if the first block is the tail. If so, notify stepper to update its current parameters.
         if (block_index == block_buffer_tail) {
             st_update_plan_block_parameters();
         }
     } else {  // Three or more plan-able blocks
-        while (block_index != block_buffer_planned) {
+        while (block_index != block_buffer_planned && n_reversed < max_blocks) {
             next        = current;
             current     = &block_buffer[block_index];
             block_index = plan_prev_block_index(block_index);
+            n_reversed++;
             // Check if next block is the tail block(=planned block). If so, update current stepper parameters.
             if (block_index == block_buffer_tail) {
                 st_update_plan_block_parameters();
             }
             // Compute maximum entry speed decelerating over the current block from its exit speed.
+            entry_speed_sqr = current->max_entry_speed_sqr;
             if (current->entry_speed_sqr != current->max_entry_speed_sqr) {
                 entry_speed_sqr = next->entry_speed_sqr + 2 * current->acceleration * current->millimeters;
-                if (entry_speed_sqr < current->max_entry_speed_sqr) {
-                    current->entry_speed_sqr = entry_speed_sqr;
-                } else {
-                    current->entry_speed_sqr = current->max_entry_speed_sqr;
+                if (entry_speed_sqr > current->max_entry_speed_sqr) {
+                    entry_speed_sqr = current->max_entry_speed_sqr;
                 }
             }
+#ifdef PLANNER_INCREMENTAL_RECALC
+            // Converged. Older blocks depend only on this entry speed, so the reverse pass is complete.
+            // Resume the forward pass from this block to check its junction with the replanned blocks.
+            if (incremental && entry_speed_sqr == current->entry_speed_sqr) {
+                block_index = plan_next_block_index(block_index);
+                break;
+            }
+#endif
+            current->entry_speed_sqr = entry_speed_sqr;
         }
     }
     // Forward Pass: Forward plan the acceleration curve from the planned pointer onward.
     // Also scans for optimal plan breakpoints and appropriately updates the planned pointer.
-    next        = &block_buffer[block_buffer_planned];  // Begin at buffer planned pointer
-    block_index = plan_next_block_index(block_buffer_planned);
+    // NOTE: block_index is the planned pointer, or the oldest block that a bounded reverse pass did not reach.
+    next                   = &block_buffer[block_index];  // Begin at buffer planned pointer
+    block_index            = plan_next_block_index(block_index);
+    plan_index_t n_touched = n_reversed;
     while (block_index != block_buffer_head) {
+        n_touched++;
         current = next;
         next    = &block_buffer[block_index];
         // Any acceleration detected in the forward pass automatically moves the optimal planned
@@ -193,23 +364,132 @@ static void planner_recalculate() {
         }
         block_index = plan_next_block_index(block_index);
     }
+    if (incremental) {
+        plan_stats.appends++;
+        plan_stats.blocks_touched += n_touched;
+        plan_stats.last_touched = n_touched;
+        if (n_touched > plan_stats.max_touched) {
+            plan_stats.max_touched = n_touched;
+        }
+    }
+}
+
+plan_stats_t* plan_get_stats() {
+    return &plan_stats;
+}
+
+void plan_reset_stats() {
+    memset(&plan_stats, 0, sizeof(plan_stats_t));
+}
+
+void plan_benchmark(uint8_t client, uint32_t count) {
+    // A 10 mm radius circle in 64 lines of about 1 mm, like CAM output. Each corner turns by 5.6 degrees,
+    // a real junction to plan and more than PLANNER_MERGE_LINES merges by default.
+    const int sides = 64;
+    float     start[MAX_N_AXIS];
+    float     corner[sides][2];
+    int32_t   position[MAX_N_AXIS];
+    system_get_position(position);
+    system_convert_array_steps_to_mpos(start, position);
+    for (int n = 0; n < sides; n++) {
+        float angle  = n * (2.0f * float(M_PI) / sides);
+        corner[n][0] = start[X_AXIS] + 10.0f * (cosf(angle) - 1.0f);
+        corner[n][1] = start[Y_AXIS] + 10.0f * sinf(angle);
+    }
+    plan_line_data_t pl_data;
+    memset(&pl_data, 0, sizeof(plan_line_data_t));
+    pl_data.feed_rate = 1000.0f;
+    float target[MAX_N_AXIS];
+    memcpy(target, start, sizeof(target));
+
+    plan_reset();
+    plan_sync_position();
+    uint32_t touched = plan_stats.blocks_touched;
+    int64_t  t0      = esp_timer_get_time();
+    for (uint32_t i = 0; i < count; i++) {
+        if (plan_check_full_buffer()) {
+            plan_discard_current_block();
+        }
+        target[X_AXIS] = corner[(i + 1) % sides][0];
+        target[Y_AXIS] = corner[(i + 1) % sides][1];
+        plan_buffer_line(target, &pl_data);
+    }
+    int64_t elapsed = esp_timer_get_time() - t0;
+    touched         = plan_stats.blocks_touched - touched;
+    plan_reset();
+    plan_sync_position();
+    grbl_sendf(client,
+               "[MSG: Planner blocks:%u time:%.2f us/block rate:%.0f blocks/s touched:%4.2f]\r\n",
+               count,
+               float(elapsed) / count,
+               elapsed ? count * 1000000.0f / elapsed : 0.0f,
+               float(touched) / count);
+}
+
+#ifdef PLANNER_USE_PSRAM
+// heap_caps_calloc() only aligns to 4 bytes, so one more line is taken to start the first block on one.
+static plan_block_t* plan_alloc_buffer(uint32_t caps) {
+    uintptr_t buffer = (uintptr_t)heap_caps_calloc(1, BLOCK_BUFFER_SIZE * sizeof(plan_block_t) + PLAN_BLOCK_ALIGNMENT, caps);
+    if (!buffer) {
+        return NULL;
+    }
+    return (plan_block_t*)((buffer + PLAN_BLOCK_ALIGNMENT - 1) & ~uintptr_t(PLAN_BLOCK_ALIGNMENT - 1));
+}
+#endif
+
+void plan_init() {
+    if (block_buffer != NULL) {
+        return;
+    }
+#ifdef PLANNER_USE_PSRAM
+    const char* location = "PSRAM";
+    if (psramFound()) {
+        block_buffer = plan_alloc_buffer(MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    }
+    if (block_buffer == NULL) {
+        // No PSRAM on this board, so fall back to internal RAM.
+        location     = "RAM";
+        block_buffer = plan_alloc_buffer(MALLOC_CAP_8BIT);
+    }
+    if (block_buffer == NULL) {
+        grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Error, "Planner buffer allocation failed");
+        return;
+    }
+#else
+    const char* location = "RAM";
+    block_buffer         = block_buffer_storage;
+#endif
+    grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Planner blocks %d in %s", BLOCK_BUFFER_SIZE, location);
 }
 
 void plan_reset() {
     memset(&pl, 0, sizeof(planner_t));  // Clear planner struct
+#ifdef SPINDLE_STATE_IN_PLANNER
+    state_deferred = false;
+#endif
+    plan_batching = false;  // A reset in the middle of an arc ends its batch
     plan_reset_buffer();
 }
 
 void plan_reset_buffer() {
+    st_prep_lock();
     block_buffer_tail    = 0;
     block_buffer_head    = 0;  // Empty = tail
     next_buffer_head     = 1;  // plan_next_block_index(block_buffer_head)
     block_buffer_planned = 0;  // = block_buffer_tail;
+    plan_deferred        = 0;  // Its blocks are gone
+#ifdef PLANNER_MERGE_LINES
+    merge.valid = false;
+#endif
+#ifdef SYNC_USER_OUTPUTS
+    sys_output_events_reset(false);  // The blocks that carried them are gone
+#endif
+    st_prep_unlock();
 }
 
 void plan_discard_current_block() {
     if (block_buffer_head != block_buffer_tail) {  // Discard non-empty buffer.
-        uint8_t block_index = plan_next_block_index(block_buffer_tail);
+        plan_index_t block_index = plan_next_block_index(block_buffer_tail);
         // Push block_buffer_planned pointer, if encountered.
         if (block_buffer_tail == block_buffer_planned) {
             block_buffer_planned = block_index;
@@ -232,13 +512,32 @@ plan_block_t* plan_get_current_block() {
 }
 
 float plan_get_exec_block_exit_speed_sqr() {
-    uint8_t block_index = plan_next_block_index(block_buffer_tail);
+    plan_index_t block_index = plan_next_block_index(block_buffer_tail);
     if (block_index == block_buffer_head) {
         return 0.0f;
     }
     return block_buffer[block_index].entry_speed_sqr;
 }
 
+// True when the exit speed of the executing block is set by the stop at the end of the buffered blocks
+// rather than by a junction, a nominal speed or the acceleration before it, so a deeper planner buffer
+// would let it run faster.
+bool plan_exec_block_exit_limited_by_depth() {
+    plan_index_t  block_index = plan_prev_block_index(block_buffer_head);
+    plan_block_t* block       = NULL;
+    float         stop_sqr    = 0.0f;  // Entry speed squared from which the blocks after can just stop
+    while (block_index != block_buffer_tail) {
+        block = &block_buffer[block_index];
+        stop_sqr += 2 * block->acceleration * block->millimeters;
+        if (stop_sqr >= block->max_entry_speed_sqr) {
+            return false;
+        }
+        block_index = plan_prev_block_index(block_index);
+    }
+    // block follows the executing one. The forward pass may have held its entry below the stop speed.
+    return block == NULL || block->entry_speed_sqr >= 0.99f * stop_sqr;
+}
+
 // Returns the availability status of the block ring buffer. True, if full.
 uint8_t plan_check_full_buffer() {
     return block_buffer_tail == next_buffer_head;
@@ -246,13 +545,13 @@ uint8_t plan_check_full_buffer() {
 
 // Computes and returns block nominal speed based on running condition and override values.
 // NOTE: All system motion commands, such as homing/parking, are not subject to overrides.
-float plan_compute_profile_nominal_speed(plan_block_t* block) {
+float MOTION_IRAM plan_compute_profile_nominal_speed(plan_block_t* block) {
     float nominal_speed = block->programmed_rate;
     if (block->motion.rapidMotion) {
-        nominal_speed *= (0.01 * sys.r_override);
+        nominal_speed *= (0.01f * sys.r_override);
     } else {
         if (!(block->motion.noFeedOverride)) {
-            nominal_speed *= (0.01 * sys.f_override);
+            nominal_speed *= (0.01f * sys.f_override);
         }
         if (nominal_speed > block->rapid_rate) {
             nominal_speed = block->rapid_rate;
@@ -266,7 +565,7 @@ float plan_compute_profile_nominal_speed(plan_block_t* block) {
 
 // Computes and updates the max entry speed (sqr) of the block, based on the minimum of the junction's
 // previous and current nominal speeds and max junction speed.
-static void plan_compute_profile_parameters(plan_block_t* block, float nominal_speed, float prev_nominal_speed) {
+static void MOTION_IRAM plan_compute_profile_parameters(plan_block_t* block, float nominal_speed, float prev_nominal_speed) {
     // Compute the junction maximum entry based on the minimum of the junction speed and neighboring nominal speeds.
     if (nominal_speed > prev_nominal_speed) {
         block->max_entry_speed_sqr = prev_nominal_speed * prev_nominal_speed;
@@ -281,10 +580,11 @@ static void plan_compute_profile_parameters(plan_block_t* block, float nominal_s
 
 // Re-calculates buffered motions profile parameters upon a motion-based override change.
 void plan_update_velocity_profile_parameters() {
-    uint8_t       block_index = block_buffer_tail;
+    plan_index_t  block_index = block_buffer_tail;
     plan_block_t* block;
     float         nominal_speed;
     float         prev_nominal_speed = SOME_LARGE_VALUE;  // Set high for first block nominal speed calculation.
+    st_prep_lock();
     while (block_index != block_buffer_head) {
         block         = &block_buffer[block_index];
         nominal_speed = plan_compute_profile_nominal_speed(block);
@@ -292,11 +592,31 @@ void plan_update_velocity_profile_parameters() {
         prev_nominal_speed = nominal_speed;
         block_index        = plan_next_block_index(block_index);
     }
+    st_prep_unlock();
     pl.previous_nominal_speed = prev_nominal_speed;  // Update prev nominal speed for next incoming block.
 }
 
-uint8_t plan_buffer_line(float* target, plan_line_data_t* pl_data) {
+#ifdef USE_KINEMATICS
+// The planner works in machine coordinates while sys_position counts joint steps.
+static void plan_convert_sys_position(int32_t* position_steps) {
+    float mpos[MAX_N_AXIS];
+    system_convert_array_steps_to_mpos(mpos, sys_position);
+    auto n_axis = motion_config.n_axis;
+    for (uint8_t idx = 0; idx < n_axis; idx++) {
+        position_steps[idx] = lround(mpos[idx] * motion_config.steps_per_mm[idx]);
+    }
+}
+#endif
+
+uint8_t MOTION_IRAM plan_buffer_line(float* target, plan_line_data_t* pl_data) {
+    HOT_PATH_PROFILE(HotPath::PlanBufferLine);
+    uint32_t start_cycles = xthal_get_ccount();
     // Prepare and initialize new block. Copy relevant pl_data for block execution.
+    motion_config_refresh();
+#ifdef PLANNER_MERGE_LINES
+    bool      merging = plan_merge_last_block(target, pl_data);
+    planner_t before  = pl;
+#endif
     plan_block_t* block = &block_buffer[block_buffer_head];
     memset(block, 0, sizeof(plan_block_t));  // Zero all block values.
     block->motion        = pl_data->motion;
@@ -306,6 +626,16 @@ uint8_t plan_buffer_line(float* target, plan_line_data_t* pl_data) {
 
 #ifdef USE_LINE_NUMBERS
     block->line_number = pl_data->line_number;
+#endif
+#ifdef SD_CHECKPOINT
+    block->sd_line = pl_data->sd_line;
+#    ifdef PLANNER_MERGE_LINES
+    if (merging) {
+        // The block starts at the first line merged into it. A checkpoint on it must not mark the
+        // lines after that one done while the steppers are still on their moves.
+        block->sd_line = merge.data.sd_line;
+    }
+#    endif
 #endif
     // Compute and store initial move distance data.
     int32_t target_steps[MAX_N_AXIS], position_steps[MAX_N_AXIS];
@@ -313,49 +643,53 @@ uint8_t plan_buffer_line(float* target, plan_line_data_t* pl_data) {
     uint8_t idx;
     // Copy position data based on type of motion being planned.
     if (block->motion.systemMotion) {
-#ifdef COREXY
-        position_steps[X_AXIS] = system_convert_corexy_to_x_axis_steps(sys_position);
-        position_steps[Y_AXIS] = system_convert_corexy_to_y_axis_steps(sys_position);
-        position_steps[Z_AXIS] = sys_position[Z_AXIS];
+#ifdef USE_KINEMATICS
+        plan_convert_sys_position(position_steps);
 #else
         memcpy(position_steps, sys_position, sizeof(sys_position));
+        if (motion_config.corexy) {
+            position_steps[X_AXIS] = system_convert_corexy_to_x_axis_steps(sys_position);
+            position_steps[Y_AXIS] = system_convert_corexy_to_y_axis_steps(sys_position);
+        }
 #endif
     } else {
         memcpy(position_steps, pl.position, sizeof(pl.position));
     }
-#ifdef COREXY
-    target_steps[A_MOTOR] = lround(target[A_MOTOR] * axis_settings[A_MOTOR]->steps_per_mm->get());
-    target_steps[B_MOTOR] = lround(target[B_MOTOR] * axis_settings[B_MOTOR]->steps_per_mm->get());
-    block->steps[A_MOTOR] = labs((target_steps[X_AXIS] - position_steps[X_AXIS]) + (target_steps[Y_AXIS] - position_steps[Y_AXIS]));
-    block->steps[B_MOTOR] = labs((target_steps[X_AXIS] - position_steps[X_AXIS]) - (target_steps[Y_AXIS] - position_steps[Y_AXIS]));
-#endif
-    auto n_axis = number_axis->get();
+    int32_t delta_steps[MAX_N_AXIS];
+    auto    n_axis = motion_config.n_axis;
     for (idx = 0; idx < n_axis; idx++) {
-        // Calculate target position in absolute steps, number of steps for each axis, and determine max step events.
-        // Also, compute individual axes distance for move and prep unit vector calculations.
-        // NOTE: Computes true distance from converted step values.
-#ifdef COREXY
-        if (!(idx == A_MOTOR) && !(idx == B_MOTOR)) {
-            target_steps[idx] = lround(target[idx] * axis_settings[idx]->steps_per_mm->get());
-            block->steps[idx] = labs(target_steps[idx] - position_steps[idx]);
-        }
-        block->step_event_count = MAX(block->step_event_count, block->steps[idx]);
-        if (idx == A_MOTOR) {
-            delta_mm = (target_steps[X_AXIS] - position_steps[X_AXIS] + target_steps[Y_AXIS] - position_steps[Y_AXIS]) /
-                       axis_settings[idx]->steps_per_mm->get();
-        } else if (idx == B_MOTOR) {
-            delta_mm = (target_steps[X_AXIS] - position_steps[X_AXIS] - target_steps[Y_AXIS] + position_steps[Y_AXIS]) /
-                       axis_settings[idx]->steps_per_mm->get();
+        target_steps[idx] = lround(target[idx] * motion_config.steps_per_mm[idx]);
+        delta_steps[idx]  = target_steps[idx] - position_steps[idx];
+    }
+#ifdef ENABLE_AUX_STREAM
+    // The auxiliary axis runs from its own stream. Only jogs and system motion move it with the other axes.
+    if (!block->motion.systemMotion && AUX_STREAM_AXIS < n_axis) {
+        if (block->motion.jogMotion) {
+            position_steps[AUX_STREAM_AXIS] = aux_stream_target();
         } else {
-            delta_mm = (target_steps[idx] - position_steps[idx]) / axis_settings[idx]->steps_per_mm->get();
+            target_steps[AUX_STREAM_AXIS] = position_steps[AUX_STREAM_AXIS];
         }
-#else
-        target_steps[idx]       = lround(target[idx] * axis_settings[idx]->steps_per_mm->get());
-        block->steps[idx]       = labs(target_steps[idx] - position_steps[idx]);
+        delta_steps[AUX_STREAM_AXIS] = target_steps[AUX_STREAM_AXIS] - position_steps[AUX_STREAM_AXIS];
+    }
+#endif
+    // Mix X and Y onto the A and B motors once for the whole block. The stepper only sees motor steps.
+    if (motion_config.corexy) {
+        int32_t delta_x      = delta_steps[X_AXIS];
+        int32_t delta_y      = delta_steps[Y_AXIS];
+        delta_steps[A_MOTOR] = delta_x + delta_y;
+        delta_steps[B_MOTOR] = delta_x - delta_y;
+    }
+    for (idx = 0; idx < n_axis; idx++) {
+        // Calculate number of steps for each motor and determine max step events. Also, compute individual
+        // motor distance for move and prep unit vector calculations.
+        // NOTE: Computes true distance from converted step values.
+        block->steps[idx]       = labs(delta_steps[idx]);
         block->step_event_count = MAX(block->step_event_count, block->steps[idx]);
-        delta_mm                = (target_steps[idx] - position_steps[idx]) / axis_settings[idx]->steps_per_mm->get();
+        delta_mm                = delta_steps[idx] * motion_config.mm_per_step[idx];
+        unit_vec[idx]           = delta_mm;  // Store unit vector numerator
+#ifdef USE_KINEMATICS
+        block->target[idx] = target_steps[idx] * motion_config.mm_per_step[idx];
 #endif
-        unit_vec[idx] = delta_mm;  // Store unit vector numerator
         // Set direction bits. Bit enabled always means direction is negative.
         if (delta_mm < 0.0) {
             block->direction_bits |= get_direction_pin_mask(idx);
@@ -363,16 +697,55 @@ uint8_t plan_buffer_line(float* target, plan_line_data_t* pl_data) {
     }
     // Bail if this is a zero-length block. Highly unlikely to occur.
     if (block->step_event_count == 0) {
+#ifdef PLANNER_MERGE_LINES
+        if (merging) {
+            st_prep_unlock();  // Not reached, a merge is only done when the merged block has steps
+        }
+#endif
+        plan_stats.cycles += xthal_get_ccount() - start_cycles;
         return PLAN_EMPTY_BLOCK;
     }
+#ifdef ENABLE_LASER_RASTER
+    // The block takes the scanline over and clears it in pl_data. A scanline shorter than a step is
+    // left to the caller, which frees it.
+    if (pl_data->raster && block->steps[pl_data->raster->axis] != 0) {
+        block->raster = pl_data->raster;
+        raster_planned(block->raster, block->steps[block->raster->axis]);
+        pl_data->raster = NULL;
+    }
+#endif
+#ifdef ENABLE_SPINDLE_SYNC
+    block->sync_pitch   = pl_data->sync_pitch;
+    block->sync_start   = pl_data->sync_start;
+    pl_data->sync_start = false;
+#endif
+#ifdef SYNC_USER_OUTPUTS
+    // The block takes the events queued before it over. A merged block stands in for the last block and
+    // keeps its events; a move with events of its own is never merged.
+    block->output_events = pl_data->output_events;
+#    ifdef PLANNER_MERGE_LINES
+    if (merging) {
+        block->output_events = merge.data.output_events;
+    }
+#    endif
+    sys_output_events_attach(pl_data->output_events);
+    pl_data->output_events = 0;
+#endif
 
     // Calculate the unit vector of the line move and the block maximum feed rate and acceleration scaled
     // down such that no individual axes maximum values are exceeded with respect to the line direction.
     // NOTE: This calculation assumes all axes are orthogonal (Cartesian) and works with ABC-axes,
     // if they are also orthogonal/independent. Operates on the absolute value of the unit vector.
     block->millimeters  = convert_delta_vector_to_unit_vector(unit_vec);
+#ifdef USE_KINEMATICS
+    block->kinematic = !kinematics_joint_motion();
+    memcpy(block->unit_vec, unit_vec, sizeof(unit_vec));
+#endif
     block->acceleration = limit_acceleration_by_axis_maximum(unit_vec);
     block->rapid_rate   = limit_rate_by_axis_maximum(unit_vec);
+#ifdef JERK_LIMITED_PROFILE
+    block->jerk = limit_jerk_by_axis_maximum(unit_vec);
+#endif
     // Store programmed rate.
     if (block->motion.rapidMotion) {
         block->programmed_rate = block->rapid_rate;
@@ -417,20 +790,22 @@ uint8_t plan_buffer_line(float* target, plan_line_data_t* pl_data) {
             junction_unit_vec[idx] = unit_vec[idx] - pl.previous_unit_vec[idx];
         }
         // NOTE: Computed without any expensive trig, sin() or acos(), by trig half angle identity of cos(theta).
-        if (junction_cos_theta > 0.999999) {
+        // NOTE: MINIMUM_JUNCTION_SPEED is a double. Keep it out of the float math below, which the ESP32
+        // FPU does in hardware while doubles go through software routines.
+        const float min_junction_speed_sqr = MINIMUM_JUNCTION_SPEED * MINIMUM_JUNCTION_SPEED;
+        if (junction_cos_theta > 0.999999f) {
             //  For a 0 degree acute junction, just set minimum junction speed.
-            block->max_junction_speed_sqr = MINIMUM_JUNCTION_SPEED * MINIMUM_JUNCTION_SPEED;
+            block->max_junction_speed_sqr = min_junction_speed_sqr;
         } else {
-            if (junction_cos_theta < -0.999999) {
+            if (junction_cos_theta < -0.999999f) {
                 // Junction is a straight line or 180 degrees. Junction speed is infinite.
                 block->max_junction_speed_sqr = SOME_LARGE_VALUE;
             } else {
                 convert_delta_vector_to_unit_vector(junction_unit_vec);
                 float junction_acceleration = limit_acceleration_by_axis_maximum(junction_unit_vec);
-                float sin_theta_d2          = sqrt(0.5 * (1.0 - junction_cos_theta));  // Trig half angle identity. Always positive.
+                float sin_theta_d2          = sqrtf(0.5f * (1.0f - junction_cos_theta));  // Trig half angle identity. Always positive.
                 block->max_junction_speed_sqr =
-                    MAX(MINIMUM_JUNCTION_SPEED * MINIMUM_JUNCTION_SPEED,
-                        (junction_acceleration * junction_deviation->get() * sin_theta_d2) / (1.0 - sin_theta_d2));
+                    MAX(min_junction_speed_sqr, (junction_acceleration * motion_config.junction_deviation * sin_theta_d2) / (1.0f - sin_theta_d2));
             }
         }
     }
@@ -442,38 +817,93 @@ uint8_t plan_buffer_line(float* target, plan_line_data_t* pl_data) {
         // Update previous path unit_vector and planner position.
         memcpy(pl.previous_unit_vec, unit_vec, sizeof(unit_vec));  // pl.previous_unit_vec[] = unit_vec[]
         memcpy(pl.position, target_steps, sizeof(target_steps));   // pl.position[] = target_steps[]
+#ifdef ENABLE_AUX_STREAM
+        if (block->motion.jogMotion && AUX_STREAM_AXIS < n_axis) {
+            aux_stream_jogged(target_steps[AUX_STREAM_AXIS]);
+        }
+#endif
+#ifdef SPINDLE_STATE_IN_PLANNER
+        // The first move after a deferred change switches the spindle and coolant. mc_line() hands the
+        // switch over in pl_data. A merged block keeps the switch of the block it extends.
+#    ifdef PLANNER_MERGE_LINES
+        if (merging && merge.data.motion.applyState) {
+            block->motion.applyState = 1;
+        }
+#    endif
+#endif
+#ifdef PLANNER_MERGE_LINES
+        plan_merge_record(target, pl_data, &before, merging);
+#    ifdef SYNC_USER_OUTPUTS
+        merge.data.output_events = block->output_events;  // pl_data has handed them to the block
+#    endif
+#    ifdef SPINDLE_STATE_IN_PLANNER
+        merge.data.motion.applyState = block->motion.applyState;
+#    endif
+#endif
         // New block is all set. Update buffer head and next buffer head indices.
+        st_prep_lock();
         block_buffer_head = next_buffer_head;
         next_buffer_head  = plan_next_block_index(block_buffer_head);
-        // Finish up by recalculating the plan with the new block.
-        planner_recalculate();
+        // Finish up by recalculating the plan with the new block, unless it is part of a batch.
+        if (plan_batching) {
+            plan_deferred++;
+        } else {
+            planner_recalculate(PLANNER_RECALC_LIMIT, true);
+        }
+        st_prep_unlock();
+#ifdef PLANNER_MERGE_LINES
+        if (merging) {
+            st_prep_unlock();  // Taken by plan_merge_last_block()
+        }
+#endif
     }
+    plan_stats.cycles += xthal_get_ccount() - start_cycles;
     return PLAN_OK;
 }
 
+void plan_begin_batch() {
+    plan_batching = true;
+}
+
+void plan_flush_batch() {
+    if (plan_deferred) {
+        st_prep_lock();
+        // The deferred blocks have no entry speeds yet, so the reverse pass must reach past all of them.
+        planner_recalculate(MIN(plan_deferred + PLANNER_RECALC_LIMIT, BLOCK_BUFFER_SIZE), true);
+        plan_deferred = 0;
+        st_prep_unlock();
+    }
+}
+
+void plan_end_batch() {
+    plan_flush_batch();
+    plan_batching = false;
+}
+
 // Reset the planner position vectors. Called by the system abort/initialization routine.
 void plan_sync_position() {
-    // TODO: For motor configurations not in the same coordinate frame as the machine position,
-    // this function needs to be updated to accomodate the difference.
-    uint8_t idx;
-    auto n_axis = number_axis->get();
-    for (idx = 0; idx < n_axis; idx++) {
-#ifdef COREXY
-        if (idx == X_AXIS) {
-            pl.position[X_AXIS] = system_convert_corexy_to_x_axis_steps(sys_position);
-        } else if (idx == Y_AXIS) {
-            pl.position[Y_AXIS] = system_convert_corexy_to_y_axis_steps(sys_position);
-        } else {
-            pl.position[idx] = sys_position[idx];
-        }
-#else
-        pl.position[idx]        = sys_position[idx];
+#ifdef PLANNER_MERGE_LINES
+    merge.valid = false;  // The next block starts somewhere else
 #endif
+#ifdef ENABLE_HEIGHT_MAP
+    height_map_sync();
+#endif
+#ifdef USE_KINEMATICS
+    plan_convert_sys_position(pl.position);
+#else
+    memcpy(pl.position, sys_position, sizeof(sys_position));
+    if (motion_config.corexy) {
+        pl.position[X_AXIS] = system_convert_corexy_to_x_axis_steps(sys_position);
+        pl.position[Y_AXIS] = system_convert_corexy_to_y_axis_steps(sys_position);
     }
+#endif
+#ifdef ENABLE_AUX_STREAM
+    aux_stream_sync_position();
+#endif
 }
 
 // Returns the number of available blocks are in the planner buffer.
-uint8_t plan_get_block_buffer_available() {
+plan_index_t plan_get_block_buffer_available() {
     if (block_buffer_head >= block_buffer_tail) {
         return (BLOCK_BUFFER_SIZE - 1) - (block_buffer_head - block_buffer_tail);
     } else {
@@ -483,7 +913,7 @@ uint8_t plan_get_block_buffer_available() {
 
 // Returns the number of active blocks are in the planner buffer.
 // NOTE: Deprecated. Not used unless classic status reports are enabled in config.h
-uint8_t plan_get_block_buffer_count() {
+plan_index_t plan_get_block_buffer_count() {
     if (block_buffer_head >= block_buffer_tail) {
         return block_buffer_head - block_buffer_tail;
     } else {
@@ -495,7 +925,54 @@ uint8_t plan_get_block_buffer_count() {
 // Called after a steppers have come to a complete stop for a feed hold and the cycle is stopped.
 void plan_cycle_reinitialize() {
     // Re-plan from a complete stop. Reset planner entry speeds and buffer planned pointer.
+    st_prep_lock();
     st_update_plan_block_parameters();
     block_buffer_planned = block_buffer_tail;
-    planner_recalculate();
+    planner_recalculate(BLOCK_BUFFER_SIZE, false);  // Replan the whole buffer from the new entry speed.
+    st_prep_unlock();
 }
+
+#ifdef PLANNER_LAZY_OVERRIDES
+// The executing block is cheap to redo: the segment generator recomputes its profile with the new
+// nominal speed from the current speed. The other blocks are safe to run as planned meanwhile. A raised
+// override only leaves them slower than they could be, and the segment generator slows a block down
+// when it loads one planned faster than the new nominal speed.
+void plan_override_changed() {
+    st_prep_lock();
+    st_update_plan_block_parameters();
+    st_prep_unlock();
+    override_stale      = true;
+    override_changed_us = esp_timer_get_time();
+}
+
+void plan_replan_overrides() {
+    if (!override_stale || esp_timer_get_time() - override_changed_us < PLANNER_OVERRIDE_SETTLE_MS * 1000LL) {
+        return;
+    }
+    override_stale = false;
+    plan_update_velocity_profile_parameters();
+    plan_cycle_reinitialize();
+}
+#endif
+
+#ifdef SPINDLE_STATE_IN_PLANNER
+void plan_defer_state() { state_deferred = true; }
+
+bool plan_take_deferred_state() {
+    bool deferred  = state_deferred;
+    state_deferred = false;
+    return deferred;
+}
+
+void plan_apply_deferred_state() {
+    if (!state_deferred) {
+        return;
+    }
+    state_deferred = false;
+    if (spindle->state_in_planner()) {
+        // Lasers only fire while moving.
+        spindle->set_state(gc_state.modal.spindle, spindle->isRateAdjusted() ? 0 : (uint32_t)gc_state.spindle_speed);
+    }
+    coolant_set_state(gc_state.modal.coolant);
+}
+#endif
@@ -33,6 +33,50 @@
 #    endif
 #endif
 
+static_assert(BLOCK_BUFFER_SIZE >= 2 && BLOCK_BUFFER_SIZE <= 1024, "BLOCK_BUFFER_SIZE must be between 2 and 1024");
+
+// The maximum number of blocks planner_recalculate() walks back from the head when a new block is
+// appended. This bounds the cost of plan_buffer_line() with deep planner buffers. Feed holds and
+// override changes always replan the whole buffer.
+#ifndef PLANNER_RECALC_LIMIT
+#    define PLANNER_RECALC_LIMIT 32
+#endif
+
+// How long feed and rapid overrides must stay unchanged before the buffer is replanned for them.
+// See PLANNER_LAZY_OVERRIDES in Config.h.
+#ifndef PLANNER_OVERRIDE_SETTLE_MS
+#    define PLANNER_OVERRIDE_SETTLE_MS 100
+#endif
+
+// Largest distance of a merged joint from the line of the merged block (mm), largest turn of a merged
+// joint (degrees), and most moves merged into one block. See PLANNER_MERGE_LINES in Config.h.
+#ifndef PLANNER_MERGE_TOLERANCE
+#    define PLANNER_MERGE_TOLERANCE 0.002
+#endif
+#ifndef PLANNER_MERGE_MAX_ANGLE
+#    define PLANNER_MERGE_MAX_ANGLE 5.0
+#endif
+#ifndef PLANNER_MERGE_POINTS
+#    define PLANNER_MERGE_POINTS 8
+#endif
+
+#ifdef ENABLE_LASER_RASTER
+struct raster_line_t;
+#endif
+
+// Index into the planner ring buffer. Wide enough for planner buffers deeper than 255 blocks.
+typedef uint16_t plan_index_t;
+
+// Counters for the work planner_recalculate() does each time a block is appended.
+typedef struct {
+    uint32_t     appends;         // Blocks appended since the last reset
+    uint32_t     blocks_touched;  // Blocks visited by the reverse and forward passes over all appends
+    plan_index_t last_touched;    // Blocks visited by the most recent append
+    plan_index_t max_touched;     // Worst case for a single append
+    uint64_t     cycles;          // CPU cycles spent in plan_buffer_line()
+    uint32_t     merges;          // Moves merged into the block before them, see PLANNER_MERGE_LINES
+} plan_stats_t;
+
 // Returned status message from planner.
 const int PLAN_OK          = true;
 const int PLAN_EMPTY_BLOCK = false;
@@ -43,14 +87,37 @@ struct PlMotion {
     uint8_t systemMotion : 1;    // Single motion. Circumvents planner state. Used by home/park.
     uint8_t noFeedOverride : 1;  // Motion does not honor feed override.
     uint8_t inverseTime : 1;     // Interprets feed rate value as inverse time when set.
+    uint8_t applyState : 1;      // Switches spindle and coolant to the block state when it starts.
+    uint8_t jogMotion : 1;       // Jog motion. Planned by the parser task, never queued to the motion task.
 };
 
+// Blocks in PSRAM are read through the cache, 32 byte lines. Each block starts on a line there, so a
+// recalculation pass reads one line per block. Internal RAM has no cache and no padding is added.
+#ifdef PLANNER_USE_PSRAM
+#    define PLAN_BLOCK_ALIGNMENT 32
+#else
+#    define PLAN_BLOCK_ALIGNMENT 4
+#endif
+
 // This struct stores a linear movement of a g-code block motion with its critical "nominal" values
-// are as specified in the source g-code.
-typedef struct {
+// are as specified in the source g-code. The fields come in the order they are needed: those of every
+// recalculation pass and every segment first, those read when the segment prep loads the block next,
+// and those only used by overrides, reports and optional features last.
+typedef struct __attribute__((aligned(PLAN_BLOCK_ALIGNMENT))) {
+    // Fields used by the motion planner to manage acceleration. Some of these values may be updated
+    // by the stepper module during execution of special motion cases for replanning purposes.
+    float entry_speed_sqr;      // The current planned entry speed at block junction in (mm/min)^2
+    float max_entry_speed_sqr;  // Maximum allowable entry speed based on the minimum of junction limit and
+    //   neighboring nominal speeds with overrides in (mm/min)^2
+    float acceleration;  // Axis-limit adjusted line acceleration in (mm/min^2). Does not change.
+    float millimeters;   // The remaining distance for this block to be executed in (mm).
+    // NOTE: This value may be altered by stepper algorithm during execution.
+#ifdef JERK_LIMITED_PROFILE
+    float jerk;  // Axis-limit adjusted line jerk in (mm/min^3), 0 for linear ramps. Does not change.
+#endif
+
     // Fields used by the bresenham algorithm for tracing the line
     // NOTE: Used by stepper algorithm to execute the block correctly. Do not alter these values.
-    uint32_t steps[MAX_N_AXIS];     // Step count along each axis
     uint32_t step_event_count;  // The maximum step axis count and number of steps required to complete this block.
     uint8_t  direction_bits;    // The direction bit set for this block (refers to *_DIRECTION_BIT in config.h)
 
@@ -58,18 +125,8 @@ typedef struct {
     PlMotion     motion;   // Block bitflag motion conditions. Copied from pl_line_data.
     SpindleState spindle;  // Spindle enable state
     CoolantState coolant;  // Coolant state
-#ifdef USE_LINE_NUMBERS
-    int32_t line_number;  // Block line number for real-time reporting. Copied from pl_line_data.
-#endif
 
-    // Fields used by the motion planner to manage acceleration. Some of these values may be updated
-    // by the stepper module during execution of special motion cases for replanning purposes.
-    float entry_speed_sqr;      // The current planned entry speed at block junction in (mm/min)^2
-    float max_entry_speed_sqr;  // Maximum allowable entry speed based on the minimum of junction limit and
-    //   neighboring nominal speeds with overrides in (mm/min)^2
-    float acceleration;  // Axis-limit adjusted line acceleration in (mm/min^2). Does not change.
-    float millimeters;   // The remaining distance for this block to be executed in (mm).
-    // NOTE: This value may be altered by stepper algorithm during execution.
+    uint32_t steps[MAX_N_AXIS];  // Step count along each axis
 
     // Stored rate limiting data used by planner when changes occur.
     float max_junction_speed_sqr;  // Junction entry speed limit based on direction vectors in (mm/min)^2
@@ -78,7 +135,30 @@ typedef struct {
 
     // Stored spindle speed data used by spindle overrides and resuming methods.
     float spindle_speed;  // Block spindle speed. Copied from pl_line_data.
-    //#endif
+
+#ifdef USE_LINE_NUMBERS
+    int32_t line_number;  // Block line number for real-time reporting. Copied from pl_line_data.
+#endif
+#ifdef SD_CHECKPOINT
+    uint32_t sd_line;  // Line of the SD job that planned the block, 0 outside of jobs. Copied from pl_line_data.
+#endif
+
+#ifdef USE_KINEMATICS
+    // The stepper prep converts the block to joint motion per segment, from the distance still to go.
+    bool  kinematic;             // False for joint space motion (homing). steps[] are then joint steps.
+    float target[MAX_N_AXIS];    // Machine position at the end of the block (mm)
+    float unit_vec[MAX_N_AXIS];  // Direction of travel
+#endif
+#ifdef ENABLE_LASER_RASTER
+    raster_line_t* raster;  // Scanline executed by this block, or NULL. Copied from pl_line_data.
+#endif
+#ifdef ENABLE_SPINDLE_SYNC
+    float sync_pitch;  // mm per spindle revolution of a synchronized block, 0 otherwise
+    bool  sync_start;  // First block of a synchronized chain
+#endif
+#ifdef SYNC_USER_OUTPUTS
+    uint8_t output_events;  // Synchronized output events the step ISR fires when the block starts
+#endif
 } plan_block_t;
 
 // Planner data prototype. Must be used when passing new motions to the planner.
@@ -91,8 +171,24 @@ typedef struct {
 #ifdef USE_LINE_NUMBERS
     int32_t line_number;  // Desired line number to report when executing.
 #endif
+#ifdef SD_CHECKPOINT
+    uint32_t sd_line;  // Set by mc_line()
+#endif
+#ifdef ENABLE_LASER_RASTER
+    raster_line_t* raster;  // Scanline whose pixels set the laser power along the move, or NULL
+#endif
+#ifdef ENABLE_SPINDLE_SYNC
+    float sync_pitch;  // Distance per spindle revolution of a G33 move, 0 otherwise
+    bool  sync_start;  // Starts a synchronized chain. Cleared by the planner once the block is planned.
+#endif
+#ifdef SYNC_USER_OUTPUTS
+    uint8_t output_events;  // Queued M62-M65/M67 events to fire at the start of the move. Cleared once planned.
+#endif
 } plan_line_data_t;
 
+// Allocate the planner buffer. Called once at startup.
+void plan_init();
+
 // Initialize and reset the motion plan subsystem
 void plan_reset();         // Reset all
 void plan_reset_buffer();  // Reset buffer only.
@@ -102,6 +198,13 @@ void plan_reset_buffer();  // Reset buffer only.
 // rate is taken to mean "frequency" and would complete the operation in 1/feed_rate minutes.
 uint8_t plan_buffer_line(float* target, plan_line_data_t* pl_data);
 
+// Batches blocks from plan_buffer_line() so a burst of short blocks, like arc segments, is planned with
+// one recalculation pass. Until the batch is flushed the new blocks are planned to stop, which is safe
+// if the stepper reaches them early. mc_line() flushes before waiting on a full planner.
+void plan_begin_batch();
+void plan_flush_batch();
+void plan_end_batch();
+
 // Called when the current block is no longer needed. Discards the block and makes the memory
 // availible for new blocks.
 void plan_discard_current_block();
@@ -113,11 +216,14 @@ plan_block_t* plan_get_system_motion_block();
 plan_block_t* plan_get_current_block();
 
 // Called periodically by step segment buffer. Mostly used internally by planner.
-uint8_t plan_next_block_index(uint8_t block_index);
+plan_index_t plan_next_block_index(plan_index_t block_index);
 
 // Called by step segment buffer when computing executing block velocity profile.
 float plan_get_exec_block_exit_speed_sqr();
 
+// True when the exit speed of the executing block is held down by the stop at the end of the buffer.
+bool plan_exec_block_exit_limited_by_depth();
+
 // Called by main program during planner calculations and step segment buffer during initialization.
 float plan_compute_profile_nominal_speed(plan_block_t* block);
 
@@ -130,14 +236,40 @@ void plan_sync_position();
 // Reinitialize plan with a partially completed block
 void plan_cycle_reinitialize();
 
+#ifdef PLANNER_LAZY_OVERRIDES
+// Applies a feed or rapid override change to the executing block and marks the rest of the buffer
+// for a replan.
+void plan_override_changed();
+// Replans the buffer once the overrides have settled. Called by the realtime loop.
+void plan_replan_overrides();
+#endif
+
 // Returns the number of available blocks are in the planner buffer.
-uint8_t plan_get_block_buffer_available();
+plan_index_t plan_get_block_buffer_available();
 
 // Returns the number of active blocks are in the planner buffer.
 // NOTE: Deprecated. Not used unless classic status reports are enabled in config.h
-uint8_t plan_get_block_buffer_count();
+plan_index_t plan_get_block_buffer_count();
 
 // Returns the status of the block ring buffer. True, if buffer is full.
 uint8_t plan_check_full_buffer();
 
 void plan_get_planner_mpos(float* target);
+
+// Planner recalculation counters. Reported by $Planner/Stats.
+plan_stats_t* plan_get_stats();
+void          plan_reset_stats();
+
+// Plans count short lines around a polygon, discarding the oldest block whenever the buffer is full, and
+// reports the blocks planned per second. Clears the planner. Only run when idle.
+void plan_benchmark(uint8_t client, uint32_t count);
+
+#ifdef SPINDLE_STATE_IN_PLANNER
+// Hands the modal spindle and coolant state to the next move instead of setting it now.
+void plan_defer_state();
+// Sets a deferred state that no move has taken over. Called once the motion is done.
+void plan_apply_deferred_state();
+// Takes a deferred state over for the move being queued. Returns true if there was one, which the
+// move carries in pl_data->motion.applyState.
+bool plan_take_deferred_state();
+#endif
@@ -26,6 +26,19 @@
 // Inverts the probe pin state depending on user settings and probing cycle mode.
 uint8_t probe_invert_mask;
 
+#ifdef PROBE_PIN
+// Runs on the core that called probe_init(), the same core as the stepper timer, so the two
+// interrupts never overlap and sys_position is captured between steps.
+static void IRAM_ATTR isr_probe() {
+    if (sys_probe_state == PROBE_ACTIVE) {
+        probe_state_monitor();
+    }
+#    ifdef ENABLE_PROBE_SCAN
+    probe_scan_edge();
+#    endif
+}
+#endif
+
 // Probe pin initialization routine.
 void probe_init() {
 #ifdef PROBE_PIN
@@ -35,6 +48,7 @@ void probe_init() {
     pinMode(PROBE_PIN, INPUT_PULLUP);  // Enable internal pull-up resistors. Normal high operation.
 #    endif
     probe_configure_invert_mask(false);  // Initialize invert mask.
+    attachInterrupt(PROBE_PIN, isr_probe, CHANGE);
 #endif
 }
 
@@ -60,11 +74,10 @@ uint8_t probe_get_state() {
 #endif
 }
 
-// Monitors probe pin state and records the system position when detected. Called by the
-// stepper ISR per ISR tick.
-// NOTE: This function must be extremely efficient as to not bog down the stepper ISR.
-void probe_state_monitor() {
-    if (probe_get_state()) {
+// Records the system position and cancels the motion if the probe is triggered. Called by the
+// probe pin interrupt on each edge and once by mc_probe() when probing starts.
+void IRAM_ATTR probe_state_monitor() {
+    if (sys_probe_state == PROBE_ACTIVE && probe_get_state()) {
         sys_probe_state = PROBE_OFF;
         memcpy(sys_probe_position, sys_position, sizeof(sys_position));
         bit_true(sys_rt_exec_state, EXEC_MOTION_CANCEL);
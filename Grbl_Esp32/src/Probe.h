@@ -38,6 +38,6 @@ void probe_configure_invert_mask(uint8_t is_probe_away);
 // Returns probe pin state. Triggered = true. Called by gcode parser and probe state monitor.
 uint8_t probe_get_state();
 
-// Monitors probe pin state and records the system position when detected. Called by the
-// stepper ISR per ISR tick.
+// Records the system position and cancels the motion if the probe is triggered. Called by the
+// probe pin interrupt on each edge and once by mc_probe() when probing starts.
 void probe_state_monitor();
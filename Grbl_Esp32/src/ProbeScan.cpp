@@ -0,0 +1,142 @@
+/*
+  ProbeScan.cpp - probe contacts recorded while the machine keeps moving
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_PROBE_SCAN
+
+typedef struct {
+    int32_t position[MAX_N_AXIS];
+    uint8_t contact;
+} probe_scan_point_t;
+
+// Filled by the probe pin interrupt, which alone moves head, and emptied by the task, which alone
+// moves tail.
+static probe_scan_point_t scan_ring[PROBE_SCAN_POINTS];
+static volatile uint32_t  scan_head = 0;
+static volatile uint32_t  scan_tail = 0;
+
+static volatile bool     scan_active  = false;
+static uint8_t           scan_client  = CLIENT_ALL;
+static uint8_t           scan_invert  = 0;  // $6 when the scan started
+static volatile uint8_t  scan_contact = 0;  // State of the last edge recorded
+static uint32_t          scan_first   = 0;  // scan_head when the scan started
+static volatile uint32_t scan_dropped = 0;
+
+void IRAM_ATTR probe_scan_edge() {
+    if (!scan_active) {
+        return;
+    }
+    // Not probe_get_state(), whose sense a G38.4 or G38.5 cycle inverts
+    uint8_t contact = digitalRead(PROBE_PIN) ^ scan_invert;
+    if (contact == scan_contact) {
+        return;  // A bounce the pin settled back from
+    }
+    scan_contact  = contact;
+    uint32_t head = scan_head;
+    if (head - scan_tail >= PROBE_SCAN_POINTS) {
+        scan_dropped++;
+        return;
+    }
+    probe_scan_point_t* point = &scan_ring[head & (PROBE_SCAN_POINTS - 1)];
+    memcpy(point->position, sys_position, sizeof(sys_position));
+    point->contact = contact;
+    __atomic_store_n(&scan_head, head + 1, __ATOMIC_RELEASE);
+}
+
+// Sends the points recorded so far, several to a write.
+static void probe_scan_send() {
+    char     batch[512];
+    size_t   len    = 0;
+    auto     n_axis = number_axis->get();
+    uint32_t head   = __atomic_load_n(&scan_head, __ATOMIC_ACQUIRE);
+    while (scan_tail != head) {
+        uint32_t                  seq   = scan_tail - scan_first;
+        const probe_scan_point_t* point = &scan_ring[scan_tail & (PROBE_SCAN_POINTS - 1)];
+        float                     mpos[MAX_N_AXIS];
+        char                      line[24 + MAX_N_AXIS * 12];
+        system_convert_array_steps_to_mpos(mpos, point->position);
+        int n = snprintf(line, sizeof(line), "[SCAN:%u:", seq);
+        for (uint8_t axis = 0; axis < n_axis; axis++) {
+            n += snprintf(line + n, sizeof(line) - n, axis ? ",%4.3f" : "%4.3f", mpos[axis]);
+        }
+        n += snprintf(line + n, sizeof(line) - n, ":%d]\r\n", point->contact);
+        if (len + n >= sizeof(batch)) {
+            grbl_send(scan_client, batch);
+            len = 0;
+        }
+        memcpy(batch + len, line, n + 1);
+        len += n;
+        __atomic_store_n(&scan_tail, scan_tail + 1, __ATOMIC_RELEASE);
+    }
+    if (len) {
+        grbl_send(scan_client, batch);
+    }
+}
+
+static void probeScanTask(void* pvParameters) {
+    while (true) {
+        task_stats_block();
+        vTaskDelay(PROBE_SCAN_FLUSH_MS / portTICK_PERIOD_MS);
+        task_stats_unblock();
+        if (scan_tail != scan_head) {
+            probe_scan_send();
+        }
+    }
+}
+
+void probe_scan_init() {
+    xTaskCreatePinnedToCore(
+        probeScanTask, "probeScanTask", PROBE_SCAN_TASK_STACK, NULL, PROBE_SCAN_TASK_PRIORITY, NULL, PROBE_SCAN_TASK_CORE);
+}
+
+void probe_scan_start(uint8_t client) {
+    if (scan_active) {
+        return;
+    }
+    // Points of the last scan the task has not sent yet keep their numbers, as scan_first only
+    // moves on. Only the ISR moves scan_head, and it is idle until scan_active is set.
+    scan_client  = client;
+    scan_first   = scan_head;
+    scan_dropped = 0;
+    scan_invert  = probe_invert->get() ? 1 : 0;
+    scan_contact = digitalRead(PROBE_PIN) ^ scan_invert;
+    scan_active  = true;
+}
+
+void probe_scan_stop() {
+    if (!scan_active) {
+        return;
+    }
+    scan_active = false;
+    grbl_sendf(scan_client, "[MSG: Probe scan points:%u dropped:%u]\r\n", probe_scan_points(), scan_dropped);
+}
+
+bool probe_scan_active() {
+    return scan_active;
+}
+
+uint32_t probe_scan_points() {
+    return scan_head - scan_first;
+}
+
+uint32_t probe_scan_dropped() {
+    return scan_dropped;
+}
+
+#endif
@@ -0,0 +1,69 @@
+#pragma once
+
+/*
+  ProbeScan.h - probe contacts recorded while the machine keeps moving
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  G38.x stops at the first contact and syncs the planner, so digitizing a surface one probe cycle per
+  point is slow. $Probe/Scan=1 instead has the probe pin interrupt latch sys_position on every change
+  of the probe state, contact or release, into a ring of PROBE_SCAN_POINTS, and the motion goes on.
+  The host traverses the surface with ordinary G0/G1 moves. A task sends the points to the client
+  that started the scan every PROBE_SCAN_FLUSH_MS, as many as there are in one write:
+
+      [SCAN:<n>:<x>,<y>,<z>...:<1 contact|0 release>]
+
+  in machine coordinates. n counts the edges from the start of the scan, so a gap shows points the
+  full ring dropped; the number dropped is also reported when the scan ends. $Probe/Scan=0 ends it,
+  as does a reset. $Probe/Scan reports the state. A G38.x cycle during a scan works as usual.
+
+  The position is latched between steps, as for G38.x, so it is as accurate as a probe cycle at the
+  same feed rate.
+*/
+
+#include "Grbl.h"
+
+#ifndef PROBE_PIN
+#    error "ENABLE_PROBE_SCAN requires PROBE_PIN"
+#endif
+
+// Edges the ring holds, a power of 2
+#ifndef PROBE_SCAN_POINTS
+#    define PROBE_SCAN_POINTS 256
+#endif
+
+// How often the points are sent
+#ifndef PROBE_SCAN_FLUSH_MS
+#    define PROBE_SCAN_FLUSH_MS 50
+#endif
+
+static_assert((PROBE_SCAN_POINTS & (PROBE_SCAN_POINTS - 1)) == 0, "PROBE_SCAN_POINTS must be a power of 2");
+
+// Starts the task that sends the points.
+void probe_scan_init();
+
+// Starts or ends a scan. The points go to client.
+void probe_scan_start(uint8_t client);
+void probe_scan_stop();
+bool probe_scan_active();
+
+// Records an edge of the probe pin. Called by the probe pin interrupt.
+void probe_scan_edge();
+
+// Points recorded and dropped by the current or last scan
+uint32_t probe_scan_points();
+uint32_t probe_scan_dropped();
@@ -1,5 +1,7 @@
 #include "Grbl.h"
 #include <map>
+#include <vector>
+#include <algorithm>
 
 // WG Readable and writable as guest
 // WU Readable and writable as user and admin
@@ -23,15 +25,26 @@ bool auth_failed(Word* w, const char* value, WebUI::AuthenticationLevel auth_lev
     }
 }
 
-void show_setting(const char* name, const char* value, const char* description, WebUI::ESPResponseStream* out) {
-    grbl_sendf(out->client(), "$%s=%s", name, value);
+void show_setting(const char* name, const char* value, const char* description, ReportBatch& batch) {
+    batch.add("$");
+    batch.add(name);
+    batch.add("=");
+    batch.add(value);
     if (description) {
-        grbl_sendf(out->client(), "    %s", description);
+        batch.add("    ");
+        batch.add(description);
     }
-    grbl_sendf(out->client(), "\r\n");
+    batch.add("\r\n");
+}
+
+void show_setting(const char* name, const char* value, const char* description, WebUI::ESPResponseStream* out) {
+    ReportBatch batch(out->client());
+    show_setting(name, value, description, batch);
 }
 
 void settings_restore(uint8_t restore_flag) {
+    // Commit all of the erased settings together instead of one at a time
+    Setting::begin();
 #ifdef WIFI_OR_BLUETOOTH
     if (restore_flag & SETTINGS_RESTORE_WIFI_SETTINGS) {
 #    ifdef ENABLE_WIFI
@@ -59,7 +72,11 @@ void settings_restore(uint8_t restore_flag) {
         for (auto idx = CoordIndex::Begin; idx < CoordIndex::End; ++idx) {
             coords[idx]->setDefault();
         }
+#ifdef COORDINATES_DEFERRED_WRITE
+        Coordinates::flush();
+#endif
     }
+    Setting::commit();
     if (restore_flag & SETTINGS_RESTORE_BUILD_INFO) {
         EEPROM.write(EEPROM_ADDR_BUILD_INFO, 0);
         EEPROM.write(EEPROM_ADDR_BUILD_INFO + 1, 0);  // Checksum
@@ -69,13 +86,24 @@ void settings_restore(uint8_t restore_flag) {
 
 // Get settings values from non volatile storage into memory
 void load_settings() {
+#ifdef SETTINGS_NVS_BLOB
+    if (Setting::loadBlob()) {
+        return;
+    }
+#endif
     for (Setting* s = Setting::List; s; s = s->next()) {
         s->load();
     }
+#ifdef SETTINGS_NVS_BLOB
+    // The next boot takes the fast path
+    Setting::saveBlob();
+    nvs_commit(Setting::_handle);
+#endif
 }
 
 extern void make_settings();
 extern void make_grbl_commands();
+static void word_index_init();
 
 namespace WebUI {
     extern void make_web_settings();
@@ -86,7 +114,9 @@ void settings_init() {
     make_settings();
     WebUI::make_web_settings();
     make_grbl_commands();
+    word_index_init();  // Before any task looks up words
     load_settings();
+    motion_config_refresh();
 }
 
 // TODO Settings - jog may need to be special-cased in the parser, since
@@ -119,43 +149,51 @@ Error report_gcode(const char* value, WebUI::AuthenticationLevel auth_level, Web
     return Error::Ok;
 }
 
-void show_grbl_settings(WebUI::ESPResponseStream* out, type_t type, bool wantAxis) {
+void show_grbl_settings(ReportBatch& batch, type_t type, bool wantAxis) {
     for (Setting* s = Setting::List; s; s = s->next()) {
         if (s->getType() == type && s->getGrblName()) {
             bool isAxis = s->getAxis() != NO_AXIS;
             // The following test could be expressed more succinctly with XOR,
             // but is arguably clearer when written out
             if ((wantAxis && isAxis) || (!wantAxis && !isAxis)) {
-                show_setting(s->getGrblName(), s->getCompatibleValue(), NULL, out);
+                show_setting(s->getGrblName(), s->getCompatibleValue(), NULL, batch);
             }
         }
     }
 }
 Error report_normal_settings(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
-    show_grbl_settings(out, GRBL, false);  // GRBL non-axis settings
-    show_grbl_settings(out, GRBL, true);   // GRBL axis settings
+    ReportBatch batch(out->client());
+    show_grbl_settings(batch, GRBL, false);  // GRBL non-axis settings
+    show_grbl_settings(batch, GRBL, true);   // GRBL axis settings
     return Error::Ok;
 }
 Error report_extended_settings(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
-    show_grbl_settings(out, GRBL, false);      // GRBL non-axis settings
-    show_grbl_settings(out, EXTENDED, false);  // Extended non-axis settings
-    show_grbl_settings(out, GRBL, true);       // GRBL axis settings
-    show_grbl_settings(out, EXTENDED, true);   // Extended axis settings
+    ReportBatch batch(out->client());
+    show_grbl_settings(batch, GRBL, false);      // GRBL non-axis settings
+    show_grbl_settings(batch, EXTENDED, false);  // Extended non-axis settings
+    show_grbl_settings(batch, GRBL, true);       // GRBL axis settings
+    show_grbl_settings(batch, EXTENDED, true);   // Extended axis settings
     return Error::Ok;
 }
 Error list_grbl_names(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    ReportBatch batch(out->client());
     for (Setting* s = Setting::List; s; s = s->next()) {
         const char* gn = s->getGrblName();
         if (gn) {
-            grbl_sendf(out->client(), "$%s => $%s\r\n", gn, s->getName());
+            batch.add("$");
+            batch.add(gn);
+            batch.add(" => $");
+            batch.add(s->getName());
+            batch.add("\r\n");
         }
     }
     return Error::Ok;
 }
 Error list_settings(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    ReportBatch batch(out->client());
     for (Setting* s = Setting::List; s; s = s->next()) {
         const char* displayValue = auth_failed(s, value, auth_level) ? "<Authentication required>" : s->getStringValue();
-        show_setting(s->getName(), displayValue, NULL, out);
+        show_setting(s->getName(), displayValue, NULL, batch);
     }
     return Error::Ok;
 }
@@ -285,7 +323,12 @@ Error report_startup_lines(const char* value, WebUI::AuthenticationLevel auth_le
     return Error::Ok;
 }
 
-std::map<const char*, uint8_t, cmp_str> restoreCommands = {
+typedef struct {
+    const char* name;
+    uint8_t     flags;
+} restore_command_t;
+
+static constexpr restore_command_t restoreCommands[] = {
 #ifdef ENABLE_RESTORE_EEPROM_DEFAULT_SETTINGS
     { "$", SETTINGS_RESTORE_DEFAULTS },      { "settings", SETTINGS_RESTORE_DEFAULTS },
 #endif
@@ -301,11 +344,802 @@ Error restore_settings(const char* value, WebUI::AuthenticationLevel auth_level,
     if (!value) {
         return Error::InvalidStatement;
     }
-    auto it = restoreCommands.find(value);
-    if (it == restoreCommands.end()) {
-        return Error::InvalidStatement;
+    for (const restore_command_t& command : restoreCommands) {
+        if (strcmp(value, command.name) == 0) {
+            settings_restore(command.flags);
+            return Error::Ok;
+        }
+    }
+    return Error::InvalidStatement;
+}
+
+#ifdef COORDINATES_DEFERRED_WRITE
+// Writes coordinate changes still held in RAM to NVS now.
+Error save_coordinates(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    Coordinates::flush();
+    return Error::Ok;
+}
+#endif
+
+// $Planner/Bench=<count> times plan_buffer_line() on <count> blocks, 10000 by default. $Stepper/Bench
+// times the segment prep the same way.
+static Error motion_bench(const char* value, WebUI::ESPResponseStream* out, void (*bench)(uint8_t client, uint32_t count)) {
+    uint32_t count = 10000;
+    if (value) {
+        char* endptr = NULL;
+        count        = strtoul(value, &endptr, 10);
+        if (*endptr) {
+            return Error::BadNumberFormat;
+        }
+        if (count == 0 || count > 1000000) {
+            return Error::InvalidValue;
+        }
+    }
+#ifdef MOTION_PIPELINE
+    if (!mc_pipeline_empty()) {
+        return Error::IdleError;
+    }
+#endif
+    if (plan_get_current_block() != NULL) {
+        return Error::IdleError;  // The benchmark clears the planner
+    }
+    bench(out->client(), count);
+    return Error::Ok;
+}
+
+Error planner_bench(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    return motion_bench(value, out, plan_benchmark);
+}
+
+Error stepper_bench(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    return motion_bench(value, out, st_benchmark);
+}
+
+Error report_planner_stats(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (value) {
+        plan_reset_stats();
+        return Error::Ok;
+    }
+    plan_stats_t* stats = plan_get_stats();
+    grbl_sendf(out->client(),
+               "[MSG: Planner appends:%u touched:%u avg:%4.2f last:%u max:%u merged:%u]\r\n",
+               stats->appends,
+               stats->blocks_touched,
+               stats->appends ? float(stats->blocks_touched) / stats->appends : 0.0,
+               stats->last_touched,
+               stats->max_touched,
+               stats->merges);
+    return Error::Ok;
+}
+
+#ifdef ENABLE_STEPPER_ISR_PROFILING
+static void report_isr_cycles(uint8_t client, const char* name, const st_isr_cycles_t* profile) {
+    if (profile->events == 0) {
+        return;
+    }
+    char bins[STEPPER_ISR_PROFILE_BINS * 11 + 1];
+    int  len = 0;
+    for (int i = 0; i < STEPPER_ISR_PROFILE_BINS && len < int(sizeof(bins)); i++) {
+        len += snprintf(bins + len, sizeof(bins) - len, i ? ",%u" : "%u", profile->histogram[i]);
+    }
+    grbl_sendf(client,
+               "[MSG: Stepper ISR %s events:%u min:%u avg:%u max:%u bins:%s]\r\n",
+               name,
+               profile->events,
+               profile->min_cycles,
+               uint32_t(profile->cycles / profile->events),
+               profile->max_cycles,
+               bins);
+}
+#endif
+
+Error report_stepper_stats(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (value) {
+#ifdef ENABLE_STEPPER_ISR_PROFILING
+        st_reset_isr_profile();
+#endif
+#ifdef STEP_BURST
+        st_reset_burst_stats();
+#endif
+        return Error::Ok;
+    }
+    grbl_sendf(out->client(), "[MSG: Stepper underruns:%u]\r\n", st_get_underrun_count());
+#ifdef STEP_BURST
+    const st_burst_stats_t* bursts = st_get_burst_stats();
+    grbl_sendf(out->client(),
+               "[MSG: Stepper runs:%u steps:%u ISRs saved:%u extra steps:%u]\r\n",
+               bursts->runs,
+               bursts->steps,
+               bursts->steps - bursts->runs * STEP_BURST_ISRS,
+               bursts->extra_steps);
+#endif
+#ifdef ENABLE_STEPPER_ISR_PROFILING
+    const st_isr_profile_t* profile = st_get_isr_profile();
+    uint32_t                mhz     = getCpuFrequencyMhz();
+    // Timer ticks are F_STEPPER_TIMER, CPU cycles mhz * 1000000
+    uint64_t period = uint64_t(profile->worst_load_ticks) * mhz * 1000000 / F_STEPPER_TIMER;
+    grbl_sendf(out->client(),
+               "[MSG: Stepper ISR cycles at %u MHz, bins of %u, worst load:%u%% (%u cycles of %u)]\r\n",
+               mhz,
+               STEPPER_ISR_PROFILE_BIN_CYCLES,
+               period ? uint32_t(profile->worst_load_cycles * 100ULL / period) : 0,
+               profile->worst_load_cycles,
+               uint32_t(period));
+    report_isr_cycles(out->client(), "all", &profile->all);
+    report_isr_cycles(out->client(), "step", &profile->work[int(StIsrWork::Step)]);
+    report_isr_cycles(out->client(), "segment", &profile->work[int(StIsrWork::Segment)]);
+    report_isr_cycles(out->client(), "block", &profile->work[int(StIsrWork::Block)]);
+#    ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+    char name[] = "AMASS 0";
+    for (int level = 0; level <= MAX_AMASS_LEVEL; level++) {
+        name[6] = '0' + level;
+        report_isr_cycles(out->client(), name, &profile->amass[level]);
+    }
+#    endif
+#endif
+    return Error::Ok;
+}
+
+#ifdef ENABLE_AXIS_ENCODERS
+Error report_encoder_stats(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (value) {
+        axis_encoder_reset_stats();
+        return Error::Ok;
+    }
+    axis_encoder_info_t info;
+    for (uint8_t i = 0; axis_encoder_get(i, &info); i++) {
+        grbl_sendf(out->client(),
+                   "[MSG: Encoder %c position:%4.3f error:%4.3f max error:%4.3f]\r\n",
+                   report_get_axis_letter(info.axis),
+                   info.position,
+                   info.error,
+                   info.max_error);
+    }
+#    ifdef AXIS_ENCODER_CORRECTION
+    grbl_sendf(out->client(), "[MSG: Encoder correction steps:%u]\r\n", st_get_correction_count());
+#    endif
+    return Error::Ok;
+}
+#endif
+
+#ifdef ENABLE_PROBE_SCAN
+Error probe_scan(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (!value) {
+        grbl_sendf(out->client(),
+                   "[MSG: Probe scan %s points:%u dropped:%u]\r\n",
+                   probe_scan_active() ? "on" : "off",
+                   probe_scan_points(),
+                   probe_scan_dropped());
+        return Error::Ok;
+    }
+    if (!strcmp(value, "1")) {
+        probe_scan_start(out->client());
+    } else if (!strcmp(value, "0")) {
+        probe_scan_stop();
+    } else {
+        return Error::InvalidValue;
+    }
+    return Error::Ok;
+}
+#endif
+
+#ifdef ENABLE_LASER_PPI
+Error laser_ppi(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (!value) {
+        grbl_sendf(out->client(), "[MSG: Laser PPI:%4.1f pulse:%uus]\r\n", laser_ppi_get(), laser_ppi_pulse_us());
+        return Error::Ok;
+    }
+    char*    end;
+    float    ppi      = strtof(value, &end);
+    uint32_t pulse_us = laser_ppi_pulse_us();
+    if (end != value && *end == ',') {
+        const char* width = end + 1;
+        pulse_us          = strtoul(width, &end, 10);
+        if (end == width) {
+            return Error::BadNumberFormat;
+        }
+    }
+    if (end == value || *end) {
+        return Error::BadNumberFormat;
+    }
+    if (ppi < 0.0f || pulse_us == 0 || pulse_us > 32767) {
+        return Error::InvalidValue;
+    }
+    laser_ppi_set(ppi, pulse_us);
+    return Error::Ok;
+}
+#endif
+
+#ifdef ENABLE_CACHE_PROFILING
+Error report_cache_profile(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (value) {
+        cache_profile_reset();
+        return Error::Ok;
+    }
+#    ifdef MOTION_IRAM_PLACEMENT
+    grbl_sendf(out->client(), "[MSG: Motion pipeline in IRAM]\r\n");
+#    else
+    grbl_sendf(out->client(), "[MSG: Motion pipeline in flash]\r\n");
+#    endif
+    for (int path = 0; path < int(HotPath::Count); path++) {
+        const hot_path_stats_t* stats = cache_profile_get(HotPath(path));
+        uint32_t                calls = stats->calls ? stats->calls : 1;
+        grbl_sendf(out->client(),
+                   "[MSG: %s calls:%u cycles/call:%u max:%u cache misses/call:%u.%02u]\r\n",
+                   cache_profile_name(HotPath(path)),
+                   stats->calls,
+                   uint32_t(stats->cycles / calls),
+                   stats->max_cycles,
+                   uint32_t(stats->cache_misses / calls),
+                   uint32_t(stats->cache_misses * 100 / calls % 100));
+    }
+    return Error::Ok;
+}
+#endif
+
+#ifdef ENABLE_STEP_CAPTURE
+Error step_capture(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (value) {
+        char*    end;
+        uint32_t events = strtoul(value, &end, 10);
+        if (*value == '\0' || *end != '\0') {
+            return Error::InvalidValue;
+        }
+        return step_capture_arm(events);
+    }
+    step_capture_stats_t stats;
+    step_capture_get_stats(&stats);
+    char bins[STEP_CAPTURE_JITTER_BINS * 11 + 1];
+    int  len = 0;
+    for (int i = 0; i < STEP_CAPTURE_JITTER_BINS && len < int(sizeof(bins)); i++) {
+        len += snprintf(bins + len, sizeof(bins) - len, i ? ",%u" : "%u", stats.histogram[i]);
+    }
+    grbl_sendf(out->client(),
+               "[MSG: Step capture %s events:%u of %u clock:%u Hz]\r\n",
+               step_capture_active ? "running" : "done",
+               stats.events,
+               stats.capacity,
+               stats.clock_hz);
+    grbl_sendf(out->client(),
+               "[MSG: Step jitter intervals:%u min:%d max:%d rms:%u ns, bins of %u ns:%s]\r\n",
+               stats.intervals,
+               stats.min_ns,
+               stats.max_ns,
+               stats.rms_ns,
+               STEP_CAPTURE_JITTER_BIN_NS,
+               bins);
+    return Error::Ok;
+}
+
+Error step_capture_segments(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    char     line[100];
+    uint32_t cursor = 0;
+    step_capture_segment_header(line, sizeof(line));
+    grbl_sendf(out->client(), "%s\r\n", line);
+    while (step_capture_segment_line(&cursor, line, sizeof(line))) {
+        grbl_sendf(out->client(), "%s\r\n", line);
+    }
+    return Error::Ok;
+}
+
+Error step_capture_events(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    char line[80];
+    step_capture_event_header(line, sizeof(line));
+    grbl_sendf(out->client(), "%s\r\n", line);
+    for (uint32_t i = 0; step_capture_event_line(i, line, sizeof(line)); i++) {
+        grbl_sendf(out->client(), "%s\r\n", line);
+    }
+    return Error::Ok;
+}
+#endif
+
+Error report_serial_stats(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (value) {
+        serial_reset_realtime_latency();
+        return Error::Ok;
+    }
+    const serial_latency_t* latency = serial_get_realtime_latency();
+    uint32_t                average = latency->count ? uint32_t(latency->total_us / latency->count) : 0;
+    grbl_sendf(out->client(),
+               "[MSG: Realtime commands:%u last:%u avg:%u max:%u us]\r\n",
+               latency->count,
+               latency->last_us,
+               average,
+               latency->max_us);
+    return Error::Ok;
+}
+
+Error report_limit_trip(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    report_limit_trigger(out->client());
+    return Error::Ok;
+}
+
+Error report_stallguard_samples(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (value) {
+        motors_reset_stallguard();
+        return Error::Ok;
+    }
+    motors_report_stallguard(out->client());
+    return Error::Ok;
+}
+
+Error report_protocol_stats(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (value) {
+        protocol_reset_client_stats();
+        return Error::Ok;
+    }
+    uint8_t owner = protocol_get_job_owner();
+    if (owner == CLIENT_ALL) {
+        grbl_sendf(out->client(), "[MSG: Job owner: none]\r\n");
+    } else {
+        grbl_sendf(out->client(), "[MSG: Job owner: %d]\r\n", owner);
+    }
+    for (uint8_t client = 0; client < CLIENT_COUNT; client++) {
+        const protocol_client_stats_t* stats = protocol_get_client_stats(client);
+        if (!stats->lines) {
+            continue;
+        }
+        grbl_sendf(out->client(),
+                   "[MSG: Client %d lines:%u last:%u avg:%u max:%u us]\r\n",
+                   client,
+                   stats->lines,
+                   stats->last_us,
+                   uint32_t(stats->total_us / stats->lines),
+                   stats->max_us);
+    }
+    return Error::Ok;
+}
+
+#if defined(ENABLE_WIFI) && defined(ENABLE_HTTP) && defined(ENABLE_SERIAL2SOCKET_OUT)
+Error report_socket_stats(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (value) {
+        WebUI::Serial2Socket.reset_stats();
+        return Error::Ok;
+    }
+    const WebUI::serial2socket_stats_t* stats = WebUI::Serial2Socket.stats();
+    uint32_t                            ms    = millis() - stats->since_ms;
+    uint32_t                            bps   = ms ? uint32_t(uint64_t(stats->bytes) * 1000 / ms) : 0;
+    uint32_t                            fps   = ms ? uint32_t(uint64_t(stats->frames) * 1000 / ms) : 0;
+    grbl_sendf(out->client(),
+               "[MSG: Socket bytes:%u frames:%u direct:%u bytes/s:%u frames/s:%u]\r\n",
+               stats->bytes,
+               stats->frames,
+               stats->direct_frames,
+               bps,
+               fps);
+    return Error::Ok;
+}
+#endif
+
+#ifdef ENABLE_BLUETOOTH
+Error report_bt_stats(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (value) {
+        WebUI::bt_config.reset_stats();
+        return Error::Ok;
+    }
+    const WebUI::bt_stats_t* stats = WebUI::bt_config.stats();
+    uint32_t                 ms    = millis() - stats->since_ms;
+    uint32_t                 total = protocol_get_client_stats(CLIENT_BT)->lines;
+    uint32_t                 lines = total >= stats->since_lines ? total - stats->since_lines : total;  // Unless $Protocol/Stats was reset
+    uint32_t                 bpw   = stats->writes ? stats->bytes / stats->writes : 0;
+    uint32_t                 lps   = ms ? uint32_t(uint64_t(lines) * 1000 / ms) : 0;
+    grbl_sendf(out->client(),
+               "[MSG: BT bytes:%u writes:%u bytes/write:%u lines:%u lines/s:%u]\r\n",
+               stats->bytes,
+               stats->writes,
+               bpw,
+               lines,
+               lps);
+    return Error::Ok;
+}
+#endif
+
+#ifdef ENABLE_TASK_STATS
+Error report_task_stats(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (value) {
+        task_stats_reset();
+        return Error::Ok;
+    }
+    task_info_t info;
+    for (uint8_t i = 0; task_stats_get(i, &info); i++) {
+        grbl_sendf(out->client(),
+                   "[MSG: Task %s core:%d priority:%u stack free:%u cpu:%u.%u%% waits:%u max wait:%u max run:%u us]\r\n",
+                   info.name,
+                   info.core,
+                   info.priority,
+                   info.stack_free,
+                   info.run_permille / 10,
+                   info.run_permille % 10,
+                   info.waits,
+                   info.max_wait_us,
+                   info.max_run_us);
+    }
+    return Error::Ok;
+}
+#endif
+
+#ifdef ENABLE_MEMORY_STATS
+Error report_memory_stats(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (value) {
+        memory_stats_reset();
+        return Error::Ok;
+    }
+    memory_stats_report(out->client());
+    return Error::Ok;
+}
+#endif
+
+#ifdef ENABLE_REALTIME_TRACE
+Error report_realtime_trace(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (value) {
+        rt_trace_reset();
+        return Error::Ok;
+    }
+    static const char* cmd_names[] = { "hold", "start", "reset", "jog cancel" };
+    static const char* hop_names[] = { "read", "flag", "protocol", "decel", "total" };
+    grbl_sendf(out->client(), "[MSG: Realtime trace, bin i counts latencies below 2^i us]\r\n");
+    for (int cmd = 0; cmd < int(RtCmd::Count); cmd++) {
+        for (int hop = 0; hop < int(RtHop::Count); hop++) {
+            const rt_trace_hist_t* hist = rt_trace_get(RtCmd(cmd), RtHop(hop));
+            if (hist->count == 0) {
+                continue;
+            }
+            char bins[RT_TRACE_BINS * 11 + 1];
+            int  len = 0;
+            for (int i = 0; i < RT_TRACE_BINS && len < int(sizeof(bins)); i++) {
+                len += snprintf(bins + len, sizeof(bins) - len, i ? ",%u" : "%u", hist->histogram[i]);
+            }
+            grbl_sendf(out->client(),
+                       "[MSG: Realtime %s %s count:%u avg:%u max:%u us bins:%s]\r\n",
+                       cmd_names[cmd],
+                       hop_names[hop],
+                       hist->count,
+                       uint32_t(hist->total_us / hist->count),
+                       hist->max_us,
+                       bins);
+        }
+    }
+    return Error::Ok;
+}
+#endif
+
+#ifdef ENABLE_TIMELINE
+Error dump_timeline(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (value) {
+        timeline_clear();
+        return Error::Ok;
+    }
+    char line[100];
+    timeline_hold(true);
+    timeline_header(line, sizeof(line));
+    grbl_sendf(out->client(), "%s\r\n", line);
+    for (uint16_t i = 0; timeline_line(i, line, sizeof(line)); i++) {
+        grbl_sendf(out->client(), "%s\r\n", line);
+    }
+    timeline_hold(false);
+    return Error::Ok;
+}
+#endif
+
+#ifdef ENABLE_METRICS
+Error report_metrics(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    metrics_write([](const char* line, void* arg) { grbl_sendf(static_cast<WebUI::ESPResponseStream*>(arg)->client(), "%s\r\n", line); },
+                  out);
+    return Error::Ok;
+}
+#endif
+
+#ifdef ENABLE_WIFI
+Error report_wifi_stats(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (value) {
+        WebUI::wifi_config.reset_stats();
+        return Error::Ok;
+    }
+    const WebUI::wifi_stats_t* stats = WebUI::wifi_config.stats();
+    int32_t                    avg   = stats->samples ? stats->rssi_sum / int32_t(stats->samples) : 0;
+    grbl_sendf(out->client(),
+               "[MSG: WiFi RSSI:%d min:%d avg:%d max:%d channel:%d power save:%s changes:%u connects:%u disconnects:%u seconds:%u]\r\n",
+               stats->rssi,
+               stats->rssi_min,
+               avg,
+               stats->rssi_max,
+               WiFi.channel(),
+               WebUI::wifi_config.power_save_on() ? "on" : "off",
+               stats->ps_changes,
+               stats->connects,
+               stats->disconnects,
+               (millis() - stats->since_ms) / 1000);
+    return Error::Ok;
+}
+#endif
+
+#if defined(ENABLE_WIFI) && defined(ENABLE_UDP_STREAM)
+Error report_udp_stats(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (value) {
+        WebUI::udp_stream.reset_stats();
+        return Error::Ok;
+    }
+    const WebUI::udp_stream_stats_t* stats = WebUI::udp_stream.stats();
+    grbl_sendf(out->client(),
+               "[MSG: UDP packets:%u out of order:%u duplicates:%u dropped:%u realtime:%u acks:%u sent:%u]\r\n",
+               stats->packets,
+               stats->out_of_order,
+               stats->duplicates,
+               stats->dropped,
+               stats->realtime,
+               stats->acks,
+               stats->sent);
+    return Error::Ok;
+}
+#endif
+
+#if defined(ENABLE_WIFI) && defined(ENABLE_NETWORK_SYNC)
+Error sync_arm(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    WebUI::network_sync.arm(!value || strcmp(value, "0"));
+    return Error::Ok;
+}
+
+Error sync_start(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    char*    end   = NULL;
+    uint32_t delay = value ? strtoul(value, &end, 10) : 0;
+    if (!value || *end || delay < NETWORK_SYNC_MIN_LEAD_MS) {
+        grbl_sendf(out->client(), "[MSG: $Sync/Start=<ms>, at least %d]\r\n", NETWORK_SYNC_MIN_LEAD_MS);
+        return Error::InvalidValue;
+    }
+    return WebUI::network_sync.start(delay) ? Error::Ok : Error::WifiFailBegin;
+}
+#endif
+
+#ifdef ENABLE_ASYNC_OUTPUT
+Error report_output_stats(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (value) {
+        client_output_reset_stats();
+        return Error::Ok;
+    }
+    for (uint8_t client = 0; client < CLIENT_COUNT; client++) {
+        const client_output_stats_t* stats = client_output_get_stats(client);
+        if (!stats) {
+            continue;
+        }
+        grbl_sendf(out->client(),
+                   "[MSG: Output %d queued:%u dropped status:%u other:%u full:%u max depth:%u]\r\n",
+                   client,
+                   stats->queued,
+                   stats->dropped_status,
+                   stats->dropped,
+                   stats->full,
+                   stats->max_depth);
+    }
+    return Error::Ok;
+}
+#endif
+
+#ifdef USE_I2S_OUT
+Error report_i2s_stats(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (value) {
+        i2s_out_reset_stats();
+        return Error::Ok;
+    }
+    const i2s_out_stats_t* stats = i2s_out_get_stats();
+#    ifdef I2S_OUT_ISR_REFILL
+    const char* refill = "interrupt";
+#    else
+    const char* refill = "task";
+#    endif
+    grbl_sendf(out->client(),
+               "[MSG: I2S buffers:%d of %d us latency:%d us refill:%s]\r\n",
+               I2S_OUT_DMABUF_COUNT,
+               I2S_OUT_DELAY_DMABUF_US,
+               I2S_OUT_DELAY_US,
+               refill);
+    if (!stats) {
+        return Error::Ok;
+    }
+    // Load is the part of a buffer's play time spent refilling it, the CPU share of the stream while stepping.
+    uint32_t avg    = stats->refills ? uint32_t(stats->refill_cycles / stats->refills) : 0;
+    uint32_t budget = getCpuFrequencyMhz() * I2S_OUT_DELAY_DMABUF_US;
+    grbl_sendf(out->client(),
+               "[MSG: I2S refills:%u avg:%u max:%u cycles load:%u%% underflows:%u truncations:%u]\r\n",
+               stats->refills,
+               avg,
+               stats->max_refill_cycles,
+               avg * 100 / budget,
+               stats->underflows,
+               stats->truncations);
+    return Error::Ok;
+}
+#endif
+
+#ifdef USE_I2S_IN
+Error report_i2s_in_stats(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (value) {
+        i2s_in_reset_stats();
+        return Error::Ok;
+    }
+    grbl_sendf(out->client(),
+               "[MSG: I2S inputs:%d sample:%d us latency:%d us]\r\n",
+               I2S_IN_NUM_BITS,
+               I2S_IN_USEC_PER_SAMPLE,
+               I2S_IN_LATENCY_US);
+    const i2s_in_stats_t* stats = i2s_in_get_stats();
+    if (!stats) {
+        return Error::Ok;
+    }
+    grbl_sendf(out->client(),
+               "[MSG: I2S buffers:%u changes:%u max:%u cycles late:%u]\r\n",
+               stats->buffers,
+               stats->changes,
+               stats->max_isr_cycles,
+               stats->late);
+    return Error::Ok;
+}
+#endif
+
+Error report_gcode_stats(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (value) {
+        gc_reset_stats();
+        return Error::Ok;
+    }
+    const gc_stats_t* stats   = gc_get_stats();
+    uint32_t          average = stats->lines ? uint32_t(stats->cycles / stats->lines) : 0;
+    uint32_t          fast    = stats->fast_lines ? uint32_t(stats->fast_cycles / stats->fast_lines) : 0;
+    grbl_sendf(out->client(),
+               "[MSG: GCode lines:%u fast:%u words:%u avg:%u fast avg:%u max:%u cycles (%u MHz)]\r\n",
+               stats->lines,
+               stats->fast_lines,
+               stats->words,
+               average,
+               fast,
+               stats->max_cycles,
+               getCpuFrequencyMhz());
+    return Error::Ok;
+}
+
+#ifdef ENABLE_BINARY_STREAM
+Error report_binary_stats(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (value) {
+        binary_stream_reset_stats();
+        return Error::Ok;
+    }
+    const binary_stream_stats_t* stats = binary_stream_get_stats();
+    grbl_sendf(out->client(),
+               "[MSG: Binary records:%u window:%u crc:%u rejected:%u overflow:%u timeout:%u]\r\n",
+               stats->records,
+               binary_stream_window(),
+               stats->crc_errors,
+               stats->rejected,
+               stats->overflows,
+               stats->timeouts);
+    return Error::Ok;
+}
+#endif
+
+#ifdef USE_KINEMATICS
+// $Kinematics/Bench[=<segments>] times the kinematics conversions. Only when Idle, since it runs on the
+// main task, which only handles realtime commands between chunks of segments.
+Error report_kinematics_bench(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    uint32_t count = 10000;
+    if (value) {
+        char* endptr = NULL;
+        count        = strtoul(value, &endptr, 10);
+        if (*endptr) {
+            return Error::BadNumberFormat;
+        }
+        if (count == 0 || count > KINEMATICS_BENCH_MAX) {
+            return Error::InvalidValue;
+        }
+    }
+    if (sys.state != State::Idle) {
+        return Error::IdleError;
+    }
+    kinematics_benchmark(out->client(), count);
+    return Error::Ok;
+}
+#endif
+
+#ifdef INPUT_SHAPING
+// $Shaper/Test=<axis> writes the input shaper test file of the axis to the SD card.
+Error shaper_test(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    if (!value || value[0] == '\0' || value[1] != '\0') {
+        return Error::InvalidValue;
+    }
+    for (uint8_t axis = 0; axis < number_axis->get(); axis++) {
+        if (toupper(value[0]) == report_get_axis_letter(axis)) {
+            return shaper_write_test(axis, out->client());
+        }
+    }
+    return Error::InvalidValue;
+}
+#endif
+
+#ifdef ENABLE_MACROS
+Error run_macro(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    return macro_run_command(value, out->client());
+}
+#endif
+
+#ifdef ENABLE_HEIGHT_MAP
+// $HeightMap/Probe=<x0>,<y0>,<x1>,<y1>,<nx>,<ny>[,<depth>[,<feed>]] probes the grid and compensates Z with it.
+Error probe_height_map(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    return height_map_probe(value, out->client());
+}
+Error show_height_map(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    return height_map_show(out->client());
+}
+Error save_height_map(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    return height_map_save();
+}
+Error load_height_map(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    return height_map_load(out->client());
+}
+Error clear_height_map(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    height_map_clear();
+    return Error::Ok;
+}
+#endif
+
+// $Report/Interval=<ms> pushes status reports to the calling client every <ms> milliseconds. 0 stops them.
+Error report_interval(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    uint8_t                    client = out->client();
+    report_subscription_info_t info   = report_get_subscription(client);
+    if (!value) {
+        grbl_sendf(client, "[MSG: Report interval:%u ms%s]\r\n", info.interval_ms, info.on_change ? " on change" : "");
+        return Error::Ok;
+    }
+    char*    endptr   = NULL;
+    uint32_t interval = strtoul(value, &endptr, 10);
+    if (*endptr) {
+        return Error::BadNumberFormat;
+    }
+    report_subscribe(client, interval, info.on_change);
+    return Error::Ok;
+}
+
+// $Report/OnChange=1 limits the pushed status reports to the ones that differ from the last one sent.
+Error report_on_change(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    uint8_t                    client = out->client();
+    report_subscription_info_t info   = report_get_subscription(client);
+    if (!value) {
+        grbl_sendf(client, "[MSG: Report on change:%d]\r\n", info.on_change);
+        return Error::Ok;
+    }
+    if (strcmp(value, "0") && strcmp(value, "1")) {
+        return Error::InvalidValue;
+    }
+    report_subscribe(client, info.interval_ms, value[0] == '1');
+    return Error::Ok;
+}
+
+// $Report/Credits=1 sends the calling client a [CR:<planner blocks>,<rx bytes>] message whenever planner
+// blocks or receive buffer space free up.
+Error report_credits(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    uint8_t client = out->client();
+    if (!value) {
+        grbl_sendf(client, "[MSG: Report credits:%d rx buffer:%u]\r\n", report_get_credits(client), serial_get_rx_buffer_size(client));
+        return Error::Ok;
+    }
+    if (strcmp(value, "0") && strcmp(value, "1")) {
+        return Error::InvalidValue;
+    }
+    report_set_credits(client, value[0] == '1');
+    return Error::Ok;
+}
+
+// $Report/Format=Delta sends the calling client only the status report fields that changed. Full restores the
+// normal reports. Selecting either resends every field in the next report.
+Error report_format(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    uint8_t client = out->client();
+    if (!value) {
+        grbl_sendf(client, "[MSG: Report format:%s]\r\n", report_get_delta_format(client) ? "Delta" : "Full");
+        return Error::Ok;
+    }
+    if (strcasecmp(value, "Delta") == 0) {
+        report_set_delta_format(client, true);
+    } else if (strcasecmp(value, "Full") == 0) {
+        report_set_delta_format(client, false);
+    } else {
+        return Error::InvalidValue;
     }
-    settings_restore(it->second);
     return Error::Ok;
 }
 
@@ -327,10 +1161,11 @@ Error doJog(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESP
     return gc_execute_line(jogLine, out->client());
 }
 
-const char* errorString(Error errorNumber) {
-    auto it = ErrorCodes.find(errorNumber);
-    return it == ErrorCodes.end() ? NULL : it->second;
+#ifdef JOG_VELOCITY_MODE
+Error doJogVelocity(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
+    return jog_velocity(value ? value : "");
 }
+#endif
 
 Error listErrorCodes(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
     if (value) {
@@ -350,8 +1185,11 @@ Error listErrorCodes(const char* value, WebUI::AuthenticationLevel auth_level, W
         }
     }
 
-    for (auto it = ErrorCodes.begin(); it != ErrorCodes.end(); it++) {
-        grbl_sendf(out->client(), "%d: %s\r\n", it->first, it->second);
+    for (int errorNumber = 0; errorNumber <= UINT8_MAX; errorNumber++) {
+        const char* errorName = errorString(static_cast<Error>(errorNumber));
+        if (errorName) {
+            grbl_sendf(out->client(), "%d: %s\r\n", errorNumber, errorName);
+        }
     }
     return Error::Ok;
 }
@@ -378,6 +1216,9 @@ void make_grbl_commands() {
     new GrblCommand("", "Help", show_grbl_help, anyState);
     new GrblCommand("T", "State", showState, anyState);
     new GrblCommand("J", "Jog", doJog, idleOrJog);
+#ifdef JOG_VELOCITY_MODE
+    new GrblCommand("JV", "Jog/Velocity", doJogVelocity, idleOrJog);
+#endif
 
     new GrblCommand("$", "GrblSettings/List", report_normal_settings, notCycleOrHold);
     new GrblCommand("+", "ExtendedSettings/List", report_extended_settings, notCycleOrHold);
@@ -390,6 +1231,98 @@ void make_grbl_commands() {
     new GrblCommand("X", "Alarm/Disable", disable_alarm_lock, anyState);
     new GrblCommand("NVX", "Settings/Erase", Setting::eraseNVS, idleOrAlarm, WA);
     new GrblCommand("V", "Settings/Stats", Setting::report_nvs_stats, idleOrAlarm);
+#ifdef COORDINATES_DEFERRED_WRITE
+    new GrblCommand(NULL, "Coordinates/Save", save_coordinates, idleOrAlarm);
+#endif
+    new GrblCommand(NULL, "Planner/Stats", report_planner_stats, anyState);
+    new GrblCommand(NULL, "Planner/Bench", planner_bench, idleOrAlarm);
+    new GrblCommand(NULL, "Stepper/Bench", stepper_bench, idleOrAlarm);
+    new GrblCommand(NULL, "Stepper/Stats", report_stepper_stats, anyState);
+#ifdef ENABLE_AXIS_ENCODERS
+    new GrblCommand(NULL, "Encoders/Stats", report_encoder_stats, anyState);
+#endif
+#ifdef ENABLE_PROBE_SCAN
+    new GrblCommand(NULL, "Probe/Scan", probe_scan, anyState);
+#endif
+#ifdef ENABLE_LASER_PPI
+    new GrblCommand(NULL, "Laser/PPI", laser_ppi, idleOrAlarm);
+#endif
+#ifdef ENABLE_CACHE_PROFILING
+    new GrblCommand(NULL, "Profile/Cache", report_cache_profile, anyState);
+#endif
+#ifdef ENABLE_STEP_CAPTURE
+    new GrblCommand(NULL, "Steps/Capture", step_capture, anyState);
+    new GrblCommand(NULL, "Steps/Capture/Segments", step_capture_segments, anyState);
+    new GrblCommand(NULL, "Steps/Capture/Events", step_capture_events, anyState);
+#endif
+    new GrblCommand(NULL, "Serial/Stats", report_serial_stats, anyState);
+    new GrblCommand(NULL, "GCode/Stats", report_gcode_stats, anyState);
+    new GrblCommand(NULL, "Protocol/Stats", report_protocol_stats, anyState);
+    new GrblCommand(NULL, "Limits/Trigger", report_limit_trip, anyState);
+    new GrblCommand(NULL, "StallGuard/Samples", report_stallguard_samples, anyState);
+#ifdef USE_I2S_OUT
+    new GrblCommand(NULL, "I2S/Stats", report_i2s_stats, anyState);
+#endif
+#ifdef USE_I2S_IN
+    new GrblCommand(NULL, "I2SIn/Stats", report_i2s_in_stats, anyState);
+#endif
+#ifdef ENABLE_ASYNC_OUTPUT
+    new GrblCommand(NULL, "Output/Stats", report_output_stats, anyState);
+#endif
+#if defined(ENABLE_WIFI) && defined(ENABLE_HTTP) && defined(ENABLE_SERIAL2SOCKET_OUT)
+    new GrblCommand(NULL, "Socket/Stats", report_socket_stats, anyState);
+#endif
+#ifdef ENABLE_BINARY_STREAM
+    new GrblCommand(NULL, "Binary/Stats", report_binary_stats, anyState);
+#endif
+#ifdef ENABLE_BLUETOOTH
+    new GrblCommand(NULL, "BT/Stats", report_bt_stats, anyState);
+#endif
+#ifdef ENABLE_WIFI
+    new GrblCommand(NULL, "WiFi/Stats", report_wifi_stats, anyState);
+#endif
+#if defined(ENABLE_WIFI) && defined(ENABLE_UDP_STREAM)
+    new GrblCommand(NULL, "UDP/Stats", report_udp_stats, anyState);
+#endif
+#if defined(ENABLE_WIFI) && defined(ENABLE_NETWORK_SYNC)
+    new GrblCommand(NULL, "Sync/Arm", sync_arm, anyState);
+    new GrblCommand(NULL, "Sync/Start", sync_start, anyState);
+#endif
+#ifdef ENABLE_TASK_STATS
+    new GrblCommand(NULL, "Tasks/Stats", report_task_stats, anyState);
+#endif
+#ifdef ENABLE_MEMORY_STATS
+    new GrblCommand(NULL, "Memory/Stats", report_memory_stats, anyState);
+#endif
+#ifdef ENABLE_TIMELINE
+    new GrblCommand(NULL, "Timeline/Dump", dump_timeline, anyState);
+#endif
+#ifdef ENABLE_METRICS
+    new GrblCommand(NULL, "Metrics", report_metrics, anyState);
+#endif
+#ifdef ENABLE_REALTIME_TRACE
+    new GrblCommand(NULL, "Realtime/Trace", report_realtime_trace, anyState);
+#endif
+#ifdef USE_KINEMATICS
+    new GrblCommand(NULL, "Kinematics/Bench", report_kinematics_bench, idleOrAlarm);
+#endif
+#ifdef INPUT_SHAPING
+    new GrblCommand(NULL, "Shaper/Test", shaper_test, idleOrAlarm);
+#endif
+#ifdef ENABLE_MACROS
+    new GrblCommand(NULL, "Macros/Run", run_macro, idleOrAlarm);
+#endif
+#ifdef ENABLE_HEIGHT_MAP
+    new GrblCommand(NULL, "HeightMap/Probe", probe_height_map, idleOrAlarm);
+    new GrblCommand(NULL, "HeightMap/Show", show_height_map, anyState);
+    new GrblCommand(NULL, "HeightMap/Save", save_height_map, idleOrAlarm);
+    new GrblCommand(NULL, "HeightMap/Load", load_height_map, idleOrAlarm);
+    new GrblCommand(NULL, "HeightMap/Clear", clear_height_map, idleOrAlarm);
+#endif
+    new GrblCommand(NULL, "Report/Interval", report_interval, anyState);
+    new GrblCommand(NULL, "Report/OnChange", report_on_change, anyState);
+    new GrblCommand(NULL, "Report/Format", report_format, anyState);
+    new GrblCommand(NULL, "Report/Credits", report_credits, anyState);
     new GrblCommand("#", "GCode/Offsets", report_ngc, idleOrAlarm);
     new GrblCommand("H", "Home", home_all, idleOrAlarm);
 #ifdef HOMING_SINGLE_AXIS_COMMANDS
@@ -438,6 +1371,134 @@ char* normalize_key(char* start) {
     return start;
 }
 
+// Every setting and command name, sorted case-insensitively so a key is found by binary search
+// instead of scanning Setting::List and Command::List. Several entries can share a key; they are
+// ordered the way the list scans used to find them: settings by full name, then settings by
+// compatible name, then commands, each in list order. The index is rebuilt when words are added.
+// The protocol loop and the WebUI task both look words up, so word_index_mutex guards the index.
+enum class WordMatch : uint8_t {
+    SettingName = 0,
+    SettingGrblName,
+    Command,
+};
+
+typedef struct {
+    const char* key;
+    WordMatch   match;
+    uint16_t    order;  // Position in its list
+    Word*       word;
+} word_key_t;
+
+static std::vector<word_key_t> word_index;
+static uint16_t                word_index_settings = 0;
+static uint16_t                word_index_commands = 0;
+static SemaphoreHandle_t       word_index_mutex    = NULL;
+
+// The ESPnnn keys of the index by number, so the WebUI commands the HMI sends all the time are
+// found with integer compares. Only the entry found first for a key is kept.
+typedef struct {
+    uint16_t number;
+    uint16_t entry;  // Position in word_index
+} esp_key_t;
+
+static std::vector<esp_key_t> esp_index;
+
+// The number of an ESPnnn key, or -1. As with the names, ESP0800 is not ESP800.
+static int esp_number(const char* key) {
+    if (strncasecmp(key, "ESP", 3) != 0) {
+        return -1;
+    }
+    key += 3;
+    if (!isdigit(key[0]) || (key[0] == '0' && key[1])) {
+        return -1;
+    }
+    int number = 0;
+    for (; *key; key++) {
+        if (!isdigit(*key) || number > 9999) {
+            return -1;
+        }
+        number = number * 10 + (*key - '0');
+    }
+    return number <= UINT16_MAX ? number : -1;
+}
+
+static bool word_key_less(const word_key_t& a, const word_key_t& b) {
+    int cmp = strcasecmp(a.key, b.key);
+    if (cmp) {
+        return cmp < 0;
+    }
+    if (a.match != b.match) {
+        return a.match < b.match;
+    }
+    return a.order < b.order;
+}
+
+static void build_word_index() {
+    word_index.clear();
+    word_index.reserve(2 * (Setting::Count + Command::Count));
+    uint16_t order = 0;
+    for (Setting* s = Setting::List; s; s = s->next(), order++) {
+        word_index.push_back({ s->getName(), WordMatch::SettingName, order, s });
+        if (s->getGrblName()) {
+            word_index.push_back({ s->getGrblName(), WordMatch::SettingGrblName, order, s });
+        }
+    }
+    order = 0;
+    for (Command* cp = Command::List; cp; cp = cp->next(), order++) {
+        word_index.push_back({ cp->getName(), WordMatch::Command, order, cp });
+        if (cp->getGrblName()) {
+            word_index.push_back({ cp->getGrblName(), WordMatch::Command, order, cp });
+        }
+    }
+    std::sort(word_index.begin(), word_index.end(), word_key_less);
+
+    esp_index.clear();
+    for (uint16_t i = 0; i < word_index.size(); i++) {
+        int number = esp_number(word_index[i].key);
+        // Entries with the same key are adjacent, in the order they are preferred
+        if (number >= 0 && (esp_index.empty() || esp_index.back().number != number)) {
+            esp_index.push_back({ uint16_t(number), i });
+        }
+    }
+    std::sort(esp_index.begin(), esp_index.end(), [](const esp_key_t& a, const esp_key_t& b) { return a.number < b.number; });
+    word_index_settings = Setting::Count;
+    word_index_commands = Command::Count;
+}
+
+static void word_index_init() {
+    word_index_mutex = xSemaphoreCreateMutex();
+    build_word_index();
+}
+
+// Copies the entry of the setting or command that key names to found. Returns false if there is none.
+// The copy stays valid when another task rebuilds the index.
+static bool find_word(const char* key, word_key_t* found) {
+    xSemaphoreTake(word_index_mutex, portMAX_DELAY);
+    if (word_index_settings != Setting::Count || word_index_commands != Command::Count) {
+        build_word_index();
+    }
+    bool ok     = false;
+    int  number = esp_number(key);
+    if (number >= 0) {
+        // Every ESPnnn key is in esp_index, so a number that is not there is no word.
+        auto esp = std::lower_bound(
+            esp_index.begin(), esp_index.end(), number, [](const esp_key_t& entry, int n) { return entry.number < n; });
+        if (esp != esp_index.end() && esp->number == number) {
+            *found = word_index[esp->entry];
+            ok     = true;
+        }
+    } else {
+        auto it = std::lower_bound(
+            word_index.begin(), word_index.end(), key, [](const word_key_t& entry, const char* k) { return strcasecmp(entry.key, k) < 0; });
+        if (it != word_index.end() && strcasecmp(it->key, key) == 0) {
+            *found = *it;
+            ok     = true;
+        }
+    }
+    xSemaphoreGive(word_index_mutex);
+    return ok;
+}
+
 // This is the handler for all forms of settings commands,
 // $..= and [..], with and without a value.
 Error do_command_or_setting(const char* key, char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
@@ -447,47 +1508,34 @@ Error do_command_or_setting(const char* key, char* value, WebUI::AuthenticationL
     // $key= with nothing following the = .  It is important to distinguish
     // those cases so that you can say "$N0=" to clear a startup line.
 
-    // First search the settings list by text name.  If found, set a new
-    // value if one is given, otherwise display the current value
-    for (Setting* s = Setting::List; s; s = s->next()) {
-        if (strcasecmp(s->getName(), key) == 0) {
-            if (auth_failed(s, value, auth_level)) {
-                return Error::AuthenticationFailed;
-            }
-            if (value) {
-                return s->setStringValue(value);
-            } else {
-                show_setting(s->getName(), s->getStringValue(), NULL, out);
-                return Error::Ok;
-            }
+    // Settings are matched by text name first, then by compatible name, and only then commands.
+    // A setting gets a new value if one is given, otherwise its current value is displayed,
+    // in compatible mode if it was named that way.
+    word_key_t entry;
+    bool       known = find_word(key, &entry);
+    if (known && entry.match != WordMatch::Command) {
+        Setting* s = static_cast<Setting*>(entry.word);
+        if (auth_failed(s, value, auth_level)) {
+            return Error::AuthenticationFailed;
         }
-    }
-
-    // Then search the setting list by compatible name.  If found, set a new
-    // value if one is given, otherwise display the current value in compatible mode
-    for (Setting* s = Setting::List; s; s = s->next()) {
-        if (s->getGrblName() && strcasecmp(s->getGrblName(), key) == 0) {
-            if (auth_failed(s, value, auth_level)) {
-                return Error::AuthenticationFailed;
-            }
-            if (value) {
-                return s->setStringValue(value);
-            } else {
-                show_setting(s->getGrblName(), s->getCompatibleValue(), NULL, out);
-                return Error::Ok;
-            }
+        if (value) {
+            return s->setStringValue(value);
+        }
+        if (entry.match == WordMatch::SettingName) {
+            show_setting(s->getName(), s->getStringValue(), NULL, out);
+        } else {
+            show_setting(s->getGrblName(), s->getCompatibleValue(), NULL, out);
         }
+        return Error::Ok;
     }
-    // If we did not find a setting, look for a command.  Commands
-    // handle values internally; you cannot determine whether to set
+    // Commands handle values internally; you cannot determine whether to set
     // or display solely based on the presence of a value.
-    for (Command* cp = Command::List; cp; cp = cp->next()) {
-        if ((strcasecmp(cp->getName(), key) == 0) || (cp->getGrblName() && strcasecmp(cp->getGrblName(), key) == 0)) {
-            if (auth_failed(cp, value, auth_level)) {
-                return Error::AuthenticationFailed;
-            }
-            return cp->action(value, auth_level, out);
+    if (known) {
+        Command* cp = static_cast<Command*>(entry.word);
+        if (auth_failed(cp, value, auth_level)) {
+            return Error::AuthenticationFailed;
         }
+        return cp->action(value, auth_level, out);
     }
 
     // If we did not find an exact match and there is no value,
@@ -504,14 +1552,15 @@ Error do_command_or_setting(const char* key, char* value, WebUI::AuthenticationL
             lcKey.remove(0, 1);
         }
         lcKey.toLowerCase();
-        bool found = false;
+        bool        found = false;
+        ReportBatch batch(out->client());
         for (Setting* s = Setting::List; s; s = s->next()) {
             auto lcTest = String(s->getName());
             lcTest.toLowerCase();
 
             if (lcTest.indexOf(lcKey) >= 0) {
                 const char* displayValue = auth_failed(s, value, auth_level) ? "<Authentication required>" : s->getStringValue();
-                show_setting(s->getName(), displayValue, NULL, out);
+                show_setting(s->getName(), displayValue, NULL, batch);
                 found = true;
             }
         }
@@ -39,6 +39,10 @@ typedef struct {
 } client_line_t;
 client_line_t client_lines[CLIENT_COUNT];
 
+static uint8_t                 job_owner = CLIENT_ALL;
+static int64_t                 waiting_since[CLIENT_COUNT];  // When pending input was first seen, 0 if none
+static protocol_client_stats_t client_stats[CLIENT_COUNT];
+
 static void empty_line(uint8_t client) {
     client_line_t* cl = &client_lines[client];
     cl->len           = 0;
@@ -91,6 +95,152 @@ Error execute_line(char* line, uint8_t client, WebUI::AuthenticationLevel auth_l
     return gc_execute_line(line, client);
 }
 
+const protocol_client_stats_t* protocol_get_client_stats(uint8_t client) {
+    return &client_stats[client];
+}
+
+void protocol_reset_client_stats() {
+    memset(client_stats, 0, sizeof(client_stats));
+}
+
+uint8_t protocol_get_job_owner() {
+    return job_owner;
+}
+
+static void record_wait(uint8_t client, int64_t now) {
+    if (!waiting_since[client]) {
+        return;
+    }
+    protocol_client_stats_t* stats = &client_stats[client];
+    uint32_t                 wait  = uint32_t(now - waiting_since[client]);
+    stats->lines++;
+    stats->last_us = wait;
+    stats->total_us += wait;
+    if (wait > stats->max_us) {
+        stats->max_us = wait;
+    }
+    waiting_since[client] = 0;
+}
+
+// Reads and executes up to max_lines lines from a client, stopping early once slice_us has passed.
+// Bytes beyond the last line stay in the client's buffer for the next pass. Returns false on abort.
+static bool protocol_service_client(uint8_t client, int max_lines, int64_t slice_us) {
+    int64_t start = esp_timer_get_time();
+    if (!waiting_since[client] && serial_has_data(client)) {
+        waiting_since[client] = start;
+    }
+    int     lines = 0;
+    uint8_t c;
+    while (lines < max_lines && (c = serial_read(client)) != SERIAL_NO_DATA) {
+#ifdef ENABLE_BINARY_STREAM
+        if (c == BINARY_STX) {
+            binary_stream_execute(client);
+            if (sys.abort) {
+                return false;  // Bail to calling function upon system abort
+            }
+            if (job_owner == CLIENT_ALL && plan_get_current_block() != NULL) {
+                job_owner = client;
+            }
+            lines++;
+            continue;
+        }
+#endif
+        Error res = add_char_to_line(c, client);
+        switch (res) {
+            case Error::Ok:
+                break;
+            case Error::Eol: {
+                protocol_execute_realtime();  // Runtime command check point.
+                if (sys.abort) {
+                    return false;  // Bail to calling function upon system abort
+                }
+                int64_t now = esp_timer_get_time();
+                record_wait(client, now);
+                char* line = client_lines[client].buffer;
+#ifdef REPORT_ECHO_RAW_LINE_RECEIVED
+                report_echo_line_received(line, client);
+#endif
+                // auth_level can be upgraded by supplying a password on the command line
+                Error status = execute_line(line, client, WebUI::AuthenticationLevel::LEVEL_GUEST);
+#ifdef SD_CAPTURE
+                if (client == sd_capture_client && status == Error::Ok) {
+                    sd_capture_line(line);
+                }
+#endif
+                report_status_message(status, client);
+                empty_line(client);
+                // The first client to start motion owns the job until the machine is idle again.
+                if (job_owner == CLIENT_ALL && plan_get_current_block() != NULL) {
+                    job_owner = client;
+                }
+                lines++;
+                now = esp_timer_get_time();
+                if (serial_has_data(client)) {
+                    waiting_since[client] = now;
+                }
+                if (slice_us && now - start >= slice_us) {
+                    return true;
+                }
+                break;
+            }
+            case Error::Overflow:
+                report_status_message(Error::Overflow, client);
+                empty_line(client);
+                break;
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+#ifdef SAFETY_DOOR_OVERLAP_RESTORE
+// Restarts the spindle for a safety door resume. Returns when it will be up to speed.
+static int64_t protocol_restore_spindle(SpindleState state, float rpm) {
+    int64_t now = esp_timer_get_time();
+    if (gc_state.modal.spindle == SpindleState::Disable || bit_istrue(sys.suspend, SUSPEND_RESTART_RETRACT)) {
+        return now;
+    }
+    if (laser_mode->get()) {
+        // When in laser mode, ignore spindle spin-up delay. Set to turn on laser when cycle starts.
+        bit_true(sys.step_control, STEP_CONTROL_UPDATE_SPINDLE_RPM);
+        return now;
+    }
+    spindle->set_state(state, (uint32_t)rpm);  // Does not wait during a suspend
+    return now + int64_t(SAFETY_DOOR_SPINDLE_DELAY * 1000000);
+}
+
+// Restarts the coolant for a safety door resume. Returns when it will be on.
+static int64_t protocol_restore_coolant(CoolantState state) {
+    int64_t now = esp_timer_get_time();
+    if (!(gc_state.modal.coolant.Flood || gc_state.modal.coolant.Mist) || bit_istrue(sys.suspend, SUSPEND_RESTART_RETRACT)) {
+        return now;
+    }
+    // NOTE: Laser mode will honor this delay. An exhaust system is often controlled by this pin.
+    coolant_set_state(state);
+    return now + int64_t(SAFETY_DOOR_COOLANT_DELAY * 1000000);
+}
+
+// Waits like delay_sec() in a suspend until both times have passed. The spindle time ends early once a
+// spindle with speed feedback is within $Spindle/AtSpeed/Tolerance of rpm.
+static void protocol_restore_wait(int64_t spindle_us, int64_t coolant_us, uint32_t rpm) {
+    float   tolerance_percent = spindle_at_speed_tolerance->get();
+    bool    feedback          = rpm && spindle->has_speed_feedback() && tolerance_percent > 0.0;
+    int32_t tolerance         = rpm * tolerance_percent / 100.0;
+    while (!sys.abort && bit_isfalse(sys.suspend, SUSPEND_RESTART_RETRACT)) {
+        int64_t now = esp_timer_get_time();
+        if (feedback && now < spindle_us && abs(int32_t(spindle->measured_rpm()) - int32_t(rpm)) <= tolerance) {
+            spindle_us = now;
+        }
+        if (now >= spindle_us && now >= coolant_us) {
+            return;
+        }
+        protocol_exec_rt_system();  // Only rt_system(), to avoid nesting suspend loops
+        delay(DWELL_TIME_STEP);
+    }
+}
+#endif
+
 bool can_park() {
     return
 #ifdef ENABLE_PARKING_OVERRIDE_CONTROL
@@ -135,69 +285,105 @@ void protocol_main_loop() {
     // Primary loop! Upon a system abort, this exits back to main() to reset the system.
     // This is also where Grbl idles while waiting for something to do.
     // ---------------------------------------------------------------------------------
-    uint8_t c;
+    job_owner = CLIENT_ALL;
+    memset(waiting_since, 0, sizeof(waiting_since));
+    task_stats_register();  // Only waits in idle_power_poll(), so it shows with its stack and all of its time running
     for (;;) {
+        // Pick up settings changed by the previous pass or by the WebUI task.
+        motion_config_refresh();
+#ifdef ENABLE_MACROS
+        macros_refresh();
+#endif
 #ifdef ENABLE_SD_CARD
-        if (SD_ready_next) {
+        // Keep SD lines coming while the planner has room, the way a streaming sender would, and
+        // only then go on to the other clients. SD_MAX_LINES_PER_LOOP bounds runs of non-motion lines.
+        for (int sd_lines = 0; SD_ready_next && sd_lines < SD_MAX_LINES_PER_LOOP && !plan_check_full_buffer(); sd_lines++) {
             char fileLine[255];
             if (readFileLine(fileLine, 255)) {
                 SD_ready_next = false;
-                report_status_message(gc_execute_line(fileLine, SD_client), SD_client);
+                report_status_message(sd_execute_line(fileLine, SD_client), SD_client);
             } else {
                 char temp[50];
                 sd_get_current_filename(temp);
+                sd_report_job_rate(SD_client);
                 grbl_notifyf("SD print done", "%s print is successful", temp);
+#    ifdef SD_CHECKPOINT
+                sd_checkpoint_clear();
+#    endif
                 closeFile();  // close file and clear SD ready/running flags
+#    ifdef ENABLE_JOB_STATS
+                job_stats_report(temp, SD_client);
+#    endif
+#    ifdef SD_JOB_QUEUE
+                sd_queue_next(SD_client);  // Reading goes on with the next job, if there is one
+#    endif
+            }
+            protocol_execute_realtime();  // Runtime command check point.
+            if (sys.abort) {
+                return;  // Bail to main() program loop to reset system.
             }
         }
+#    ifdef SD_CHECKPOINT
+        sd_checkpoint_poll();
+#    endif
+        sd_index_poll();
+#    ifdef ENABLE_SIMULATOR
+        sim_execute();
+        if (sys.abort) {
+            return;  // Bail to main() program loop to reset system.
+        }
+#    endif
 #endif
-        // Receive one line of incoming serial data, as the data becomes available.
+        // Receive lines of incoming serial data, as the data becomes available.
         // Filtering, if necessary, is done later in gc_execute_line(), so the
         // filtering is the same with serial and file input.
-        uint8_t client = CLIENT_SERIAL;
-        char*   line;
-        for (client = 0; client < CLIENT_COUNT; client++) {
-            while ((c = serial_read(client)) != SERIAL_NO_DATA) {
-                Error res = add_char_to_line(c, client);
-                switch (res) {
-                    case Error::Ok:
-                        break;
-                    case Error::Eol:
-                        protocol_execute_realtime();  // Runtime command check point.
-                        if (sys.abort) {
-                            return;  // Bail to calling function upon system abort
-                        }
-                        line = client_lines[client].buffer;
-#ifdef REPORT_ECHO_RAW_LINE_RECEIVED
-                        report_echo_line_received(line, client);
-#endif
-                        // auth_level can be upgraded by supplying a password on the command line
-                        report_status_message(execute_line(line, client, WebUI::AuthenticationLevel::LEVEL_GUEST), client);
-                        empty_line(client);
-                        break;
-                    case Error::Overflow:
-                        report_status_message(Error::Overflow, client);
-                        empty_line(client);
-                        break;
-                    default:
-                        break;
-                }
-            }  // while serial read
-        }      // for clients
+        // The client that owns the running job goes first with the larger share, so a chatty
+        // client cannot hold up a streaming job; the others get a bounded slice each.
+        if (job_owner != CLIENT_ALL && plan_get_current_block() == NULL && sys.state == State::Idle) {
+            job_owner = CLIENT_ALL;
+        }
+        uint8_t owner = job_owner;
+        if (owner != CLIENT_ALL && !protocol_service_client(owner, PROTOCOL_OWNER_LINES, 0)) {
+            return;
+        }
+        for (uint8_t client = 0; client < CLIENT_COUNT; client++) {
+            if (client == owner) {
+                continue;
+            }
+            bool ok = (owner == CLIENT_ALL) ? protocol_service_client(client, PROTOCOL_OWNER_LINES, 0)
+                                            : protocol_service_client(client, PROTOCOL_CLIENT_LINES, PROTOCOL_CLIENT_SLICE_US);
+            if (!ok) {
+                return;
+            }
+        }
+#ifdef ENABLE_MACROS
+        macros_execute_pending();
+        if (sys.abort) {
+            return;  // Bail to main() program loop to reset system.
+        }
+#endif
         // If there are no more characters in the serial read buffer to be processed and executed,
         // this indicates that g-code streaming has either filled the planner buffer or has
         // completed. In either case, auto-cycle start, if enabled, any queued moves.
+#ifdef PATH_BLENDING
+        // A held G64 move may wait for the next line only while the planner has enough to run.
+        if (plan_get_block_buffer_count() < BLEND_FLUSH_BLOCKS) {
+            blend_flush();
+            if (sys.abort) {
+                return;  // Bail to main() program loop to reset system.
+            }
+        }
+#endif
         protocol_auto_cycle_start();
         protocol_execute_realtime();  // Runtime command check point.
         if (sys.abort) {
             return;  // Bail to main() program loop to reset system.
         }
-        // check to see if we should disable the stepper drivers ... esp32 work around for disable in main loop.
-        if (stepper_idle) {
-            if (esp_timer_get_time() > stepper_idle_counter) {
-                motors_set_disable(true);
-            }
-        }
+#ifdef COORDINATES_DEFERRED_WRITE
+        Coordinates::poll();
+#endif
+        warm_restart_poll();
+        idle_power_poll();  // Waits here while the machine stands idle
     }
     return; /* Never reached */
 }
@@ -205,6 +391,13 @@ void protocol_main_loop() {
 // Block until all buffered steps are executed or in a cycle state. Works with feed hold
 // during a synchronize call, if it should happen. Also, waits for clean cycle end.
 void protocol_buffer_synchronize() {
+#ifdef PATH_BLENDING
+    blend_flush();  // The held G64 move is part of the buffer
+#endif
+    if (sim_active()) {
+        sim_drain(true);  // Nothing runs the blocks, the simulation drops them
+        return;
+    }
     // If system is queued, ensure cycle resumes if the auto start flag is present.
     protocol_auto_cycle_start();
     do {
@@ -212,7 +405,18 @@ void protocol_buffer_synchronize() {
         if (sys.abort) {
             return;  // Check for system abort
         }
+#ifdef MOTION_PIPELINE
+        protocol_auto_cycle_start();  // The motion task may plan queued moves after the call above
+    } while (plan_get_current_block() || (sys.state == State::Cycle) || !mc_pipeline_empty());
+#else
     } while (plan_get_current_block() || (sys.state == State::Cycle));
+#endif
+#ifdef SYNC_USER_OUTPUTS
+    sys_output_events_fire_pending();  // Synchronized outputs with no move after them switch here
+#endif
+#ifdef SPINDLE_STATE_IN_PLANNER
+    plan_apply_deferred_state();  // As does a spindle or coolant change
+#endif
 }
 
 // Auto-cycle start triggers when there is a motion ready to execute and if the main program is not
@@ -222,6 +426,11 @@ void protocol_buffer_synchronize() {
 // is finished, single commands), a command that needs to wait for the motions in the buffer to
 // execute calls a buffer sync, or the planner buffer is full and ready to go.
 void protocol_auto_cycle_start() {
+#if defined(ENABLE_WIFI) && defined(ENABLE_NETWORK_SYNC)
+    if (WebUI::network_sync.holding()) {
+        return;  // The cycle starts at the synchronized moment
+    }
+#endif
     if (plan_get_current_block() != NULL) {            // Check if there are any blocks in the buffer.
         system_set_exec_state_flag(EXEC_CYCLE_START);  // If so, execute them!
     }
@@ -240,11 +449,127 @@ void protocol_auto_cycle_start() {
 // limit switches, or the main program.
 void protocol_execute_realtime() {
     protocol_exec_rt_system();
+#ifdef ENABLE_AUX_STREAM
+    st_aux_wake_up();
+#endif
     if (sys.suspend) {
         protocol_exec_rt_suspend();
     }
 }
 
+// Applies feed and rapid override commands, given as EXEC_FEED_OVR_* and EXEC_RAPID_OVR_* bits.
+static void protocol_exec_motion_override(uint8_t rt_exec) {
+    uint8_t new_f_override = sys.f_override;
+    if (rt_exec & EXEC_FEED_OVR_RESET) {
+        new_f_override = DEFAULT_FEED_OVERRIDE;
+    }
+    if (rt_exec & EXEC_FEED_OVR_COARSE_PLUS) {
+        new_f_override += FEED_OVERRIDE_COARSE_INCREMENT;
+    }
+    if (rt_exec & EXEC_FEED_OVR_COARSE_MINUS) {
+        new_f_override -= FEED_OVERRIDE_COARSE_INCREMENT;
+    }
+    if (rt_exec & EXEC_FEED_OVR_FINE_PLUS) {
+        new_f_override += FEED_OVERRIDE_FINE_INCREMENT;
+    }
+    if (rt_exec & EXEC_FEED_OVR_FINE_MINUS) {
+        new_f_override -= FEED_OVERRIDE_FINE_INCREMENT;
+    }
+    new_f_override         = MIN(new_f_override, MAX_FEED_RATE_OVERRIDE);
+    new_f_override         = MAX(new_f_override, MIN_FEED_RATE_OVERRIDE);
+    uint8_t new_r_override = sys.r_override;
+    if (rt_exec & EXEC_RAPID_OVR_RESET) {
+        new_r_override = DEFAULT_RAPID_OVERRIDE;
+    }
+    if (rt_exec & EXEC_RAPID_OVR_MEDIUM) {
+        new_r_override = RAPID_OVERRIDE_MEDIUM;
+    }
+    if (rt_exec & EXEC_RAPID_OVR_LOW) {
+        new_r_override = RAPID_OVERRIDE_LOW;
+    }
+    if ((new_f_override != sys.f_override) || (new_r_override != sys.r_override)) {
+        sys.f_override         = new_f_override;
+        sys.r_override         = new_r_override;
+        sys.report_ovr_counter = 0;  // Set to report change immediately
+#ifdef PLANNER_LAZY_OVERRIDES
+        plan_override_changed();
+#else
+        plan_update_velocity_profile_parameters();
+        plan_cycle_reinitialize();
+#endif
+    }
+}
+
+// Applies spindle and coolant override commands, given as EXEC_SPINDLE_OVR_* and EXEC_COOLANT_* bits.
+static void protocol_exec_accessory_override(uint8_t rt_exec) {
+    // NOTE: Unlike motion overrides, spindle overrides do not require a planner reinitialization.
+    uint8_t last_s_override = sys.spindle_speed_ovr;
+    if (rt_exec & EXEC_SPINDLE_OVR_RESET) {
+        last_s_override = DEFAULT_SPINDLE_SPEED_OVERRIDE;
+    }
+    if (rt_exec & EXEC_SPINDLE_OVR_COARSE_PLUS) {
+        last_s_override += SPINDLE_OVERRIDE_COARSE_INCREMENT;
+    }
+    if (rt_exec & EXEC_SPINDLE_OVR_COARSE_MINUS) {
+        last_s_override -= SPINDLE_OVERRIDE_COARSE_INCREMENT;
+    }
+    if (rt_exec & EXEC_SPINDLE_OVR_FINE_PLUS) {
+        last_s_override += SPINDLE_OVERRIDE_FINE_INCREMENT;
+    }
+    if (rt_exec & EXEC_SPINDLE_OVR_FINE_MINUS) {
+        last_s_override -= SPINDLE_OVERRIDE_FINE_INCREMENT;
+    }
+    last_s_override = MIN(last_s_override, MAX_SPINDLE_SPEED_OVERRIDE);
+    last_s_override = MAX(last_s_override, MIN_SPINDLE_SPEED_OVERRIDE);
+    if (last_s_override != sys.spindle_speed_ovr) {
+        bit_true(sys.step_control, STEP_CONTROL_UPDATE_SPINDLE_RPM);
+        sys.spindle_speed_ovr  = last_s_override;
+        sys.report_ovr_counter = 0;  // Set to report change immediately
+        // If spinlde is on, tell it the rpm has been overridden
+        if (gc_state.modal.spindle != SpindleState::Disable) {
+            spindle->set_rpm(gc_state.spindle_speed);
+        }
+    }
+    if (rt_exec & EXEC_SPINDLE_OVR_STOP) {
+        // Spindle stop override allowed only while in HOLD state.
+        // NOTE: Report counters are set in spindle_set_state() when spindle stop is executed.
+        if (sys.state == State::Hold) {
+            if (!(sys.spindle_stop_ovr)) {
+                sys.spindle_stop_ovr = SPINDLE_STOP_OVR_INITIATE;
+            } else if (sys.spindle_stop_ovr & SPINDLE_STOP_OVR_ENABLED) {
+                sys.spindle_stop_ovr |= SPINDLE_STOP_OVR_RESTORE;
+            }
+        }
+    }
+    // NOTE: Since coolant state always performs a planner sync whenever it changes, the current
+    // run state can be determined by checking the parser state.
+    if (rt_exec & (EXEC_COOLANT_FLOOD_OVR_TOGGLE | EXEC_COOLANT_MIST_OVR_TOGGLE)) {
+        if (sys.state == State::Idle || sys.state == State::Cycle || sys.state == State::Hold) {
+            CoolantState coolant_state = gc_state.modal.coolant;
+#ifdef COOLANT_FLOOD_PIN
+            if (rt_exec & EXEC_COOLANT_FLOOD_OVR_TOGGLE) {
+                if (coolant_state.Flood) {
+                    coolant_state.Flood = 0;
+                } else {
+                    coolant_state.Flood = 1;
+                }
+            }
+#endif
+#ifdef COOLANT_MIST_PIN
+            if (rt_exec & EXEC_COOLANT_MIST_OVR_TOGGLE) {
+                if (coolant_state.Mist) {
+                    coolant_state.Mist = 0;
+                } else {
+                    coolant_state.Mist = 1;
+                }
+            }
+#endif
+            coolant_set_state(coolant_state);  // Report counter set in coolant_set_state().
+            gc_state.modal.coolant = coolant_state;
+        }
+    }
+}
+
 // Executes run-time commands, when required. This function primarily operates as Grbl's state
 // machine and controls the various real-time features Grbl has to offer.
 // NOTE: Do not alter this unless you know exactly what you are doing!
@@ -275,7 +600,10 @@ void protocol_exec_rt_system() {
         // Execute system abort.
         if (rt_exec & EXEC_RESET) {
             sys.abort = true;  // Only place this is set true.
-            return;            // Nothing else to do but exit.
+#ifdef ENABLE_REALTIME_TRACE
+            rt_trace_hop(RtCmd::Reset, RtHop::Protocol, true);
+#endif
+            return;  // Nothing else to do but exit.
         }
         // Execute and serial print status
         if (rt_exec & EXEC_STATUS_REPORT) {
@@ -285,6 +613,9 @@ void protocol_exec_rt_system() {
         // NOTE: Once hold is initiated, the system immediately enters a suspend state to block all
         // main program processes until either reset or resumed. This ensures a hold completes safely.
         if (rt_exec & (EXEC_MOTION_CANCEL | EXEC_FEED_HOLD | EXEC_SAFETY_DOOR | EXEC_SLEEP)) {
+#ifdef ENABLE_REALTIME_TRACE
+            bool was_holding = sys.step_control & STEP_CONTROL_EXECUTE_HOLD;
+#endif
             // State check for allowable states for hold methods.
             if (!(sys.state == State::Alarm || sys.state == State::CheckMode)) {
                 // If in CYCLE or JOG states, immediately initiate a motion HOLD.
@@ -352,6 +683,16 @@ void protocol_exec_rt_system() {
                     sys.suspend |= SUSPEND_SAFETY_DOOR_AJAR;
                 }
             }
+#ifdef ENABLE_REALTIME_TRACE
+            // A hold or cancel that started a deceleration is traced on to st_prep_buffer().
+            bool decelerating = !was_holding && (sys.step_control & STEP_CONTROL_EXECUTE_HOLD);
+            if (rt_exec & EXEC_FEED_HOLD) {
+                rt_trace_hop(RtCmd::FeedHold, RtHop::Protocol, !decelerating);
+            }
+            if (rt_exec & EXEC_MOTION_CANCEL) {
+                rt_trace_hop(RtCmd::JogCancel, RtHop::Protocol, !decelerating);
+            }
+#endif
             if (rt_exec & EXEC_SLEEP) {
                 if (sys.state == State::Alarm) {
                     sys.suspend |= (SUSPEND_RETRACT_COMPLETE | SUSPEND_HOLD_COMPLETE);
@@ -398,6 +739,9 @@ void protocol_exec_rt_system() {
                 }
             }
             system_clear_exec_state_flag(EXEC_CYCLE_START);
+#ifdef ENABLE_REALTIME_TRACE
+            rt_trace_hop(RtCmd::CycleStart, RtHop::Protocol, true);
+#endif
         }
         if (cycle_stop) {
             // Reinitializes the cycle plan and stepper system after a feed hold for a resume. Called by
@@ -417,7 +761,12 @@ void protocol_exec_rt_system() {
             } else {
                 // Motion complete. Includes CYCLE/JOG/HOMING states and jog cancel/motion cancel/soft limit events.
                 // NOTE: Motion and jog cancel both immediately return to idle after the hold completes.
+#ifdef JOG_VELOCITY_MODE
+                // A velocity jog ends the same way. Its steps bypassed the planner.
+                if ((sys.suspend & SUSPEND_JOG_CANCEL) || st_jog_velocity_active()) {
+#else
                 if (sys.suspend & SUSPEND_JOG_CANCEL) {  // For jog cancel, flush buffers and sync positions.
+#endif
                     sys.step_control = STEP_CONTROL_NORMAL_OP;
                     plan_reset();
                     st_reset();
@@ -431,120 +780,41 @@ void protocol_exec_rt_system() {
                 } else {
                     sys.suspend = SUSPEND_DISABLE;
                     sys.state   = State::Idle;
+#ifdef SPINDLE_STATE_IN_PLANNER
+                    plan_apply_deferred_state();  // A trailing M5 or M9 must not wait for the next line
+#endif
                 }
             }
             cycle_stop = false;
         }
     }
     // Execute overrides.
+#ifdef REALTIME_EVENT_QUEUE
+    // Queued commands run one at a time, in the order they came, so repeated steps all count.
+    rt_event_t event;
+    while (system_pop_exec_event(&event)) {
+        switch (event.group) {
+            case RtGroup::MotionOverride:
+                protocol_exec_motion_override(event.mask);
+                break;
+            case RtGroup::AccessoryOverride:
+                protocol_exec_accessory_override(event.mask);
+                break;
+        }
+    }
+#endif
     rt_exec = sys_rt_exec_motion_override;  // Copy volatile sys_rt_exec_motion_override
     if (rt_exec) {
         system_clear_exec_motion_overrides();  // Clear all motion override flags.
-        uint8_t new_f_override = sys.f_override;
-        if (rt_exec & EXEC_FEED_OVR_RESET) {
-            new_f_override = DEFAULT_FEED_OVERRIDE;
-        }
-        if (rt_exec & EXEC_FEED_OVR_COARSE_PLUS) {
-            new_f_override += FEED_OVERRIDE_COARSE_INCREMENT;
-        }
-        if (rt_exec & EXEC_FEED_OVR_COARSE_MINUS) {
-            new_f_override -= FEED_OVERRIDE_COARSE_INCREMENT;
-        }
-        if (rt_exec & EXEC_FEED_OVR_FINE_PLUS) {
-            new_f_override += FEED_OVERRIDE_FINE_INCREMENT;
-        }
-        if (rt_exec & EXEC_FEED_OVR_FINE_MINUS) {
-            new_f_override -= FEED_OVERRIDE_FINE_INCREMENT;
-        }
-        new_f_override         = MIN(new_f_override, MAX_FEED_RATE_OVERRIDE);
-        new_f_override         = MAX(new_f_override, MIN_FEED_RATE_OVERRIDE);
-        uint8_t new_r_override = sys.r_override;
-        if (rt_exec & EXEC_RAPID_OVR_RESET) {
-            new_r_override = DEFAULT_RAPID_OVERRIDE;
-        }
-        if (rt_exec & EXEC_RAPID_OVR_MEDIUM) {
-            new_r_override = RAPID_OVERRIDE_MEDIUM;
-        }
-        if (rt_exec & EXEC_RAPID_OVR_LOW) {
-            new_r_override = RAPID_OVERRIDE_LOW;
-        }
-        if ((new_f_override != sys.f_override) || (new_r_override != sys.r_override)) {
-            sys.f_override         = new_f_override;
-            sys.r_override         = new_r_override;
-            sys.report_ovr_counter = 0;  // Set to report change immediately
-            plan_update_velocity_profile_parameters();
-            plan_cycle_reinitialize();
-        }
+        protocol_exec_motion_override(rt_exec);
     }
+#ifdef PLANNER_LAZY_OVERRIDES
+    plan_replan_overrides();
+#endif
     rt_exec = sys_rt_exec_accessory_override;
     if (rt_exec) {
         system_clear_exec_accessory_overrides();  // Clear all accessory override flags.
-        // NOTE: Unlike motion overrides, spindle overrides do not require a planner reinitialization.
-        uint8_t last_s_override = sys.spindle_speed_ovr;
-        if (rt_exec & EXEC_SPINDLE_OVR_RESET) {
-            last_s_override = DEFAULT_SPINDLE_SPEED_OVERRIDE;
-        }
-        if (rt_exec & EXEC_SPINDLE_OVR_COARSE_PLUS) {
-            last_s_override += SPINDLE_OVERRIDE_COARSE_INCREMENT;
-        }
-        if (rt_exec & EXEC_SPINDLE_OVR_COARSE_MINUS) {
-            last_s_override -= SPINDLE_OVERRIDE_COARSE_INCREMENT;
-        }
-        if (rt_exec & EXEC_SPINDLE_OVR_FINE_PLUS) {
-            last_s_override += SPINDLE_OVERRIDE_FINE_INCREMENT;
-        }
-        if (rt_exec & EXEC_SPINDLE_OVR_FINE_MINUS) {
-            last_s_override -= SPINDLE_OVERRIDE_FINE_INCREMENT;
-        }
-        last_s_override = MIN(last_s_override, MAX_SPINDLE_SPEED_OVERRIDE);
-        last_s_override = MAX(last_s_override, MIN_SPINDLE_SPEED_OVERRIDE);
-        if (last_s_override != sys.spindle_speed_ovr) {
-            bit_true(sys.step_control, STEP_CONTROL_UPDATE_SPINDLE_RPM);
-            sys.spindle_speed_ovr  = last_s_override;
-            sys.report_ovr_counter = 0;  // Set to report change immediately
-            // If spinlde is on, tell it the rpm has been overridden
-            if (gc_state.modal.spindle != SpindleState::Disable) {
-                spindle->set_rpm(gc_state.spindle_speed);
-            }
-        }
-        if (rt_exec & EXEC_SPINDLE_OVR_STOP) {
-            // Spindle stop override allowed only while in HOLD state.
-            // NOTE: Report counters are set in spindle_set_state() when spindle stop is executed.
-            if (sys.state == State::Hold) {
-                if (!(sys.spindle_stop_ovr)) {
-                    sys.spindle_stop_ovr = SPINDLE_STOP_OVR_INITIATE;
-                } else if (sys.spindle_stop_ovr & SPINDLE_STOP_OVR_ENABLED) {
-                    sys.spindle_stop_ovr |= SPINDLE_STOP_OVR_RESTORE;
-                }
-            }
-        }
-        // NOTE: Since coolant state always performs a planner sync whenever it changes, the current
-        // run state can be determined by checking the parser state.
-        if (rt_exec & (EXEC_COOLANT_FLOOD_OVR_TOGGLE | EXEC_COOLANT_MIST_OVR_TOGGLE)) {
-            if (sys.state == State::Idle || sys.state == State::Cycle || sys.state == State::Hold) {
-                CoolantState coolant_state = gc_state.modal.coolant;
-#ifdef COOLANT_FLOOD_PIN
-                if (rt_exec & EXEC_COOLANT_FLOOD_OVR_TOGGLE) {
-                    if (coolant_state.Flood) {
-                        coolant_state.Flood = 0;
-                    } else {
-                        coolant_state.Flood = 1;
-                    }
-                }
-#endif
-#ifdef COOLANT_MIST_PIN
-                if (rt_exec & EXEC_COOLANT_MIST_OVR_TOGGLE) {
-                    if (coolant_state.Mist) {
-                        coolant_state.Mist = 0;
-                    } else {
-                        coolant_state.Mist = 1;
-                    }
-                }
-#endif
-                coolant_set_state(coolant_state);  // Report counter set in coolant_set_state().
-                gc_state.modal.coolant = coolant_state;
-            }
-        }
+        protocol_exec_accessory_override(rt_exec);
     }
 #ifdef DEBUG
     if (sys_rt_exec_debug) {
@@ -689,6 +959,11 @@ static void protocol_exec_rt_suspend() {
                     }
                     // Handles parking restore and safety door resume.
                     if (sys.suspend & SUSPEND_INITIATE_RESTORE) {
+#ifdef SAFETY_DOOR_OVERLAP_RESTORE
+                        // The spindle and coolant come up while the machine moves back to the pull-out position.
+                        int64_t spindle_ready_us = protocol_restore_spindle(restore_spindle, restore_spindle_speed);
+                        int64_t coolant_ready_us = protocol_restore_coolant(restore_coolant);
+#endif
 #ifdef PARKING_ENABLE
                         // Execute fast restore motion to the pull-out position. Parking requires homing enabled.
                         // NOTE: State is will remain DOOR, until the de-energizing and retract is complete.
@@ -701,6 +976,9 @@ static void protocol_exec_rt_suspend() {
                             }
                         }
 #endif
+#ifdef SAFETY_DOOR_OVERLAP_RESTORE
+                        protocol_restore_wait(spindle_ready_us, coolant_ready_us, laser_mode->get() ? 0 : uint32_t(restore_spindle_speed));
+#else
                         // Delayed Tasks: Restart spindle and coolant, delay to power-up, then resume cycle.
                         if (gc_state.modal.spindle != SpindleState::Disable) {
                             // Block if safety door re-opened during prior restore actions.
@@ -722,6 +1000,7 @@ static void protocol_exec_rt_suspend() {
                                 delay_sec(SAFETY_DOOR_COOLANT_DELAY, DELAY_MODE_SYS_SUSPEND);
                             }
                         }
+#endif
 #ifdef PARKING_ENABLE
                         // Execute slow plunge motion from pull-out position to resume position.
                         if (can_park()) {
@@ -34,6 +34,35 @@
 #    define LINE_BUFFER_SIZE 80
 #endif
 
+// Lines the job owner, the client whose line started the current motion, may run per main loop pass.
+// Clients without a job run this many too while no client owns a job.
+#ifndef PROTOCOL_OWNER_LINES
+#    define PROTOCOL_OWNER_LINES 16
+#endif
+
+// Lines and microseconds the other clients may use per pass while a client owns a job. A line that is
+// already being executed always completes.
+#ifndef PROTOCOL_CLIENT_LINES
+#    define PROTOCOL_CLIENT_LINES 2
+#endif
+#ifndef PROTOCOL_CLIENT_SLICE_US
+#    define PROTOCOL_CLIENT_SLICE_US 2000
+#endif
+
+// How long each client's lines waited with input pending before the main loop ran them.
+typedef struct {
+    uint32_t lines;
+    uint32_t last_us;
+    uint32_t max_us;
+    uint64_t total_us;
+} protocol_client_stats_t;
+
+const protocol_client_stats_t* protocol_get_client_stats(uint8_t client);
+void                           protocol_reset_client_stats();
+
+// The client that owns the running job, or CLIENT_ALL if there is none.
+uint8_t protocol_get_job_owner();
+
 // Starts Grbl main loop. It handles all incoming characters from the serial port and executes
 // them as they complete. It is also responsible for finishing the initialization procedures.
 void protocol_main_loop();
@@ -0,0 +1,70 @@
+/*
+  Raster.cpp - laser scanlines with per-pixel power, executed by the step generator
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_LASER_RASTER
+
+static DRAM_ATTR raster_line_t raster_lines[RASTER_LINES];
+static uint8_t                 raster_next;  // Where raster_alloc() starts looking
+
+void raster_reset() {
+    for (uint8_t i = 0; i < RASTER_LINES; i++) {
+        raster_lines[i].state = RasterState::Free;
+    }
+    raster_next = 0;
+}
+
+void raster_flush() {
+    for (uint8_t i = 0; i < RASTER_LINES; i++) {
+        if (raster_lines[i].state == RasterState::Planned) {
+            raster_lines[i].state = RasterState::Free;
+        }
+    }
+}
+
+raster_line_t* raster_alloc() {
+    for (uint8_t n = 0; n < RASTER_LINES; n++) {
+        raster_line_t* line = &raster_lines[raster_next];
+        if (++raster_next == RASTER_LINES) {
+            raster_next = 0;
+        }
+        if (line->state == RasterState::Free) {
+            line->state = RasterState::Filled;
+            return line;
+        }
+    }
+    return NULL;
+}
+
+void raster_prepare(raster_line_t* line, float power, bool enabled) {
+    Spindles::PWM* fast_spindle = spindle->fast_output();
+    uint32_t       off          = fast_spindle->off_duty();
+    for (uint16_t i = 0; i < line->n_pixels; i++) {
+        uint8_t pixel = line->pixels[i];
+        line->duty[i] = (enabled && pixel) ? fast_spindle->rpm_to_duty(power * pixel / 255.0) : off;
+    }
+}
+
+void raster_planned(raster_line_t* line, uint32_t steps) {
+    line->steps = steps;
+    line->pitch = (uint64_t(steps) << RASTER_PITCH_SHIFT) / line->n_pixels;
+    line->state = RasterState::Planned;
+}
+
+#endif
@@ -0,0 +1,89 @@
+#pragma once
+
+/*
+  Raster.h - laser scanlines with per-pixel power, executed by the step generator
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  A scanline is one planner block along a single axis. Its pixels are converted to output duties when
+  the line is planned, and the step ISR switches to the next pixel on the raster axis steps. The
+  planner and the segment prep see an ordinary line, so a few hundred pixels cost one block instead
+  of a few hundred g-code lines.
+
+  Lines live in a small pool. The binary stream fills a free line from a raster record, the planner
+  marks it planned, and the step ISR frees it after the last step of the block. Power is not scaled
+  with the speed, so senders run the line at constant speed by adding unpowered overscan moves
+  before and after it.
+*/
+
+#include "Grbl.h"
+
+#ifndef ENABLE_BINARY_STREAM
+#    error "ENABLE_LASER_RASTER requires ENABLE_BINARY_STREAM"
+#endif
+#ifdef USE_KINEMATICS
+#    error "ENABLE_LASER_RASTER does not support USE_KINEMATICS"
+#endif
+
+// Lines that can be queued or planned at once. Each holds RASTER_MAX_PIXELS pixels.
+#ifndef RASTER_LINES
+#    define RASTER_LINES 8
+#endif
+
+// Pixels that fit in one binary frame after the raster record header.
+const uint16_t RASTER_MAX_PIXELS = 238;
+
+// Fraction bits of the per-pixel step pitch.
+const int RASTER_PITCH_SHIFT = 16;
+
+enum class RasterState : uint8_t {
+    Free = 0,
+    Filled,   // Pixels received, waiting for the main loop
+    Planned,  // Owned by a planner block until the step ISR finishes it
+};
+
+struct raster_line_t {
+    volatile RasterState state;
+    uint8_t              axis;      // Axis the line runs along
+    uint16_t             n_pixels;
+    uint32_t             steps;     // Raster axis steps of the planned block
+    uint32_t             pitch;     // Raster axis steps per pixel, in 1/2^RASTER_PITCH_SHIFT
+    uint8_t              pixels[RASTER_MAX_PIXELS];
+    uint32_t             duty[RASTER_MAX_PIXELS];  // Output duty per pixel, set by raster_prepare()
+};
+
+// Drops every line. Called on reset, with the record queue.
+void raster_reset();
+
+// Frees the lines owned by planner blocks. Called by st_reset(), which is always followed by a planner
+// reset.
+void raster_flush();
+
+// Returns a free line for the caller to fill, or NULL when all lines are in use. Called by the
+// serial task only.
+raster_line_t* raster_alloc();
+
+// Converts the pixels to output duties, with pixel value 255 at power. Called by the main loop just
+// before the line is planned, so the spindle override in effect then applies.
+void raster_prepare(raster_line_t* line, float power, bool enabled);
+
+// Marks the line as owned by a planned block of steps raster axis steps. Called by the planner.
+void raster_planned(raster_line_t* line, uint32_t steps);
+
+inline void raster_release(raster_line_t* line) {
+    line->state = RasterState::Free;
+}
@@ -0,0 +1,102 @@
+/*
+  RealtimeTrace.cpp - latency of realtime commands from arrival to effect
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_REALTIME_TRACE
+
+typedef struct {
+    int64_t       start_us;  // Arrival
+    int64_t       last_us;   // End of the last hop
+    volatile bool active;
+    RtHop         next;  // Hops before it are done
+} rt_trace_t;
+
+static rt_trace_t      rt_traces[int(RtCmd::Count)];
+static rt_trace_hist_t rt_hists[int(RtCmd::Count)][int(RtHop::Count)];
+
+static void IRAM_ATTR rt_trace_add(RtCmd cmd, RtHop hop, int64_t us) {
+    rt_trace_hist_t* hist = &rt_hists[int(cmd)][int(hop)];
+    uint32_t         t    = us > 0 ? uint32_t(us) : 0;
+    uint32_t         bin  = t ? 32 - __builtin_clz(t) : 0;
+    hist->histogram[bin < RT_TRACE_BINS ? bin : RT_TRACE_BINS - 1]++;
+    hist->count++;
+    hist->total_us += t;
+    if (t > hist->max_us) {
+        hist->max_us = t;
+    }
+}
+
+void rt_trace_start(uint8_t command, int64_t arrival_us) {
+    RtCmd cmd;
+    switch (command) {
+        case CMD_FEED_HOLD:
+            cmd = RtCmd::FeedHold;
+            break;
+        case CMD_CYCLE_START:
+            cmd = RtCmd::CycleStart;
+            break;
+        case CMD_RESET:
+            cmd = RtCmd::Reset;
+            break;
+        case CMD_JOG_CANCEL:
+            if (sys.state != State::Jog) {
+                return;  // Ignored by execute_realtime_command()
+            }
+            cmd = RtCmd::JogCancel;
+            break;
+        default:
+            return;
+    }
+    rt_trace_begin(cmd, arrival_us);
+}
+
+void IRAM_ATTR rt_trace_begin(RtCmd cmd, int64_t arrival_us) {
+    rt_trace_t* trace = &rt_traces[int(cmd)];
+    trace->active     = false;
+    trace->start_us   = arrival_us;
+    trace->last_us    = arrival_us;
+    trace->next       = RtHop::Read;
+    trace->active     = true;
+    rt_trace_hop(cmd, RtHop::Read, false);
+}
+
+void IRAM_ATTR rt_trace_hop(RtCmd cmd, RtHop hop, bool last) {
+    rt_trace_t* trace = &rt_traces[int(cmd)];
+    if (!trace->active || trace->next != hop) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    rt_trace_add(cmd, hop, now - trace->last_us);
+    trace->last_us = now;
+    trace->next    = RtHop(int(hop) + 1);
+    if (last) {
+        rt_trace_add(cmd, RtHop::Total, now - trace->start_us);
+        trace->active = false;
+    }
+}
+
+const rt_trace_hist_t* rt_trace_get(RtCmd cmd, RtHop hop) {
+    return &rt_hists[int(cmd)][int(hop)];
+}
+
+void rt_trace_reset() {
+    memset(rt_hists, 0, sizeof(rt_hists));
+}
+
+#endif
@@ -0,0 +1,74 @@
+#pragma once
+
+/*
+  RealtimeTrace.h - latency of realtime commands from arrival to effect
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Feed hold, cycle start, reset and jog cancel are timed at each hop on their way through Grbl. Each hop
+  and the whole way go into a histogram with bins of powers of two microseconds, so the worst case can
+  be read off together with how often it happens. A command that arrives while the previous one of its
+  kind is still on its way restarts the trace.
+
+  The trace of a feed hold or jog cancel that starts a deceleration ends when st_prep_buffer() plans it.
+  The segments prepared before that still run at the old speed, up to SEGMENT_BUFFER_SIZE of them.
+*/
+
+#include "Grbl.h"
+
+// Bin i counts the latencies below 2^i microseconds that do not fit bin i - 1. The last bin also counts
+// the longer ones.
+#ifndef RT_TRACE_BINS
+#    define RT_TRACE_BINS 20
+#endif
+
+enum class RtCmd : uint8_t {
+    FeedHold = 0,
+    CycleStart,
+    Reset,
+    JogCancel,
+    Count,
+};
+
+enum class RtHop : uint8_t {
+    Read = 0,  // Arrival at the interface to serialCheckTask reading it, or a pin edge to its debounce
+    Flag,      // To execute_realtime_command() returning. For a reset the motion has stopped then.
+    Protocol,  // To protocol_exec_rt_system() acting on the flag
+    Decel,     // To st_prep_buffer() planning the deceleration of a feed hold or jog cancel
+    Total,     // Arrival to the last hop
+    Count,
+};
+
+typedef struct {
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t histogram[RT_TRACE_BINS];
+} rt_trace_hist_t;
+
+// Starts the trace of a realtime command character that arrived at arrival_us and records its read hop.
+// Other characters are ignored.
+void rt_trace_start(uint8_t command, int64_t arrival_us);
+
+// The same for cmd from another source, such as a control pin with its edge at arrival_us. Safe in ISRs.
+void rt_trace_begin(RtCmd cmd, int64_t arrival_us);
+
+// Records the end of hop for cmd, if the trace of cmd waits for it. last ends the trace.
+void rt_trace_hop(RtCmd cmd, RtHop hop, bool last);
+
+const rt_trace_hist_t* rt_trace_get(RtCmd cmd, RtHop hop);
+void                   rt_trace_reset();
@@ -48,6 +48,7 @@
 
 #include "Grbl.h"
 #include <map>
+#include <cmath>
 
 #ifdef REPORT_HEAP
 EspClass esp;
@@ -55,14 +56,23 @@ EspClass esp;
 const int DEFAULTBUFFERSIZE = 64;
 
 // this is a generic send function that everything should use, so interfaces could be added (Bluetooth, etc)
-void grbl_send(uint8_t client, const char* text) {
+void grbl_send(uint8_t client, const char* text, OutputClass output_class) {
     if (client == CLIENT_INPUT) {
         return;
     }
+#ifdef ENABLE_ASYNC_OUTPUT
+    if (client_output_queue(client, text, strlen(text), output_class)) {
+        return;
+    }
+#endif
+    grbl_write(client, text);
+}
+
+// Writes text to the transports now. grbl_send() uses this directly unless output is queued.
+void grbl_write(uint8_t client, const char* text) {
 #ifdef ENABLE_BLUETOOTH
     if (WebUI::SerialBT.hasClient() && (client == CLIENT_BT || client == CLIENT_ALL)) {
-        WebUI::SerialBT.print(text);
-        //delay(10); // possible fix for dropped characters
+        WebUI::bt_config.write((const uint8_t*)text, strlen(text));
     }
 #endif
 #if defined(ENABLE_WIFI) && defined(ENABLE_HTTP) && defined(ENABLE_SERIAL2SOCKET_OUT)
@@ -74,9 +84,56 @@ void grbl_send(uint8_t client, const char* text) {
     if (client == CLIENT_TELNET || client == CLIENT_ALL) {
         WebUI::telnet_server.write((const uint8_t*)text, strlen(text));
     }
+#endif
+#if defined(ENABLE_WIFI) && defined(ENABLE_UDP_STREAM)
+    if (client == CLIENT_UDP || client == CLIENT_ALL) {
+        WebUI::udp_stream.write((const uint8_t*)text, strlen(text));
+    }
 #endif
     if (client == CLIENT_SERIAL || client == CLIENT_ALL) {
-        Serial.print(text);
+        serial_print(text);
+    }
+}
+
+static char         report_batch_buffer[REPORT_BATCH_SIZE];
+static bool         report_batch_in_use = false;
+static portMUX_TYPE report_batch_mux    = portMUX_INITIALIZER_UNLOCKED;
+
+ReportBatch::ReportBatch(uint8_t client) : _client(client), _buf(NULL), _len(0) {
+    portENTER_CRITICAL(&report_batch_mux);
+    if (!report_batch_in_use) {
+        report_batch_in_use = true;
+        _buf                = report_batch_buffer;
+    }
+    portEXIT_CRITICAL(&report_batch_mux);
+}
+
+ReportBatch::~ReportBatch() {
+    flush();
+    if (_buf) {
+        portENTER_CRITICAL(&report_batch_mux);
+        report_batch_in_use = false;
+        portEXIT_CRITICAL(&report_batch_mux);
+    }
+}
+
+void ReportBatch::add(const char* text) {
+    size_t len = strlen(text);
+    if (_len + len >= REPORT_BATCH_SIZE) {
+        flush();
+    }
+    if (!_buf || len >= REPORT_BATCH_SIZE) {
+        grbl_send(_client, text, OutputClass::Response);
+        return;
+    }
+    memcpy(_buf + _len, text, len + 1);
+    _len += len;
+}
+
+void ReportBatch::flush() {
+    if (_len) {
+        grbl_send(_client, _buf, OutputClass::Response);
+        _len = 0;
     }
 }
 
@@ -114,13 +171,19 @@ void grbl_msg_sendf(uint8_t client, MsgLevel level, const char* format, ...) {
     if (level > GRBL_MSG_LEVEL) {
         return;
     }
+    va_list arg;
+    va_start(arg, format);
+    grbl_msg_vsendf(client, format, arg);
+    va_end(arg);
+}
+
+// Sends a message that has passed the level filter
+void grbl_msg_vsendf(uint8_t client, const char* format, va_list arg) {
     char    loc_buf[100];
     char*   temp = loc_buf;
-    va_list arg;
     va_list copy;
-    va_start(arg, format);
     va_copy(copy, arg);
-    size_t len = vsnprintf(NULL, 0, format, arg);
+    size_t len = vsnprintf(NULL, 0, format, copy);
     va_end(copy);
     if (len >= sizeof(loc_buf)) {
         temp = new char[len + 1];
@@ -130,8 +193,7 @@ void grbl_msg_sendf(uint8_t client, MsgLevel level, const char* format, ...) {
     }
     len = vsnprintf(temp, len + 1, format, arg);
     grbl_sendf(client, "[MSG:%s]\r\n", temp);
-    va_end(arg);
-    if (len > 100) {
+    if (temp != loc_buf) {
         delete[] temp;
     }
 }
@@ -139,7 +201,7 @@ void grbl_msg_sendf(uint8_t client, MsgLevel level, const char* format, ...) {
 //function to notify
 void grbl_notify(const char* title, const char* msg) {
 #ifdef ENABLE_NOTIFICATIONS
-    WebUI::notificationsservice.sendMSG(title, msg);
+    WebUI::notificationsservice.queueMSG(title, msg);
 #endif
 }
 
@@ -169,47 +231,123 @@ void grbl_notifyf(const char* title, const char* format, ...) {
 static const int coordStringLen = 20;
 static const int axesStringLen = coordStringLen * MAX_N_AXIS;
 
-// formats axis values into a string and returns that string in rpt
-// NOTE: rpt should have at least size: axesStringLen
-static void report_util_axis_values(float* axis_value, char* rpt) {
-    uint8_t idx;
-    char    axisVal[coordStringLen];
-    float   unit_conv = 1.0;  // unit conversion multiplier..default is mm
-    const char* format = "%4.3f";  // Default - report mm to 3 decimal places
-    rpt[0]            = '\0';
-    if (report_inches->get()) {
-        unit_conv = 1.0 / MM_PER_INCH;
-        format = "%4.4f";  // Report inches to 4 decimal places
+// Builds a report in a caller supplied buffer. The write position is kept, so appending a field does
+// not rescan what is already there the way strcat() does, and numbers are formatted with integer
+// arithmetic instead of sprintf(). Anything that does not fit is dropped; the buffer stays terminated.
+class ReportWriter {
+public:
+    ReportWriter(char* buf, size_t size) : _buf(buf), _size(size), _len(0) { _buf[0] = '\0'; }
+
+    void add(char c) {
+        if (_len + 1 < _size) {
+            _buf[_len++] = c;
+            _buf[_len]   = '\0';
+        }
     }
-    auto n_axis = number_axis->get();
-    for (idx = 0; idx < n_axis; idx++) {
-        snprintf(axisVal, coordStringLen-1, format, axis_value[idx] * unit_conv);
-        strcat(rpt, axisVal);
-        if (idx < (number_axis->get() - 1)) {
-            strcat(rpt, ",");
+
+    void add(const char* s) {
+        while (*s && _len + 1 < _size) {
+            _buf[_len++] = *s++;
         }
+        _buf[_len] = '\0';
     }
-}
 
-// This version returns the axis values as a String
-static String report_util_axis_values(const float* axis_value) {
-    String rpt = "";
-    uint8_t idx;
-    char    axisVal[coordStringLen];
-    float   unit_conv = 1.0;  // unit conversion multiplier..default is mm
-    int decimals = 3;  // Default - report mm to 3 decimal places
-    if (report_inches->get()) {
-        unit_conv = 1.0 / MM_PER_INCH;
-        decimals = 4;  // Report inches to 4 decimal places
+    void add(const char* s, size_t n) {
+        while (n-- && *s && _len + 1 < _size) {
+            _buf[_len++] = *s++;
+        }
+        _buf[_len] = '\0';
     }
-    auto n_axis = number_axis->get();
-    for (idx = 0; idx < n_axis; idx++) {
-        rpt += String(axis_value[idx] * unit_conv, decimals);
-        if (idx < (number_axis->get() - 1)) {
-            rpt += ",";
+
+    void add_uint(uint32_t value) {
+        char    digits[10];
+        uint8_t n = 0;
+        do {
+            digits[n++] = '0' + value % 10;
+            value /= 10;
+        } while (value);
+        while (n) {
+            add(digits[--n]);
         }
     }
-    return rpt;
+
+    void add_int(int32_t value) {
+        if (value < 0) {
+            add('-');
+            add_uint(0 - uint32_t(value));
+        } else {
+            add_uint(value);
+        }
+    }
+
+    // Same text as printf("%.*f", decimals, value) for 0 to 5 decimals, including the rounding.
+    void add_fixed(float value, uint8_t decimals) {
+        static const uint32_t scale[] = { 1, 10, 100, 1000, 10000, 100000 };
+        if (!std::isfinite(value) || fabsf(value) >= 1e9 || decimals > 5) {
+            char temp[coordStringLen];
+            snprintf(temp, sizeof(temp), "%.*f", decimals, value);
+            add(temp);
+            return;
+        }
+        if (std::signbit(value)) {
+            add('-');
+            value = -value;
+        }
+        double   scaled = double(value) * scale[decimals];
+        uint64_t units  = uint64_t(scaled);
+        double   rest   = scaled - double(units);
+        if (rest > 0.5 || (rest == 0.5 && (units & 1))) {  // Round half to even, like printf
+            units++;
+        }
+        add_uint(uint32_t(units / scale[decimals]));
+        if (decimals) {
+            add('.');
+            uint32_t fraction = units % scale[decimals];
+            for (uint32_t digit = scale[decimals] / 10; digit; digit /= 10) {
+                add(char('0' + (fraction / digit) % 10));
+            }
+        }
+    }
+
+    // Comma separated axis values in the report units, mm to 3 decimals or inches to 4.
+    void add_axes(const float* axis_value) {
+        float   unit_conv = 1.0;  // unit conversion multiplier..default is mm
+        uint8_t decimals  = 3;    // Default - report mm to 3 decimal places
+        if (report_inches->get()) {
+            unit_conv = 1.0 / MM_PER_INCH;
+            decimals  = 4;  // Report inches to 4 decimal places
+        }
+        auto n_axis = number_axis->get();
+        for (uint8_t idx = 0; idx < n_axis; idx++) {
+            if (idx) {
+                add(',');
+            }
+            add_fixed(axis_value[idx] * unit_conv, decimals);
+        }
+    }
+
+    const char* c_str() const { return _buf; }
+    size_t      length() const { return _len; }
+
+private:
+    char*  _buf;
+    size_t _size;
+    size_t _len;
+};
+
+// formats axis values into a string and returns that string in rpt
+// NOTE: rpt should have at least size: axesStringLen
+static void report_util_axis_values(float* axis_value, char* rpt) {
+    ReportWriter writer(rpt, axesStringLen);
+    writer.add_axes(axis_value);
+}
+
+// This version returns the axis values as a String
+static String report_util_axis_values(const float* axis_value) {
+    char         rpt[axesStringLen];
+    ReportWriter writer(rpt, sizeof(rpt));
+    writer.add_axes(axis_value);
+    return String(rpt);
 }
 
 // Handles the primary confirmation protocol response for streaming interfaces and human-feedback.
@@ -218,6 +356,15 @@ static String report_util_axis_values(const float* axis_value) {
 // operation. Errors events can originate from the g-code parser, settings module, or asynchronously
 // from a critical error, such as a triggered hard limit. Interface should always monitor for these
 // responses.
+static void report_error_response(uint8_t client, Error status_code) {
+    char         msg[16];
+    ReportWriter rpt(msg, sizeof(msg));
+    rpt.add("error:");
+    rpt.add_uint(static_cast<int>(status_code));
+    rpt.add("\r\n");
+    grbl_send(client, msg, OutputClass::Response);
+}
+
 void report_status_message(Error status_code, uint8_t client) {
     switch (status_code) {
         case Error::Ok:  // Error::Ok
@@ -225,10 +372,10 @@ void report_status_message(Error status_code, uint8_t client) {
             if (get_sd_state(false) == SDCARD_BUSY_PRINTING) {
                 SD_ready_next = true;  // flag so system_execute_line() will send the next line
             } else {
-                grbl_send(client, "ok\r\n");
+                grbl_send(client, "ok\r\n", OutputClass::Response);
             }
 #else
-            grbl_send(client, "ok\r\n");
+            grbl_send(client, "ok\r\n", OutputClass::Response);
 #endif
             break;
         default:
@@ -236,25 +383,33 @@ void report_status_message(Error status_code, uint8_t client) {
             // do we need to stop a running SD job?
             if (get_sd_state(false) == SDCARD_BUSY_PRINTING) {
                 if (status_code == Error::GcodeUnsupportedCommand) {
-                    grbl_sendf(client, "error:%d\r\n", status_code);  // most senders seem to tolerate this error and keep on going
+                    report_error_response(client, status_code);  // most senders seem to tolerate this error and keep on going
                     grbl_sendf(CLIENT_ALL, "error:%d in SD file at line %d\r\n", status_code, sd_get_current_line_number());
                     // don't close file
                 } else {
                     grbl_notifyf("SD print error", "Error:%d during SD file at line: %d", status_code, sd_get_current_line_number());
                     grbl_sendf(CLIENT_ALL, "error:%d in SD file at line %d\r\n", status_code, sd_get_current_line_number());
                     closeFile();
+#    ifdef SD_JOB_QUEUE
+                    sd_queue_clear();  // The next jobs may depend on this one
+#    endif
                 }
                 return;
             }
 #endif
-            grbl_sendf(client, "error:%d\r\n", static_cast<int>(status_code));
+            report_error_response(client, status_code);
     }
 }
 
 // Prints alarm messages.
 void report_alarm_message(ExecAlarm alarm_code) {
-    grbl_sendf(CLIENT_ALL, "ALARM:%d\r\n", static_cast<int>(alarm_code));  // OK to send to all clients
-    delay_ms(500);                                                         // Force delay to ensure message clears serial write buffer.
+    char         msg[16];
+    ReportWriter rpt(msg, sizeof(msg));
+    rpt.add("ALARM:");
+    rpt.add_uint(static_cast<int>(alarm_code));
+    rpt.add("\r\n");
+    grbl_send(CLIENT_ALL, msg, OutputClass::Response);  // OK to send to all clients
+    delay_ms(500);                                      // Force delay to ensure message clears serial write buffer.
 }
 
 std::map<Message, const char*> MessageText = {
@@ -305,18 +460,40 @@ void report_grbl_help(uint8_t client) {
 // These values are retained until Grbl is power-cycled, whereby they will be re-zeroed.
 void report_probe_parameters(uint8_t client) {
     // Report in terms of machine position.
-    float print_position[MAX_N_AXIS];
-    char  probe_rpt[(axesStringLen + 13 + 6 + 1)];  // the probe report we are building here
-    char  temp[axesStringLen];
-    strcpy(probe_rpt, "[PRB:");  // initialize the string with the first characters
+    float        print_position[MAX_N_AXIS];
+    char         probe_rpt[(axesStringLen + 13 + 6 + 1)];  // the probe report we are building here
+    ReportWriter rpt(probe_rpt, sizeof(probe_rpt));
+    rpt.add("[PRB:");  // initialize the string with the first characters
     // get the machine position and put them into a string and append to the probe report
     system_convert_array_steps_to_mpos(print_position, sys_probe_position);
-    report_util_axis_values(print_position, temp);
-    strcat(probe_rpt, temp);
+    rpt.add_axes(print_position);
     // add the success indicator and add closing characters
-    sprintf(temp, ":%d]\r\n", sys.probe_succeeded);
-    strcat(probe_rpt, temp);
-    grbl_send(client, probe_rpt);  // send the report
+    rpt.add(':');
+    rpt.add_uint(sys.probe_succeeded);
+    rpt.add("]\r\n");
+    grbl_send(client, probe_rpt, OutputClass::Response);  // send the report
+}
+
+// Reports the last hard limit trip: how many there have been, the time from the first switch edge to
+// the alarm, the triggered axes, and the machine position captured at the first edge.
+void report_limit_trigger(uint8_t client) {
+    const limit_trigger_t* trigger = limits_get_trigger();
+    float                  print_position[MAX_N_AXIS];
+    char                   msg[axesStringLen + 64];
+    ReportWriter           rpt(msg, sizeof(msg));
+    rpt.add("[MSG: Limit trips:");
+    rpt.add_uint(trigger->count);
+    if (trigger->count) {
+        rpt.add(" latency:");
+        rpt.add_uint(trigger->latency_us);
+        rpt.add(" us axes:");
+        rpt.add_uint(trigger->state);
+        rpt.add(" MPos:");
+        system_convert_array_steps_to_mpos(print_position, (int32_t*)trigger->position);
+        rpt.add_axes(print_position);
+    }
+    rpt.add("]\r\n");
+    grbl_send(client, msg);
 }
 
 // Prints Grbl NGC parameters (coordinate offsets, probing)
@@ -341,16 +518,16 @@ void report_ngc_parameters(uint8_t client) {
     }
     ngc_rpt += String(tlo, 3);;
     ngc_rpt += "]\r\n";
-    grbl_send(client, ngc_rpt.c_str());
+    grbl_send(client, ngc_rpt.c_str(), OutputClass::Response);
     report_probe_parameters(client);
 }
 
 // Print current gcode parser mode state
 void report_gcode_modes(uint8_t client) {
-    char        temp[20];
-    char        modes_rpt[75];
-    const char* mode = "";
-    strcpy(modes_rpt, "[GC:");
+    char         modes_rpt[80];
+    ReportWriter rpt(modes_rpt, sizeof(modes_rpt));
+    const char*  mode = "";
+    rpt.add("[GC:");
 
     switch (gc_state.modal.motion) {
         case Motion::None:
@@ -380,11 +557,26 @@ void report_gcode_modes(uint8_t client) {
         case Motion::ProbeAwayNoError:
             mode = "G38.4";
             break;
+        case Motion::SpindleSync:
+            mode = "G33";
+            break;
+        case Motion::ChipBreakCycle:
+            mode = "G73";
+            break;
+        case Motion::DrillCycle:
+            mode = "G81";
+            break;
+        case Motion::DwellCycle:
+            mode = "G82";
+            break;
+        case Motion::PeckCycle:
+            mode = "G83";
+            break;
     }
-    strcat(modes_rpt, mode);
+    rpt.add(mode);
 
-    sprintf(temp, " G%d", gc_state.modal.coord_select + 54);
-    strcat(modes_rpt, temp);
+    rpt.add(" G");
+    rpt.add_uint(gc_state.modal.coord_select + 54);
 
     switch (gc_state.modal.plane_select) {
         case Plane::XY:
@@ -397,7 +589,7 @@ void report_gcode_modes(uint8_t client) {
             mode = " G19";
             break;
     }
-    strcat(modes_rpt, mode);
+    rpt.add(mode);
 
     switch (gc_state.modal.units) {
         case Units::Inches:
@@ -407,7 +599,7 @@ void report_gcode_modes(uint8_t client) {
             mode = " G21";
             break;
     }
-    strcat(modes_rpt, mode);
+    rpt.add(mode);
 
     switch (gc_state.modal.distance) {
         case Distance::Absolute:
@@ -417,14 +609,26 @@ void report_gcode_modes(uint8_t client) {
             mode = " G91";
             break;
     }
-    strcat(modes_rpt, mode);
+    rpt.add(mode);
+
+#ifdef PATH_BLENDING
+    if (gc_state.modal.control == ControlMode::Blend) {
+        rpt.add(" G64");
+    }
+#endif
+
+#ifdef CANNED_CYCLES
+    if (gc_state.modal.retract == RetractMode::RPlane) {
+        rpt.add(" G99");
+    }
+#endif
 
 #if 0
     switch (gc_state.modal.arc_distance) {
         case ArcDistance::Absolute: mode = " G90.1"; break;
         case ArcDistance::Incremental: mode = " G91.1"; break;
     }
-    strcat(modes_rpt, mode);
+    rpt.add(mode);
 #endif
 
     switch (gc_state.modal.feed_rate) {
@@ -435,7 +639,7 @@ void report_gcode_modes(uint8_t client) {
             mode = " G93";
             break;
     }
-    strcat(modes_rpt, mode);
+    rpt.add(mode);
 
     //report_util_gcode_modes_M();
     switch (gc_state.modal.program_flow) {
@@ -455,7 +659,7 @@ void report_gcode_modes(uint8_t client) {
             mode = " M30";
             break;
     }
-    strcat(modes_rpt, mode);
+    rpt.add(mode);
 
     switch (gc_state.modal.spindle) {
         case SpindleState::Cw:
@@ -470,36 +674,36 @@ void report_gcode_modes(uint8_t client) {
         default:
             mode = "";
     }
-    strcat(modes_rpt, mode);
+    rpt.add(mode);
 
     //report_util_gcode_modes_M();  // optional M7 and M8 should have been dealt with by here
     auto coolant = gc_state.modal.coolant;
     if (!coolant.Mist && !coolant.Flood) {
-        strcat(modes_rpt, " M9");
+        rpt.add(" M9");
     } else {
         // Note: Multiple coolant states may be active at the same time.
         if (coolant.Mist) {
-            strcat(modes_rpt, " M7");
+            rpt.add(" M7");
         }
         if (coolant.Flood) {
-            strcat(modes_rpt, " M8");
+            rpt.add(" M8");
         }
     }
 
 #ifdef ENABLE_PARKING_OVERRIDE_CONTROL
     if (sys.override_ctrl == OVERRIDE_PARKING_MOTION) {
-        strcat(modes_rpt, " M56");
+        rpt.add(" M56");
     }
 #endif
 
-    sprintf(temp, " T%d", gc_state.tool);
-    strcat(modes_rpt, temp);
-    sprintf(temp, report_inches->get() ? " F%.1f" : " F%.0f", gc_state.feed_rate);
-    strcat(modes_rpt, temp);
-    sprintf(temp, " S%d", uint32_t(gc_state.spindle_speed));
-    strcat(modes_rpt, temp);
-    strcat(modes_rpt, "]\r\n");
-    grbl_send(client, modes_rpt);
+    rpt.add(" T");
+    rpt.add_uint(gc_state.tool);
+    rpt.add(" F");
+    rpt.add_fixed(gc_state.feed_rate, report_inches->get() ? 1 : 0);
+    rpt.add(" S");
+    rpt.add_uint(uint32_t(gc_state.spindle_speed));
+    rpt.add("]\r\n");
+    grbl_send(client, modes_rpt, OutputClass::Response);
 }
 
 // Prints specified startup line
@@ -514,74 +718,80 @@ void report_execute_startup_message(const char* line, Error status_code, uint8_t
 
 // Prints build info line
 void report_build_info(char* line, uint8_t client) {
-    char build_info[50];
-    strcpy(build_info, "[VER:");
-    strcat(build_info, GRBL_VERSION);
-    strcat(build_info, ".");
-    strcat(build_info, GRBL_VERSION_BUILD);
-    strcat(build_info, ":");
-    strcat(build_info, line);
-    strcat(build_info, "]\r\n[OPT:");
-    strcat(build_info, "V");  // variable spindle..always on now
-    strcat(build_info, "N");
+    char         build_info[50 + LINE_BUFFER_SIZE];
+    ReportWriter rpt(build_info, sizeof(build_info));
+    rpt.add("[VER:");
+    rpt.add(GRBL_VERSION);
+    rpt.add(".");
+    rpt.add(GRBL_VERSION_BUILD);
+    rpt.add(":");
+    rpt.add(line);
+    rpt.add("]\r\n[OPT:");
+    rpt.add("V");  // variable spindle..always on now
+    rpt.add("N");
 #ifdef COOLANT_MIST_PIN
-    strcat(build_info, "M");  // TODO Need to deal with M8...it could be disabled
-#endif
-#ifdef COREXY
-    strcat(build_info, "C");
+    rpt.add("M");  // TODO Need to deal with M8...it could be disabled
 #endif
+    if (motion_config.corexy) {
+        rpt.add("C");
+    }
 #ifdef PARKING_ENABLE
-    strcat(build_info, "P");
+    rpt.add("P");
 #endif
 #ifdef HOMING_SINGLE_AXIS_COMMANDS
-    strcat(build_info, "H");
+    rpt.add("H");
 #endif
 #ifdef LIMITS_TWO_SWITCHES_ON_AXES
-    strcat(build_info, "L");
+    rpt.add("L");
 #endif
 #ifdef ALLOW_FEED_OVERRIDE_DURING_PROBE_CYCLES
-    strcat(build_info, "A");
+    rpt.add("A");
 #endif
 #ifdef ENABLE_BLUETOOTH
-    strcat(build_info, "B");
+    rpt.add("B");
 #endif
 #ifdef ENABLE_SD_CARD
-    strcat(build_info, "S");
+    rpt.add("S");
 #endif
 #ifdef ENABLE_PARKING_OVERRIDE_CONTROL
     serial_write('R');
 #endif
 #if defined(ENABLE_WIFI)
-    strcat(build_info, "W");
+    rpt.add("W");
 #endif
 #ifndef ENABLE_RESTORE_EEPROM_WIPE_ALL  // NOTE: Shown when disabled.
-    strcat(build_info, "*");
+    rpt.add("*");
 #endif
 #ifndef ENABLE_RESTORE_EEPROM_DEFAULT_SETTINGS  // NOTE: Shown when disabled.
-    strcat(build_info, "$");
+    rpt.add("$");
 #endif
 #ifndef ENABLE_RESTORE_EEPROM_CLEAR_PARAMETERS  // NOTE: Shown when disabled.
-    strcat(build_info, "#");
+    rpt.add("#");
 #endif
 #ifndef ENABLE_BUILD_INFO_WRITE_COMMAND  // NOTE: Shown when disabled.
-    strcat(build_info, "I");
+    rpt.add("I");
 #endif
 #ifndef FORCE_BUFFER_SYNC_DURING_EEPROM_WRITE  // NOTE: Shown when disabled.
-    strcat(build_info, "E");
+    rpt.add("E");
 #endif
 #ifndef FORCE_BUFFER_SYNC_DURING_WCO_CHANGE  // NOTE: Shown when disabled.
-    strcat(build_info, "W");
+    rpt.add("W");
 #endif
     // NOTE: Compiled values, like override increments/max/min values, may be added at some point later.
     // These will likely have a comma delimiter to separate them.
-    strcat(build_info, "]\r\n");
-    grbl_send(client, build_info);  // ok to send to all
+    rpt.add("]\r\n");
+    grbl_send(client, build_info, OutputClass::Response);  // ok to send to all
     report_machine_type(client);
+    grbl_msg_sendf(client, MsgLevel::Info, "Segment underruns:%d", st_get_underrun_count());
+    boot_report(client);
 #if defined(ENABLE_WIFI)
-    grbl_send(client, (char*)WebUI::wifi_config.info());
+    grbl_send(client, (char*)WebUI::wifi_config.info(), OutputClass::Response);
+#endif
+#if defined(ENABLE_ETHERNET)
+    grbl_send(client, (char*)WebUI::eth_config.info(), OutputClass::Response);
 #endif
 #if defined(ENABLE_BLUETOOTH)
-    grbl_send(client, (char*)WebUI::bt_config.info());
+    grbl_send(client, (char*)WebUI::bt_config.info(), OutputClass::Response);
 #endif
 }
 
@@ -596,64 +806,73 @@ void report_echo_line_received(char* line, uint8_t client) {
 // specific needs, but the desired real-time data report must be as short as possible. This is
 // requires as it minimizes the computational overhead and allows grbl to keep running smoothly,
 // especially during g-code programs with fast, short line segments and high frequency reports (5-20Hz).
-void report_realtime_status(uint8_t client) {
-    uint8_t idx;
-    int32_t current_position[MAX_N_AXIS];  // Copy current state of the system position variable
-    memcpy(current_position, sys_position, sizeof(sys_position));
+// Space left in the receive buffer of a client, for the Bf: field.
+static int report_client_rx_available(uint8_t client) {
+    if (client >= CLIENT_COUNT) {
+        return DEFAULTBUFFERSIZE;
+    }
+    return serial_get_rx_buffer_available(client);
+}
+
+// Builds the status report for client. When bf_pos is given, the client's receive buffer space is
+// left out of the Bf: field and *bf_pos is set to where it goes, so one report can be sent to several
+// clients. *bf_pos stays zero if the report has no Bf: field.
+static void report_build_realtime_status(ReportWriter& rpt, uint8_t client, size_t* bf_pos) {
+    uint8_t        idx;
+    sys_snapshot_t snapshot;  // Position, rate and state as of the same step
+    system_snapshot(&snapshot);
     float print_position[MAX_N_AXIS];
-    char  status[200];
-    char  temp[MAX_N_AXIS * 20];
-    system_convert_array_steps_to_mpos(print_position, current_position);
+    system_convert_array_steps_to_mpos(print_position, snapshot.position);
     // Report current machine state and sub-states
-    strcpy(status, "<");
-    switch (sys.state) {
+    rpt.add('<');
+    switch (snapshot.state) {
         case State::Idle:
-            strcat(status, "Idle");
+            rpt.add("Idle");
             break;
         case State::Cycle:
-            strcat(status, "Run");
+            rpt.add("Run");
             break;
         case State::Hold:
             if (!(sys.suspend & SUSPEND_JOG_CANCEL)) {
-                strcat(status, "Hold:");
+                rpt.add("Hold:");
                 if (sys.suspend & SUSPEND_HOLD_COMPLETE) {
-                    strcat(status, "0");  // Ready to resume
+                    rpt.add("0");  // Ready to resume
                 } else {
-                    strcat(status, "1");  // Actively holding
+                    rpt.add("1");  // Actively holding
                 }
                 break;
             }  // Continues to print jog state during jog cancel.
         case State::Jog:
-            strcat(status, "Jog");
+            rpt.add("Jog");
             break;
         case State::Homing:
-            strcat(status, "Home");
+            rpt.add("Home");
             break;
         case State::Alarm:
-            strcat(status, "Alarm");
+            rpt.add("Alarm");
             break;
         case State::CheckMode:
-            strcat(status, "Check");
+            rpt.add("Check");
             break;
         case State::SafetyDoor:
-            strcat(status, "Door:");
+            rpt.add("Door:");
             if (sys.suspend & SUSPEND_INITIATE_RESTORE) {
-                strcat(status, "3");  // Restoring
+                rpt.add("3");  // Restoring
             } else {
                 if (sys.suspend & SUSPEND_RETRACT_COMPLETE) {
                     if (sys.suspend & SUSPEND_SAFETY_DOOR_AJAR) {
-                        strcat(status, "1");  // Door ajar
+                        rpt.add("1");  // Door ajar
                     } else {
-                        strcat(status, "0");
+                        rpt.add("0");
                     }
                     // Door closed and ready to resume
                 } else {
-                    strcat(status, "2");  // Retracting
+                    rpt.add("2");  // Retracting
                 }
             }
             break;
         case State::Sleep:
-            strcat(status, "Sleep");
+            rpt.add("Sleep");
             break;
     }
     float wco[MAX_N_AXIS];
@@ -672,35 +891,22 @@ void report_realtime_status(uint8_t client) {
     }
     // Report machine position
     if (bit_istrue(status_mask->get(), BITFLAG_RT_STATUS_POSITION_TYPE)) {
-        strcat(status, "|MPos:");
+        rpt.add("|MPos:");
     } else {
-#ifdef USE_FWD_KINEMATICS
-        forward_kinematics(print_position);
-#endif
-        strcat(status, "|WPos:");
+        rpt.add("|WPos:");
     }
-    report_util_axis_values(print_position, temp);
-    strcat(status, temp);
+    rpt.add_axes(print_position);
     // Returns planner and serial read buffer states.
 #ifdef REPORT_FIELD_BUFFER_STATE
     if (bit_istrue(status_mask->get(), BITFLAG_RT_STATUS_BUFFER_STATE)) {
-        int bufsize = DEFAULTBUFFERSIZE;
-#    if defined(ENABLE_WIFI) && defined(ENABLE_TELNET)
-        if (client == CLIENT_TELNET) {
-            bufsize = WebUI::telnet_server.get_rx_buffer_available();
+        rpt.add("|Bf:");
+        rpt.add_uint(plan_get_block_buffer_available());
+        rpt.add(',');
+        if (bf_pos) {
+            *bf_pos = rpt.length();
+        } else {
+            rpt.add_int(report_client_rx_available(client));
         }
-#    endif  //ENABLE_WIFI && ENABLE_TELNET
-#    if defined(ENABLE_BLUETOOTH)
-        if (client == CLIENT_BT) {
-            //TODO FIXME
-            bufsize = 512 - WebUI::SerialBT.available();
-        }
-#    endif  //ENABLE_BLUETOOTH
-        if (client == CLIENT_SERIAL) {
-            bufsize = serial_get_rx_buffer_available(CLIENT_SERIAL);
-        }
-        sprintf(temp, "|Bf:%d,%d", plan_get_block_buffer_available(), bufsize);
-        strcat(status, temp);
     }
 #endif
 #ifdef USE_LINE_NUMBERS
@@ -710,65 +916,67 @@ void report_realtime_status(uint8_t client) {
     if (cur_block != NULL) {
         uint32_t ln = cur_block->line_number;
         if (ln > 0) {
-            sprintf(temp, "|Ln:%d", ln);
-            strcat(status, temp);
+            rpt.add("|Ln:");
+            rpt.add_uint(ln);
         }
     }
 #    endif
 #endif
     // Report realtime feed speed
 #ifdef REPORT_FIELD_CURRENT_FEED_SPEED
+    rpt.add("|FS:");
     if (report_inches->get()) {
-        sprintf(temp, "|FS:%.1f,%d", st_get_realtime_rate() / MM_PER_INCH, sys.spindle_speed);
+        rpt.add_fixed(snapshot.feed_rate / MM_PER_INCH, 1);
     } else {
-        sprintf(temp, "|FS:%.0f,%d", st_get_realtime_rate(), sys.spindle_speed);
+        rpt.add_fixed(snapshot.feed_rate, 0);
     }
-    strcat(status, temp);
+    rpt.add(',');
+    rpt.add_uint(sys.spindle_speed);
 #endif
 #ifdef REPORT_FIELD_PIN_STATE
     uint8_t lim_pin_state  = limits_get_state();
     uint8_t ctrl_pin_state = system_control_get_state();
     uint8_t prb_pin_state  = probe_get_state();
     if (lim_pin_state | ctrl_pin_state | prb_pin_state) {
-        strcat(status, "|Pn:");
+        rpt.add("|Pn:");
         if (prb_pin_state) {
-            strcat(status, "P");
+            rpt.add("P");
         }
         if (lim_pin_state) {
             auto n_axis = number_axis->get();
             if (n_axis >= 1 && bit_istrue(lim_pin_state, bit(X_AXIS))) {
-                strcat(status, "X");
+                rpt.add("X");
             }
             if (n_axis >= 2 && bit_istrue(lim_pin_state, bit(Y_AXIS))) {
-                strcat(status, "Y");
+                rpt.add("Y");
             }
             if (n_axis >= 3 && bit_istrue(lim_pin_state, bit(Z_AXIS))) {
-                strcat(status, "Z");
+                rpt.add("Z");
             }
             if (n_axis >= 4 && bit_istrue(lim_pin_state, bit(A_AXIS))) {
-                strcat(status, "A");
+                rpt.add("A");
             }
             if (n_axis >= 5 && bit_istrue(lim_pin_state, bit(B_AXIS))) {
-                strcat(status, "B");
+                rpt.add("B");
             }
             if (n_axis >= 6 && bit_istrue(lim_pin_state, bit(C_AXIS))) {
-                strcat(status, "C");
+                rpt.add("C");
             }
         }
         if (ctrl_pin_state) {
 #    ifdef ENABLE_SAFETY_DOOR_INPUT_PIN
             if (bit_istrue(ctrl_pin_state, CONTROL_PIN_INDEX_SAFETY_DOOR)) {
-                strcat(status, "D");
+                rpt.add("D");
             }
 #    endif
             if (bit_istrue(ctrl_pin_state, CONTROL_PIN_INDEX_RESET)) {
-                strcat(status, "R");
+                rpt.add("R");
             }
             if (bit_istrue(ctrl_pin_state, CONTROL_PIN_INDEX_FEED_HOLD)) {
-                strcat(status, "H");
+                rpt.add("H");
             }
             if (bit_istrue(ctrl_pin_state, CONTROL_PIN_INDEX_CYCLE_START)) {
-                strcat(status, "S");
+                rpt.add("S");
             }
         }
     }
@@ -791,9 +999,8 @@ void report_realtime_status(uint8_t client) {
         if (sys.report_ovr_counter == 0) {
             sys.report_ovr_counter = 1;  // Set override on next report.
         }
-        strcat(status, "|WCO:");
-        report_util_axis_values(wco, temp);
-        strcat(status, temp);
+        rpt.add("|WCO:");
+        rpt.add_axes(wco);
     }
 #endif
 #ifdef REPORT_FIELD_OVERRIDES
@@ -812,30 +1019,34 @@ void report_realtime_status(uint8_t client) {
                 break;
         }
 
-        sprintf(temp, "|Ov:%d,%d,%d", sys.f_override, sys.r_override, sys.spindle_speed_ovr);
-        strcat(status, temp);
+        rpt.add("|Ov:");
+        rpt.add_uint(sys.f_override);
+        rpt.add(',');
+        rpt.add_uint(sys.r_override);
+        rpt.add(',');
+        rpt.add_uint(sys.spindle_speed_ovr);
         SpindleState sp_state      = spindle->get_state();
         CoolantState coolant_state = coolant_get_state();
         if (sp_state != SpindleState::Disable || coolant_state.Mist || coolant_state.Flood) {
-            strcat(status, "|A:");
+            rpt.add("|A:");
             switch (sp_state) {
                 case SpindleState::Disable:
                     break;
                 case SpindleState::Cw:
-                    strcat(status, "S");
+                    rpt.add("S");
                     break;
                 case SpindleState::Ccw:
-                    strcat(status, "C");
+                    rpt.add("C");
                     break;
             }
 
             auto coolant = coolant_state;
             if (coolant.Flood) {
-                strcat(status, "F");
+                rpt.add("F");
             }
 #    ifdef COOLANT_MIST_PIN  // TODO Deal with M8 - Flood
             if (coolant.Mist) {
-                strcat(status, "M");
+                rpt.add("M");
             }
 #    endif
         }
@@ -843,18 +1054,245 @@ void report_realtime_status(uint8_t client) {
 #endif
 #ifdef ENABLE_SD_CARD
     if (get_sd_state(false) == SDCARD_BUSY_PRINTING) {
-        sprintf(temp, "|SD:%4.2f,", sd_report_perc_complete());
-        strcat(status, temp);
+        char temp[coordStringLen * MAX_N_AXIS];
+        rpt.add("|SD:");
+        rpt.add_fixed(sd_report_perc_complete(), 2);
+        rpt.add(',');
         sd_get_current_filename(temp);
-        strcat(status, temp);
+        rpt.add(temp);
     }
 #endif
 #ifdef REPORT_HEAP
-    sprintf(temp, "|Heap:%d", esp.getHeapSize());
-    strcat(status, temp);
+    rpt.add("|Heap:");
+    rpt.add_uint(esp.getHeapSize());
 #endif
-    strcat(status, ">\r\n");
-    grbl_send(client, status);
+    rpt.add(">\r\n");
+}
+
+// Status report fields tracked by the delta format. A field is sent again only when its text changes.
+// Pn, A, Ln and SD are left out of the full report when they are empty, so for them a missing field is
+// a change too, and is sent as empty. WCO and Ov are left out between refreshes, which is not a change.
+static const char* const delta_fields[]   = { "MPos", "WPos", "Bf", "Ln", "FS", "Pn", "WCO", "Ov", "A", "SD", "Heap" };
+static const int         N_DELTA_FIELDS   = sizeof(delta_fields) / sizeof(delta_fields[0]);
+static const uint16_t    delta_empty_mask = bit(3) | bit(5) | bit(8) | bit(9);  // Ln, Pn, A and SD
+
+typedef struct {
+    bool     enabled;
+    uint16_t present;               // Fields in the last report sent
+    uint32_t hash[N_DELTA_FIELDS];  // Text of each of those fields
+} report_delta_t;
+static report_delta_t report_deltas[CLIENT_COUNT];
+
+static uint32_t report_hash(const char* text, size_t len) {
+    uint32_t hash = 2166136261u;  // FNV-1a
+    while (len--) {
+        hash = (hash ^ uint8_t(*text++)) * 16777619u;
+    }
+    return hash;
+}
+
+void report_set_delta_format(uint8_t client, bool enabled) {
+    if (client < CLIENT_COUNT) {
+        memset(&report_deltas[client], 0, sizeof(report_delta_t));  // Next report is sent in full
+        report_deltas[client].enabled = enabled;
+    }
+}
+
+bool report_get_delta_format(uint8_t client) {
+    return client < CLIENT_COUNT && report_deltas[client].enabled;
+}
+
+// Sends a status report built by report_build_realtime_status(), cut down to the fields that changed
+// since the last report if the client asked for the delta format. The state is always sent.
+// A full report can be dropped when the client's output is backed up, since the next one replaces it.
+// Deltas cannot, because later deltas leave out what this one carries.
+static void report_send_status(uint8_t client, const char* status) {
+    if (!report_get_delta_format(client)) {
+        grbl_send(client, status, OutputClass::Droppable);
+        return;
+    }
+    report_delta_t* delta = &report_deltas[client];
+    char            compact[200];
+    ReportWriter    rpt(compact, sizeof(compact));
+    uint16_t        present = 0;
+    const char*     field   = status + 1;  // Skip <
+    const char*     end     = strchr(field, '>');
+    if (end == NULL) {
+        grbl_send(client, status);
+        return;
+    }
+    const char* next = (const char*)memchr(field, '|', end - field);
+    rpt.add(status, (next ? next : end) - status);  // <State
+    while (next) {
+        field = next + 1;
+        next  = (const char*)memchr(field, '|', end - field);
+        size_t      len   = (next ? next : end) - field;
+        const char* colon = (const char*)memchr(field, ':', len);
+        size_t      key   = colon ? colon - field : len;
+        int         idx;
+        for (idx = 0; idx < N_DELTA_FIELDS; idx++) {
+            if (strlen(delta_fields[idx]) == key && strncmp(delta_fields[idx], field, key) == 0) {
+                break;
+            }
+        }
+        if (idx < N_DELTA_FIELDS) {
+            uint32_t hash = report_hash(field, len);
+            present |= bit(idx);
+            if (bit_istrue(delta->present, bit(idx)) && delta->hash[idx] == hash) {
+                continue;  // Unchanged
+            }
+            delta->hash[idx] = hash;
+        }
+        rpt.add('|');
+        rpt.add(field, len);
+    }
+    for (int idx = 0; idx < N_DELTA_FIELDS; idx++) {
+        if (bit_istrue(delta_empty_mask, bit(idx)) && bit_istrue(delta->present, bit(idx)) && bit_isfalse(present, bit(idx))) {
+            rpt.add('|');
+            rpt.add(delta_fields[idx]);
+            rpt.add(':');
+        }
+    }
+    // Fields like WCO that are only refreshed now and then are remembered until the format is reset.
+    delta->present = present | (delta->present & ~delta_empty_mask);
+    rpt.add(">\r\n");
+    grbl_send(client, compact, OutputClass::Response);
+}
+
+void report_realtime_status(uint8_t client) {
+    char         status[200];
+    ReportWriter rpt(status, sizeof(status));
+    report_build_realtime_status(rpt, client, NULL);
+    report_send_status(client, status);
+}
+
+// Status reports pushed without a ? poll, set up per client by $Report/Interval and $Report/OnChange.
+typedef struct {
+    uint32_t interval_ms;  // Zero when the client is not subscribed
+    bool     on_change;    // Only send when the report differs from the last one sent
+    int64_t  next_us;      // When the next report is due
+    uint32_t last_hash;    // Hash of the last report sent, for on_change
+} report_subscription_t;
+static report_subscription_t report_subscriptions[CLIENT_COUNT];
+
+void report_subscribe(uint8_t client, uint32_t interval_ms, bool on_change) {
+    if (client >= CLIENT_COUNT) {
+        return;
+    }
+    report_subscription_t* sub = &report_subscriptions[client];
+    sub->interval_ms           = interval_ms;
+    sub->on_change             = on_change;
+    sub->next_us               = esp_timer_get_time();
+    sub->last_hash             = 0;
+}
+
+report_subscription_info_t report_get_subscription(uint8_t client) {
+    report_subscription_info_t info = { 0, false };
+    if (client < CLIENT_COUNT) {
+        info.interval_ms = report_subscriptions[client].interval_ms;
+        info.on_change   = report_subscriptions[client].on_change;
+    }
+    return info;
+}
+
+// Called regularly by serialCheckTask. The report is built once for all the clients that are due and
+// only the Bf: receive buffer value is filled in per client.
+void report_status_push() {
+    int64_t now = esp_timer_get_time();
+    uint8_t due = 0;
+    for (uint8_t client = 0; client < CLIENT_COUNT; client++) {
+        report_subscription_t* sub = &report_subscriptions[client];
+        if (sub->interval_ms && now >= sub->next_us) {
+            due |= bit(client);
+            sub->next_us += int64_t(sub->interval_ms) * 1000;
+            if (sub->next_us <= now) {
+                sub->next_us = now + int64_t(sub->interval_ms) * 1000;  // Fell behind, so don't send a burst
+            }
+        }
+    }
+    if (!due) {
+        return;
+    }
+    char         status[200];
+    ReportWriter rpt(status, sizeof(status));
+    size_t       bf_pos = 0;
+    report_build_realtime_status(rpt, CLIENT_ALL, &bf_pos);
+    for (uint8_t client = 0; client < CLIENT_COUNT; client++) {
+        if (bit_isfalse(due, bit(client))) {
+            continue;
+        }
+        const char* text = status;
+        char        client_status[sizeof(status) + 8];
+        if (bf_pos) {
+            ReportWriter client_rpt(client_status, sizeof(client_status));
+            client_rpt.add(status, bf_pos);
+            client_rpt.add_int(report_client_rx_available(client));
+            client_rpt.add(status + bf_pos);
+            text = client_status;
+        }
+        report_subscription_t* sub = &report_subscriptions[client];
+        if (sub->on_change) {
+            uint32_t hash = report_hash(text, strlen(text));
+            if (hash == sub->last_hash) {
+                continue;
+            }
+            sub->last_hash = hash;
+        }
+        report_send_status(client, text);
+    }
+}
+
+// Credit messages pushed when planner blocks or receive buffer space free up, set up per client by
+// $Report/Credits.
+typedef struct {
+    bool         enabled;
+    bool         force;    // Send the next check even if nothing was freed
+    plan_index_t planner;  // Free planner blocks in the last message, or lower if they were used since
+    uint16_t     rx;       // Free receive buffer bytes in the last message, or lower if they were used since
+} report_credit_t;
+static report_credit_t report_credits[CLIENT_COUNT];
+
+void report_set_credits(uint8_t client, bool enabled) {
+    if (client >= CLIENT_COUNT) {
+        return;
+    }
+    report_credits[client].enabled = enabled;
+    report_credits[client].force   = true;
+}
+
+bool report_get_credits(uint8_t client) {
+    return client < CLIENT_COUNT && report_credits[client].enabled;
+}
+
+// Called regularly by serialCheckTask. Used space is tracked silently, and a message is only sent once
+// a planner block or REPORT_CREDIT_RX_STEP receive bytes have been freed, or the receive buffer empties.
+void report_credit_push() {
+    plan_index_t planner = plan_get_block_buffer_available();
+    for (uint8_t client = 0; client < CLIENT_COUNT; client++) {
+        report_credit_t* credit = &report_credits[client];
+        if (!credit->enabled) {
+            continue;
+        }
+        uint16_t rx    = serial_get_rx_buffer_available(client);
+        bool     freed = credit->force || planner > credit->planner || rx >= credit->rx + REPORT_CREDIT_RX_STEP ||
+                     (rx > credit->rx && rx == serial_get_rx_buffer_size(client));
+        if (freed) {
+            char         msg[24];
+            ReportWriter rpt(msg, sizeof(msg));
+            rpt.add("[CR:");
+            rpt.add_uint(planner);
+            rpt.add(',');
+            rpt.add_uint(rx);
+            rpt.add("]\r\n");
+            grbl_send(client, msg, OutputClass::Response);  // A lost credit would stall the sender
+            credit->force   = false;
+            credit->planner = planner;
+            credit->rx      = rx;
+            continue;
+        }
+        credit->planner = MIN(credit->planner, planner);
+        credit->rx      = MIN(credit->rx, rx);
+    }
 }
 
 void report_realtime_steps() {
@@ -889,24 +1327,28 @@ void report_machine_type(uint8_t client) {
     Would would print something like ... [MSG Rx: 0x01 0x03 0x01 0x08 0x31 0xbf]
 */
 void report_hex_msg(char* buf, const char* prefix, int len) {
-    char report[200];
-    char temp[20];
-    sprintf(report, "%s", prefix);
+    static const char hex[] = "0123456789ABCDEF";
+    char              report[200];
+    ReportWriter      rpt(report, sizeof(report));
+    rpt.add(prefix);
     for (int i = 0; i < len; i++) {
-        sprintf(temp, " 0x%02X", buf[i]);
-        strcat(report, temp);
+        rpt.add(" 0x");
+        rpt.add(hex[uint8_t(buf[i]) >> 4]);
+        rpt.add(hex[uint8_t(buf[i]) & 0xf]);
     }
 
     grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "%s", report);
 }
 
-void report_hex_msg(uint8_t* buf, const char* prefix, int len) {
-    char report[200];
-    char temp[20];
-    sprintf(report, "%s", prefix);
+void report_hex_msg(const uint8_t* buf, const char* prefix, int len) {
+    static const char hex[] = "0123456789ABCDEF";
+    char              report[200];
+    ReportWriter      rpt(report, sizeof(report));
+    rpt.add(prefix);
     for (int i = 0; i < len; i++) {
-        sprintf(temp, " 0x%02X", buf[i]);
-        strcat(report, temp);
+        rpt.add(" 0x");
+        rpt.add(hex[uint8_t(buf[i]) >> 4]);
+        rpt.add(hex[uint8_t(buf[i]) & 0xf]);
     }
 
     grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "%s", report);
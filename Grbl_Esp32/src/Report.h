@@ -20,8 +20,6 @@
   along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-const char* errorString(Error errorNumber);
-
 // Define Grbl feedback message codes. Valid values (0-255).
 enum class Message : uint8_t {
     CriticalEvent   = 1,
@@ -43,8 +41,14 @@ enum class Message : uint8_t {
 #define CLIENT_WEBUI 2
 #define CLIENT_TELNET 3
 #define CLIENT_INPUT 4
+#define CLIENT_UDP 5
 #define CLIENT_ALL 0xFF
-#define CLIENT_COUNT 5  // total number of client types regardless if they are used
+#define CLIENT_COUNT 6  // total number of client types regardless if they are used
+
+// Receive buffer bytes that must free up before another credit message is sent. See report_set_credits().
+#ifndef REPORT_CREDIT_RX_STEP
+#    define REPORT_CREDIT_RX_STEP 32
+#endif
 
 enum class MsgLevel : uint8_t {
     None    = 0,  // set GRBL_MSG_LEVEL in config.h to the level you want to see
@@ -56,9 +60,42 @@ enum class MsgLevel : uint8_t {
 };
 
 // functions to send data to the user.
-void grbl_send(uint8_t client, const char* text);
+// How queued output is treated when a transport falls behind. Ignored without ENABLE_ASYNC_OUTPUT.
+enum class OutputClass : uint8_t {
+    Normal = 0,  // Waits up to CLIENT_OUTPUT_WAIT_MS for room, then is dropped
+    Droppable,   // Dropped at once when the queue is short of room, like a status report a newer one replaces
+    Response,    // Output the host cannot lose: replies, alarms, listings, deltas and credits. Never dropped,
+                 // and may use the room kept free for them
+};
+
+void grbl_send(uint8_t client, const char* text, OutputClass output_class = OutputClass::Normal);
+void grbl_write(uint8_t client, const char* text);
 void grbl_sendf(uint8_t client, const char* format, ...);
 void grbl_msg_sendf(uint8_t client, MsgLevel level, const char* format, ...);
+void grbl_msg_vsendf(uint8_t client, const char* format, va_list arg);
+
+// Bytes a ReportBatch collects before it sends them
+#ifndef REPORT_BATCH_SIZE
+#    define REPORT_BATCH_SIZE 1024
+#endif
+
+// Collects the text of a long report, such as $$, and sends it to the client in a few writes of up to
+// REPORT_BATCH_SIZE bytes instead of a packet per line. The bytes sent are the same. One batch buffer is
+// shared; a batch that finds it taken sends each piece as it comes. The listing answers a command, so it
+// is sent as a Response and never dropped.
+class ReportBatch {
+public:
+    ReportBatch(uint8_t client);
+    ~ReportBatch();
+
+    void add(const char* text);
+    void flush();
+
+private:
+    uint8_t _client;
+    char*   _buf;
+    size_t  _len;
+};
 
 //function to notify
 void grbl_notify(const char* title, const char* msg);
@@ -89,9 +126,37 @@ void report_echo_line_received(char* line, uint8_t client);
 // Prints realtime status report
 void report_realtime_status(uint8_t client);
 
+// Sends status reports to client every interval_ms without ? polling, or stops them when interval_ms
+// is zero. With on_change, a report is only sent when it differs from the last one the client got.
+void report_subscribe(uint8_t client, uint32_t interval_ms, bool on_change);
+typedef struct {
+    uint32_t interval_ms;
+    bool     on_change;
+} report_subscription_info_t;
+report_subscription_info_t report_get_subscription(uint8_t client);
+
+// Selects the compact status format for client, where each report only has the state and the fields
+// that changed since the previous report to that client. Set by $Report/Format.
+void report_set_delta_format(uint8_t client, bool enabled);
+bool report_get_delta_format(uint8_t client);
+
+// Sends the subscribed status reports that are due. Called regularly by serialCheckTask.
+void report_status_push();
+
+// Sends client [CR:<planner blocks>,<rx bytes>] each time planner blocks or receive buffer space free up,
+// so a sender can stream against the free space instead of counting characters. Set by $Report/Credits.
+void report_set_credits(uint8_t client, bool enabled);
+bool report_get_credits(uint8_t client);
+
+// Sends the credit messages that are due. Called regularly by serialCheckTask.
+void report_credit_push();
+
 // Prints recorded probe position
 void report_probe_parameters(uint8_t client);
 
+// Prints the time and position of the last hard limit trip
+void report_limit_trigger(uint8_t client);
+
 // Prints Grbl NGC parameters (coordinate offsets, probe)
 void report_ngc_parameters(uint8_t client);
 
@@ -114,6 +179,6 @@ void report_realtime_debug();
 void report_machine_type(uint8_t client);
 
 void report_hex_msg(char* buf, const char* prefix, int len);
-void report_hex_msg(uint8_t* buf, const char* prefix, int len);
+void report_hex_msg(const uint8_t* buf, const char* prefix, int len);
 
 char report_get_axis_letter(uint8_t axis);
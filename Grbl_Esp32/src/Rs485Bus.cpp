@@ -0,0 +1,242 @@
+/*
+  Rs485Bus.cpp - one RS485 bus shared by the devices on it
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+const int RS485_BUS_EVENT_QUEUE_SIZE = 10;  // UART driver events
+
+namespace RS485 {
+    Bus bus;
+
+    bool Bus::begin(const uart_config_t& config, uint8_t tx_pin, uint8_t rx_pin, uint8_t rts_pin, uint32_t turnaround_us) {
+        if (_task != nullptr) {
+            if (config.baud_rate != _baud_rate || tx_pin != _tx_pin || rx_pin != _rx_pin || rts_pin != _rts_pin) {
+                grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "RS485 bus already runs at %d baud on other pins", _baud_rate);
+                return false;
+            }
+            _turnaround_us = MAX(_turnaround_us, turnaround_us);
+            return true;
+        }
+
+        grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "RS485 bus TX:%d RX:%d RTS:%d %d baud", tx_pin, rx_pin, rts_pin, config.baud_rate);
+
+        uart_driver_delete(RS485_BUS_UART_PORT);
+
+        if (uart_param_config(RS485_BUS_UART_PORT, &config) != ESP_OK) {
+            grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "RS485 bus uart parameters failed");
+            return false;
+        }
+        if (uart_set_pin(RS485_BUS_UART_PORT, tx_pin, rx_pin, rts_pin, UART_PIN_NO_CHANGE) != ESP_OK) {
+            grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "RS485 bus uart pin config failed");
+            return false;
+        }
+        if (uart_driver_install(
+                RS485_BUS_UART_PORT, RS485_BUS_MAX_MSG_SIZE * 2, 0, RS485_BUS_EVENT_QUEUE_SIZE, &_uart_queue, 0) != ESP_OK) {
+            grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "RS485 bus uart driver install failed");
+            return false;
+        }
+        if (uart_set_mode(RS485_BUS_UART_PORT, UART_MODE_RS485_HALF_DUPLEX) != ESP_OK) {
+            grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "RS485 bus uart set half duplex failed");
+            return false;
+        }
+
+        _baud_rate     = config.baud_rate;
+        _tx_pin        = tx_pin;
+        _rx_pin        = rx_pin;
+        _rts_pin       = rts_pin;
+        _turnaround_us = turnaround_us;
+        _queue[0]      = xQueueCreate(RS485_BUS_QUEUE_SIZE, sizeof(Request));
+        _queue[1]      = xQueueCreate(RS485_BUS_QUEUE_SIZE, sizeof(Request));
+        _lock          = xSemaphoreCreateMutex();
+        xTaskCreatePinnedToCore(busTask,     // task
+                                "rs485Bus",  // name for task
+                                RS485_BUS_TASK_STACK,
+                                this,  // parameters
+                                RS485_BUS_TASK_PRIORITY,
+                                &_task,
+                                RS485_BUS_TASK_CORE  // core
+        );
+        return true;
+    }
+
+    bool Bus::attach(Device* device) {
+        if (_task == nullptr) {
+            return false;
+        }
+        if (_n_devices == RS485_BUS_MAX_DEVICES) {
+            grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "RS485 bus has no room for another device");
+            return false;
+        }
+        for (uint8_t i = 0; i < _n_devices; i++) {
+            if (_devices[i] == device) {
+                return true;
+            }
+        }
+        device->_next_poll     = xTaskGetTickCount();
+        _devices[_n_devices++] = device;
+        xTaskNotifyGive(_task);
+        return true;
+    }
+
+    bool Bus::submit(Request& request, Priority priority) {
+        if (_task == nullptr) {
+            return false;
+        }
+        request.seq = __atomic_add_fetch(&_seq, 1, __ATOMIC_RELAXED);
+        if (xQueueSend(_queue[int(priority)], &request, 0) != pdTRUE) {
+            return false;
+        }
+        xTaskNotifyGive(_task);
+        return true;
+    }
+
+    void Bus::cancel(Device* device) { device->_cancelled = __atomic_add_fetch(&_seq, 1, __ATOMIC_RELAXED); }
+
+    int Bus::transact(const uint8_t* tx, uint16_t tx_length, uint8_t* rx, uint16_t rx_length, TickType_t timeout) {
+        if (_task == nullptr) {
+            return 0;
+        }
+        xSemaphoreTake(_lock, portMAX_DELAY);
+        int length = exchange(tx, tx_length, rx, rx_length, timeout, nullptr);
+        xSemaphoreGive(_lock);
+        return length;
+    }
+
+    // Sends one message and collects the response as the UART driver reports received data, until it is
+    // complete or the timeout runs out. Returns the number of bytes received.
+    int Bus::exchange(const uint8_t* tx, uint16_t tx_length, uint8_t* rx, uint16_t rx_length, TickType_t timeout, Request* request) {
+        // Keep the bus silent for the turnaround, so the devices see a new frame.
+        int64_t gap_us = _turnaround_us - (esp_timer_get_time() - _last_frame_us);
+        if (gap_us > 0) {
+            delayMicroseconds(gap_us);
+        }
+
+        uart_flush(RS485_BUS_UART_PORT);
+        xQueueReset(_uart_queue);
+        uart_write_bytes(RS485_BUS_UART_PORT, reinterpret_cast<const char*>(tx), tx_length);
+
+        if (rx_length == 0) {
+            // Nothing comes back, the next request may follow as soon as this one is out.
+            uart_wait_tx_done(RS485_BUS_UART_PORT, timeout);
+            _last_frame_us = esp_timer_get_time();
+            return 0;
+        }
+
+        int        read_length = 0;
+        TickType_t start       = xTaskGetTickCount();
+        while (read_length < rx_length) {
+            TickType_t   elapsed = xTaskGetTickCount() - start;
+            uart_event_t event;
+            if (elapsed >= timeout) {
+                break;
+            }
+            task_stats_block();
+            BaseType_t received = xQueueReceive(_uart_queue, &event, timeout - elapsed);
+            task_stats_unblock();
+            if (received != pdTRUE) {
+                break;
+            }
+            switch (event.type) {
+                case UART_DATA:
+                    read_length += uart_read_bytes(RS485_BUS_UART_PORT, rx + read_length, rx_length - read_length, 0);
+                    break;
+                case UART_FIFO_OVF:
+                case UART_BUFFER_FULL:
+                    uart_flush(RS485_BUS_UART_PORT);
+                    xQueueReset(_uart_queue);
+                    _last_frame_us = esp_timer_get_time();
+                    return 0;
+                default:
+                    break;
+            }
+            if (request != nullptr && request->device->complete(*request, rx, read_length)) {
+                break;
+            }
+        }
+        _last_frame_us = esp_timer_get_time();
+        return read_length;
+    }
+
+    void Bus::run(Request& request) {
+        static uint8_t rx[RS485_BUS_MAX_MSG_SIZE];
+        Device*        device    = request.device;
+        uint16_t       rx_length = MIN(request.rx_length, uint16_t(RS485_BUS_MAX_MSG_SIZE));
+
+        for (uint8_t attempt = 0; attempt < MAX(request.attempts, uint8_t(1)); attempt++) {
+            // The device may have cancelled the request between attempts
+            if (int32_t(request.seq - device->_cancelled) < 0) {
+                return;
+            }
+            xSemaphoreTake(_lock, portMAX_DELAY);
+            int length = exchange(request.msg, request.tx_length, rx, rx_length, request.timeout, &request);
+            xSemaphoreGive(_lock);
+            if (device->response(request, rx, length)) {
+                return;
+            }
+        }
+        device->failed(request);
+    }
+
+    // Takes the next queued request that is still wanted, or else the poll of a device that is due.
+    // Waits for either when there is none.
+    bool Bus::next(Request& request) {
+        for (int priority = 0; priority < 2; priority++) {
+            while (xQueueReceive(_queue[priority], &request, 0) == pdTRUE) {
+                if (int32_t(request.seq - request.device->_cancelled) > 0) {
+                    return true;
+                }
+            }
+        }
+
+        TickType_t now  = xTaskGetTickCount();
+        TickType_t wait = portMAX_DELAY;
+        for (uint8_t i = 0; i < _n_devices; i++) {
+            Device*    device = _devices[i];
+            TickType_t period = device->poll_period();
+            if (period == portMAX_DELAY) {
+                continue;
+            }
+            int32_t left = int32_t(device->_next_poll - now);
+            if (left <= 0) {
+                device->_next_poll = now + period;
+                if (device->poll(request)) {
+                    request.device = device;
+                    request.seq    = __atomic_add_fetch(&_seq, 1, __ATOMIC_RELAXED);
+                    return true;
+                }
+                left = period;
+            }
+            wait = MIN(wait, TickType_t(left));
+        }
+
+        task_stats_block();
+        ulTaskNotifyTake(pdTRUE, wait);
+        task_stats_unblock();
+        return false;
+    }
+
+    void Bus::busTask(void* pvParameters) {
+        Bus*    bus = static_cast<Bus*>(pvParameters);
+        Request request;
+        while (true) {
+            if (bus->next(request)) {
+                bus->run(request);
+            }
+        }
+    }
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+/*
+  Rs485Bus.h - one RS485 bus shared by the devices on it
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  The bus owns the UART and one task. Devices, a VFD spindle, servos or remote I/O, submit requests
+  without waiting and get the response back through their Device methods, called by the bus task.
+  Requests go out back to back with only the turnaround gap between them, the high priority queue
+  ahead of the low one. When both are empty, the attached devices are asked for their status polls
+  as each one's poll period comes round. All devices share the baud rate and framing of the first one
+  that starts the bus; the framing and checksum of the messages are up to the devices.
+*/
+
+#include "Config.h"
+#include "TaskConfig.h"
+
+#include <driver/uart.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+
+#ifndef RS485_BUS_UART_PORT
+#    define RS485_BUS_UART_PORT UART_NUM_2
+#endif
+// Largest request or response, the answers of twelve Dynamixel motors to a SYNC_READ
+#ifndef RS485_BUS_MAX_MSG_SIZE
+#    define RS485_BUS_MAX_MSG_SIZE 192
+#endif
+// Requests that can wait in each of the two queues
+#ifndef RS485_BUS_QUEUE_SIZE
+#    define RS485_BUS_QUEUE_SIZE 8
+#endif
+#ifndef RS485_BUS_MAX_DEVICES
+#    define RS485_BUS_MAX_DEVICES 4
+#endif
+
+namespace RS485 {
+    enum class Priority : uint8_t {
+        High,  // Motion and commands
+        Low,   // Settings and anything that can wait
+    };
+
+    class Device;
+
+    struct Request {
+        Device*    device;
+        uint32_t   context;    // For the device, handed back with the response
+        uint8_t    flags;      // For the device
+        uint8_t    attempts;   // Sent at most this often until the device accepts the response
+        uint16_t   tx_length;
+        uint16_t   rx_length;  // Expected response, 0 when there is none, as for a broadcast
+        TickType_t timeout;    // For the whole response
+        uint32_t   seq;        // Set by submit()
+        uint8_t    msg[RS485_BUS_MAX_MSG_SIZE];
+    };
+
+    class Device {
+    public:
+        // Fills a status poll when the device has one. Called by the bus task when the queues are empty,
+        // once each poll_period().
+        virtual bool       poll(Request& request) { return false; }
+        virtual TickType_t poll_period() { return portMAX_DELAY; }
+
+        // True when the response is complete before rx_length bytes, as an error response can be.
+        virtual bool complete(const Request& request, const uint8_t* response, int length) { return length >= request.rx_length; }
+
+        // The response, or what arrived of it before the timeout. Returns false to have the request sent
+        // again, as long as it has attempts left.
+        virtual bool response(const Request& request, const uint8_t* response, int length) { return true; }
+
+        // The request got no response the device accepted in all of its attempts.
+        virtual void failed(const Request& request) {}
+
+        virtual ~Device() {}
+
+    private:
+        friend class Bus;
+
+        uint32_t   _cancelled = 0;  // Requests submitted before this are dropped
+        TickType_t _next_poll = 0;
+    };
+
+    class Bus {
+    public:
+        // Starts the bus, or checks that the running bus has the same pins and baud rate. turnaround_us is
+        // the silence between the end of a response and the next request, 0 for none.
+        bool begin(const uart_config_t& config, uint8_t tx_pin, uint8_t rx_pin, uint8_t rts_pin, uint32_t turnaround_us);
+        bool started() { return _task != nullptr; }
+
+        // Polls the device when the bus is idle.
+        bool attach(Device* device);
+
+        // Queues the request without waiting, false when the queue is full.
+        bool submit(Request& request, Priority priority = Priority::High);
+
+        // Drops the requests of the device that are still queued.
+        void cancel(Device* device);
+
+        // Sends a request and waits for its response, in the calling task. For setup, before the device
+        // submits anything. Returns the number of bytes received.
+        int transact(const uint8_t* tx, uint16_t tx_length, uint8_t* rx, uint16_t rx_length, TickType_t timeout);
+
+    private:
+        static void busTask(void* pvParameters);
+
+        void run(Request& request);
+        bool next(Request& request);
+        int  exchange(const uint8_t* tx, uint16_t tx_length, uint8_t* rx, uint16_t rx_length, TickType_t timeout, Request* request);
+
+        int               _baud_rate;
+        uint8_t           _tx_pin;
+        uint8_t           _rx_pin;
+        uint8_t           _rts_pin;
+        uint32_t          _turnaround_us;
+        int64_t           _last_frame_us = 0;
+        QueueHandle_t     _queue[2]      = { nullptr, nullptr };
+        QueueHandle_t     _uart_queue    = nullptr;
+        SemaphoreHandle_t _lock          = nullptr;
+        TaskHandle_t      _task          = nullptr;
+        uint32_t          _seq           = 0;
+        Device*           _devices[RS485_BUS_MAX_DEVICES];
+        uint8_t           _n_devices = 0;
+    };
+
+    extern Bus bus;
+}
@@ -20,12 +20,155 @@
 
 #include "SDCard.h"
 
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+
 File        myFile;
 bool        SD_ready_next = false;  // Grbl has processed a line and is waiting for another
 uint8_t     SD_client     = CLIENT_SERIAL;
 uint32_t    sd_current_line_number;     // stores the most recent line number read from the SD
 static char comment[LINE_BUFFER_SIZE];  // Line to be executed. Zero-terminated.
 
+// Read-ahead. sdReadTask takes empty blocks from sd_empty_blocks, fills them from myFile and hands
+// them over in sd_full_blocks. readFileLine() works through one full block at a time and gives it
+// back when it is used up. A block shorter than SD_READ_BLOCK_SIZE is the end of the file.
+typedef struct {
+    uint8_t  index;
+    uint32_t generation;  // Blocks queued for an earlier file are dropped
+} sd_empty_block_t;
+
+typedef struct {
+    uint8_t  index;
+    uint32_t generation;
+    size_t   length;
+} sd_full_block_t;
+
+static uint8_t*          sd_blocks[2];
+static QueueHandle_t     sd_empty_blocks;
+static QueueHandle_t     sd_full_blocks;
+static SemaphoreHandle_t sd_file_mutex;  // Held by sdReadTask while it reads and while files are opened or closed
+static TaskHandle_t      sdReadTaskHandle = 0;
+static volatile uint32_t sd_generation    = 0;
+
+// Uploads and downloads. sdTransferTask writes or reads the blocks queued in sd_xfer_queue and gives
+// them back in sd_xfer_done, in order. An upload fills one block while the other is written, a download
+// sends one while the other is read. The blocks are only allocated during a transfer.
+typedef struct {
+    uint8_t index;
+    bool    read;
+    size_t  length;  // Bytes to write, or bytes read when given back
+} sd_xfer_block_t;
+
+static uint8_t*          sd_xfer_blocks[2];
+static QueueHandle_t     sd_xfer_queue;
+static QueueHandle_t     sd_xfer_done;
+static TaskHandle_t      sdTransferTaskHandle = 0;
+static File              sd_xfer_file;
+static volatile bool     sd_xfer_error;
+static bool              sd_xfer_active = false;
+static bool              sd_xfer_owned;  // sd_xfer_block is held by the caller, not the task
+static sd_xfer_block_t   sd_xfer_block;
+static uint32_t          sd_upload_size;
+static uint32_t          sd_upload_bytes;
+static int64_t           sd_upload_start_us;
+static int64_t           sd_upload_report_us;
+static bool              sd_upload_quiet;  // No progress messages, for a capture
+
+// The block being split into lines. Only used by the reader of the job.
+static sd_full_block_t sd_block;
+static size_t          sd_block_pos;
+static bool            sd_have_block;
+static bool            sd_at_end;
+static uint32_t        sd_file_size;
+static uint32_t        sd_bytes_used;  // Bytes handed out by readFileLine(), for the percent complete
+#ifdef SD_CHECKPOINT
+static uint32_t sd_line_offset;       // Of the line last read
+static uint32_t sd_checkpoint_saved;  // Line of the last checkpoint of the job
+#endif
+static int64_t         sd_job_start_us;
+
+static void sdReadTask(void* pvParameters) {
+    sd_empty_block_t empty;
+    while (true) {
+        task_stats_block();
+        xQueueReceive(sd_empty_blocks, &empty, portMAX_DELAY);
+        xSemaphoreTake(sd_file_mutex, portMAX_DELAY);
+        task_stats_unblock();
+        if (empty.generation == sd_generation && myFile) {
+            sd_full_block_t full = { empty.index, empty.generation, myFile.read(sd_blocks[empty.index], SD_READ_BLOCK_SIZE) };
+            xQueueSend(sd_full_blocks, &full, 0);  // Never full. Only two blocks are in use
+        }
+        xSemaphoreGive(sd_file_mutex);
+    }
+}
+
+static bool sd_read_ahead_init() {
+    if (sdReadTaskHandle) {
+        return true;
+    }
+    for (uint8_t i = 0; i < 2; i++) {
+        sd_blocks[i] = (uint8_t*)heap_caps_malloc(SD_READ_BLOCK_SIZE, MALLOC_CAP_DMA);
+        if (!sd_blocks[i]) {
+            return false;
+        }
+    }
+    sd_empty_blocks = xQueueCreate(2, sizeof(sd_empty_block_t));
+    sd_full_blocks  = xQueueCreate(2, sizeof(sd_full_block_t));
+    sd_file_mutex   = xSemaphoreCreateMutex();
+    xTaskCreatePinnedToCore(sdReadTask,    // task
+                            "sdReadTask",  // name for task
+                            SD_READ_TASK_STACK,
+                            NULL,  // parameters
+                            SD_READ_TASK_PRIORITY,
+                            &sdReadTaskHandle,
+                            SD_READ_TASK_CORE  // core
+    );
+    return true;
+}
+
+// Drops the blocks of the previous file and queues both blocks for the current one.
+// Called with sd_file_mutex held.
+static void sd_restart_read_ahead() {
+    sd_generation++;
+    xQueueReset(sd_empty_blocks);
+    xQueueReset(sd_full_blocks);
+    sd_have_block = false;
+    sd_at_end     = false;
+    sd_bytes_used = 0;
+    for (uint8_t i = 0; i < 2; i++) {
+        sd_empty_block_t empty = { i, sd_generation };
+        xQueueSend(sd_empty_blocks, &empty, 0);
+    }
+}
+
+// Makes sure the current block has unread bytes, waiting for sdReadTask if needed.
+// Returns false at the end of the file.
+static bool sd_fill() {
+    while (!sd_at_end && (!sd_have_block || sd_block_pos == sd_block.length)) {
+        if (sd_have_block) {
+            sd_have_block = false;
+            if (sd_block.length < SD_READ_BLOCK_SIZE) {
+                sd_at_end = true;
+                break;
+            }
+            sd_empty_block_t empty = { sd_block.index, sd_block.generation };
+            xQueueSend(sd_empty_blocks, &empty, portMAX_DELAY);
+        }
+        if (xQueueReceive(sd_full_blocks, &sd_block, 10 / portTICK_PERIOD_MS) != pdTRUE) {
+            if (!(get_sd_state(false) & (SDCARD_BUSY_PRINTING | SDCARD_BUSY_PARSING))) {
+                sd_at_end = true;  // The job was closed, e.g. by mc_reset()
+            }
+            continue;
+        }
+        if (sd_block.generation != sd_generation) {
+            continue;
+        }
+        sd_have_block = true;
+        sd_block_pos  = 0;
+    }
+    return !sd_at_end;
+}
+
 // attempt to mount the SD card
 /*bool sd_mount()
 {
@@ -61,25 +204,64 @@ void listDir(fs::FS& fs, const char* dirname, uint8_t levels, uint8_t client) {
 }
 
 boolean openFile(fs::FS& fs, const char* path) {
+    if (!sd_read_ahead_init()) {
+        return false;
+    }
+    xSemaphoreTake(sd_file_mutex, portMAX_DELAY);
     myFile = fs.open(path);
     if (!myFile) {
+        xSemaphoreGive(sd_file_mutex);
         //report_status_message(Error::SdFailedRead, CLIENT_SERIAL);
         return false;
     }
+    sd_file_size    = myFile.size();
+    sd_job_start_us = esp_timer_get_time();
+#ifdef ENABLE_JOB_STATS
+    job_stats_begin();
+#endif
+    sd_restart_read_ahead();
+    xSemaphoreGive(sd_file_mutex);
     set_sd_state(SDCARD_BUSY_PRINTING);
     SD_ready_next          = false;  // this will get set to true when Grbl issues "ok" message
     sd_current_line_number = 0;
+#ifdef ENABLE_O_CODES
+    ocode_reset();
+#endif
+#ifdef SD_CHECKPOINT
+    sd_checkpoint_saved = 0;
+#endif
     return true;
 }
 
+// Moves the job to position, which must be the start of line line_number, and restarts the
+// read-ahead there.
+boolean seekFile(uint32_t position, uint32_t line_number) {
+    if (!myFile) {
+        return false;
+    }
+    xSemaphoreTake(sd_file_mutex, portMAX_DELAY);
+    bool ok = myFile.seek(position);
+    sd_restart_read_ahead();
+    xSemaphoreGive(sd_file_mutex);
+    sd_bytes_used          = position;
+    sd_current_line_number = line_number - 1;
+    return ok;
+}
+
 boolean closeFile() {
     if (!myFile) {
         return false;
     }
+#ifdef ENABLE_JOB_STATS
+    job_stats_end();
+#endif
     set_sd_state(SDCARD_IDLE);
     SD_ready_next          = false;
     sd_current_line_number = 0;
+    xSemaphoreTake(sd_file_mutex, portMAX_DELAY);
     myFile.close();
+    sd_generation++;  // sdReadTask drops anything still queued for the file
+    xSemaphoreGive(sd_file_mutex);
     return true;
 }
 
@@ -96,33 +278,845 @@ boolean readFileLine(char* line, int maxlen) {
         return false;
     }
     sd_current_line_number += 1;
+#ifdef SD_CHECKPOINT
+    sd_line_offset = sd_bytes_used;
+#endif
     int len = 0;
-    while (myFile.available()) {
-        if (len >= maxlen) {
+    while (sd_fill()) {
+        const uint8_t* start = &sd_blocks[sd_block.index][sd_block_pos];
+        size_t         count = sd_block.length - sd_block_pos;
+        const uint8_t* eol   = (const uint8_t*)memchr(start, '\n', count);
+        if (eol) {
+            count = eol - start;
+        }
+        if (len + count >= size_t(maxlen)) {
             return false;
         }
-        char c = myFile.read();
-        if (c == '\n') {
+        memcpy(&line[len], start, count);
+        len += count;
+        sd_block_pos += count;
+        sd_bytes_used += count;
+        if (eol) {
+            sd_block_pos++;  // Skip the newline
+            sd_bytes_used++;
             break;
         }
-        line[len++] = c;
     }
     line[len] = '\0';
-    return len || myFile.available();
+    return len || sd_fill();
 }
 
 // return a percentage complete 50.5 = 50.5%
 float sd_report_perc_complete() {
-    if (!myFile) {
+    if (!myFile || !sd_file_size) {
         return 0.0;
     }
-    return (float)myFile.position() / (float)myFile.size() * 100.0f;
+    return (float)sd_bytes_used / (float)sd_file_size * 100.0f;
 }
 
 uint32_t sd_get_current_line_number() {
     return sd_current_line_number;
 }
 
+uint32_t sd_get_current_position() {
+    return sd_bytes_used;
+}
+
+#ifdef SD_CHECKPOINT
+static void sd_checkpoint_line();
+#endif
+
+// Runs a line read from the job, through the O-words when they are enabled.
+Error sd_execute_line(char* line, uint8_t client) {
+#ifdef SD_CHECKPOINT
+    sd_checkpoint_line();
+#endif
+#ifdef ENABLE_O_CODES
+    return ocode_file_line(line, client);
+#else
+    return gc_execute_line(line, client);
+#endif
+}
+
+// Job index. <file>.idx has a header and a record for every SD_INDEX_INTERVAL lines holding where the
+// line starts and the modal state in effect before it, so a job can be resumed from any line after
+// reading at most SD_INDEX_INTERVAL lines and without parsing anything before the resumed line.
+const uint32_t SD_INDEX_MAGIC   = 0x58444947;  // "GIDX"
+const uint16_t SD_INDEX_VERSION = 1;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t interval;
+    uint32_t source_size;  // Size of the indexed file, to catch files edited since
+} sd_index_header_t;
+
+typedef struct {
+    Motion       motion;
+    Plane        plane_select;
+    Units        units;
+    Distance     distance;
+    FeedRate     feed_mode;
+    CoordIndex   coord_select;
+    SpindleState spindle;
+    CoolantState coolant;
+    float        feed_rate;  // F as written, in the units of the file
+    float        spindle_speed;
+} sd_modal_t;
+
+typedef struct {
+    uint32_t   line;    // Number of the line starting at offset
+    uint32_t   offset;  // Byte offset in the file
+    sd_modal_t modal;
+} sd_index_record_t;
+
+static String sd_index_path(const char* path) {
+    return String(path) + ".idx";
+}
+
+// Tracks the modal words of one line closely enough to resume after it. Lines the parser would reject
+// are not handled, as a file that has them does not run anyway.
+static void sd_scan_modal(const char* line, sd_modal_t* modal) {
+    char    block[256];
+    uint8_t len = 0;
+    // Collapse like gc_execute_line(): no whitespace or comments, upper case.
+    for (bool in_comment = false; *line && len < sizeof(block) - 1; line++) {
+        char c = *line;
+        if (in_comment) {
+            in_comment = (c != ')');
+        } else if (c == '(') {
+            in_comment = true;
+        } else if (c == ';') {
+            break;
+        } else if (!isspace(c)) {
+            block[len++] = toupper(c);
+        }
+    }
+    block[len] = '\0';
+    if (block[0] == '$' || block[0] == '[') {
+        return;  // Not g-code
+    }
+    uint8_t pos = 0;
+    while (block[pos]) {
+        char  letter = block[pos++];
+        float value;
+        if (!read_float(block, &pos, &value)) {
+            return;
+        }
+        int code = lroundf(value * 10.0f);  // G38.2 is 382
+        switch (letter) {
+            case 'G':
+                switch (code) {
+                    case 0:
+                    case 10:
+                    case 20:
+                    case 30:
+                        modal->motion = static_cast<Motion>(code / 10);
+                        break;
+                    case 382:
+                    case 383:
+                    case 384:
+                    case 385:
+                        modal->motion = static_cast<Motion>(code - 382 + static_cast<int>(Motion::ProbeToward));
+                        break;
+                    case 800:
+                        modal->motion = Motion::None;
+                        break;
+                    case 170:
+                    case 180:
+                    case 190:
+                        modal->plane_select = static_cast<Plane>((code - 170) / 10);
+                        break;
+                    case 200:
+                        modal->units = Units::Inches;
+                        break;
+                    case 210:
+                        modal->units = Units::Mm;
+                        break;
+                    case 900:
+                        modal->distance = Distance::Absolute;
+                        break;
+                    case 910:
+                        modal->distance = Distance::Incremental;
+                        break;
+                    case 930:
+                        modal->feed_mode = FeedRate::InverseTime;
+                        break;
+                    case 940:
+                        modal->feed_mode = FeedRate::UnitsPerMin;
+                        break;
+                    case 540:
+                    case 550:
+                    case 560:
+                    case 570:
+                    case 580:
+                    case 590:
+                        modal->coord_select = static_cast<CoordIndex>((code - 540) / 10);
+                        break;
+                }
+                break;
+            case 'M':
+                switch (code) {
+                    case 20:
+                    case 300:
+                        // Program end resets the same modes as in gc_execute_line().
+                        modal->motion       = Motion::Linear;
+                        modal->plane_select = Plane::XY;
+                        modal->distance     = Distance::Absolute;
+                        modal->feed_mode    = FeedRate::UnitsPerMin;
+                        modal->coord_select = CoordIndex::G54;
+                        modal->spindle      = SpindleState::Disable;
+                        modal->coolant      = {};
+                        break;
+                    case 30:
+                        modal->spindle = SpindleState::Cw;
+                        break;
+                    case 40:
+                        modal->spindle = SpindleState::Ccw;
+                        break;
+                    case 50:
+                        modal->spindle = SpindleState::Disable;
+                        break;
+                    case 70:
+                        modal->coolant.Mist = 1;
+                        break;
+                    case 80:
+                        modal->coolant.Flood = 1;
+                        break;
+                    case 90:
+                        modal->coolant = {};
+                        break;
+                }
+                break;
+            case 'F':
+                modal->feed_rate = value;
+                break;
+            case 'S':
+                modal->spindle_speed = value;
+                break;
+        }
+    }
+}
+
+static void sd_modal_from_parser(sd_modal_t* modal) {
+    modal->motion        = gc_state.modal.motion;
+    modal->plane_select  = gc_state.modal.plane_select;
+    modal->units         = gc_state.modal.units;
+    modal->distance      = gc_state.modal.distance;
+    modal->feed_mode     = gc_state.modal.feed_rate;
+    modal->coord_select  = gc_state.modal.coord_select;
+    modal->spindle       = gc_state.modal.spindle;
+    modal->coolant       = gc_state.modal.coolant;
+    modal->feed_rate     = (modal->units == Units::Inches) ? gc_state.feed_rate / MM_PER_INCH : gc_state.feed_rate;
+    modal->spindle_speed = gc_state.spindle_speed;
+}
+
+// Sets the parser to the modal state, and the spindle and coolant to theirs. With a position, which is
+// in machine coordinates, the tool first goes there in the other axes at its current height and then
+// feeds down in Z with the spindle running.
+static Error sd_restore_modal(const sd_modal_t* modal, const float* position, uint8_t client) {
+    char  block[LINE_BUFFER_SIZE];
+    Error status = Error::Ok;
+    if (position) {
+        int length = snprintf(block, sizeof(block), "G21G53G0");
+        for (uint8_t axis = 0; axis < number_axis->get(); axis++) {
+            if (axis != Z_AXIS) {
+                length += snprintf(block + length, sizeof(block) - length, "%c%.4f", report_get_axis_letter(axis), position[axis]);
+            }
+        }
+        status = gc_execute_line(block, client);
+    }
+    if (status == Error::Ok) {
+        snprintf(block,
+                 sizeof(block),
+                 "G%dG%dG%dG%dG%dF%.4fS%.4fM%dM%d",
+                 17 + static_cast<int>(modal->plane_select),
+                 modal->units == Units::Inches ? 20 : 21,
+                 90 + static_cast<int>(modal->distance),
+                 modal->feed_mode == FeedRate::InverseTime ? 93 : 94,
+                 54 + static_cast<int>(modal->coord_select),
+                 modal->feed_rate,
+                 modal->spindle_speed,
+                 modal->spindle == SpindleState::Cw ? 3 : (modal->spindle == SpindleState::Ccw ? 4 : 5),
+                 modal->coolant.Flood ? 8 : (modal->coolant.Mist ? 7 : 9));
+        status = gc_execute_line(block, client);
+    }
+    if (status == Error::Ok && modal->coolant.Flood && modal->coolant.Mist) {
+        char mist[] = "M7";  // Only one coolant word is allowed per block
+        status      = gc_execute_line(mist, client);
+    }
+    if (status == Error::Ok && position) {
+        // G94 for the F of the plunge, then the feed mode and rate of the job again
+        float to_units = (modal->units == Units::Inches) ? 1.0 / MM_PER_INCH : 1.0;
+        snprintf(block, sizeof(block), "G94G53G1Z%.4fF%.4f", position[Z_AXIS] * to_units, modal->feed_rate);
+        status = gc_execute_line(block, client);
+        if (status == Error::Ok) {
+            snprintf(block, sizeof(block), "G%dF%.4f", modal->feed_mode == FeedRate::InverseTime ? 93 : 94, modal->feed_rate);
+            status = gc_execute_line(block, client);
+        }
+    }
+    // The motion mode cannot be set without a move, except by the parser itself.
+    if (status == Error::Ok && modal->motion <= Motion::CcwArc) {
+        gc_state.modal.motion = modal->motion;
+    }
+    return status;
+}
+
+// The index being written by sd_index_poll(), SD_INDEX_LINES_PER_POLL lines per pass of the main loop
+static File       sd_index_file;
+static fs::FS*    sd_index_fs;
+static String     sd_index_name;
+static sd_modal_t sd_index_modal;
+static uint8_t    sd_index_client;
+static int64_t    sd_index_start_us;
+
+// Starts writing <path>.idx. The modal state starts out as the parser's current state.
+Error sd_build_index(fs::FS& fs, const char* path, uint8_t client) {
+    if (!openFile(fs, path)) {
+        return Error::SdFailedRead;
+    }
+    set_sd_state(SDCARD_BUSY_PARSING);  // Not a job, so status messages are still sent
+    sd_index_name = sd_index_path(path);
+    sd_index_file = fs.open(sd_index_name, FILE_WRITE);
+    if (!sd_index_file) {
+        closeFile();
+        return Error::SdFailedOpenFile;
+    }
+    sd_index_header_t header = { SD_INDEX_MAGIC, SD_INDEX_VERSION, SD_INDEX_INTERVAL, sd_file_size };
+    if (sd_index_file.write((const uint8_t*)&header, sizeof(header)) != sizeof(header)) {
+        sd_index_file.close();
+        closeFile();
+        fs.remove(sd_index_name);
+        return Error::SdFailedOpenFile;
+    }
+    sd_index_fs       = &fs;
+    sd_index_client   = client;
+    sd_index_start_us = esp_timer_get_time();
+    sd_modal_from_parser(&sd_index_modal);
+    return Error::Ok;
+}
+
+void sd_index_poll() {
+    if (!sd_index_file) {
+        return;
+    }
+    bool ok  = true;
+    bool end = false;
+    char line[255];
+    for (int count = 0; ok && !end && count < SD_INDEX_LINES_PER_POLL; count++) {
+        uint32_t number = sd_current_line_number + 1;
+        if ((number - 1) % SD_INDEX_INTERVAL == 0) {
+            sd_index_record_t record = { number, sd_bytes_used, sd_index_modal };
+            ok                       = sd_index_file.write((const uint8_t*)&record, sizeof(record)) == sizeof(record);
+        }
+        if (ok) {
+            end = !readFileLine(line, sizeof(line));
+            if (!end) {
+                sd_scan_modal(line, &sd_index_modal);
+            }
+        }
+    }
+    if (ok && !end) {
+        return;  // More on the next pass
+    }
+    uint32_t lines = sd_current_line_number ? sd_current_line_number - 1 : 0;
+    bool     whole = sd_bytes_used >= sd_file_size;  // Else a line was too long for the buffer
+    sd_index_file.close();
+    closeFile();
+    if (!ok || !whole) {
+        // A partial index would send resumes past the failed line to the wrong offsets. Without one,
+        // sd_resume_job() reads the file from its start.
+        sd_index_fs->remove(sd_index_name);
+        if (!ok) {
+            grbl_msg_sendf(sd_index_client, MsgLevel::Info, "Index write failed");
+        } else {
+            grbl_msg_sendf(sd_index_client, MsgLevel::Info, "Line %u is too long, not indexed", lines + 1);
+        }
+        return;
+    }
+    uint32_t ms = uint32_t((esp_timer_get_time() - sd_index_start_us) / 1000);
+    grbl_msg_sendf(sd_index_client, MsgLevel::Info, "Indexed %u lines in %u ms", lines, ms);
+}
+
+// Starts path as a job from line, restoring the modal state recorded in its index first. Without a
+// usable index the file is read from its start instead.
+Error sd_resume_job(fs::FS& fs, const char* path, uint32_t line, uint8_t client) {
+    if (line == 0) {
+        return Error::SdFailedRead;
+    }
+    sd_index_header_t header = {};
+    sd_index_record_t record = {};
+    File              index  = fs.open(sd_index_path(path));
+    bool              ok     = false;
+    if (index) {
+        uint32_t records = index.size() >= sizeof(header) ? (index.size() - sizeof(header)) / sizeof(record) : 0;
+        ok               = records && index.read((uint8_t*)&header, sizeof(header)) == sizeof(header) &&
+             header.magic == SD_INDEX_MAGIC && header.version == SD_INDEX_VERSION && header.interval;
+        if (ok) {
+            uint32_t entry = MIN((line - 1) / header.interval, records - 1);
+            ok = index.seek(sizeof(header) + entry * sizeof(record)) && index.read((uint8_t*)&record, sizeof(record)) == sizeof(record);
+        }
+        index.close();
+    }
+    if (!openFile(fs, path)) {
+        return Error::SdFailedRead;
+    }
+    if (ok && header.source_size != sd_file_size) {
+        grbl_msg_sendf(client, MsgLevel::Info, "Index is out of date");
+        ok = false;
+    }
+    if (!ok) {
+        record.line   = 1;
+        record.offset = 0;
+        sd_modal_from_parser(&record.modal);
+    }
+    // Skip to the line, following only its modal words.
+    char skipped[255];
+    bool found = seekFile(record.offset, record.line);
+    while (found && sd_current_line_number + 1 < line) {
+        found = readFileLine(skipped, sizeof(skipped));
+        if (found) {
+            sd_scan_modal(skipped, &record.modal);
+        }
+    }
+    if (!found) {
+        closeFile();
+        return Error::SdFailedRead;
+    }
+    SD_client    = client;
+    Error status = sd_restore_modal(&record.modal, nullptr, client);
+    grbl_msg_sendf(client, MsgLevel::Info, "Resuming %s at line %u", path, line);
+    report_status_message(status, client);  // Starts the job, or closes the file on an error
+    return Error::Ok;
+}
+
+#ifdef SD_CHECKPOINT
+// Checkpoints. The state before each of the last SD_CHECKPOINT_LINES lines is kept in a ring, indexed by
+// the line number. Every SD_CHECKPOINT_INTERVAL_MS the line of the block the steppers are on is looked
+// up there and stored in NVS, whose writes are spread over its pages. All lines before that one are
+// done, so the job can go on from its start.
+const uint32_t SD_CHECKPOINT_MAGIC = 0x54504B43;  // "CKPT"
+const char*    SD_CHECKPOINT_KEY   = "SD_CKPT";
+
+typedef struct {
+    uint32_t   line;    // 0 for an unused entry
+    uint32_t   offset;  // Of the line in the file
+    sd_modal_t modal;
+    float      position[MAX_N_AXIS];  // Machine position of the parser, where the line starts
+} sd_line_state_t;
+
+typedef struct {
+    uint32_t        magic;
+    uint32_t        file_size;
+    char            path[SD_CHECKPOINT_PATH_LENGTH];
+    sd_line_state_t state;
+} sd_checkpoint_t;
+
+static sd_line_state_t sd_line_states[SD_CHECKPOINT_LINES];
+static int64_t         sd_checkpoint_next_us;
+
+static void sd_checkpoint_line() {
+    if (get_sd_state(false) != SDCARD_BUSY_PRINTING || sys.state == State::CheckMode) {
+        return;
+    }
+    sd_line_state_t* state = &sd_line_states[sd_current_line_number % SD_CHECKPOINT_LINES];
+    state->line            = sd_current_line_number;
+    state->offset          = sd_line_offset;
+    sd_modal_from_parser(&state->modal);
+    memcpy(state->position, gc_state.position, sizeof(state->position));
+}
+
+void sd_checkpoint_poll() {
+    int64_t now = esp_timer_get_time();
+    if (get_sd_state(false) != SDCARD_BUSY_PRINTING || sys.state == State::CheckMode || now < sd_checkpoint_next_us) {
+        return;
+    }
+    sd_checkpoint_next_us = now + SD_CHECKPOINT_INTERVAL_MS * 1000;
+    plan_block_t* block   = plan_get_current_block();
+    if (block == NULL || block->sd_line == 0 || block->sd_line == sd_checkpoint_saved) {
+        return;
+    }
+    const sd_line_state_t* state = &sd_line_states[block->sd_line % SD_CHECKPOINT_LINES];
+    if (state->line != block->sd_line) {
+        return;  // The parser is too far ahead, the line is gone from the ring
+    }
+    sd_checkpoint_t checkpoint = { SD_CHECKPOINT_MAGIC, sd_file_size };
+    strlcpy(checkpoint.path, myFile.name(), sizeof(checkpoint.path));
+    checkpoint.state = *state;
+    if (nvs_set_blob(Setting::_handle, SD_CHECKPOINT_KEY, &checkpoint, sizeof(checkpoint)) == ESP_OK &&
+        nvs_commit(Setting::_handle) == ESP_OK) {
+        sd_checkpoint_saved = block->sd_line;
+    }
+}
+
+void sd_checkpoint_clear() {
+    memset(sd_line_states, 0, sizeof(sd_line_states));
+    sd_checkpoint_saved   = 0;
+    sd_checkpoint_next_us = 0;
+    nvs_erase_key(Setting::_handle, SD_CHECKPOINT_KEY);
+    nvs_commit(Setting::_handle);
+}
+
+// Starts the job of the checkpoint from its line. The machine should be homed, so that the machine
+// position means the same as when the checkpoint was taken.
+Error sd_recover_job(uint8_t client) {
+    sd_checkpoint_t checkpoint;
+    size_t          length = sizeof(checkpoint);
+    if (nvs_get_blob(Setting::_handle, SD_CHECKPOINT_KEY, &checkpoint, &length) != ESP_OK || length != sizeof(checkpoint) ||
+        checkpoint.magic != SD_CHECKPOINT_MAGIC) {
+        grbl_msg_sendf(client, MsgLevel::Info, "No checkpoint");
+        return Error::SdFileNotFound;
+    }
+    if (!openFile(SD, checkpoint.path)) {
+        return Error::SdFailedRead;
+    }
+    if (checkpoint.file_size != sd_file_size || !seekFile(checkpoint.state.offset, checkpoint.state.line)) {
+        closeFile();
+        grbl_msg_sendf(client, MsgLevel::Info, "%s has changed since the checkpoint", checkpoint.path);
+        return Error::SdFailedRead;
+    }
+    SD_client    = client;
+    Error status = sd_restore_modal(&checkpoint.state.modal, checkpoint.state.position, client);
+    grbl_msg_sendf(client, MsgLevel::Info, "Recovering %s at line %u", checkpoint.path, checkpoint.state.line);
+    report_status_message(status, client);  // Starts the job, or closes the file on an error
+    return Error::Ok;
+}
+#endif
+
+#ifdef SD_JOB_QUEUE
+typedef struct {
+    char path[SD_JOB_QUEUE_PATH_LENGTH];
+    bool wait;
+} sd_queued_job_t;
+
+// Added to by the command task, taken from by protocol_main_loop().
+static sd_queued_job_t sd_queue[SD_JOB_QUEUE_SIZE];
+static uint8_t         sd_queue_head;
+static uint8_t         sd_queue_count;
+static portMUX_TYPE    sd_queue_mux = portMUX_INITIALIZER_UNLOCKED;
+
+Error sd_queue_add(const char* path, bool wait) {
+    if (strlen(path) >= SD_JOB_QUEUE_PATH_LENGTH) {
+        return Error::InvalidValue;
+    }
+    portENTER_CRITICAL(&sd_queue_mux);
+    bool full = sd_queue_count == SD_JOB_QUEUE_SIZE;
+    if (!full) {
+        sd_queued_job_t* job = &sd_queue[(sd_queue_head + sd_queue_count++) % SD_JOB_QUEUE_SIZE];
+        strcpy(job->path, path);
+        job->wait = wait;
+    }
+    portEXIT_CRITICAL(&sd_queue_mux);
+    return full ? Error::Overflow : Error::Ok;
+}
+
+static bool sd_queue_pop(sd_queued_job_t* job) {
+    portENTER_CRITICAL(&sd_queue_mux);
+    bool found = sd_queue_count != 0;
+    if (found) {
+        *job          = sd_queue[sd_queue_head];
+        sd_queue_head = (sd_queue_head + 1) % SD_JOB_QUEUE_SIZE;
+        sd_queue_count--;
+    }
+    portEXIT_CRITICAL(&sd_queue_mux);
+    return found;
+}
+
+// Opening the file starts the read-ahead, so its first block is loaded while the planner still runs
+// the end of the previous job.
+bool sd_queue_next(uint8_t client) {
+    sd_queued_job_t job;
+    if (!sd_queue_pop(&job)) {
+        return false;
+    }
+    if (!openFile(SD, job.path)) {
+        grbl_notifyf("SD queue error", "Cannot open %s, queue cleared", job.path);
+        sd_queue_clear();
+        report_status_message(Error::SdFailedRead, client);
+        return false;
+    }
+    SD_client = client;
+    grbl_msg_sendf(client, MsgLevel::Info, "Starting %s", job.path);
+    if (job.wait) {
+        char pause[] = "M0";  // Waits for the previous job to finish, then holds until cycle start
+        report_status_message(gc_execute_line(pause, client), client);
+    } else {
+        SD_ready_next = true;
+    }
+    return true;
+}
+
+void sd_queue_clear() {
+    portENTER_CRITICAL(&sd_queue_mux);
+    sd_queue_count = 0;
+    portEXIT_CRITICAL(&sd_queue_mux);
+}
+
+void sd_queue_report(uint8_t client) {
+    sd_queued_job_t jobs[SD_JOB_QUEUE_SIZE];
+    portENTER_CRITICAL(&sd_queue_mux);
+    uint8_t count = sd_queue_count;
+    for (uint8_t i = 0; i < count; i++) {
+        jobs[i] = sd_queue[(sd_queue_head + i) % SD_JOB_QUEUE_SIZE];
+    }
+    portEXIT_CRITICAL(&sd_queue_mux);
+    for (uint8_t i = 0; i < count; i++) {
+        grbl_sendf(client, "[QUEUE:%d|%s%s]\r\n", i + 1, jobs[i].path, jobs[i].wait ? "|WAIT" : "");
+    }
+}
+#endif
+
+void sd_report_job_rate(uint8_t client) {
+    // readFileLine() also counts the call that found the end of the file.
+    uint32_t lines = sd_current_line_number ? sd_current_line_number - 1 : 0;
+    uint32_t ms    = (esp_timer_get_time() - sd_job_start_us) / 1000;
+    uint32_t rate  = ms ? uint32_t(uint64_t(lines) * 1000 / ms) : lines;
+    grbl_msg_sendf(client, MsgLevel::Info, "SD job %u lines in %u ms, %u lines/s", lines, ms, rate);
+}
+
+static void sdTransferTask(void* pvParameters) {
+    sd_xfer_block_t block;
+    while (true) {
+        task_stats_block();
+        xQueueReceive(sd_xfer_queue, &block, portMAX_DELAY);
+        task_stats_unblock();
+        uint8_t* data = sd_xfer_blocks[block.index];
+        if (sd_xfer_error) {
+            block.length = 0;
+        } else if (block.read) {
+            int n        = sd_xfer_file.read(data, SD_UPLOAD_BLOCK_SIZE);
+            block.length = n > 0 ? n : 0;
+        } else if (sd_xfer_file.write(data, block.length) != block.length) {
+            sd_xfer_error = true;
+        }
+        xQueueSend(sd_xfer_done, &block, 0);  // Never full. Only two blocks are in use
+    }
+}
+
+static void sd_xfer_free_blocks() {
+    for (uint8_t i = 0; i < 2; i++) {
+        free(sd_xfer_blocks[i]);
+        sd_xfer_blocks[i] = NULL;
+    }
+}
+
+// Opens the file of a transfer and hands both blocks to the task for reading, or to the caller.
+static boolean sd_xfer_begin(fs::FS& fs, const char* path, const char* mode, bool read) {
+    if (sd_xfer_active) {
+        return false;
+    }
+    if (!sdTransferTaskHandle) {
+        sd_xfer_queue = xQueueCreate(2, sizeof(sd_xfer_block_t));
+        sd_xfer_done  = xQueueCreate(2, sizeof(sd_xfer_block_t));
+        xTaskCreatePinnedToCore(sdTransferTask,    // task
+                                "sdTransferTask",  // name for task
+                                SD_UPLOAD_TASK_STACK,
+                                NULL,  // parameters
+                                SD_UPLOAD_TASK_PRIORITY,
+                                &sdTransferTaskHandle,
+                                SD_UPLOAD_TASK_CORE  // core
+        );
+    }
+    for (uint8_t i = 0; i < 2; i++) {
+        sd_xfer_blocks[i] = (uint8_t*)heap_caps_malloc(SD_UPLOAD_BLOCK_SIZE, MALLOC_CAP_DMA);
+        if (!sd_xfer_blocks[i]) {
+            sd_xfer_free_blocks();
+            return false;
+        }
+    }
+    sd_xfer_file = fs.open(path, mode);
+    if (!sd_xfer_file || (read && sd_xfer_file.isDirectory())) {
+        sd_xfer_file.close();
+        sd_xfer_free_blocks();
+        return false;
+    }
+    xQueueReset(sd_xfer_queue);
+    xQueueReset(sd_xfer_done);
+    for (uint8_t i = 0; i < 2; i++) {
+        sd_xfer_block_t block = { i, read, 0 };
+        xQueueSend(read ? sd_xfer_queue : sd_xfer_done, &block, 0);
+    }
+    sd_xfer_error  = false;
+    sd_xfer_active = true;
+    sd_xfer_owned  = false;
+    return true;
+}
+
+// Waits until sdTransferTask has given back both blocks, after queueing the partly filled upload block
+// if write_rest is set, then closes the file.
+static void sd_xfer_finish(bool write_rest) {
+    uint8_t owned = 0;
+    if (sd_xfer_owned) {
+        if (write_rest && !sd_xfer_block.read && sd_xfer_block.length) {
+            xQueueSend(sd_xfer_queue, &sd_xfer_block, portMAX_DELAY);
+        } else {
+            owned = 1;
+        }
+        sd_xfer_owned = false;
+    }
+    sd_xfer_block_t block;
+    while (owned < 2) {
+        xQueueReceive(sd_xfer_done, &block, portMAX_DELAY);
+        owned++;
+    }
+    sd_xfer_file.close();
+    sd_xfer_free_blocks();
+    sd_xfer_active = false;
+}
+
+static void sd_upload_report(bool done) {
+    uint32_t ms   = (esp_timer_get_time() - sd_upload_start_us) / 1000;
+    uint32_t rate = ms ? uint32_t(uint64_t(sd_upload_bytes) * 1000 / 1024 / ms) : 0;
+    if (done) {
+        grbl_sendf(CLIENT_ALL, "[MSG:Upload %u KB in %u ms, %u KB/s]\r\n", sd_upload_bytes / 1024, ms, rate);
+    } else if (sd_upload_size) {
+        grbl_sendf(CLIENT_ALL, "[MSG:Upload %u%%, %u KB/s]\r\n", uint32_t(uint64_t(sd_upload_bytes) * 100 / sd_upload_size), rate);
+    } else {
+        grbl_sendf(CLIENT_ALL, "[MSG:Upload %u KB, %u KB/s]\r\n", sd_upload_bytes / 1024, rate);
+    }
+}
+
+boolean sd_upload_begin(fs::FS& fs, const char* path, uint32_t size) {
+    if (!sd_xfer_begin(fs, path, FILE_WRITE, false)) {
+        return false;
+    }
+    sd_upload_size      = size;
+    sd_upload_bytes     = 0;
+    sd_upload_start_us  = esp_timer_get_time();
+    sd_upload_report_us = sd_upload_start_us;
+    sd_upload_quiet     = false;
+    return true;
+}
+
+boolean sd_upload_write(const uint8_t* data, size_t length) {
+    if (!sd_xfer_active) {
+        return false;
+    }
+    sd_upload_bytes += length;
+    while (length) {
+        if (!sd_xfer_owned) {
+            xQueueReceive(sd_xfer_done, &sd_xfer_block, portMAX_DELAY);
+            sd_xfer_block.length = 0;
+            sd_xfer_owned        = true;
+        }
+        size_t n = SD_UPLOAD_BLOCK_SIZE - sd_xfer_block.length;
+        if (n > length) {
+            n = length;
+        }
+        memcpy(sd_xfer_blocks[sd_xfer_block.index] + sd_xfer_block.length, data, n);
+        sd_xfer_block.length += n;
+        data += n;
+        length -= n;
+        if (sd_xfer_block.length == SD_UPLOAD_BLOCK_SIZE) {
+            xQueueSend(sd_xfer_queue, &sd_xfer_block, portMAX_DELAY);
+            sd_xfer_owned = false;
+        }
+    }
+    int64_t now = esp_timer_get_time();
+    if (!sd_upload_quiet && now - sd_upload_report_us >= SD_UPLOAD_REPORT_MS * 1000) {
+        sd_upload_report_us = now;
+        sd_upload_report(false);
+    }
+    return !sd_xfer_error;
+}
+
+boolean sd_upload_end() {
+    if (!sd_xfer_active) {
+        return false;
+    }
+    sd_xfer_finish(true);
+    if (!sd_xfer_error && !sd_upload_quiet) {
+        sd_upload_report(true);
+    }
+    return !sd_xfer_error;
+}
+
+void sd_upload_abort() {
+    if (sd_xfer_active) {
+        sd_xfer_error = true;  // sdTransferTask skips the blocks still queued
+        sd_xfer_finish(false);
+    }
+}
+
+boolean sd_download_begin(fs::FS& fs, const char* path, uint32_t* size) {
+    if (!sd_xfer_begin(fs, path, FILE_READ, true)) {
+        return false;
+    }
+    *size = sd_xfer_file.size();
+    return true;
+}
+
+const uint8_t* sd_download_next(size_t* length) {
+    *length = 0;
+    if (!sd_xfer_active) {
+        return NULL;
+    }
+    if (sd_xfer_owned) {
+        // The previous block has been used, so it can be read again while the caller sends this one.
+        xQueueSend(sd_xfer_queue, &sd_xfer_block, portMAX_DELAY);
+        sd_xfer_owned = false;
+    }
+    xQueueReceive(sd_xfer_done, &sd_xfer_block, portMAX_DELAY);
+    sd_xfer_owned = true;
+    *length       = sd_xfer_block.length;
+    return sd_xfer_blocks[sd_xfer_block.index];
+}
+
+void sd_download_end() {
+    if (sd_xfer_active) {
+        sd_xfer_error = true;  // Blocks still queued are given back without reading
+        sd_xfer_finish(false);
+    }
+}
+
+#ifdef SD_CAPTURE
+uint8_t         sd_capture_client = CLIENT_ALL;
+static uint32_t sd_capture_lines;
+
+Error sd_capture_begin(fs::FS& fs, const char* path, uint8_t client) {
+    if (sd_capture_client != CLIENT_ALL || get_sd_state(true) != SDCARD_IDLE) {
+        return Error::SdFailedBusy;
+    }
+    if (!sd_upload_begin(fs, path, 0)) {
+        return Error::SdFailedOpenFile;
+    }
+    sd_upload_quiet = true;
+    set_sd_state(SDCARD_BUSY_UPLOADING);  // get_sd_state(true) would remount the card under the file
+    sd_capture_lines  = 0;
+    sd_capture_client = client;
+    return Error::Ok;
+}
+
+void sd_capture_line(const char* line) {
+    if (*line == '\0' || *line == '$' || *line == '[') {
+        return;
+    }
+    if (sd_upload_write((const uint8_t*)line, strlen(line)) && sd_upload_write((const uint8_t*)"\n", 1)) {
+        sd_capture_lines++;
+        return;
+    }
+    uint8_t client    = sd_capture_client;
+    sd_capture_client = CLIENT_ALL;
+    sd_upload_abort();
+    set_sd_state(SDCARD_IDLE);
+    grbl_msg_sendf(client, MsgLevel::Error, "Capture failed after %u lines", sd_capture_lines);
+}
+
+void sd_capture_end() {
+    if (sd_capture_client == CLIENT_ALL) {
+        return;
+    }
+    uint8_t client    = sd_capture_client;
+    sd_capture_client = CLIENT_ALL;
+    if (sd_upload_end()) {
+        grbl_msg_sendf(client, MsgLevel::Info, "Captured %u lines", sd_capture_lines);
+    } else {
+        grbl_msg_sendf(client, MsgLevel::Error, "Capture failed after %u lines", sd_capture_lines);
+    }
+    set_sd_state(SDCARD_IDLE);
+}
+#endif
+
 uint8_t sd_state = SDCARD_IDLE;
 
 uint8_t get_sd_state(bool refresh) {
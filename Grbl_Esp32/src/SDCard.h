@@ -21,6 +21,63 @@
 #include <SPI.h>
 
 #define SDCARD_DET_PIN -1
+
+// Files are read ahead by a background task into two blocks of this many bytes, so readFileLine()
+// splits lines out of memory while the next block is loaded.
+#ifndef SD_READ_BLOCK_SIZE
+#    define SD_READ_BLOCK_SIZE 4096
+#endif
+
+// Uploads and downloads go through two blocks of this many bytes, written or read by a background task.
+#ifndef SD_UPLOAD_BLOCK_SIZE
+#    define SD_UPLOAD_BLOCK_SIZE 16384
+#endif
+// Time between the upload progress messages.
+#ifndef SD_UPLOAD_REPORT_MS
+#    define SD_UPLOAD_REPORT_MS 2000
+#endif
+
+// Lines between the records of a job index. See sd_build_index().
+#ifndef SD_INDEX_INTERVAL
+#    define SD_INDEX_INTERVAL 500
+#endif
+// Lines sd_index_poll() reads per pass of the main loop while it builds an index.
+#ifndef SD_INDEX_LINES_PER_POLL
+#    define SD_INDEX_LINES_PER_POLL 64
+#endif
+
+// Most SD lines protocol_main_loop() runs before it services the other clients again. It stops
+// earlier once the planner is full.
+#ifndef SD_MAX_LINES_PER_LOOP
+#    define SD_MAX_LINES_PER_LOOP 32
+#endif
+
+#ifdef SD_CHECKPOINT
+// Time between checkpoints while a job runs, and the lines the state is kept for. The line the steppers
+// are on has to be among the last SD_CHECKPOINT_LINES the parser read.
+#    ifndef SD_CHECKPOINT_INTERVAL_MS
+#        define SD_CHECKPOINT_INTERVAL_MS 5000
+#    endif
+#    ifndef SD_CHECKPOINT_LINES
+#        define SD_CHECKPOINT_LINES 64
+#    endif
+#    ifndef SD_CHECKPOINT_PATH_LENGTH
+#        define SD_CHECKPOINT_PATH_LENGTH 64
+#    endif
+#endif
+
+#ifdef SD_JOB_QUEUE
+// Jobs waiting in the queue, and the longest path of one
+#    ifndef SD_JOB_QUEUE_SIZE
+#        define SD_JOB_QUEUE_SIZE 8
+#    endif
+#    ifndef SD_JOB_QUEUE_PATH_LENGTH
+#        define SD_JOB_QUEUE_PATH_LENGTH 64
+#    endif
+#endif
+
+static_assert(SD_READ_BLOCK_SIZE >= 512 && SD_READ_BLOCK_SIZE % 512 == 0, "SD_READ_BLOCK_SIZE must be a multiple of 512");
+static_assert(SD_UPLOAD_BLOCK_SIZE >= 512 && SD_UPLOAD_BLOCK_SIZE % 512 == 0, "SD_UPLOAD_BLOCK_SIZE must be a multiple of 512");
 const int SDCARD_DET_VAL = 0;
 
 const int SDCARD_IDLE           = 0;
@@ -37,9 +94,60 @@ uint8_t  get_sd_state(bool refresh);
 uint8_t  set_sd_state(uint8_t flag);
 void     listDir(fs::FS& fs, const char* dirname, uint8_t levels, uint8_t client);
 boolean  openFile(fs::FS& fs, const char* path);
+boolean  seekFile(uint32_t position, uint32_t line_number);
 boolean  closeFile();
 boolean  readFileLine(char* line, int len);
 void     readFile(fs::FS& fs, const char* path);
 float    sd_report_perc_complete();
 uint32_t sd_get_current_line_number();
+uint32_t sd_get_current_position();  // Offset of the line after the current one
+Error    sd_execute_line(char* line, uint8_t client);
 void     sd_get_current_filename(char* name);
+void     sd_report_job_rate(uint8_t client);  // Lines and lines/s of the job so far
+Error    sd_build_index(fs::FS& fs, const char* path, uint8_t client);
+void     sd_index_poll();  // Builds the index started by sd_build_index(), a few lines per call
+Error    sd_resume_job(fs::FS& fs, const char* path, uint32_t line, uint8_t client);
+
+#ifdef SD_CHECKPOINT
+// Power loss recovery. sd_checkpoint_poll() stores where the running job is when it is time to, and
+// sd_checkpoint_clear() drops the checkpoint when the job is done. sd_recover_job() restores the modal
+// state and the position of the checkpoint and goes on with the job from there.
+void  sd_checkpoint_poll();
+void  sd_checkpoint_clear();
+Error sd_recover_job(uint8_t client);
+#endif
+
+#ifdef SD_JOB_QUEUE
+// The job queue. wait holds the job until cycle start. sd_queue_next() starts the next job, if there is
+// one; it is called when a job has read its last line, and by $SD/Queue when no job is running.
+Error sd_queue_add(const char* path, bool wait);
+bool  sd_queue_next(uint8_t client);
+void  sd_queue_clear();
+void  sd_queue_report(uint8_t client);
+#endif
+
+// Writing an upload. The data is collected into full blocks, so every write but the last covers whole
+// sectors, and the caller only waits when both blocks are still being written. size is the expected
+// length for the progress messages, or 0 when unknown.
+boolean sd_upload_begin(fs::FS& fs, const char* path, uint32_t size);
+boolean sd_upload_write(const uint8_t* data, size_t length);  // False after a failed write
+boolean sd_upload_end();                                       // Writes the rest and closes the file
+void    sd_upload_abort();                                     // Closes the file without writing the rest
+
+#ifdef SD_CAPTURE
+// Recording a streamed job. While sd_capture_client is not CLIENT_ALL, every g-code line from that
+// client that executed without error is appended to the file through the upload writer, as the parser
+// collapsed it, so the file runs again with $SD/Run. $ and [ESP] commands are left out. The card is
+// busy until sd_capture_end().
+extern uint8_t sd_capture_client;
+
+Error sd_capture_begin(fs::FS& fs, const char* path, uint8_t client);
+void  sd_capture_line(const char* line);
+void  sd_capture_end();  // Writes the rest and reports the line count to the capturing client
+#endif
+
+// Reading a file for a download, one block ahead of the caller. Only one upload or download runs at a
+// time. sd_download_next() returns the next block, valid until the next call, with length 0 at the end.
+boolean        sd_download_begin(fs::FS& fs, const char* path, uint32_t* size);
+const uint8_t* sd_download_next(size_t* length);
+void           sd_download_end();
@@ -57,19 +57,166 @@
 
 #include "Grbl.h"
 
-portMUX_TYPE myMutex = portMUX_INITIALIZER_UNLOCKED;
-
 static TaskHandle_t serialCheckTaskHandle = 0;
 
-WebUI::InputBuffer client_buffer[CLIENT_COUNT];  // create a buffer for each client
+// Time of the first serial_notify() since serialCheckTask last went idle. Zero when none is pending.
+static volatile int64_t serial_notify_time = 0;
+
+static serial_latency_t realtime_latency;
+
+#ifdef USE_UART_DRIVER
+#    include <driver/uart.h>
+
+static const uart_port_t GRBL_UART = UART_NUM_0;
+
+static QueueHandle_t uart_queue = NULL;
+
+// Bytes taken from the driver ring in one call, then handed to serialCheckTask one by one.
+static uint8_t uart_chunk[128];
+static int     uart_chunk_len = 0;
+static int     uart_chunk_pos = 0;
+
+static int serial_uart_available() {
+    size_t buffered = 0;
+    uart_get_buffered_data_len(GRBL_UART, &buffered);
+    return (uart_chunk_len - uart_chunk_pos) + buffered;
+}
+
+static int serial_uart_read() {
+    if (uart_chunk_pos == uart_chunk_len) {
+        int n = uart_read_bytes(GRBL_UART, uart_chunk, sizeof(uart_chunk), 0);
+        if (n <= 0) {
+            return -1;
+        }
+        uart_chunk_len = n;
+        uart_chunk_pos = 0;
+    }
+    return uart_chunk[uart_chunk_pos++];
+}
+
+// Wakes serialCheckTask on the driver's receive events, so the UART need not wait for the next poll.
+static void uartEventTask(void* pvParameters) {
+    uart_event_t event;
+    while (true) {
+        task_stats_block();
+        BaseType_t received = xQueueReceive(uart_queue, &event, portMAX_DELAY);
+        task_stats_unblock();
+        if (received != pdTRUE) {
+            continue;
+        }
+        switch (event.type) {
+            case UART_DATA:
+                serial_notify();
+                break;
+            case UART_FIFO_OVF:
+            case UART_BUFFER_FULL:
+                // The data is lost either way, start clean instead of running a partial line
+                uart_flush_input(GRBL_UART);
+                xQueueReset(uart_queue);
+                grbl_send(CLIENT_SERIAL, "[MSG:Serial input overflow]\r\n");
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static void serial_uart_init() {
+    uart_config_t uart_config = {};
+    uart_config.baud_rate     = BAUD_RATE;
+    uart_config.data_bits     = UART_DATA_8_BITS;
+    uart_config.parity        = UART_PARITY_DISABLE;
+    uart_config.stop_bits     = UART_STOP_BITS_1;
+#    ifdef UART_FLOW_CONTROL
+    uart_config.flow_ctrl           = UART_HW_FLOWCTRL_CTS_RTS;
+    uart_config.rx_flow_ctrl_thresh = UART_RTS_THRESHOLD;
+    int rts_pin                     = UART_RTS_PIN;
+    int cts_pin                     = UART_CTS_PIN;
+#    else
+    uart_config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+    int rts_pin           = UART_PIN_NO_CHANGE;
+    int cts_pin           = UART_PIN_NO_CHANGE;
+#    endif
+    uart_param_config(GRBL_UART, &uart_config);
+    uart_set_pin(GRBL_UART, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, rts_pin, cts_pin);
+    uart_driver_install(GRBL_UART, UART_RX_BUFFER_SIZE, UART_TX_BUFFER_SIZE, UART_EVENT_QUEUE_SIZE, &uart_queue, 0);
+    xTaskCreatePinnedToCore(uartEventTask,    // task
+                            "uartEventTask",  // name for task
+                            UART_EVENT_TASK_STACK,
+                            NULL,  // parameters
+                            UART_EVENT_TASK_PRIORITY,
+                            NULL,
+                            UART_EVENT_TASK_CORE  // core
+    );
+}
+#else
+static int serial_uart_available() {
+    return Serial.available();
+}
+
+static int serial_uart_read() {
+    return Serial.read();
+}
+#endif
+
+// One buffer per client. serialCheckTask is the only writer and the protocol loop the only reader,
+// so the lock-free single-producer, single-consumer InputBuffer needs no critical sections.
+// Indexed by client number.
+WebUI::InputBuffer client_buffer[CLIENT_COUNT] = {
+    { RX_BUFFER_SIZE },         // CLIENT_SERIAL
+    { RX_BUFFER_SIZE },         // CLIENT_BT
+    { RX_BUFFER_SIZE_WEBUI },   // CLIENT_WEBUI
+    { RX_BUFFER_SIZE_TELNET },  // CLIENT_TELNET
+    { RX_BUFFER_SIZE },         // CLIENT_INPUT
+    { RX_BUFFER_SIZE_TELNET },  // CLIENT_UDP
+};
 
-// Returns the number of bytes available in a client buffer.
-uint8_t serial_get_rx_buffer_available(uint8_t client) {
-    return client_buffer[client].availableforwrite();
+// Bytes received by a client's interface that serialCheckTask has not moved to its buffer yet.
+static int client_pending(uint8_t client) {
+    switch (client) {
+        case CLIENT_SERIAL:
+            return serial_uart_available();
+        case CLIENT_INPUT:
+            return WebUI::inputBuffer.available();
+#ifdef ENABLE_BLUETOOTH
+        case CLIENT_BT:
+            return WebUI::SerialBT.available();
+#endif
+#if defined(ENABLE_WIFI) && defined(ENABLE_HTTP) && defined(ENABLE_SERIAL2SOCKET_IN)
+        case CLIENT_WEBUI:
+            return WebUI::Serial2Socket.available();
+#endif
+#if defined(ENABLE_WIFI) && defined(ENABLE_TELNET)
+        case CLIENT_TELNET:
+            return WebUI::telnet_server.available();
+#endif
+#if defined(ENABLE_WIFI) && defined(ENABLE_UDP_STREAM)
+        case CLIENT_UDP:
+            return WebUI::udp_stream.available();
+#endif
+        default:
+            return 0;
+    }
+}
+
+uint16_t serial_get_rx_buffer_available(uint8_t client) {
+    if (client >= CLIENT_COUNT) {
+        return 0;
+    }
+    int available = client_buffer[client].availableforwrite() - client_pending(client);
+    return available > 0 ? available : 0;
+}
+
+uint16_t serial_get_rx_buffer_size(uint8_t client) {
+    return client < CLIENT_COUNT ? client_buffer[client].size() : 0;
 }
 
 void serial_init() {
+#ifdef USE_UART_DRIVER
+    serial_uart_init();
+#else
     Serial.begin(BAUD_RATE);
+#endif
     // reset all buffers
     serial_reset_read_buffer(CLIENT_ALL);
     grbl_send(CLIENT_SERIAL, "\r\n");  // create some white space after ESP32 boot info
@@ -77,27 +224,136 @@ void serial_init() {
     // create a task to check for incoming data
     xTaskCreatePinnedToCore(serialCheckTask,    // task
                             "serialCheckTask",  // name for task
-                            8192,               // size of task stack
-                            NULL,               // parameters
-                            1,                  // priority
+                            SERIAL_CHECK_TASK_STACK,
+                            NULL,  // parameters
+                            SERIAL_CHECK_TASK_PRIORITY,
                             &serialCheckTaskHandle,
-                            1  // core
+                            SERIAL_CHECK_TASK_CORE  // core
     );
 }
 
+// Wakes serialCheckTask right away. Called by the input sources that get told about new data, like
+// the Bluetooth callback, the WebUI socket and telnet. The UART is still polled every SERIAL_POLL_MS,
+// unless USE_UART_DRIVER gives it events too.
+void serial_notify() {
+    if (serialCheckTaskHandle) {
+        if (serial_notify_time == 0) {
+            serial_notify_time = esp_timer_get_time();
+        }
+        xTaskNotifyGive(serialCheckTaskHandle);
+    }
+}
+
+// Records the time from a realtime command being available to it being executed. For polled sources
+// the arrival time is not known, so the time the task last went idle is used, giving a worst case value.
+static void serial_record_latency(int64_t arrival) {
+    uint32_t latency = esp_timer_get_time() - arrival;
+    realtime_latency.count++;
+    realtime_latency.total_us += latency;
+    realtime_latency.last_us = latency;
+    if (latency > realtime_latency.max_us) {
+        realtime_latency.max_us = latency;
+    }
+}
+
+const serial_latency_t* serial_get_realtime_latency() {
+    return &realtime_latency;
+}
+
+void serial_reset_realtime_latency() {
+    memset(&realtime_latency, 0, sizeof(serial_latency_t));
+}
+
+// Acts on a realtime character, or adds any other to the client buffer.
+static void serial_receive(uint8_t client, uint8_t data, int64_t idle_since) {
+#ifdef ENABLE_BINARY_STREAM
+    // Bytes of a binary frame are consumed whole, so record payloads never look like realtime commands.
+    if (binary_stream_feed(client, data)) {
+        return;
+    }
+#endif
+    // Pick off realtime command characters directly from the serial stream. These characters are
+    // not passed into the main buffer, but these set system state flag bits for realtime execution.
+    if (is_realtime_command(data)) {
+        int64_t arrival = serial_notify_time ? serial_notify_time : idle_since;
+        serial_record_latency(arrival);
+#ifdef ENABLE_REALTIME_TRACE
+        rt_trace_start(data, arrival);
+#endif
+        execute_realtime_command(data, client);
+    } else {
+        client_buffer[client].write(data);
+    }
+}
+
+// Nonzero when one of the four bytes of word is zero.
+static inline uint32_t serial_zero_byte(uint32_t word) {
+    return (word - 0x01010101) & ~word & 0x80808080;
+}
+
+// Nonzero when one of the four bytes of word is c.
+static inline uint32_t serial_has_byte(uint32_t word, uint8_t c) {
+    return serial_zero_byte(word ^ (c * 0x01010101u));
+}
+
+// Length of the text at the start of data that holds no realtime character. Words of four bytes are
+// checked at once, like memchr() does, and the last few bytes one by one.
+static size_t serial_text_length(const uint8_t* data, size_t size) {
+    size_t length = 0;
+    for (; length + 4 <= size; length += 4) {
+        uint32_t word;
+        memcpy(&word, data + length, 4);
+        if ((word & 0x80808080) || serial_has_byte(word, CMD_RESET) || serial_has_byte(word, CMD_STATUS_REPORT) ||
+            serial_has_byte(word, CMD_CYCLE_START) || serial_has_byte(word, CMD_FEED_HOLD)) {
+            break;
+        }
+    }
+    while (length < size && !is_realtime_command(data[length])) {
+        length++;
+    }
+    return length;
+}
+
+// Moves a block read from a buffered source to the client buffer. The text between realtime
+// characters is copied with one write instead of byte by byte.
+static void serial_receive_block(uint8_t client, const uint8_t* data, size_t size, int64_t idle_since) {
+    metric_rx(client, size);
+    idle_power_wake();
+#ifdef ENABLE_BINARY_STREAM
+    // Frames can start anywhere and span blocks, so the parser sees every byte.
+    for (size_t i = 0; i < size; i++) {
+        serial_receive(client, data[i], idle_since);
+    }
+#else
+    while (size) {
+        size_t length = serial_text_length(data, size);
+        client_buffer[client].write(data, length);
+        data += length;
+        size -= length;
+        if (size) {
+            serial_receive(client, *data++, idle_since);
+            size--;
+        }
+    }
+#endif
+}
+
 // this task runs and checks for data on all interfaces
 // REaltime stuff is acted upon, then characters are added to the appropriate buffer
 void serialCheckTask(void* pvParameters) {
-    uint8_t data   = 0;
-    uint8_t client = CLIENT_ALL;  // who sent the data
-    while (true) {                // run continuously
+    uint8_t data       = 0;
+    uint8_t client     = CLIENT_ALL;  // who sent the data
+    int64_t idle_since = esp_timer_get_time();
+    // Taken at once from the buffered sources
+    uint8_t block[SERIAL_BLOCK_SIZE];
+    while (true) {  // run continuously
         while (any_client_has_data()) {
-            if (Serial.available()) {
+            if (serial_uart_available()) {
                 client = CLIENT_SERIAL;
-                data   = Serial.read();
+                data   = serial_uart_read();
             } else if (WebUI::inputBuffer.available()) {
-                client = CLIENT_INPUT;
-                data   = WebUI::inputBuffer.read();
+                serial_receive_block(CLIENT_INPUT, block, WebUI::inputBuffer.read(block, sizeof(block)), idle_since);
+                continue;
             } else {
                 //currently is wifi or BT but better to prepare both can be live
 #ifdef ENABLE_BLUETOOTH
@@ -109,14 +365,23 @@ void serialCheckTask(void* pvParameters) {
 #endif
 #if defined(ENABLE_WIFI) && defined(ENABLE_HTTP) && defined(ENABLE_SERIAL2SOCKET_IN)
                     if (WebUI::Serial2Socket.available()) {
-                        client = CLIENT_WEBUI;
-                        data   = WebUI::Serial2Socket.read();
+                        serial_receive_block(CLIENT_WEBUI, block, WebUI::Serial2Socket.read(block, sizeof(block)), idle_since);
+                        continue;
                     } else {
 #endif
 #if defined(ENABLE_WIFI) && defined(ENABLE_TELNET)
                         if (WebUI::telnet_server.available()) {
                             client = CLIENT_TELNET;
                             data   = WebUI::telnet_server.read();
+                        } else {
+#endif
+#if defined(ENABLE_WIFI) && defined(ENABLE_UDP_STREAM)
+                            if (WebUI::udp_stream.available()) {
+                                client = CLIENT_UDP;
+                                data   = WebUI::udp_stream.read();
+                            }
+#endif
+#if defined(ENABLE_WIFI) && defined(ENABLE_TELNET)
                         }
 #endif
 #if defined(ENABLE_WIFI) && defined(ENABLE_HTTP) && defined(ENABLE_SERIAL2SOCKET_IN)
@@ -126,28 +391,31 @@ void serialCheckTask(void* pvParameters) {
                 }
 #endif
             }
-            // Pick off realtime command characters directly from the serial stream. These characters are
-            // not passed into the main buffer, but these set system state flag bits for realtime execution.
-            if (is_realtime_command(data)) {
-                execute_realtime_command(data, client);
-            } else {
-                vTaskEnterCritical(&myMutex);
-                client_buffer[client].write(data);
-                vTaskExitCritical(&myMutex);
-            }
+            metric_rx(client);
+            idle_power_wake();
+            serial_receive(client, data, idle_since);
         }  // if something available
         WebUI::COMMANDS::handle();
+        if (boot_network_ready()) {  // Started in the background, see BootTrace.h
 #ifdef ENABLE_WIFI
-        WebUI::wifi_config.handle();
+            WebUI::wifi_config.handle();
 #endif
 #ifdef ENABLE_BLUETOOTH
-        WebUI::bt_config.handle();
+            WebUI::bt_config.handle();
 #endif
-#if defined(ENABLE_WIFI) && defined(ENABLE_HTTP) && defined(ENABLE_SERIAL2SOCKET_IN)
+        }
+#if defined(ENABLE_WIFI) && defined(ENABLE_HTTP) && defined(ENABLE_SERIAL2SOCKET_OUT)
         WebUI::Serial2Socket.handle_flush();
 #endif
-        vTaskDelay(1 / portTICK_RATE_MS);  // Yield to other tasks
-    }                                      // while(true)
+        report_status_push();
+        report_credit_push();
+        // Sleep until a source signals new data, or the next poll of the sources that cannot.
+        serial_notify_time = 0;
+        idle_since         = esp_timer_get_time();
+        task_stats_block();
+        ulTaskNotifyTake(pdTRUE, SERIAL_POLL_MS / portTICK_RATE_MS);
+        task_stats_unblock();
+    }  // while(true)
 }
 
 void serial_reset_read_buffer(uint8_t client) {
@@ -160,26 +428,53 @@ void serial_reset_read_buffer(uint8_t client) {
 
 // Writes one byte to the TX serial buffer. Called by main program.
 void serial_write(uint8_t data) {
+#ifdef USE_UART_DRIVER
+    uart_write_bytes(GRBL_UART, (const char*)&data, 1);
+#else
     Serial.write((char)data);
+#endif
+}
+
+void serial_print(const char* text) {
+#ifdef USE_UART_DRIVER
+    uart_write_bytes(GRBL_UART, text, strlen(text));
+#else
+    Serial.print(text);
+#endif
+}
+
+uint32_t serial_get_baud_rate() {
+#ifdef USE_UART_DRIVER
+    uint32_t baud = 0;
+    uart_get_baudrate(GRBL_UART, &baud);
+    return baud;
+#else
+    return Serial.baudRate();
+#endif
 }
 
 // Fetches the first byte in the serial read buffer. Called by protocol loop.
 uint8_t serial_read(uint8_t client) {
-    uint8_t data;
-    vTaskEnterCritical(&myMutex);
-    if (client_buffer[client].available()) {
-        data = client_buffer[client].read();
-        vTaskExitCritical(&myMutex);
-        //Serial.write((char)data);
-        return data;
-    } else {
-        vTaskExitCritical(&myMutex);
-        return SERIAL_NO_DATA;
-    }
+    int data = client_buffer[client].read();
+    return data < 0 ? SERIAL_NO_DATA : data;
+}
+
+// Fetches up to size bytes from a client read buffer. Returns the number of bytes copied.
+size_t serial_read_bulk(uint8_t client, uint8_t* data, size_t size) {
+    return client_buffer[client].read(data, size);
+}
+
+// Queues bytes into a client read buffer as if they had been received. Returns the number queued.
+size_t serial_write_bulk(uint8_t client, const uint8_t* data, size_t size) {
+    return client_buffer[client].write(data, size);
+}
+
+bool serial_has_data(uint8_t client) {
+    return client_buffer[client].available() > 0;
 }
 
 bool any_client_has_data() {
-    return (Serial.available() || WebUI::inputBuffer.available()
+    return (serial_uart_available() || WebUI::inputBuffer.available()
 #ifdef ENABLE_BLUETOOTH
             || (WebUI::SerialBT.hasClient() && WebUI::SerialBT.available())
 #endif
@@ -188,6 +483,9 @@ bool any_client_has_data() {
 #endif
 #if defined(ENABLE_WIFI) && defined(ENABLE_TELNET)
             || WebUI::telnet_server.available()
+#endif
+#if defined(ENABLE_WIFI) && defined(ENABLE_UDP_STREAM)
+            || WebUI::udp_stream.available()
 #endif
     );
 }
@@ -202,15 +500,24 @@ void execute_realtime_command(uint8_t command, uint8_t client) {
     switch (command) {
         case CMD_RESET:
             mc_reset();  // Call motion control reset routine.
+#ifdef ENABLE_REALTIME_TRACE
+            rt_trace_hop(RtCmd::Reset, RtHop::Flag, false);
+#endif
             break;
         case CMD_STATUS_REPORT:
             report_realtime_status(client);  // direct call instead of setting flag
             break;
         case CMD_CYCLE_START:
             system_set_exec_state_flag(EXEC_CYCLE_START);  // Set as true
+#ifdef ENABLE_REALTIME_TRACE
+            rt_trace_hop(RtCmd::CycleStart, RtHop::Flag, false);
+#endif
             break;
         case CMD_FEED_HOLD:
             system_set_exec_state_flag(EXEC_FEED_HOLD);  // Set as true
+#ifdef ENABLE_REALTIME_TRACE
+            rt_trace_hop(RtCmd::FeedHold, RtHop::Flag, false);
+#endif
             break;
         case CMD_SAFETY_DOOR:
             system_set_exec_state_flag(EXEC_SAFETY_DOOR);
@@ -218,6 +525,9 @@ void execute_realtime_command(uint8_t command, uint8_t client) {
         case CMD_JOG_CANCEL:
             if (sys.state == State::Jog) {  // Block all other states from invoking motion cancel.
                 system_set_exec_state_flag(EXEC_MOTION_CANCEL);
+#ifdef ENABLE_REALTIME_TRACE
+                rt_trace_hop(RtCmd::JogCancel, RtHop::Flag, false);
+#endif
             }
             break;
 #ifdef DEBUG
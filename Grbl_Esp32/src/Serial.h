@@ -25,6 +25,21 @@
 #ifndef RX_BUFFER_SIZE
 #    define RX_BUFFER_SIZE 128
 #endif
+// The network clients get deeper receive buffers so a sender can keep the planner full across their
+// longer round trips. The other clients use RX_BUFFER_SIZE.
+#ifndef RX_BUFFER_SIZE_TELNET
+#    define RX_BUFFER_SIZE_TELNET 1024
+#endif
+#ifndef RX_BUFFER_SIZE_WEBUI
+#    define RX_BUFFER_SIZE_WEBUI 1024
+#endif
+
+static_assert((RX_BUFFER_SIZE & (RX_BUFFER_SIZE - 1)) == 0 && RX_BUFFER_SIZE <= 32768, "RX_BUFFER_SIZE must be a power of 2 up to 32768");
+static_assert((RX_BUFFER_SIZE_TELNET & (RX_BUFFER_SIZE_TELNET - 1)) == 0 && RX_BUFFER_SIZE_TELNET <= 32768,
+              "RX_BUFFER_SIZE_TELNET must be a power of 2 up to 32768");
+static_assert((RX_BUFFER_SIZE_WEBUI & (RX_BUFFER_SIZE_WEBUI - 1)) == 0 && RX_BUFFER_SIZE_WEBUI <= 32768,
+              "RX_BUFFER_SIZE_WEBUI must be a power of 2 up to 32768");
+
 #ifndef TX_BUFFER_SIZE
 #    ifdef USE_LINE_NUMBERS
 #        define TX_BUFFER_SIZE 112
@@ -35,12 +50,50 @@
 
 const float SERIAL_NO_DATA = 0xff;
 
+// serialCheckTask takes up to this many bytes at once from the WebUI command buffers. Stack space.
+#ifndef SERIAL_BLOCK_SIZE
+#    define SERIAL_BLOCK_SIZE 256
+#endif
+
+// The UART and telnet cannot signal new data, so serialCheckTask still polls them this often.
+#ifndef SERIAL_POLL_MS
+#    define SERIAL_POLL_MS 1
+#endif
+
+#ifdef USE_UART_DRIVER
+// The driver's receive ring, in bytes. It must exceed the 128 byte hardware FIFO.
+#    ifndef UART_RX_BUFFER_SIZE
+#        define UART_RX_BUFFER_SIZE 8192
+#    endif
+// Output is queued in a ring of this size instead of waiting for the FIFO.
+#    ifndef UART_TX_BUFFER_SIZE
+#        define UART_TX_BUFFER_SIZE 2048
+#    endif
+#    ifndef UART_EVENT_QUEUE_SIZE
+#        define UART_EVENT_QUEUE_SIZE 16
+#    endif
+// FIFO fill at which RTS tells the host to pause, out of 128
+#    ifndef UART_RTS_THRESHOLD
+#        define UART_RTS_THRESHOLD 100
+#    endif
+static_assert(UART_RX_BUFFER_SIZE > 128, "UART_RX_BUFFER_SIZE must exceed the UART FIFO");
+#    if defined(UART_FLOW_CONTROL) && (!defined(UART_RTS_PIN) || !defined(UART_CTS_PIN))
+#        error "UART_FLOW_CONTROL needs UART_RTS_PIN and UART_CTS_PIN"
+#    endif
+#endif
+
 // a task to read for incoming data from serial port
 void serialCheckTask(void* pvParameters);
 
 void serial_write(uint8_t data);
+// Writes text to the serial port.
+void     serial_print(const char* text);
+uint32_t serial_get_baud_rate();
 // Fetches the first byte in the serial read buffer. Called by main program.
 uint8_t serial_read(uint8_t client);
+// Bulk versions of the above for a client read buffer. Return the number of bytes transferred.
+size_t serial_read_bulk(uint8_t client, uint8_t* data, size_t size);
+size_t serial_write_bulk(uint8_t client, const uint8_t* data, size_t size);
 
 // See if the character is an action command like feedhold or jogging. If so, do the action and return true
 uint8_t check_action_command(uint8_t data);
@@ -48,8 +101,26 @@ uint8_t check_action_command(uint8_t data);
 void serial_init();
 void serial_reset_read_buffer(uint8_t client);
 
-// Returns the number of bytes available in the RX serial buffer.
-uint8_t serial_get_rx_buffer_available(uint8_t client);
+// Returns the number of bytes a sender can still send to client without overrunning its receive buffer.
+// Bytes already received by the interface but not yet moved to the receive buffer are counted as used.
+uint16_t serial_get_rx_buffer_available(uint8_t client);
+uint16_t serial_get_rx_buffer_size(uint8_t client);
+
+// True if the client's receive buffer holds bytes the main loop has not read yet.
+bool serial_has_data(uint8_t client);
+
+// Wakes the serial task when new input is available on a client that can signal it.
+void serial_notify();
+
+// How long realtime commands wait between arriving and being executed, in microseconds.
+typedef struct {
+    uint32_t count;
+    uint32_t last_us;
+    uint32_t max_us;
+    uint64_t total_us;
+} serial_latency_t;
+const serial_latency_t* serial_get_realtime_latency();
+void                    serial_reset_realtime_latency();
 
 void execute_realtime_command(uint8_t command, uint8_t client);
 bool any_client_has_data();
@@ -1,20 +1,25 @@
 #include "Grbl.h"
 #include "WebUI/JSONEncoder.h"
+#include <cmath>
 #include <map>
 #include <nvs.h>
 
 Word::Word(type_t type, permissions_t permissions, const char* description, const char* grblName, const char* fullName) :
     _description(description), _grblName(grblName), _fullName(fullName), _type(type), _permissions(permissions) {}
 
-Command* Command::List = NULL;
+Command* Command::List  = NULL;
+uint16_t Command::Count = 0;
 
 Command::Command(const char* description, type_t type, permissions_t permissions, const char* grblName, const char* fullName) :
     Word(type, permissions, description, grblName, fullName) {
     link = List;
     List = this;
+    Count++;
 }
 
-Setting* Setting::List = NULL;
+Setting* Setting::List  = NULL;
+uint16_t Setting::Count      = 0;
+uint32_t Setting::Generation = 1;
 
 Setting::Setting(
     const char* description, type_t type, permissions_t permissions, const char* grblName, const char* fullName, bool (*checker)(char*)) :
@@ -22,6 +27,7 @@ Setting::Setting(
     _checker(checker) {
     link = List;
     List = this;
+    Count++;
 
     // NVS keys are limited to 15 characters, so if the setting name is longer
     // than that, we derive a 15-character name from a hash function
@@ -50,7 +56,9 @@ Error Setting::check(char* s) {
     return _checker(s) ? Error::Ok : Error::InvalidValue;
 }
 
-nvs_handle Setting::_handle = 0;
+nvs_handle Setting::_handle           = 0;
+uint8_t    Setting::_transactionDepth = 0;
+bool       Setting::_dirty            = false;
 
 void Setting::init() {
     if (!_handle) {
@@ -60,6 +68,130 @@ void Setting::init() {
     }
 }
 
+void Setting::begin() {
+    _transactionDepth++;
+}
+
+Error Setting::commit() {
+    if (_transactionDepth && --_transactionDepth) {
+        return Error::Ok;
+    }
+    if (!_dirty) {
+        return Error::Ok;
+    }
+    _dirty = false;
+#ifdef SETTINGS_NVS_BLOB
+    saveBlob();  // Committed together with the keys it mirrors
+#endif
+    return nvs_commit(_handle) ? Error::NvsSetFailed : Error::Ok;
+}
+
+#ifdef SETTINGS_NVS_BLOB
+// The blob holds the stored value of every numeric setting, in the order of Setting::List, after a
+// bitmap of the settings that have one. layout hashes their key names, so a firmware with another
+// set of settings doesn't take the values of the wrong ones.
+static const char*    SETTINGS_BLOB_KEY     = "settings";
+static const uint16_t SETTINGS_BLOB_VERSION = 1;
+static const uint32_t FNV_OFFSET_BASIS      = 2166136261u;
+
+typedef struct {
+    uint16_t version;
+    uint16_t count;     // Numeric settings
+    uint32_t layout;    // Hash of their key names
+    uint32_t checksum;  // Hash of the bitmap and the values
+} settings_blob_header_t;
+
+static uint32_t settings_blob_hash(uint32_t hash, const uint8_t* data, size_t len) {
+    while (len--) {
+        hash = (hash ^ *data++) * 16777619u;  // FNV-1a
+    }
+    return hash;
+}
+
+uint16_t Setting::blobLayout(uint32_t* layout) {
+    uint16_t count = 0;
+    *layout        = FNV_OFFSET_BASIS;
+    for (Setting* s = List; s; s = s->next()) {
+        if (s->isNumeric()) {
+            *layout = settings_blob_hash(*layout, (const uint8_t*)s->_keyName, strlen(s->_keyName) + 1);
+            count++;
+        }
+    }
+    return count;
+}
+
+bool Setting::loadBlob() {
+    uint32_t layout;
+    uint16_t count = blobLayout(&layout);
+    size_t   words = (count + 31) / 32;
+    size_t   len   = sizeof(settings_blob_header_t) + (words + count) * sizeof(uint32_t);
+    uint8_t* blob  = (uint8_t*)malloc(len);
+    if (blob == NULL) {
+        return false;
+    }
+    auto   header = (settings_blob_header_t*)blob;
+    auto   bits   = (uint32_t*)(header + 1);
+    auto   values = (int32_t*)(bits + words);
+    size_t found  = len;
+    bool   valid  = nvs_get_blob(_handle, SETTINGS_BLOB_KEY, blob, &found) == ESP_OK && found == len;
+    valid         = valid && header->version == SETTINGS_BLOB_VERSION && header->count == count && header->layout == layout;
+    valid = valid && header->checksum == settings_blob_hash(FNV_OFFSET_BASIS, (const uint8_t*)bits, len - sizeof(settings_blob_header_t));
+    if (valid) {
+        uint16_t i = 0;
+        for (Setting* s = List; s; s = s->next()) {
+            if (s->isNumeric()) {
+                s->setStored(bits[i / 32] & (1u << (i % 32)), values[i]);
+                i++;
+            } else {
+                s->load();
+            }
+        }
+    }
+    free(blob);
+    return valid;
+}
+
+void Setting::saveBlob() {
+    uint32_t layout;
+    uint16_t count = blobLayout(&layout);
+    size_t   words = (count + 31) / 32;
+    size_t   len   = sizeof(settings_blob_header_t) + (words + count) * sizeof(uint32_t);
+    uint8_t* blob  = (uint8_t*)calloc(1, len);
+    if (blob == NULL) {
+        return;
+    }
+    auto     header = (settings_blob_header_t*)blob;
+    auto     bits   = (uint32_t*)(header + 1);
+    auto     values = (int32_t*)(bits + words);
+    uint16_t i      = 0;
+    for (Setting* s = List; s; s = s->next()) {
+        if (s->isNumeric()) {
+            if (s->getStored(&values[i])) {
+                bits[i / 32] |= 1u << (i % 32);
+            } else {
+                values[i] = 0;
+            }
+            i++;
+        }
+    }
+    header->version  = SETTINGS_BLOB_VERSION;
+    header->count    = count;
+    header->layout   = layout;
+    header->checksum = settings_blob_hash(FNV_OFFSET_BASIS, (const uint8_t*)bits, len - sizeof(settings_blob_header_t));
+    if (nvs_set_blob(_handle, SETTINGS_BLOB_KEY, blob, len)) {
+        nvs_erase_key(_handle, SETTINGS_BLOB_KEY);  // Rather the per-key values than a stale blob
+    }
+    free(blob);
+}
+#endif
+
+void Setting::changed() {
+    _dirty = true;
+    if (!_transactionDepth) {
+        commit();
+    }
+}
+
 IntSetting::IntSetting(const char*   description,
                        type_t        type,
                        permissions_t permissions,
@@ -76,23 +208,34 @@ IntSetting::IntSetting(const char*   description,
 }
 
 void IntSetting::load() {
-    esp_err_t err = nvs_get_i32(_handle, _keyName, &_storedValue);
-    if (err) {
+    int32_t raw;
+    setStored(nvs_get_i32(_handle, _keyName, &raw) == ESP_OK, raw);
+}
+
+bool IntSetting::getStored(int32_t* raw) {
+    *raw = _storedValue;
+    return _storedValue != std::numeric_limits<int32_t>::min();
+}
+
+void IntSetting::setStored(bool stored, int32_t raw) {
+    if (stored) {
+        _storedValue  = raw;
+        _currentValue = raw;
+    } else {
         _storedValue  = std::numeric_limits<int32_t>::min();
         _currentValue = _defaultValue;
-    } else {
-        _currentValue = _storedValue;
     }
 }
 
 void IntSetting::setDefault() {
-    if (_currentIsNvm) {
-        nvs_erase_key(_handle, _keyName);
-    } else {
+    if (!_currentIsNvm) {
         _currentValue = _defaultValue;
-        if (_storedValue != _currentValue) {
-            nvs_erase_key(_handle, _keyName);
-        }
+        Generation++;
+    }
+    if (_storedValue != std::numeric_limits<int32_t>::min()) {
+        nvs_erase_key(_handle, _keyName);
+        _storedValue = std::numeric_limits<int32_t>::min();
+        changed();
     }
 }
 
@@ -114,17 +257,20 @@ Error IntSetting::setStringValue(char* s) {
     // If we don't see the NVM state, we have to make this the live value:
     if (!_currentIsNvm) {
         _currentValue = convertedValue;
+        Generation++;
     }
 
     if (_storedValue != convertedValue) {
         if (convertedValue == _defaultValue) {
             nvs_erase_key(_handle, _keyName);
+            _storedValue = std::numeric_limits<int32_t>::min();
         } else {
             if (nvs_set_i32(_handle, _keyName, convertedValue)) {
                 return Error::NvsSetFailed;
             }
             _storedValue = convertedValue;
         }
+        changed();
     }
     return Error::Ok;
 }
@@ -165,19 +311,32 @@ AxisMaskSetting::AxisMaskSetting(const char*   description,
     _defaultValue(defVal), _currentValue(defVal) {}
 
 void AxisMaskSetting::load() {
-    esp_err_t err = nvs_get_i32(_handle, _keyName, &_storedValue);
-    if (err) {
+    int32_t raw;
+    setStored(nvs_get_i32(_handle, _keyName, &raw) == ESP_OK, raw);
+}
+
+bool AxisMaskSetting::getStored(int32_t* raw) {
+    *raw = _storedValue;
+    return _storedValue != -1;
+}
+
+void AxisMaskSetting::setStored(bool stored, int32_t raw) {
+    if (stored) {
+        _storedValue  = raw;
+        _currentValue = raw;
+    } else {
         _storedValue  = -1;
         _currentValue = _defaultValue;
-    } else {
-        _currentValue = _storedValue;
     }
 }
 
 void AxisMaskSetting::setDefault() {
     _currentValue = _defaultValue;
-    if (_storedValue != _currentValue) {
+    Generation++;
+    if (_storedValue != -1) {
         nvs_erase_key(_handle, _keyName);
+        _storedValue = -1;
+        changed();
     }
 }
 
@@ -207,15 +366,18 @@ Error AxisMaskSetting::setStringValue(char* s) {
         }
     }
     _currentValue = convertedValue;
+    Generation++;
     if (_storedValue != _currentValue) {
         if (_currentValue == _defaultValue) {
             nvs_erase_key(_handle, _keyName);
+            _storedValue = -1;
         } else {
             if (nvs_set_i32(_handle, _keyName, _currentValue)) {
                 return Error::NvsSetFailed;
             }
             _storedValue = _currentValue;
         }
+        changed();
     }
     return Error::Ok;
 }
@@ -256,24 +418,45 @@ FloatSetting::FloatSetting(const char*   description,
                            float         maxVal,
                            bool (*checker)(char*) = NULL) :
     Setting(description, type, permissions, grblName, name, checker),
-    _defaultValue(defVal), _currentValue(defVal), _minValue(minVal), _maxValue(maxVal) {}
+    _defaultValue(defVal), _currentValue(defVal), _storedValue(NAN), _minValue(minVal), _maxValue(maxVal) {}
 
 void FloatSetting::load() {
+    int32_t raw;
+    setStored(nvs_get_i32(_handle, _keyName, &raw) == ESP_OK, raw);
+}
+
+bool FloatSetting::getStored(int32_t* raw) {
     union {
         int32_t ival;
         float   fval;
     } v;
-    if (nvs_get_i32(_handle, _keyName, &v.ival)) {
-        _currentValue = _defaultValue;
-    } else {
+    v.fval = _storedValue;
+    *raw   = v.ival;
+    return !std::isnan(_storedValue);
+}
+
+void FloatSetting::setStored(bool stored, int32_t raw) {
+    union {
+        int32_t ival;
+        float   fval;
+    } v;
+    v.ival = raw;
+    if (stored) {
+        _storedValue  = v.fval;
         _currentValue = v.fval;
+    } else {
+        _storedValue  = NAN;  // Compares unequal to every value
+        _currentValue = _defaultValue;
     }
 }
 
 void FloatSetting::setDefault() {
     _currentValue = _defaultValue;
-    if (_storedValue != _currentValue) {
+    Generation++;
+    if (!std::isnan(_storedValue)) {
         nvs_erase_key(_handle, _keyName);
+        _storedValue = NAN;
+        changed();
     }
 }
 
@@ -294,9 +477,11 @@ Error FloatSetting::setStringValue(char* s) {
         return Error::NumberRange;
     }
     _currentValue = convertedValue;
+    Generation++;
     if (_storedValue != _currentValue) {
         if (_currentValue == _defaultValue) {
             nvs_erase_key(_handle, _keyName);
+            _storedValue = NAN;
         } else {
             union {
                 int32_t ival;
@@ -308,6 +493,7 @@ Error FloatSetting::setStringValue(char* s) {
             }
             _storedValue = _currentValue;
         }
+        changed();
     }
     return Error::Ok;
 }
@@ -367,8 +553,11 @@ void StringSetting::load() {
 
 void StringSetting::setDefault() {
     _currentValue = _defaultValue;
+    Generation++;
     if (_storedValue != _currentValue) {
         nvs_erase_key(_handle, _keyName);
+        _storedValue = _defaultValue;
+        changed();
     }
 }
 
@@ -381,6 +570,7 @@ Error StringSetting::setStringValue(char* s) {
         return err;
     }
     _currentValue = s;
+    Generation++;
     if (_storedValue != _currentValue) {
         if (_currentValue == _defaultValue) {
             nvs_erase_key(_handle, _keyName);
@@ -391,6 +581,7 @@ Error StringSetting::setStringValue(char* s) {
             }
             _storedValue = _currentValue;
         }
+        changed();
     }
     return Error::Ok;
 }
@@ -426,19 +617,32 @@ EnumSetting::EnumSetting(
     _defaultValue(defVal), _options(opts) {}
 
 void EnumSetting::load() {
-    esp_err_t err = nvs_get_i8(_handle, _keyName, &_storedValue);
-    if (err) {
+    int8_t raw;
+    setStored(nvs_get_i8(_handle, _keyName, &raw) == ESP_OK, raw);
+}
+
+bool EnumSetting::getStored(int32_t* raw) {
+    *raw = _storedValue;
+    return _storedValue != -1;
+}
+
+void EnumSetting::setStored(bool stored, int32_t raw) {
+    if (stored) {
+        _storedValue  = raw;
+        _currentValue = raw;
+    } else {
         _storedValue  = -1;
         _currentValue = _defaultValue;
-    } else {
-        _currentValue = _storedValue;
     }
 }
 
 void EnumSetting::setDefault() {
     _currentValue = _defaultValue;
-    if (_storedValue != _currentValue) {
+    Generation++;
+    if (_storedValue != -1) {
         nvs_erase_key(_handle, _keyName);
+        _storedValue = -1;
+        changed();
     }
 }
 
@@ -472,15 +676,18 @@ Error EnumSetting::setStringValue(char* s) {
         }
     }
     _currentValue = it->second;
+    Generation++;
     if (_storedValue != _currentValue) {
-        if (_storedValue == _defaultValue) {
+        if (_currentValue == _defaultValue) {
             nvs_erase_key(_handle, _keyName);
+            _storedValue = -1;
         } else {
             if (nvs_set_i8(_handle, _keyName, _currentValue)) {
                 return Error::NvsSetFailed;
             }
             _storedValue = _currentValue;
         }
+        changed();
     }
     return Error::Ok;
 }
@@ -520,18 +727,31 @@ FlagSetting::FlagSetting(const char*   description,
     _defaultValue(defVal) {}
 
 void FlagSetting::load() {
-    esp_err_t err = nvs_get_i8(_handle, _keyName, &_storedValue);
-    if (err) {
+    int8_t raw;
+    setStored(nvs_get_i8(_handle, _keyName, &raw) == ESP_OK, raw);
+}
+
+bool FlagSetting::getStored(int32_t* raw) {
+    *raw = _storedValue;
+    return _storedValue != -1;
+}
+
+void FlagSetting::setStored(bool stored, int32_t raw) {
+    if (stored) {
+        _storedValue  = raw;
+        _currentValue = !!_storedValue;
+    } else {
         _storedValue  = -1;  // Neither well-formed false (0) nor true (1)
         _currentValue = _defaultValue;
-    } else {
-        _currentValue = !!_storedValue;
     }
 }
 void FlagSetting::setDefault() {
     _currentValue = _defaultValue;
-    if (_storedValue != _currentValue) {
+    Generation++;
+    if (_storedValue != -1) {
         nvs_erase_key(_handle, _keyName);
+        _storedValue = -1;
+        changed();
     }
 }
 
@@ -539,17 +759,20 @@ Error FlagSetting::setStringValue(char* s) {
     s             = trim(s);
     _currentValue = (strcasecmp(s, "on") == 0) || (strcasecmp(s, "true") == 0) || (strcasecmp(s, "enabled") == 0) ||
                     (strcasecmp(s, "yes") == 0) || (strcasecmp(s, "1") == 0);
+    Generation++;
     // _storedValue is -1, 0, or 1
     // _currentValue is 0 or 1
     if (_storedValue != (int8_t)_currentValue) {
         if (_currentValue == _defaultValue) {
             nvs_erase_key(_handle, _keyName);
+            _storedValue = -1;
         } else {
             if (nvs_set_i8(_handle, _keyName, _currentValue)) {
                 return Error::NvsSetFailed;
             }
             _storedValue = _currentValue;
         }
+        changed();
     }
     return Error::Ok;
 }
@@ -591,19 +814,31 @@ IPaddrSetting::IPaddrSetting(const char*   description,
 }
 
 void IPaddrSetting::load() {
-    esp_err_t err = nvs_get_i32(_handle, _keyName, (int32_t*)&_storedValue);
-    if (err) {
+    int32_t raw;
+    setStored(nvs_get_i32(_handle, _keyName, &raw) == ESP_OK, raw);
+}
+
+bool IPaddrSetting::getStored(int32_t* raw) {
+    *raw = int32_t(_storedValue);
+    return _storedValue != 0x000000ff;
+}
+
+void IPaddrSetting::setStored(bool stored, int32_t raw) {
+    if (stored) {
+        _storedValue  = uint32_t(raw);
+        _currentValue = _storedValue;
+    } else {
         _storedValue  = 0x000000ff;  // Unreasonable value for any IP thing
         _currentValue = _defaultValue;
-    } else {
-        _currentValue = _storedValue;
     }
 }
 
 void IPaddrSetting::setDefault() {
     _currentValue = _defaultValue;
-    if (_storedValue != _currentValue) {
+    if (_storedValue != 0x000000ff) {
         nvs_erase_key(_handle, _keyName);
+        _storedValue = 0x000000ff;
+        changed();
     }
 }
 
@@ -621,12 +856,14 @@ Error IPaddrSetting::setStringValue(char* s) {
     if (_storedValue != _currentValue) {
         if (_currentValue == _defaultValue) {
             nvs_erase_key(_handle, _keyName);
+            _storedValue = 0x000000ff;
         } else {
             if (nvs_set_i32(_handle, _keyName, (int32_t)_currentValue)) {
                 return Error::NvsSetFailed;
             }
             _storedValue = _currentValue;
         }
+        changed();
     }
     return Error::Ok;
 }
@@ -656,9 +893,10 @@ Error GrblCommand::action(char* value, WebUI::AuthenticationLevel auth_level, We
 Coordinates* coords[CoordIndex::End];
 
 bool Coordinates::load() {
-    size_t len;
+    size_t len = sizeof(_currentValue);
     switch (nvs_get_blob(Setting::_handle, _name, _currentValue, &len)) {
         case ESP_OK:
+            _stored = true;
             return true;
         case ESP_ERR_NVS_INVALID_LENGTH:
             // This could happen if the stored value is longer than the buffer.
@@ -676,9 +914,61 @@ bool Coordinates::load() {
 };
 
 void Coordinates::set(float value[MAX_N_AXIS]) {
+    if (memcmp(_currentValue, value, sizeof(_currentValue)) == 0) {
+#ifdef COORDINATES_DEFERRED_WRITE
+        if (_stored || _pending) {
+            return;
+        }
+#else
+        if (_stored) {
+            return;
+        }
+#endif
+    }
     memcpy(&_currentValue, value, sizeof(_currentValue));
-#ifdef FORCE_BUFFER_SYNC_DURING_EEPROM_WRITE
+#ifdef COORDINATES_DEFERRED_WRITE
+    _stored  = false;
+    _pending = true;
+    _changed = esp_timer_get_time();
+#else
+#    ifdef FORCE_BUFFER_SYNC_DURING_EEPROM_WRITE
     protocol_buffer_synchronize();
+#    endif
+    save();
 #endif
-    nvs_set_blob(Setting::_handle, _name, _currentValue, sizeof(_currentValue));
 }
+
+void Coordinates::save() {
+    if (nvs_set_blob(Setting::_handle, _name, _currentValue, sizeof(_currentValue)) == ESP_OK) {
+        _stored = true;
+        Setting::changed();
+    }
+}
+
+#ifdef COORDINATES_DEFERRED_WRITE
+int64_t Coordinates::_changed = 0;
+
+void Coordinates::flush() {
+    if (!_changed) {
+        return;
+    }
+    _changed = 0;
+    Setting::begin();
+    for (auto idx = CoordIndex::Begin; idx < CoordIndex::End; ++idx) {
+        if (coords[idx]->_pending) {
+            coords[idx]->_pending = false;
+            coords[idx]->save();
+        }
+    }
+    Setting::commit();
+}
+
+void Coordinates::poll() {
+    if (!_changed || (sys.state != State::Idle && sys.state != State::Alarm)) {
+        return;
+    }
+    if (esp_timer_get_time() - _changed >= COORDINATES_WRITE_DELAY_MS * 1000LL) {
+        flush();
+    }
+}
+#endif
@@ -61,6 +61,7 @@ protected:
     Command* link;  // linked list of setting objects
 public:
     static Command* List;
+    static uint16_t Count;  // Number of commands in List
     Command*        next() { return link; }
 
     ~Command() {}
@@ -75,6 +76,13 @@ public:
 
 class Setting : public Word {
 private:
+    static uint8_t _transactionDepth;
+    static bool    _dirty;
+
+#ifdef SETTINGS_NVS_BLOB
+    static uint16_t blobLayout(uint32_t* layout);
+#endif
+
 protected:
     // group_t _group;
     axis_t   _axis = NO_AXIS;
@@ -87,8 +95,27 @@ public:
     static nvs_handle _handle;
     static void     init();
     static Setting* List;
+    static uint16_t Count;       // Number of settings in List
+    static uint32_t Generation;  // Bumped whenever a numeric or string setting's live value is set
     Setting*        next() { return link; }
 
+    // NVS changes made between begin() and commit() are committed together with a single
+    // nvs_commit() when the outermost commit() runs. Outside a transaction every change is
+    // committed as it is made. Transactions may nest.
+    static void  begin();
+    static Error commit();
+
+    // Records that a value was written to or erased from NVS.
+    static void changed();
+
+#ifdef SETTINGS_NVS_BLOB
+    // The stored values of all numeric settings are also kept in one NVS blob, rewritten by every
+    // commit(). loadBlob() loads all settings with it and returns false when it is missing or was
+    // written for other settings; saveBlob() writes it without committing.
+    static bool loadBlob();
+    static void saveBlob();
+#endif
+
     Error check(char* s);
 
     static Error report_nvs_stats(const char* value, WebUI::AuthenticationLevel auth_level, WebUI::ESPResponseStream* out) {
@@ -126,6 +153,12 @@ public:
     virtual void load() {};
     virtual void setDefault() {};
 
+    // Numeric settings store one int32_t. getStored() reads it and returns false when the setting
+    // has none; setStored() does what load() does with it.
+    virtual bool isNumeric() { return false; }
+    virtual bool getStored(int32_t* raw) { return false; }
+    virtual void setStored(bool stored, int32_t raw) {}
+
     // The default implementation of addWebui() does nothing.
     // Derived classes may override it to do something.
     virtual void addWebui(WebUI::JSONencoder*) {};
@@ -169,6 +202,9 @@ public:
         IntSetting(NULL, type, permissions, grblName, name, defVal, minVal, maxVal, checker, currentIsNvm) {}
 
     void        load();
+    bool        isNumeric() { return true; }
+    bool        getStored(int32_t* raw);
+    void        setStored(bool stored, int32_t raw);
     void        setDefault();
     void        addWebui(WebUI::JSONencoder*);
     Error       setStringValue(char* value);
@@ -197,6 +233,9 @@ public:
         AxisMaskSetting(NULL, type, permissions, grblName, name, defVal, checker) {}
 
     void        load();
+    bool        isNumeric() { return true; }
+    bool        getStored(int32_t* raw);
+    void        setStored(bool stored, int32_t raw);
     void        setDefault();
     void        addWebui(WebUI::JSONencoder*);
     Error       setStringValue(char* value);
@@ -206,10 +245,23 @@ public:
     int32_t get() { return _currentValue; }
 };
 
+#ifdef COORDINATES_DEFERRED_WRITE
+#    ifndef COORDINATES_WRITE_DELAY_MS
+#        define COORDINATES_WRITE_DELAY_MS 2000
+#    endif
+#endif
+
 class Coordinates {
 private:
     float _currentValue[MAX_N_AXIS];
     const char* _name;
+    bool        _stored = false;  // _currentValue matches NVS, so an unchanged set() is skipped
+#ifdef COORDINATES_DEFERRED_WRITE
+    bool           _pending = false;  // _currentValue is still to be written to NVS
+    static int64_t _changed;          // esp_timer time of the last set() that left a write pending
+#endif
+    void save();
+
 public:
     Coordinates(const char* name) : _name(name) {}
 
@@ -224,6 +276,13 @@ public:
     // Return a pointer to the array
     const float* get() { return _currentValue; }
     void set(float *value);
+
+#ifdef COORDINATES_DEFERRED_WRITE
+    // Writes every pending coordinate set to NVS with one commit.
+    static void flush();
+    // Calls flush() once Grbl is idle and the coordinates have settled. Called from the main loop.
+    static void poll();
+#endif
 };
 
 extern Coordinates* coords[CoordIndex::End];
@@ -258,6 +317,9 @@ public:
         FloatSetting(NULL, type, permissions, grblName, name, defVal, minVal, maxVal, checker) {}
 
     void load();
+    bool isNumeric() { return true; }
+    bool getStored(int32_t* raw);
+    void setStored(bool stored, int32_t raw);
     void setDefault();
     // There are no Float settings in WebUI
     void        addWebui(WebUI::JSONencoder*) {}
@@ -324,6 +386,9 @@ public:
         EnumSetting(NULL, type, permissions, grblName, name, defVal, opts) {}
 
     void        load();
+    bool        isNumeric() { return true; }
+    bool        getStored(int32_t* raw);
+    void        setStored(bool stored, int32_t raw);
     void        setDefault();
     void        addWebui(WebUI::JSONencoder*);
     Error       setStringValue(char* value);
@@ -350,6 +415,9 @@ public:
         FlagSetting(NULL, type, permissions, grblName, name, defVal, checker) {}
 
     void load();
+    bool isNumeric() { return true; }
+    bool getStored(int32_t* raw);
+    void setStored(bool stored, int32_t raw);
     void setDefault();
     // There are no Flag settings in WebUI
     // The booleans are expressed as Enums
@@ -384,6 +452,9 @@ public:
                   bool (*checker)(char*));
 
     void        load();
+    bool        isNumeric() { return true; }
+    bool        getStored(int32_t* raw);
+    void        setStored(bool stored, int32_t raw);
     void        setDefault();
     void        addWebui(WebUI::JSONencoder*);
     Error       setStringValue(char* value);
@@ -398,10 +469,24 @@ public:
     FloatSetting* steps_per_mm;
     FloatSetting* max_rate;
     FloatSetting* acceleration;
+#ifdef JERK_LIMITED_PROFILE
+    FloatSetting* jerk;
+#endif
+#ifdef INPUT_SHAPING
+    FloatSetting* shaper_frequency;
+    FloatSetting* shaper_damping;
+#endif
+#ifdef BACKLASH_COMPENSATION
+    FloatSetting* backlash;
+#endif
     FloatSetting* max_travel;
     FloatSetting* run_current;
     FloatSetting* hold_current;
     FloatSetting* home_mpos;
+#ifdef HOMING_PER_AXIS_RATES
+    FloatSetting* homing_seek_rate;
+    FloatSetting* homing_feed_rate;
+#endif
     IntSetting*   microsteps;
     IntSetting*   stallguard;
 
@@ -1,4 +1,5 @@
 #include "Grbl.h"
+#include "Spindles/PWMSpindle.h"
 
 bool motorSettingChanged = false;
 
@@ -9,6 +10,7 @@ StringSetting* startup_line_1;
 StringSetting* build_info;
 
 IntSetting* pulse_microseconds;
+IntSetting* dir_delay_microseconds;
 IntSetting* stepper_idle_lock_time;
 
 AxisMaskSetting* step_invert_mask;
@@ -34,6 +36,33 @@ FlagSetting* laser_mode;
 IntSetting*   status_mask;
 FloatSetting* junction_deviation;
 FloatSetting* arc_tolerance;
+#ifdef PROBE_TWO_STAGE
+FloatSetting* probe_slow_feed;
+FloatSetting* probe_retract;
+#endif
+#ifdef USE_KINEMATICS
+FloatSetting* kinematics_tolerance;
+#else
+EnumSetting* kinematics_type;
+
+enum_opt_t kinematicsTypes = {
+    // clang-format off
+    { "CARTESIAN", int8_t(KinematicsType::Cartesian) },
+    { "COREXY", int8_t(KinematicsType::CoreXY) },
+    { "HBOT", int8_t(KinematicsType::HBot) },
+    // clang-format on
+};
+#endif
+#ifdef INPUT_SHAPING
+EnumSetting* shaper_type;
+
+enum_opt_t shaperTypes = {
+    // clang-format off
+    { "ZV", int8_t(ShaperType::ZV) },
+    { "ZVD", int8_t(ShaperType::ZVD) },
+    // clang-format on
+};
+#endif
 
 FloatSetting* homing_feed_rate;
 FloatSetting* homing_seek_rate;
@@ -45,6 +74,7 @@ FloatSetting* rpm_max;
 FloatSetting* rpm_min;
 FloatSetting* spindle_delay_spinup;
 FloatSetting* spindle_delay_spindown;
+FloatSetting* spindle_at_speed_tolerance;
 FlagSetting*  spindle_enbl_off_with_zero_speed;
 FlagSetting*  spindle_enable_invert;
 FlagSetting*  spindle_output_invert;
@@ -54,6 +84,12 @@ FloatSetting* spindle_pwm_min_value;
 FloatSetting* spindle_pwm_max_value;
 IntSetting*   spindle_pwm_bit_precision;
 
+StringSetting* spindle_pwm_curve;
+
+#ifdef ENABLE_MACROS
+StringSetting* macro_settings[N_MACROS];
+#endif
+
 EnumSetting* spindle_type;
 
 enum_opt_t spindleTypes = {
@@ -84,8 +120,14 @@ typedef struct {
     float       steps_per_mm;
     float       max_rate;
     float       acceleration;
+    float       jerk;
+    float       shaper_frequency;
+    float       shaper_damping;
+    float       backlash;
     float       max_travel;
     float       home_mpos;
+    float       homing_seek_rate;
+    float       homing_feed_rate;
     float       run_current;
     float       hold_current;
     uint16_t    microsteps;
@@ -95,8 +137,14 @@ axis_defaults_t axis_defaults[] = { { "X",
                                       DEFAULT_X_STEPS_PER_MM,
                                       DEFAULT_X_MAX_RATE,
                                       DEFAULT_X_ACCELERATION,
+                                      DEFAULT_X_JERK,
+                                      DEFAULT_X_SHAPER_FREQUENCY,
+                                      DEFAULT_X_SHAPER_DAMPING,
+                                      DEFAULT_X_BACKLASH,
                                       DEFAULT_X_MAX_TRAVEL,
                                       DEFAULT_X_HOMING_MPOS,
+                                      DEFAULT_X_HOMING_SEEK_RATE,
+                                      DEFAULT_X_HOMING_FEED_RATE,
                                       DEFAULT_X_CURRENT,
                                       DEFAULT_X_HOLD_CURRENT,
                                       DEFAULT_X_MICROSTEPS,
@@ -105,8 +153,14 @@ axis_defaults_t axis_defaults[] = { { "X",
                                       DEFAULT_Y_STEPS_PER_MM,
                                       DEFAULT_Y_MAX_RATE,
                                       DEFAULT_Y_ACCELERATION,
+                                      DEFAULT_Y_JERK,
+                                      DEFAULT_Y_SHAPER_FREQUENCY,
+                                      DEFAULT_Y_SHAPER_DAMPING,
+                                      DEFAULT_Y_BACKLASH,
                                       DEFAULT_Y_MAX_TRAVEL,
                                       DEFAULT_Y_HOMING_MPOS,
+                                      DEFAULT_Y_HOMING_SEEK_RATE,
+                                      DEFAULT_Y_HOMING_FEED_RATE,
                                       DEFAULT_Y_CURRENT,
                                       DEFAULT_Y_HOLD_CURRENT,
                                       DEFAULT_Y_MICROSTEPS,
@@ -115,8 +169,14 @@ axis_defaults_t axis_defaults[] = { { "X",
                                       DEFAULT_Z_STEPS_PER_MM,
                                       DEFAULT_Z_MAX_RATE,
                                       DEFAULT_Z_ACCELERATION,
+                                      DEFAULT_Z_JERK,
+                                      DEFAULT_Z_SHAPER_FREQUENCY,
+                                      DEFAULT_Z_SHAPER_DAMPING,
+                                      DEFAULT_Z_BACKLASH,
                                       DEFAULT_Z_MAX_TRAVEL,
                                       DEFAULT_Z_HOMING_MPOS,
+                                      DEFAULT_Z_HOMING_SEEK_RATE,
+                                      DEFAULT_Z_HOMING_FEED_RATE,
                                       DEFAULT_Z_CURRENT,
                                       DEFAULT_Z_HOLD_CURRENT,
                                       DEFAULT_Z_MICROSTEPS,
@@ -125,8 +185,14 @@ axis_defaults_t axis_defaults[] = { { "X",
                                       DEFAULT_A_STEPS_PER_MM,
                                       DEFAULT_A_MAX_RATE,
                                       DEFAULT_A_ACCELERATION,
+                                      DEFAULT_A_JERK,
+                                      DEFAULT_A_SHAPER_FREQUENCY,
+                                      DEFAULT_A_SHAPER_DAMPING,
+                                      DEFAULT_A_BACKLASH,
                                       DEFAULT_A_MAX_TRAVEL,
                                       DEFAULT_A_HOMING_MPOS,
+                                      DEFAULT_A_HOMING_SEEK_RATE,
+                                      DEFAULT_A_HOMING_FEED_RATE,
                                       DEFAULT_A_CURRENT,
                                       DEFAULT_A_HOLD_CURRENT,
                                       DEFAULT_A_MICROSTEPS,
@@ -135,8 +201,14 @@ axis_defaults_t axis_defaults[] = { { "X",
                                       DEFAULT_B_STEPS_PER_MM,
                                       DEFAULT_B_MAX_RATE,
                                       DEFAULT_B_ACCELERATION,
+                                      DEFAULT_B_JERK,
+                                      DEFAULT_B_SHAPER_FREQUENCY,
+                                      DEFAULT_B_SHAPER_DAMPING,
+                                      DEFAULT_B_BACKLASH,
                                       DEFAULT_B_MAX_TRAVEL,
                                       DEFAULT_B_HOMING_MPOS,
+                                      DEFAULT_B_HOMING_SEEK_RATE,
+                                      DEFAULT_B_HOMING_FEED_RATE,
                                       DEFAULT_B_CURRENT,
                                       DEFAULT_B_HOLD_CURRENT,
                                       DEFAULT_B_MICROSTEPS,
@@ -145,8 +217,14 @@ axis_defaults_t axis_defaults[] = { { "X",
                                       DEFAULT_C_STEPS_PER_MM,
                                       DEFAULT_C_MAX_RATE,
                                       DEFAULT_C_ACCELERATION,
+                                      DEFAULT_C_JERK,
+                                      DEFAULT_C_SHAPER_FREQUENCY,
+                                      DEFAULT_C_SHAPER_DAMPING,
+                                      DEFAULT_C_BACKLASH,
                                       DEFAULT_C_MAX_TRAVEL,
                                       DEFAULT_C_HOMING_MPOS,
+                                      DEFAULT_C_HOMING_SEEK_RATE,
+                                      DEFAULT_C_HOMING_FEED_RATE,
                                       DEFAULT_C_CURRENT,
                                       DEFAULT_C_HOLD_CURRENT,
                                       DEFAULT_C_MICROSTEPS,
@@ -195,6 +273,21 @@ static bool checkStallguardDebugMask(char* val) {
     return true;
 }
 
+static bool checkSpindleCurve(char* value) {
+    return Spindles::PWM::parse_curve(value, NULL, NULL) >= 0;
+}
+
+#ifdef ENABLE_MACROS
+// The lines are split into words once the setting is stored, see macros_refresh().
+static bool checkMacro(char* value) {
+    int lines = 1;
+    for (const char* s = value; *s; s++) {
+        lines += *s == '&';
+    }
+    return strlen(value) <= MACRO_MAX_LENGTH && lines <= MACRO_MAX_LINES;
+}
+#endif
+
 // Generates a string like "122" from axisNum 2 and base 120
 static const char* makeGrblName(int axisNum, int base) {
     // To omit A,B,C axes:
@@ -295,6 +388,20 @@ void make_settings() {
         setting->setAxis(axis);
         axis_settings[axis]->home_mpos = setting;
     }
+#ifdef HOMING_PER_AXIS_RATES
+    for (axis = MAX_N_AXIS - 1; axis >= 0; axis--) {
+        def          = &axis_defaults[axis];
+        auto setting = new FloatSetting(EXTENDED, WG, NULL, makename(def->name, "Home/Seek"), def->homing_seek_rate, 0.0, 10000.0);
+        setting->setAxis(axis);
+        axis_settings[axis]->homing_seek_rate = setting;
+    }
+    for (axis = MAX_N_AXIS - 1; axis >= 0; axis--) {
+        def          = &axis_defaults[axis];
+        auto setting = new FloatSetting(EXTENDED, WG, NULL, makename(def->name, "Home/Feed"), def->homing_feed_rate, 0.0, 10000.0);
+        setting->setAxis(axis);
+        axis_settings[axis]->homing_feed_rate = setting;
+    }
+#endif
 
     for (axis = MAX_N_AXIS - 1; axis >= 0; axis--) {
         def = &axis_defaults[axis];
@@ -303,6 +410,37 @@ void make_settings() {
         setting->setAxis(axis);
         axis_settings[axis]->acceleration = setting;
     }
+#ifdef JERK_LIMITED_PROFILE
+    for (axis = MAX_N_AXIS - 1; axis >= 0; axis--) {
+        def          = &axis_defaults[axis];
+        auto setting = new FloatSetting(EXTENDED, WG, NULL, makename(def->name, "Jerk"), def->jerk, 0.0, 1000000.0);  // mm/sec^3
+        setting->setAxis(axis);
+        axis_settings[axis]->jerk = setting;
+    }
+#endif
+#ifdef INPUT_SHAPING
+    for (axis = MAX_N_AXIS - 1; axis >= 0; axis--) {
+        def = &axis_defaults[axis];
+        auto setting =
+            new FloatSetting(EXTENDED, WG, NULL, makename(def->name, "Shaper/Frequency"), def->shaper_frequency, 0.0, 500.0);  // Hz
+        setting->setAxis(axis);
+        axis_settings[axis]->shaper_frequency = setting;
+    }
+    for (axis = MAX_N_AXIS - 1; axis >= 0; axis--) {
+        def          = &axis_defaults[axis];
+        auto setting = new FloatSetting(EXTENDED, WG, NULL, makename(def->name, "Shaper/Damping"), def->shaper_damping, 0.0, 0.9);
+        setting->setAxis(axis);
+        axis_settings[axis]->shaper_damping = setting;
+    }
+#endif
+#ifdef BACKLASH_COMPENSATION
+    for (axis = MAX_N_AXIS - 1; axis >= 0; axis--) {
+        def          = &axis_defaults[axis];
+        auto setting = new FloatSetting(EXTENDED, WG, NULL, makename(def->name, "Backlash"), def->backlash, 0.0, 10.0);  // mm
+        setting->setAxis(axis);
+        axis_settings[axis]->backlash = setting;
+    }
+#endif
     for (axis = MAX_N_AXIS - 1; axis >= 0; axis--) {
         def          = &axis_defaults[axis];
         auto setting = new FloatSetting(GRBL, WG, makeGrblName(axis, 110), makename(def->name, "MaxRate"), def->max_rate, 1.0, 100000.0);
@@ -325,9 +463,12 @@ void make_settings() {
     // IntSetting spindle_pwm_bit_precision(EXTENDED, WG, "Spindle/PWM/Precision", DEFAULT_SPINDLE_BIT_PRECISION, 1, 16);
     spindle_pwm_freq      = new FloatSetting(EXTENDED, WG, "33", "Spindle/PWM/Frequency", DEFAULT_SPINDLE_FREQ, 0, 100000);
     spindle_output_invert = new FlagSetting(GRBL, WG, NULL, "Spindle/PWM/Invert", DEFAULT_INVERT_SPINDLE_OUTPUT_PIN);
+    spindle_pwm_curve     = new StringSetting(EXTENDED, WG, NULL, "Spindle/PWM/Curve", DEFAULT_SPINDLE_PWM_CURVE, checkSpindleCurve);
 
     spindle_delay_spinup   = new FloatSetting(EXTENDED, WG, NULL, "Spindle/Delay/SpinUp", DEFAULT_SPINDLE_DELAY_SPINUP, 0, 30);
-    spindle_delay_spindown = new FloatSetting(EXTENDED, WG, NULL, "Spindle/Delay/SpinDown", DEFAULT_SPINDLE_DELAY_SPINUP, 0, 30);
+    spindle_delay_spindown = new FloatSetting(EXTENDED, WG, NULL, "Spindle/Delay/SpinDown", DEFAULT_SPINDLE_DELAY_SPINDOWN, 0, 30);
+    spindle_at_speed_tolerance =
+        new FloatSetting(EXTENDED, WG, NULL, "Spindle/AtSpeed/Tolerance", DEFAULT_SPINDLE_AT_SPEED_TOLERANCE, 0.0, 100.0);
 
     spindle_enbl_off_with_zero_speed =
         new FlagSetting(GRBL, WG, NULL, "Spindle/Enable/OffWithSpeed", DEFAULT_SPINDLE_ENABLE_OFF_WITH_ZERO_SPEED);
@@ -337,6 +478,13 @@ void make_settings() {
     // GRBL Non-numbered settings
     startup_line_0 = new StringSetting(GRBL, WG, "N0", "GCode/Line0", "", checkStartupLine);
     startup_line_1 = new StringSetting(GRBL, WG, "N1", "GCode/Line1", "", checkStartupLine);
+#ifdef ENABLE_MACROS
+    for (int index = 0; index < N_MACROS; index++) {
+        char name[20];
+        snprintf(name, sizeof(name), "Macros/Macro%d", index);
+        macro_settings[index] = new StringSetting(EXTENDED, WG, NULL, strdup(name), "", checkMacro);
+    }
+#endif
 
     // GRBL Numbered Settings
     laser_mode = new FlagSetting(GRBL, WG, "32", "GCode/LaserMode", DEFAULT_LASER_MODE);
@@ -362,16 +510,29 @@ void make_settings() {
     report_inches = new FlagSetting(GRBL, WG, "13", "Report/Inches", DEFAULT_REPORT_INCHES);
     // TODO Settings - also need to clear, but not set, soft_limits
     arc_tolerance      = new FloatSetting(GRBL, WG, "12", "GCode/ArcTolerance", DEFAULT_ARC_TOLERANCE, 0, 1);
+#ifdef USE_KINEMATICS
+    kinematics_tolerance = new FloatSetting(EXTENDED, WG, NULL, "Kinematics/Tolerance", DEFAULT_KINEMATICS_TOLERANCE, 0, 1);
+#else
+    kinematics_type = new EnumSetting(NULL, EXTENDED, WG, NULL, "Kinematics/Type", int8_t(DEFAULT_KINEMATICS_TYPE), &kinematicsTypes);
+#endif
+#ifdef INPUT_SHAPING
+    shaper_type = new EnumSetting(NULL, EXTENDED, WG, NULL, "Shaper/Type", int8_t(DEFAULT_SHAPER_TYPE), &shaperTypes);
+#endif
     junction_deviation = new FloatSetting(GRBL, WG, "11", "GCode/JunctionDeviation", DEFAULT_JUNCTION_DEVIATION, 0, 10);
     status_mask        = new IntSetting(GRBL, WG, "10", "Report/Status", DEFAULT_STATUS_REPORT_MASK, 0, 3);
 
     probe_invert           = new FlagSetting(GRBL, WG, "6", "Probe/Invert", DEFAULT_INVERT_PROBE_PIN);
+#ifdef PROBE_TWO_STAGE
+    probe_slow_feed = new FloatSetting(EXTENDED, WG, NULL, "Probe/SlowFeed", DEFAULT_PROBE_SLOW_FEED, 0, 10000);
+    probe_retract   = new FloatSetting(EXTENDED, WG, NULL, "Probe/Retract", DEFAULT_PROBE_RETRACT, 0, 100);
+#endif
     limit_invert           = new FlagSetting(GRBL, WG, "5", "Limits/Invert", DEFAULT_INVERT_LIMIT_PINS);
     step_enable_invert     = new FlagSetting(GRBL, WG, "4", "Stepper/EnableInvert", DEFAULT_INVERT_ST_ENABLE);
     dir_invert_mask        = new AxisMaskSetting(GRBL, WG, "3", "Stepper/DirInvert", DEFAULT_DIRECTION_INVERT_MASK);
     step_invert_mask       = new AxisMaskSetting(GRBL, WG, "2", "Stepper/StepInvert", DEFAULT_STEPPING_INVERT_MASK);
     stepper_idle_lock_time = new IntSetting(GRBL, WG, "1", "Stepper/IdleTime", DEFAULT_STEPPER_IDLE_LOCK_TIME, 0, 255);
     pulse_microseconds     = new IntSetting(GRBL, WG, "0", "Stepper/Pulse", DEFAULT_STEP_PULSE_MICROSECONDS, 3, 1000);
+    dir_delay_microseconds = new IntSetting(EXTENDED, WG, NULL, "Stepper/DirDelay", DEFAULT_DIRECTION_DELAY_MICROSECONDS, 0, 100);
     spindle_type           = new EnumSetting(NULL, EXTENDED, WG, NULL, "Spindle/Type", static_cast<int8_t>(SPINDLE_TYPE), &spindleTypes);
     stallguard_debug_mask  = new AxisMaskSetting(EXTENDED, WG, NULL, "Report/StallGuard", 0, checkStallguardDebugMask);
 
@@ -17,6 +17,7 @@ extern StringSetting* startup_line_1;
 extern StringSetting* build_info;
 
 extern IntSetting* pulse_microseconds;
+extern IntSetting* dir_delay_microseconds;
 extern IntSetting* stepper_idle_lock_time;
 
 extern AxisMaskSetting* step_invert_mask;
@@ -37,6 +38,18 @@ extern FlagSetting* laser_mode;
 extern IntSetting*   status_mask;
 extern FloatSetting* junction_deviation;
 extern FloatSetting* arc_tolerance;
+#ifdef PROBE_TWO_STAGE
+extern FloatSetting* probe_slow_feed;
+extern FloatSetting* probe_retract;
+#endif
+#ifdef USE_KINEMATICS
+extern FloatSetting* kinematics_tolerance;
+#else
+extern EnumSetting* kinematics_type;
+#endif
+#ifdef INPUT_SHAPING
+extern EnumSetting* shaper_type;
+#endif
 
 extern FloatSetting* homing_feed_rate;
 extern FloatSetting* homing_seek_rate;
@@ -47,6 +60,7 @@ extern FloatSetting* rpm_max;
 extern FloatSetting* rpm_min;
 extern FloatSetting* spindle_delay_spinup;
 extern FloatSetting* spindle_delay_spindown;
+extern FloatSetting* spindle_at_speed_tolerance;
 extern FlagSetting*  spindle_enbl_off_with_zero_speed;
 extern FlagSetting*  spindle_enable_invert;
 extern FlagSetting*  spindle_output_invert;
@@ -56,6 +70,12 @@ extern FloatSetting* spindle_pwm_min_value;
 extern FloatSetting* spindle_pwm_max_value;
 extern IntSetting*   spindle_pwm_bit_precision;
 
+extern StringSetting* spindle_pwm_curve;
+
+#ifdef ENABLE_MACROS
+extern StringSetting* macro_settings[N_MACROS];
+#endif
+
 extern EnumSetting* spindle_type;
 
 extern AxisMaskSetting* stallguard_debug_mask;
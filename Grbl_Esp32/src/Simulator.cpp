@@ -0,0 +1,289 @@
+/*
+  Simulator.cpp - runs a file through the parser, planner and segment prep without motion
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#include <xtensa/hal.h>
+#include <rom/crc.h>
+
+#if defined(ENABLE_SIMULATOR) && defined(ENABLE_SD_CARD)
+
+static char             sim_path[128];
+static uint8_t          sim_client;
+static volatile bool    sim_pending  = false;
+static bool             sim_running  = false;
+static bool             sim_draining = false;  // In sim_drain(true), where the blocks really stop
+static sim_result_t     sim_result;
+static uint32_t         sim_expected_digest;
+static SimTrace         sim_trace;
+static char             sim_golden_path[128];
+static File             sim_golden;
+static uint32_t         sim_golden_index;  // Segments recorded or compared so far
+
+// A segment as the golden file holds it
+typedef struct {
+    uint32_t n_step;
+    uint32_t cycles_per_tick;
+    uint8_t  direction_bits;
+    uint8_t  amass_level;
+    uint16_t reserved;
+} sim_golden_t;
+
+Error sim_request(const char* path, uint8_t client, uint32_t expected_digest, SimTrace trace, const char* golden) {
+    if (sim_pending || sys.state != State::Idle) {
+        return Error::IdleError;
+    }
+    if (get_sd_state(true) != SDCARD_IDLE) {
+        return Error::SdFailedBusy;
+    }
+    if (strlen(path) >= sizeof(sim_path)) {
+        return Error::InvalidValue;
+    }
+    if (trace != SimTrace::None && (golden == NULL || strlen(golden) >= sizeof(sim_golden_path))) {
+        return Error::InvalidValue;
+    }
+    strcpy(sim_path, path);
+    strcpy(sim_golden_path, trace != SimTrace::None ? golden : "");
+    sim_trace           = trace;
+    sim_client          = client;
+    sim_expected_digest = expected_digest;
+    sim_pending         = true;
+    return Error::Ok;
+}
+
+bool sim_active() {
+    return sim_running;
+}
+
+static bool sim_within(uint32_t value, uint32_t golden, uint32_t tolerance) {
+    return (value > golden ? value - golden : golden - value) <= tolerance;
+}
+
+static void sim_trace_segment(const st_segment_trace_t* segment) {
+    sim_golden_t record = {};
+    if (sim_trace == SimTrace::Record) {
+        record.n_step          = segment->n_step;
+        record.cycles_per_tick = segment->cycles_per_tick;
+        record.direction_bits  = segment->direction_bits;
+        record.amass_level     = segment->amass_level;
+        sim_golden.write((const uint8_t*)&record, sizeof(record));
+    } else if (sim_golden.read((uint8_t*)&record, sizeof(record)) != sizeof(record)) {
+        // Past the end of the golden file, which the report counts
+    } else if (!sim_within(segment->n_step, record.n_step, SIM_TRACE_STEP_TOLERANCE) ||
+               !sim_within(segment->cycles_per_tick, record.cycles_per_tick, record.cycles_per_tick / 1000 * SIM_TRACE_PERIOD_TOLERANCE) ||
+               segment->direction_bits != record.direction_bits || segment->amass_level != record.amass_level) {
+        if (sim_result.mismatches++ == 0) {
+            sim_result.first_mismatch = sim_golden_index;
+        }
+    }
+    sim_golden_index++;
+}
+
+void sim_drain(bool all) {
+    uint32_t start = xthal_get_ccount();
+    plan_flush_batch();
+    sim_draining = all;
+    do {
+        st_prep_buffer();
+        sim_result.ticks += st_discard_segments(&sim_result.segments, sim_golden ? sim_trace_segment : NULL);
+    } while (all ? plan_get_current_block() != NULL : plan_check_full_buffer());
+    sim_draining = false;
+    sim_result.prep_cycles += xthal_get_ccount() - start;
+}
+
+void sim_dwell(float seconds) {
+    sim_result.dwell_seconds += seconds;
+}
+
+void sim_segment(float mm, float minutes, float nominal_speed, bool depth_limited) {
+    sim_result.distance += mm;
+    if (mm < 0.99f * nominal_speed * minutes) {
+        sim_result.below_seconds += minutes * 60.0f;
+    }
+    if (depth_limited && !sim_draining) {
+        sim_result.depth_seconds += minutes * 60.0f;
+    }
+}
+
+const sim_result_t* sim_get_result() {
+    return &sim_result;
+}
+
+static void sim_report(uint8_t client) {
+    const sim_result_t* r       = &sim_result;
+    float               motion  = float(r->ticks) / F_STEPPER_TIMER;
+    float               planned = motion + r->dwell_seconds;
+    float               wall    = r->wall_us / 1000000.0f;
+    uint64_t            parse   = r->parse_cycles > r->prep_cycles ? r->parse_cycles - r->prep_cycles : 0;
+    grbl_sendf(client,
+               "[MSG: Simulated %u lines in %.2f s, %.0f lines/s, %.0fx real time]\r\n",
+               r->lines,
+               wall,
+               wall > 0 ? r->lines / wall : 0.0f,
+               wall > 0 ? planned / wall : 0.0f);
+    grbl_sendf(client,
+               "[MSG: Planned time %.2f s, dwell %.2f s, blocks %u, segments %u]\r\n",
+               planned,
+               r->dwell_seconds,
+               r->blocks,
+               r->segments);
+    grbl_sendf(client,
+               "[MSG: Average feed %.0f mm/min over %.1f mm, below nominal feed %.2f s, of that depth limited %.2f s]\r\n",
+               motion > 0 ? r->distance / motion * 60.0f : 0.0f,
+               r->distance,
+               r->below_seconds,
+               r->depth_seconds);
+    grbl_sendf(client,
+               "[MSG: Cycles parse+plan %llu per line, prep %llu per segment]\r\n",
+               r->lines ? parse / r->lines : 0,
+               r->segments ? r->prep_cycles / r->segments : 0);
+    if (r->errors) {
+        grbl_sendf(client, "[MSG: Errors %u, first on line %u]\r\n", r->errors, r->first_error);
+    }
+    grbl_sendf(client, "[MSG: Heap peak %u bytes, kept %d bytes]\r\n", r->heap_peak, r->heap_kept);
+    if (!sim_expected_digest) {
+        grbl_sendf(client, "[MSG: Digest %08x]\r\n", r->digest);
+    } else if (r->digest == sim_expected_digest) {
+        grbl_sendf(client, "[MSG: Digest %08x matches]\r\n", r->digest);
+    } else {
+        grbl_sendf(client, "[MSG: Digest %08x differs from %08x]\r\n", r->digest, sim_expected_digest);
+    }
+    if (sim_trace == SimTrace::Record) {
+        grbl_sendf(client, "[MSG: Recorded %u segments to %s]\r\n", sim_golden_index, sim_golden_path);
+    } else if (sim_trace == SimTrace::Compare) {
+        uint32_t golden = sim_golden.size() / sizeof(sim_golden_t);
+        if (r->mismatches) {
+            grbl_sendf(client, "[MSG: Segments differ from %s: %u, first at %u]\r\n", sim_golden_path, r->mismatches, r->first_mismatch);
+        }
+        if (golden != sim_golden_index) {
+            grbl_sendf(client, "[MSG: Segments %u, golden %u]\r\n", sim_golden_index, golden);
+        } else if (!r->mismatches) {
+            grbl_sendf(client, "[MSG: Segments match %s]\r\n", sim_golden_path);
+        }
+    }
+}
+
+// Adds the result of a line and the parser state after it to the digest. The position is taken to
+// 0.1 um, so a difference in the last bit of a float does not count.
+static void sim_digest_line(Error err) {
+    uint8_t status = static_cast<uint8_t>(err);
+    int32_t position[MAX_N_AXIS];
+    for (int axis = 0; axis < MAX_N_AXIS; axis++) {
+        position[axis] = lroundf(gc_state.position[axis] * 10000.0f);
+    }
+    uint32_t crc      = crc32_le(sim_result.digest, &status, sizeof(status));
+    crc               = crc32_le(crc, (const uint8_t*)&gc_state.modal, sizeof(gc_state.modal));
+    sim_result.digest = crc32_le(crc, (const uint8_t*)position, sizeof(position));
+}
+
+void sim_execute() {
+    if (!sim_pending) {
+        return;
+    }
+    sim_pending    = false;
+    uint8_t client = sim_client;
+    if (sys.state != State::Idle) {
+        report_status_message(Error::IdleError, client);
+        return;
+    }
+    if (!openFile(SD, sim_path)) {
+        report_status_message(Error::SdFailedRead, client);
+        return;
+    }
+    if (sim_trace != SimTrace::None) {
+        sim_golden = SD.open(sim_golden_path, sim_trace == SimTrace::Record ? FILE_WRITE : FILE_READ);
+        if (!sim_golden) {
+            closeFile();
+            report_status_message(sim_trace == SimTrace::Record ? Error::SdFailedOpenFile : Error::SdFailedRead, client);
+            return;
+        }
+    }
+    sim_golden_index = 0;
+    set_sd_state(SDCARD_BUSY_PARSING);  // Not a job, so status messages are still sent
+
+    // The file changes the parser state, so it is put back afterwards.
+    parser_state_t saved_state = gc_state;
+    uint32_t       appends     = plan_get_stats()->appends;
+    memset(&sim_result, 0, sizeof(sim_result));
+    sys.state   = State::CheckMode;
+    sim_running = true;
+
+    char     line[255];
+    uint32_t heap_start = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    int64_t  start      = esp_timer_get_time();
+    int64_t  last_yield = start;
+    while (readFileLine(line, sizeof(line))) {
+        sim_result.lines++;
+        uint32_t cycles = xthal_get_ccount();
+        Error    err    = sd_execute_line(line, client);
+        sim_result.parse_cycles += xthal_get_ccount() - cycles;
+        if (err != Error::Ok && sim_result.errors++ == 0) {
+            sim_result.first_error = sd_get_current_line_number();
+        }
+        sim_digest_line(err);
+        uint32_t heap_free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+        if (heap_free < heap_start && heap_start - heap_free > sim_result.heap_peak) {
+            sim_result.heap_peak = heap_start - heap_free;
+        }
+        protocol_execute_realtime();
+        if (sys.abort) {
+            break;  // The reset puts the planner and the parser back
+        }
+        int64_t now = esp_timer_get_time();
+        if (now - last_yield > SIM_YIELD_MS * 1000) {
+            vTaskDelay(1);
+            last_yield = esp_timer_get_time();
+        }
+    }
+    if (!sys.abort) {
+        uint32_t cycles = xthal_get_ccount();
+        sim_drain(true);
+        sim_result.parse_cycles += xthal_get_ccount() - cycles;
+    }
+    sim_result.wall_us   = esp_timer_get_time() - start;
+    sim_result.blocks    = plan_get_stats()->appends - appends;
+    sim_result.heap_kept = int32_t(heap_start - heap_caps_get_free_size(MALLOC_CAP_8BIT));
+    sim_running        = false;
+    closeFile();
+
+    if (!sys.abort) {
+        st_reset();
+        plan_reset();
+        gc_state = saved_state;
+        plan_sync_position();
+        sys.state = State::Idle;
+    }
+    sim_report(client);
+    if (sim_golden) {
+        sim_golden.close();
+    }
+}
+
+#else
+
+bool sim_active() {
+    return false;
+}
+
+void sim_drain(bool all) {}
+
+void sim_dwell(float seconds) {}
+
+void sim_segment(float mm, float minutes, float nominal_speed, bool depth_limited) {}
+
+#endif
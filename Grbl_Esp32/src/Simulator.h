@@ -0,0 +1,123 @@
+#pragma once
+
+/*
+  Simulator.h - runs a file through the parser, planner and segment prep without motion
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  $SD/Simulate=<file> feeds a file from the SD card to gc_execute_line() in check mode, but with the
+  planner and st_prep_buffer() running. Whenever the planner is full, or the parser waits for the
+  motion to end, the prepped segments are dropped instead of stepped and their step timer ticks are
+  added up. The planner is kept full the way a sender that is well ahead of the machine keeps it, so
+  the sum is the cycle time the machine would take with the current settings and overrides.
+
+  The report gives the lines per second and the CPU cycles spent per line in the parser and planner
+  and per segment in the segment prep, which makes it a benchmark for changes to those stages, and
+  the planned time, which can be held against the time of the same file on the machine. The files in
+  src/tests are the reference set: parser.nc and parsetest.nc for the parser, raster_tree.nc and
+  arcs_arrows.nc as long jobs.
+
+  For regressions the report has a digest, a CRC of the result of every line and of the parser modes
+  and position after it, and the heap the run took at its peak and kept at the end. A change to the
+  parser that is meant to be faster only should leave the digest of each reference file as it was.
+  $SD/Simulate=P=<file> D=<digest> also says whether the digest matches.
+
+  For the planner and the segment prep, R=<golden file> records every segment the run preps, its step
+  count, step period, direction bits and AMASS level, to a file on the SD card, and C=<golden file>
+  compares the segments of the run with one recorded before. Step counts may differ by
+  SIM_TRACE_STEP_TOLERANCE and periods by SIM_TRACE_PERIOD_TOLERANCE per mille; the directions and
+  AMASS levels must match. A golden file holds for the settings it was recorded with.
+
+  As a cycle time estimate for a job it also gives the average feed rate and the time spent below the
+  nominal feed rate, the programmed rate with the overrides and the axis rate limits applied. Of that,
+  the depth limited time is the deceleration the machine would do only because the planner buffer
+  ends there, which a deeper buffer (BLOCK_BUFFER_SIZE) would save.
+
+  Nothing moves and the spindle and coolant stay off. When the file is done the planner, the segment
+  buffer and the parser state are put back to what they were before, so the machine position is
+  unchanged.
+*/
+
+#include "Grbl.h"
+
+// The simulation runs in the protocol loop and gives the other tasks a tick this often.
+#ifndef SIM_YIELD_MS
+#    define SIM_YIELD_MS 100
+#endif
+
+// How far a segment may be from its golden record
+#ifndef SIM_TRACE_STEP_TOLERANCE
+#    define SIM_TRACE_STEP_TOLERANCE 1  // Steps
+#endif
+#ifndef SIM_TRACE_PERIOD_TOLERANCE
+#    define SIM_TRACE_PERIOD_TOLERANCE 5  // Per mille of the step period
+#endif
+
+// What a run does with the segments it preps
+enum class SimTrace : uint8_t {
+    None = 0,
+    Record,   // Writes them to the golden file
+    Compare,  // Compares them with the golden file
+};
+
+typedef struct {
+    uint32_t lines;          // Lines read from the file
+    uint32_t errors;         // Lines gc_execute_line() rejected
+    uint32_t first_error;    // Line number of the first of them
+    uint32_t blocks;         // Planner blocks appended
+    uint32_t segments;       // Step segments prepped
+    uint64_t ticks;          // Step timer ticks of those segments
+    float    dwell_seconds;  // G4 time, which the segments do not include
+    float    distance;       // mm traveled
+    float    below_seconds;  // Time below the nominal feed rate
+    float    depth_seconds;  // Deceleration forced by the end of the planner buffer
+    uint64_t parse_cycles;   // CPU cycles in gc_execute_line() and the planner
+    uint64_t prep_cycles;    // CPU cycles in st_prep_buffer()
+    int64_t  wall_us;        // Time the simulation took
+    uint32_t digest;         // CRC of the line results and parser states
+    uint32_t heap_peak;      // Most heap bytes in use by the run at once
+    int32_t  heap_kept;      // Heap bytes still in use when it ended
+    uint32_t mismatches;     // Segments outside the tolerances of their golden record
+    uint32_t first_mismatch; // Index of the first of them
+} sim_result_t;
+
+// Queues path for simulation by the protocol loop. Needs an idle machine and an idle SD card. A
+// nonzero expected_digest is checked against the digest of the run. golden is the file for trace.
+Error sim_request(const char* path,
+                  uint8_t     client,
+                  uint32_t    expected_digest = 0,
+                  SimTrace    trace           = SimTrace::None,
+                  const char* golden          = NULL);
+
+// Runs a queued simulation. Called by the protocol loop.
+void sim_execute();
+
+// True while a simulation runs. The motion control and protocol calls below hand their waits for the
+// stepper to these.
+bool sim_active();
+
+// Makes room in the planner buffer. all runs the planner and segment buffers dry.
+void sim_drain(bool all);
+
+void sim_dwell(float seconds);
+
+// Adds a segment prepped by st_prep_buffer(): its length, its time in minutes, the nominal speed of its
+// block and whether it decelerates only because of the planner depth.
+void sim_segment(float mm, float minutes, float nominal_speed, bool depth_limited);
+
+// The result of the last simulation.
+const sim_result_t* sim_get_result();
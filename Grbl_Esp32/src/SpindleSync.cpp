@@ -0,0 +1,195 @@
+/*
+  SpindleSync.cpp - spindle encoder and spindle synchronized motion
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_SPINDLE_SYNC
+
+#    include <driver/pcnt.h>
+#    include <soc/pcnt_struct.h>
+
+// The counter resets to 0 at either limit, so raw counts are taken modulo this.
+static const int16_t ENCODER_COUNT_LIMIT = 32767;
+
+volatile uint32_t spindle_sync_start_us;
+
+static esp_timer_handle_t encoder_timer    = NULL;
+static portMUX_TYPE       encoder_spinlock = portMUX_INITIALIZER_UNLOCKED;
+static int32_t            encoder_position;  // Position at the last sample
+static int16_t            encoder_raw;       // Counter value at the last sample
+static int64_t            encoder_time;
+static volatile float     encoder_rate;  // Counts per second
+
+static volatile int16_t  index_raw;  // Counter value at the last index pulse
+static volatile uint32_t index_count;
+
+static int32_t sync_origin;
+
+static inline int16_t IRAM_ATTR encoder_read_raw() {
+    return int16_t(PCNT.cnt_unit[SPINDLE_ENCODER_PCNT_UNIT].cnt_val);
+}
+
+// Difference of two raw counts, for moves of less than half the count limit.
+static int32_t encoder_delta(int16_t to, int16_t from) {
+    int32_t delta = (int32_t(to) - from) % ENCODER_COUNT_LIMIT;
+    if (delta > ENCODER_COUNT_LIMIT / 2) {
+        delta -= ENCODER_COUNT_LIMIT;
+    } else if (delta < -ENCODER_COUNT_LIMIT / 2) {
+        delta += ENCODER_COUNT_LIMIT;
+    }
+    return delta;
+}
+
+static void encoder_sample(void* arg) {
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&encoder_spinlock);
+    int16_t raw   = encoder_read_raw();
+    int32_t delta = encoder_delta(raw, encoder_raw);
+    encoder_position += delta;
+    encoder_raw = raw;
+    portEXIT_CRITICAL(&encoder_spinlock);
+    // Light smoothing. A sample holds few counts at low speeds.
+    float rate   = delta * 1000000.0f / (now - encoder_time);
+    encoder_rate = encoder_rate + 0.25f * (rate - encoder_rate);
+    encoder_time = now;
+}
+
+#    ifdef SPINDLE_ENCODER_INDEX_PIN
+static void IRAM_ATTR isr_encoder_index() {
+    index_raw = encoder_read_raw();
+    index_count++;
+}
+#    endif
+
+void spindle_encoder_init() {
+    pcnt_config_t config  = {};
+    config.pulse_gpio_num = SPINDLE_ENCODER_A_PIN;
+    config.channel        = PCNT_CHANNEL_0;
+    config.unit           = SPINDLE_ENCODER_PCNT_UNIT;
+#    ifdef SPINDLE_ENCODER_B_PIN
+    // Counts both edges of A, with B giving the direction.
+    config.ctrl_gpio_num = SPINDLE_ENCODER_B_PIN;
+    config.pos_mode      = PCNT_COUNT_DEC;
+    config.neg_mode      = PCNT_COUNT_INC;
+    config.lctrl_mode    = PCNT_MODE_REVERSE;
+    config.hctrl_mode    = PCNT_MODE_KEEP;
+#    else
+    config.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+    config.pos_mode      = PCNT_COUNT_INC;
+    config.neg_mode      = PCNT_COUNT_DIS;
+    config.lctrl_mode    = PCNT_MODE_KEEP;
+    config.hctrl_mode    = PCNT_MODE_KEEP;
+#    endif
+    config.counter_h_lim = ENCODER_COUNT_LIMIT;
+    config.counter_l_lim = -ENCODER_COUNT_LIMIT;
+    pcnt_unit_config(&config);
+
+    pcnt_set_filter_value(SPINDLE_ENCODER_PCNT_UNIT, 100);  // Ignore glitches shorter than 1.25us (APB cycles)
+    pcnt_filter_enable(SPINDLE_ENCODER_PCNT_UNIT);
+    pcnt_counter_pause(SPINDLE_ENCODER_PCNT_UNIT);
+    pcnt_counter_clear(SPINDLE_ENCODER_PCNT_UNIT);
+    pcnt_counter_resume(SPINDLE_ENCODER_PCNT_UNIT);
+
+#    ifdef SPINDLE_ENCODER_INDEX_PIN
+    pinMode(SPINDLE_ENCODER_INDEX_PIN, INPUT);
+    attachInterrupt(SPINDLE_ENCODER_INDEX_PIN, isr_encoder_index, RISING);
+#    endif
+
+    encoder_position = 0;
+    encoder_raw      = 0;
+    encoder_rate     = 0.0;
+    encoder_time     = esp_timer_get_time();
+    if (encoder_timer == NULL) {
+        esp_timer_create_args_t args = {};
+        args.callback                = encoder_sample;
+        args.name                    = "spindleEncoder";
+        esp_timer_create(&args, &encoder_timer);
+        esp_timer_start_periodic(encoder_timer, SPINDLE_ENCODER_SAMPLE_MS * 1000);
+    }
+
+    grbl_msg_sendf(CLIENT_SERIAL,
+                   MsgLevel::Info,
+                   "Spindle encoder A:%s B:%s Index:%s %d counts/rev",
+                   pinName(SPINDLE_ENCODER_A_PIN).c_str(),
+#    ifdef SPINDLE_ENCODER_B_PIN
+                   pinName(SPINDLE_ENCODER_B_PIN).c_str(),
+#    else
+                   "None",
+#    endif
+#    ifdef SPINDLE_ENCODER_INDEX_PIN
+                   pinName(SPINDLE_ENCODER_INDEX_PIN).c_str(),
+#    else
+                   "None",
+#    endif
+                   SPINDLE_ENCODER_COUNTS_PER_REV);
+}
+
+int32_t spindle_encoder_position() {
+    portENTER_CRITICAL(&encoder_spinlock);
+    int32_t position = encoder_position + encoder_delta(encoder_read_raw(), encoder_raw);
+    portEXIT_CRITICAL(&encoder_spinlock);
+    return position;
+}
+
+float spindle_encoder_rpm() {
+    return encoder_rate * 60.0f / SPINDLE_ENCODER_COUNTS_PER_REV;
+}
+
+bool spindle_sync_begin() {
+    float rpm = fabsf(spindle_encoder_rpm());
+    if (rpm < 1.0) {
+        grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Spindle not turning");
+        return false;
+    }
+#    ifdef SPINDLE_ENCODER_INDEX_PIN
+    // Two revolutions is plenty to see an index.
+    int64_t  deadline = esp_timer_get_time() + int64_t(2 * 60000000 / rpm);
+    uint32_t count    = index_count;
+    while (index_count == count) {
+        if (esp_timer_get_time() > deadline) {
+            grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "No spindle index");
+            return false;
+        }
+        protocol_execute_realtime();
+        if (sys.abort) {
+            return false;
+        }
+        delay(1);
+    }
+    portENTER_CRITICAL(&encoder_spinlock);
+    int16_t raw      = encoder_read_raw();
+    int32_t position = encoder_position + encoder_delta(raw, encoder_raw);
+    portEXIT_CRITICAL(&encoder_spinlock);
+    sync_origin = position - encoder_delta(raw, index_raw);
+#    else
+    sync_origin = spindle_encoder_position();
+#    endif
+    spindle_sync_start_us = uint32_t(esp_timer_get_time());
+    return true;
+}
+
+float spindle_sync_revolutions(float minutes, float* rev_per_min) {
+    float   rate   = encoder_rate;
+    int32_t counts = spindle_encoder_position() - sync_origin;
+    // Time from now to the predicted point, negative when it is already past.
+    int32_t ahead_us = int32_t(spindle_sync_start_us + uint32_t(minutes * 60000000.0f) - uint32_t(esp_timer_get_time()));
+    *rev_per_min     = fabsf(rate) * 60.0f / SPINDLE_ENCODER_COUNTS_PER_REV;
+    return fabsf(counts + rate * ahead_us * 0.000001f) / SPINDLE_ENCODER_COUNTS_PER_REV;
+}
+
+#endif
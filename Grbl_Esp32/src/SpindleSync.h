@@ -0,0 +1,79 @@
+#pragma once
+
+/*
+  SpindleSync.h - spindle encoder and spindle synchronized motion
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  The spindle encoder is counted by a pulse counter unit. With SPINDLE_ENCODER_B_PIN it is decoded as
+  quadrature on both edges of A, otherwise the rising edges of A are counted. The counter is unwrapped
+  into a 32 bit position by a periodic sample, which also measures the speed. An optional index pin
+  latches the count once per revolution.
+
+  G33 X.. Z.. K.. is a spindle synchronized move. K is the distance per spindle revolution along the
+  move. The first G33 after other motion waits for the machine to stop and for the next index pulse,
+  so every pass of a thread starts at the same spindle angle. G33 moves that follow directly keep that
+  reference. The stepper prep sets the speed of each segment from the spindle position predicted for
+  it, within the block acceleration, so the move lags the spindle during its acceleration and catches up
+  after it. A feed hold ends the synchronization and the remaining moves run at their planned rate.
+
+  Machine definitions set SPINDLE_ENCODER_A_PIN and SPINDLE_ENCODER_COUNTS_PER_REV (counts as decoded,
+  so twice the lines per revolution with a B pin), and optionally SPINDLE_ENCODER_B_PIN and
+  SPINDLE_ENCODER_INDEX_PIN. Without an index the reference is the spindle angle at the start.
+*/
+
+#include "Grbl.h"
+
+#ifndef SPINDLE_ENCODER_A_PIN
+#    error "ENABLE_SPINDLE_SYNC requires SPINDLE_ENCODER_A_PIN"
+#endif
+#ifndef SPINDLE_ENCODER_COUNTS_PER_REV
+#    error "ENABLE_SPINDLE_SYNC requires SPINDLE_ENCODER_COUNTS_PER_REV"
+#endif
+
+// Pulse counter unit of the encoder. Unit 0 is the default for the PWM spindle tachometer.
+#ifndef SPINDLE_ENCODER_PCNT_UNIT
+#    define SPINDLE_ENCODER_PCNT_UNIT PCNT_UNIT_1
+#endif
+
+// Period of the position and speed sample. The counter must not move more than 16383 counts in it.
+#ifndef SPINDLE_ENCODER_SAMPLE_MS
+#    define SPINDLE_ENCODER_SAMPLE_MS 10
+#endif
+
+// Time of the first step of a synchronized chain, in esp_timer microseconds. Set by the step ISR.
+extern volatile uint32_t spindle_sync_start_us;
+
+void spindle_encoder_init();
+
+// Encoder counts since startup.
+int32_t spindle_encoder_position();
+
+// Measured spindle speed in revolutions per minute. Negative when the count goes down.
+float spindle_encoder_rpm();
+
+// Sets the reference of a new synchronized chain: the next index position, or the current position
+// without an index pin. Returns false if the spindle is not turning or no index arrives.
+bool spindle_sync_begin();
+
+// Revolutions turned since the reference, predicted for the given time in minutes after the first step
+// of the chain. rev_per_min is set to the spindle speed. Called by the stepper prep.
+float spindle_sync_revolutions(float minutes, float* rev_per_min);
+
+inline void IRAM_ATTR spindle_sync_mark_start() {
+    spindle_sync_start_us = uint32_t(esp_timer_get_time());
+}
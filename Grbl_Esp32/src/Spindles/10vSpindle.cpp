@@ -153,20 +153,24 @@ namespace Spindles {
             enable = !enable;
         }
 
-        digitalWrite(_enable_pin, enable);
+        PinBatch batch;
+        batch.write(_enable_pin, enable);
 
         // turn off anything that acts like an enable
         if (!enable) {
-            digitalWrite(_direction_pin, enable);
-            digitalWrite(_forward_pin, enable);
-            digitalWrite(_reverse_pin, enable);
+            batch.write(_direction_pin, enable);
+            batch.write(_forward_pin, enable);
+            batch.write(_reverse_pin, enable);
         }
+        batch.commit();
     }
 
     void _10v::set_dir_pin(bool Clockwise) {
         //grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Spindle::_10v::set_dir_pin");
-        digitalWrite(_direction_pin, Clockwise);
-        digitalWrite(_forward_pin, Clockwise);
-        digitalWrite(_reverse_pin, !Clockwise);
+        PinBatch batch;
+        batch.write(_direction_pin, Clockwise);
+        batch.write(_forward_pin, Clockwise);
+        batch.write(_reverse_pin, !Clockwise);
+        batch.commit();
     }
 }
@@ -34,8 +34,11 @@ namespace Spindles {
 
         _min_rpm       = rpm_min->get();
         _max_rpm       = rpm_max->get();
+        _pwm_period    = 255;  // Full scale DAC counts, for the levels rpm_to_duty() computes
+        _pwm_off_value = 0;
         _pwm_min_value = 0;    // not actually PWM...DAC counts
         _pwm_max_value = 255;  // not actually PWM...DAC counts
+        _dac_output    = true;
         _gpio_ok       = true;
 
         if (_output_pin != GPIO_NUM_25 && _output_pin != GPIO_NUM_26) {  // DAC can only be used on these pins
@@ -44,6 +47,9 @@ namespace Spindles {
             return;
         }
 
+        dacWrite(_output_pin, 0);  // Powers the pad up for write_duty_isr()
+        _current_pwm_duty = 0;
+
         pinMode(_enable_pin, OUTPUT);
         pinMode(_direction_pin, OUTPUT);
 
@@ -85,7 +91,7 @@ namespace Spindles {
                 rpm               = _min_rpm;
                 sys.spindle_speed = rpm;
                 pwm_value         = 0;
-                grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Spindle RPM less than min RPM:%5.2f %d", rpm, pwm_value);
+                grbl_msg_deferf(CLIENT_SERIAL, MsgLevel::Info, "Spindle RPM less than min RPM:%5.2f %d", rpm, pwm_value);
             }
         } else {
             // Compute intermediate PWM value with linear spindle speed model.
@@ -102,7 +108,22 @@ namespace Spindles {
 
     void Dac::set_output(uint32_t duty) {
         if (_gpio_ok) {
+            _current_pwm_duty = duty;
             dacWrite(_output_pin, (uint8_t)duty);
         }
     }
+
+    // In laser mode, M4 scales the level with the feed rate like the Laser spindle, for analog
+    // modulated lasers.
+    bool Dac::isRateAdjusted() { return laser_mode->get(); }
+
+    // The step ISR writes the level of each segment, and with LASER_POWER_RAMP each step of the
+    // ramp through a segment, to the DAC register. An enable pin that turns off at zero speed
+    // needs the update from the spindle layer instead.
+    PWM* Dac::fast_output() {
+        if (_output_pin == UNDEFINED_PIN || !_gpio_ok || (_enable_pin != UNDEFINED_PIN && _off_with_zero_speed)) {
+            return nullptr;
+        }
+        return this;
+    }
 }
@@ -40,6 +40,8 @@ namespace Spindles {
         void     init() override;
         void     config_message() override;
         uint32_t set_rpm(uint32_t rpm) override;
+        bool     isRateAdjusted() override;
+        PWM*     fast_output() override;
 
         virtual ~Dac() {}
 
@@ -119,10 +119,10 @@ namespace Spindles {
         //  Recv: 01 03 0004 095D 0000
         //                   ---- = 2397 (val #1)
 
-        // TODO: What are we going to do with this? Update sys.spindle_speed? Update vfd state?
+        // The measured speed ends the spin-up and spin-down waits in set_state().
         return [](const uint8_t* response, Spindles::VFD* vfd) -> bool {
-            uint16_t rpm = (uint16_t(response[4]) << 8) | uint16_t(response[5]);
-            // Set current RPM value? Somewhere?
+            uint16_t rpm   = (uint16_t(response[4]) << 8) | uint16_t(response[5]);
+            vfd->_sync_rpm = rpm;
             return true;
         };
     }
@@ -157,6 +157,27 @@ namespace Spindles {
         data.msg[4] = (value & 0xFF);
     }
 
+    Huanyang::response_parser Huanyang::get_current_rpm(ModbusCommand& data) {
+        // NOTE: data length is excluding the CRC16 checksum.
+        data.tx_length = 6;
+        data.rx_length = 6;
+
+        // data.msg[0] is omitted (modbus address is filled in later)
+        data.msg[1] = 0x04;
+        data.msg[2] = 0x03;
+        data.msg[3] = 0x01;  // Output frequency * 100
+        data.msg[4] = 0x00;
+        data.msg[5] = 0x00;
+
+        // The output frequency is converted back with the RPM to Hz factor of set_speed_command(), so the
+        // spindle reads as at speed once the VFD outputs the frequency it was given.
+        return [](const uint8_t* response, Spindles::VFD* vfd) -> bool {
+            uint16_t frequency = (uint16_t(response[4]) << 8) | uint16_t(response[5]);
+            vfd->_sync_rpm     = uint32_t(frequency) * 60 / 100;
+            return true;
+        };
+    }
+
     Huanyang::response_parser Huanyang::get_status_ok(ModbusCommand& data) {
         // NOTE: data length is excluding the CRC16 checksum.
         data.tx_length = 6;
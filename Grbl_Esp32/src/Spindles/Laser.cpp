@@ -28,6 +28,15 @@ namespace Spindles {
         return true;  // can use M4 (CCW) laser mode.
     }
 
+    PWM* Laser::fast_output() {
+        // With an enable pin that turns off at zero speed, every segment also needs the enable pin update.
+        if (_output_pin == UNDEFINED_PIN || _output_pin >= I2S_OUT_PIN_BASE || _piecewide_linear ||
+            (_enable_pin != UNDEFINED_PIN && _off_with_zero_speed)) {
+            return nullptr;
+        }
+        return this;
+    }
+
     void Laser::config_message() {
         grbl_msg_sendf(CLIENT_SERIAL,
                        MsgLevel::Info,
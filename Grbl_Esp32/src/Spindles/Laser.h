@@ -36,6 +36,7 @@ namespace Spindles {
 
         bool isRateAdjusted() override;
         void config_message() override;
+        PWM* fast_output() override;
 
         virtual ~Laser() {}
     };
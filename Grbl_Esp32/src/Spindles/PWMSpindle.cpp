@@ -21,6 +21,47 @@
 */
 #include "PWMSpindle.h"
 
+#include <soc/ledc_struct.h>
+#include <soc/rtc_io_reg.h>
+#include <driver/pcnt.h>
+
+// Optional tachometer. Define SPINDLE_TACH_PIN in the machine definition to measure the spindle speed
+// with a pulse counter. The spin-up and spin-down delays then end once the spindle is at speed.
+#ifndef SPINDLE_TACH_PULSES_PER_REV
+#    define SPINDLE_TACH_PULSES_PER_REV 1
+#endif
+
+#ifndef SPINDLE_TACH_PCNT_UNIT
+#    define SPINDLE_TACH_PCNT_UNIT PCNT_UNIT_0
+#endif
+
+// More pulses per revolution or a longer sample give a finer RPM reading.
+#ifndef SPINDLE_TACH_SAMPLE_MS
+#    define SPINDLE_TACH_SAMPLE_MS 250
+#endif
+
+// The counter wraps to 0 here, so a sample can hold up to this many pulses.
+static const int16_t SPINDLE_TACH_COUNT_LIMIT = 32767;
+
+// Shared by all the PWM based spindles, since they use the same counter.
+static esp_timer_handle_t tach_timer = NULL;
+static volatile uint32_t  tach_rpm   = 0;
+static int16_t            tach_count;
+static int64_t            tach_time;
+
+static void tach_sample(void* arg) {
+    int16_t count;
+    int64_t now = esp_timer_get_time();
+    pcnt_get_counter_value(SPINDLE_TACH_PCNT_UNIT, &count);
+    int32_t pulses = count - tach_count;
+    if (pulses < 0) {
+        pulses += SPINDLE_TACH_COUNT_LIMIT;
+    }
+    tach_rpm   = uint64_t(pulses) * 60000000 / (uint64_t(SPINDLE_TACH_PULSES_PER_REV) * (now - tach_time));
+    tach_count = count;
+    tach_time  = now;
+}
+
 // ======================= PWM ==============================
 /*
     This gets called at startup or whenever a spindle setting changes
@@ -96,29 +137,87 @@ namespace Spindles {
         _pwm_max_value = (_pwm_period * spindle_pwm_max_value->get() / 100.0);
 
 #ifdef ENABLE_PIECEWISE_LINEAR_SPINDLE
-        _min_rpm          = RPM_MIN;
-        _max_rpm          = RPM_MAX;
-        _piecewide_linear = true;
+        _min_rpm = RPM_MIN;
+        _max_rpm = RPM_MAX;
 #else
-        _min_rpm          = rpm_min->get();
-        _max_rpm          = rpm_max->get();
-        _piecewide_linear = false;
+        _min_rpm = rpm_min->get();
+        _max_rpm = rpm_max->get();
 #endif
-        // The pwm_gradient is the pwm duty cycle units per rpm
-        // _pwm_gradient = (_pwm_max_value - _pwm_min_value) / (_max_rpm - _min_rpm);
+        _lut_generation = 0;  // The next rpm_to_duty() builds the table for these values
 
         _pwm_chan_num = 0;  // Channel 0 is reserved for spindle use
+
+#ifdef SPINDLE_TACH_PIN
+        _tach_pin = SPINDLE_TACH_PIN;
+#else
+        _tach_pin         = UNDEFINED_PIN;
+#endif
+        tach_init();
+    }
+
+    void PWM::tach_init() {
+        if (_tach_pin == UNDEFINED_PIN) {
+            return;
+        }
+
+        pcnt_config_t config  = {};
+        config.pulse_gpio_num = _tach_pin;
+        config.ctrl_gpio_num  = PCNT_PIN_NOT_USED;
+        config.channel        = PCNT_CHANNEL_0;
+        config.unit           = SPINDLE_TACH_PCNT_UNIT;
+        config.pos_mode       = PCNT_COUNT_INC;  // Count rising edges only
+        config.neg_mode       = PCNT_COUNT_DIS;
+        config.lctrl_mode     = PCNT_MODE_KEEP;
+        config.hctrl_mode     = PCNT_MODE_KEEP;
+        config.counter_h_lim  = SPINDLE_TACH_COUNT_LIMIT;
+        config.counter_l_lim  = 0;
+        pcnt_unit_config(&config);
+
+        pcnt_set_filter_value(SPINDLE_TACH_PCNT_UNIT, 1023);  // Ignore glitches shorter than 12.8us (APB cycles)
+        pcnt_filter_enable(SPINDLE_TACH_PCNT_UNIT);
+        pcnt_counter_pause(SPINDLE_TACH_PCNT_UNIT);
+        pcnt_counter_clear(SPINDLE_TACH_PCNT_UNIT);
+        pcnt_counter_resume(SPINDLE_TACH_PCNT_UNIT);
+
+        if (tach_timer == NULL) {
+            esp_timer_create_args_t args = {};
+            args.callback                = tach_sample;
+            args.name                    = "spindleTach";
+            esp_timer_create(&args, &tach_timer);
+        } else {
+            esp_timer_stop(tach_timer);
+        }
+        tach_count = 0;
+        tach_time  = esp_timer_get_time();
+        tach_rpm   = 0;
+        esp_timer_start_periodic(tach_timer, SPINDLE_TACH_SAMPLE_MS * 1000);
     }
 
-    uint32_t PWM::set_rpm(uint32_t rpm) {
-        uint32_t pwm_value;
+    bool PWM::has_speed_feedback() { return _tach_pin != UNDEFINED_PIN; }
+
+    uint32_t PWM::measured_rpm() { return tach_rpm; }
 
+    uint32_t MOTION_IRAM PWM::set_rpm(uint32_t rpm) {
+        HOT_PATH_PROFILE(HotPath::SpindleSetRpm);
         if (_output_pin == UNDEFINED_PIN) {
             return rpm;
         }
 
         //grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "set_rpm(%d)", rpm);
 
+        uint32_t pwm_value = rpm_to_duty(rpm);
+
+        set_enable_pin(_current_state != SpindleState::Disable);
+        set_output(pwm_value);
+
+        return 0;
+    }
+
+    uint32_t PWM::rpm_to_duty(uint32_t rpm) {
+        if (_lut_generation != Setting::Generation) {
+            build_lut();
+        }
+
         // apply override
         rpm = rpm * sys.spindle_speed_ovr / 100;  // Scale by spindle speed override value (uint8_t percent)
 
@@ -131,23 +230,141 @@ namespace Spindles {
 
         sys.spindle_speed = rpm;
 
-        if (_piecewide_linear) {
-            //pwm_value = piecewise_linear_fit(rpm); TODO
-            pwm_value = 0;
-            grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Warning: Linear fit not implemented yet.");
+        if (rpm == 0) {
+            return _pwm_off_value;
+        }
+
+        // rpm is within the limits here, so the position is at most SPINDLE_PWM_LUT_SIZE << 16
+        uint32_t pos   = (rpm - _min_rpm) * _lut_scale;
+        uint32_t index = pos >> 16;
+        if (index >= SPINDLE_PWM_LUT_SIZE) {
+            return _duty_lut[SPINDLE_PWM_LUT_SIZE];
+        }
+        int32_t step = int32_t(_duty_lut[index + 1]) - int32_t(_duty_lut[index]);
+        return _duty_lut[index] + ((step * int32_t((pos & 0xFFFF) >> 8)) >> 8);
+    }
 
-        } else {
-            if (rpm == 0) {
-                pwm_value = _pwm_off_value;
+    int PWM::parse_curve(const char* curve, float* rpm, float* percent) {
+        int   count    = 0;
+        float last_rpm = -1.0;
+        while (*curve) {
+            if (*curve == ' ' || *curve == ',') {
+                curve++;
+                continue;
+            }
+            char* end;
+            float point_rpm = strtof(curve, &end);
+            if (end == curve || *end != ':') {
+                return -1;
+            }
+            curve               = end + 1;
+            float point_percent = strtof(curve, &end);
+            if (end == curve || (*end && *end != ' ' && *end != ',')) {
+                return -1;
+            }
+            if (point_rpm <= last_rpm || point_percent < 0.0 || point_percent > 100.0 || count == SPINDLE_PWM_CURVE_POINTS) {
+                return -1;
+            }
+            if (rpm != NULL) {
+                rpm[count]     = point_rpm;
+                percent[count] = point_percent;
+            }
+            last_rpm = point_rpm;
+            curve    = end;
+            count++;
+        }
+        return count;
+    }
+
+    // Rebuilds the RPM to duty table when a setting changed. The curve runs from $Spindle/PWM/Min at
+    // the min RPM to $Spindle/PWM/Max at the max RPM, straight unless the calibration points of
+    // $Spindle/PWM/Curve in between bend it to match a spindle whose speed is not linear in the duty.
+    void PWM::build_lut() {
+        _lut_generation = Setting::Generation;
+
+        float curve_rpm[SPINDLE_PWM_CURVE_POINTS + 2];
+        float curve_duty[SPINDLE_PWM_CURVE_POINTS + 2];
+        float point_rpm[SPINDLE_PWM_CURVE_POINTS];
+        float point_percent[SPINDLE_PWM_CURVE_POINTS];
+
+        int points = parse_curve(spindle_pwm_curve->get(), point_rpm, point_percent);
+        int n      = 0;
+
+        curve_rpm[n]    = _min_rpm;
+        curve_duty[n++] = _pwm_min_value;
+        for (int i = 0; i < points; i++) {
+            if (point_rpm[i] > _min_rpm && point_rpm[i] < _max_rpm) {
+                curve_rpm[n]    = point_rpm[i];
+                curve_duty[n++] = _pwm_period * point_percent[i] / 100.0;
+            }
+        }
+        curve_rpm[n]    = _max_rpm;
+        curve_duty[n++] = _pwm_max_value;
+
+        if (_min_rpm >= _max_rpm) {
+            // rpm_to_duty() limits every rpm to the max
+            _lut_scale = 0;
+            for (int i = 0; i <= SPINDLE_PWM_LUT_SIZE; i++) {
+                _duty_lut[i] = _pwm_max_value;
+            }
+            return;
+        }
+
+        _lut_scale  = (uint32_t(SPINDLE_PWM_LUT_SIZE) << 16) / (_max_rpm - _min_rpm);
+        int segment = 0;
+        for (int i = 0; i <= SPINDLE_PWM_LUT_SIZE; i++) {
+            float rpm = _min_rpm + float(_max_rpm - _min_rpm) * i / SPINDLE_PWM_LUT_SIZE;
+            while (segment < n - 2 && rpm > curve_rpm[segment + 1]) {
+                segment++;
+            }
+            float duty   = mapConstrain(rpm, curve_rpm[segment], curve_rpm[segment + 1], curve_duty[segment], curve_duty[segment + 1]);
+            _duty_lut[i] = uint32_t(duty + 0.5);
+        }
+    }
+
+    void IRAM_ATTR PWM::write_duty_isr(uint32_t duty) {
+        if (duty == _current_pwm_duty) {
+            return;
+        }
+
+        _current_pwm_duty = duty;
+
+        if (_dac_output) {
+            // The level field dacWrite() sets, once it has powered the pad up
+            if (_output_pin == GPIO_NUM_25) {
+                SET_PERI_REG_BITS(RTC_IO_PAD_DAC1_REG, RTC_IO_PDAC1_DAC, duty, RTC_IO_PDAC1_DAC_S);
             } else {
-                pwm_value = map_uint32_t(rpm, _min_rpm, _max_rpm, _pwm_min_value, _pwm_max_value);
+                SET_PERI_REG_BITS(RTC_IO_PAD_DAC2_REG, RTC_IO_PDAC2_DAC, duty, RTC_IO_PDAC2_DAC_S);
             }
+            return;
         }
 
-        set_enable_pin(_current_state != SpindleState::Disable);
-        set_output(pwm_value);
+        if (_invert_pwm) {
+            duty = (1 << _pwm_precision) - duty;
+        }
 
-        return 0;
+        // Same register sequence as ledcWrite(), but without its mutex, which cannot be taken in an ISR. A
+        // zero duty disables the output, which then stays at its idle level, low, instead of glitching.
+        uint8_t group   = _pwm_chan_num / 8;
+        auto&   channel = LEDC.channel_group[group].channel[_pwm_chan_num % 8];
+        channel.duty.duty = duty << 4;  // 25 bit (21.4)
+        if (duty) {
+            channel.conf0.sig_out_en = 1;
+            channel.conf1.duty_start = 1;
+            if (group) {
+                channel.conf0.val |= BIT(4);  // low_speed_update
+            } else {
+                channel.conf0.clk_en = 1;
+            }
+        } else {
+            channel.conf0.sig_out_en = 0;
+            channel.conf1.duty_start = 0;
+            if (group) {
+                channel.conf0.val &= ~BIT(4);
+            } else {
+                channel.conf0.clk_en = 0;
+            }
+        }
     }
 
     void PWM::set_state(SpindleState state, uint32_t rpm) {
@@ -155,29 +372,27 @@ namespace Spindles {
             return;  // Block during abort.
         }
 
+        SpindleState previous_state = _current_state;
+        uint32_t     previous_speed = sys.spindle_speed;
+
         _current_state = state;
 
         if (_current_state == SpindleState::Disable) {  // Halt or set spindle direction and rpm.
             sys.spindle_speed = 0;
             stop();
-            if (use_delays && (_current_state != state)) {
-                //grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "SpinDown Start ");
-                mc_dwell(spindle_delay_spindown->get());
-                //grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "SpinDown Done");
+            if (use_delays && previous_state != state) {
+                spin_wait(0, spindle_delay_spindown->get());
             }
         } else {
             set_dir_pin(_current_state == SpindleState::Cw);
             set_rpm(rpm);
             set_enable_pin(_current_state != SpindleState::Disable);  // must be done after setting rpm for enable features to work
-            if (use_delays && (_current_state != state)) {
-                //grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "SpinUp Start %d", rpm);
-                mc_dwell(spindle_delay_spinup->get());
-                //grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "SpinUp Done");
+            // With speed feedback, speed changes are waited for as well.
+            if (use_delays && (previous_state != state || (has_speed_feedback() && sys.spindle_speed != previous_speed))) {
+                spin_wait(sys.spindle_speed, spindle_delay_spinup->get());
             }
         }
 
-        _current_state = state;
-
         sys.report_ovr_counter = 0;  // Set to report change immediately
     }
 
@@ -191,6 +406,19 @@ namespace Spindles {
         return SpindleState::Cw;
     }
 
+    // Not when the enable pin follows the speed. set_enable_pin() then needs the rpm the ISR does not set.
+    bool PWM::state_in_planner() { return !(_off_with_zero_speed && _enable_pin != UNDEFINED_PIN); }
+
+    // Called by the step ISR when a block with a new state starts. The segment loaded right after it
+    // sets the output, so only the direction and enable pins change here.
+    void PWM::set_state_isr(SpindleState state) {
+        _current_state = state;
+        if (state != SpindleState::Disable) {
+            set_dir_pin(state == SpindleState::Cw);
+        }
+        set_enable_pin(state != SpindleState::Disable);
+    }
+
     void PWM::stop() {
         // inverts are delt with in methods
         set_enable_pin(false);
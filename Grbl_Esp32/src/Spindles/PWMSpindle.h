@@ -23,6 +23,15 @@
 */
 #include "Spindle.h"
 
+// Entries of the RPM to duty table, evenly spaced from the min to the max RPM
+#ifndef SPINDLE_PWM_LUT_SIZE
+#    define SPINDLE_PWM_LUT_SIZE 256
+#endif
+// Calibration points $Spindle/PWM/Curve can hold
+#ifndef SPINDLE_PWM_CURVE_POINTS
+#    define SPINDLE_PWM_CURVE_POINTS 16
+#endif
+
 namespace Spindles {
     // This adds support for PWM
     class PWM : public Spindle {
@@ -40,11 +49,26 @@ namespace Spindles {
         SpindleState     get_state() override;
         void             stop() override;
         void             config_message() override;
+        bool             has_speed_feedback() override;
+        uint32_t         measured_rpm() override;
+        bool             state_in_planner() override;
+        void             set_state_isr(SpindleState state) override;
+
+        // Split out of set_rpm() so the segment prep can compute the duty of each segment ahead of
+        // time. Applies the override and rpm limits, and updates sys.spindle_speed.
+        uint32_t rpm_to_duty(uint32_t rpm);
+        // ISR safe. Writes a duty from rpm_to_duty() straight to the LEDC registers, or to the DAC.
+        void IRAM_ATTR write_duty_isr(uint32_t duty);
+        uint32_t       off_duty() const { return _pwm_off_value; }
+
+        // Parses "rpm:percent rpm:percent ..." with the rpm rising. Returns the number of points, or -1
+        // when the text is not a valid curve. rpm and percent may be NULL to only check it.
+        static int parse_curve(const char* curve, float* rpm, float* percent);
 
         virtual ~PWM() {}
 
     protected:
-        int32_t  _current_pwm_duty;
+        volatile int32_t _current_pwm_duty;
         uint32_t _min_rpm;
         uint32_t _max_rpm;
         uint32_t _pwm_off_value;
@@ -57,16 +81,24 @@ namespace Spindles {
         uint32_t _pwm_freq;
         uint32_t _pwm_period;  // how many counts in 1 period
         uint8_t  _pwm_precision;
-        bool     _piecewide_linear;
         bool     _off_with_zero_speed;
         bool     _invert_pwm;
-        //uint32_t _pwm_gradient; // Precalulated value to speed up rpm to PWM conversions.
+        uint8_t  _tach_pin;
+        bool     _dac_output = false;  // The duty is a DAC level on _output_pin
+
+        // Duty at SPINDLE_PWM_LUT_SIZE + 1 evenly spaced rpm from _min_rpm to _max_rpm, so rpm_to_duty()
+        // interpolates between two entries instead of mapping the settings for every segment.
+        uint32_t _duty_lut[SPINDLE_PWM_LUT_SIZE + 1];
+        uint32_t _lut_scale;           // table positions per rpm, 16.16 fixed point
+        uint32_t _lut_generation = 0;  // Setting::Generation the table was built for, 0 to rebuild
 
         virtual void set_dir_pin(bool Clockwise);
         virtual void set_output(uint32_t duty);
         virtual void set_enable_pin(bool enable_pin);
 
         void    get_pins_and_settings();
+        void    build_lut();
+        void    tach_init();
         uint8_t calc_pwm_precision(uint32_t freq);
     };
 }
@@ -93,6 +93,46 @@ namespace Spindles {
         return false;  // default for basic spindle is false
     }
 
+    // Spindles that can have their output updated straight from the step ISR return themselves here.
+    // Everything else gets set_rpm() called as each segment is loaded.
+    PWM* Spindle::fast_output() { return nullptr; }
+
+    bool Spindle::has_speed_feedback() { return false; }
+
+    uint32_t Spindle::measured_rpm() { return 0; }
+
+    bool Spindle::state_in_planner() { return false; }
+
+    void Spindle::set_state_isr(SpindleState state) {}
+
+    void Spindle::spin_wait(uint32_t rpm, float max_seconds) {
+        // The suspend and restore sequences in protocol_exec_rt_suspend() do their own waiting.
+        if (max_seconds <= 0.0 || sys.state == State::CheckMode || sys.suspend) {
+            return;
+        }
+        float tolerance_percent = spindle_at_speed_tolerance->get();
+        if (!has_speed_feedback() || tolerance_percent <= 0.0) {
+            mc_dwell(max_seconds);
+            return;
+        }
+        int32_t tolerance = (rpm ? rpm : rpm_max->get()) * tolerance_percent / 100.0;
+        int64_t deadline  = esp_timer_get_time() + int64_t(max_seconds * 1000000);
+        bool    at_speed  = false;
+        _syncing          = true;
+        while (!sys.abort) {
+            at_speed = abs(int32_t(measured_rpm()) - int32_t(rpm)) <= tolerance;
+            if (at_speed || esp_timer_get_time() >= deadline) {
+                break;
+            }
+            protocol_execute_realtime();
+            delay(DWELL_TIME_STEP);
+        }
+        _syncing = false;
+        if (!at_speed && !sys.abort) {
+            grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Spindle at %d RPM, not at %d RPM", int(measured_rpm()), int(rpm));
+        }
+    }
+
     void Spindle::sync(SpindleState state, uint32_t rpm) {
         if (sys.state == State::CheckMode) {
             return;
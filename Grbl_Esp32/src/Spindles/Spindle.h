@@ -48,6 +48,8 @@ enum class SpindleType : int8_t {
 // ================ NO FLOATS! ==========================
 
 namespace Spindles {
+    class PWM;
+
     // This is the base class. Do not use this as your spindle
     class Spindle {
     public:
@@ -66,6 +68,17 @@ namespace Spindles {
         virtual void         config_message()                            = 0;
         virtual bool         isRateAdjusted();
         virtual void         sync(SpindleState state, uint32_t rpm);
+        virtual PWM*         fast_output();
+
+        // Spindles that measure their speed return true here. The spin-up and spin-down delays then end
+        // as soon as measured_rpm() is within $Spindle/AtSpeed/Tolerance of the target.
+        virtual bool     has_speed_feedback();
+        virtual uint32_t measured_rpm();
+
+        // Spindles that can switch direction and enable from the step ISR return true here. The output
+        // follows the segment rpm. Used by SPINDLE_STATE_IN_PLANNER.
+        virtual bool state_in_planner();
+        virtual void set_state_isr(SpindleState state);
 
         virtual ~Spindle() {}
 
@@ -74,6 +87,13 @@ namespace Spindles {
         volatile SpindleState _current_state = SpindleState::Disable;
 
         static void select();
+
+    protected:
+        // Waits for the spindle to reach rpm, for at most max_seconds. Without speed feedback it waits the
+        // full time, like a fixed delay.
+        void spin_wait(uint32_t rpm, float max_seconds);
+
+        volatile bool _syncing = false;  // spin_wait() is running
     };
 
 }
@@ -34,172 +34,197 @@
 */
 #include "VFDSpindle.h"
 
-const uart_port_t VFD_RS485_UART_PORT  = UART_NUM_2;  // hard coded for this port right now
-const int         VFD_RS485_BUF_SIZE   = 127;
-const int         VFD_RS485_QUEUE_SIZE = 10;   // numv\ber of commands that can be queued up.
-const int         RESPONSE_WAIT_TICKS  = 50;   // how long to wait for a response
-const int         VFD_RS485_POLL_RATE  = 200;  // in milliseconds between commands
-
-// OK to change these
-// #define them in your machine definition file if you want different values
-#ifndef VFD_RS485_ADDR
-#    define VFD_RS485_ADDR 0x01
-#endif
+const int RESPONSE_WAIT_TICKS      = 50;    // how long to wait for a response
+const int VFD_RS485_POLL_RATE      = 200;   // in milliseconds between status polls while idle
+const int VFD_RS485_SYNC_POLL_RATE = 50;    // in milliseconds between RPM polls while waiting for speed
+const int MODBUS_EXCEPTION_LENGTH  = 5;     // address, function | 0x80, exception code and CRC
+const int REQUEST_CRITICAL         = 0x01;  // RS485::Request flag, the alarm goes off when it fails
 
 namespace Spindles {
-    QueueHandle_t VFD::vfd_cmd_queue     = nullptr;
-    TaskHandle_t  VFD::vfd_cmdTaskHandle = nullptr;
+    // CRC16 of every byte value for the reflected Modbus polynomial 0xA001, so the CRC takes one lookup
+    // per byte instead of eight shifts.
+    static const uint16_t crc_table[256] = {
+        0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+        0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+        0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+        0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+        0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+        0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+        0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+        0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+        0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+        0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+        0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+        0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+        0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+        0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+        0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+        0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+        0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+        0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+        0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+        0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+        0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+        0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+        0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+        0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+        0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+        0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+        0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+        0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+        0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+        0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+        0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+        0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040,
+    };
+
+    // Turns a command into a bus request, with the CRC16 checksum added. The parser goes along with it.
+    void VFD::to_request(const ModbusCommand& cmd, response_parser parser, RS485::Request& request) {
+        request.device    = this;
+        request.context   = reinterpret_cast<uint32_t>(parser);
+        request.flags     = cmd.critical ? REQUEST_CRITICAL : 0;
+        request.attempts  = MAX_RETRIES;
+        request.timeout   = RESPONSE_WAIT_TICKS;
+        request.tx_length = cmd.tx_length + 2;
+        request.rx_length = cmd.rx_length + 2;
+        memcpy(request.msg, cmd.msg, cmd.tx_length);
+
+        auto crc16                     = ModRTU_CRC(cmd.msg, cmd.tx_length);
+        request.msg[cmd.tx_length]     = (crc16 & 0xFF);
+        request.msg[cmd.tx_length + 1] = (crc16 & 0xFF00) >> 8;
 
-    // The communications task
-    void VFD::vfd_cmd_task(void* pvParameters) {
-        static bool unresponsive = false;  // to pop off a message once each time it becomes unresponsive
-        static int  pollidx      = 0;
+#ifdef VFD_DEBUG_MODE
+        if (parser == nullptr) {
+            report_hex_msg(request.msg, "RS485 Tx: ", request.tx_length);
+        }
+#endif
+    }
 
-        VFD*          instance = static_cast<VFD*>(pvParameters);
-        ModbusCommand next_cmd;
-        uint8_t       rx_message[VFD_RS485_MAX_MSG_SIZE];
+    // Called by the bus task when no command is queued. The max RPM is asked for as long as it is 0,
+    // which means a previous initialization failed. Otherwise the RPM, direction and status are polled
+    // in turn.
+    bool VFD::poll(RS485::Request& request) {
+        ModbusCommand   cmd;
+        response_parser parser = nullptr;
 
-        while (true) {
-            response_parser parser = nullptr;
+        if (!vfd_ok) {
+            return false;
+        }
 
-            next_cmd.msg[0] = VFD_RS485_ADDR;  // Always default to this
+        cmd.msg[0]   = _modbus_id;  // Always default to this
+        cmd.critical = false;
 
-            // First check if we should ask the VFD for the max RPM value as part of the initialization. We
-            // should also query this is max_rpm is 0, because that means a previous initialization failed:
-            if (pollidx == 0 || (instance->_max_rpm == 0 && (parser = instance->get_max_rpm(next_cmd)) != nullptr)) {
-                pollidx           = 1;
-                next_cmd.critical = true;
-            } else {
-                next_cmd.critical = false;
+        if (_max_rpm == 0 && (parser = get_max_rpm(cmd)) != nullptr) {
+            cmd.critical = true;
+        } else {
+            // While set_state() waits for the spindle to reach its speed, only the RPM matters.
+            if (_syncing) {
+                _pollidx = 1;
             }
-
-            // If we don't have a parser, the queue goes first. During idle, we can grab a parser.
-            if (parser == nullptr && xQueueReceive(vfd_cmd_queue, &next_cmd, 0) != pdTRUE) {
-                // We poll in a cycle. Note that the switch will fall through unless we encounter a hit.
-                // The weakest form here is 'get_status_ok' which should be implemented if the rest fails.
-                switch (pollidx) {
-                    case 1:
-                        parser = instance->get_current_rpm(next_cmd);
-                        if (parser) {
-                            pollidx = 2;
-                            break;
-                        }
-                        // fall through intentionally:
-                    case 2:
-                        parser = instance->get_current_direction(next_cmd);
-                        if (parser) {
-                            pollidx = 3;
-                            break;
-                        }
-                        // fall through intentionally:
-                    case 3:
-                        parser  = instance->get_status_ok(next_cmd);
-                        pollidx = 1;
-
-                        // we could complete this in case parser == nullptr with some ifs, but let's
-                        // just keep it easy and wait an iteration.
+            // We poll in a cycle. Note that the switch will fall through unless we encounter a hit.
+            // The weakest form here is 'get_status_ok' which should be implemented if the rest fails.
+            switch (_pollidx) {
+                case 1:
+                    parser = get_current_rpm(cmd);
+                    if (parser) {
+                        _pollidx = 2;
                         break;
-                }
-
-                // If we have no parser, that means get_status_ok is not implemented (and we have
-                // nothing resting in our queue). Let's fall back on a simple continue.
-                if (parser == nullptr) {
-                    vTaskDelay(VFD_RS485_POLL_RATE);
-                    continue;  // main while loop
-                }
+                    }
+                    // fall through intentionally:
+                case 2:
+                    parser = get_current_direction(cmd);
+                    if (parser) {
+                        _pollidx = 3;
+                        break;
+                    }
+                    // fall through intentionally:
+                case 3:
+                    parser   = get_status_ok(cmd);
+                    _pollidx = 1;
+                    break;
             }
+        }
 
-            {
-                // Grabbed the command. Add the CRC16 checksum:
-                auto crc16 = ModRTU_CRC(next_cmd.msg, next_cmd.tx_length);
+        // If we have no parser, that means get_status_ok is not implemented. Skip this poll.
+        if (parser == nullptr) {
+            return false;
+        }
+        to_request(cmd, parser, request);
+        return true;
+    }
 
-                next_cmd.tx_length += 2;
-                next_cmd.rx_length += 2;
+    TickType_t VFD::poll_period() { return _syncing ? VFD_RS485_SYNC_POLL_RATE : VFD_RS485_POLL_RATE; }
 
-                // add the calculated Crc to the message
-                next_cmd.msg[next_cmd.tx_length - 1] = (crc16 & 0xFF00) >> 8;
-                next_cmd.msg[next_cmd.tx_length - 2] = (crc16 & 0xFF);
+    // Called by the bus task as the response arrives. The CRC is updated with each chunk, so it is known
+    // when the last byte is. A Modbus exception response is shorter than the expected reply, so it ends
+    // the wait as soon as it is complete instead of running into the timeout.
+    bool VFD::complete(const RS485::Request& request, const uint8_t* response, int length) {
+        _rx_crc        = ModRTU_CRC(response + _rx_crc_length, length - _rx_crc_length, _rx_crc);
+        _rx_crc_length = length;
+        return length >= request.rx_length || (length >= MODBUS_EXCEPTION_LENGTH && (response[1] & 0x80));
+    }
 
+    // Checks the response and hands it to the parser of the request. Returns false to have the command
+    // sent again.
+    bool VFD::response(const RS485::Request& request, const uint8_t* rx_message, int read_length) {
+        // The CRC is 0 for a complete frame with a good CRC, including the received CRC bytes
+        uint16_t crc16response = read_length == _rx_crc_length ? _rx_crc : ModRTU_CRC(rx_message, read_length);
+        _rx_crc                = 0xFFFF;
+        _rx_crc_length         = 0;
+
+        if (read_length != request.rx_length ||  // check expected length
+            rx_message[0] != request.msg[0] ||   // check address, commands may go to other devices on the bus
+            crc16response != 0) {                // check CRC
 #ifdef VFD_DEBUG_MODE
-                if (parser == nullptr) {
-                    report_hex_msg(next_cmd.msg, "RS485 Tx: ", next_cmd.tx_length);
+            report_hex_msg(request.msg, "RS485 Tx: ", request.tx_length);
+            report_hex_msg(rx_message, "RS485 Rx: ", read_length);
+
+            if (read_length != 0) {
+                if (rx_message[0] != request.msg[0]) {
+                    grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "RS485 received message from other modbus device");
+                } else if (read_length != request.rx_length) {
+                    grbl_msg_sendf(CLIENT_SERIAL,
+                                   MsgLevel::Info,
+                                   "RS485 received message of unexpected length; expected %d, got %d",
+                                   int(request.rx_length),
+                                   int(read_length));
+                } else {
+                    grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "RS485 CRC check failed");
                 }
-#endif
+            } else {
+                grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "RS485 No response");
             }
-
-            // Assume for the worst, and retry...
-            int retry_count = 0;
-            for (; retry_count < MAX_RETRIES; ++retry_count) {
-                // Flush the UART and write the data:
-                uart_flush(VFD_RS485_UART_PORT);
-                uart_write_bytes(VFD_RS485_UART_PORT, reinterpret_cast<const char*>(next_cmd.msg), next_cmd.tx_length);
-
-                // Read the response
-                uint16_t read_length = uart_read_bytes(VFD_RS485_UART_PORT, rx_message, next_cmd.rx_length, RESPONSE_WAIT_TICKS);
-
-                // Generate crc16 for the response:
-                auto crc16response = ModRTU_CRC(rx_message, next_cmd.rx_length - 2);
-
-                if (read_length == next_cmd.rx_length &&                             // check expected length
-                    rx_message[0] == VFD_RS485_ADDR &&                               // check address
-                    rx_message[read_length - 1] == (crc16response & 0xFF00) >> 8 &&  // check CRC byte 1
-                    rx_message[read_length - 2] == (crc16response & 0xFF)) {         // check CRC byte 1
-
-                    // success
-                    unresponsive = false;
-                    retry_count  = MAX_RETRIES + 1;  // stop retry'ing
-
-                    // Should we parse this?
-                    if (parser != nullptr && !parser(rx_message, instance)) {
-#ifdef VFD_DEBUG_MODE
-                        report_hex_msg(next_cmd.msg, "RS485 Tx: ", next_cmd.tx_length);
-                        report_hex_msg(rx_message, "RS485 Rx: ", read_length);
 #endif
+            return false;
+        }
 
-                        // Not succesful! Now what?
-                        unresponsive = true;
-                        grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Spindle RS485 did not give a satisfying response");
-                    }
-                } else {
+        // success
+        _unresponsive = false;
+
+        // Should we parse this?
+        response_parser parser = reinterpret_cast<response_parser>(request.context);
+        if (parser != nullptr && !parser(rx_message, this)) {
 #ifdef VFD_DEBUG_MODE
-                    report_hex_msg(next_cmd.msg, "RS485 Tx: ", next_cmd.tx_length);
-                    report_hex_msg(rx_message, "RS485 Rx: ", read_length);
-
-                    if (read_length != 0) {
-                        if (rx_message[0] != VFD_RS485_ADDR) {
-                            grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "RS485 received message from other modbus device");
-                        } else if (read_length != next_cmd.rx_length) {
-                            grbl_msg_sendf(CLIENT_SERIAL,
-                                           MsgLevel::Info,
-                                           "RS485 received message of unexpected length; expected %d, got %d",
-                                           int(next_cmd.rx_length),
-                                           int(read_length));
-                        } else {
-                            grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "RS485 CRC check failed");
-                        }
-                    } else {
-                        grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "RS485 No response");
-                    }
+            report_hex_msg(request.msg, "RS485 Tx: ", request.tx_length);
+            report_hex_msg(rx_message, "RS485 Rx: ", read_length);
 #endif
 
-                    // Wait a bit before we retry. Set the delay to poll-rate. Not sure
-                    // if we should use a different value...
-                    vTaskDelay(VFD_RS485_POLL_RATE);
-                }
-            }
+            // Not succesful! Now what?
+            _unresponsive = true;
+            grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Spindle RS485 did not give a satisfying response");
+        }
+        return true;
+    }
 
-            if (retry_count == MAX_RETRIES) {
-                if (!unresponsive) {
-                    grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Spindle RS485 Unresponsive %d", next_cmd.rx_length);
-                    if (next_cmd.critical) {
-                        grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Critical Spindle RS485 Unresponsive");
-                        system_set_exec_alarm(ExecAlarm::SpindleControl);
-                    }
-                    unresponsive = true;
-                }
+    // Pops off a message once each time the VFD becomes unresponsive
+    void VFD::failed(const RS485::Request& request) {
+        if (!_unresponsive) {
+            grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Spindle RS485 Unresponsive %d", request.rx_length);
+            if (request.flags & REQUEST_CRITICAL) {
+                grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Critical Spindle RS485 Unresponsive");
+                system_set_exec_alarm(ExecAlarm::SpindleControl);
             }
-
-            vTaskDelay(VFD_RS485_POLL_RATE);  // TODO: What is the best value here?
+            _unresponsive = true;
         }
     }
 
@@ -224,10 +249,6 @@ namespace Spindles {
             return;
         }
 
-        // this allows us to init() again later.
-        // If you change certain settings, init() gets called agian
-        uart_driver_delete(VFD_RS485_UART_PORT);
-
         uart_config_t uart_config;
         default_modbus_settings(uart_config);
 
@@ -242,40 +263,23 @@ namespace Spindles {
         uart_config.flow_ctrl           = UART_HW_FLOWCTRL_DISABLE;
         uart_config.rx_flow_ctrl_thresh = 122;
 
-        if (uart_param_config(VFD_RS485_UART_PORT, &uart_config) != ESP_OK) {
-            grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "RS485 VFD uart parameters failed");
-            return;
-        }
+        // Modbus RTU frames are separated by 3.5 characters of silence, with a fixed 1.75 ms above 19200 baud.
+        uint32_t frame_gap_us = uart_config.baud_rate > 19200 ? 1750 : (35 * 11 * 1000000UL) / (10 * uart_config.baud_rate);
 
-        if (uart_set_pin(VFD_RS485_UART_PORT, _txd_pin, _rxd_pin, _rts_pin, UART_PIN_NO_CHANGE) != ESP_OK) {
-            grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "RS485 VFD uart pin config failed");
+        // init can happen many times, the bus starts once and polls the VFD once it is attached
+        if (!RS485::bus.begin(uart_config, _txd_pin, _rxd_pin, _rts_pin, frame_gap_us)) {
+            grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "RS485 VFD bus failed");
             return;
         }
 
-        if (uart_driver_install(VFD_RS485_UART_PORT, VFD_RS485_BUF_SIZE * 2, 0, 0, NULL, 0) != ESP_OK) {
-            grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "RS485 VFD uart driver install failed");
-            return;
-        }
+        ModbusCommand probe;
+        _has_rpm_feedback = get_current_rpm(probe) != nullptr;
 
-        if (uart_set_mode(VFD_RS485_UART_PORT, UART_MODE_RS485_HALF_DUPLEX) != ESP_OK) {
-            grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "RS485 VFD uart set half duplex failed");
+        // Initialization is complete, so now it's okay to poll:
+        if (!RS485::bus.attach(this)) {
             return;
         }
 
-        // Initialization is complete, so now it's okay to run the queue task:
-        if (!_task_running) {  // init can happen many times, we only want to start one task
-            vfd_cmd_queue = xQueueCreate(VFD_RS485_QUEUE_SIZE, sizeof(ModbusCommand));
-            xTaskCreatePinnedToCore(vfd_cmd_task,         // task
-                                    "vfd_cmdTaskHandle",  // name for task
-                                    2048,                 // size of task stack
-                                    this,                 // parameters
-                                    1,                    // priority
-                                    &vfd_cmdTaskHandle,
-                                    0  // core
-            );
-            _task_running = true;
-        }
-
         is_reversable = true;  // these VFDs are always reversable
         use_delays    = true;
         vfd_ok        = true;
@@ -346,17 +350,16 @@ namespace Spindles {
             set_rpm(rpm);
             if (state == SpindleState::Disable) {
                 sys.spindle_speed = 0;
-                if (_current_state != state) {
-                    mc_dwell(spindle_delay_spindown->get());
-                }
+                spin_wait(0, spindle_delay_spindown->get());
             } else {
-                if (_current_state != state) {
-                    mc_dwell(spindle_delay_spinup->get());
-                }
+                spin_wait(_current_rpm, spindle_delay_spinup->get());
             }
         } else {
             if (_current_rpm != rpm) {
                 set_rpm(rpm);
+                if (has_speed_feedback()) {
+                    spin_wait(_current_rpm, spindle_delay_spinup->get());
+                }
             }
         }
 
@@ -367,27 +370,32 @@ namespace Spindles {
         return;
     }
 
+    bool VFD::has_speed_feedback() { return _has_rpm_feedback && vfd_ok; }
+
+    uint32_t VFD::measured_rpm() { return _sync_rpm; }
+
     bool VFD::set_mode(SpindleState mode, bool critical) {
         if (!vfd_ok) {
             return false;
         }
 
         ModbusCommand mode_cmd;
-        mode_cmd.msg[0] = VFD_RS485_ADDR;
+        mode_cmd.msg[0] = _modbus_id;
 
         direction_command(mode, mode_cmd);
 
+        // Turning off supersedes the commands still waiting for the bus
         if (mode == SpindleState::Disable) {
-            if (!xQueueReset(vfd_cmd_queue)) {
-                grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "VFD spindle off, queue could not be reset");
-            }
+            RS485::bus.cancel(this);
         }
 
         mode_cmd.critical = critical;
         _current_state    = mode;
 
-        if (xQueueSend(vfd_cmd_queue, &mode_cmd, 0) != pdTRUE) {
-            grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "VFD Queue Full");
+        RS485::Request request;
+        to_request(mode_cmd, nullptr, request);
+        if (!RS485::bus.submit(request)) {
+            grbl_msg_deferf(CLIENT_SERIAL, MsgLevel::Info, "VFD Queue Full");
         }
 
         return true;
@@ -399,7 +407,7 @@ namespace Spindles {
         }
 
 #ifdef VFD_DEBUG_MODE
-        grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Setting spindle speed to %d rpm (%d, %d)", int(rpm), int(_min_rpm), int(_max_rpm));
+        grbl_msg_deferf(CLIENT_SERIAL, MsgLevel::Info, "Setting spindle speed to %d rpm (%d, %d)", int(rpm), int(_min_rpm), int(_max_rpm));
 #endif
 
         // apply override
@@ -423,14 +431,16 @@ namespace Spindles {
         // TODO add the speed modifiers override, linearization, etc.
 
         ModbusCommand rpm_cmd;
-        rpm_cmd.msg[0] = VFD_RS485_ADDR;
+        rpm_cmd.msg[0] = _modbus_id;
 
         set_speed_command(rpm, rpm_cmd);
 
         rpm_cmd.critical = false;
 
-        if (xQueueSend(vfd_cmd_queue, &rpm_cmd, 0) != pdTRUE) {
-            grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "VFD Queue Full");
+        RS485::Request request;
+        to_request(rpm_cmd, nullptr, request);
+        if (!RS485::bus.submit(request)) {
+            grbl_msg_deferf(CLIENT_SERIAL, MsgLevel::Info, "VFD Queue Full");
         }
 
         return rpm;
@@ -441,25 +451,13 @@ namespace Spindles {
     // state is cached rather than read right now to prevent delays
     SpindleState VFD::get_state() { return _current_state; }
 
-    // Calculate the CRC on all of the byte except the last 2
-    // It then added the CRC to those last 2 bytes
-    // full_msg_len This is the length of the message including the 2 crc bytes
+    // Calculate the Modbus CRC of msg_len bytes, continuing from crc so a message can be done in parts.
+    // The CRC goes into the message low byte first; the CRC of a message including its CRC bytes is 0.
     // Source: https://ctlsys.com/support/how_to_compute_the_modbus_rtu_message_crc/
-    uint16_t VFD::ModRTU_CRC(uint8_t* buf, int msg_len) {
-        uint16_t crc = 0xFFFF;
+    uint16_t VFD::ModRTU_CRC(const uint8_t* buf, int msg_len, uint16_t crc) {
         for (int pos = 0; pos < msg_len; pos++) {
-            crc ^= uint16_t(buf[pos]);  // XOR byte into least sig. byte of crc.
-
-            for (int i = 8; i != 0; i--) {  // Loop over each bit
-                if ((crc & 0x0001) != 0) {  // If the LSB is set
-                    crc >>= 1;              // Shift right and XOR 0xA001
-                    crc ^= 0xA001;
-                } else {        // Else LSB is not set
-                    crc >>= 1;  // Just shift right
-                }
-            }
+            crc = (crc >> 8) ^ crc_table[(crc ^ buf[pos]) & 0xFF];
         }
-
         return crc;
     }
 }
@@ -19,12 +19,19 @@
     along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "Spindle.h"
+#include "../Rs485Bus.h"
 
 #include <driver/uart.h>
 
+// OK to change these
+// #define them in your machine definition file if you want different values
+#ifndef VFD_RS485_ADDR
+#    define VFD_RS485_ADDR 0x01
+#endif
+
 namespace Spindles {
 
-    class VFD : public Spindle {
+    class VFD : public Spindle, public RS485::Device {
     private:
         static const int VFD_RS485_MAX_MSG_SIZE = 16;  // more than enough for a modbus message
         static const int MAX_RETRIES            = 3;   // otherwise the spindle is marked 'unresponsive'
@@ -36,17 +43,21 @@ namespace Spindles {
         uint8_t _rxd_pin;
         uint8_t _rts_pin;
 
-        uint32_t _current_rpm  = 0;
-        bool     _task_running = false;
-        bool     vfd_ok        = true;
-
-        static QueueHandle_t vfd_cmd_queue;
-        static TaskHandle_t  vfd_cmdTaskHandle;
-        static void          vfd_cmd_task(void* pvParameters);
+        uint32_t _current_rpm      = 0;
+        bool     vfd_ok            = true;
+        bool     _has_rpm_feedback = false;   // get_current_rpm() is implemented
+        bool     _unresponsive     = false;   // to pop off a message once each time it becomes unresponsive
+        uint8_t  _pollidx          = 1;       // status poll that is next in turn
+        uint16_t _rx_crc           = 0xFFFF;  // CRC of the response so far, kept by complete()
+        int      _rx_crc_length    = 0;       // bytes of the response in _rx_crc
 
-        static uint16_t ModRTU_CRC(uint8_t* buf, int msg_len);
+        static uint16_t ModRTU_CRC(const uint8_t* buf, int msg_len, uint16_t crc = 0xFFFF);
 
     protected:
+        // Address the commands go to. All devices on the bus share the UART and the bus task, a
+        // command for another device sets msg[0] to its address and the response is checked against it.
+        uint8_t _modbus_id = VFD_RS485_ADDR;
+
         struct ModbusCommand {
             bool critical;  // TODO SdB: change into `uint8_t critical : 1;`: We want more flags...
 
@@ -69,6 +80,16 @@ namespace Spindles {
         virtual response_parser get_current_direction(ModbusCommand& data) { return nullptr; }
         virtual response_parser get_status_ok(ModbusCommand& data) = 0;
 
+    private:
+        void to_request(const ModbusCommand& cmd, response_parser parser, RS485::Request& request);
+
+        // RS485::Device, called by the bus task
+        bool       poll(RS485::Request& request) override;
+        TickType_t poll_period() override;
+        bool       complete(const RS485::Request& request, const uint8_t* response, int length) override;
+        bool       response(const RS485::Request& request, const uint8_t* rx_message, int read_length) override;
+        void       failed(const RS485::Request& request) override;
+
     public:
         VFD()           = default;
         VFD(const VFD&) = delete;
@@ -80,6 +101,7 @@ namespace Spindles {
         // Should hide them and use a member function.
         volatile uint32_t _min_rpm;
         volatile uint32_t _max_rpm;
+        volatile uint32_t _sync_rpm = 0;  // Spindle speed last reported by get_current_rpm()
 
         void         init();
         void         config_message();
@@ -87,6 +109,8 @@ namespace Spindles {
         SpindleState get_state();
         uint32_t     set_rpm(uint32_t rpm);
         void         stop();
+        bool         has_speed_feedback() override;
+        uint32_t     measured_rpm() override;
 
         virtual ~VFD() {}
     };
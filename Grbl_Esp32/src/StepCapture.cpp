@@ -0,0 +1,184 @@
+/*
+  StepCapture.cpp - records the time of every step pulse to check it against the planned profile
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_STEP_CAPTURE
+
+#    include <xtensa/hal.h>
+
+typedef struct {
+    uint32_t time;     // In 1 / capture_clock_hz
+    uint32_t period;   // ISR period of the segment in step timer ticks
+    uint16_t segment;  // Number of the segment, counted by the step ISR
+    uint16_t tick;     // ISR tick within the segment
+    uint8_t  bits;     // Axes stepped
+    uint8_t  amass;
+} step_event_t;
+
+volatile bool            step_capture_active = false;
+static step_event_t*     capture             = NULL;
+static uint32_t          capture_capacity;
+static uint32_t          capture_limit;
+static volatile uint32_t capture_count;
+static uint32_t          capture_clock_hz;
+
+void IRAM_ATTR step_capture_record(uint8_t bits, uint16_t segment, uint16_t tick, uint32_t period, uint8_t amass) {
+    step_event_t* event = &capture[capture_count];
+#    ifdef USE_I2S_STEPS
+    event->time = current_stepper == ST_I2S_STREAM ? i2s_out_get_stream_position() : xthal_get_ccount();
+#    else
+    event->time = xthal_get_ccount();
+#    endif
+    event->period  = period;
+    event->segment = segment;
+    event->tick    = tick;
+    event->bits    = bits;
+    event->amass   = amass;
+    if (++capture_count >= capture_limit) {
+        step_capture_active = false;
+    }
+}
+
+Error step_capture_arm(uint32_t events) {
+    if (capture == NULL) {
+        // Internal RAM, which the step ISR can write while a flash write has the cache disabled
+        size_t size      = STEP_CAPTURE_EVENTS * sizeof(step_event_t);
+        capture          = (step_event_t*)heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        capture_capacity = STEP_CAPTURE_EVENTS;
+        if (capture == NULL) {
+            grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Error, "Step capture allocation failed");
+            return Error::InvalidValue;
+        }
+    }
+    step_capture_active = false;
+    capture_count       = 0;
+    capture_limit       = MIN(events, capture_capacity);
+#    ifdef USE_I2S_STEPS
+    capture_clock_hz = current_stepper == ST_I2S_STREAM ? 1000000 / I2S_OUT_USEC_PER_PULSE : getCpuFrequencyMhz() * 1000000;
+#    else
+    capture_clock_hz = getCpuFrequencyMhz() * 1000000;
+#    endif
+    step_capture_active = capture_limit > 0;
+    return Error::Ok;
+}
+
+// Measured minus planned time between two events of one segment, in ns.
+static int32_t step_capture_error_ns(const step_event_t* from, const step_event_t* to) {
+    float measured = float(to->time - from->time) / capture_clock_hz;
+    float planned  = float(to->tick - from->tick) * from->period / F_STEPPER_TIMER;
+    return int32_t((measured - planned) * 1e9f);
+}
+
+void step_capture_get_stats(step_capture_stats_t* stats) {
+    memset(stats, 0, sizeof(step_capture_stats_t));
+    stats->events   = capture_count;
+    stats->capacity = capture_capacity;
+    stats->clock_hz = capture_clock_hz;
+    float sum_sq    = 0;
+    for (uint32_t i = 1; i < stats->events; i++) {
+        if (capture[i].segment != capture[i - 1].segment) {
+            continue;  // The planned time from the last pulse of a segment to the first of the next is not known
+        }
+        int32_t error = step_capture_error_ns(&capture[i - 1], &capture[i]);
+        if (stats->intervals == 0 || error < stats->min_ns) {
+            stats->min_ns = error;
+        }
+        if (stats->intervals == 0 || error > stats->max_ns) {
+            stats->max_ns = error;
+        }
+        stats->intervals++;
+        sum_sq += float(error) * error;
+        uint32_t bin = abs(error) / STEP_CAPTURE_JITTER_BIN_NS;
+        stats->histogram[bin < STEP_CAPTURE_JITTER_BINS ? bin : STEP_CAPTURE_JITTER_BINS - 1]++;
+    }
+    if (stats->intervals) {
+        stats->rms_ns = uint32_t(sqrtf(sum_sq / stats->intervals));
+    }
+}
+
+int step_capture_event_header(char* buf, size_t size) {
+    return snprintf(buf, size, "time_us,segment,tick,period_ticks,amass,bits");
+}
+
+int step_capture_event_line(uint32_t index, char* buf, size_t size) {
+    if (index >= capture_count) {
+        return 0;
+    }
+    const step_event_t* event = &capture[index];
+    return snprintf(buf,
+                    size,
+                    "%.3f,%u,%u,%u,%u,%u",
+                    double(event->time - capture[0].time) * 1e6 / capture_clock_hz,
+                    event->segment,
+                    event->tick,
+                    event->period,
+                    event->amass,
+                    event->bits);
+}
+
+int step_capture_segment_header(char* buf, size_t size) {
+    return snprintf(buf, size, "segment,events,ticks,period_ticks,amass,planned_mm_min,achieved_mm_min,error_pct");
+}
+
+int step_capture_segment_line(uint32_t* cursor, char* buf, size_t size) {
+    uint8_t n_axis = number_axis->get();
+    while (*cursor < capture_count) {
+        const step_event_t* first = &capture[*cursor];
+        uint32_t            last  = *cursor;
+        // The steps of the first event were taken before the measured span starts.
+        uint32_t steps[MAX_N_AXIS] = {};
+        while (last + 1 < capture_count && capture[last + 1].segment == first->segment) {
+            last++;
+            for (uint8_t axis = 0; axis < n_axis; axis++) {
+                if (bit_istrue(capture[last].bits, bit(axis))) {
+                    steps[axis]++;
+                }
+            }
+        }
+        *cursor = last + 1;
+        if (last == uint32_t(first - capture)) {
+            continue;
+        }
+        float mm = 0;
+        for (uint8_t axis = 0; axis < n_axis; axis++) {
+            float axis_mm = steps[axis] / axis_settings[axis]->steps_per_mm->get();
+            mm += axis_mm * axis_mm;
+        }
+        mm                     = sqrtf(mm);
+        uint32_t ticks         = capture[last].tick - first->tick;
+        float    planned       = float(ticks) * first->period / F_STEPPER_TIMER;
+        float    actual        = float(capture[last].time - first->time) / capture_clock_hz;
+        float    planned_feed  = planned > 0 ? mm / planned * 60.0f : 0.0f;
+        float    achieved_feed = actual > 0 ? mm / actual * 60.0f : 0.0f;
+        return snprintf(buf,
+                        size,
+                        "%u,%u,%u,%u,%u,%.2f,%.2f,%.3f",
+                        first->segment,
+                        last + 1 - uint32_t(first - capture),
+                        ticks,
+                        first->period,
+                        first->amass,
+                        planned_feed,
+                        achieved_feed,
+                        planned_feed > 0 ? (achieved_feed - planned_feed) * 100.0f / planned_feed : 0.0f);
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,80 @@
+#pragma once
+
+/*
+  StepCapture.h - records the time of every step pulse to check it against the planned profile
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  $Steps/Capture=<n> arms a capture of the next n step events, an event being an ISR tick that pulses
+  at least one axis. Each event keeps the axes it stepped, the segment and the ISR tick within the
+  segment that traced it, and the time the pulse went out: the CPU cycle counter for timed and RMT
+  steps, the position in the sample stream for I2S streaming, which is what the DMA puts on the pins.
+
+  Two events of the same segment are planned to lie a whole number of ISR periods apart. The
+  difference to the measured interval is the jitter, reported by $Steps/Capture as minimum, maximum,
+  RMS and a histogram of its size. $Steps/Capture/Segments compares the feed rate each segment was
+  planned for with the one its pulses achieved, and $Steps/Capture/Events sends the raw events as CSV.
+
+  The events are kept in internal RAM, never in PSRAM. Flash writes, NVS ones included, disable the
+  cache PSRAM is read through, and the step ISR must be able to record an event at any time.
+*/
+
+#include "Grbl.h"
+
+#ifndef STEP_CAPTURE_EVENTS
+#    define STEP_CAPTURE_EVENTS 2048  // 16 bytes each
+#endif
+#ifndef STEP_CAPTURE_JITTER_BINS
+#    define STEP_CAPTURE_JITTER_BINS 12
+#endif
+#ifndef STEP_CAPTURE_JITTER_BIN_NS
+#    define STEP_CAPTURE_JITTER_BIN_NS 500
+#endif
+
+// Set while events are recorded. The step ISR checks it before calling step_capture_record().
+extern volatile bool step_capture_active;
+
+// Records the step bits that just went out, with the segment and the ISR tick that traced them, the
+// ISR period of that segment in step timer ticks and its AMASS level. Called by the step ISR.
+void step_capture_record(uint8_t bits, uint16_t segment, uint16_t tick, uint32_t period, uint8_t amass);
+
+// Discards the last capture and records the next events step events, at most the buffer size.
+Error step_capture_arm(uint32_t events);
+
+typedef struct {
+    uint32_t events;     // Events recorded
+    uint32_t capacity;   // Events the buffer holds
+    uint32_t clock_hz;   // Rate of the event times
+    uint32_t intervals;  // Event pairs of one segment, the jitter is measured over
+    int32_t  min_ns;     // Measured minus planned interval
+    int32_t  max_ns;
+    uint32_t rms_ns;
+    uint32_t histogram[STEP_CAPTURE_JITTER_BINS];  // By the size of the jitter, the last bin also the larger ones
+} step_capture_stats_t;
+
+void step_capture_get_stats(step_capture_stats_t* stats);
+
+// CSV header lines, without line ends. Return the length.
+int step_capture_event_header(char* buf, size_t size);
+int step_capture_segment_header(char* buf, size_t size);
+
+// The CSV line of an event. Returns the length, 0 past the last event.
+int step_capture_event_line(uint32_t index, char* buf, size_t size);
+
+// The CSV line of the segment whose first event is at *cursor, which is advanced to the next one.
+// Segments with a single event are skipped. Returns the length, 0 past the last segment.
+int step_capture_segment_line(uint32_t* cursor, char* buf, size_t size);
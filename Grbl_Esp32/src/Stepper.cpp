@@ -24,6 +24,10 @@
 */
 
 #include "Grbl.h"
+#include "Spindles/PWMSpindle.h"
+
+#include <xtensa/hal.h>
+#include <soc/gpio_struct.h>
 
 // Stores the planner block Bresenham algorithm execution data for the segments in the segment
 // buffer. Normally, this buffer is partially in-use, but, for the worst case scenario, it will
@@ -36,6 +40,20 @@ typedef struct {
     uint32_t step_event_count;
     uint8_t  direction_bits;
     uint8_t  is_pwm_rate_adjusted;  // Tracks motions that require constant laser power/rate
+#ifdef ENABLE_LASER_RASTER
+    raster_line_t* raster;  // Scanline of the block, or NULL
+#endif
+#ifdef ENABLE_SPINDLE_SYNC
+    bool sync_start;  // First block of a spindle synchronized chain
+#endif
+#ifdef SYNC_USER_OUTPUTS
+    uint8_t output_events;  // Synchronized output events to fire when the block starts
+#endif
+#ifdef SPINDLE_STATE_IN_PLANNER
+    bool         apply_state;  // Switch the spindle and coolant to the state below when the block starts
+    SpindleState spindle;
+    CoolantState coolant;
+#endif
 } st_block_t;
 static st_block_t st_block_buffer[SEGMENT_BUFFER_SIZE - 1];
 
@@ -43,24 +61,34 @@ static st_block_t st_block_buffer[SEGMENT_BUFFER_SIZE - 1];
 // algorithm to execute, which are "checked-out" incrementally from the first block in the
 // planner buffer. Once "checked-out", the steps in the segments buffer cannot be modified by
 // the planner, where the remaining planner block steps still can.
+// NOTE: The 32-bit fields come first and the narrow ones are packed at the end, so a segment stays
+// 16 bytes (4 more each with LASER_POWER_RAMP and ENABLE_LASER_PPI) with no padding.
 typedef struct {
-    uint16_t n_step;           // Number of step events to be executed for this segment
-    uint16_t cycles_per_tick;  // Step distance traveled per ISR tick, aka step rate.
-    uint8_t  st_block_index;   // Stepper block data index. Uses this information to execute this segment.
-#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-    uint8_t amass_level;  // Indicates AMASS level for the ISR to execute this segment
-#else
-    uint8_t prescaler;  // Without AMASS, a prescaler is required to adjust for slow timing.
+    uint32_t n_step;           // Number of step events to be executed for this segment
+    uint32_t cycles_per_tick;  // Step distance traveled per ISR tick, aka step rate. Full 32-bit timer period.
+    uint32_t spindle_duty;     // Precomputed output duty for spindles with a fast output (lasers)
+#ifdef LASER_POWER_RAMP
+    int32_t spindle_duty_step;  // Duty change per ISR tick, in 1/2^SPINDLE_DUTY_SHIFT. Zero for a constant output.
+#endif
+#ifdef ENABLE_LASER_PPI
+    uint32_t ppi_step;  // Laser pulses travelled per ISR tick, in 1/2^32. Zero with the laser off.
 #endif
-    uint16_t spindle_rpm;  // TODO get rid of this.
+    uint16_t spindle_rpm;     // TODO get rid of this.
+    uint8_t  st_block_index;  // Stepper block data index. Uses this information to execute this segment.
+    uint8_t  amass_level;     // Indicates AMASS level for the ISR to execute this segment. Zero without AMASS.
 } segment_t;
 static segment_t segment_buffer[SEGMENT_BUFFER_SIZE];
 
+#ifdef LASER_POWER_RAMP
+// Fraction bits of the ramped duty. 16 bit PWM duties still fit in 32 bits.
+const int SPINDLE_DUTY_SHIFT = 15;
+#endif
+
 // Stepper ISR data struct. Contains the running data for the main stepper ISR.
 typedef struct {
     // Used by the bresenham line algorithm
 
-    uint32_t counter_x, counter_y, counter_z, counter_a, counter_b, counter_c;  // Counter variables for the bresenham line tracer
+    uint32_t counter[MAX_N_AXIS];  // Counter variables for the bresenham line tracer
 
 #ifdef STEP_PULSE_DELAY
     uint8_t step_bits;  // Stores out_bits output to complete the step pulse delay
@@ -70,34 +98,161 @@ typedef struct {
     uint8_t step_pulse_time;  // Step pulse reset time after step rise
     uint8_t step_outbits;     // The next stepping-bits to be output
     uint8_t dir_outbits;
+    bool    dir_pending;  // dir_outbits changed, the next output writes them to the pins
+    bool    dir_setup;    // The pins were just written, the steps of this output wait for them
 #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-    uint32_t steps[MAX_N_AXIS];
+    uint32_t steps[MAX_N_AXIS];  // Block steps scaled to amass_level
+    uint8_t  amass_level;        // Level steps[] was scaled to, 0xff when it must be recomputed
 #endif
 
-    uint16_t    step_count;        // Steps remaining in line segment motion
+    uint32_t    step_count;        // Steps remaining in line segment motion
     uint8_t     exec_block_index;  // Tracks the current st_block index. Change indicates new block.
     st_block_t* exec_block;        // Pointer to the block data for the segment being executed
     segment_t*  exec_segment;      // Pointer to the segment being executed
+#ifdef LASER_POWER_RAMP
+    uint32_t spindle_duty;  // Ramped fast output duty, in 1/2^SPINDLE_DUTY_SHIFT
+#endif
+#ifdef ENABLE_LASER_PPI
+    uint32_t ppi_phase;  // Progress toward the next laser pulse, in 1/2^32
+#endif
+#ifdef ENABLE_LASER_RASTER
+    raster_line_t* raster;        // Scanline being executed, or NULL once its last step is out
+    uint32_t       raster_steps;  // Raster axis steps done
+    uint32_t       raster_phase;  // Progress into the current pixel, in 1/2^RASTER_PITCH_SHIFT steps
+    uint16_t       raster_pixel;
+#endif
+#ifdef ENABLE_STEP_CAPTURE
+    uint16_t capture_segment;  // Segments loaded, numbers them for step_capture_record()
+    uint16_t capture_tick;     // ISR ticks traced in the segment
+    uint32_t capture_period;   // ISR period of the segment in step timer ticks
+    uint8_t  capture_amass;
+#endif
+#if defined(USE_I2S_STEPS) && defined(I2S_PROBE_TRUNCATE)
+    bool   i2s_tracking;     // i2s_buffer_position[] holds the current stream
+    int8_t i2s_fill_buffer;  // DMA buffer the last step went into
+    bool   probe_armed;      // A probe cycle was stepping
+#endif
+#ifdef STEP_BURST
+    uint8_t  burst_axes;      // Axes of the block that step on every tick, 0 if another axis steps too
+    uint16_t burst_steps;     // Steps of the run traced for the next output, 0 for a single step
+    uint32_t burst_period;    // Step period of that run in step timer ticks
+    uint32_t burst_extra;     // Ticks the run being output adds to the period, for its steps after the first
+    uint32_t timer_period;    // Period last written to the step timer
+    uint32_t segment_period;  // cycles_per_tick of the segment it was written for
+#endif
+#ifdef USE_MCPWM_STEPS
+    uint32_t run_wake;    // Ticks from the output of the run to the ISR that stops it, 0 if none
+    uint32_t run_rest;    // Ticks from that ISR to the next output, 0 unless the next ISR stops the run
+    uint32_t run_period;  // Step period of the run
+    uint8_t  run_axes;    // Axes stepping in it
+    uint8_t  run_dir;     // And their direction bits
+#endif
+#ifdef BACKLASH_COMPENSATION
+    uint8_t  block_axes;                  // Axes the executing block steps
+    uint8_t  backlash_axes;               // Axes with backlash left to take up
+    uint32_t backlash[MAX_N_AXIS];        // Steps left to take up
+    uint32_t backlash_phase[MAX_N_AXIS];  // Step timer ticks since the last take-up step
+#endif
+#ifdef AXIS_ENCODER_CORRECTION
+    uint32_t correction_phase[MAX_N_AXIS];  // Step timer ticks since the last correction step
+#endif
+#ifdef ENABLE_AUX_STREAM
+    uint32_t aux_ticks;         // Timer periods each tick of the segment is split into for the auxiliary axis
+    uint32_t aux_tick;          // Of those, the ones left before the next tick of the segment
+    uint32_t aux_period;        // Step timer ticks of each but the first
+    uint32_t aux_first;         // And of the first, which takes the rest of the division
+    uint32_t aux_timer;         // Period last written to the step timer
+    bool     aux_only;          // The segment buffer is empty, the ISR runs for the auxiliary axis alone
+    bool     aux_stop_pending;  // The cycle stop of a feed hold waits for the auxiliary axis to stop
+#endif
 } stepper_t;
 static stepper_t st;
 
+#ifdef AXIS_ENCODER_CORRECTION
+// Steps the axis encoders found missing, negative for the - direction, and the axes that have any. Set by
+// st_set_correction() and counted down by the step ISR. Outside of st, as st_reset() does not move the mechanics.
+static volatile int32_t  correction_steps[MAX_N_AXIS];
+static volatile uint8_t  correction_axes = 0;
+static volatile uint32_t correction_count;
+#endif
+
+// Settings used by the stepper ISR, snapshotted by st_update_context() so the ISR does not have to go
+// through the settings objects on every tick. Settings cannot change while a cycle is running.
+typedef struct {
+    uint32_t generation;  // motion_config.generation the fields below were copied from
+    uint8_t  dir_invert_mask;
+    uint8_t  step_invert_mask;
+    uint32_t pulse_microseconds;
+    uint32_t dir_delay_microseconds;
+#ifdef BACKLASH_COMPENSATION
+    uint32_t backlash_steps[MAX_N_AXIS];
+    uint32_t backlash_ticks[MAX_N_AXIS];  // Shortest step timer period between take-up steps
+#endif
+#ifdef AXIS_ENCODER_CORRECTION
+    uint32_t correction_ticks[MAX_N_AXIS];  // Shortest step timer period between correction steps
+#endif
+    // Spindle whose output the ISR writes directly, or nullptr to use spindle->set_rpm().
+    Spindles::PWM* fast_spindle;
+} st_context_t;
+static DRAM_ATTR st_context_t st_ctx;
+static void                   st_update_context();
+
 // Step segment ring buffer indices
 static volatile uint8_t segment_buffer_tail;
-static uint8_t          segment_buffer_head;
+static volatile uint8_t segment_buffer_head;
 static uint8_t          segment_next_head;
 
+// Motors have been told the machine is cruising. Only changed by the segment prep.
+static bool st_cruising = false;
+
+// Number of times the segment buffer ran dry while the planner still had motion queued.
+static volatile uint32_t segment_underruns;
+
+// Task notified when a segment that moves one of segment_event_axes is loaded. See st_set_segment_event().
+static volatile TaskHandle_t segment_event_task = NULL;
+static volatile uint8_t      segment_event_axes = 0;
+
+#ifdef USE_STEPPER_PREP_TASK
+// Segment preparation task. The stepper ISR notifies it when the segment buffer runs low. The mutex
+// serializes st_prep_buffer() with the planner and protocol code that modify the same blocks.
+static TaskHandle_t      stepperPrepTaskHandle = 0;
+static SemaphoreHandle_t stepperPrepMutex      = NULL;
+static void              stepperPrepTask(void* pvParameters);
+#endif
+
 // Used to avoid ISR nesting of the "Stepper Driver Interrupt". Should never occur though.
 static volatile uint8_t busy;
 
+#ifdef ENABLE_AUX_STREAM
+// The step timer runs, between st_wake_up() and st_go_idle()
+static volatile bool stepper_running = false;
+#endif
+
 // Pointers for the step segment being prepped from the planner buffer. Accessed only by the
 // main program. Pointers may be planning segments or planner blocks ahead of what being executed.
 static plan_block_t* pl_block;       // Pointer to the planner block being prepped
 static st_block_t*   st_prep_block;  // Pointer to the stepper block data being prepped
 
-// esp32 work around for diable in main loop
-uint64_t stepper_idle_counter;  // used to count down until time to disable stepper drivers
+// Single precision copies of the segment constants. The FPU of the ESP32 only does floats, so a
+// double in the prep math, even a literal, turns it into software floating point calls.
+static const float dt_segment              = DT_SEGMENT;
+static const float req_mm_increment_scalar = REQ_MM_INCREMENT_SCALAR;
+
+// Time the drivers are disabled by $1, for IdlePower
+uint64_t stepper_idle_counter;
 bool     stepper_idle;
 
+// A one-shot timer ends the idle lock. On Trinamic drivers it first lowers the hold current after
+// TRINAMIC_IDLE_HOLD_MS, then disables the drivers after $1 ms. The mutex keeps it from acting after
+// st_wake_up() has enabled them for the next motion.
+enum class IdleStage : uint8_t {
+    Hold,
+    Disable,
+};
+static esp_timer_handle_t stepper_idle_timer = NULL;
+static SemaphoreHandle_t  stepper_idle_mutex = NULL;
+static volatile IdleStage stepper_idle_stage;
+
 // Segment preparation data struct. Contains all the necessary information to compute new segments
 // based on the current executing planner block.
 typedef struct {
@@ -127,7 +282,55 @@ typedef struct {
 
     float inv_rate;  // Used by PWM laser mode to speed up segment calculations.
     //uint16_t current_spindle_pwm;  // todo remove
-    float current_spindle_rpm;
+
+    uint8_t cruise_segments;  // Consecutive cruise segments prepped, for motors_set_cruise()
+    float    current_spindle_rpm;
+    uint32_t current_spindle_duty;
+
+#ifdef USE_KINEMATICS
+    int32_t joint_steps[MAX_N_AXIS];  // Joint position at the end of the last prepped segment
+#endif
+#if defined(USE_KINEMATICS) || defined(INPUT_SHAPING) || defined(JOG_VELOCITY_MODE)
+    bool st_block_used;  // st_prep_block already belongs to a prepped segment
+#endif
+#ifdef JOG_VELOCITY_MODE
+    bool    jog_active;                // The segments come from the velocity jog, not from the planner
+    bool    jog_soft_limits;           // Stop before the soft limits
+    float   jog_target[MAX_N_AXIS];    // Commanded axis velocities (mm/min)
+    float   jog_velocity[MAX_N_AXIS];  // Axis velocities at the end of the last prepped segment (mm/min)
+    int32_t jog_steps[MAX_N_AXIS];     // Axis position at the end of the last prepped segment (steps)
+    float   jog_fraction[MAX_N_AXIS];  // Part of a step the axis position is ahead of jog_steps
+    int64_t jog_deadline;              // esp_timer_get_time() the velocity lapses at without a keep-alive
+#endif
+#ifdef INPUT_SHAPING
+    bool    shaping;                       // The block is shaped. Not for system motions.
+    bool    shaper_moving;                 // The shaped motion has not caught up with the command yet
+    float   shaper_settle;                 // Time the end of the command is still held for it (min)
+    int32_t shaper_block_end[MAX_N_AXIS];  // Commanded position at the end of the block (steps)
+    int32_t shaper_steps[MAX_N_AXIS];      // Shaped position at the end of the last prepped segment
+#endif
+#ifdef ENABLE_SPINDLE_SYNC
+    bool  sync_active;  // Segments follow the spindle. Cleared by a feed hold until the next chain.
+    float sync_time;    // Execution time of the chain at the end of the last prepped segment (min)
+    float sync_revs;    // Spindle revolutions the prepped distance of the chain stands for
+#endif
+#ifdef ENABLE_SIMULATOR
+    bool depth_limited;  // The exit speed of the block is held down by the planner depth. Simulation only.
+#endif
+#ifdef JERK_LIMITED_PROFILE
+    // S-curve of the running acceleration or deceleration ramp, see st_scurve_begin()
+    bool    scurve_valid;     // Cleared when a new block is loaded
+    uint8_t scurve_ramp;      // Ramp type it was built for
+    float   scurve_start_mm;  // Ramp start and end, measured from end of block (mm)
+    float   scurve_end_mm;
+    float   scurve_v0;        // Entry and exit speed of the ramp (mm/min)
+    float   scurve_v1;
+    float   scurve_time;      // Duration of the ramp (min)
+    float   scurve_tj;        // Duration of the jerk phases at either end (min)
+    float   scurve_accel;     // Signed acceleration between the jerk phases (mm/min^2)
+    float   scurve_jerk;      // Signed jerk of the first phase (mm/min^3)
+    float   scurve_t;         // Time into the ramp at the end of the last prepped segment (min)
+#endif
 
 } st_prep_t;
 static st_prep_t prep;
@@ -137,11 +340,14 @@ const char* stepper_names[] = {
     "RMT Steps",
     "I2S Steps, Stream",
     "I2S Steps, Static",
+    "MCPWM Steps",
 };
 
 #ifndef DEFAULT_STEPPER
 #    if defined(USE_I2S_STEPS)
 #        define DEFAULT_STEPPER ST_I2S_STREAM
+#    elif defined(USE_MCPWM_STEPS)
+#        define DEFAULT_STEPPER ST_MCPWM
 #    elif defined(USE_RMT_STEPS)
 #        define DEFAULT_STEPPER ST_RMT
 #    else
@@ -206,11 +412,66 @@ stepper_id_t current_stepper = DEFAULT_STEPPER;
 
 */
 #ifdef USE_RMT_STEPS
+// RMT channels to start for each combination of step bits, one table per squaring mode. Each entry is a
+// bit mask of RMT channels, so the ISR kicks every pulse of a step event in one short loop.
+static DRAM_ATTR uint8_t rmt_start_bits[3][1 << MAX_N_AXIS];
+static bool              rmt_start_bits_built = false;
+
+static void                  stepper_rmt_build_table();
 inline IRAM_ATTR static void stepperRMT_Outputs();
+
+// Channels whose item 0 waits out the direction setup time instead of RMT_STEP_DELAY_TICKS
+static uint8_t rmt_delayed_channels = 0;
+
+#    ifdef RMT_STEP_BURST
+// Channels whose RMT memory holds a run, item 1 has to be made an end marker again for a single step.
+// Outside of st, st_reset() must not forget them.
+static uint8_t               rmt_burst_channels = 0;
+inline IRAM_ATTR static void stepperRMT_Burst();
+#    endif
+#endif
+
+#ifdef USE_MCPWM_STEPS
+inline IRAM_ATTR static void stepperMCPWM_Outputs();
+inline IRAM_ATTR static void stepperMCPWM_Burst();
+inline IRAM_ATTR static void stepperMCPWM_Stop();
+#endif
+
+#ifdef STEP_BURST
+static st_burst_stats_t burst_stats;
 #endif
 
 static void stepper_pulse_func();
 
+#ifdef HOMING_PARALLEL_SQUARING
+// Axes whose primary or ganged motor is held still, indexed by PRIMARY_MOTOR and GANGED_MOTOR
+static volatile uint8_t ganged_motor_lock[MAX_GANGED] = { 0, 0 };
+#    ifdef USE_RMT_STEPS
+static volatile uint8_t rmt_locked_channels = 0;  // RMT channels of the held motors
+#    endif
+
+#endif
+
+#ifdef ENABLE_STEPPER_ISR_PROFILING
+static st_isr_profile_t isr_profile;
+static StIsrWork        isr_work;    // Set by stepper_pulse_func() for the current invocation
+static uint8_t          isr_amass;   // AMASS level of the segment the invocation stepped
+static uint16_t         isr_period;  // Timer period of that segment
+
+static inline void IRAM_ATTR isr_profile_add(st_isr_cycles_t* profile, uint32_t cycles) {
+    if (profile->events == 0 || cycles < profile->min_cycles) {
+        profile->min_cycles = cycles;
+    }
+    if (cycles > profile->max_cycles) {
+        profile->max_cycles = cycles;
+    }
+    profile->events++;
+    profile->cycles += cycles;
+    uint32_t bin = cycles / STEPPER_ISR_PROFILE_BIN_CYCLES;
+    profile->histogram[bin < STEPPER_ISR_PROFILE_BINS ? bin : STEPPER_ISR_PROFILE_BINS - 1]++;
+}
+#endif
+
 // TODO: Replace direct updating of the int32 position counters in the ISR somehow. Perhaps use smaller
 // int8 variables and update position counters only when a segment completes. This can get complicated
 // with probing and homing cycles that require true real-time positions.
@@ -223,12 +484,446 @@ void IRAM_ATTR onStepperDriverTimer(
     }
     busy = true;
 
+#ifdef ENABLE_STEPPER_ISR_PROFILING
+    uint32_t start_cycles = xthal_get_ccount();
+    isr_work              = StIsrWork::Step;
+    if (st.exec_segment) {
+        isr_period = st.exec_segment->cycles_per_tick;
+#    ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+        isr_amass = st.exec_segment->amass_level;
+#    endif
+    }
     stepper_pulse_func();
+    uint32_t cycles = xthal_get_ccount() - start_cycles;
+    isr_profile_add(&isr_profile.all, cycles);
+    isr_profile_add(&isr_profile.work[int(isr_work)], cycles);
+    isr_profile_add(&isr_profile.amass[isr_amass], cycles);
+    // cycles / period > worst_cycles / worst_period, without dividing
+    if (isr_period && uint64_t(cycles) * isr_profile.worst_load_ticks >= uint64_t(isr_profile.worst_load_cycles) * isr_period) {
+        isr_profile.worst_load_cycles = cycles;
+        isr_profile.worst_load_ticks  = isr_period;
+    }
+#else
+    stepper_pulse_func();
+#endif
 
     TIMERG0.hw_timer[STEP_TIMER_INDEX].config.alarm_en = TIMER_ALARM_EN;
     busy                                               = false;
 }
 
+// Traces the Bresenham line for the first N axes. Instantiated for the axis count of the machine, so
+// the per-axis loop can be fully unrolled and the step ISR does not branch on the number of axes.
+// Nor does it branch on whether an axis steps: the step is a 0 or 1 that masks the counter wrap and
+// the position change, so every tick costs the same for a given axis count.
+template <int N>
+static inline void IRAM_ATTR stepper_trace_axes() {
+    static_assert(N <= MAX_N_AXIS, "Axis count exceeds MAX_N_AXIS");
+    const uint32_t event_count    = st.exec_block->step_event_count;
+    const uint32_t direction_bits = st.exec_block->direction_bits;
+    uint32_t       step_bits      = 0;
+    for (int axis = 0; axis < N; axis++) {
+#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+        uint32_t counter = st.counter[axis] + st.steps[axis];
+#else
+        uint32_t counter = st.counter[axis] + st.exec_block->steps[axis];
+#endif
+        uint32_t step    = counter > event_count;
+        int32_t  reverse = -int32_t((direction_bits >> axis) & 1);  // -1 when moving negative, else 0
+        st.counter[axis] = counter - (event_count & -step);
+        step_bits |= step << axis;
+        sys_position[axis] += (int32_t(step) ^ reverse) - reverse;  // step negated when reverse
+    }
+    st.step_outbits |= step_bits;
+}
+
+// Traces one ISR tick for the axes of the machine.
+static inline void IRAM_ATTR stepper_trace() {
+    stepper_trace_axes<MachineTraits::n_axis>();
+}
+
+#ifdef STEP_BURST
+// True if the next ticks of the segment can go out as one run generated by the step generator. Every moving
+// axis of the block steps on every tick, so tracing the ticks one by one would step the same axes each
+// time and leave the Bresenham counters as they are. Probing, homing, laser rasters and ramps, step
+// capture and motors that step themselves need to see each step.
+static inline bool IRAM_ATTR stepper_burst_ready() {
+    if (!st.burst_axes || st.step_count < 2 || motor_class_steps) {
+        return false;
+    }
+#    ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+    if (st.exec_segment->amass_level) {
+        return false;
+    }
+#    endif
+#    ifdef ENABLE_LASER_RASTER
+    if (st.raster) {
+        return false;
+    }
+#    endif
+#    ifdef LASER_POWER_RAMP
+    if (st.exec_segment->spindle_duty_step) {
+        return false;
+    }
+#    endif
+#    ifdef ENABLE_LASER_PPI
+    if (st.exec_segment->ppi_step) {
+        return false;
+    }
+#    endif
+#    ifdef ENABLE_STEP_CAPTURE
+    if (step_capture_active) {
+        return false;
+    }
+#    endif
+    if (sys.state == State::Homing || sys_probe_state == PROBE_ACTIVE) {
+        return false;
+    }
+    if (st.dir_pending) {
+        return false;  // The first step in a new direction may wait for the direction setup time
+    }
+#    ifdef BACKLASH_COMPENSATION
+    if (st.backlash_axes) {
+        return false;
+    }
+#    endif
+#    ifdef AXIS_ENCODER_CORRECTION
+    if (correction_axes) {
+        return false;
+    }
+#    endif
+    uint32_t pulse = st_ctx.pulse_microseconds * TICKS_PER_MICROSECOND;
+#    ifdef USE_MCPWM_STEPS
+    // The period must fit the timer and end after the pulse
+    uint32_t period = st.exec_segment->cycles_per_tick;
+    return period > MCPWM_STEP_DELAY_TICKS + pulse + TICKS_PER_MICROSECOND && period <= MCPWM_MAX_PERIOD_TICKS;
+#    else
+    // The space between the pulses must fit an RMT item
+    uint32_t space = st.exec_segment->cycles_per_tick - pulse;
+    return st.exec_segment->cycles_per_tick > pulse + TICKS_PER_MICROSECOND && space <= RMT_ITEM_MAX_TICKS;
+#    endif
+}
+
+// Traces up to STEP_BURST_MAX_STEPS ticks at once. The position counts all of the run, which is output as
+// one step by the next invocation, and the caller counts its first tick.
+static inline void IRAM_ATTR stepper_trace_burst() {
+    uint16_t n = st.step_count < STEP_BURST_MAX_STEPS ? st.step_count : STEP_BURST_MAX_STEPS;
+    st.step_outbits = st.burst_axes;
+    for (int axis = 0; axis < MAX_N_AXIS; axis++) {
+        if (st.burst_axes & bit(axis)) {
+            if (st.exec_block->direction_bits & bit(axis)) {
+                sys_position[axis] -= n;
+            } else {
+                sys_position[axis] += n;
+            }
+        }
+    }
+    st.step_count -= n - 1;
+    st.burst_steps  = n;
+    st.burst_period = st.exec_segment->cycles_per_tick;
+    burst_stats.runs++;
+    burst_stats.steps += n;
+}
+#endif
+
+#ifdef BACKLASH_COMPENSATION
+// The direction each axis moved last, for the axes that have moved. Outside of st, as st_reset() does not
+// move the mechanics.
+static uint8_t backlash_known = 0;
+static uint8_t backlash_dir   = 0;
+
+// Starts taking up the backlash of the axes the new block reverses.
+static inline void IRAM_ATTR stepper_backlash_block(uint8_t moving) {
+    uint8_t direction_bits = st.exec_block->direction_bits;
+    uint8_t reversed       = (direction_bits ^ backlash_dir) & moving & backlash_known;
+    backlash_dir           = (backlash_dir & ~moving) | (direction_bits & moving);
+    backlash_known         = backlash_known | moving;
+    st.block_axes          = moving;
+    if (sys.state == State::Homing) {
+        st.backlash_axes = 0;  // The switches are always approached the same way
+        memset(st.backlash, 0, sizeof(st.backlash));
+        return;
+    }
+    for (int axis = 0; axis < MAX_N_AXIS; axis++) {
+        if (reversed & bit(axis)) {
+            // Reversing again before the take-up is done only gives back what was taken up
+            uint32_t full           = st_ctx.backlash_steps[axis];
+            st.backlash[axis]       = full > st.backlash[axis] ? full - st.backlash[axis] : 0;
+            st.backlash_phase[axis] = 0;
+            if (st.backlash[axis]) {
+                st.backlash_axes |= bit(axis);
+            } else {
+                st.backlash_axes &= ~bit(axis);
+            }
+        }
+    }
+}
+
+// Adds take-up steps to the axes that do not step on this tick, one at most and no sooner than
+// backlash_ticks after the previous one. They go in the direction of the block and are not counted in
+// sys_position. Axes the block does not move keep theirs until it moves again.
+static inline void IRAM_ATTR stepper_backlash_step() {
+    uint8_t axes = st.backlash_axes & st.block_axes;
+    for (int axis = 0; axis < MAX_N_AXIS; axis++) {
+        if (!(axes & bit(axis))) {
+            continue;
+        }
+        if (st.backlash_phase[axis] < st_ctx.backlash_ticks[axis]) {
+            st.backlash_phase[axis] += st.exec_segment->cycles_per_tick;
+        }
+        if (!(st.step_outbits & bit(axis)) && st.backlash_phase[axis] >= st_ctx.backlash_ticks[axis]) {
+            st.step_outbits |= bit(axis);
+            st.backlash_phase[axis] = 0;
+            if (--st.backlash[axis] == 0) {
+                st.backlash_axes &= ~bit(axis);
+            }
+        }
+    }
+}
+#endif
+
+#ifdef AXIS_ENCODER_CORRECTION
+// Adds correction steps to the axes the block moves in the direction of their correction and that do not
+// step on this tick, one at most and no sooner than correction_ticks after the previous one. Like the
+// backlash take-up they are not counted in sys_position, which stays the commanded position.
+static inline void IRAM_ATTR stepper_correction_step() {
+    for (int axis = 0; axis < MAX_N_AXIS; axis++) {
+        int32_t steps = correction_steps[axis];
+        if (steps == 0 || st.exec_block->steps[axis] == 0) {
+            continue;
+        }
+        if ((steps < 0) != bool(st.exec_block->direction_bits & bit(axis))) {
+            continue;  // Kept until the axis moves that way, or the encoder finds it caught up
+        }
+        if (st.correction_phase[axis] < st_ctx.correction_ticks[axis]) {
+            st.correction_phase[axis] += st.exec_segment->cycles_per_tick;
+        }
+        if (!(st.step_outbits & bit(axis)) && st.correction_phase[axis] >= st_ctx.correction_ticks[axis]) {
+            st.step_outbits |= bit(axis);
+            st.correction_phase[axis] = 0;
+            steps += steps < 0 ? 1 : -1;
+            correction_steps[axis] = steps;
+            correction_count       = correction_count + 1;
+            if (steps == 0) {
+                correction_axes = correction_axes & ~bit(axis);
+            }
+        }
+    }
+}
+
+void st_set_correction(uint8_t axis, int32_t steps) {
+    correction_steps[axis] = steps;
+    if (steps) {
+        correction_axes = correction_axes | bit(axis);
+    } else {
+        correction_axes = correction_axes & ~bit(axis);
+    }
+}
+
+uint32_t st_get_correction_count() {
+    return correction_count;
+}
+#endif
+
+// Wakes the segment event task if the segment just loaded moves one of its axes.
+static inline void IRAM_ATTR stepper_segment_event() {
+    for (int axis = 0; axis < MAX_N_AXIS; axis++) {
+        if ((segment_event_axes & bit(axis)) && st.exec_block->steps[axis]) {
+            BaseType_t higherPriorityTaskWoken = pdFALSE;
+            vTaskNotifyGiveFromISR(segment_event_task, &higherPriorityTaskWoken);
+            if (higherPriorityTaskWoken && xPortInIsrContext()) {
+                portYIELD_FROM_ISR();
+            }
+            return;
+        }
+    }
+}
+
+#ifdef ENABLE_LASER_RASTER
+// Advances the scanline by one raster axis step and writes the power of the pixel it enters. The last
+// step switches the output off and frees the line.
+static inline void IRAM_ATTR stepper_raster_step() {
+    raster_line_t* line = st.raster;
+    if (++st.raster_steps >= line->steps) {
+        st_ctx.fast_spindle->write_duty_isr(st_ctx.fast_spindle->off_duty());
+        raster_release(line);
+        st.raster = NULL;
+        return;
+    }
+    st.raster_phase += 1UL << RASTER_PITCH_SHIFT;
+    if (st.raster_phase < line->pitch) {
+        return;
+    }
+    while (st.raster_phase >= line->pitch && st.raster_pixel + 1 < line->n_pixels) {
+        st.raster_phase -= line->pitch;
+        st.raster_pixel++;
+    }
+    st_ctx.fast_spindle->write_duty_isr(line->duty[st.raster_pixel]);
+}
+#endif
+
+#if defined(USE_I2S_STEPS) && defined(I2S_PROBE_TRUNCATE)
+// Machine position at the start of each I2S DMA buffer, so a probe hit can drop the buffers the DMA has
+// not played yet and still know where the motors stopped.
+static int32_t i2s_buffer_position[I2S_OUT_DMABUF_COUNT][MAX_N_AXIS];
+
+// Records the position at the start of the DMA buffer the step stream is filling, when that buffer changes.
+static inline void IRAM_ATTR stepper_i2s_track_buffer() {
+    int8_t buffer = i2s_out_get_fill_index();
+    if (st.i2s_tracking && buffer == st.i2s_fill_buffer) {
+        return;
+    }
+    // sys_position already counts the steps going out in this invocation, and they go into this buffer.
+    int32_t position[MAX_N_AXIS];
+    uint8_t direction_bits = st.dir_outbits ^ st_ctx.dir_invert_mask;
+    for (uint8_t axis = 0; axis < MAX_N_AXIS; axis++) {
+        position[axis] = sys_position[axis];
+        if (st.step_outbits & bit(axis)) {
+            position[axis] += (direction_bits & bit(axis)) ? 1 : -1;
+        }
+    }
+    // Buffers passed without a step start where this one does. The first step of a stream sets them all.
+    int8_t next = st.i2s_tracking ? st.i2s_fill_buffer : buffer;
+    do {
+        next = (next + 1) % I2S_OUT_DMABUF_COUNT;
+        memcpy(i2s_buffer_position[next], position, sizeof(position));
+    } while (next != buffer);
+    st.i2s_tracking    = true;
+    st.i2s_fill_buffer = buffer;
+}
+
+// On a probe hit, drops the step samples the DMA has not played yet and ends the motion there, instead of
+// running out the queued buffers and the deceleration. The probe position is where the motors stop, at
+// most I2S_OUT_TRUNCATE_MARGIN buffers past the hit. Returns true if the motion was ended.
+static bool IRAM_ATTR stepper_i2s_probe_stop() {
+    stepper_i2s_track_buffer();
+    if (sys_probe_state == PROBE_ACTIVE) {
+        st.probe_armed = true;
+        return false;
+    }
+    if (!st.probe_armed) {
+        return false;
+    }
+    st.probe_armed = false;
+    int first      = i2s_out_truncate();
+    if (first < 0) {
+        return false;  // Too close to the DMA, the hit is handled as without I2S
+    }
+    system_position_write_begin();
+    memcpy(sys_position, i2s_buffer_position[first], sizeof(sys_position));
+    system_position_write_end();
+    memcpy(sys_probe_position, sys_position, sizeof(sys_position));
+    st_go_idle();
+    cycle_stop = true;
+    return true;
+}
+#endif
+
+// Counts an underrun when the segment buffer ran dry while the planner still had motion queued.
+static inline void IRAM_ATTR stepper_count_underrun() {
+#ifdef JOG_VELOCITY_MODE
+    if (sys.step_control == STEP_CONTROL_NORMAL_OP && (plan_get_current_block() != NULL || prep.jog_active)) {
+#else
+    if (sys.step_control == STEP_CONTROL_NORMAL_OP && plan_get_current_block() != NULL) {
+#endif
+        segment_underruns++;
+    }
+}
+
+// Ensures the pwm is set properly upon completion of rate-controlled motion.
+static inline void IRAM_ATTR stepper_rate_pwm_off() {
+    if (sys.state != State::Jog) {  // added to prevent ... jog after probing crash
+        if (st.exec_block != NULL && st.exec_block->is_pwm_rate_adjusted) {
+            if (st_ctx.fast_spindle) {
+                sys.spindle_speed = 0;
+                st_ctx.fast_spindle->write_duty_isr(st_ctx.fast_spindle->off_duty());
+            } else {
+                spindle->set_rpm(0);
+            }
+        }
+    }
+}
+
+// Ends an invocation that traced steps. The I2S stream needs the pulse pushed out.
+static inline void IRAM_ATTR stepper_pulse_end() {
+#ifdef USE_I2S_STEPS
+    if (current_stepper == ST_I2S_STREAM) {
+        //
+        // Generate pulse (at least one pulse)
+        // The pulse resolution is limited by I2S_OUT_USEC_PER_PULSE
+        //
+        i2s_out_push_sample(st_ctx.pulse_microseconds / I2S_OUT_USEC_PER_PULSE);
+        set_stepper_pins_on(0);  // turn all off
+    }
+#endif
+}
+
+#ifdef ENABLE_AUX_STREAM
+static inline void IRAM_ATTR stepper_aux_period(uint32_t period) {
+    if (period != st.aux_timer) {
+        Stepper_Timer_WritePeriod(period);
+        st.aux_timer = period;
+    }
+}
+
+// Splits each tick of a segment slower than AUX_STREAM_TICK_CYCLES into periods the auxiliary axis can
+// step in, while it has steps to put out. The tick itself takes the first, longest period.
+static inline void IRAM_ATTR stepper_aux_split(uint32_t cycles) {
+    uint32_t ticks = 1;
+    if (cycles > AUX_STREAM_TICK_CYCLES && aux_stream_ready()) {
+        ticks = (cycles + AUX_STREAM_TICK_CYCLES - 1) / AUX_STREAM_TICK_CYCLES;
+    }
+    st.aux_ticks  = ticks;
+    st.aux_period = cycles / ticks;
+    st.aux_first  = cycles - (ticks - 1) * st.aux_period;
+}
+
+// Adds the step of the auxiliary stream for the next cycles step timer ticks to the output, with its
+// direction. It is counted in sys_position like the steps of the segments.
+static inline void IRAM_ATTR stepper_aux_step(uint32_t cycles) {
+    int8_t step = aux_stream_step(cycles);
+    if (step == 0) {
+        return;
+    }
+    uint8_t dir_bit = (step < 0 ? bit(AUX_STREAM_AXIS) : 0) ^ (st_ctx.dir_invert_mask & bit(AUX_STREAM_AXIS));
+    if ((st.dir_outbits & bit(AUX_STREAM_AXIS)) != dir_bit) {
+        st.dir_outbits ^= bit(AUX_STREAM_AXIS);
+        st.dir_pending = true;
+    }
+    st.step_outbits |= bit(AUX_STREAM_AXIS);
+    system_position_write_begin();
+    sys_position[AUX_STREAM_AXIS] += step;
+    system_position_write_end();
+}
+
+// Keeps the ISR ticking for the auxiliary axis once the segment buffer is empty. The motion of the other
+// axes ends as it would, except that the cycle stop of a feed hold waits until the auxiliary axis has
+// stopped too. The ISR goes idle when it has.
+static void IRAM_ATTR stepper_aux_only() {
+    if (!st.aux_only) {
+        st.aux_only = true;
+        stepper_count_underrun();
+        stepper_rate_pwm_off();
+        st.aux_stop_pending = sys.step_control & STEP_CONTROL_EXECUTE_HOLD;
+        if (!st.aux_stop_pending) {
+            cycle_stop = true;
+        }
+    }
+    if (!aux_stream_ready()) {
+        st.aux_only = false;
+        st_go_idle();
+        if (st.aux_stop_pending) {
+            st.aux_stop_pending = false;
+            cycle_stop          = true;
+        }
+        return;
+    }
+    st.step_outbits = 0;
+    stepper_aux_period(AUX_STREAM_TICK_CYCLES);
+    stepper_aux_step(AUX_STREAM_TICK_CYCLES);
+    stepper_pulse_end();
+}
+#endif
+
 /**
  * This phase of the ISR should ONLY create the pulses for the steppers.
  * This prevents jitter caused by the interval between the start of the
@@ -237,18 +932,86 @@ void IRAM_ATTR onStepperDriverTimer(
  * is to keep pulse timing as regular as possible.
  */
 static void stepper_pulse_func() {
-    auto n_axis = number_axis->get();
-
-    motors_set_direction_pins(st.dir_outbits);
+#if defined(USE_I2S_STEPS) && defined(I2S_PROBE_TRUNCATE)
+    if (current_stepper == ST_I2S_STREAM && stepper_i2s_probe_stop()) {
+        return;
+    }
+#endif
+#ifdef USE_MCPWM_STEPS
+    if (st.run_rest) {
+        stepperMCPWM_Stop();  // This invocation only ends the run that went out last
+        return;
+    }
+#endif
+#if !defined(USE_RMT_STEPS) && !defined(USE_MCPWM_STEPS)
+    // The last pulse has not ended yet, as its alarm is still armed or its interrupt waits behind this
+    // one: the step rate is above what the pulse length allows. End it here and hold the pins low as
+    // long, so the drivers see the next edge, and the pending alarm cannot cut the next pulse short.
+    if (current_stepper != ST_I2S_STREAM && (TIMERG0.hw_timer[PULSE_TIMER_INDEX].config.alarm_en || TIMERG0.int_raw.t1)) {
+        TIMERG0.hw_timer[PULSE_TIMER_INDEX].config.alarm_en = TIMER_ALARM_DIS;
+        TIMERG0.int_clr_timers.t1                           = 1;
+        set_stepper_pins_on(0);
+        ets_delay_us(st_ctx.pulse_microseconds);
+    }
+#endif
+    if (st.dir_pending) {
+        // Only when the segment loader found a new direction, ahead of the steps that need it
+        motors_set_direction_pins(st.dir_outbits);
+        st.dir_pending = false;
+        st.dir_setup   = st_ctx.dir_delay_microseconds != 0;
+    }
 #ifdef USE_RMT_STEPS
+#    ifdef RMT_STEP_BURST
+    if (st.burst_steps) {
+        stepperRMT_Burst();
+    } else {
+        stepperRMT_Outputs();
+    }
+#    else
     stepperRMT_Outputs();
+#    endif
+#elif defined(USE_MCPWM_STEPS)
+    if (st.burst_steps) {
+        stepperMCPWM_Burst();
+    } else {
+        stepperMCPWM_Outputs();
+    }
 #else
+    if (st.dir_setup && current_stepper != ST_I2S_STREAM) {
+        ets_delay_us(st_ctx.dir_delay_microseconds);  // Once per direction change, at most 100 us
+    }
     set_stepper_pins_on(st.step_outbits);
-    uint64_t step_pulse_start_time = esp_timer_get_time();
+    if (current_stepper != ST_I2S_STREAM) {
+        // Restart the pulse timer. Its alarm, st_ctx.pulse_microseconds out, turns the pins off.
+        TIMERG0.hw_timer[PULSE_TIMER_INDEX].load_high       = 0;
+        TIMERG0.hw_timer[PULSE_TIMER_INDEX].load_low        = 0;
+        TIMERG0.hw_timer[PULSE_TIMER_INDEX].reload          = 1;
+        TIMERG0.hw_timer[PULSE_TIMER_INDEX].config.alarm_en = TIMER_ALARM_EN;
+    }
+#endif
+    st.dir_setup = false;
+#ifdef ENABLE_STEP_CAPTURE
+    // The bits going out were traced by the previous invocation, so the capture fields still describe them.
+    if (step_capture_active && st.step_outbits) {
+        step_capture_record(st.step_outbits, st.capture_segment, st.capture_tick, st.capture_period, st.capture_amass);
+    }
 #endif
 
     // some motor objects, like unipolar, handle steps themselves
-    motors_step(st.step_outbits, st.dir_outbits);
+    if (motor_class_steps) {
+        motors_step(st.step_outbits, st.dir_outbits);
+    }
+#ifdef ENABLE_AUX_STREAM
+    if (st.aux_tick) {
+        // A period of a split tick. Only the auxiliary axis steps in it.
+        st.aux_tick--;
+        stepper_aux_period(st.aux_period);
+        st.step_outbits = 0;
+        stepper_aux_step(st.aux_period);
+        stepper_pulse_end();
+        return;
+    }
+#endif
 
     // If there is no step segment, attempt to pop one from the stepper buffer
     if (st.exec_segment == NULL) {
@@ -257,188 +1020,305 @@ static void stepper_pulse_func() {
             // Initialize new step segment and load number of steps to execute
             st.exec_segment = &segment_buffer[segment_buffer_tail];
             // Initialize step segment timing per step and load number of steps to execute.
-            Stepper_Timer_WritePeriod(st.exec_segment->cycles_per_tick);
+#ifdef ENABLE_AUX_STREAM
+            stepper_aux_split(st.exec_segment->cycles_per_tick);  // Written with each tick below
+            st.aux_only = false;
+#elif !defined(STEP_BURST)
+            Stepper_Timer_WritePeriod(st.exec_segment->cycles_per_tick);  // Else written before the trace below
+#endif
             st.step_count = st.exec_segment->n_step;  // NOTE: Can sometimes be zero when moving slow.
+#ifdef ENABLE_STEP_CAPTURE
+            st.capture_segment++;
+            st.capture_tick = 0;
+            st.capture_period = st.exec_segment->cycles_per_tick;
+            st.capture_amass  = st.exec_segment->amass_level;
+#endif
+#ifdef ENABLE_STEPPER_ISR_PROFILING
+            isr_work   = StIsrWork::Segment;
+            isr_period = st.exec_segment->cycles_per_tick;
+#    ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+            isr_amass = st.exec_segment->amass_level;
+#    endif
+#endif
             // If the new segment starts a new planner block, initialize stepper variables and counters.
             // NOTE: When the segment data index changes, this indicates a new planner block.
             if (st.exec_block_index != st.exec_segment->st_block_index) {
                 st.exec_block_index = st.exec_segment->st_block_index;
                 st.exec_block       = &st_block_buffer[st.exec_block_index];
+#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+                st.amass_level = 0xff;  // Rescale steps[] for the new block
+#endif
+#ifdef ENABLE_STEPPER_ISR_PROFILING
+                isr_work = StIsrWork::Block;
+#endif
                 // Initialize Bresenham line and distance counters
-                st.counter_x = st.counter_y = st.counter_z = (st.exec_block->step_event_count >> 1);
-                // TODO ABC
+#ifdef STEP_BURST
+                // The counters start at half the event count, so with 2 events or more an axis with as
+                // many steps steps on every tick.
+                bool    burst      = st.exec_block->step_event_count >= 2;
+                uint8_t burst_axes = 0;
+#endif
+#ifdef BACKLASH_COMPENSATION
+                uint8_t moving = 0;
+#endif
+                for (int axis = 0; axis < MAX_N_AXIS; axis++) {
+                    st.counter[axis] = st.exec_block->step_event_count >> 1;
+#ifdef BACKLASH_COMPENSATION
+                    if (st.exec_block->steps[axis]) {
+                        moving |= bit(axis);
+                    }
+#endif
+#ifdef STEP_BURST
+                    if (st.exec_block->steps[axis] == st.exec_block->step_event_count) {
+                        burst_axes |= bit(axis);
+                    } else if (st.exec_block->steps[axis]) {
+                        burst = false;
+                    }
+#endif
+                }
+#ifdef STEP_BURST
+                st.burst_axes = burst ? burst_axes : 0;
+#endif
+#ifdef BACKLASH_COMPENSATION
+                stepper_backlash_block(moving);
+#endif
+#ifdef ENABLE_LASER_RASTER
+                if (st.raster) {
+                    raster_release(st.raster);  // Ended short of its step count
+                }
+                st.raster       = st.exec_block->raster;
+                st.raster_steps = 0;
+                st.raster_phase = 0;
+                st.raster_pixel = 0;
+#endif
+#ifdef ENABLE_SPINDLE_SYNC
+                if (st.exec_block->sync_start) {
+                    spindle_sync_mark_start();  // The prep predicts the spindle from here
+                }
+#endif
+#ifdef SYNC_USER_OUTPUTS
+                if (st.exec_block->output_events) {
+                    sys_output_events_fire(st.exec_block->output_events);  // M62-M65/M67 of the block
+                }
+#endif
+#ifdef SPINDLE_STATE_IN_PLANNER
+                if (st.exec_block->apply_state) {
+                    spindle->set_state_isr(st.exec_block->spindle);  // The segment below sets its output
+                    coolant_set_state_isr(st.exec_block->coolant);
+                }
+#endif
+            }
+            if (segment_event_axes) {
+                stepper_segment_event();
+            }
+            uint8_t dir_outbits = st.exec_block->direction_bits ^ st_ctx.dir_invert_mask;
+#ifdef ENABLE_AUX_STREAM
+            if (st.exec_block->steps[AUX_STREAM_AXIS] == 0) {
+                // Left to the auxiliary stream
+                dir_outbits = (dir_outbits & ~bit(AUX_STREAM_AXIS)) | (st.dir_outbits & bit(AUX_STREAM_AXIS));
+            }
+#endif
+            if (dir_outbits != st.dir_outbits) {
+                st.dir_outbits = dir_outbits;
+                st.dir_pending = true;
             }
-            st.dir_outbits = st.exec_block->direction_bits ^ dir_invert_mask->get();
 #ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
             // With AMASS enabled, adjust Bresenham axis increment counters according to AMASS level.
-            st.steps[X_AXIS] = st.exec_block->steps[X_AXIS] >> st.exec_segment->amass_level;
-            st.steps[Y_AXIS] = st.exec_block->steps[Y_AXIS] >> st.exec_segment->amass_level;
-            st.steps[Z_AXIS] = st.exec_block->steps[Z_AXIS] >> st.exec_segment->amass_level;
-
-            if (n_axis > A_AXIS) {
-                st.steps[A_AXIS] = st.exec_block->steps[A_AXIS] >> st.exec_segment->amass_level;
-                if (n_axis > B_AXIS) {
-                    st.steps[B_AXIS] = st.exec_block->steps[B_AXIS] >> st.exec_segment->amass_level;
-                    if (n_axis > C_AXIS) {
-                        st.steps[C_AXIS] = st.exec_block->steps[C_AXIS] >> st.exec_segment->amass_level;
-                    }
+            // They only change with the block or the level, so consecutive segments of a block reuse them.
+            if (st.amass_level != st.exec_segment->amass_level) {
+                st.amass_level = st.exec_segment->amass_level;
+                for (int axis = 0; axis < MAX_N_AXIS; axis++) {
+                    st.steps[axis] = st.exec_block->steps[axis] >> st.amass_level;
                 }
             }
 #endif
             // Set real-time spindle output as segment is loaded, just prior to the first step.
-            spindle->set_rpm(st.exec_segment->spindle_rpm);
+#ifdef ENABLE_LASER_RASTER
+            if (st.raster) {
+                st_ctx.fast_spindle->write_duty_isr(st.raster->duty[st.raster_pixel]);  // Scanlines set it per pixel
+            } else
+#endif
+            if (st_ctx.fast_spindle) {
+                st_ctx.fast_spindle->write_duty_isr(st.exec_segment->spindle_duty);
+#ifdef LASER_POWER_RAMP
+                st.spindle_duty = st.exec_segment->spindle_duty << SPINDLE_DUTY_SHIFT;
+#endif
+            } else {
+                spindle->set_rpm(st.exec_segment->spindle_rpm);
+            }
         } else {
-            // Segment buffer empty. Shutdown.
-            st_go_idle();
-            if (sys.state != State::Jog) {  // added to prevent ... jog after probing crash
-                // Ensure pwm is set properly upon completion of rate-controlled motion.
-                if (st.exec_block != NULL && st.exec_block->is_pwm_rate_adjusted) {
-                    spindle->set_rpm(0);
-                }
+            // Segment buffer empty. Shutdown. If motion is still queued, the prep could not keep up.
+#ifdef ENABLE_AUX_STREAM
+            if (st.aux_only || aux_stream_ready()) {
+                stepper_aux_only();
+                return;
+            }
+#endif
+            stepper_count_underrun();
+#ifdef USE_MCPWM_STEPS
+            if (st.run_wake) {
+                // The run that just went out still has to be stopped. Go idle after that.
+                Stepper_Timer_WritePeriod(st.run_wake);
+                st.timer_period = st.run_wake;
+                st.run_rest     = MCPWM_STOP_MIN_TICKS;
+                st.run_wake     = 0;
+                st.step_outbits = 0;
+                return;
             }
+#endif
+            st_go_idle();
+            stepper_rate_pwm_off();
             cycle_stop = true;
             return;  // Nothing to do but exit.
         }
     }
-    // Check probing state.
-    if (sys_probe_state == PROBE_ACTIVE) {
-        probe_state_monitor();
+#ifdef STEP_BURST
+    // A run being output delays the next output by its steps after the first
+    uint32_t period = st.exec_segment->cycles_per_tick + st.burst_extra;
+#    ifdef USE_MCPWM_STEPS
+    if (st.run_wake) {
+        // Wake in the last period of the run to stop it, then output on time
+        st.run_rest = period > st.run_wake + MCPWM_STOP_MIN_TICKS ? period - st.run_wake : MCPWM_STOP_MIN_TICKS;
+        period      = st.run_wake;
+        st.run_wake = 0;
+    }
+#    endif
+    if (period != st.timer_period) {
+        Stepper_Timer_WritePeriod(period);
+        st.timer_period   = period;
+        st.segment_period = st.exec_segment->cycles_per_tick;
     }
+#endif
     // Reset step out bits.
     st.step_outbits = 0;
     // Execute step displacement profile by Bresenham line algorithm
-#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-    st.counter_x += st.steps[X_AXIS];
-#else
-    st.counter_x += st.exec_block->steps[X_AXIS];
-#endif
-    if (st.counter_x > st.exec_block->step_event_count) {
-        st.step_outbits |= bit(X_AXIS);
-        st.counter_x -= st.exec_block->step_event_count;
-        if (st.exec_block->direction_bits & bit(X_AXIS)) {
-            sys_position[X_AXIS]--;
-        } else {
-            sys_position[X_AXIS]++;
-        }
+    system_position_write_begin();
+#ifdef STEP_BURST
+    if (stepper_burst_ready()) {
+        stepper_trace_burst();
+    } else {
+        stepper_trace();
     }
-#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-    st.counter_y += st.steps[Y_AXIS];
 #else
-    st.counter_y += st.exec_block->steps[Y_AXIS];
+    stepper_trace();
 #endif
-    if (st.counter_y > st.exec_block->step_event_count) {
-        st.step_outbits |= bit(Y_AXIS);
-        st.counter_y -= st.exec_block->step_event_count;
-        if (st.exec_block->direction_bits & bit(Y_AXIS)) {
-            sys_position[Y_AXIS]--;
-        } else {
-            sys_position[Y_AXIS]++;
-        }
+    system_position_write_end();
+#ifdef BACKLASH_COMPENSATION
+    if (st.backlash_axes) {
+        stepper_backlash_step();
     }
-#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-    st.counter_z += st.steps[Z_AXIS];
-#else
-    st.counter_z += st.exec_block->steps[Z_AXIS];
 #endif
-    if (st.counter_z > st.exec_block->step_event_count) {
-        st.step_outbits |= bit(Z_AXIS);
-        st.counter_z -= st.exec_block->step_event_count;
-        if (st.exec_block->direction_bits & bit(Z_AXIS)) {
-            sys_position[Z_AXIS]--;
-        } else {
-            sys_position[Z_AXIS]++;
-        }
+#ifdef AXIS_ENCODER_CORRECTION
+    if (correction_axes) {
+        stepper_correction_step();
     }
-
-    if (n_axis > A_AXIS) {
-#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-        st.counter_a += st.steps[A_AXIS];
-#else
-        st.counter_a += st.exec_block->steps[A_AXIS];
 #endif
-        if (st.counter_a > st.exec_block->step_event_count) {
-            st.step_outbits |= bit(A_AXIS);
-            st.counter_a -= st.exec_block->step_event_count;
-            if (st.exec_block->direction_bits & bit(A_AXIS)) {
-                sys_position[A_AXIS]--;
-            } else {
-                sys_position[A_AXIS]++;
-            }
-        }
-
-        if (n_axis > B_AXIS) {
-#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-            st.counter_b += st.steps[B_AXIS];
-#else
-            st.counter_b += st.exec_block->steps[B_AXIS];
-#endif
-            if (st.counter_b > st.exec_block->step_event_count) {
-                st.step_outbits |= bit(B_AXIS);
-                st.counter_b -= st.exec_block->step_event_count;
-                if (st.exec_block->direction_bits & bit(B_AXIS)) {
-                    sys_position[B_AXIS]--;
-                } else {
-                    sys_position[B_AXIS]++;
-                }
-            }
-
-            if (n_axis > C_AXIS) {
-#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-                st.counter_c += st.steps[C_AXIS];
-#else
-                st.counter_c += st.exec_block->steps[C_AXIS];
-#endif
-                if (st.counter_c > st.exec_block->step_event_count) {
-                    st.step_outbits |= bit(C_AXIS);
-                    st.counter_c -= st.exec_block->step_event_count;
-                    if (st.exec_block->direction_bits & bit(C_AXIS)) {
-                        sys_position[C_AXIS]--;
-                    } else {
-                        sys_position[C_AXIS]++;
-                    }
-                }
-            }
-        }
-    }
 
     // During a homing cycle, lock out and prevent desired axes from moving.
     if (sys.state == State::Homing) {
         st.step_outbits &= sys.homing_axis_lock;
     }
+#ifdef ENABLE_AUX_STREAM
+    st.aux_tick = st.aux_ticks - 1;
+    stepper_aux_period(st.aux_first);
+    stepper_aux_step(st.aux_first);
+#endif
+#ifdef ENABLE_LASER_RASTER
+    if (st.raster && (st.step_outbits & bit(st.raster->axis))) {
+        stepper_raster_step();
+    }
+#endif
+#ifdef LASER_POWER_RAMP
+    if (st.exec_segment->spindle_duty_step) {
+        st.spindle_duty += st.exec_segment->spindle_duty_step;
+        st_ctx.fast_spindle->write_duty_isr(st.spindle_duty >> SPINDLE_DUTY_SHIFT);
+    }
+#endif
+#ifdef ENABLE_LASER_PPI
+    uint32_t ppi_phase = st.ppi_phase + st.exec_segment->ppi_step;
+    if (ppi_phase < st.ppi_phase) {
+        laser_ppi_fire();  // The phase wrapped, the tool has travelled another pulse spacing
+    }
+    st.ppi_phase = ppi_phase;
+#endif
     st.step_count--;  // Decrement step events count
+#ifdef ENABLE_STEP_CAPTURE
+    st.capture_tick++;
+#endif
     if (st.step_count == 0) {
         // Segment is complete. Discard current segment and advance segment indexing.
         st.exec_segment = NULL;
         if (++segment_buffer_tail == SEGMENT_BUFFER_SIZE) {
             segment_buffer_tail = 0;
         }
-    }
-
-#ifdef USE_I2S_STEPS
-    if (current_stepper == ST_I2S_STREAM) {
-        //
-        // Generate pulse (at least one pulse)
-        // The pulse resolution is limited by I2S_OUT_USEC_PER_PULSE
-        //
-        i2s_out_push_sample(pulse_microseconds->get() / I2S_OUT_USEC_PER_PULSE);
-        set_stepper_pins_on(0);  // turn all off
-        return;
-    }
+#ifdef USE_STEPPER_PREP_TASK
+        // Wake the prep task once the queue drains to the watermark.
+        int queued = int(segment_buffer_head) - int(segment_buffer_tail);
+        if (queued < 0) {
+            queued += SEGMENT_BUFFER_SIZE;  // Head has wrapped around
+        }
+        if (queued <= STEPPER_PREP_WATERMARK && stepperPrepTaskHandle) {
+            BaseType_t higherPriorityTaskWoken = pdFALSE;
+            vTaskNotifyGiveFromISR(stepperPrepTaskHandle, &higherPriorityTaskWoken);
+            if (higherPriorityTaskWoken && xPortInIsrContext()) {
+                portYIELD_FROM_ISR();
+            }
+        }
 #endif
-#ifdef USE_RMT_STEPS
-    return;
-#else
-    // wait for step pulse time to complete...some of it should have expired during code above
-    while (esp_timer_get_time() - step_pulse_start_time < pulse_microseconds->get()) {
-        NOP();  // spin here until time to turn off step
     }
+    stepper_pulse_end();
+}
+
+#if !defined(USE_RMT_STEPS) && !defined(USE_MCPWM_STEPS)
+// Native GPIO levels of the step pins for each combination of step bits, one table per squaring mode, with
+// the step invert mask folded in. A step event of the timed stepper is then a write to the set and the
+// clear registers of the GPIO port instead of a digitalWrite() per pin.
+typedef struct {
+    uint32_t set[2];  // Bit n of word w is GPIO(32 * w + n)
+    uint32_t clear[2];
+} step_gpio_t;
+enum class StepGpio : uint8_t {
+    NotBuilt = 0,
+    Ready,
+    Unusable,  // A step pin is not a GPIO pin, set_stepper_pins_on() writes them one by one
+};
+static DRAM_ATTR step_gpio_t step_gpio[3][1 << MAX_N_AXIS];
+static uint8_t               step_gpio_invert = 0;  // Step invert mask the tables were built with
+static StepGpio              step_gpio_state  = StepGpio::NotBuilt;
+
+static void stepper_gpio_build_table();
+
+// Ends the step pulses started by stepper_pulse_func(). It shares the priority of the step ISR, so a
+// pulse can be stretched by the rest of that ISR, but never cut short.
+static void IRAM_ATTR onStepPulseTimer(void* para) {
+    TIMERG0.int_clr_timers.t1 = 1;
     set_stepper_pins_on(0);  // turn all off
+}
 #endif
+
+// Runs in the esp_timer task.
+static void stepper_idle_expired(void* arg) {
+    xSemaphoreTake(stepper_idle_mutex, portMAX_DELAY);
+    if (stepper_idle) {
+        uint8_t lock_ms = stepper_idle_lock_time->get();
+        if (stepper_idle_stage == IdleStage::Hold) {
+            motors_set_idle_hold(true);  // All chained drivers in one SPI transfer
+            if (lock_ms != 0xff) {
+                stepper_idle_stage = IdleStage::Disable;
+                uint32_t rest_ms = lock_ms > TRINAMIC_IDLE_HOLD_MS ? lock_ms - TRINAMIC_IDLE_HOLD_MS : 0;
+                esp_timer_start_once(stepper_idle_timer, rest_ms * 1000);
+            }
+        } else {
+            motors_set_disable(true);
+        }
+    }
+    xSemaphoreGive(stepper_idle_mutex);
 }
 
 void stepper_init() {
     grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Axis count %d", number_axis->get());
     grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "%s", stepper_names[current_stepper]);
+    st_update_context();
 
 #ifdef USE_I2S_STEPS
     // I2S stepper stream mode use callback but timer interrupt
@@ -446,10 +1326,193 @@ void stepper_init() {
 #endif
     // Other stepper use timer interrupt
     Stepper_Timer_Init();
+
+    stepper_idle_mutex           = xSemaphoreCreateMutex();
+    esp_timer_create_args_t args = {};
+    args.callback                = stepper_idle_expired;
+    args.name                    = "stepperIdle";
+    esp_timer_create(&args, &stepper_idle_timer);
+
+#ifdef USE_STEPPER_PREP_TASK
+    stepperPrepMutex = xSemaphoreCreateRecursiveMutex();
+    xTaskCreatePinnedToCore(stepperPrepTask,    // task
+                            "stepperPrepTask",  // name for task
+                            STEPPER_PREP_TASK_STACK,
+                            NULL,  // parameters
+                            STEPPER_PREP_TASK_PRIORITY,
+                            &stepperPrepTaskHandle,
+                            STEPPER_PREP_TASK_CORE  // core
+    );
+#endif
+}
+
+#ifdef USE_STEPPER_PREP_TASK
+// Refills the segment buffer whenever the stepper ISR reports that it is running low. This keeps
+// segment preparation off the core that parses g-code, so long lines or slow clients cannot starve it.
+static void stepperPrepTask(void* pvParameters) {
+    while (true) {
+        task_stats_block();
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        task_stats_unblock();
+        st_prep_buffer();
+    }
+}
+#endif
+
+// Serializes access to the segment preparation state and the planner blocks it consumes. Only needed
+// when st_prep_buffer() runs in its own task. The lock is recursive, so nested calls are fine.
+void st_prep_lock() {
+#ifdef USE_STEPPER_PREP_TASK
+    if (stepperPrepMutex) {
+        xSemaphoreTakeRecursive(stepperPrepMutex, portMAX_DELAY);
+    }
+#endif
+}
+
+void st_prep_unlock() {
+#ifdef USE_STEPPER_PREP_TASK
+    if (stepperPrepMutex) {
+        xSemaphoreGiveRecursive(stepperPrepMutex);
+    }
+#endif
+}
+
+void st_set_segment_event(TaskHandle_t task, uint8_t axes) {
+    segment_event_axes = 0;
+    segment_event_task = task;
+    segment_event_axes = task ? axes : 0;
+}
+
+uint32_t st_get_underrun_count() {
+    return segment_underruns;
+}
+
+#ifdef STEP_BURST
+const st_burst_stats_t* st_get_burst_stats() {
+    return &burst_stats;
+}
+
+void st_reset_burst_stats() {
+    burst_stats = {};
+}
+#endif
+
+uint8_t st_get_segment_buffer_count() {
+    uint8_t head = segment_buffer_head;
+    uint8_t tail = segment_buffer_tail;
+    return head >= tail ? head - tail : head + SEGMENT_BUFFER_SIZE - tail;
+}
+
+uint32_t st_get_buffer_memory() {
+    return sizeof(segment_buffer) + sizeof(st_block_buffer);
+}
+
+#ifdef HOMING_PARALLEL_SQUARING
+uint8_t st_get_ganged_axes() {
+    return MachineTraits::ganged_axes;
+}
+
+void IRAM_ATTR st_lock_ganged_motor(uint8_t axis, uint8_t motor) {
+    if (!(MachineTraits::ganged_axes & bit(axis))) {
+        return;
+    }
+    ganged_motor_lock[motor] |= bit(axis);
+#    ifdef USE_RMT_STEPS
+    rmt_locked_channels |= bit(rmt_chan_num[axis][motor]);
+#    endif
 }
 
+uint8_t IRAM_ATTR st_get_locked_motors(uint8_t motor) {
+    return ganged_motor_lock[motor];
+}
+#endif
+
+uint64_t st_discard_segments(uint32_t* count, void (*trace)(const st_segment_trace_t* segment)) {
+    uint64_t ticks = 0;
+    while (segment_buffer_tail != segment_buffer_head) {
+        segment_t* segment = &segment_buffer[segment_buffer_tail];
+        ticks += uint64_t(segment->n_step) * segment->cycles_per_tick;
+        if (trace) {
+            st_segment_trace_t record;
+            record.n_step          = segment->n_step;
+            record.cycles_per_tick = segment->cycles_per_tick;
+            record.direction_bits  = st_block_buffer[segment->st_block_index].direction_bits;
+            record.amass_level     = segment->amass_level;
+            trace(&record);
+        }
+#ifdef ENABLE_LASER_RASTER
+        st_block_t* block = &st_block_buffer[segment->st_block_index];
+        if (block->raster) {
+            raster_release(block->raster);  // The ISR releases it after its last step
+            block->raster = NULL;
+        }
+#endif
+        (*count)++;
+        if (++segment_buffer_tail == SEGMENT_BUFFER_SIZE) {
+            segment_buffer_tail = 0;
+        }
+    }
+    return ticks;
+}
+
+void st_benchmark(uint8_t client, uint32_t count) {
+    // 1 mm sides at 3000 mm/min, so blocks of a few segments each, with their ramps
+    const int sides = 64;
+    float     start[MAX_N_AXIS];
+    int32_t   position[MAX_N_AXIS];
+    system_get_position(position);
+    system_convert_array_steps_to_mpos(start, position);
+    plan_line_data_t pl_data;
+    memset(&pl_data, 0, sizeof(plan_line_data_t));
+    pl_data.feed_rate = 3000.0f;
+    float target[MAX_N_AXIS];
+    memcpy(target, start, sizeof(target));
+
+    st_reset();
+    plan_reset();
+    plan_sync_position();
+    uint32_t segments = 0;
+    uint64_t cycles   = 0;
+    int      side     = 0;
+    while (segments < count) {
+        while (!plan_check_full_buffer()) {
+            float angle    = ++side * (2.0f * float(M_PI) / sides);
+            target[X_AXIS] = start[X_AXIS] + 10.0f * (cosf(angle) - 1.0f);
+            target[Y_AXIS] = start[Y_AXIS] + 10.0f * sinf(angle);
+            plan_buffer_line(target, &pl_data);
+        }
+        uint32_t before = segments;
+        uint32_t t0     = xthal_get_ccount();
+        st_prep_buffer();
+        cycles += xthal_get_ccount() - t0;
+        st_discard_segments(&segments);
+        if (segments == before) {
+            break;  // The prep is held, as at the end of a feed hold
+        }
+    }
+    st_reset();
+    plan_reset();
+    plan_sync_position();
+    float us = float(cycles) / getCpuFrequencyMhz();
+    grbl_sendf(client,
+               "[MSG: Segment prep segments:%u time:%.2f us/segment rate:%.0f segments/ms]\r\n",
+               segments,
+               segments ? us / segments : 0.0f,
+               us > 0 ? segments * 1000.0f / us : 0.0f);
+}
+
+#ifdef ENABLE_STEPPER_ISR_PROFILING
+const st_isr_profile_t* st_get_isr_profile() {
+    return &isr_profile;
+}
+
+void st_reset_isr_profile() {
+    memset(&isr_profile, 0, sizeof(st_isr_profile_t));
+}
+#endif
+
 void stepper_switch(stepper_id_t new_stepper) {
-    grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Debug, "Switch stepper: %s -> %s", stepper_names[current_stepper], stepper_names[new_stepper]);
+    grbl_msg_deferf(CLIENT_SERIAL, MsgLevel::Debug, "Switch stepper: %s -> %s", stepper_names[current_stepper], stepper_names[new_stepper]);
     if (current_stepper == new_stepper) {
         // do not need to change
         return;
@@ -468,23 +1531,81 @@ void stepper_switch(stepper_id_t new_stepper) {
     current_stepper = new_stepper;
 }
 
+// Refreshes the ISR copy of the stepper settings.
+static void st_update_context() {
+    motion_config_refresh();
+    if (st_ctx.generation != motion_config.generation) {
+        st_ctx.generation             = motion_config.generation;
+        st_ctx.dir_invert_mask        = motion_config.dir_invert_mask;
+        st_ctx.step_invert_mask       = motion_config.step_invert_mask;
+        st_ctx.pulse_microseconds     = motion_config.pulse_microseconds;
+        st_ctx.dir_delay_microseconds = motion_config.dir_delay_microseconds;
+#ifdef BACKLASH_COMPENSATION
+        for (int axis = 0; axis < MAX_N_AXIS; axis++) {
+            // max_rate is in mm/min
+            float steps_per_sec = motion_config.max_rate[axis] * motion_config.steps_per_mm[axis] * (BACKLASH_RATE_PERCENT / 6000.0f);
+
+            st_ctx.backlash_steps[axis] = lroundf(motion_config.backlash[axis] * motion_config.steps_per_mm[axis]);
+            st_ctx.backlash_ticks[axis] = steps_per_sec > 0.0f ? uint32_t(F_STEPPER_TIMER / steps_per_sec) : 0;
+        }
+#endif
+#ifdef AXIS_ENCODER_CORRECTION
+        for (int axis = 0; axis < MAX_N_AXIS; axis++) {
+            float steps_per_sec =
+                motion_config.max_rate[axis] * motion_config.steps_per_mm[axis] * (AXIS_ENCODER_CORRECTION_RATE_PERCENT / 6000.0f);
+            st_ctx.correction_ticks[axis] = steps_per_sec > 0.0f ? uint32_t(F_STEPPER_TIMER / steps_per_sec) : 0;
+        }
+#endif
+    }
+    st_ctx.fast_spindle = spindle ? spindle->fast_output() : nullptr;
+}
+
 // enabled. Startup init and limits call this function but shouldn't start the cycle.
 void st_wake_up() {
     //grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "st_wake_up");
     // Enable stepper drivers.
-    motors_set_disable(false);
+    esp_timer_stop(stepper_idle_timer);
+    xSemaphoreTake(stepper_idle_mutex, portMAX_DELAY);
     stepper_idle = false;
+    motors_set_idle_hold(false);
+    motors_set_disable(false);
+    xSemaphoreGive(stepper_idle_mutex);
+    warm_restart_invalidate();  // Until the machine stands still again
+    st_update_context();
+#ifdef USE_RMT_STEPS
+    if (!rmt_start_bits_built) {
+        stepper_rmt_build_table();
+    }
+#endif
     // Initialize step pulse timing from settings. Here to ensure updating after re-writing.
 #ifdef STEP_PULSE_DELAY
     // Step pulse delay handling is not require with ESP32...the RMT function does it.
 #else  // Normal operation
     // Set step pulse time. Ad hoc computation from oscilloscope. Uses two's complement.
-    st.step_pulse_time = -(((pulse_microseconds->get() - 2) * TICKS_PER_MICROSECOND) >> 3);
+    st.step_pulse_time = -(((st_ctx.pulse_microseconds - 2) * TICKS_PER_MICROSECOND) >> 3);
+#endif
+#if !defined(USE_RMT_STEPS) && !defined(USE_MCPWM_STEPS)
+    if (step_gpio_state == StepGpio::NotBuilt || step_gpio_invert != st_ctx.step_invert_mask) {
+        stepper_gpio_build_table();
+    }
+    timer_set_alarm_value(STEP_TIMER_GROUP, PULSE_TIMER_INDEX, uint64_t(st_ctx.pulse_microseconds) * TICKS_PER_MICROSECOND);
 #endif
     // Enable Stepper Driver Interrupt
+#ifdef ENABLE_AUX_STREAM
+    stepper_running = true;
+#endif
     Stepper_Timer_Start();
 }
 
+#ifdef ENABLE_AUX_STREAM
+void st_aux_wake_up() {
+    if (!stepper_running && aux_stream_ready()) {
+        st.aux_only = true;  // Nothing else moves, no cycle stop is owed
+        st_wake_up();
+    }
+}
+#endif
+
 // Reset and clear stepper subsystem variables
 void st_reset() {
 #ifdef ESP_DEBUG
@@ -496,32 +1617,175 @@ void st_reset() {
         i2s_out_reset();
     }
 #endif
+    st_update_context();
     st_go_idle();
+    st_prep_lock();
+    if (st_cruising) {
+        st_cruising = false;
+        motors_set_cruise(false);
+    }
     // Initialize stepper algorithm variables.
     memset(&prep, 0, sizeof(st_prep_t));
     memset(&st, 0, sizeof(stepper_t));
+#ifdef ENABLE_LASER_RASTER
+    raster_flush();
+#endif
+#ifdef USE_KINEMATICS
+    memcpy(prep.joint_steps, sys_position, sizeof(sys_position));
+#endif
     st.exec_segment     = NULL;
     pl_block            = NULL;  // Planner block pointer used by segment buffer
+#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+    st.amass_level = 0xff;
+#endif
     segment_buffer_tail = 0;
     segment_buffer_head = 0;  // empty = tail
     segment_next_head   = 1;
     busy                = false;
     st.step_outbits     = 0;
-    st.dir_outbits      = dir_invert_mask->get();  // Initialize direction bits to default.
+    st.dir_outbits      = st_ctx.dir_invert_mask;  // Initialize direction bits to default.
+    st.dir_pending      = true;                    // The pins may not match them yet
+#ifdef HOMING_PARALLEL_SQUARING
+    ganged_motor_lock[PRIMARY_MOTOR] = 0;
+    ganged_motor_lock[GANGED_MOTOR]  = 0;
+#    ifdef USE_RMT_STEPS
+    rmt_locked_channels = 0;
+#    endif
+#endif
+    st_prep_unlock();
+#ifdef ENABLE_AUX_STREAM
+    st_aux_wake_up();  // After a jog cancel the auxiliary axis goes on, after an abort it has stopped
+#endif
     // TODO do we need to turn step pins off?
 }
 
+#ifdef USE_KINEMATICS
+void st_sync_joint_steps() {
+    st_prep_lock();
+    memcpy(prep.joint_steps, sys_position, sizeof(sys_position));
+    st_prep_unlock();
+}
+#endif
+
+#if !defined(USE_RMT_STEPS) && !defined(USE_MCPWM_STEPS)
+// Adds a step pin to the GPIO tables. Returns false if it is not a GPIO pin.
+static bool stepper_gpio_add_motor(uint8_t axis, uint8_t pin, int motor, bool ganged) {
+    if (pin == UNDEFINED_PIN) {
+        return true;
+    }
+    if (pin >= NATIVE_GPIO_PINS) {
+        return false;
+    }
+    for (int mode = 0; mode < 3; mode++) {
+        if (ganged && mode == int(motor == PRIMARY_MOTOR ? SquaringMode::B : SquaringMode::A)) {
+            continue;  // The squaring mode leaves the pin of this motor alone
+        }
+        for (int mask = 0; mask < (1 << MAX_N_AXIS); mask++) {
+            step_gpio_t& entry = step_gpio[mode][mask];
+            if ((mask ^ step_gpio_invert) & bit(axis)) {
+                entry.set[pin / 32] |= bit(pin % 32);
+            } else {
+                entry.clear[pin / 32] |= bit(pin % 32);
+            }
+        }
+    }
+    return true;
+}
+
+// Run by st_wake_up() when the step invert mask is not the one the tables were built for. The tables
+// are left unused if a step pin is on the I2S expander.
+static void stepper_gpio_build_table() {
+    memset(step_gpio, 0, sizeof(step_gpio));
+    step_gpio_invert = st_ctx.step_invert_mask;
+    bool native      = true;
+#    ifdef X_STEP_PIN
+#        ifdef X2_STEP_PIN
+    native &= stepper_gpio_add_motor(X_AXIS, X_STEP_PIN, PRIMARY_MOTOR, true);
+    native &= stepper_gpio_add_motor(X_AXIS, X2_STEP_PIN, GANGED_MOTOR, true);
+#        else
+    native &= stepper_gpio_add_motor(X_AXIS, X_STEP_PIN, PRIMARY_MOTOR, false);
+#        endif
+#    endif
+#    ifdef Y_STEP_PIN
+#        ifdef Y2_STEP_PIN
+    native &= stepper_gpio_add_motor(Y_AXIS, Y_STEP_PIN, PRIMARY_MOTOR, true);
+    native &= stepper_gpio_add_motor(Y_AXIS, Y2_STEP_PIN, GANGED_MOTOR, true);
+#        else
+    native &= stepper_gpio_add_motor(Y_AXIS, Y_STEP_PIN, PRIMARY_MOTOR, false);
+#        endif
+#    endif
+#    ifdef Z_STEP_PIN
+#        ifdef Z2_STEP_PIN
+    native &= stepper_gpio_add_motor(Z_AXIS, Z_STEP_PIN, PRIMARY_MOTOR, true);
+    native &= stepper_gpio_add_motor(Z_AXIS, Z2_STEP_PIN, GANGED_MOTOR, true);
+#        else
+    native &= stepper_gpio_add_motor(Z_AXIS, Z_STEP_PIN, PRIMARY_MOTOR, false);
+#        endif
+#    endif
+#    ifdef A_STEP_PIN
+#        ifdef A2_STEP_PIN
+    native &= stepper_gpio_add_motor(A_AXIS, A_STEP_PIN, PRIMARY_MOTOR, true);
+    native &= stepper_gpio_add_motor(A_AXIS, A2_STEP_PIN, GANGED_MOTOR, true);
+#        else
+    native &= stepper_gpio_add_motor(A_AXIS, A_STEP_PIN, PRIMARY_MOTOR, false);
+#        endif
+#    endif
+#    ifdef B_STEP_PIN
+#        ifdef B2_STEP_PIN
+    native &= stepper_gpio_add_motor(B_AXIS, B_STEP_PIN, PRIMARY_MOTOR, true);
+    native &= stepper_gpio_add_motor(B_AXIS, B2_STEP_PIN, GANGED_MOTOR, true);
+#        else
+    native &= stepper_gpio_add_motor(B_AXIS, B_STEP_PIN, PRIMARY_MOTOR, false);
+#        endif
+#    endif
+#    ifdef C_STEP_PIN
+#        ifdef C2_STEP_PIN
+    native &= stepper_gpio_add_motor(C_AXIS, C_STEP_PIN, PRIMARY_MOTOR, true);
+    native &= stepper_gpio_add_motor(C_AXIS, C2_STEP_PIN, GANGED_MOTOR, true);
+#        else
+    native &= stepper_gpio_add_motor(C_AXIS, C_STEP_PIN, PRIMARY_MOTOR, false);
+#        endif
+#    endif
+    step_gpio_state = native ? StepGpio::Ready : StepGpio::Unusable;
+}
+#endif
+
 void set_stepper_pins_on(uint8_t onMask) {
-    onMask ^= step_invert_mask->get();  // invert pins as required by invert mask
+#if !defined(USE_RMT_STEPS) && !defined(USE_MCPWM_STEPS)
+    if (step_gpio_state == StepGpio::Ready
+#    ifdef HOMING_PARALLEL_SQUARING
+        && !(ganged_motor_lock[PRIMARY_MOTOR] | ganged_motor_lock[GANGED_MOTOR])  // The tables don't know the locks
+#    endif
+    ) {
+        const step_gpio_t& entry = step_gpio[int(ganged_mode)][onMask & ((1 << MAX_N_AXIS) - 1)];
+        GPIO.out_w1ts            = entry.set[0];
+        GPIO.out_w1tc            = entry.clear[0];
+        if (entry.set[1] | entry.clear[1]) {
+            GPIO.out1_w1ts.val = entry.set[1];
+            GPIO.out1_w1tc.val = entry.clear[1];
+        }
+        return;
+    }
+#endif
+    // Steps of the primary and the ganged motors of ganged axes
+    uint8_t primaryMask = onMask;
+    uint8_t gangedMask  = onMask;
+#ifdef HOMING_PARALLEL_SQUARING
+    primaryMask &= ~ganged_motor_lock[PRIMARY_MOTOR];
+    gangedMask &= ~ganged_motor_lock[GANGED_MOTOR];
+#endif
+    onMask ^= st_ctx.step_invert_mask;  // invert pins as required by invert mask
+    primaryMask ^= st_ctx.step_invert_mask;
+    gangedMask ^= st_ctx.step_invert_mask;
 #ifdef X_STEP_PIN
 #    ifndef X2_STEP_PIN  // if not a ganged axis
     digitalWrite(X_STEP_PIN, (onMask & bit(X_AXIS)));
 #    else  // is a ganged axis
     if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::A)) {
-        digitalWrite(X_STEP_PIN, (onMask & bit(X_AXIS)));
+        digitalWrite(X_STEP_PIN, (primaryMask & bit(X_AXIS)));
     }
     if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::B)) {
-        digitalWrite(X2_STEP_PIN, (onMask & bit(X_AXIS)));
+        digitalWrite(X2_STEP_PIN, (gangedMask & bit(X_AXIS)));
     }
 #    endif
 #endif
@@ -530,10 +1794,10 @@ void set_stepper_pins_on(uint8_t onMask) {
     digitalWrite(Y_STEP_PIN, (onMask & bit(Y_AXIS)));
 #    else  // is a ganged axis
     if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::A)) {
-        digitalWrite(Y_STEP_PIN, (onMask & bit(Y_AXIS)));
+        digitalWrite(Y_STEP_PIN, (primaryMask & bit(Y_AXIS)));
     }
     if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::B)) {
-        digitalWrite(Y2_STEP_PIN, (onMask & bit(Y_AXIS)));
+        digitalWrite(Y2_STEP_PIN, (gangedMask & bit(Y_AXIS)));
     }
 #    endif
 #endif
@@ -543,10 +1807,10 @@ void set_stepper_pins_on(uint8_t onMask) {
     digitalWrite(Z_STEP_PIN, (onMask & bit(Z_AXIS)));
 #    else  // is a ganged axis
     if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::A)) {
-        digitalWrite(Z_STEP_PIN, (onMask & bit(Z_AXIS)));
+        digitalWrite(Z_STEP_PIN, (primaryMask & bit(Z_AXIS)));
     }
     if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::B)) {
-        digitalWrite(Z2_STEP_PIN, (onMask & bit(Z_AXIS)));
+        digitalWrite(Z2_STEP_PIN, (gangedMask & bit(Z_AXIS)));
     }
 #    endif
 #endif
@@ -556,10 +1820,10 @@ void set_stepper_pins_on(uint8_t onMask) {
     digitalWrite(A_STEP_PIN, (onMask & bit(A_AXIS)));
 #    else  // is a ganged axis
     if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::A)) {
-        digitalWrite(A_STEP_PIN, (onMask & bit(A_AXIS)));
+        digitalWrite(A_STEP_PIN, (primaryMask & bit(A_AXIS)));
     }
     if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::B)) {
-        digitalWrite(A2_STEP_PIN, (onMask & bit(A_AXIS)));
+        digitalWrite(A2_STEP_PIN, (gangedMask & bit(A_AXIS)));
     }
 #    endif
 #endif
@@ -569,10 +1833,10 @@ void set_stepper_pins_on(uint8_t onMask) {
     digitalWrite(B_STEP_PIN, (onMask & bit(B_AXIS)));
 #    else  // is a ganged axis
     if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::A)) {
-        digitalWrite(B_STEP_PIN, (onMask & bit(B_AXIS)));
+        digitalWrite(B_STEP_PIN, (primaryMask & bit(B_AXIS)));
     }
     if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::B)) {
-        digitalWrite(B2_STEP_PIN, (onMask & bit(B_AXIS)));
+        digitalWrite(B2_STEP_PIN, (gangedMask & bit(B_AXIS)));
     }
 #    endif
 #endif
@@ -582,10 +1846,10 @@ void set_stepper_pins_on(uint8_t onMask) {
     digitalWrite(C_STEP_PIN, (onMask & bit(C_AXIS)));
 #    else  // is a ganged axis
     if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::A)) {
-        digitalWrite(C_STEP_PIN, (onMask & bit(C_AXIS)));
+        digitalWrite(C_STEP_PIN, (primaryMask & bit(C_AXIS)));
     }
     if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::B)) {
-        digitalWrite(C2_STEP_PIN, (onMask & bit(C_AXIS)));
+        digitalWrite(C2_STEP_PIN, (gangedMask & bit(C_AXIS)));
     }
 #    endif
 #endif
@@ -593,121 +1857,268 @@ void set_stepper_pins_on(uint8_t onMask) {
 //#endif
 
 #ifdef USE_RMT_STEPS
-inline IRAM_ATTR static void stepperRMT_Outputs() {
-#    ifdef X_STEP_PIN
-    if (st.step_outbits & bit(X_AXIS)) {
-#        ifndef X2_STEP_PIN  // if not a ganged axis
-        RMT.conf_ch[rmt_chan_num[X_AXIS][PRIMARY_MOTOR]].conf1.mem_rd_rst = 1;
-        RMT.conf_ch[rmt_chan_num[X_AXIS][PRIMARY_MOTOR]].conf1.tx_start   = 1;
-#        else  // it is a ganged axis
-        if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::A)) {
-            RMT.conf_ch[rmt_chan_num[X_AXIS][PRIMARY_MOTOR]].conf1.mem_rd_rst = 1;
-            RMT.conf_ch[rmt_chan_num[X_AXIS][PRIMARY_MOTOR]].conf1.tx_start   = 1;
-        }
-        if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::B)) {
-            RMT.conf_ch[rmt_chan_num[X_AXIS][GANGED_MOTOR]].conf1.mem_rd_rst = 1;
-            RMT.conf_ch[rmt_chan_num[X_AXIS][GANGED_MOTOR]].conf1.tx_start   = 1;
+static void stepper_rmt_add_axis(uint8_t axis, bool ganged) {
+    for (int mode = 0; mode < 3; mode++) {
+        uint8_t bits = 0;
+        if (!ganged || mode != int(SquaringMode::B)) {
+            bits |= bit(rmt_chan_num[axis][PRIMARY_MOTOR]);
+        }
+        if (ganged && mode != int(SquaringMode::A)) {
+            bits |= bit(rmt_chan_num[axis][GANGED_MOTOR]);
+        }
+        for (int mask = 0; mask < (1 << MAX_N_AXIS); mask++) {
+            if (mask & bit(axis)) {
+                rmt_start_bits[mode][mask] |= bits;
+            }
         }
-#        endif
     }
+}
+
+// The RMT channels are assigned by init_motors(), so this runs on the first st_wake_up().
+static void stepper_rmt_build_table() {
+    memset(rmt_start_bits, 0, sizeof(rmt_start_bits));
+#    ifdef X_STEP_PIN
+#        ifdef X2_STEP_PIN
+    stepper_rmt_add_axis(X_AXIS, true);
+#        else
+    stepper_rmt_add_axis(X_AXIS, false);
+#        endif
 #    endif
 #    ifdef Y_STEP_PIN
-    if (st.step_outbits & bit(Y_AXIS)) {
-#        ifndef Y2_STEP_PIN  // if not a ganged axis
-        RMT.conf_ch[rmt_chan_num[Y_AXIS][PRIMARY_MOTOR]].conf1.mem_rd_rst = 1;
-        RMT.conf_ch[rmt_chan_num[Y_AXIS][PRIMARY_MOTOR]].conf1.tx_start   = 1;
-#        else  // it is a ganged axis
-        if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::A)) {
-            RMT.conf_ch[rmt_chan_num[Y_AXIS][PRIMARY_MOTOR]].conf1.mem_rd_rst = 1;
-            RMT.conf_ch[rmt_chan_num[Y_AXIS][PRIMARY_MOTOR]].conf1.tx_start   = 1;
-        }
-        if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::B)) {
-            RMT.conf_ch[rmt_chan_num[Y_AXIS][GANGED_MOTOR]].conf1.mem_rd_rst = 1;
-            RMT.conf_ch[rmt_chan_num[Y_AXIS][GANGED_MOTOR]].conf1.tx_start   = 1;
-        }
+#        ifdef Y2_STEP_PIN
+    stepper_rmt_add_axis(Y_AXIS, true);
+#        else
+    stepper_rmt_add_axis(Y_AXIS, false);
 #        endif
-    }
 #    endif
-
 #    ifdef Z_STEP_PIN
-    if (st.step_outbits & bit(Z_AXIS)) {
-#        ifndef Z2_STEP_PIN  // if not a ganged axis
-        RMT.conf_ch[rmt_chan_num[Z_AXIS][PRIMARY_MOTOR]].conf1.mem_rd_rst = 1;
-        RMT.conf_ch[rmt_chan_num[Z_AXIS][PRIMARY_MOTOR]].conf1.tx_start   = 1;
-#        else  // it is a ganged axis
-        if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::A)) {
-            RMT.conf_ch[rmt_chan_num[Z_AXIS][PRIMARY_MOTOR]].conf1.mem_rd_rst = 1;
-            RMT.conf_ch[rmt_chan_num[Z_AXIS][PRIMARY_MOTOR]].conf1.tx_start   = 1;
-        }
-        if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::B)) {
-            RMT.conf_ch[rmt_chan_num[Z_AXIS][GANGED_MOTOR]].conf1.mem_rd_rst = 1;
-            RMT.conf_ch[rmt_chan_num[Z_AXIS][GANGED_MOTOR]].conf1.tx_start   = 1;
-        }
+#        ifdef Z2_STEP_PIN
+    stepper_rmt_add_axis(Z_AXIS, true);
+#        else
+    stepper_rmt_add_axis(Z_AXIS, false);
 #        endif
-    }
 #    endif
-
 #    ifdef A_STEP_PIN
-    if (st.step_outbits & bit(A_AXIS)) {
-#        ifndef A2_STEP_PIN  // if not a ganged axis
-        RMT.conf_ch[rmt_chan_num[A_AXIS][PRIMARY_MOTOR]].conf1.mem_rd_rst = 1;
-        RMT.conf_ch[rmt_chan_num[A_AXIS][PRIMARY_MOTOR]].conf1.tx_start   = 1;
-#        else  // it is a ganged axis
-        if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::A)) {
-            RMT.conf_ch[rmt_chan_num[A_AXIS][PRIMARY_MOTOR]].conf1.mem_rd_rst = 1;
-            RMT.conf_ch[rmt_chan_num[A_AXIS][PRIMARY_MOTOR]].conf1.tx_start   = 1;
-        }
-        if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::B)) {
-            RMT.conf_ch[rmt_chan_num[A_AXIS][GANGED_MOTOR]].conf1.mem_rd_rst = 1;
-            RMT.conf_ch[rmt_chan_num[A_AXIS][GANGED_MOTOR]].conf1.tx_start   = 1;
-        }
+#        ifdef A2_STEP_PIN
+    stepper_rmt_add_axis(A_AXIS, true);
+#        else
+    stepper_rmt_add_axis(A_AXIS, false);
 #        endif
-    }
 #    endif
-
 #    ifdef B_STEP_PIN
-    if (st.step_outbits & bit(B_AXIS)) {
-#        ifndef Z2_STEP_PIN  // if not a ganged axis
-        RMT.conf_ch[rmt_chan_num[B_AXIS][PRIMARY_MOTOR]].conf1.mem_rd_rst = 1;
-        RMT.conf_ch[rmt_chan_num[B_AXIS][PRIMARY_MOTOR]].conf1.tx_start   = 1;
-#        else  // it is a ganged axis
-        if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::A)) {
-            RMT.conf_ch[rmt_chan_num[B_AXIS][PRIMARY_MOTOR]].conf1.mem_rd_rst = 1;
-            RMT.conf_ch[rmt_chan_num[B_AXIS][PRIMARY_MOTOR]].conf1.tx_start   = 1;
-        }
-        if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::B)) {
-            RMT.conf_ch[rmt_chan_num[B_AXIS][GANGED_MOTOR]].conf1.mem_rd_rst = 1;
-            RMT.conf_ch[rmt_chan_num[B_AXIS][GANGED_MOTOR]].conf1.tx_start   = 1;
-        }
+#        ifdef B2_STEP_PIN
+    stepper_rmt_add_axis(B_AXIS, true);
+#        else
+    stepper_rmt_add_axis(B_AXIS, false);
 #        endif
-    }
 #    endif
-
 #    ifdef C_STEP_PIN
-    if (st.step_outbits & bit(C_AXIS)) {
-#        ifndef Z2_STEP_PIN  // if not a ganged axis
-        RMT.conf_ch[rmt_chan_num[C_AXIS][PRIMARY_MOTOR]].conf1.mem_rd_rst = 1;
-        RMT.conf_ch[rmt_chan_num[C_AXIS][PRIMARY_MOTOR]].conf1.tx_start   = 1;
-#        else  // it is a ganged axis
-        if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::A)) {
-            RMT.conf_ch[rmt_chan_num[C_AXIS][PRIMARY_MOTOR]].conf1.mem_rd_rst = 1;
-            RMT.conf_ch[rmt_chan_num[C_AXIS][PRIMARY_MOTOR]].conf1.tx_start   = 1;
-        }
-        if ((ganged_mode == SquaringMode::Dual) || (ganged_mode == SquaringMode::B)) {
-            RMT.conf_ch[rmt_chan_num[C_AXIS][GANGED_MOTOR]].conf1.mem_rd_rst = 1;
-            RMT.conf_ch[rmt_chan_num[C_AXIS][GANGED_MOTOR]].conf1.tx_start   = 1;
+#        ifdef C2_STEP_PIN
+    stepper_rmt_add_axis(C_AXIS, true);
+#        else
+    stepper_rmt_add_axis(C_AXIS, false);
+#        endif
+#    endif
+    rmt_start_bits_built = true;
+}
+
+// Writes item 0 of a channel, its step pulse after delay ticks
+static inline void IRAM_ATTR stepperRMT_FirstItem(int chan, uint32_t delay) {
+    rmt_item32_t item;
+    item.level0                     = RMT.conf_ch[chan].conf1.idle_out_lv;
+    item.duration0                  = delay;
+    item.level1                     = !item.level0;
+    item.duration1                  = st_ctx.pulse_microseconds * TICKS_PER_MICROSECOND;
+    RMTMEM.chan[chan].data32[0].val = item.val;
+}
+
+inline IRAM_ATTR static void stepperRMT_Outputs() {
+    uint8_t channels = rmt_start_bits[int(ganged_mode)][st.step_outbits & ((1 << MAX_N_AXIS) - 1)];
+#    ifdef HOMING_PARALLEL_SQUARING
+    channels &= ~rmt_locked_channels;
+#    endif
+    // Right after a direction change, the pulses start after the direction setup time
+    uint8_t delayed = st.dir_setup ? channels : 0;
+    if (delayed != rmt_delayed_channels) {
+        uint32_t setup = st_ctx.dir_delay_microseconds * TICKS_PER_MICROSECOND;
+        setup          = setup > RMT_STEP_DELAY_TICKS ? setup : RMT_STEP_DELAY_TICKS;
+        for (uint8_t todo = rmt_delayed_channels & ~delayed; todo; todo &= todo - 1) {
+            stepperRMT_FirstItem(__builtin_ctz(todo), RMT_STEP_DELAY_TICKS);
+        }
+        for (uint8_t todo = delayed & ~rmt_delayed_channels; todo; todo &= todo - 1) {
+            stepperRMT_FirstItem(__builtin_ctz(todo), setup);
         }
+        rmt_delayed_channels = delayed;
+    }
+#    ifdef RMT_STEP_BURST
+    st.burst_extra = 0;
+    // A single pulse ends after item 0
+    uint8_t ended = channels & rmt_burst_channels;
+    rmt_burst_channels &= ~ended;
+    while (ended) {
+        int chan = __builtin_ctz(ended);
+        ended &= ended - 1;
+        RMTMEM.chan[chan].data32[1].val = 0;
+    }
+#    endif
+    while (channels) {
+        int chan = __builtin_ctz(channels);
+        channels &= channels - 1;
+        RMT.conf_ch[chan].conf1.mem_rd_rst = 1;
+        RMT.conf_ch[chan].conf1.tx_start   = 1;
+    }
+}
+
+#    ifdef RMT_STEP_BURST
+// Starts a run of st.burst_steps pulses, st.burst_period apart, on the channels of the stepping axes.
+// Item 0 is the pulse after the direction delay, as for a single step, then each item is the space
+// after a pulse and the next pulse, and the end marker stops the channel right after the last pulse,
+// before the step timer calls for the next output. The items are written before any channel starts so
+// the axes stay in step.
+inline IRAM_ATTR static void stepperRMT_Burst() {
+    uint8_t channels = rmt_start_bits[int(ganged_mode)][st.step_outbits & ((1 << MAX_N_AXIS) - 1)];
+#        ifdef HOMING_PARALLEL_SQUARING
+    channels &= ~rmt_locked_channels;
 #        endif
+    uint32_t pulse = st_ctx.pulse_microseconds * TICKS_PER_MICROSECOND;
+    for (uint8_t todo = channels; todo; todo &= todo - 1) {
+        int          chan = __builtin_ctz(todo);
+        rmt_item32_t item;
+        item.level0    = RMT.conf_ch[chan].conf1.idle_out_lv;
+        item.duration0 = RMT_STEP_DELAY_TICKS;
+        item.level1    = !item.level0;
+        item.duration1 = pulse;
+
+        RMTMEM.chan[chan].data32[0].val = item.val;
+        item.duration0                  = st.burst_period - pulse;
+        for (int i = 1; i < st.burst_steps; i++) {
+            RMTMEM.chan[chan].data32[i].val = item.val;
+        }
+        RMTMEM.chan[chan].data32[st.burst_steps].val = 0;
+    }
+    rmt_burst_channels |= channels;
+    rmt_delayed_channels &= ~channels;
+    while (channels) {
+        int chan = __builtin_ctz(channels);
+        channels &= channels - 1;
+        RMT.conf_ch[chan].conf1.mem_rd_rst = 1;
+        RMT.conf_ch[chan].conf1.tx_start   = 1;
+    }
+    st.burst_extra = (st.burst_steps - 1) * st.burst_period;
+    st.burst_steps = 0;
+}
+#    endif
+#endif
+
+#ifdef USE_MCPWM_STEPS
+// Steps of the primary and the ganged motors, as set_stepper_pins_on() has them
+static inline void IRAM_ATTR stepper_mcpwm_motors(uint8_t bits, uint8_t& primary, uint8_t& ganged) {
+    primary = bits;
+    ganged  = bits;
+    if (ganged_mode == SquaringMode::A) {
+        ganged = 0;
+    } else if (ganged_mode == SquaringMode::B) {
+        primary &= ~mcpwm_steps_ganged_axes();
     }
+#    ifdef HOMING_PARALLEL_SQUARING
+    primary &= ~ganged_motor_lock[PRIMARY_MOTOR];
+    ganged &= ~ganged_motor_lock[GANGED_MOTOR];
 #    endif
 }
+
+// Step timer ticks since the alarm that started this ISR
+static inline uint32_t IRAM_ATTR stepper_timer_ticks() {
+    TIMERG0.hw_timer[STEP_TIMER_INDEX].update = 1;
+    return TIMERG0.hw_timer[STEP_TIMER_INDEX].cnt_low;
+}
+
+inline IRAM_ATTR static void stepperMCPWM_Outputs() {
+    st.burst_extra = 0;
+    uint8_t primary, ganged;
+    stepper_mcpwm_motors(st.step_outbits, primary, ganged);
+    // Right after a direction change, the pulses start after the direction setup time
+    uint32_t delay = MCPWM_STEP_DELAY_TICKS;
+    if (st.dir_setup && st_ctx.dir_delay_microseconds * TICKS_PER_MICROSECOND > delay) {
+        delay = st_ctx.dir_delay_microseconds * TICKS_PER_MICROSECOND;
+    }
+    mcpwm_steps_pulse(primary, ganged, delay);
+}
+
+// Starts a run of st.burst_steps pulses, st.burst_period apart, and has the step timer wake the ISR
+// half way through the last period of the run to stop it. The wake is put off by as much as this ISR
+// started late, as the run starts that late too.
+inline IRAM_ATTR static void stepperMCPWM_Burst() {
+    uint8_t primary, ganged;
+    stepper_mcpwm_motors(st.step_outbits, primary, ganged);
+    uint32_t late = stepper_timer_ticks();
+    mcpwm_steps_run(primary, ganged, st.burst_period);
+    st.run_period  = st.burst_period;
+    st.run_axes    = st.step_outbits;
+    st.run_dir     = st.dir_outbits ^ st_ctx.dir_invert_mask;
+    st.burst_extra = (st.burst_steps - 1) * st.burst_period;
+    st.run_wake    = st.burst_extra + st.burst_period / 2 + late;
+    st.burst_steps = 0;
+}
+
+// Stops the run at the end of the period it is in. That is its last period unless this ISR started
+// half a period late or more, then the timers made a step in each period after it, and the machine
+// position counts them.
+inline IRAM_ATTR static void stepperMCPWM_Stop() {
+    uint32_t late = stepper_timer_ticks();
+    mcpwm_steps_stop();
+    uint32_t extra = (st.run_period / 2 + late) / st.run_period;
+    if (extra) {
+        system_position_write_begin();
+        for (int axis = 0; axis < MAX_N_AXIS; axis++) {
+            if (st.run_axes & bit(axis)) {
+                sys_position[axis] += (st.run_dir & bit(axis)) ? -int32_t(extra) : int32_t(extra);
+            }
+        }
+        system_position_write_end();
+        burst_stats.extra_steps += extra;
+    }
+    Stepper_Timer_WritePeriod(st.run_rest);
+    st.timer_period = st.run_rest;
+    st.run_rest     = 0;
+}
 #endif
 
+// Starts the timer for the first stage of the idle lock that applies. Called from the step ISR too.
+static void stepper_idle_schedule(uint8_t lock_ms) {
+    if (!stepper_idle_timer) {
+        return;
+    }
+    esp_timer_stop(stepper_idle_timer);
+    if (motors_have_idle_hold() && (lock_ms == 0xff || lock_ms > TRINAMIC_IDLE_HOLD_MS)) {
+        stepper_idle_stage = IdleStage::Hold;
+        esp_timer_start_once(stepper_idle_timer, TRINAMIC_IDLE_HOLD_MS * 1000);
+    } else if (lock_ms != 0xff) {
+        stepper_idle_stage = IdleStage::Disable;
+        esp_timer_start_once(stepper_idle_timer, lock_ms * 1000);
+    }
+}
+
 // Stepper shutdown
 void st_go_idle() {
     // Disable Stepper Driver Interrupt. Allow Stepper Port Reset Interrupt to finish, if active.
     Stepper_Timer_Stop();
     busy = false;
+#ifdef ENABLE_AUX_STREAM
+    stepper_running = false;
+#endif
+#ifdef USE_MCPWM_STEPS
+    mcpwm_steps_stop();  // A run cut short leaves the position ahead of the motors, as any abort in motion
+    st.run_wake    = 0;
+    st.run_rest    = 0;
+    st.burst_extra = 0;
+#endif
+#ifdef STEP_BURST
+    // Don't make the next cycle wait for a run that went out in this one
+    if (st.timer_period != st.segment_period) {
+        Stepper_Timer_WritePeriod(st.segment_period);
+        st.timer_period = st.segment_period;
+    }
+#endif
 
     // Set stepper driver idle state, disabled or enabled, depending on settings and circumstances.
     if (((stepper_idle_lock_time->get() != 0xff) || sys_rt_exec_alarm != ExecAlarm::None || sys.state == State::Sleep) &&
@@ -718,12 +2129,17 @@ void st_go_idle() {
         if (sys.state == State::Sleep || sys_rt_exec_alarm != ExecAlarm::None) {
             motors_set_disable(true);
         } else {
-            stepper_idle         = true;  // esp32 work around for disable in main loop
-            stepper_idle_counter = esp_timer_get_time() + (stepper_idle_lock_time->get() * 1000);  // * 1000 because the time is in uSecs
-            // after idle countdown will be disabled in protocol loop
+            uint8_t lock_ms      = stepper_idle_lock_time->get();
+            stepper_idle         = true;
+            stepper_idle_counter = esp_timer_get_time() + (lock_ms * 1000);  // * 1000 because the time is in uSecs
+            stepper_idle_schedule(lock_ms);
         }
     } else {
         motors_set_disable(false);
+        if (sys.state != State::Homing) {
+            stepper_idle = true;  // $1=255 keeps the drivers enabled, but the hold current can still drop
+            stepper_idle_schedule(0xff);
+        }
     }
 
     set_stepper_pins_on(0);
@@ -742,6 +2158,7 @@ void st_update_plan_block_parameters() {
 #ifdef PARKING_ENABLE
 // Changes the run state of the step segment buffer to execute the special parking motion.
 void st_parking_setup_buffer() {
+    st_prep_lock();
     // Store step execution data of partially completed block, if necessary.
     if (prep.recalculate_flag.holdPartialBlock) {
         prep.last_st_block_index  = prep.st_block_index;
@@ -753,10 +2170,12 @@ void st_parking_setup_buffer() {
     prep.recalculate_flag.parking     = 1;
     prep.recalculate_flag.recalculate = 0;
     pl_block                          = NULL;  // Always reset parking motion to reload new block.
+    st_prep_unlock();
 }
 
 // Restores the step segment buffer to the normal run state after a parking motion.
 void st_parking_restore_buffer() {
+    st_prep_lock();
     // Restore step execution data and flags of partially completed block, if necessary.
     if (prep.recalculate_flag.holdPartialBlock) {
         st_prep_block                          = &st_block_buffer[prep.last_st_block_index];
@@ -766,12 +2185,13 @@ void st_parking_restore_buffer() {
         prep.step_per_mm                       = prep.last_step_per_mm;
         prep.recalculate_flag.holdPartialBlock = 1;
         prep.recalculate_flag.recalculate      = 1;
-        prep.req_mm_increment                  = REQ_MM_INCREMENT_SCALAR / prep.step_per_mm;  // Recompute this value.
+        prep.req_mm_increment                  = req_mm_increment_scalar / prep.step_per_mm;  // Recompute this value.
     } else {
         prep.recalculate_flag = {};
     }
 
     pl_block = NULL;  // Set to reload next block.
+    st_prep_unlock();
 }
 #endif
 
@@ -794,11 +2214,452 @@ static uint8_t st_next_block_index(uint8_t block_index) {
    Currently, the segment buffer conservatively holds roughly up to 40-50 msec of steps.
    NOTE: Computation units are in steps, millimeters, and minutes.
 */
-void st_prep_buffer() {
+static void st_prep_segments();
+
+// Sets the step timing of a segment from its time per step event (min/step), and its AMASS level.
+static void MOTION_IRAM st_prep_segment_rate(segment_t* segment, float inv_rate) {
+    // Compute CPU cycles per step for the prepped segment.
+    uint32_t cycles = ceilf((TICKS_PER_MICROSECOND * 1000000 * 60) * inv_rate);  // (cycles/step)
+
+#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+    // Compute step timing and multi-axis smoothing level.
+    // NOTE: AMASS overdrives the timer with each level, so only one prescalar is required.
+    // Each level doubles the range of the one below it, so the level is the bit length of cycles/AMASS_LEVEL1.
+    uint32_t bins        = cycles / AMASS_LEVEL1;
+    uint8_t  level       = bins ? 32 - __builtin_clz(bins) : 0;
+    segment->amass_level = MIN(level, MAX_AMASS_LEVEL);
+    if (segment->amass_level) {
+        cycles >>= segment->amass_level;
+        segment->n_step <<= segment->amass_level;
+    }
+    segment->cycles_per_tick = cycles;
+#else
+    segment->amass_level     = 0;
+    segment->cycles_per_tick = cycles;  // The 32-bit step timer covers any step rate without a prescaler
+#endif
+}
+
+#if defined(USE_KINEMATICS) || defined(INPUT_SHAPING) || defined(JOG_VELOCITY_MODE)
+// Gives the segment its own Bresenham data, for the signed steps of each axis. Used where the axes do
+// not keep the proportions of the planner block. Returns the step events to execute.
+static uint32_t MOTION_IRAM st_prep_segment_steps(segment_t* segment, const int32_t* axis_steps) {
+    if (prep.st_block_used) {
+        uint8_t pwm_rate_adjusted           = st_prep_block->is_pwm_rate_adjusted;
+        prep.st_block_index                 = st_next_block_index(prep.st_block_index);
+        st_prep_block                       = &st_block_buffer[prep.st_block_index];
+        st_prep_block->is_pwm_rate_adjusted = pwm_rate_adjusted;
+#    ifdef SYNC_USER_OUTPUTS
+        st_prep_block->output_events = 0;  // Fired with the first segment of the planner block
+#    endif
+#    ifdef SPINDLE_STATE_IN_PLANNER
+        st_prep_block->apply_state = false;
+#    endif
+    }
+    prep.st_block_used            = true;
+    segment->st_block_index       = prep.st_block_index;
+    st_prep_block->direction_bits = 0;
+
+    uint32_t step_event_count = 0;
+    uint8_t  idx;
+    auto     n_axis = motion_config.n_axis;
+    for (idx = 0; idx < n_axis; idx++) {
+        int32_t steps = axis_steps[idx];
+        if (steps < 0) {
+            st_prep_block->direction_bits |= bit(idx);
+            steps = -steps;
+        }
+#    ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+        st_prep_block->steps[idx] = steps << MAX_AMASS_LEVEL;
+#    else
+        st_prep_block->steps[idx] = steps;
+#    endif
+        step_event_count = MAX(step_event_count, uint32_t(steps));
+    }
+    // A segment without steps still has to take its time.
+    if (step_event_count == 0) {
+        step_event_count = 1;
+    }
+#    ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+    st_prep_block->step_event_count = step_event_count << MAX_AMASS_LEVEL;
+#    else
+    st_prep_block->step_event_count = step_event_count;
+#    endif
+    segment->n_step = step_event_count;
+    return step_event_count;
+}
+#endif
+
+#ifdef USE_KINEMATICS
+// Converts the end of a segment of a kinematic block to joint steps. The joint direction changes
+// along the block, so every segment gets its own Bresenham data. Returns the step events to execute.
+static uint32_t st_prep_joint_segment(segment_t* segment, float mm_remaining) {
+    float   mpos[MAX_N_AXIS];
+    float   joints[MAX_N_AXIS];
+    int32_t steps[MAX_N_AXIS];
+    uint8_t idx;
+    auto    n_axis = motion_config.n_axis;
+    for (idx = 0; idx < n_axis; idx++) {
+        mpos[idx]   = pl_block->target[idx] - pl_block->unit_vec[idx] * mm_remaining;
+        joints[idx] = prep.joint_steps[idx] * motion_config.mm_per_step[idx];
+    }
+    // An unreachable point leaves the joints where they are until the path is back in reach.
+    bool reachable = kinematics->inverse(mpos, joints);
+    for (idx = 0; idx < n_axis; idx++) {
+        steps[idx] = reachable ? lround(joints[idx] * motion_config.steps_per_mm[idx]) - prep.joint_steps[idx] : 0;
+        prep.joint_steps[idx] += steps[idx];
+    }
+    return st_prep_segment_steps(segment, steps);
+}
+#endif
+
+#ifdef INPUT_SHAPING
+// Commanded position of the axes at mm_remaining from the end of the block, in steps.
+static void st_shaper_commanded(float mm_remaining, float* position) {
+    float left = prep.step_per_mm * mm_remaining / pl_block->step_event_count;  // Part of the block still to go
+    for (uint8_t idx = 0; idx < motion_config.n_axis; idx++) {
+        float steps   = (pl_block->direction_bits & bit(idx)) ? -float(pl_block->steps[idx]) : float(pl_block->steps[idx]);
+        position[idx] = prep.shaper_block_end[idx] - steps * left;
+    }
+}
+
+// Steps a segment of a shaped block to the shaped position at its end. Where the command comes to a
+// stop, the segment, and the settle segments after it, hold it there until the shaped motion has
+// caught up: *dt grows by the time the segment holds. Returns the step events to execute.
+static uint32_t st_prep_shaped_segment(segment_t* segment, float mm_remaining, float* dt) {
+    float   commanded[MAX_N_AXIS];
+    float   shaped[MAX_N_AXIS];
+    int32_t steps[MAX_N_AXIS];
+    uint8_t idx;
+    auto    n_axis = motion_config.n_axis;
+    if (!prep.shaper_moving) {
+        // Starting from rest, where the shaped motion and the command agree.
+        st_shaper_commanded(pl_block->millimeters, commanded);
+        shaper_reset(commanded);
+        prep.shaper_moving = true;
+    }
+    st_shaper_commanded(mm_remaining, commanded);
+    if (prep.shaper_settle > 0.0) {
+        // Settle segment, *dt is taken from the settle time.
+        shaper_add(*dt, commanded);
+        prep.shaper_settle -= *dt;
+    } else {
+        shaper_add(*dt, commanded);
+        if (mm_remaining == prep.mm_complete && prep.current_speed == 0.0) {
+            float hold         = MIN(shaper_duration(), MAX(dt_segment - *dt, 0.0f));
+            prep.shaper_settle = shaper_duration() - hold;
+            shaper_add(hold, commanded);
+            *dt += hold;
+        }
+    }
+    if (prep.shaper_settle <= 0.0 && mm_remaining == prep.mm_complete && prep.current_speed == 0.0) {
+        memcpy(shaped, commanded, sizeof(shaped));  // Caught up
+        prep.shaper_settle = 0.0;
+        prep.shaper_moving = false;
+    } else {
+        shaper_output(shaped);
+    }
+    for (idx = 0; idx < n_axis; idx++) {
+        steps[idx] = lround(shaped[idx]) - prep.shaper_steps[idx];
+        prep.shaper_steps[idx] += steps[idx];
+    }
+    return st_prep_segment_steps(segment, steps);
+}
+#endif
+
+#ifdef ENABLE_SPINDLE_SYNC
+// Prepares one DT_SEGMENT of a spindle synchronized block. The speed is the spindle speed times the
+// pitch, plus the speed that closes the lag behind the spindle position predicted for the segment at
+// half the block acceleration. It changes by at most the block acceleration, and stays low enough to
+// reach the exit speed by the end of the block. Sets dt and returns the distance left in the block.
+static float st_prep_sync_segment(float* dt) {
+    float rev_per_min;
+    float revs      = spindle_sync_revolutions(prep.sync_time, &rev_per_min);
+    float pitch     = pl_block->sync_pitch;
+    float accel     = pl_block->acceleration;
+    float lag       = (revs - prep.sync_revs) * pitch;  // mm behind the spindle
+    float speed     = rev_per_min * pitch + copysignf(sqrtf(accel * fabsf(lag)), lag);
+    float time_var  = DT_SEGMENT;
+    float max_delta = accel * time_var;
+
+    speed = MIN(speed, prep.current_speed + max_delta);
+    speed = MAX(speed, prep.current_speed - max_delta);
+    speed = MIN(speed, sqrtf(prep.exit_speed * prep.exit_speed + 2 * accel * pl_block->millimeters));
+    speed = MIN(speed, pl_block->rapid_rate);
+    speed = MAX(speed, prep.req_mm_increment / time_var);  // At least one step per segment
+
+    float mm           = speed * time_var;
+    float mm_remaining = pl_block->millimeters - mm;
+    if (mm_remaining <= 0.0) {
+        mm           = pl_block->millimeters;
+        time_var     = mm / speed;
+        mm_remaining = 0.0;
+    }
+    prep.current_speed = speed;
+    prep.sync_revs += mm / pitch;
+    prep.sync_time += time_var;
+    *dt = time_var;
+    return mm_remaining;
+}
+#endif
+
+#ifdef JERK_LIMITED_PROFILE
+// Builds the S-curve of a ramp from the current distance and speed to end_mm and end_speed. The ramp
+// keeps the duration of the planner's linear ramp, so it covers the same distance at the same average
+// speed: the acceleration rises at the jerk limit, holds and falls back symmetrically. When the ramp is
+// too short for that at the block jerk, the acceleration rises and falls over half the ramp each.
+// A replanned block keeps its running S-curve if it still ends at end_speed and end_mm. A running
+// acceleration may also end earlier, before latest_mm: the replan starts from the speed of the S-curve,
+// which lags the linear ramp, so the planner's new ramp end would otherwise restart it on every replan.
+static void st_scurve_begin(uint8_t ramp, float mm_remaining, float end_mm, float end_speed, float latest_mm) {
+    if (prep.scurve_valid && prep.scurve_ramp == ramp && prep.scurve_v1 == end_speed &&
+        (prep.scurve_end_mm == end_mm || (ramp == RAMP_ACCEL && prep.scurve_end_mm >= latest_mm))) {
+        return;
+    }
+    float v0    = prep.current_speed;
+    float delta = end_speed - v0;
+    float dv    = fabsf(delta);
+    float sum   = v0 + end_speed;
+    float time  = sum > 0.0 ? 2.0 * (mm_remaining - end_mm) / sum : 0.0;
+
+    prep.scurve_valid    = true;
+    prep.scurve_ramp     = ramp;
+    prep.scurve_start_mm = mm_remaining;
+    prep.scurve_end_mm   = end_mm;
+    prep.scurve_v0       = v0;
+    prep.scurve_v1       = end_speed;
+    prep.scurve_time     = MAX(time, 0.0f);
+    prep.scurve_t        = 0.0;
+
+    float jerk = pl_block->jerk;
+    float tj, accel;
+    if (prep.scurve_time == 0.0 || dv == 0.0) {
+        tj    = 0.5 * prep.scurve_time;
+        accel = 0.0;
+    } else if (jerk * prep.scurve_time * prep.scurve_time <= 4.0 * dv) {
+        tj    = 0.5 * prep.scurve_time;
+        accel = dv / tj;
+    } else {
+        accel = 0.5 * jerk * (prep.scurve_time - sqrtf(MAX(prep.scurve_time * prep.scurve_time - 4.0 * dv / jerk, 0.0f)));
+        tj    = accel / jerk;
+    }
+    prep.scurve_tj    = tj;
+    prep.scurve_accel = copysignf(accel, delta);
+    prep.scurve_jerk  = tj > 0.0 ? prep.scurve_accel / tj : 0.0;
+}
+
+// Advances the S-curve by *time_var and sets the distance from the end of the block and the speed
+// reached. At the end of the ramp, *time_var is cut to the time it had left and true is returned.
+static bool st_scurve_advance(float* time_var, float* mm_remaining) {
+    float t = prep.scurve_t + *time_var;
+    if (t >= prep.scurve_time) {
+        *time_var          = prep.scurve_time - prep.scurve_t;
+        *mm_remaining      = prep.scurve_end_mm;
+        prep.current_speed = prep.scurve_v1;
+        prep.scurve_valid  = false;
+        return true;
+    }
+    prep.scurve_t = t;
+
+    float v0 = prep.scurve_v0;
+    float tj = prep.scurve_tj;
+    float j  = prep.scurve_jerk;
+    float speed, mm;
+    if (t < tj) {  // Acceleration rising
+        speed = v0 + 0.5 * j * t * t;
+        mm    = t * (v0 + j * t * t / 6.0);
+    } else if (t <= prep.scurve_time - tj) {  // Constant acceleration
+        float v_tj = v0 + 0.5 * j * tj * tj;
+        float dt   = t - tj;
+        speed      = v_tj + prep.scurve_accel * dt;
+        mm         = tj * (v0 + j * tj * tj / 6.0) + dt * (v_tj + 0.5 * prep.scurve_accel * dt);
+    } else {  // Acceleration falling, measured back from the end of the ramp
+        float u = prep.scurve_time - t;
+        speed   = prep.scurve_v1 - 0.5 * j * u * u;
+        mm      = prep.scurve_start_mm - prep.scurve_end_mm - u * (prep.scurve_v1 - j * u * u / 6.0);
+    }
+    *mm_remaining      = prep.scurve_start_mm - mm;
+    prep.current_speed = speed;
+    return false;
+}
+#endif
+
+#ifdef JOG_VELOCITY_MODE
+bool st_jog_velocity(const float* velocity, uint32_t keepalive_ms) {
+    st_prep_lock();
+    if (prep.jog_active && (sys.step_control & (STEP_CONTROL_EXECUTE_HOLD | STEP_CONTROL_END_MOTION))) {
+        st_prep_unlock();
+        return false;  // Stopping, the cycle stop ends it
+    }
+    auto n_axis = motion_config.n_axis;
+    if (!prep.jog_active) {
+        // Called in Idle, so the segment buffer is empty and the machine position is final.
+        prep.jog_active      = true;
+        prep.jog_soft_limits = motion_config.soft_limits;
+        for (uint8_t idx = 0; idx < n_axis; idx++) {
+            prep.jog_velocity[idx] = 0.0;
+            prep.jog_steps[idx]    = sys_position[idx];
+            prep.jog_fraction[idx] = 0.0;
+        }
+        prep.st_block_index                 = st_next_block_index(prep.st_block_index);
+        st_prep_block                       = &st_block_buffer[prep.st_block_index];
+        st_prep_block->is_pwm_rate_adjusted = false;
+#    ifdef SYNC_USER_OUTPUTS
+        st_prep_block->output_events = 0;
+#    endif
+#    ifdef SPINDLE_STATE_IN_PLANNER
+        st_prep_block->apply_state = false;
+#    endif
+        prep.st_block_used = false;
+        prep.current_speed = 0.0;
+    }
+    for (uint8_t idx = 0; idx < n_axis; idx++) {
+        prep.jog_target[idx] = velocity[idx];
+    }
+    prep.jog_deadline = esp_timer_get_time() + int64_t(keepalive_ms) * 1000;
+    st_prep_unlock();
+    return true;
+}
+
+bool st_jog_velocity_active() {
+    return prep.jog_active;
+}
+
+// Moves the jog velocities toward target for one segment of dt. The changes of all axes are scaled
+// by the same factor to keep each within its acceleration, so the velocity changes along a straight
+// line and a stop stays on the path.
+static void st_jog_accelerate(const float* target, float* velocity, float dt) {
+    auto  n_axis = motion_config.n_axis;
+    float scale  = 1.0;
+    for (uint8_t idx = 0; idx < n_axis; idx++) {
+        float delta     = fabsf(target[idx] - prep.jog_velocity[idx]);
+        float max_delta = motion_config.acceleration[idx] * 60 * 60 * dt;
+        if (delta > max_delta) {
+            scale = MIN(scale, max_delta / delta);
+        }
+    }
+    for (uint8_t idx = 0; idx < n_axis; idx++) {
+        velocity[idx] = prep.jog_velocity[idx] + (target[idx] - prep.jog_velocity[idx]) * scale;
+    }
+}
+
+// True if the jog can run the next segment at velocity and still come to a stop within the soft
+// limits. Every axis stops in the time the slowest one needs, as st_jog_accelerate() stops them.
+static bool st_jog_within_limits(const float* velocity, float dt) {
+    auto  n_axis    = motion_config.n_axis;
+    float stop_time = 0.0;
+    for (uint8_t idx = 0; idx < n_axis; idx++) {
+        stop_time = MAX(stop_time, fabsf(velocity[idx]) / (motion_config.acceleration[idx] * 60 * 60));
+    }
+    for (uint8_t idx = 0; idx < n_axis; idx++) {
+        if (velocity[idx] == 0.0 && prep.jog_velocity[idx] == 0.0) {
+            continue;
+        }
+        float min_mpos = motion_config.travel_min[idx];
+        float max_mpos = motion_config.travel_max[idx];
+        float position = prep.jog_steps[idx] * motion_config.mm_per_step[idx];
+        float distance = 0.5 * (prep.jog_velocity[idx] + velocity[idx]) * dt + 0.5 * velocity[idx] * stop_time;
+        // An axis already past a limit may still move back.
+        if ((distance > 0.0 && position + distance > max_mpos) || (distance < 0.0 && position + distance < min_mpos)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Prepares the segments of a velocity jog. Every DT_SEGMENT the axis velocities move toward the jog
+// target, or toward a stop on a hold, a jog cancel, a missed keep-alive or the soft limits. Only
+// JOG_VELOCITY_SEGMENTS are queued, which bounds the time a change takes to reach the motors. Once
+// the jog rests, the motion ends and the cycle stop returns to Idle.
+static void st_prep_jog_segments() {
+    auto n_axis = motion_config.n_axis;
+    bool stop   = (sys.step_control & STEP_CONTROL_EXECUTE_HOLD) || esp_timer_get_time() > prep.jog_deadline;
+    while (segment_buffer_tail != segment_next_head) {
+        int queued = int(segment_buffer_head) - int(segment_buffer_tail);
+        if (queued < 0) {
+            queued += SEGMENT_BUFFER_SIZE;  // Head has wrapped around
+        }
+        if (queued >= JOG_VELOCITY_SEGMENTS) {
+            return;
+        }
+
+        float   dt = DT_SEGMENT;
+        float   target[MAX_N_AXIS];
+        float   velocity[MAX_N_AXIS];
+        int32_t steps[MAX_N_AXIS];
+        uint8_t idx;
+        for (idx = 0; idx < n_axis; idx++) {
+            target[idx] = stop ? 0.0 : prep.jog_target[idx];
+        }
+        st_jog_accelerate(target, velocity, dt);
+        if (prep.jog_soft_limits && !st_jog_within_limits(velocity, dt)) {
+            memset(target, 0, sizeof(target));
+            st_jog_accelerate(target, velocity, dt);
+        }
+
+        bool  moving = false;
+        float speed  = 0.0;
+        for (idx = 0; idx < n_axis; idx++) {
+            float mm               = 0.5 * (prep.jog_velocity[idx] + velocity[idx]) * dt;
+            float move             = mm * motion_config.steps_per_mm[idx] + prep.jog_fraction[idx];
+            steps[idx]             = lround(move);
+            prep.jog_fraction[idx] = move - steps[idx];
+            prep.jog_velocity[idx] = velocity[idx];
+            prep.jog_steps[idx] += steps[idx];
+            speed += velocity[idx] * velocity[idx];
+            moving |= velocity[idx] != 0.0 || target[idx] != 0.0;
+        }
+        prep.current_speed = sqrtf(speed);
+
+        segment_t* prep_segment = &segment_buffer[segment_buffer_head];
+        uint32_t   step_events  = st_prep_segment_steps(prep_segment, steps);
+#    ifdef ENABLE_LASER_RASTER
+        st_prep_block->raster = NULL;
+#    endif
+#    ifdef ENABLE_SPINDLE_SYNC
+        st_prep_block->sync_start = false;
+#    endif
+        prep_segment->spindle_rpm  = prep.current_spindle_rpm;
+        prep_segment->spindle_duty = prep.current_spindle_duty;
+#    ifdef LASER_POWER_RAMP
+        prep_segment->spindle_duty_step = 0;
+#    endif
+        st_prep_segment_rate(prep_segment, dt / step_events);
+
+        metric_inc(Metric::Segments);
+        segment_buffer_head = segment_next_head;
+        if (++segment_next_head == SEGMENT_BUFFER_SIZE) {
+            segment_next_head = 0;
+        }
+        if (!moving) {
+            bit_true(sys.step_control, STEP_CONTROL_END_MOTION);  // At rest and told to stay there
+            return;
+        }
+    }
+}
+#endif
+
+void MOTION_IRAM st_prep_buffer() {
+    HOT_PATH_PROFILE(HotPath::StPrepBuffer);
     // Block step prep buffer, while in a suspend state and there is no suspend motion to execute.
     if (bit_istrue(sys.step_control, STEP_CONTROL_END_MOTION)) {
         return;
     }
+    st_prep_lock();
+    st_prep_segments();
+    st_prep_unlock();
+}
+
+static void MOTION_IRAM st_prep_segments() {
+    // Re-check now that the lock is held. A feed hold may have ended the motion in the meantime.
+    if (bit_istrue(sys.step_control, STEP_CONTROL_END_MOTION)) {
+        return;
+    }
+#ifdef JOG_VELOCITY_MODE
+    if (prep.jog_active) {
+        st_prep_jog_segments();
+        return;
+    }
+#endif
 
     while (segment_buffer_tail != segment_next_head) {  // Check if we need to fill the buffer.
         // Determine if we need to load a new planner block or if the block needs to be recomputed.
@@ -833,8 +2694,37 @@ void st_prep_buffer() {
                 // segment buffer finishes the prepped block, but the stepper ISR is still executing it.
                 st_prep_block                 = &st_block_buffer[prep.st_block_index];
                 st_prep_block->direction_bits = pl_block->direction_bits;
+#ifdef SYNC_USER_OUTPUTS
+                st_prep_block->output_events = pl_block->output_events;
+#endif
+#ifdef SPINDLE_STATE_IN_PLANNER
+                st_prep_block->apply_state = pl_block->motion.applyState;
+                st_prep_block->spindle     = pl_block->spindle;
+                st_prep_block->coolant     = pl_block->coolant;
+                if (pl_block->motion.applyState) {
+                    bit_true(sys.step_control, STEP_CONTROL_UPDATE_SPINDLE_RPM);  // The segments take the new speed
+                }
+#endif
+#ifdef ENABLE_LASER_RASTER
+                st_prep_block->raster = pl_block->raster;
+#endif
+#ifdef ENABLE_SPINDLE_SYNC
+                st_prep_block->sync_start = pl_block->sync_start;
+                if (pl_block->sync_start) {
+                    prep.sync_active = true;
+                    prep.sync_time   = 0.0f;
+                    prep.sync_revs   = 0.0f;
+                    spindle_sync_mark_start();  // Estimate until the step ISR starts the block
+                } else if (prep.sync_active && pl_block->sync_pitch == 0.0f) {
+                    // Leaving the chain. Its last segment may be slower than the planned junction speed.
+                    prep.sync_active = false;
+                    if (prep.current_speed * prep.current_speed < pl_block->entry_speed_sqr) {
+                        pl_block->entry_speed_sqr = prep.current_speed * prep.current_speed;
+                    }
+                }
+#endif
                 uint8_t idx;
-                auto    n_axis = number_axis->get();
+                auto    n_axis = motion_config.n_axis;
 #ifndef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
                 for (idx = 0; idx < n_axis; idx++) {
                     st_prep_block->steps[idx] = pl_block->steps[idx];
@@ -848,25 +2738,56 @@ void st_prep_buffer() {
                     st_prep_block->steps[idx] = pl_block->steps[idx] << MAX_AMASS_LEVEL;
                 }
                 st_prep_block->step_event_count = pl_block->step_event_count << MAX_AMASS_LEVEL;
+#endif
+#if defined(USE_KINEMATICS) || defined(INPUT_SHAPING) || defined(JOG_VELOCITY_MODE)
+                prep.st_block_used = false;
+#endif
+#ifdef USE_KINEMATICS
+                if (!pl_block->kinematic) {
+                    // Joint space blocks are stepped as planned.
+                    for (idx = 0; idx < n_axis; idx++) {
+                        int32_t steps = pl_block->steps[idx];
+                        prep.joint_steps[idx] += (pl_block->direction_bits & bit(idx)) ? -steps : steps;
+                    }
+                }
+#endif
+#ifdef JERK_LIMITED_PROFILE
+                prep.scurve_valid = false;
+#endif
+#ifdef INPUT_SHAPING
+                if (!prep.shaper_moving && segment_buffer_tail == segment_buffer_head) {
+                    // All steps are out and the command rests. Start over from the machine position,
+                    // which homing sets directly.
+                    memcpy(prep.shaper_block_end, sys_position, sizeof(sys_position));
+                    memcpy(prep.shaper_steps, sys_position, sizeof(sys_position));
+                }
+                for (idx = 0; idx < n_axis; idx++) {
+                    int32_t steps = pl_block->steps[idx];
+                    prep.shaper_block_end[idx] += (pl_block->direction_bits & bit(idx)) ? -steps : steps;
+                }
+                prep.shaping = shaper_refresh() && !(sys.step_control & STEP_CONTROL_EXECUTE_SYS_MOTION);
+                if (!prep.shaping) {
+                    memcpy(prep.shaper_steps, prep.shaper_block_end, sizeof(prep.shaper_steps));
+                }
 #endif
                 // Initialize segment buffer data for generating the segments.
                 prep.steps_remaining  = (float)pl_block->step_event_count;
                 prep.step_per_mm      = prep.steps_remaining / pl_block->millimeters;
-                prep.req_mm_increment = REQ_MM_INCREMENT_SCALAR / prep.step_per_mm;
-                prep.dt_remainder     = 0.0;  // Reset for new segment block
+                prep.req_mm_increment = req_mm_increment_scalar / prep.step_per_mm;
+                prep.dt_remainder     = 0.0f;  // Reset for new segment block
                 if ((sys.step_control & STEP_CONTROL_EXECUTE_HOLD) || prep.recalculate_flag.decelOverride) {
                     // New block loaded mid-hold. Override planner block entry speed to enforce deceleration.
                     prep.current_speed                  = prep.exit_speed;
                     pl_block->entry_speed_sqr           = prep.exit_speed * prep.exit_speed;
                     prep.recalculate_flag.decelOverride = 0;
                 } else {
-                    prep.current_speed = sqrt(pl_block->entry_speed_sqr);
+                    prep.current_speed = sqrtf(pl_block->entry_speed_sqr);
                 }
 
                 if (spindle->isRateAdjusted()) {  //   laser_mode->get() {
                     if (pl_block->spindle == SpindleState::Ccw) {
                         // Pre-compute inverse programmed rate to speed up PWM updating per step segment.
-                        prep.inv_rate                       = 1.0 / pl_block->programmed_rate;
+                        prep.inv_rate                       = 1.0f / pl_block->programmed_rate;
                         st_prep_block->is_pwm_rate_adjusted = true;
                     }
                 }
@@ -877,20 +2798,27 @@ void st_prep_buffer() {
              planner has updated it. For a commanded forced-deceleration, such as from a feed
              hold, override the planner velocities and decelerate to the target exit speed.
             */
-            prep.mm_complete  = 0.0;  // Default velocity profile complete at 0.0mm from end of block.
-            float inv_2_accel = 0.5 / pl_block->acceleration;
+            prep.mm_complete  = 0.0f;  // Default velocity profile complete at 0.0mm from end of block.
+            float inv_2_accel = 0.5f / pl_block->acceleration;
             if (sys.step_control & STEP_CONTROL_EXECUTE_HOLD) {  // [Forced Deceleration to Zero Velocity]
+#ifdef ENABLE_SPINDLE_SYNC
+                prep.sync_active = false;  // The spindle keeps turning, so the chain cannot be resumed in sync
+#endif
                 // Compute velocity profile parameters for a feed hold in-progress. This profile overrides
                 // the planner block profile, enforcing a deceleration to zero speed.
                 prep.ramp_type = RAMP_DECEL;
+#ifdef ENABLE_REALTIME_TRACE
+                rt_trace_hop(RtCmd::FeedHold, RtHop::Decel, true);
+                rt_trace_hop(RtCmd::JogCancel, RtHop::Decel, true);
+#endif
                 // Compute decelerate distance relative to end of block.
                 float decel_dist = pl_block->millimeters - inv_2_accel * pl_block->entry_speed_sqr;
-                if (decel_dist < 0.0) {
+                if (decel_dist < 0.0f) {
                     // Deceleration through entire planner block. End of feed hold is not in this block.
-                    prep.exit_speed = sqrt(pl_block->entry_speed_sqr - 2 * pl_block->acceleration * pl_block->millimeters);
+                    prep.exit_speed = sqrtf(pl_block->entry_speed_sqr - 2 * pl_block->acceleration * pl_block->millimeters);
                 } else {
                     prep.mm_complete = decel_dist;  // End of feed hold.
-                    prep.exit_speed  = 0.0;
+                    prep.exit_speed  = 0.0f;
                 }
             } else {  // [Normal Operation]
                 // Compute or recompute velocity profile parameters of the prepped planner block.
@@ -899,23 +2827,36 @@ void st_prep_buffer() {
                 float exit_speed_sqr;
                 float nominal_speed;
                 if (sys.step_control & STEP_CONTROL_EXECUTE_SYS_MOTION) {
-                    prep.exit_speed = exit_speed_sqr = 0.0;  // Enforce stop at end of system motion.
+                    prep.exit_speed = exit_speed_sqr = 0.0f;  // Enforce stop at end of system motion.
                 } else {
                     exit_speed_sqr  = plan_get_exec_block_exit_speed_sqr();
-                    prep.exit_speed = sqrt(exit_speed_sqr);
+                    prep.exit_speed = sqrtf(exit_speed_sqr);
                 }
+#ifdef ENABLE_SIMULATOR
+                prep.depth_limited = sim_active() && !(sys.step_control & STEP_CONTROL_EXECUTE_SYS_MOTION) &&
+                                     plan_exec_block_exit_limited_by_depth();
+#endif
 
-                nominal_speed            = plan_compute_profile_nominal_speed(pl_block);
-                float nominal_speed_sqr  = nominal_speed * nominal_speed;
-                float intersect_distance = 0.5 * (pl_block->millimeters + inv_2_accel * (pl_block->entry_speed_sqr - exit_speed_sqr));
+                nominal_speed           = plan_compute_profile_nominal_speed(pl_block);
+                float nominal_speed_sqr = nominal_speed * nominal_speed;
+#ifdef PLANNER_LAZY_OVERRIDES
+                if (exit_speed_sqr > nominal_speed_sqr) {
+                    // Planned before an override reduction. Leave at the new nominal speed and start the
+                    // next block from there, as after a deceleration override.
+                    exit_speed_sqr                      = nominal_speed_sqr;
+                    prep.exit_speed                     = nominal_speed;
+                    prep.recalculate_flag.decelOverride = 1;
+                }
+#endif
+                float intersect_distance = 0.5f * (pl_block->millimeters + inv_2_accel * (pl_block->entry_speed_sqr - exit_speed_sqr));
                 if (pl_block->entry_speed_sqr > nominal_speed_sqr) {  // Only occurs during override reductions.
                     prep.accelerate_until = pl_block->millimeters - inv_2_accel * (pl_block->entry_speed_sqr - nominal_speed_sqr);
-                    if (prep.accelerate_until <= 0.0) {  // Deceleration-only.
+                    if (prep.accelerate_until <= 0.0f) {  // Deceleration-only.
                         prep.ramp_type = RAMP_DECEL;
                         // prep.decelerate_after = pl_block->millimeters;
                         // prep.maximum_speed = prep.current_speed;
                         // Compute override block exit speed since it doesn't match the planner exit speed.
-                        prep.exit_speed = sqrt(pl_block->entry_speed_sqr - 2 * pl_block->acceleration * pl_block->millimeters);
+                        prep.exit_speed = sqrtf(pl_block->entry_speed_sqr - 2 * pl_block->acceleration * pl_block->millimeters);
                         prep.recalculate_flag.decelOverride = 1;  // Flag to load next block as deceleration override.
                         // TODO: Determine correct handling of parameters in deceleration-only.
                         // Can be tricky since entry speed will be current speed, as in feed holds.
@@ -926,7 +2867,7 @@ void st_prep_buffer() {
                         prep.maximum_speed    = nominal_speed;
                         prep.ramp_type        = RAMP_DECEL_OVERRIDE;
                     }
-                } else if (intersect_distance > 0.0) {
+                } else if (intersect_distance > 0.0f) {
                     if (intersect_distance < pl_block->millimeters) {  // Either trapezoid or triangle types
                         // NOTE: For acceleration-cruise and cruise-only types, following calculation will be 0.0.
                         prep.decelerate_after = inv_2_accel * (nominal_speed_sqr - exit_speed_sqr);
@@ -942,7 +2883,7 @@ void st_prep_buffer() {
                         } else {  // Triangle type
                             prep.accelerate_until = intersect_distance;
                             prep.decelerate_after = intersect_distance;
-                            prep.maximum_speed    = sqrt(2.0 * pl_block->acceleration * intersect_distance + exit_speed_sqr);
+                            prep.maximum_speed    = sqrtf(2.0f * pl_block->acceleration * intersect_distance + exit_speed_sqr);
                         }
                     } else {  // Deceleration-only type
                         prep.ramp_type = RAMP_DECEL;
@@ -950,7 +2891,7 @@ void st_prep_buffer() {
                         // prep.maximum_speed = prep.current_speed;
                     }
                 } else {  // Acceleration-only type
-                    prep.accelerate_until = 0.0;
+                    prep.accelerate_until = 0.0f;
                     // prep.decelerate_after = 0.0;
                     prep.maximum_speed = prep.exit_speed;
                 }
@@ -979,28 +2920,70 @@ void st_prep_buffer() {
           the end of planner block (typical) or mid-block at the end of a forced deceleration,
           such as from a feed hold.
         */
-        float dt_max   = DT_SEGMENT;                                // Maximum segment time
-        float dt       = 0.0;                                       // Initialize segment time
+        float dt_max   = dt_segment;                                // Maximum segment time
+#ifdef ADAPTIVE_SEGMENT_TIMING
+        // Constant velocity needs no ramp resolution, so cruise segments can be longer. The 32-bit step
+        // count holds any length, so high step rates get the full multiplier too.
+        if (prep.ramp_type == RAMP_CRUISE) {
+            dt_max = dt_segment * SEGMENT_CRUISE_MULTIPLIER;
+        }
+#endif
+#ifdef USE_KINEMATICS
+        // Each segment runs straight in joint space. Shorten it so the chord stays on the path.
+        if (pl_block->kinematic) {
+            float speed = MAX(prep.current_speed, prep.maximum_speed);
+            if (speed > 0.0f) {
+                float length     = speed * dt_max;
+                float max_length = kinematics->segment_length();
+                if (max_length > 0.0f && length > max_length) {
+                    length = max_length;
+                }
+                float   start[MAX_N_AXIS];
+                float   joints[MAX_N_AXIS];
+                uint8_t idx;
+                for (idx = 0; idx < motion_config.n_axis; idx++) {
+                    start[idx]  = pl_block->target[idx] - pl_block->unit_vec[idx] * pl_block->millimeters;
+                    joints[idx] = prep.joint_steps[idx] * motion_config.mm_per_step[idx];
+                }
+                length = kinematics_chord_length(start, joints, pl_block->unit_vec, length);
+                dt_max = MIN(dt_max, length / speed);
+            }
+        }
+#endif
+#ifdef LASER_POWER_RAMP
+        float segment_start_speed = prep.current_speed;  // Laser power is ramped from here to the segment end
+#endif
+        float dt       = 0.0f;                                       // Initialize segment time
         float time_var = dt_max;                                    // Time worker variable
         float mm_var;                                               // mm-Distance worker variable
         float speed_var;                                            // Speed worker variable
         float mm_remaining = pl_block->millimeters;                 // New segment distance from end of block.
         float minimum_mm   = mm_remaining - prep.req_mm_increment;  // Guarantee at least one step.
 
-        if (minimum_mm < 0.0) {
-            minimum_mm = 0.0;
+        if (minimum_mm < 0.0f) {
+            minimum_mm = 0.0f;
         }
 
+#ifdef ENABLE_SPINDLE_SYNC
+        if (prep.sync_active) {
+            mm_remaining = st_prep_sync_segment(&dt);
+        } else
+#endif
+#ifdef INPUT_SHAPING
+        if (prep.shaper_settle > 0.0f) {
+            dt = MIN(prep.shaper_settle, dt_max);  // Settle segment, the command rests at the end of its profile
+        } else
+#endif
         do {
             switch (prep.ramp_type) {
                 case RAMP_DECEL_OVERRIDE:
                     speed_var = pl_block->acceleration * time_var;
-                    mm_var    = time_var * (prep.current_speed - 0.5 * speed_var);
+                    mm_var    = time_var * (prep.current_speed - 0.5f * speed_var);
                     mm_remaining -= mm_var;
                     if ((mm_remaining < prep.accelerate_until) || (mm_var <= 0)) {
                         // Cruise or cruise-deceleration types only for deceleration override.
                         mm_remaining       = prep.accelerate_until;  // NOTE: 0.0 at EOB
-                        time_var           = 2.0 * (pl_block->millimeters - mm_remaining) / (prep.current_speed + prep.maximum_speed);
+                        time_var           = 2.0f * (pl_block->millimeters - mm_remaining) / (prep.current_speed + prep.maximum_speed);
                         prep.ramp_type     = RAMP_CRUISE;
                         prep.current_speed = prep.maximum_speed;
                     } else {  // Mid-deceleration override ramp.
@@ -1009,12 +2992,23 @@ void st_prep_buffer() {
                     break;
                 case RAMP_ACCEL:
                     // NOTE: Acceleration ramp only computes during first do-while loop.
+#ifdef JERK_LIMITED_PROFILE
+                    if (pl_block->jerk > 0.0f) {
+                        // decelerate_after is only set when the ramp ends before the end of the block.
+                        float latest_mm = prep.accelerate_until > 0.0f ? prep.decelerate_after : 0.0f;
+                        st_scurve_begin(RAMP_ACCEL, mm_remaining, prep.accelerate_until, prep.maximum_speed, latest_mm);
+                        if (st_scurve_advance(&time_var, &mm_remaining)) {  // End of acceleration ramp.
+                            prep.ramp_type = (mm_remaining == prep.decelerate_after) ? RAMP_DECEL : RAMP_CRUISE;
+                        }
+                        break;
+                    }
+#endif
                     speed_var = pl_block->acceleration * time_var;
-                    mm_remaining -= time_var * (prep.current_speed + 0.5 * speed_var);
+                    mm_remaining -= time_var * (prep.current_speed + 0.5f * speed_var);
                     if (mm_remaining < prep.accelerate_until) {  // End of acceleration ramp.
                         // Acceleration-cruise, acceleration-deceleration ramp junction, or end of block.
                         mm_remaining = prep.accelerate_until;  // NOTE: 0.0 at EOB
-                        time_var     = 2.0 * (pl_block->millimeters - mm_remaining) / (prep.current_speed + prep.maximum_speed);
+                        time_var     = 2.0f * (pl_block->millimeters - mm_remaining) / (prep.current_speed + prep.maximum_speed);
                         if (mm_remaining == prep.decelerate_after) {
                             prep.ramp_type = RAMP_DECEL;
                         } else {
@@ -1040,11 +3034,18 @@ void st_prep_buffer() {
                     }
                     break;
                 default:  // case RAMP_DECEL:
+#ifdef JERK_LIMITED_PROFILE
+                    if (pl_block->jerk > 0.0f) {
+                        st_scurve_begin(RAMP_DECEL, mm_remaining, prep.mm_complete, prep.exit_speed, prep.mm_complete);
+                        st_scurve_advance(&time_var, &mm_remaining);
+                        break;
+                    }
+#endif
                     // NOTE: mm_var used as a misc worker variable to prevent errors when near zero speed.
                     speed_var = pl_block->acceleration * time_var;  // Used as delta speed (mm/min)
                     if (prep.current_speed > speed_var) {           // Check if at or below zero speed.
                         // Compute distance from end of segment to end of block.
-                        mm_var = mm_remaining - time_var * (prep.current_speed - 0.5 * speed_var);  // (mm)
+                        mm_var = mm_remaining - time_var * (prep.current_speed - 0.5f * speed_var);  // (mm)
                         if (mm_var > prep.mm_complete) {                                            // Typical case. In deceleration ramp.
                             mm_remaining = mm_var;
                             prep.current_speed -= speed_var;
@@ -1052,19 +3053,25 @@ void st_prep_buffer() {
                         }
                     }
                     // Otherwise, at end of block or end of forced-deceleration.
-                    time_var           = 2.0 * (mm_remaining - prep.mm_complete) / (prep.current_speed + prep.exit_speed);
+                    time_var           = 2.0f * (mm_remaining - prep.mm_complete) / (prep.current_speed + prep.exit_speed);
                     mm_remaining       = prep.mm_complete;
                     prep.current_speed = prep.exit_speed;
             }
 
             dt += time_var;  // Add computed ramp time to total segment time.
+#ifdef ADAPTIVE_SEGMENT_TIMING
+            // Left the cruise. Fall back to normal length segments so the deceleration keeps its resolution.
+            if (dt_max > dt_segment && prep.ramp_type != RAMP_CRUISE) {
+                dt_max = MAX(dt, dt_segment);
+            }
+#endif
             if (dt < dt_max) {
                 time_var = dt_max - dt;  // **Incomplete** At ramp junction.
             } else {
                 if (mm_remaining > minimum_mm) {  // Check for very slow segments with zero steps.
                     // Increase segment time to ensure at least one step in segment. Override and loop
                     // through distance calculations until minimum_mm or mm_complete.
-                    dt_max += DT_SEGMENT;
+                    dt_max += dt_segment;
                     time_var = dt_max - dt;
                 } else {
                     break;  // **Complete** Exit loop. Segment execution time maxed.
@@ -1075,11 +3082,18 @@ void st_prep_buffer() {
         /* -----------------------------------------------------------------------------------
           Compute spindle speed PWM output for step segment
         */
+#ifdef LASER_POWER_RAMP
+        float   ramp_start_rpm = -1.0f;  // Rate adjusted power at the segment start. Negative without a ramp.
+        int32_t ramp_duty      = 0;     // Fast output duty change from the segment start to its end
+#endif
         if (st_prep_block->is_pwm_rate_adjusted || (sys.step_control & STEP_CONTROL_UPDATE_SPINDLE_RPM)) {
             if (pl_block->spindle != SpindleState::Disable) {
                 float rpm = pl_block->spindle_speed;
                 // NOTE: Feed and rapid overrides are independent of PWM value and do not alter laser power/rate.
                 if (st_prep_block->is_pwm_rate_adjusted) {
+#ifdef LASER_POWER_RAMP
+                    ramp_start_rpm = rpm * (segment_start_speed * prep.inv_rate);
+#endif
                     rpm *= (prep.current_speed * prep.inv_rate);
                     //grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "RPM %.2f", rpm);
                     //grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Rates CV %.2f IV %.2f RPM %.2f", prep.current_speed, prep.inv_rate, rpm);
@@ -1089,12 +3103,31 @@ void st_prep_buffer() {
 
                 prep.current_spindle_rpm = rpm;
             } else {
-                sys.spindle_speed        = 0.0;
-                prep.current_spindle_rpm = 0.0;
+                sys.spindle_speed        = 0.0f;
+                prep.current_spindle_rpm = 0.0f;
+            }
+            // Lasers get their output duty computed here, so the ISR only has to write it.
+            Spindles::PWM* fast_spindle = spindle->fast_output();
+            if (fast_spindle) {
+                prep.current_spindle_duty = fast_spindle->rpm_to_duty(prep.current_spindle_rpm);
+#ifdef LASER_POWER_RAMP
+                if (ramp_start_rpm >= 0.0f) {
+                    ramp_duty = int32_t(prep.current_spindle_duty) - int32_t(fast_spindle->rpm_to_duty(ramp_start_rpm));
+                }
+#endif
             }
             bit_false(sys.step_control, STEP_CONTROL_UPDATE_SPINDLE_RPM);
         }
-        prep_segment->spindle_rpm = prep.current_spindle_rpm;  // Reload segment PWM value
+        prep_segment->spindle_rpm  = prep.current_spindle_rpm;  // Reload segment PWM value
+        prep_segment->spindle_duty = prep.current_spindle_duty;
+#ifdef LASER_POWER_RAMP
+#    ifdef ENABLE_LASER_RASTER
+        if (pl_block->raster) {
+            ramp_duty = 0;  // The pixels set the power
+        }
+#    endif
+        prep_segment->spindle_duty -= ramp_duty;  // The ISR starts the segment at its start duty
+#endif
 
         /* -----------------------------------------------------------------------------------
            Compute segment step rate, steps to execute, and apply necessary rate corrections.
@@ -1107,12 +3140,17 @@ void st_prep_buffer() {
            supported by Grbl (i.e. exceeding 10 meters axis travel at 200 step/mm).
         */
         float step_dist_remaining    = prep.step_per_mm * mm_remaining;             // Convert mm_remaining to steps
-        float n_steps_remaining      = ceil(step_dist_remaining);                   // Round-up current steps remaining
-        float last_n_steps_remaining = ceil(prep.steps_remaining);                  // Round-up last steps remaining
+        float n_steps_remaining      = ceilf(step_dist_remaining);                   // Round-up current steps remaining
+        float last_n_steps_remaining = ceilf(prep.steps_remaining);                  // Round-up last steps remaining
         prep_segment->n_step         = last_n_steps_remaining - n_steps_remaining;  // Compute number of steps to execute.
 
         // Bail if we are at the end of a feed hold and don't have a step to execute.
+#ifdef INPUT_SHAPING
+        // Shaped blocks go on, their segments move toward the shaped position and end in a settle.
+        if (prep_segment->n_step == 0 && !prep.shaping) {
+#else
         if (prep_segment->n_step == 0) {
+#endif
             if (sys.step_control & STEP_CONTROL_EXECUTE_HOLD) {
                 // Less than one step to decelerate to zero speed, but already very close. AMASS
                 // requires full steps to execute. So, just bail.
@@ -1137,49 +3175,68 @@ void st_prep_buffer() {
 
         dt += prep.dt_remainder;                                               // Apply previous segment partial step execute time
         float inv_rate = dt / (last_n_steps_remaining - step_dist_remaining);  // Compute adjusted step rate inverse
+#ifdef USE_KINEMATICS
+        if (pl_block->kinematic) {
+            // The Cartesian step count above still ends feed holds. The joint targets are whole steps,
+            // so no partial step time is carried into the next segment.
+            inv_rate          = dt / st_prep_joint_segment(prep_segment, mm_remaining);
+            n_steps_remaining = step_dist_remaining;
+        }
+#endif
+#ifdef INPUT_SHAPING
+        if (prep.shaping) {
+            // As for kinematic blocks, the step count above only tracks the command along the block.
+            uint32_t step_events = st_prep_shaped_segment(prep_segment, mm_remaining, &dt);
+            inv_rate             = dt / step_events;
+            n_steps_remaining    = step_dist_remaining;
+        }
+#endif
 
-        // Compute CPU cycles per step for the prepped segment.
-        uint32_t cycles = ceil((TICKS_PER_MICROSECOND * 1000000 * 60) * inv_rate);  // (cycles/step)
-
-#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-        // Compute step timing and multi-axis smoothing level.
-        // NOTE: AMASS overdrives the timer with each level, so only one prescalar is required.
-        if (cycles < AMASS_LEVEL1) {
-            prep_segment->amass_level = 0;
-        } else {
-            if (cycles < AMASS_LEVEL2) {
-                prep_segment->amass_level = 1;
-            } else if (cycles < AMASS_LEVEL3) {
-                prep_segment->amass_level = 2;
-            } else {
-                prep_segment->amass_level = 3;
-            }
-            cycles >>= prep_segment->amass_level;
-            prep_segment->n_step <<= prep_segment->amass_level;
+        st_prep_segment_rate(prep_segment, inv_rate);
+#ifdef LASER_POWER_RAMP
+        // Spread the duty change over the ISR ticks of the segment, so it ends at the end duty.
+        prep_segment->spindle_duty_step = 0;
+        if (ramp_duty != 0 && prep_segment->n_step != 0) {
+            prep_segment->spindle_duty_step = int32_t((int64_t(ramp_duty) << SPINDLE_DUTY_SHIFT) / prep_segment->n_step);
         }
-        if (cycles < (1UL << 16)) {
-            prep_segment->cycles_per_tick = cycles;  // < 65536 (4.1ms @ 16MHz)
-        } else {
-            prep_segment->cycles_per_tick = 0xffff;  // Just set the slowest speed possible.
+#endif
+#ifdef ENABLE_LASER_PPI
+        // Pulses along the tool path of the segment, spread over its ISR ticks. The ISR fires one each
+        // time the sum wraps.
+        prep_segment->ppi_step = 0;
+        if (laser_ppi_pulses_per_mm > 0.0f && pl_block->spindle != SpindleState::Disable && pl_block->spindle_speed > 0.0f &&
+            prep_segment->n_step != 0) {
+            float pulses           = laser_ppi_pulses_per_mm * (pl_block->millimeters - mm_remaining);
+            float step             = pulses / prep_segment->n_step * 4294967296.0f;
+            prep_segment->ppi_step = step < 4294967040.0f ? uint32_t(step) : UINT32_MAX;  // At most a pulse per tick
         }
-#else
-        // Compute step timing and timer prescalar for normal step generation.
-        if (cycles < (1UL << 16)) {             // < 65536  (4.1ms @ 16MHz)
-            prep_segment->prescaler       = 1;  // prescaler: 0
-            prep_segment->cycles_per_tick = cycles;
-        } else if (cycles < (1UL << 19)) {      // < 524288 (32.8ms@16MHz)
-            prep_segment->prescaler       = 2;  // prescaler: 8
-            prep_segment->cycles_per_tick = cycles >> 3;
-        } else {
-            prep_segment->prescaler = 3;  // prescaler: 64
-            if (cycles < (1UL << 22)) {   // < 4194304 (262ms@16MHz)
-                prep_segment->cycles_per_tick = cycles >> 6;
-            } else {  // Just set the slowest speed possible. (Around 4 step/sec.)
-                prep_segment->cycles_per_tick = 0xffff;
+#endif
+        // Tell the motors when the machine cruises. Leaving cruise is signalled as soon as a ramp is
+        // prepped, ahead of its execution. Entering it waits for a full buffer of cruise segments, so
+        // the ISR is already executing one.
+        if (prep.ramp_type == RAMP_CRUISE) {
+            if (prep.cruise_segments < SEGMENT_BUFFER_SIZE) {
+                prep.cruise_segments++;
             }
+        } else {
+            prep.cruise_segments = 0;
+        }
+        bool cruising = prep.cruise_segments >= SEGMENT_BUFFER_SIZE;
+        if (cruising != st_cruising) {
+            st_cruising = cruising;
+            motors_set_cruise(cruising);
+        }
+
+#ifdef ENABLE_SIMULATOR
+        if (sim_active()) {
+            sim_segment(pl_block->millimeters - mm_remaining,
+                        dt,
+                        plan_compute_profile_nominal_speed(pl_block),
+                        prep.depth_limited && prep.ramp_type == RAMP_DECEL);
         }
 #endif
         // Segment complete! Increment segment buffer indices, so stepper ISR can immediately execute it.
+        metric_inc(Metric::Segments);
         segment_buffer_head = segment_next_head;
         if (++segment_next_head == SEGMENT_BUFFER_SIZE) {
             segment_next_head = 0;
@@ -1188,10 +3245,15 @@ void st_prep_buffer() {
         pl_block->millimeters = mm_remaining;
         prep.steps_remaining  = n_steps_remaining;
         prep.dt_remainder     = (n_steps_remaining - step_dist_remaining) * inv_rate;
+#ifdef INPUT_SHAPING
+        if (prep.shaper_settle > 0.0f) {
+            continue;  // The command rests, but the shaped motion has not caught up with it yet.
+        }
+#endif
         // Check for exit conditions and flag to load next planner block.
         if (mm_remaining == prep.mm_complete) {
             // End of planner block or forced-termination. No more distance to be executed.
-            if (mm_remaining > 0.0) {  // At end of forced-termination.
+            if (mm_remaining > 0.0f) {  // At end of forced-termination.
                 // Reset prep parameters for resuming and then bail. Allow the stepper ISR to complete
                 // the segment queue, where realtime protocol will set new state upon receiving the
                 // cycle stop flag from the ISR. Prep_segment is blocked until then.
@@ -1232,6 +3294,42 @@ float st_get_realtime_rate() {
     }
 }
 
+// The ISR keeps running while this walks the segment buffer, so the result can be off by the part of
+// a segment executed meanwhile. That is well below what a servo update can resolve.
+void st_get_lookahead(uint32_t lead_us, float* delta) {
+    memset(delta, 0, sizeof(float) * MAX_N_AXIS);
+
+    uint64_t   ticks     = uint64_t(lead_us) * TICKS_PER_MICROSECOND;  // Step timer ticks left to account for
+    segment_t* executing = st.exec_segment;
+    uint32_t   remaining = st.step_count;
+    uint8_t    index     = segment_buffer_tail;
+    uint8_t    head      = segment_buffer_head;
+    auto       n_axis    = MachineTraits::n_axis;
+
+    while (ticks > 0 && index != head) {
+        segment_t*  segment = &segment_buffer[index];
+        st_block_t* block   = &st_block_buffer[segment->st_block_index];
+        uint32_t    events  = (segment == executing) ? remaining : segment->n_step;
+        uint32_t    period  = MAX(segment->cycles_per_tick, 1);
+        uint64_t    span    = uint64_t(events) * period;
+        float       done    = (span > ticks) ? float(ticks) / period : float(events);  // Step events executed by then
+        ticks               = (span > ticks) ? 0 : ticks - span;
+
+        for (uint8_t axis = 0; axis < n_axis; axis++) {
+#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+            float steps = float(block->steps[axis] >> segment->amass_level) * done / block->step_event_count;
+#else
+            float steps = float(block->steps[axis]) * done / block->step_event_count;
+#endif
+            delta[axis] += (block->direction_bits & bit(axis)) ? -steps : steps;
+        }
+
+        if (++index == SEGMENT_BUFFER_SIZE) {
+            index = 0;
+        }
+    }
+}
+
 void IRAM_ATTR Stepper_Timer_WritePeriod(uint64_t alarm_val) {
     if (current_stepper == ST_I2S_STREAM) {
 #ifdef USE_I2S_STEPS
@@ -1256,6 +3354,17 @@ void IRAM_ATTR Stepper_Timer_Init() {
     timer_set_counter_value(STEP_TIMER_GROUP, STEP_TIMER_INDEX, 0x00000000ULL);
     timer_enable_intr(STEP_TIMER_GROUP, STEP_TIMER_INDEX);
     timer_isr_register(STEP_TIMER_GROUP, STEP_TIMER_INDEX, onStepperDriverTimer, NULL, 0, NULL);
+#if !defined(USE_RMT_STEPS) && !defined(USE_MCPWM_STEPS)
+    // The pulse timer runs freely. Each step restarts it from 0 and arms its alarm once.
+    config.alarm_en    = TIMER_ALARM_DIS;
+    config.auto_reload = false;
+    timer_init(STEP_TIMER_GROUP, PULSE_TIMER_INDEX, &config);
+    timer_set_counter_value(STEP_TIMER_GROUP, PULSE_TIMER_INDEX, 0x00000000ULL);
+    timer_set_alarm_value(STEP_TIMER_GROUP, PULSE_TIMER_INDEX, uint64_t(st_ctx.pulse_microseconds) * TICKS_PER_MICROSECOND);
+    timer_enable_intr(STEP_TIMER_GROUP, PULSE_TIMER_INDEX);
+    timer_isr_register(STEP_TIMER_GROUP, PULSE_TIMER_INDEX, onStepPulseTimer, NULL, 0, NULL);
+    timer_start(STEP_TIMER_GROUP, PULSE_TIMER_INDEX);
+#endif
 }
 
 void IRAM_ATTR Stepper_Timer_Start() {
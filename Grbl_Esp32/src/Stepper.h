@@ -28,9 +28,51 @@
 #    define SEGMENT_BUFFER_SIZE 6
 #endif
 
+// The segment ring indices are 8 bits wide.
+static_assert(SEGMENT_BUFFER_SIZE >= 3 && SEGMENT_BUFFER_SIZE <= 255, "SEGMENT_BUFFER_SIZE must be between 3 and 255");
+
+// With ADAPTIVE_SEGMENT_TIMING, cruise segments are up to this many times longer than DT_SEGMENT.
+#ifndef SEGMENT_CRUISE_MULTIPLIER
+#    define SEGMENT_CRUISE_MULTIPLIER 4
+#endif
+
 #include "Grbl.h"
 #include "Config.h"
 
+#ifdef USE_STEPPER_PREP_TASK
+// The stepper ISR wakes the prep task when this many segments or fewer are left in the buffer.
+#    ifndef STEPPER_PREP_WATERMARK
+#        define STEPPER_PREP_WATERMARK (SEGMENT_BUFFER_SIZE / 2)
+#    endif
+#endif
+
+#ifdef JOG_VELOCITY_MODE
+// Segments a velocity jog keeps queued ahead of the step ISR. A new velocity or a jog cancel reaches the
+// motors within this many DT_SEGMENTs.
+#    ifndef JOG_VELOCITY_SEGMENTS
+#        define JOG_VELOCITY_SEGMENTS 3
+#    endif
+static_assert(JOG_VELOCITY_SEGMENTS >= 2 && JOG_VELOCITY_SEGMENTS < SEGMENT_BUFFER_SIZE,
+              "JOG_VELOCITY_SEGMENTS must be at least 2 and less than SEGMENT_BUFFER_SIZE");
+#endif
+
+#ifdef BACKLASH_COMPENSATION
+// Fastest backlash take-up, in percent of the axis max rate.
+#    ifndef BACKLASH_RATE_PERCENT
+#        define BACKLASH_RATE_PERCENT 25
+#    endif
+#endif
+
+#ifdef AXIS_ENCODER_CORRECTION
+#    ifndef ENABLE_AXIS_ENCODERS
+#        error "AXIS_ENCODER_CORRECTION requires ENABLE_AXIS_ENCODERS"
+#    endif
+// Fastest correction, in percent of the axis max rate.
+#    ifndef AXIS_ENCODER_CORRECTION_RATE_PERCENT
+#        define AXIS_ENCODER_CORRECTION_RATE_PERCENT 10
+#    endif
+#endif
+
 // Some useful constants.
 const double DT_SEGMENT              = (1.0 / (ACCELERATION_TICKS_PER_SECOND * 60.0));  // min/segment
 const double REQ_MM_INCREMENT_SCALAR = 1.25;
@@ -53,23 +95,74 @@ struct PrepFlag {
 // timer, and the CPU overhead. Level 0 (no AMASS, normal operation) frequency bin starts at the
 // Level 1 cutoff frequency and up to as fast as the CPU allows (over 30kHz in limited testing).
 // NOTE: AMASS cutoff frequency multiplied by ISR overdrive factor must not exceed maximum step frequency.
-// NOTE: Current settings are set to overdrive the ISR to no more than 16kHz, balancing CPU overhead
-// and timer accuracy.  Do not alter these settings unless you know what you are doing.
+// NOTE: The ESP32 step timer is 32 bits wide at F_STEPPER_TIMER, so the level no longer has to keep the
+// period under a 16-bit limit. Each level doubles the step rate range it covers, and a segment takes
+// the highest level whose overdriven period stays at or above the AMASS_LEVEL1 period. The defaults
+// overdrive the ISR to no more than 16kHz, balancing CPU overhead and timer accuracy.
 ///#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
-#define MAX_AMASS_LEVEL 3
+#ifndef MAX_AMASS_LEVEL
+#    define MAX_AMASS_LEVEL 3
+#endif
+#ifndef AMASS_LEVEL1_CUTOFF
+#    define AMASS_LEVEL1_CUTOFF 8000  // Hz
+#endif
 // AMASS_LEVEL0: Normal operation. No AMASS. No upper cutoff frequency. Starts at LEVEL1 cutoff frequency.
 // Note ESP32 use F_STEPPER_TIMER rather than the AVR F_CPU
-const int AMASS_LEVEL1 = (F_STEPPER_TIMER / 8000);  // Over-drives ISR (x2). Defined as F_CPU/(Cutoff frequency in Hz)
-const int AMASS_LEVEL2 = (F_STEPPER_TIMER / 4000);  // Over-drives ISR (x4)
-const int AMASS_LEVEL3 = (F_STEPPER_TIMER / 2000);  // Over-drives ISR (x8)
+const uint32_t AMASS_LEVEL1 = (F_STEPPER_TIMER / AMASS_LEVEL1_CUTOFF);  // Over-drives ISR (x2). Level n starts at AMASS_LEVEL1 << (n-1)
 
 static_assert(MAX_AMASS_LEVEL >= 1, "AMASS must have 1 or more levels to operate correctly.");
+static_assert(MAX_AMASS_LEVEL <= 8, "Step counts are shifted by MAX_AMASS_LEVEL and must fit in 32 bits.");
 //#endif
 
+#ifdef USE_RMT_STEPS
+// The RMT channels count step timer ticks. An item holds up to RMT_ITEM_MAX_TICKS at each level.
+const uint32_t RMT_ITEM_MAX_TICKS = 32767;
+#    ifdef STEP_PULSE_DELAY
+const uint32_t RMT_STEP_DELAY_TICKS = STEP_PULSE_DELAY * TICKS_PER_MICROSECOND;
+#    else
+const uint32_t RMT_STEP_DELAY_TICKS = 1;
+#    endif
+#else
+#    undef RMT_STEP_BURST  // The runs are generated by the RMT channels
+#endif
+
+#ifdef RMT_STEP_BURST
+// Longest run of steps the RMT channels generate on their own. A run is one item per step plus an end
+// marker in the channel's first 64 items, the next ones may belong to the next channel.
+#    ifndef RMT_BURST_MAX_STEPS
+#        define RMT_BURST_MAX_STEPS 63
+#    endif
+static_assert(RMT_BURST_MAX_STEPS >= 2 && RMT_BURST_MAX_STEPS <= 63, "RMT_BURST_MAX_STEPS must be between 2 and 63");
+#    define STEP_BURST_MAX_STEPS RMT_BURST_MAX_STEPS
+const uint32_t STEP_BURST_ISRS = 1;  // ISR wakes per run
+#endif
+
+#ifdef USE_MCPWM_STEPS
+// The MCPWM timers repeat the pulse on their own, so a run usually takes the rest of its segment. The
+// ISR wakes to start it and to stop it.
+#    ifndef MCPWM_BURST_MAX_STEPS
+#        define MCPWM_BURST_MAX_STEPS 4096
+#    endif
+static_assert(MCPWM_BURST_MAX_STEPS >= 2 && MCPWM_BURST_MAX_STEPS <= 65535, "MCPWM_BURST_MAX_STEPS must be between 2 and 65535");
+#    define STEP_BURST_MAX_STEPS MCPWM_BURST_MAX_STEPS
+const uint32_t STEP_BURST_ISRS = 2;
+// Shortest wait from stopping a run to the next output, so the ISRs cannot pile up
+const uint32_t MCPWM_STOP_MIN_TICKS = 2 * TICKS_PER_MICROSECOND;
+#endif
+
+// The step ISR hands runs of steps to the step generator
+#ifdef STEP_BURST_MAX_STEPS
+#    define STEP_BURST
+#endif
+
 const timer_group_t STEP_TIMER_GROUP = TIMER_GROUP_0;
 const timer_idx_t   STEP_TIMER_INDEX = TIMER_0;
+#if !defined(USE_RMT_STEPS) && !defined(USE_MCPWM_STEPS)
+// One-shot timer in the step timer group that ends the step pulses of timed GPIO stepping.
+const timer_idx_t PULSE_TIMER_INDEX = TIMER_1;
+#endif
 
-// esp32 work around for diable in main loop
+// The idle lock, ended by a timer in Stepper.cpp
 extern uint64_t stepper_idle_counter;
 extern bool     stepper_idle;
 
@@ -80,6 +173,7 @@ enum stepper_id_t {
     ST_RMT,
     ST_I2S_STREAM,
     ST_I2S_STATIC,
+    ST_MCPWM,
 };
 extern const char*  stepper_names[];
 extern stepper_id_t current_stepper;
@@ -100,6 +194,11 @@ void st_go_idle();
 // Reset the stepper subsystem variables
 void st_reset();
 
+#ifdef USE_KINEMATICS
+// Makes the segment prep convert the next move from sys_position, after it was set without st_reset().
+void st_sync_joint_steps();
+#endif
+
 // Changes the run state of the step segment buffer to execute the special parking motion.
 void st_parking_setup_buffer();
 
@@ -112,9 +211,134 @@ void st_prep_buffer();
 // Called by planner_recalculate() when the executing block is updated by the new plan.
 void st_update_plan_block_parameters();
 
+// Guards the planner blocks and prep state against a concurrent st_prep_buffer(). No-ops unless
+// USE_STEPPER_PREP_TASK is enabled.
+void st_prep_lock();
+void st_prep_unlock();
+
+// Number of times the segment buffer emptied while motion was still queued in the planner.
+uint32_t st_get_underrun_count();
+
+// Has the step ISR notify task each time it loads a segment that moves one of axes, so servo axes are
+// commanded as their motion starts rather than at their next update. A NULL task stops the events.
+void st_set_segment_event(TaskHandle_t task, uint8_t axes);
+
+#ifdef STEP_BURST
+typedef struct {
+    uint32_t runs;         // Runs of steps generated by the RMT channels or the MCPWM timers
+    uint32_t steps;        // Step events in them, each saved an ISR but the STEP_BURST_ISRS of its run
+    uint32_t extra_steps;  // Steps the MCPWM timers made after their run as the ISR was late to stop it
+} st_burst_stats_t;
+
+const st_burst_stats_t* st_get_burst_stats();
+void                    st_reset_burst_stats();
+#endif
+
+// Segments waiting for the step ISR, including the one it executes.
+uint8_t st_get_segment_buffer_count();
+
+// Bytes of the segment buffer and the stepper block data it refers to.
+uint32_t st_get_buffer_memory();
+
+#ifdef HOMING_PARALLEL_SQUARING
+// Axes that have a ganged motor.
+uint8_t st_get_ganged_axes();
+
+// Holds one motor of a ganged axis still while the other one keeps stepping. motor is PRIMARY_MOTOR or
+// GANGED_MOTOR. Safe to call from an ISR. st_reset() releases all motors.
+void st_lock_ganged_motor(uint8_t axis, uint8_t motor);
+
+// Axes whose motor of the given gang index is held.
+uint8_t st_get_locked_motors(uint8_t motor);
+#endif
+
+#ifdef JOG_VELOCITY_MODE
+// Sets the axis velocities (mm/min) of the velocity jog, starting it from the machine position if none
+// is running. The segment prep steps it directly, without planner blocks, and decelerates to a stop
+// once keepalive_ms pass without a new call. Returns false while a stopping jog drains.
+bool st_jog_velocity(const float* velocity, uint32_t keepalive_ms);
+
+// A velocity jog owns the segment buffer. Cleared by st_reset().
+bool st_jog_velocity_active();
+#endif
+
+#ifdef AXIS_ENCODER_CORRECTION
+// Sets the steps the step ISR adds to an axis, negative for the - direction, replacing those it has not
+// put out yet. They go out while the axis moves in their direction. See AxisEncoder.h.
+void st_set_correction(uint8_t axis, int32_t steps);
+
+// Correction steps put out since startup.
+uint32_t st_get_correction_count();
+#endif
+
+#ifdef ENABLE_AUX_STREAM
+// Starts the step ISR for the auxiliary axis if it has stopped with nothing else to step. Polled by
+// protocol_execute_realtime(), so it runs in the task that starts and resets the other motion.
+void st_aux_wake_up();
+#endif
+
+// A prepped segment as the step ISR would run it
+typedef struct {
+    uint32_t n_step;
+    uint32_t cycles_per_tick;
+    uint8_t  direction_bits;
+    uint8_t  amass_level;
+} st_segment_trace_t;
+
+// Drops the prepped segments without stepping them, adds their number to count and returns their
+// duration in step timer ticks. trace, if given, is called with each of them first. Only valid while
+// the step ISR is stopped. See Simulator.h.
+uint64_t st_discard_segments(uint32_t* count, void (*trace)(const st_segment_trace_t* segment) = NULL);
+
+// Preps count segments of the polygon of plan_benchmark() and reports the segments prepared per
+// millisecond, not counting the planning. Clears the planner. Only run when idle.
+void st_benchmark(uint8_t client, uint32_t count);
+
+// CPU cycles spent in the step timer ISR. Only collected with ENABLE_STEPPER_ISR_PROFILING. Histogram
+// bin i counts the invocations that took i to i + 1 times STEPPER_ISR_PROFILE_BIN_CYCLES, the last bin
+// also the longer ones.
+#ifndef STEPPER_ISR_PROFILE_BINS
+#    define STEPPER_ISR_PROFILE_BINS 16
+#endif
+#ifndef STEPPER_ISR_PROFILE_BIN_CYCLES
+#    define STEPPER_ISR_PROFILE_BIN_CYCLES 250
+#endif
+
+typedef struct {
+    uint32_t events;      // ISR invocations measured
+    uint64_t cycles;      // Total CPU cycles spent in them
+    uint32_t min_cycles;  // Shortest single invocation
+    uint32_t max_cycles;  // Longest single invocation
+    uint32_t histogram[STEPPER_ISR_PROFILE_BINS];
+} st_isr_cycles_t;
+
+// What an invocation did besides stepping.
+enum class StIsrWork : uint8_t {
+    Step = 0,  // Nothing
+    Segment,   // Loaded a segment of the same block
+    Block,     // Loaded a segment of a new block
+    Count,
+};
+
+typedef struct {
+    st_isr_cycles_t all;
+    st_isr_cycles_t work[int(StIsrWork::Count)];
+    st_isr_cycles_t amass[MAX_AMASS_LEVEL + 1];  // By AMASS level of the segment
+    uint32_t        worst_load_cycles;  // The invocation that used the largest part of its timer period,
+    uint32_t        worst_load_ticks;   // and that period in step timer ticks
+} st_isr_profile_t;
+#ifdef ENABLE_STEPPER_ISR_PROFILING
+const st_isr_profile_t* st_get_isr_profile();
+void                    st_reset_isr_profile();
+#endif
+
 // Called by realtime status reporting if realtime rate reporting is enabled in config.h.
 float st_get_realtime_rate();
 
+// Adds up how far each axis will move in the next lead_us by walking the segments queued for the
+// stepper ISR. delta[] receives signed steps. Used to command servos ahead of sys_position.
+void st_get_lookahead(uint32_t lead_us, float* delta);
+
 // disable (or enable) steppers via STEPPERS_DISABLE_PIN
 bool get_stepper_disable();  // returns the state of the pin
 
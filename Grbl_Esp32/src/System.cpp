@@ -25,6 +25,7 @@
 system_t           sys;
 int32_t            sys_position[MAX_N_AXIS];        // Real-time machine (aka home) position vector in steps.
 int32_t            sys_probe_position[MAX_N_AXIS];  // Last probe position in machine coordinates and steps.
+volatile uint32_t  sys_position_seq;                // Odd while sys_position is being written
 volatile uint8_t   sys_probe_state;                 // Probing state value.  Used to coordinate the probing cycle with stepper ISR.
 volatile uint8_t   sys_rt_exec_state;               // Global realtime executor bitflag variable for state management. See EXEC bitmasks.
 volatile ExecAlarm sys_rt_exec_alarm;               // Global realtime executor bitflag variable for setting various alarms.
@@ -40,55 +41,66 @@ UserOutput::DigitalOutput* myDigitalOutputs[MaxUserDigitalPin];
 
 xQueueHandle control_sw_queue;    // used by control switch debouncing
 bool         debouncing = false;  // debouncing in process
+#ifdef ENABLE_CONTROL_SW_DEBOUNCE
+static int64_t control_sw_edge_us;  // Edge that started the debounce
+#endif
+
+#ifdef CONTROL_SW_FAST_PATH
+static const uint8_t CONTROL_SW_SAFETY_PINS = CONTROL_PIN_INDEX_SAFETY_DOOR | CONTROL_PIN_INDEX_RESET | CONTROL_PIN_INDEX_FEED_HOLD;
+
+static uint8_t  control_sw_level;       // Pins asserted after their last edge
+static uint32_t control_sw_last_us[8];  // Time of the last edge of each pin, by CONTROL_PIN_INDEX bit
+#endif
 
 void system_ini() {  // Renamed from system_init() due to conflict with esp32 files
     // setup control inputs
 
 #ifdef CONTROL_SAFETY_DOOR_PIN
     pinMode(CONTROL_SAFETY_DOOR_PIN, INPUT_PULLUP);
-    attachInterrupt(digitalPinToInterrupt(CONTROL_SAFETY_DOOR_PIN), isr_control_inputs, CHANGE);
+    attachInterrupt(CONTROL_SAFETY_DOOR_PIN, isr_control_inputs, CHANGE);
 #endif
 #ifdef CONTROL_RESET_PIN
     pinMode(CONTROL_RESET_PIN, INPUT_PULLUP);
-    attachInterrupt(digitalPinToInterrupt(CONTROL_RESET_PIN), isr_control_inputs, CHANGE);
+    attachInterrupt(CONTROL_RESET_PIN, isr_control_inputs, CHANGE);
 #endif
 #ifdef CONTROL_FEED_HOLD_PIN
     pinMode(CONTROL_FEED_HOLD_PIN, INPUT_PULLUP);
-    attachInterrupt(digitalPinToInterrupt(CONTROL_FEED_HOLD_PIN), isr_control_inputs, CHANGE);
+    attachInterrupt(CONTROL_FEED_HOLD_PIN, isr_control_inputs, CHANGE);
 #endif
 #ifdef CONTROL_CYCLE_START_PIN
     pinMode(CONTROL_CYCLE_START_PIN, INPUT_PULLUP);
-    attachInterrupt(digitalPinToInterrupt(CONTROL_CYCLE_START_PIN), isr_control_inputs, CHANGE);
+    attachInterrupt(CONTROL_CYCLE_START_PIN, isr_control_inputs, CHANGE);
 #endif
 #ifdef MACRO_BUTTON_0_PIN
     grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Macro Pin 0");
     pinMode(MACRO_BUTTON_0_PIN, INPUT_PULLUP);
-    attachInterrupt(digitalPinToInterrupt(MACRO_BUTTON_0_PIN), isr_control_inputs, CHANGE);
+    attachInterrupt(MACRO_BUTTON_0_PIN, isr_control_inputs, CHANGE);
 #endif
 #ifdef MACRO_BUTTON_1_PIN
     grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Macro Pin 1");
     pinMode(MACRO_BUTTON_1_PIN, INPUT_PULLUP);
-    attachInterrupt(digitalPinToInterrupt(MACRO_BUTTON_1_PIN), isr_control_inputs, CHANGE);
+    attachInterrupt(MACRO_BUTTON_1_PIN, isr_control_inputs, CHANGE);
 #endif
 #ifdef MACRO_BUTTON_2_PIN
     grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Macro Pin 2");
     pinMode(MACRO_BUTTON_2_PIN, INPUT_PULLUP);
-    attachInterrupt(digitalPinToInterrupt(MACRO_BUTTON_2_PIN), isr_control_inputs, CHANGE);
+    attachInterrupt(MACRO_BUTTON_2_PIN, isr_control_inputs, CHANGE);
 #endif
 #ifdef MACRO_BUTTON_3_PIN
     grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Macro Pin 3");
     pinMode(MACRO_BUTTON_3_PIN, INPUT_PULLUP);
-    attachInterrupt(digitalPinToInterrupt(MACRO_BUTTON_3_PIN), isr_control_inputs, CHANGE);
+    attachInterrupt(MACRO_BUTTON_3_PIN, isr_control_inputs, CHANGE);
 #endif
 #ifdef ENABLE_CONTROL_SW_DEBOUNCE
     // setup task used for debouncing
     control_sw_queue = xQueueCreate(10, sizeof(int));
-    xTaskCreate(controlCheckTask,
-                "controlCheckTask",
-                2048,
-                NULL,
-                5,  // priority
-                NULL);
+    xTaskCreatePinnedToCore(controlCheckTask,
+                            "controlCheckTask",
+                            CONTROL_CHECK_TASK_STACK,
+                            NULL,
+                            CONTROL_CHECK_TASK_PRIORITY,
+                            NULL,
+                            CONTROL_CHECK_TASK_CORE);
 #endif
 
     //customize pin definition if needed
@@ -109,15 +121,31 @@ void system_ini() {  // Renamed from system_init() due to conflict with esp32 fi
     myAnalogOutputs[3] = new UserOutput::AnalogOutput(3, USER_ANALOG_PIN_3, USER_ANALOG_PIN_3_FREQ);
 }
 
+// Starts the realtime trace of the command system_exec_control_pin() is about to carry out for pin.
+static void IRAM_ATTR control_sw_trace(uint8_t pin, int64_t edge_us) {
+#ifdef ENABLE_REALTIME_TRACE
+    if (bit_istrue(pin, CONTROL_PIN_INDEX_RESET)) {
+        rt_trace_begin(RtCmd::Reset, edge_us);
+    } else if (bit_istrue(pin, CONTROL_PIN_INDEX_CYCLE_START)) {
+        rt_trace_begin(RtCmd::CycleStart, edge_us);
+    } else if (bit_istrue(pin, CONTROL_PIN_INDEX_FEED_HOLD)) {
+        rt_trace_begin(RtCmd::FeedHold, edge_us);
+    }
+#endif
+}
+
 #ifdef ENABLE_CONTROL_SW_DEBOUNCE
 // this is the debounce task
 void controlCheckTask(void* pvParameters) {
     while (true) {
         int evt;
+        task_stats_block();
         xQueueReceive(control_sw_queue, &evt, portMAX_DELAY);  // block until receive queue
         vTaskDelay(CONTROL_SW_DEBOUNCE_PERIOD);                // delay a while
+        task_stats_unblock();
         uint8_t pin = system_control_get_state();
         if (pin) {
+            control_sw_trace(pin, control_sw_edge_us);
             system_exec_control_pin(pin);
         }
         debouncing = false;
@@ -125,16 +153,60 @@ void controlCheckTask(void* pvParameters) {
 }
 #endif
 
+#ifdef CONTROL_SW_FAST_PATH
+// The pins of mask asserted in state that are still asserted glitch_us after the edge at edge_us
+static uint8_t IRAM_ATTR control_sw_filter(uint8_t state, uint8_t mask, int64_t edge_us, uint32_t glitch_us) {
+    if (!(state & mask)) {
+        return 0;
+    }
+    while (esp_timer_get_time() - edge_us < glitch_us) {}
+    return state & mask & system_control_get_state();
+}
+
+// Returns the pins that were pressed. An edge of a pin that changed less than its lockout time ago is a
+// bounce; it is followed but not acted on. A pin asserted by a glitch keeps its level and time.
+static uint8_t IRAM_ATTR control_sw_edges(int64_t edge_us) {
+    uint8_t state  = system_control_get_state();
+    uint8_t stable = control_sw_filter(state, CONTROL_SW_SAFETY_PINS, edge_us, CONTROL_SW_SAFETY_GLITCH_US) |
+                     control_sw_filter(state, uint8_t(~CONTROL_SW_SAFETY_PINS), edge_us, CONTROL_SW_CONVENIENCE_GLITCH_US);
+    uint8_t  changed = (state ^ control_sw_level) & ~(state & ~stable);
+    uint8_t  pressed = 0;
+    uint32_t now     = uint32_t(edge_us);
+    for (uint8_t i = 0; changed >> i; i++) {
+        uint8_t bit = 1 << i;
+        if (!(changed & bit)) {
+            continue;
+        }
+        uint32_t lockout_ms = (bit & CONTROL_SW_SAFETY_PINS) ? CONTROL_SW_SAFETY_LOCKOUT_MS : CONTROL_SW_CONVENIENCE_LOCKOUT_MS;
+        if ((stable & bit) && now - control_sw_last_us[i] >= lockout_ms * 1000) {
+            pressed |= bit;
+        }
+        control_sw_last_us[i] = now;
+        control_sw_level ^= bit;
+    }
+    return pressed;
+}
+#endif
+
 void IRAM_ATTR isr_control_inputs() {
-#ifdef ENABLE_CONTROL_SW_DEBOUNCE
+#if defined(CONTROL_SW_FAST_PATH)
+    int64_t edge_us = esp_timer_get_time();
+    uint8_t pin     = control_sw_edges(edge_us);
+    if (pin) {
+        control_sw_trace(pin, edge_us);
+        system_exec_control_pin(pin);
+    }
+#elif defined(ENABLE_CONTROL_SW_DEBOUNCE)
     // we will start a task that will recheck the switches after a small delay
     int evt;
     if (!debouncing) {  // prevent resending until debounce is done
-        debouncing = true;
+        debouncing         = true;
+        control_sw_edge_us = esp_timer_get_time();
         xQueueSendFromISR(control_sw_queue, &evt, NULL);
     }
 #else
     uint8_t pin = system_control_get_state();
+    control_sw_trace(pin, esp_timer_get_time());
     system_exec_control_pin(pin);
 #endif
 }
@@ -149,6 +221,53 @@ uint8_t system_check_safety_door_ajar() {
 }
 
 // Special handlers for setting and clearing Grbl's real-time execution flags.
+#ifdef REALTIME_EVENT_QUEUE
+// Multi-producer, single-consumer ring of realtime commands. A producer reserves a slot by advancing
+// the head with a compare and swap, fills it and publishes it by storing its sequence number. The
+// consumer takes slots in order once they are published. Tasks and ISRs on either core can produce
+// without locks, and a producer that is preempted between reserve and publish only delays the slots
+// after it.
+typedef struct {
+    volatile uint32_t seq;  // Slot index + 1 once the event is in
+    rt_event_t        event;
+} rt_slot_t;
+
+static rt_slot_t rt_events[REALTIME_EVENT_QUEUE_SIZE];
+static uint32_t  rt_event_head = 0;  // Next slot to reserve
+static uint32_t  rt_event_tail = 0;  // Next slot to take
+
+// Returns false when the queue is full. The caller then sets the flag bits, as without the queue.
+static bool IRAM_ATTR system_push_exec_event(RtGroup group, uint8_t mask) {
+    uint32_t head = __atomic_load_n(&rt_event_head, __ATOMIC_ACQUIRE);
+    do {
+        if (head - __atomic_load_n(&rt_event_tail, __ATOMIC_ACQUIRE) >= REALTIME_EVENT_QUEUE_SIZE) {
+            return false;
+        }
+    } while (!__atomic_compare_exchange_n(&rt_event_head, &head, head + 1, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+    rt_slot_t* slot   = &rt_events[head % REALTIME_EVENT_QUEUE_SIZE];
+    slot->event.group = group;
+    slot->event.mask  = mask;
+    __atomic_store_n(&slot->seq, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool system_pop_exec_event(rt_event_t* event) {
+    uint32_t   tail = rt_event_tail;
+    rt_slot_t* slot = &rt_events[tail % REALTIME_EVENT_QUEUE_SIZE];
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != tail + 1) {
+        return false;  // Empty, or the next event is not published yet
+    }
+    *event = slot->event;
+    __atomic_store_n(&rt_event_tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+void system_reset_exec_events() {
+    rt_event_t event;
+    while (system_pop_exec_event(&event)) {}
+}
+#endif
+
 void system_set_exec_state_flag(uint8_t mask) {
     // TODO uint8_t sreg = SREG;
     // TODO cli();
@@ -167,6 +286,7 @@ void system_set_exec_alarm(ExecAlarm code) {
     //uint8_t sreg = SREG;
     //cli();
     sys_rt_exec_alarm = code;
+    warm_restart_lost();  // Clearing the alarm with $X does not bring the position back
     //SREG = sreg;
 }
 
@@ -178,6 +298,11 @@ void system_clear_exec_alarm() {
 }
 
 void system_set_exec_motion_override_flag(uint8_t mask) {
+#ifdef REALTIME_EVENT_QUEUE
+    if (system_push_exec_event(RtGroup::MotionOverride, mask)) {
+        return;
+    }
+#endif
     //uint8_t sreg = SREG;
     //cli();
     sys_rt_exec_motion_override |= (mask);
@@ -185,6 +310,11 @@ void system_set_exec_motion_override_flag(uint8_t mask) {
 }
 
 void system_set_exec_accessory_override_flag(uint8_t mask) {
+#ifdef REALTIME_EVENT_QUEUE
+    if (system_push_exec_event(RtGroup::AccessoryOverride, mask)) {
+        return;
+    }
+#endif
     //uint8_t sreg = SREG;
     //cli();
     sys_rt_exec_accessory_override |= (mask);
@@ -212,54 +342,69 @@ void system_flag_wco_change() {
     sys.report_wco_counter = 0;
 }
 
+void system_get_position(int32_t* position) {
+    uint32_t seq;
+    do {
+        while ((seq = sys_position_seq) & 1) {}  // The ISR on the other core is mid-step
+        __sync_synchronize();
+        memcpy(position, sys_position, sizeof(sys_position));
+        __sync_synchronize();
+    } while (seq != sys_position_seq);
+}
+
+void system_snapshot(sys_snapshot_t* snapshot) {
+    uint32_t seq;
+    do {
+        while ((seq = sys_position_seq) & 1) {}
+        __sync_synchronize();
+        memcpy(snapshot->position, sys_position, sizeof(sys_position));
+        snapshot->state     = sys.state;
+        snapshot->feed_rate = st_get_realtime_rate();
+        __sync_synchronize();
+    } while (seq != sys_position_seq);
+}
+
 // Returns machine position of axis 'idx'. Must be sent a 'step' array.
 // NOTE: If motor steps and machine position are not in the same coordinate frame, this function
 //   serves as a central place to compute the transformation.
 float system_convert_axis_steps_to_mpos(int32_t* steps, uint8_t idx) {
-    float pos;
-    float steps_per_mm = axis_settings[idx]->steps_per_mm->get();
-#ifdef COREXY
-    if (idx == X_AXIS) {
-        pos = (float)system_convert_corexy_to_x_axis_steps(steps) / steps_per_mm;
-    } else if (idx == Y_AXIS) {
-        pos = (float)system_convert_corexy_to_y_axis_steps(steps) / steps_per_mm;
-    } else {
-        pos = steps[idx] / steps_per_mm;
+    int32_t axis_steps = steps[idx];
+    if (motion_config.corexy && idx == X_AXIS) {
+        axis_steps = system_convert_corexy_to_x_axis_steps(steps);
+    } else if (motion_config.corexy && idx == Y_AXIS) {
+        axis_steps = system_convert_corexy_to_y_axis_steps(steps);
     }
-#else
-    pos = steps[idx] / steps_per_mm;
-#endif
-    return pos;
+    return axis_steps * motion_config.mm_per_step[idx];
 }
 
+// Converts every axis in one pass with the reciprocals from motion_config, mixing the CoreXY motors
+// once for both axes.
 void system_convert_array_steps_to_mpos(float* position, int32_t* steps) {
-    uint8_t idx;
-    auto    n_axis = number_axis->get();
-    for (idx = 0; idx < n_axis; idx++) {
-        position[idx] = system_convert_axis_steps_to_mpos(steps, idx);
+#ifdef USE_KINEMATICS
+    // Steps count joints, which are converted to the machine position except while homing.
+    if (!kinematics_joint_motion()) {
+        kinematics_steps_to_mpos(position, steps);
+        return;
+    }
+#endif
+    const float* mm_per_step = motion_config.mm_per_step;
+    auto         n_axis      = motion_config.n_axis;
+    for (uint8_t idx = 0; idx < n_axis; idx++) {
+        position[idx] = steps[idx] * mm_per_step[idx];
+    }
+    if (motion_config.corexy) {
+        position[X_AXIS] = system_convert_corexy_to_x_axis_steps(steps) * mm_per_step[X_AXIS];
+        position[Y_AXIS] = system_convert_corexy_to_y_axis_steps(steps) * mm_per_step[Y_AXIS];
     }
-    return;
 }
 
 // Checks and reports if target array exceeds machine travel limits.
 // Return true if exceeding limits
 uint8_t system_check_travel_limits(float* target) {
     uint8_t idx;
-    auto    n_axis = number_axis->get();
+    auto    n_axis = motion_config.n_axis;
     for (idx = 0; idx < n_axis; idx++) {
-        float travel = axis_settings[idx]->max_travel->get();
-        float mpos   = axis_settings[idx]->home_mpos->get();
-        float max_mpos, min_mpos;
-
-        if (bit_istrue(homing_dir_mask->get(), bit(idx))) {
-            min_mpos = mpos;
-            max_mpos = mpos + travel;
-        } else {
-            min_mpos = mpos - travel;
-            max_mpos = mpos;
-        }
-
-        if (target[idx] < min_mpos || target[idx] > max_mpos)
+        if (target[idx] < motion_config.travel_min[idx] || target[idx] > motion_config.travel_max[idx])
             return true;
     }
     return false;
@@ -269,54 +414,55 @@ uint8_t system_check_travel_limits(float* target) {
 // triggered is 1 and not triggered is 0. Invert mask is applied. Bitfield organization is
 // defined by the CONTROL_PIN_INDEX in the header file.
 uint8_t system_control_get_state() {
-    uint8_t defined_pin_mask = 0;  // a mask of defined pins
-    uint8_t control_state    = 0;
+    uint8_t  defined_pin_mask = 0;  // a mask of defined pins
+    uint8_t  control_state    = 0;
+    uint64_t inputs           = gpio_read_inputs();
 
 #ifdef CONTROL_SAFETY_DOOR_PIN
     defined_pin_mask |= CONTROL_PIN_INDEX_SAFETY_DOOR;
-    if (digitalRead(CONTROL_SAFETY_DOOR_PIN)) {
+    if (gpio_input_level(inputs, CONTROL_SAFETY_DOOR_PIN)) {
         control_state |= CONTROL_PIN_INDEX_SAFETY_DOOR;
     }
 #endif
 #ifdef CONTROL_RESET_PIN
     defined_pin_mask |= CONTROL_PIN_INDEX_RESET;
-    if (digitalRead(CONTROL_RESET_PIN)) {
+    if (gpio_input_level(inputs, CONTROL_RESET_PIN)) {
         control_state |= CONTROL_PIN_INDEX_RESET;
     }
 #endif
 #ifdef CONTROL_FEED_HOLD_PIN
     defined_pin_mask |= CONTROL_PIN_INDEX_FEED_HOLD;
-    if (digitalRead(CONTROL_FEED_HOLD_PIN)) {
+    if (gpio_input_level(inputs, CONTROL_FEED_HOLD_PIN)) {
         control_state |= CONTROL_PIN_INDEX_FEED_HOLD;
     }
 #endif
 #ifdef CONTROL_CYCLE_START_PIN
     defined_pin_mask |= CONTROL_PIN_INDEX_CYCLE_START;
-    if (digitalRead(CONTROL_CYCLE_START_PIN)) {
+    if (gpio_input_level(inputs, CONTROL_CYCLE_START_PIN)) {
         control_state |= CONTROL_PIN_INDEX_CYCLE_START;
     }
 #endif
 #ifdef MACRO_BUTTON_0_PIN
     defined_pin_mask |= CONTROL_PIN_INDEX_MACRO_0;
-    if (digitalRead(MACRO_BUTTON_0_PIN)) {
+    if (gpio_input_level(inputs, MACRO_BUTTON_0_PIN)) {
         control_state |= CONTROL_PIN_INDEX_MACRO_0;
     }
 #endif
 #ifdef MACRO_BUTTON_1_PIN
     defined_pin_mask |= CONTROL_PIN_INDEX_MACRO_1;
-    if (digitalRead(MACRO_BUTTON_1_PIN)) {
+    if (gpio_input_level(inputs, MACRO_BUTTON_1_PIN)) {
         control_state |= CONTROL_PIN_INDEX_MACRO_1;
     }
 #endif
 #ifdef MACRO_BUTTON_2_PIN
     defined_pin_mask |= CONTROL_PIN_INDEX_MACRO_2;
-    if (digitalRead(MACRO_BUTTON_2_PIN)) {
+    if (gpio_input_level(inputs, MACRO_BUTTON_2_PIN)) {
         control_state |= CONTROL_PIN_INDEX_MACRO_2;
     }
 #endif
 #ifdef MACRO_BUTTON_3_PIN
     defined_pin_mask |= CONTROL_PIN_INDEX_MACRO_3;
-    if (digitalRead(MACRO_BUTTON_3_PIN)) {
+    if (gpio_input_level(inputs, MACRO_BUTTON_3_PIN)) {
         control_state |= CONTROL_PIN_INDEX_MACRO_3;
     }
 #endif
@@ -332,31 +478,56 @@ void system_exec_control_pin(uint8_t pin) {
     if (bit_istrue(pin, CONTROL_PIN_INDEX_RESET)) {
         grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Reset via control pin");
         mc_reset();
+#ifdef ENABLE_REALTIME_TRACE
+        rt_trace_hop(RtCmd::Reset, RtHop::Flag, false);
+#endif
     } else if (bit_istrue(pin, CONTROL_PIN_INDEX_CYCLE_START)) {
         bit_true(sys_rt_exec_state, EXEC_CYCLE_START);
+#ifdef ENABLE_REALTIME_TRACE
+        rt_trace_hop(RtCmd::CycleStart, RtHop::Flag, false);
+#endif
     } else if (bit_istrue(pin, CONTROL_PIN_INDEX_FEED_HOLD)) {
         bit_true(sys_rt_exec_state, EXEC_FEED_HOLD);
+#ifdef ENABLE_REALTIME_TRACE
+        rt_trace_hop(RtCmd::FeedHold, RtHop::Flag, false);
+#endif
     } else if (bit_istrue(pin, CONTROL_PIN_INDEX_SAFETY_DOOR)) {
         bit_true(sys_rt_exec_state, EXEC_SAFETY_DOOR);
     }
 #ifdef MACRO_BUTTON_0_PIN
     else if (bit_istrue(pin, CONTROL_PIN_INDEX_MACRO_0)) {
+#    ifdef ENABLE_MACROS
+        macro_request(0);
+#    else
         user_defined_macro(CONTROL_PIN_INDEX_MACRO_0);  // function must be implemented by user
+#    endif
     }
 #endif
 #ifdef MACRO_BUTTON_1_PIN
     else if (bit_istrue(pin, CONTROL_PIN_INDEX_MACRO_1)) {
+#    ifdef ENABLE_MACROS
+        macro_request(1);
+#    else
         user_defined_macro(CONTROL_PIN_INDEX_MACRO_1);  // function must be implemented by user
+#    endif
     }
 #endif
 #ifdef MACRO_BUTTON_2_PIN
     else if (bit_istrue(pin, CONTROL_PIN_INDEX_MACRO_2)) {
+#    ifdef ENABLE_MACROS
+        macro_request(2);
+#    else
         user_defined_macro(CONTROL_PIN_INDEX_MACRO_2);  // function must be implemented by user
+#    endif
     }
 #endif
 #ifdef MACRO_BUTTON_3_PIN
     else if (bit_istrue(pin, CONTROL_PIN_INDEX_MACRO_3)) {
+#    ifdef ENABLE_MACROS
+        macro_request(3);
+#    else
         user_defined_macro(CONTROL_PIN_INDEX_MACRO_3);  // function must be implemented by user
+#    endif
     }
 #endif
 }
@@ -372,10 +543,96 @@ int32_t system_convert_corexy_to_y_axis_steps(int32_t* steps) {
 
 // io_num is the virtual pin# and has nothing to do with the actual esp32 GPIO_NUM_xx
 // It uses a mask so all can be turned of in ms_reset
+#ifdef SYNC_USER_OUTPUTS
+typedef struct {
+    uint8_t  io_num;
+    bool     analog;
+    uint32_t level;  // On or off, or the duty of an analog output
+} output_event_t;
+
+// Ring of events. From tail to attached they wait for their move to start, from attached to head for a
+// move to be planned.
+static output_event_t   output_events[SYNC_OUTPUT_EVENTS];
+static volatile uint8_t output_event_tail;  // Moved by the step ISR
+static uint8_t          output_event_attached;
+static uint8_t          output_event_head;
+
+static uint8_t output_event_next(uint8_t index) {
+    return index + 1 == SYNC_OUTPUT_EVENTS ? 0 : index + 1;
+}
+
+// Queues an event. A full ring waits for the motion, which fires the events in it.
+static bool sys_output_event_queue(uint8_t io_num, bool analog, uint32_t level) {
+    if (output_event_next(output_event_head) == output_event_tail) {
+        protocol_buffer_synchronize();
+        if (output_event_next(output_event_head) == output_event_tail) {
+            return false;
+        }
+    }
+    output_events[output_event_head] = { io_num, analog, level };
+    output_event_head                = output_event_next(output_event_head);
+    return true;
+}
+
+uint8_t sys_output_events_pending() {
+    return (output_event_head + SYNC_OUTPUT_EVENTS - output_event_attached) % SYNC_OUTPUT_EVENTS;
+}
+
+void sys_output_events_attach(uint8_t count) {
+    output_event_attached = (output_event_attached + count) % SYNC_OUTPUT_EVENTS;
+}
+
+void IRAM_ATTR sys_output_events_fire(uint8_t count) {
+    uint8_t tail = output_event_tail;
+    while (count--) {
+        const output_event_t* event = &output_events[tail];
+        if (event->analog) {
+            myAnalogOutputs[event->io_num]->write_duty_isr(event->level);
+        } else {
+            myDigitalOutputs[event->io_num]->set_level_isr(event->level);
+        }
+        tail = tail + 1 == SYNC_OUTPUT_EVENTS ? 0 : tail + 1;
+    }
+    output_event_tail = tail;
+}
+
+void sys_output_events_fire_pending() {
+    if (output_event_tail != output_event_attached) {
+        return;  // Moves that carry events have not run yet
+    }
+    uint8_t count = sys_output_events_pending();
+    sys_output_events_attach(count);
+    sys_output_events_fire(count);
+}
+
+void sys_output_events_reset(bool pending) {
+    output_event_tail = output_event_attached;
+    if (pending) {
+        output_event_tail = output_event_attached = output_event_head;
+    }
+}
+#endif
+
 bool sys_io_control(uint8_t io_num_mask, bool turnOn, bool synchronized) {
     bool cmd_ok = true;
+#ifdef SYNC_USER_OUTPUTS
+    // Switched by the step ISR at the start of the next move, the motion keeps going.
+    if (synchronized) {
+        for (uint8_t io_num = 0; io_num < MaxUserDigitalPin; io_num++) {
+            if (io_num_mask & bit(io_num)) {
+                if (!myDigitalOutputs[io_num]->defined()) {
+                    cmd_ok = cmd_ok && !turnOn;
+                } else if (!sys_output_event_queue(io_num, false, turnOn)) {
+                    cmd_ok = myDigitalOutputs[io_num]->set_level(turnOn) && cmd_ok;
+                }
+            }
+        }
+        return cmd_ok;
+    }
+#else
     if (synchronized)
         protocol_buffer_synchronize();
+#endif
 
     for (uint8_t io_num = 0; io_num < MaxUserDigitalPin; io_num++) {
         if (io_num_mask & bit(io_num)) {
@@ -390,8 +647,24 @@ bool sys_io_control(uint8_t io_num_mask, bool turnOn, bool synchronized) {
 // It uses a mask so all can be turned of in ms_reset
 bool sys_pwm_control(uint8_t io_num_mask, float duty, bool synchronized) {
     bool cmd_ok = true;
+#ifdef SYNC_USER_OUTPUTS
+    if (synchronized) {
+        for (uint8_t io_num = 0; io_num < MaxUserDigitalPin; io_num++) {
+            if (io_num_mask & bit(io_num)) {
+                auto output = myAnalogOutputs[io_num];
+                if (!output->defined()) {
+                    cmd_ok = false;
+                } else if (!sys_output_event_queue(io_num, true, output->duty(duty))) {
+                    cmd_ok = output->set_level(duty) && cmd_ok;
+                }
+            }
+        }
+        return cmd_ok;
+    }
+#else
     if (synchronized)
         protocol_buffer_synchronize();
+#endif
 
     for (uint8_t io_num = 0; io_num < MaxUserDigitalPin; io_num++) {
         if (io_num_mask & bit(io_num)) {
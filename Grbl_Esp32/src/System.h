@@ -88,6 +88,7 @@ enum class ExecAlarm : uint8_t {
     HomingFailPulloff  = 8,
     HomingFailApproach = 9,
     SpindleControl     = 10,
+    FollowingError     = 11,
 };
 
 // Override bit maps. Realtime bitflags to control feed, rapid, spindle, and coolant overrides.
@@ -111,6 +112,25 @@ enum class ExecAlarm : uint8_t {
 #define EXEC_COOLANT_FLOOD_OVR_TOGGLE bit(6)
 #define EXEC_COOLANT_MIST_OVR_TOGGLE bit(7)
 
+#ifdef REALTIME_EVENT_QUEUE
+#    ifndef REALTIME_EVENT_QUEUE_SIZE
+#        define REALTIME_EVENT_QUEUE_SIZE 32
+#    endif
+static_assert((REALTIME_EVENT_QUEUE_SIZE & (REALTIME_EVENT_QUEUE_SIZE - 1)) == 0, "REALTIME_EVENT_QUEUE_SIZE must be a power of 2");
+
+// Groups of queued realtime commands. Each group has its own set of eight EXEC_* bits, so a new group
+// adds command types without another flag variable to poll.
+enum class RtGroup : uint8_t {
+    MotionOverride,     // EXEC_FEED_OVR_*, EXEC_RAPID_OVR_*
+    AccessoryOverride,  // EXEC_SPINDLE_OVR_*, EXEC_COOLANT_*
+};
+
+typedef struct {
+    RtGroup group;
+    uint8_t mask;
+} rt_event_t;
+#endif
+
 // Define system suspend flags. Used in various ways to manage suspend states and procedures.
 #define SUSPEND_DISABLE 0                // Must be zero.
 #define SUSPEND_HOLD_COMPLETE bit(0)     // Indicates initial feed hold is complete.
@@ -154,10 +174,34 @@ enum class ExecAlarm : uint8_t {
 #define SPINDLE_STOP_OVR_RESTORE bit(2)
 #define SPINDLE_STOP_OVR_RESTORE_CYCLE bit(3)
 
-// NOTE: These position variables may need to be declared as volatiles, if problems arise.
+// sys_position is written by the step ISR on one core and read by tasks on both. Read it through
+// system_get_position() or system_snapshot() outside the ISR, so a copy taken during a step is never torn.
 extern int32_t sys_position[MAX_N_AXIS];        // Real-time machine (aka home) position vector in steps.
 extern int32_t sys_probe_position[MAX_N_AXIS];  // Last probe position in machine coordinates and steps.
 
+// Sequence count guarding sys_position. A writer makes it odd while it changes the position and even
+// again when done. Readers copy the position between two equal even counts and retry otherwise, so
+// they never hold off the ISR. There is one writer at a time: the step ISR, or a task while the
+// steppers are idle, as after homing.
+extern volatile uint32_t sys_position_seq;
+
+inline void IRAM_ATTR system_position_write_begin() {
+    sys_position_seq = sys_position_seq + 1;
+    __sync_synchronize();
+}
+
+inline void IRAM_ATTR system_position_write_end() {
+    __sync_synchronize();
+    sys_position_seq = sys_position_seq + 1;
+}
+
+// Realtime state read in one go. See system_snapshot().
+typedef struct {
+    int32_t position[MAX_N_AXIS];  // sys_position, in steps
+    float   feed_rate;             // st_get_realtime_rate(), in mm/min
+    State   state;
+} sys_snapshot_t;
+
 extern volatile uint8_t   sys_probe_state;    // Probing state value.  Used to coordinate the probing cycle with stepper ISR.
 extern volatile uint8_t   sys_rt_exec_state;  // Global realtime executor bitflag variable for state management. See EXEC bitmasks.
 extern volatile ExecAlarm sys_rt_exec_alarm;  // Global realtime executor bitflag variable for setting various alarms.
@@ -172,12 +216,35 @@ extern volatile uint8_t sys_rt_exec_debug;
 
 void system_ini();  // Renamed from system_init() due to conflict with esp32 files
 
+// Copies sys_position without tearing. Not for the step ISR, which owns it.
+void system_get_position(int32_t* position);
+
+// Copies the position together with the realtime feed rate and state it was taken at.
+void system_snapshot(sys_snapshot_t* snapshot);
+
 // Returns bitfield of control pin states, organized by CONTROL_PIN_INDEX. (1=triggered, 0=not triggered).
 uint8_t system_control_get_state();
 
 // Returns if safety door is ajar(T) or closed(F), based on pin state.
 uint8_t system_check_safety_door_ajar();
 
+#ifdef CONTROL_SW_FAST_PATH
+// How long an edge must hold, and how long a pin must be quiet before an edge counts, for the safety
+// inputs (reset, feed hold, safety door) and the others (cycle start, macro buttons)
+#    ifndef CONTROL_SW_SAFETY_GLITCH_US
+#        define CONTROL_SW_SAFETY_GLITCH_US 2
+#    endif
+#    ifndef CONTROL_SW_SAFETY_LOCKOUT_MS
+#        define CONTROL_SW_SAFETY_LOCKOUT_MS 20
+#    endif
+#    ifndef CONTROL_SW_CONVENIENCE_GLITCH_US
+#        define CONTROL_SW_CONVENIENCE_GLITCH_US 20
+#    endif
+#    ifndef CONTROL_SW_CONVENIENCE_LOCKOUT_MS
+#        define CONTROL_SW_CONVENIENCE_LOCKOUT_MS 100
+#    endif
+#endif
+
 void isr_control_inputs();
 
 // Special handlers for setting and clearing Grbl's real-time execution flags.
@@ -190,6 +257,13 @@ void system_set_exec_accessory_override_flag(uint8_t mask);
 void system_clear_exec_motion_overrides();
 void system_clear_exec_accessory_overrides();
 
+#ifdef REALTIME_EVENT_QUEUE
+// Takes the oldest queued realtime command. Only protocol_exec_rt_system() calls this.
+bool system_pop_exec_event(rt_event_t* event);
+// Drops all queued realtime commands.
+void system_reset_exec_events();
+#endif
+
 // Execute the startup script lines stored in EEPROM upon initialization
 void  system_execute_startup(char* line);
 Error execute_line(char* line, uint8_t client, WebUI::AuthenticationLevel auth_level);
@@ -227,6 +301,19 @@ void system_exec_control_pin(uint8_t pin);
 bool sys_io_control(uint8_t io_num_mask, bool turnOn, bool synchronized);
 bool sys_pwm_control(uint8_t io_num_mask, float duty, bool synchronized);
 
+#ifdef SYNC_USER_OUTPUTS
+// Synchronized M62, M63 and M67 events. sys_io_control() and sys_pwm_control() queue them, the planner
+// hands them to the next move and the step ISR fires them when that move starts.
+#    ifndef SYNC_OUTPUT_EVENTS
+#        define SYNC_OUTPUT_EVENTS 16
+#    endif
+uint8_t        sys_output_events_pending();             // Queued, not handed to a move yet
+void           sys_output_events_attach(uint8_t count);  // Hands the oldest count pending events to a move
+void IRAM_ATTR sys_output_events_fire(uint8_t count);    // A move starts. Called by the step ISR.
+void           sys_output_events_fire_pending();         // No move followed them. Called once motion is done.
+void           sys_output_events_reset(bool pending);    // Drops the events handed to moves, and the pending ones
+#endif
+
 int8_t sys_get_next_RMT_chan_num();
 
 int8_t  sys_get_next_PWM_chan_num();
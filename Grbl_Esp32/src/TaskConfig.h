@@ -0,0 +1,308 @@
+#pragma once
+
+/*
+  TaskConfig.h - core, priority and stack of every Grbl task
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Every task Grbl starts takes its core, priority and stack size from here. Any of them can be set in
+  Config.h or the machine file instead.
+
+  The tasks are in two groups. Motion tasks plan, prepare and feed the steps, read the job and
+  serve the devices on the step path. Service tasks handle the network, uploads and output.
+  ISOLATE_MOTION_CORE puts the motion tasks on the core of the Arduino loop, which runs the protocol
+  loop, and the service tasks on the other core, where ESP-IDF runs the Wi-Fi and Bluetooth stacks.
+  Without it every task keeps the core it always had.
+*/
+
+#include "Config.h"
+
+#include <freertos/FreeRTOS.h>
+
+#ifdef ISOLATE_MOTION_CORE
+#    define TASK_MOTION_CORE CONFIG_ARDUINO_RUNNING_CORE
+#    define TASK_SERVICE_CORE (1 - CONFIG_ARDUINO_RUNNING_CORE)
+// The core of a motion or service task, or its own default core without ISOLATE_MOTION_CORE
+#    define MOTION_TASK_ON(core) TASK_MOTION_CORE
+#    define SERVICE_TASK_ON(core) TASK_SERVICE_CORE
+#else
+#    define MOTION_TASK_ON(core) (core)
+#    define SERVICE_TASK_ON(core) (core)
+#endif
+
+// Motion tasks
+
+// Fills the segment buffer, woken by the step ISR. See USE_STEPPER_PREP_TASK.
+#ifndef STEPPER_PREP_TASK_CORE
+#    define STEPPER_PREP_TASK_CORE MOTION_TASK_ON(0)
+#endif
+#ifndef STEPPER_PREP_TASK_PRIORITY
+#    define STEPPER_PREP_TASK_PRIORITY 20
+#endif
+#ifndef STEPPER_PREP_TASK_STACK
+#    define STEPPER_PREP_TASK_STACK 4096
+#endif
+
+// Fills the segment queue of the auxiliary axis, woken by the step ISR. See AuxStream.h.
+#ifndef AUX_STREAM_TASK_CORE
+#    define AUX_STREAM_TASK_CORE MOTION_TASK_ON(0)
+#endif
+#ifndef AUX_STREAM_TASK_PRIORITY
+#    define AUX_STREAM_TASK_PRIORITY 19
+#endif
+#ifndef AUX_STREAM_TASK_STACK
+#    define AUX_STREAM_TASK_STACK 4096
+#endif
+
+// Plans the moves of the motion pipeline. See MOTION_PIPELINE.
+#ifndef MOTION_TASK_CORE
+#    define MOTION_TASK_CORE STEPPER_PREP_TASK_CORE
+#endif
+#ifndef MOTION_TASK_PRIORITY
+#    define MOTION_TASK_PRIORITY (STEPPER_PREP_TASK_PRIORITY - 1)  // Segment prep preempts planning
+#endif
+#ifndef MOTION_TASK_STACK
+#    define MOTION_TASK_STACK 4096
+#endif
+
+// Moves the UART bytes into the input buffer and picks out the realtime commands
+#ifndef UART_EVENT_TASK_CORE
+#    define UART_EVENT_TASK_CORE MOTION_TASK_ON(1)
+#endif
+#ifndef UART_EVENT_TASK_PRIORITY
+#    define UART_EVENT_TASK_PRIORITY 2
+#endif
+#ifndef UART_EVENT_TASK_STACK
+#    define UART_EVENT_TASK_STACK 2048
+#endif
+
+#ifndef SERIAL_CHECK_TASK_CORE
+#    define SERIAL_CHECK_TASK_CORE MOTION_TASK_ON(1)
+#endif
+#ifndef SERIAL_CHECK_TASK_PRIORITY
+#    define SERIAL_CHECK_TASK_PRIORITY 1
+#endif
+#ifndef SERIAL_CHECK_TASK_STACK
+#    define SERIAL_CHECK_TASK_STACK 8192
+#endif
+
+// Debounces the control switches. See ENABLE_CONTROL_SW_DEBOUNCE.
+#ifndef CONTROL_CHECK_TASK_CORE
+#    define CONTROL_CHECK_TASK_CORE MOTION_TASK_ON(tskNO_AFFINITY)
+#endif
+#ifndef CONTROL_CHECK_TASK_PRIORITY
+#    define CONTROL_CHECK_TASK_PRIORITY 5
+#endif
+#ifndef CONTROL_CHECK_TASK_STACK
+#    define CONTROL_CHECK_TASK_STACK 2048
+#endif
+
+// Reads SD jobs ahead
+#ifndef SD_READ_TASK_CORE
+#    define SD_READ_TASK_CORE MOTION_TASK_ON(0)
+#endif
+#ifndef SD_READ_TASK_PRIORITY
+#    define SD_READ_TASK_PRIORITY 1
+#endif
+#ifndef SD_READ_TASK_STACK
+#    define SD_READ_TASK_STACK 4096
+#endif
+
+// Serves the VFD spindle, the Dynamixel servos and the other RS485 devices
+#ifndef RS485_BUS_TASK_CORE
+#    define RS485_BUS_TASK_CORE MOTION_TASK_ON(0)
+#endif
+#ifndef RS485_BUS_TASK_PRIORITY
+#    define RS485_BUS_TASK_PRIORITY 1
+#endif
+#ifndef RS485_BUS_TASK_STACK
+#    define RS485_BUS_TASK_STACK 4096
+#endif
+
+// Samples the StallGuard values while homing
+#ifndef STALLGUARD_SAMPLE_TASK_CORE
+#    define STALLGUARD_SAMPLE_TASK_CORE MOTION_TASK_ON(0)
+#endif
+#ifndef STALLGUARD_SAMPLE_TASK_PRIORITY
+#    define STALLGUARD_SAMPLE_TASK_PRIORITY 2
+#endif
+#ifndef STALLGUARD_SAMPLE_TASK_STACK
+#    define STALLGUARD_SAMPLE_TASK_STACK 4096
+#endif
+
+// Moves the RC and Dynamixel servos to the position of their axes
+#ifndef SERVO_UPDATE_TASK_CORE
+#    define SERVO_UPDATE_TASK_CORE MOTION_TASK_ON(0)
+#endif
+#ifndef SERVO_UPDATE_TASK_PRIORITY
+#    define SERVO_UPDATE_TASK_PRIORITY 1
+#endif
+#ifndef SERVO_UPDATE_TASK_STACK
+#    define SERVO_UPDATE_TASK_STACK 4096
+#endif
+
+// Compares the axis encoders with the machine position. See AxisEncoder.h.
+#ifndef AXIS_ENCODER_TASK_CORE
+#    define AXIS_ENCODER_TASK_CORE MOTION_TASK_ON(0)
+#endif
+#ifndef AXIS_ENCODER_TASK_PRIORITY
+#    define AXIS_ENCODER_TASK_PRIORITY 2
+#endif
+#ifndef AXIS_ENCODER_TASK_STACK
+#    define AXIS_ENCODER_TASK_STACK 4096
+#endif
+
+// Feeds the I2S output. Always runs on the core of the Arduino loop.
+#ifndef I2S_OUT_TASK_PRIORITY
+#    define I2S_OUT_TASK_PRIORITY 1
+#endif
+#ifndef I2S_OUT_TASK_STACK
+#    define I2S_OUT_TASK_STACK (1024 * 10)
+#endif
+
+// Service tasks
+
+// Writes SD uploads and reads downloads
+#ifndef SD_UPLOAD_TASK_CORE
+#    define SD_UPLOAD_TASK_CORE SERVICE_TASK_ON(0)
+#endif
+#ifndef SD_UPLOAD_TASK_PRIORITY
+#    define SD_UPLOAD_TASK_PRIORITY 1
+#endif
+#ifndef SD_UPLOAD_TASK_STACK
+#    define SD_UPLOAD_TASK_STACK 4096
+#endif
+
+// Writes and inflates firmware updates. See WebUI/OtaWriter.h.
+#ifndef OTA_WRITE_TASK_CORE
+#    define OTA_WRITE_TASK_CORE SERVICE_TASK_ON(0)
+#endif
+#ifndef OTA_WRITE_TASK_PRIORITY
+#    define OTA_WRITE_TASK_PRIORITY 1
+#endif
+#ifndef OTA_WRITE_TASK_STACK
+#    define OTA_WRITE_TASK_STACK 4096
+#endif
+
+// One per transport. See ENABLE_ASYNC_OUTPUT.
+#ifndef CLIENT_OUTPUT_TASK_CORE
+#    define CLIENT_OUTPUT_TASK_CORE SERVICE_TASK_ON(0)
+#endif
+#ifndef CLIENT_OUTPUT_TASK_PRIORITY
+#    define CLIENT_OUTPUT_TASK_PRIORITY 1
+#endif
+#ifndef CLIENT_OUTPUT_TASK_STACK
+#    define CLIENT_OUTPUT_TASK_STACK 4096
+#endif
+
+// See ENABLE_DEFERRED_MSG
+#ifndef DEFERRED_MSG_TASK_CORE
+#    define DEFERRED_MSG_TASK_CORE SERVICE_TASK_ON(0)
+#endif
+#ifndef DEFERRED_MSG_TASK_PRIORITY
+#    define DEFERRED_MSG_TASK_PRIORITY 1
+#endif
+#ifndef DEFERRED_MSG_TASK_STACK
+#    define DEFERRED_MSG_TASK_STACK 4096
+#endif
+
+// Sends the points of a probe scan. See ProbeScan.h.
+#ifndef PROBE_SCAN_TASK_CORE
+#    define PROBE_SCAN_TASK_CORE SERVICE_TASK_ON(0)
+#endif
+#ifndef PROBE_SCAN_TASK_PRIORITY
+#    define PROBE_SCAN_TASK_PRIORITY 1
+#endif
+#ifndef PROBE_SCAN_TASK_STACK
+#    define PROBE_SCAN_TASK_STACK 4096
+#endif
+
+// Brings up the network after boot. See BootTrace.h.
+#ifndef BOOT_NETWORK_TASK_CORE
+#    define BOOT_NETWORK_TASK_CORE SERVICE_TASK_ON(0)
+#endif
+#ifndef BOOT_NETWORK_TASK_PRIORITY
+#    define BOOT_NETWORK_TASK_PRIORITY 1
+#endif
+#ifndef BOOT_NETWORK_TASK_STACK
+#    define BOOT_NETWORK_TASK_STACK 8192
+#endif
+
+// The web server, the websocket and telnet. See WifiServices.h.
+#ifndef WIFI_SERVICES_TASK_CORE
+#    define WIFI_SERVICES_TASK_CORE SERVICE_TASK_ON(0)
+#endif
+#ifndef WIFI_SERVICES_TASK_PRIORITY
+#    define WIFI_SERVICES_TASK_PRIORITY 1
+#endif
+#ifndef WIFI_SERVICES_TASK_STACK
+#    define WIFI_SERVICES_TASK_STACK 8192
+#endif
+
+// Starts the radio and scans for networks. See WifiConfig.h.
+#ifndef WIFI_MANAGER_TASK_CORE
+#    define WIFI_MANAGER_TASK_CORE SERVICE_TASK_ON(0)
+#endif
+#ifndef WIFI_MANAGER_TASK_PRIORITY
+#    define WIFI_MANAGER_TASK_PRIORITY 1
+#endif
+#ifndef WIFI_MANAGER_TASK_STACK
+#    define WIFI_MANAGER_TASK_STACK 8192
+#endif
+
+// Receives the UDP stream
+#ifndef UDP_STREAM_TASK_CORE
+#    define UDP_STREAM_TASK_CORE WIFI_SERVICES_TASK_CORE
+#endif
+#ifndef UDP_STREAM_TASK_PRIORITY
+#    define UDP_STREAM_TASK_PRIORITY (WIFI_SERVICES_TASK_PRIORITY + 1)
+#endif
+#ifndef UDP_STREAM_TASK_STACK
+#    define UDP_STREAM_TASK_STACK 4096
+#endif
+
+// Answers and times the round trips of a synchronized start
+#ifndef NETWORK_SYNC_TASK_CORE
+#    define NETWORK_SYNC_TASK_CORE WIFI_SERVICES_TASK_CORE
+#endif
+#ifndef NETWORK_SYNC_TASK_PRIORITY
+#    define NETWORK_SYNC_TASK_PRIORITY (WIFI_SERVICES_TASK_PRIORITY + 2)
+#endif
+#ifndef NETWORK_SYNC_TASK_STACK
+#    define NETWORK_SYNC_TASK_STACK 3072
+#endif
+
+#ifndef NOTIFICATION_TASK_CORE
+#    define NOTIFICATION_TASK_CORE SERVICE_TASK_ON(0)
+#endif
+#ifndef NOTIFICATION_TASK_PRIORITY
+#    define NOTIFICATION_TASK_PRIORITY 0
+#endif
+#ifndef NOTIFICATION_TASK_STACK
+#    define NOTIFICATION_TASK_STACK 8192  // TLS needs room
+#endif
+
+// Prints the StallGuard values for $Report/StallGuard and rereads the motor settings
+#ifndef STALLGUARD_DEBUG_TASK_CORE
+#    define STALLGUARD_DEBUG_TASK_CORE SERVICE_TASK_ON(0)
+#endif
+#ifndef STALLGUARD_DEBUG_TASK_PRIORITY
+#    define STALLGUARD_DEBUG_TASK_PRIORITY 1
+#endif
+#ifndef STALLGUARD_DEBUG_TASK_STACK
+#    define STALLGUARD_DEBUG_TASK_STACK 4096
+#endif
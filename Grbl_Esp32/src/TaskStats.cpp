@@ -0,0 +1,136 @@
+/*
+  TaskStats.cpp - run time, wait and stack statistics of the Grbl tasks
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_TASK_STATS
+
+// Only the task itself writes its entry after it is added.
+typedef struct {
+    TaskHandle_t handle;
+    int64_t      since_us;  // Added or reset
+    int64_t      mark_us;   // Last block or unblock
+    bool         blocked;
+    uint64_t     wait_us;  // Total time blocked
+    uint32_t     max_wait_us;
+    uint32_t     max_run_us;
+    uint32_t     waits;
+} task_entry_t;
+
+static task_entry_t task_entries[TASK_STATS_MAX_TASKS];
+static volatile int task_entry_count = 0;
+static portMUX_TYPE task_entry_mux   = portMUX_INITIALIZER_UNLOCKED;
+static int64_t      task_reset_us    = 0;
+
+static task_entry_t* task_entry() {
+    TaskHandle_t handle = xTaskGetCurrentTaskHandle();
+    int          count  = task_entry_count;
+    for (int i = 0; i < count; i++) {
+        if (task_entries[i].handle == handle) {
+            return &task_entries[i];
+        }
+    }
+    task_entry_t* entry = NULL;
+    portENTER_CRITICAL(&task_entry_mux);
+    if (task_entry_count < TASK_STATS_MAX_TASKS) {
+        entry = &task_entries[task_entry_count];
+        memset(entry, 0, sizeof(task_entry_t));
+        entry->handle   = handle;
+        entry->since_us = esp_timer_get_time();
+        entry->mark_us  = entry->since_us;
+        task_entry_count++;
+    }
+    portEXIT_CRITICAL(&task_entry_mux);
+    return entry;
+}
+
+void task_stats_register() {
+    task_entry();
+}
+
+void task_stats_block() {
+    task_entry_t* entry = task_entry();
+    if (!entry) {
+        return;
+    }
+    int64_t  now = esp_timer_get_time();
+    uint32_t run = uint32_t(now - entry->mark_us);
+    if (run > entry->max_run_us) {
+        entry->max_run_us = run;
+    }
+    entry->mark_us = now;
+    entry->blocked = true;
+}
+
+void task_stats_unblock() {
+    task_entry_t* entry = task_entry();
+    if (!entry || !entry->blocked) {
+        return;
+    }
+    int64_t  now  = esp_timer_get_time();
+    uint32_t wait = uint32_t(now - entry->mark_us);
+    if (wait > entry->max_wait_us) {
+        entry->max_wait_us = wait;
+    }
+    entry->wait_us += wait;
+    entry->waits++;
+    entry->mark_us = now;
+    entry->blocked = false;
+}
+
+uint8_t task_stats_count() {
+    return task_entry_count;
+}
+
+bool task_stats_get(uint8_t index, task_info_t* info) {
+    if (index >= task_entry_count) {
+        return false;
+    }
+    const task_entry_t* entry = &task_entries[index];
+    int64_t             now   = esp_timer_get_time();
+    int64_t             since = entry->since_us > task_reset_us ? entry->since_us : task_reset_us;
+    uint64_t            wait  = entry->wait_us;
+    if (entry->blocked) {
+        wait += now - entry->mark_us;  // The wait still going on
+    }
+    uint64_t   elapsed = now - since;
+    BaseType_t core    = xTaskGetAffinity(entry->handle);
+
+    info->name         = pcTaskGetTaskName(entry->handle);
+    info->core         = core == tskNO_AFFINITY ? -1 : core;
+    info->priority     = uxTaskPriorityGet(entry->handle);
+    info->stack_free   = uxTaskGetStackHighWaterMark(entry->handle);  // Bytes, the stack type is uint8_t
+    info->run_permille = elapsed && wait < elapsed ? uint32_t((elapsed - wait) * 1000 / elapsed) : 0;
+    info->waits        = entry->waits;
+    info->max_wait_us  = entry->max_wait_us;
+    info->max_run_us   = entry->max_run_us;
+    return true;
+}
+
+void task_stats_reset() {
+    task_reset_us = esp_timer_get_time();
+    for (int i = 0; i < task_entry_count; i++) {
+        task_entry_t* entry = &task_entries[i];
+        entry->wait_us      = 0;
+        entry->waits        = 0;
+        entry->max_wait_us  = 0;
+        entry->max_run_us   = 0;
+    }
+}
+
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+
+/*
+  TaskStats.h - run time, wait and stack statistics of the Grbl tasks
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Each Grbl task brackets the calls where it blocks with task_stats_block() and task_stats_unblock().
+  The time outside the brackets is the time the task was running or ready to run, which is its share of
+  a core when nothing of higher priority preempts it. The longest single wait and the longest stretch
+  between two waits show starvation and tasks that hog their core. The stack high-water mark, priority
+  and core come from FreeRTOS. A task appears after its first wait, or when it calls task_stats_register().
+
+  The prebuilt FreeRTOS of the Arduino core has no run time counters, which is why the tasks measure
+  themselves.
+*/
+
+#include "Grbl.h"
+
+// Tasks that can be tracked.
+#ifndef TASK_STATS_MAX_TASKS
+#    define TASK_STATS_MAX_TASKS 20
+#endif
+
+typedef struct {
+    const char* name;
+    int         core;  // -1 when not pinned
+    uint32_t    priority;
+    uint32_t    stack_free;    // Least free stack since the task started, in bytes
+    uint32_t    run_permille;  // Time not waiting, in 1/1000 of the time since the reset
+    uint32_t    waits;
+    uint32_t    max_wait_us;
+    uint32_t    max_run_us;
+} task_info_t;
+
+#ifdef ENABLE_TASK_STATS
+void task_stats_register();
+void task_stats_block();
+void task_stats_unblock();
+
+// Number of tracked tasks, and a snapshot of one of them.
+uint8_t task_stats_count();
+bool    task_stats_get(uint8_t index, task_info_t* info);
+
+void task_stats_reset();
+#else
+inline void task_stats_register() {}
+inline void task_stats_block() {}
+inline void task_stats_unblock() {}
+#endif
@@ -0,0 +1,106 @@
+/*
+  Timeline.cpp - recorder of the buffer levels along the motion path
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_TIMELINE
+
+typedef struct {
+    uint32_t time_ms;
+    uint32_t underruns;         // st_get_underrun_count() at the sample
+    float    feed;              // mm/min
+    uint16_t rx[CLIENT_COUNT];  // Bytes waiting in the receive buffer of each client
+    uint8_t  planner;           // Blocks in the planner buffer
+    uint8_t  segments;          // Segments in the step segment buffer
+} timeline_sample_t;
+
+static timeline_sample_t  timeline[TIMELINE_SAMPLES];
+static volatile uint16_t  timeline_head;  // Next sample to write
+static volatile uint16_t  timeline_used;
+static volatile bool      timeline_held;
+static esp_timer_handle_t timeline_timer = NULL;
+
+static void timeline_sample(void* arg) {
+    if (timeline_held) {
+        return;
+    }
+    timeline_sample_t* sample = &timeline[timeline_head];
+    sample->time_ms           = uint32_t(esp_timer_get_time() / 1000);
+    sample->underruns         = st_get_underrun_count();
+    sample->feed              = st_get_realtime_rate();
+    for (uint8_t client = 0; client < CLIENT_COUNT; client++) {
+        sample->rx[client] = serial_get_rx_buffer_size(client) - serial_get_rx_buffer_available(client);
+    }
+    sample->planner  = plan_get_block_buffer_count();
+    sample->segments = st_get_segment_buffer_count();
+    timeline_head    = (timeline_head + 1) % TIMELINE_SAMPLES;
+    if (timeline_used < TIMELINE_SAMPLES) {
+        timeline_used++;
+    }
+}
+
+void timeline_init() {
+    if (timeline_timer == NULL) {
+        esp_timer_create_args_t args = {};
+        args.callback                = timeline_sample;
+        args.name                    = "timeline";
+        esp_timer_create(&args, &timeline_timer);
+        esp_timer_start_periodic(timeline_timer, TIMELINE_SAMPLE_MS * 1000);
+    }
+}
+
+void timeline_clear() {
+    timeline_held = true;
+    timeline_used = 0;
+    timeline_head = 0;
+    timeline_held = false;
+}
+
+void timeline_hold(bool hold) {
+    timeline_held = hold;
+}
+
+uint16_t timeline_count() {
+    return timeline_used;
+}
+
+int timeline_header(char* buf, size_t size) {
+    return snprintf(buf, size, "time_ms,planner,segments,rx_serial,rx_bt,rx_webui,rx_telnet,rx_input,feed,underruns");
+}
+
+int timeline_line(uint16_t index, char* buf, size_t size) {
+    if (index >= timeline_used) {
+        return 0;
+    }
+    const timeline_sample_t* sample = &timeline[(timeline_head + TIMELINE_SAMPLES - timeline_used + index) % TIMELINE_SAMPLES];
+    return snprintf(buf,
+                    size,
+                    "%u,%u,%u,%u,%u,%u,%u,%u,%.1f,%u",
+                    sample->time_ms,
+                    sample->planner,
+                    sample->segments,
+                    sample->rx[CLIENT_SERIAL],
+                    sample->rx[CLIENT_BT],
+                    sample->rx[CLIENT_WEBUI],
+                    sample->rx[CLIENT_TELNET],
+                    sample->rx[CLIENT_INPUT],
+                    sample->feed,
+                    sample->underruns);
+}
+
+#endif
@@ -0,0 +1,55 @@
+#pragma once
+
+/*
+  Timeline.h - recorder of the buffer levels along the motion path
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  A periodic timer samples the bytes waiting in each client receive buffer, the planner blocks, the step
+  segments, the feed rate and the segment underrun count into a ring, which always holds the last
+  TIMELINE_SAMPLES samples. After a stutter the ring shows which stage ran dry first: input that stops
+  arriving empties the receive buffers, a slow parser leaves bytes waiting with a draining planner, and
+  a slow segment prep drains the segments with blocks still planned. An underrun shows as a step in the
+  count at the time of its sample.
+
+  $Timeline/Dump sends the ring as CSV, oldest sample first, and the WebUI serves it as /timeline.csv.
+  Sampling pauses while it is sent.
+*/
+
+#include "Grbl.h"
+
+#ifndef TIMELINE_SAMPLES
+#    define TIMELINE_SAMPLES 500
+#endif
+#ifndef TIMELINE_SAMPLE_MS
+#    define TIMELINE_SAMPLE_MS 20
+#endif
+
+void timeline_init();
+
+// Discards the samples.
+void timeline_clear();
+
+// Stops and restarts sampling, so the ring does not change while it is read.
+void timeline_hold(bool hold);
+
+// Samples in the ring. Index 0 is the oldest.
+uint16_t timeline_count();
+
+// The CSV header line and the CSV line of a sample, without line ends. Return the length.
+int timeline_header(char* buf, size_t size);
+int timeline_line(uint16_t index, char* buf, size_t size);
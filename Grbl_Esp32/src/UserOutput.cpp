@@ -19,6 +19,8 @@
 
 #include "Grbl.h"
 
+#include <soc/ledc_struct.h>
+
 namespace UserOutput {
     DigitalOutput::DigitalOutput() {}
 
@@ -52,6 +54,14 @@ namespace UserOutput {
         return true;
     }
 
+#ifdef SYNC_USER_OUTPUTS
+    void IRAM_ATTR DigitalOutput::set_level_isr(bool isOn) {
+        if (_pin != UNDEFINED_PIN) {
+            digitalWrite(_pin, isOn);
+        }
+    }
+#endif
+
     // ==================================================================
 
     AnalogOutput::AnalogOutput() {}
@@ -102,15 +112,49 @@ namespace UserOutput {
             return false;
         }
 
-        if (_current_value == percent)
-            return true;
+        duty = (percent / 100.0) * (1 << _resolution_bits);
 
-        _current_value = percent;
+        if (_current_duty == uint32_t(duty))
+            return true;
 
-        duty = (percent / 100.0) * (1 << _resolution_bits);
+        _current_duty = duty;
 
         ledcWrite(_pwm_channel, duty);
 
         return true;
     }
+
+#ifdef SYNC_USER_OUTPUTS
+    uint32_t AnalogOutput::duty(float percent) const { return (percent / 100.0) * (1 << _resolution_bits); }
+
+    void IRAM_ATTR AnalogOutput::write_duty_isr(uint32_t duty) {
+        if (_pin == UNDEFINED_PIN || duty == _current_duty) {
+            return;
+        }
+        _current_duty = duty;
+
+        // Same register sequence as ledcWrite(), but without its mutex, which cannot be taken in an ISR. A
+        // zero duty disables the output, which then stays at its idle level, low.
+        uint8_t group   = _pwm_channel / 8;
+        auto&   channel = LEDC.channel_group[group].channel[_pwm_channel % 8];
+        channel.duty.duty = duty << 4;  // 25 bit (21.4)
+        if (duty) {
+            channel.conf0.sig_out_en = 1;
+            channel.conf1.duty_start = 1;
+            if (group) {
+                channel.conf0.val |= BIT(4);  // low_speed_update
+            } else {
+                channel.conf0.clk_en = 1;
+            }
+        } else {
+            channel.conf0.sig_out_en = 0;
+            channel.conf1.duty_start = 0;
+            if (group) {
+                channel.conf0.val &= ~BIT(4);
+            } else {
+                channel.conf0.clk_en = 0;
+            }
+        }
+    }
+#endif
 }
\ No newline at end of file
@@ -28,6 +28,10 @@ namespace UserOutput {
         DigitalOutput(uint8_t number, uint8_t pin);
 
         bool set_level(bool isOn);
+#ifdef SYNC_USER_OUTPUTS
+        bool           defined() const { return _pin != UNDEFINED_PIN; }
+        void IRAM_ATTR set_level_isr(bool isOn);
+#endif
 
     protected:
         void init();
@@ -42,16 +46,21 @@ namespace UserOutput {
         AnalogOutput();
         AnalogOutput(uint8_t number, uint8_t pin, float pwm_frequency);
         bool set_level(float percent);
+#ifdef SYNC_USER_OUTPUTS
+        bool           defined() const { return _pin != UNDEFINED_PIN; }
+        uint32_t       duty(float percent) const;
+        void IRAM_ATTR write_duty_isr(uint32_t duty);
+#endif
 
     protected:
         void init();
         void config_message();
 
-        uint8_t _number      = UNDEFINED_PIN;
-        uint8_t _pin         = UNDEFINED_PIN;
-        uint8_t _pwm_channel = -1;  // -1 means invalid or not setup
-        float   _pwm_frequency;
-        uint8_t _resolution_bits;
-        float   _current_value;
+        uint8_t  _number      = UNDEFINED_PIN;
+        uint8_t  _pin         = UNDEFINED_PIN;
+        uint8_t  _pwm_channel = -1;  // -1 means invalid or not setup
+        float    _pwm_frequency;
+        uint8_t  _resolution_bits;
+        uint32_t _current_duty = 0;
     };
 }
\ No newline at end of file
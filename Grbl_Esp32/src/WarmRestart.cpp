@@ -0,0 +1,113 @@
+/*
+  WarmRestart.cpp - machine position kept in RTC memory across a restart of the CPU
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_WARM_RESTART
+
+#    include <esp_attr.h>
+#    include <esp_system.h>
+
+static const uint32_t WARM_RESTART_VALID = 0x57524d31;  // "WRM1"
+
+typedef struct {
+    uint32_t valid;  // WARM_RESTART_VALID, 0 when the position is not to be trusted
+    uint32_t n_axis;
+    int32_t  position[MAX_N_AXIS];
+    uint32_t checksum;
+} warm_restart_t;
+
+// Not cleared by the startup code, so a restart finds what was there
+static RTC_NOINIT_ATTR warm_restart_t warm_copy;
+
+static volatile bool warm_homed = false;  // A full homing cycle completed, or the position was restored
+
+// FNV-1a over everything but the checksum
+static uint32_t warm_restart_checksum(const warm_restart_t& copy) {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(&copy);
+    uint32_t       hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(warm_restart_t, checksum); i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool warm_restart_trusted() {
+    if (sys.state != State::Idle || sys_rt_exec_alarm != ExecAlarm::None || stepper_idle_lock_time->get() != 0xff) {
+        return false;
+    }
+    return warm_homed || !homing_enable->get();
+}
+
+void warm_restart_poll() {
+    if (!warm_restart_trusted()) {
+        warm_copy.valid = 0;
+        return;
+    }
+    int32_t position[MAX_N_AXIS];
+    system_get_position(position);
+    if (warm_copy.valid == WARM_RESTART_VALID && !memcmp(position, warm_copy.position, sizeof(position))) {
+        return;
+    }
+    warm_copy.valid = 0;  // While it changes
+    memcpy(warm_copy.position, position, sizeof(position));
+    warm_copy.n_axis   = number_axis->get();
+    warm_copy.checksum = warm_restart_checksum(warm_copy);
+    warm_copy.valid    = WARM_RESTART_VALID;
+}
+
+void warm_restart_invalidate() {
+    warm_copy.valid = 0;
+}
+
+void warm_restart_homed() {
+    warm_homed = true;
+}
+
+void IRAM_ATTR warm_restart_lost() {
+    warm_homed      = false;
+    warm_copy.valid = 0;
+}
+
+bool warm_restart_restore() {
+    warm_restart_t copy = warm_copy;
+    warm_copy.valid     = 0;
+    switch (esp_reset_reason()) {
+        case ESP_RST_SW:
+        case ESP_RST_PANIC:
+        case ESP_RST_INT_WDT:
+        case ESP_RST_TASK_WDT:
+        case ESP_RST_WDT:
+            break;
+        default:
+            return false;  // The RTC memory or the drivers may have lost power
+    }
+    if (copy.valid != WARM_RESTART_VALID || copy.n_axis != number_axis->get()) {
+        return false;
+    }
+    copy.valid = 0;  // As it was when the checksum was taken
+    if (copy.checksum != warm_restart_checksum(copy)) {
+        return false;
+    }
+    memcpy(sys_position, copy.position, sizeof(sys_position));
+    warm_homed = true;
+    grbl_msg_sendf(CLIENT_SERIAL, MsgLevel::Info, "Machine position kept across the restart");
+    return true;
+}
+
+#endif
@@ -0,0 +1,62 @@
+#pragma once
+
+/*
+  WarmRestart.h - machine position kept in RTC memory across a restart of the CPU
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  A soft reset (Ctrl-X) keeps sys_position, but a restart of the CPU, by a watchdog, a panic or
+  [ESP444]RESTART, starts from zero, and HOMING_INIT_LOCK then asks for a homing cycle. With
+  ENABLE_WARM_RESTART the main loop keeps a copy of the position, with a checksum, in RTC memory,
+  which the restart leaves alone, for as long as the position can be trusted: the machine is Idle
+  and not in alarm, the stepper drivers are held ($1=255), and, with homing enabled, a full $H has
+  completed since the position was last lost. Any alarm, a reset in motion among them, loses it. The copy is marked invalid as soon as the steppers
+  are woken for any motion, since steps can be lost in a stop the restart makes.
+
+  At boot the copy is taken, and the homing lock skipped, only after a restart of the CPU alone,
+  never after a power up, a brownout or the reset pin, and only when its checksum and axis count
+  match. The drivers must stay enabled through the restart, for which their enable input needs a
+  pull resistor that enables them while the pin floats, and nothing may move the axes meanwhile.
+*/
+
+#include "Grbl.h"
+
+#ifdef ENABLE_WARM_RESTART
+
+// Keeps the copy of the position up to date. Called once per pass of the main loop.
+void warm_restart_poll();
+
+// Marks the copy invalid. Called when the steppers wake up.
+void warm_restart_invalidate();
+
+// Tells that a full homing cycle completed.
+void warm_restart_homed();
+
+// Tells that the position was lost, so only a new $H makes it trusted again. Safe in an ISR.
+void warm_restart_lost();
+
+// Loads sys_position from the copy if it is valid. Returns true if it did. Called once at boot.
+bool warm_restart_restore();
+#else
+inline void warm_restart_poll() {}
+inline void warm_restart_invalidate() {}
+inline void warm_restart_homed() {}
+inline void warm_restart_lost() {}
+inline bool warm_restart_restore() {
+    return false;
+}
+#endif
@@ -38,6 +38,12 @@ namespace WebUI {
     String BTConfig::_btname   = "";
     String BTConfig::_btclient = "";
 
+    SemaphoreHandle_t BTConfig::_tx_mutex = NULL;
+    uint8_t           BTConfig::_tx_buffer[BT_TX_BUFFER_SIZE];
+    size_t            BTConfig::_tx_len   = 0;
+    uint32_t          BTConfig::_tx_since = 0;
+    bt_stats_t        BTConfig::_stats;
+
     BTConfig::BTConfig() {}
 
     static void my_spp_cb(esp_spp_cb_event_t event, esp_spp_cb_param_t* param) {
@@ -54,6 +60,9 @@ namespace WebUI {
                 grbl_send(CLIENT_ALL, "[MSG:BT Disconnected]\r\n");
                 BTConfig::_btclient = "";
                 break;
+            case ESP_SPP_DATA_IND_EVT:  // Data is already queued in SerialBT
+                serial_notify();
+                break;
             default:
                 break;
         }
@@ -113,6 +122,10 @@ namespace WebUI {
     void BTConfig::begin() {
         //stop active services
         end();
+        if (!_tx_mutex) {
+            _tx_mutex = xSemaphoreCreateMutex();
+            reset_stats();
+        }
         _btname = bt_name->get();
         if (wifi_radio_mode->get() == ESP_BT) {
             if (!SerialBT.begin(_btname)) {
@@ -129,14 +142,23 @@ namespace WebUI {
     /**
      * End WiFi
      */
-    void BTConfig::end() { SerialBT.end(); }
+    void BTConfig::end() {
+        if (_tx_mutex) {
+            xSemaphoreTake(_tx_mutex, portMAX_DELAY);
+            _tx_len = 0;
+            xSemaphoreGive(_tx_mutex);
+        }
+        SerialBT.end();
+    }
 
     /**
      * Reset ESP
      */
     void BTConfig::reset_settings() {
+        Setting::begin();
         bt_name->setDefault();
         wifi_radio_mode->setDefault();
+        Setting::commit();
         grbl_send(CLIENT_ALL, "[MSG:BT reset done]\r\n");
     }
 
@@ -151,6 +173,55 @@ namespace WebUI {
     void BTConfig::handle() {
         //If needed
         COMMANDS::wait(0);
+        if (_tx_len && (millis() - _tx_since) >= BT_TX_FLUSH_MS) {
+            flush();
+        }
+    }
+
+    // Called with _tx_mutex held.
+    void BTConfig::send_buffer() {
+        if (_tx_len) {
+            SerialBT.write(_tx_buffer, _tx_len);
+            _stats.bytes += _tx_len;
+            _stats.writes++;
+            _tx_len = 0;
+        }
+    }
+
+    void BTConfig::write(const uint8_t* data, size_t size) {
+        if (!_tx_mutex) {
+            return;
+        }
+        xSemaphoreTake(_tx_mutex, portMAX_DELAY);
+        if (_tx_len + size > BT_TX_BUFFER_SIZE) {
+            send_buffer();
+        }
+        if (size >= BT_TX_BUFFER_SIZE) {
+            SerialBT.write(data, size);
+            _stats.bytes += size;
+            _stats.writes++;
+        } else {
+            if (_tx_len == 0) {
+                _tx_since = millis();
+            }
+            memcpy(&_tx_buffer[_tx_len], data, size);
+            _tx_len += size;
+        }
+        xSemaphoreGive(_tx_mutex);
+    }
+
+    void BTConfig::flush() {
+        if (_tx_mutex) {
+            xSemaphoreTake(_tx_mutex, portMAX_DELAY);
+            send_buffer();
+            xSemaphoreGive(_tx_mutex);
+        }
+    }
+
+    void BTConfig::reset_stats() {
+        memset(&_stats, 0, sizeof(_stats));
+        _stats.since_ms    = millis();
+        _stats.since_lines = protocol_get_client_stats(CLIENT_BT)->lines;
     }
 
     BTConfig::~BTConfig() { end(); }
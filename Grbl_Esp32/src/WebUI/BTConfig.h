@@ -28,9 +28,27 @@ const char* const DEFAULT_BT_NAME = "btgrblesp";
 
 #include <BluetoothSerial.h>
 
+// Output to Bluetooth is collected and written in pieces of up to BT_TX_BUFFER_SIZE bytes, since
+// SerialBT sends every write as at least one SPP packet of at most 330 bytes. What is collected
+// goes out after BT_TX_FLUSH_MS at the latest.
+#ifndef BT_TX_BUFFER_SIZE
+#    define BT_TX_BUFFER_SIZE 330
+#endif
+#ifndef BT_TX_FLUSH_MS
+#    define BT_TX_FLUSH_MS 3
+#endif
+
 namespace WebUI {
     extern BluetoothSerial SerialBT;
 
+    // Counters reported by $BT/Stats.
+    typedef struct {
+        uint32_t bytes;
+        uint32_t writes;       // Writes to SerialBT, about one SPP packet each
+        uint32_t since_ms;     // Time of the last reset
+        uint32_t since_lines;  // Lines received from Bluetooth before the last reset
+    } bt_stats_t;
+
     class BTConfig {
         //boundaries
     public:
@@ -50,10 +68,23 @@ namespace WebUI {
         static bool        Is_BT_on();
         static String      _btclient;
 
+        static void              write(const uint8_t* data, size_t size);
+        static void              flush();
+        static const bt_stats_t* stats() { return &_stats; }
+        static void              reset_stats();
+
         ~BTConfig();
 
     private:
         static String _btname;
+
+        static void send_buffer();
+
+        static SemaphoreHandle_t _tx_mutex;
+        static uint8_t           _tx_buffer[BT_TX_BUFFER_SIZE];
+        static size_t            _tx_len;
+        static uint32_t          _tx_since;  // When the oldest byte in the buffer was added
+        static bt_stats_t        _stats;
     };
 
     extern BTConfig bt_config;
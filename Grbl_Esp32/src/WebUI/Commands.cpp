@@ -71,6 +71,9 @@ namespace WebUI {
         COMMANDS::wait(0);
         //in case of restart requested
         if (restart_ESP_module) {
+#ifdef COORDINATES_DEFERRED_WRITE
+            Coordinates::flush();
+#endif
             ESP.restart();
             while (1) {}
         }
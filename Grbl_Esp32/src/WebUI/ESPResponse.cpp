@@ -22,14 +22,32 @@
 #if defined(ENABLE_HTTP) && defined(ENABLE_WIFI)
 #    include "WebServer.h"
 #    include <WebServer.h>
+#    include <WebSocketsServer.h>
 #endif
 
 namespace WebUI {
 #if defined(ENABLE_HTTP) && defined(ENABLE_WIFI)
-    ESPResponseStream::ESPResponseStream(WebServer* webserver) {
+    ESPResponseStream::ESPResponseStream(WebServer* webserver, const char* content_type) {
+        _header_sent  = false;
+        _webserver    = webserver;
+        _content_type = content_type;
+        _socket       = NULL;
+        _prefix_len   = 0;
+        _client       = CLIENT_WEBUI;
+        _buffer       = NULL;
+        _buffer_len   = 0;
+    }
+
+    ESPResponseStream::ESPResponseStream(WebSocketsServer* socket, uint8_t num, const char* prefix) {
         _header_sent = false;
-        _webserver   = webserver;
+        _webserver   = NULL;
+        _socket      = socket;
+        _num         = num;
+        _prefix      = prefix;
+        _prefix_len  = strlen(prefix);
         _client      = CLIENT_WEBUI;
+        _buffer      = NULL;
+        _buffer_len  = 0;
     }
 #endif
 
@@ -38,6 +56,10 @@ namespace WebUI {
 #if defined(ENABLE_HTTP) && defined(ENABLE_WIFI)
         _header_sent = false;
         _webserver   = NULL;
+        _socket      = NULL;
+        _prefix_len  = 0;
+        _buffer      = NULL;
+        _buffer_len  = 0;
 #endif
     }
 
@@ -47,6 +69,16 @@ namespace WebUI {
 #if defined(ENABLE_HTTP) && defined(ENABLE_WIFI)
         _header_sent = false;
         _webserver   = NULL;
+        _socket      = NULL;
+        _prefix_len  = 0;
+        _buffer      = NULL;
+        _buffer_len  = 0;
+#endif
+    }
+
+    ESPResponseStream::~ESPResponseStream() {
+#if defined(ENABLE_HTTP) && defined(ENABLE_WIFI)
+        response_pool_release(_buffer);
 #endif
     }
 
@@ -72,6 +104,19 @@ namespace WebUI {
         }
     }
 
+    // Same as above, without a temporary String.
+    void ESPResponseStream::formatBytes(uint64_t bytes, char* buf, size_t size) {
+        if (bytes < 1024) {
+            snprintf(buf, size, "%u B", (unsigned)bytes);
+        } else if (bytes < (1024 * 1024)) {
+            snprintf(buf, size, "%.2f KB", bytes / 1024.0);
+        } else if (bytes < (1024 * 1024 * 1024)) {
+            snprintf(buf, size, "%.2f MB", bytes / 1024.0 / 1024.0);
+        } else {
+            snprintf(buf, size, "%.2f GB", bytes / 1024.0 / 1024.0 / 1024.0);
+        }
+    }
+
     void ESPResponseStream::print(const char* data) {
         if (_client == CLIENT_INPUT) {
             return;
@@ -80,19 +125,35 @@ namespace WebUI {
         if (_webserver) {
             if (!_header_sent) {
                 _webserver->setContentLength(CONTENT_LENGTH_UNKNOWN);
-                _webserver->sendHeader("Content-Type", "text/html");
+                _webserver->sendHeader("Content-Type", _content_type);
                 _webserver->sendHeader("Cache-Control", "no-cache");
                 _webserver->send(200);
                 _header_sent = true;
+                _buffer      = response_pool_acquire();
             }
 
-            _buffer += data;
-            if (_buffer.length() > 1200) {
-                //send data
-                _webserver->sendContent(_buffer);
-                //reset buffer
-                _buffer = "";
+            if (_buffer == NULL) {
+                _webserver->sendContent(data);  // All pool buffers in use, send unbuffered
+                return;
             }
+            append(data);
+            return;
+        }
+        if (_socket) {
+            if (!_header_sent) {
+                _header_sent = true;
+                _buffer      = response_pool_acquire();
+                if (_buffer) {
+                    memcpy(_buffer, _prefix, _prefix_len);
+                    _buffer_len = _prefix_len;
+                }
+            }
+            if (_buffer == NULL) {
+                String frame = String(_prefix) + data;  // All pool buffers in use, one frame each
+                _socket->sendTXT(_num, frame);
+                return;
+            }
+            append(data);
             return;
         }
 #endif
@@ -102,20 +163,64 @@ namespace WebUI {
         grbl_send(_client, data);
     }
 
+#if defined(ENABLE_HTTP) && defined(ENABLE_WIFI)
+    // Copies data to the buffer, sending it each time it fills up.
+    void ESPResponseStream::append(const char* data) {
+        size_t len = strlen(data);
+        while (len) {
+            size_t n = BUFFER_SIZE - _buffer_len;
+            if (n > len) {
+                n = len;
+            }
+            memcpy(_buffer + _buffer_len, data, n);
+            _buffer_len += n;
+            data += n;
+            len -= n;
+            if (_buffer_len == BUFFER_SIZE) {
+                send_buffer();
+            }
+        }
+    }
+
+    // Sends the buffer as one chunk of the chunked transfer, or as one frame after the prefix.
+    void ESPResponseStream::send_buffer() {
+        if (_socket) {
+            if (_buffer_len > _prefix_len) {
+                _socket->sendTXT(_num, (uint8_t*)_buffer, _buffer_len);
+                _buffer_len = _prefix_len;
+            }
+            return;
+        }
+        if (_buffer_len) {
+            _webserver->sendContent_P(_buffer, _buffer_len);
+            _buffer_len = 0;
+        }
+    }
+#endif
+
     void ESPResponseStream::flush() {
 #if defined(ENABLE_HTTP) && defined(ENABLE_WIFI)
         if (_webserver) {
             if (_header_sent) {
                 //send data
-                if (_buffer.length() > 0) {
-                    _webserver->sendContent(_buffer);
-                }
+                send_buffer();
 
                 //close connection
                 _webserver->sendContent("");
             }
             _header_sent = false;
-            _buffer      = "";
+            _buffer_len  = 0;
+            response_pool_release(_buffer);
+            _buffer = NULL;
+        }
+        if (_socket) {
+            if (_buffer) {
+                send_buffer();
+            }
+            _header_sent = false;
+            _buffer_len  = 0;
+            response_pool_release(_buffer);
+            _buffer = NULL;
         }
 #endif
     }
@@ -21,23 +21,29 @@
 */
 
 #if defined(ENABLE_HTTP) && defined(ENABLE_WIFI)
+#    include "ResponsePool.h"
 class WebServer;
+class WebSocketsServer;
 #endif
 
 namespace WebUI {
     class ESPResponseStream {
     public:
 #if defined(ENABLE_HTTP) && defined(ENABLE_WIFI)
-        ESPResponseStream(WebServer* webserver);
+        ESPResponseStream(WebServer* webserver, const char* content_type = "text/html");
+        // Output of a websocket command, sent to connection num in text frames that start with prefix
+        ESPResponseStream(WebSocketsServer* socket, uint8_t num, const char* prefix);
 #endif
         ESPResponseStream(uint8_t client, bool byid = true);
         ESPResponseStream();
+        ~ESPResponseStream();
 
         void          print(const char* data);
         void          println(const char* data);
         void          flush();
         bool          anyOutput() { return _header_sent; }
         static String formatBytes(uint64_t bytes);
+        static void   formatBytes(uint64_t bytes, char* buf, size_t size);
         uint8_t       client() { return _client; }
 
     private:
@@ -45,8 +51,22 @@ namespace WebUI {
         bool    _header_sent;
 
 #if defined(ENABLE_HTTP) && defined(ENABLE_WIFI)
-        WebServer* _webserver;
-        String     _buffer;
+        // Output for the web server is sent in chunks of about one TCP segment. The buffer is taken from
+        // the response pool when the first output arrives and returned by flush(), so responses do not
+        // allocate from the heap. See ResponsePool.h.
+        static const size_t BUFFER_SIZE = RESPONSE_POOL_BUFFER_SIZE;
+
+        void append(const char* data);
+        void send_buffer();
+
+        WebServer*        _webserver;
+        const char*       _content_type;
+        WebSocketsServer* _socket;
+        uint8_t           _num;
+        const char*       _prefix;
+        size_t            _prefix_len;
+        char*             _buffer;
+        size_t            _buffer_len;
 #endif
     };
 }
@@ -0,0 +1,108 @@
+/*
+  EthConfig.cpp -  wired Ethernet functions class
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "../Grbl.h"
+
+#ifdef ENABLE_ETHERNET
+
+#    include "EthConfig.h"
+#    include "WifiServices.h"
+
+namespace WebUI {
+    EthConfig eth_config;
+
+    bool EthConfig::_started   = false;
+    bool EthConfig::_connected = false;
+
+    EthConfig::EthConfig() {}
+
+    const char* EthConfig::info() {
+        static String result;
+        String        tmp;
+        result = "[MSG:Mode=ETH";
+        if (!_started) {
+            result += ":Off]\r\n";
+            return result.c_str();
+        }
+        result += ":Status=";
+        result += _connected ? "Connected" : "Not connected";
+        if (_connected) {
+            result += ":Speed=";
+            result += String(ETH.linkSpeed());
+            result += ETH.fullDuplex() ? "Mbps Full" : "Mbps Half";
+        }
+        result += ":IP=";
+        result += ETH.localIP().toString();
+        result += ":MAC=";
+        tmp = ETH.macAddress();
+        tmp.replace(":", "-");
+        result += tmp;
+        result += "]\r\n";
+        return result.c_str();
+    }
+
+    void EthConfig::EthEvent(WiFiEvent_t event) {
+        switch (event) {
+            case SYSTEM_EVENT_ETH_START:
+                // The hostname can only be set once the interface exists
+                ETH.setHostname(wifi_hostname->get());
+                break;
+            case SYSTEM_EVENT_ETH_CONNECTED:
+                grbl_send(CLIENT_ALL, "[MSG:Ethernet link up]\r\n");
+                break;
+            case SYSTEM_EVENT_ETH_GOT_IP:
+                grbl_sendf(CLIENT_ALL, "[MSG:Ethernet connected with %s]\r\n", ETH.localIP().toString().c_str());
+                _connected = true;
+                break;
+            case SYSTEM_EVENT_ETH_DISCONNECTED:
+                grbl_send(CLIENT_ALL, "[MSG:Ethernet link down]\r\n");
+                _connected = false;
+                break;
+            case SYSTEM_EVENT_ETH_STOP:
+                _connected = false;
+                break;
+            default:
+                break;
+        }
+    }
+
+    /**
+     * begin Ethernet setup
+     * The EMAC driver cannot be stopped and started again, so changes of the settings apply at the
+     * next restart.
+     */
+    void EthConfig::begin() {
+        if (_started || eth_ip_mode->get() == ESP_ETH_OFF) {
+            return;
+        }
+        WiFi.onEvent(EthConfig::EthEvent);
+        if (!ETH.begin()) {
+            grbl_send(CLIENT_ALL, "[MSG:Starting Ethernet failed]\r\n");
+            return;
+        }
+        if (eth_ip_mode->get() == ESP_ETH_STATIC) {
+            IPAddress ip(eth_ip->get()), mask(eth_netmask->get()), gateway(eth_gateway->get());
+            ETH.config(ip, gateway, mask);
+        }
+        _started = true;
+        grbl_send(CLIENT_ALL, "[MSG:Ethernet Started]\r\n");
+    }
+
+    EthConfig::~EthConfig() {}
+}
+#endif  // ENABLE_ETHERNET
@@ -0,0 +1,59 @@
+#pragma once
+
+/*
+  EthConfig.h -  wired Ethernet functions class
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// The PHY is wired to the EMAC of the ESP32 through RMII. Its address, power pin, management pins,
+// type and clock come from the ETH_PHY_ADDR, ETH_PHY_POWER, ETH_PHY_MDC, ETH_PHY_MDIO, ETH_PHY_TYPE
+// and ETH_CLK_MODE defines of <ETH.h>, which default to a LAN8720 clocked from GPIO0. A machine
+// file defines them to match its board.
+#include <WiFi.h>
+#include <ETH.h>
+
+namespace WebUI {
+    //Ethernet IP mode
+    static const int ESP_ETH_OFF    = 0;
+    static const int ESP_ETH_DHCP   = 1;
+    static const int ESP_ETH_STATIC = 2;
+
+    //defaults values
+    static const int   DEFAULT_ETH_IP_MODE = ESP_ETH_DHCP;
+    static const char* DEFAULT_ETH_IP      = "0.0.0.0";
+    static const char* DEFAULT_ETH_GW      = "0.0.0.0";
+    static const char* DEFAULT_ETH_MK      = "0.0.0.0";
+
+    class EthConfig {
+    public:
+        EthConfig();
+
+        static const char* info();
+        static void        begin();
+        // True once the interface is up, whether or not the link is, so the services can listen on it
+        static bool started() { return _started; }
+        static bool connected() { return _connected; }
+
+        ~EthConfig();
+
+    private:
+        static void EthEvent(WiFiEvent_t event);
+        static bool _started;
+        static bool _connected;
+    };
+
+    extern EthConfig eth_config;
+}
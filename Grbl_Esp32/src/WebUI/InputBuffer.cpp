@@ -24,90 +24,80 @@
 namespace WebUI {
     InputBuffer inputBuffer;
 
-    InputBuffer::InputBuffer() {
-        _RXbufferSize = 0;
-        _RXbufferpos  = 0;
-    }
+    InputBuffer::InputBuffer(uint16_t size) : _RXbuffer(new uint8_t[size]), _RXsize(size), _RXhead(0), _RXtail(0) {}
 
-    void InputBuffer::begin() {
-        _RXbufferSize = 0;
-        _RXbufferpos  = 0;
-    }
+    // Discards everything in the buffer. Only moves the read index, so it is safe for the consumer.
+    void InputBuffer::begin() { _RXtail.store(_RXhead.load(std::memory_order_acquire), std::memory_order_release); }
 
-    void InputBuffer::end() {
-        _RXbufferSize = 0;
-        _RXbufferpos  = 0;
-    }
+    void InputBuffer::end() { begin(); }
 
     InputBuffer::operator bool() const { return true; }
 
-    int InputBuffer::available() { return _RXbufferSize; }
-
-    int InputBuffer::availableforwrite() { return RXBUFFERSIZE - _RXbufferSize; }
-
-    size_t InputBuffer::write(uint8_t c) {
-        if ((1 + _RXbufferSize) <= RXBUFFERSIZE) {
-            int current = _RXbufferpos + _RXbufferSize;
-            if (current > RXBUFFERSIZE) {
-                current = current - RXBUFFERSIZE;
-            }
-            if (current > (RXBUFFERSIZE - 1)) {
-                current = 0;
-            }
-            _RXbuffer[current] = c;
-            current++;
-            _RXbufferSize += 1;
-            return 1;
-        }
-        return 0;
+    int InputBuffer::available() {
+        return uint16_t(_RXhead.load(std::memory_order_acquire) - _RXtail.load(std::memory_order_relaxed));
     }
 
+    int InputBuffer::availableforwrite() {
+        return _RXsize - uint16_t(_RXhead.load(std::memory_order_relaxed) - _RXtail.load(std::memory_order_acquire));
+    }
+
+    size_t InputBuffer::write(uint8_t c) { return write(&c, 1); }
+
     size_t InputBuffer::write(const uint8_t* buffer, size_t size) {
-        //No need currently
-        //keep for compatibility
+        uint16_t head = _RXhead.load(std::memory_order_relaxed);
+        uint16_t room = _RXsize - uint16_t(head - _RXtail.load(std::memory_order_acquire));
+        if (size > room) {
+            size = room;
+        }
+        // At most two copies, up to the end of the ring and from its start
+        uint16_t pos   = head & (_RXsize - 1);
+        size_t   first = _RXsize - pos;
+        if (first > size) {
+            first = size;
+        }
+        memcpy(_RXbuffer + pos, buffer, first);
+        memcpy(_RXbuffer, buffer + first, size - first);
+        _RXhead.store(head + size, std::memory_order_release);
         return size;
     }
 
     int InputBuffer::peek(void) {
-        if (_RXbufferSize > 0) {
-            return _RXbuffer[_RXbufferpos];
-        } else {
+        uint16_t tail = _RXtail.load(std::memory_order_relaxed);
+        if (_RXhead.load(std::memory_order_acquire) == tail) {
             return -1;
         }
+        return _RXbuffer[tail & (_RXsize - 1)];
     }
 
     bool InputBuffer::push(const char* data) {
-        int data_size = strlen(data);
-        if ((data_size + _RXbufferSize) <= RXBUFFERSIZE) {
-            int current = _RXbufferpos + _RXbufferSize;
-            if (current > RXBUFFERSIZE) {
-                current = current - RXBUFFERSIZE;
-            }
-            for (int i = 0; i < data_size; i++) {
-                if (current > (RXBUFFERSIZE - 1)) {
-                    current = 0;
-                }
-                _RXbuffer[current] = data[i];
-                current++;
-            }
-            _RXbufferSize += strlen(data);
-            return true;
+        size_t data_size = strlen(data);
+        if (data_size > size_t(availableforwrite())) {
+            return false;
         }
-        return false;
+        write((const uint8_t*)data, data_size);
+        return true;
     }
 
     int InputBuffer::read(void) {
-        if (_RXbufferSize > 0) {
-            int v = _RXbuffer[_RXbufferpos];
-            _RXbufferpos++;
-            if (_RXbufferpos > (RXBUFFERSIZE - 1)) {
-                _RXbufferpos = 0;
-            }
-            _RXbufferSize--;
-            return v;
-        } else {
-            return -1;
+        uint8_t c;
+        return read(&c, 1) ? c : -1;
+    }
+
+    size_t InputBuffer::read(uint8_t* buffer, size_t size) {
+        uint16_t tail  = _RXtail.load(std::memory_order_relaxed);
+        uint16_t count = uint16_t(_RXhead.load(std::memory_order_acquire) - tail);
+        if (size > count) {
+            size = count;
+        }
+        uint16_t pos   = tail & (_RXsize - 1);
+        size_t   first = _RXsize - pos;
+        if (first > size) {
+            first = size;
         }
+        memcpy(buffer, _RXbuffer + pos, first);
+        memcpy(buffer + first, _RXbuffer, size - first);
+        _RXtail.store(tail + size, std::memory_order_release);
+        return size;
     }
 
     void InputBuffer::flush(void) {
@@ -115,8 +105,5 @@ namespace WebUI {
         //keep for compatibility
     }
 
-    InputBuffer::~InputBuffer() {
-        _RXbufferSize = 0;
-        _RXbufferpos  = 0;
-    }
+    InputBuffer::~InputBuffer() { delete[] _RXbuffer; }
 }
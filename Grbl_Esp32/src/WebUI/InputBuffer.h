@@ -21,12 +21,18 @@
 */
 
 #include <Print.h>
+#include <atomic>
 #include <cstring>
 
 namespace WebUI {
+    // Single-producer, single-consumer ring buffer. One task writes and one task reads without any
+    // locking. The write index is only advanced by the producer and the read index only by the consumer.
+    // The size must be a power of 2 no larger than 32768.
     class InputBuffer : public Print {
     public:
-        InputBuffer();
+        static const int RXBUFFERSIZE = 128;  // Default size
+
+        InputBuffer(uint16_t size = RXBUFFERSIZE);
 
         size_t        write(uint8_t c);
         size_t        write(const uint8_t* buffer, size_t size);
@@ -39,8 +45,10 @@ namespace WebUI {
         void          end();
         int           available();
         int           availableforwrite();
+        inline int    size() const { return _RXsize; }
         int           peek(void);
         int           read(void);
+        size_t        read(uint8_t* buffer, size_t size);
         bool          push(const char* data);
         void          flush(void);
 
@@ -49,11 +57,11 @@ namespace WebUI {
         ~InputBuffer();
 
     private:
-        static const int RXBUFFERSIZE = 128;
-
-        uint8_t  _RXbuffer[RXBUFFERSIZE];
-        uint16_t _RXbufferSize;
-        uint16_t _RXbufferpos;
+        uint8_t* _RXbuffer;
+        uint16_t _RXsize;
+        // Free running indices. Their difference is the number of bytes in the buffer.
+        std::atomic<uint16_t> _RXhead;  // Written by the producer
+        std::atomic<uint16_t> _RXtail;  // Written by the consumer
     };
 
     extern InputBuffer inputBuffer;
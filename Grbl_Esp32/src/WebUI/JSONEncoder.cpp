@@ -10,7 +10,41 @@ namespace WebUI {
 
     // Constructor.  If _pretty is true, newlines are
     // inserted into the JSON string for easy reading.
-    JSONencoder::JSONencoder(bool pretty) : pretty(pretty), level(0), str("") { count[level] = 0; }
+    JSONencoder::JSONencoder(bool pretty) : JSONencoder(pretty, nullptr) {}
+
+    JSONencoder::JSONencoder(bool pretty, ESPResponseStream* stream) : pretty(pretty), level(0), str(""), stream(stream), buf_len(0) {
+        count[level] = 0;
+    }
+
+    void JSONencoder::add(char c) {
+        if (!stream) {
+            str += c;
+            return;
+        }
+        buf[buf_len++] = c;
+        if (buf_len == BUFFER_SIZE - 1) {
+            flush();
+        }
+    }
+
+    void JSONencoder::add(const char* s) {
+        if (!stream) {
+            str.concat(s);
+            return;
+        }
+        while (*s) {
+            add(*s++);
+        }
+    }
+
+    // Sends the buffered output to the stream.
+    void JSONencoder::flush() {
+        if (buf_len) {
+            buf[buf_len] = '\0';
+            stream->print(buf);
+            buf_len = 0;
+        }
+    }
 
     // Private function to add commas between
     // elements as needed, omitting the comma
@@ -38,7 +72,7 @@ namespace WebUI {
     // Private function to add a name enclosed with quotes.
     void JSONencoder::quoted(const char* s) {
         add('"');
-        str.concat(s);
+        add(s);
         add('"');
     }
 
@@ -73,6 +107,9 @@ namespace WebUI {
     // and returning the encoded string
     String JSONencoder::end() {
         end_object();
+        if (stream) {
+            flush();
+        }
         return str;
     }
 
@@ -122,13 +159,17 @@ namespace WebUI {
     }
 
     // Creates a "tag":"value" member from an Arduino string
-    void JSONencoder::member(const char* tag, String value) {
+    void JSONencoder::member(const char* tag, const String& value) {
         begin_member(tag);
         quoted(value.c_str());
     }
 
     // Creates a "tag":"value" member from an integer
-    void JSONencoder::member(const char* tag, int value) { member(tag, String(value)); }
+    void JSONencoder::member(const char* tag, int value) {
+        char value_str[12];
+        snprintf(value_str, sizeof(value_str), "%d", value);
+        member(tag, value_str);
+    }
 
     // Creates an Esp32_WebUI configuration item specification from
     // a value passed in as a C-style string.
@@ -144,7 +185,9 @@ namespace WebUI {
     // Creates an Esp32_WebUI configuration item specification from
     // an integer value.
     void JSONencoder::begin_webui(const char* p, const char* help, const char* type, int val) {
-        begin_webui(p, help, type, String(val).c_str());
+        char val_str[12];
+        snprintf(val_str, sizeof(val_str), "%d", val);
+        begin_webui(p, help, type, val_str);
     }
 
     // Creates an Esp32_WebUI configuration item specification from
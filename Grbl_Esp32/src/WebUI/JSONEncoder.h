@@ -3,16 +3,24 @@
 // Class for creating JSON-encoded strings.
 
 namespace WebUI {
+    class ESPResponseStream;
+
     class JSONencoder {
     private:
         static const int MAX_JSON_LEVEL = 16;
+        static const int BUFFER_SIZE    = 256;
 
-        bool   pretty;
-        int    level;
-        String str;
-        int    count[MAX_JSON_LEVEL];
-        void   add(char c) { str += c; }
-        void   comma_line();
+        bool               pretty;
+        int                level;
+        String             str;
+        ESPResponseStream* stream;
+        char               buf[BUFFER_SIZE];
+        int                buf_len;
+        int                count[MAX_JSON_LEVEL];
+        void               add(char c);
+        void               add(const char* s);
+        void               flush();
+        void               comma_line();
         void   comma();
         void   quoted(const char* s);
         void   inc_level();
@@ -26,15 +34,19 @@ namespace WebUI {
         // Constructor; set _pretty true for pretty printing
         JSONencoder(bool pretty);
 
+        // Streaming constructor. The output goes to stream in pieces of a small fixed buffer instead of
+        // being collected in a String, so the memory used does not grow with the length.
+        JSONencoder(bool pretty, ESPResponseStream* stream);
+
         // begin() starts the encoding process.
         void begin();
 
-        // end() returns the encoded string
+        // end() returns the encoded string. When streaming it sends the rest and returns an empty string.
         String end();
 
         // member() creates a "tag":"value" element
         void member(const char* tag, const char* value);
-        void member(const char* tag, String value);
+        void member(const char* tag, const String& value);
         void member(const char* tag, int value);
 
         // begin_array() starts a "tag":[  array element
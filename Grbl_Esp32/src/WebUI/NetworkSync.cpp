@@ -0,0 +1,271 @@
+/*
+  NetworkSync.cpp - cycle start at the same moment on several controllers
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../Grbl.h"
+
+#if defined(ENABLE_WIFI) && defined(ENABLE_NETWORK_SYNC)
+
+#    include <lwip/sockets.h>
+#    include "NetworkSync.h"
+
+namespace WebUI {
+    Network_Sync network_sync;
+
+    static TaskHandle_t syncTaskHandle = NULL;
+    static portMUX_TYPE sync_spinlock  = portMUX_INITIALIZER_UNLOCKED;
+
+    static const int SYNC_PACKET_SIZE = 21;  // Type, id and two times
+
+    Network_Sync::Network_Sync() {
+        _sock         = -1;
+        _armed        = false;
+        _timer        = NULL;
+        _id           = 0;
+        _leader_addr  = 0;
+        _leader_start = 0;
+        _ping_sent    = 0;
+        _pings_left   = 0;
+        _best_rtt     = 0;
+        _offset       = 0;
+    }
+
+    bool Network_Sync::begin() {
+        end();
+        if (!_timer) {
+            esp_timer_create_args_t args = {};
+            args.callback                = fire;
+            args.arg                     = this;
+            args.dispatch_method         = ESP_TIMER_TASK;
+            args.name                    = "syncStart";
+            esp_timer_create(&args, &_timer);
+        }
+        int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (sock < 0) {
+            grbl_send(CLIENT_ALL, "[MSG:Cannot start sync]\r\n");
+            return false;
+        }
+        int broadcast = 1;
+        setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &broadcast, sizeof(broadcast));
+        sockaddr_in addr     = {};
+        addr.sin_family      = AF_INET;
+        addr.sin_port        = htons(NETWORK_SYNC_PORT);
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(sock, (sockaddr*)&addr, sizeof(addr)) < 0) {
+            close(sock);
+            grbl_send(CLIENT_ALL, "[MSG:Cannot start sync]\r\n");
+            return false;
+        }
+        // The receive task also wakes without traffic, to send a round trip again when one is lost
+        timeval timeout = { 0, NETWORK_SYNC_PING_TIMEOUT_MS * 1000 };
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        _sock = sock;
+        if (!syncTaskHandle) {
+            xTaskCreatePinnedToCore(receiveTask,  // task
+                                    "syncTask",   // name for task
+                                    NETWORK_SYNC_TASK_STACK,
+                                    this,  // parameters
+                                    NETWORK_SYNC_TASK_PRIORITY,
+                                    &syncTaskHandle,
+                                    NETWORK_SYNC_TASK_CORE  // core
+            );
+        }
+        grbl_sendf(CLIENT_ALL, "[MSG:Sync Started %d]\r\n", NETWORK_SYNC_PORT);
+        return true;
+    }
+
+    void Network_Sync::end() {
+        int sock = _sock;
+        _sock    = -1;
+        if (sock >= 0) {
+            close(sock);
+        }
+    }
+
+    void Network_Sync::arm(bool armed) {
+        if (!armed && _timer) {
+            esp_timer_stop(_timer);
+        }
+        portENTER_CRITICAL(&sync_spinlock);
+        _pings_left = 0;  // Stops following a start
+        _ping_sent  = 0;
+        portEXIT_CRITICAL(&sync_spinlock);
+        _armed = armed;
+    }
+
+    bool Network_Sync::start(uint32_t delay_ms) {
+        if (_sock < 0 || delay_ms < NETWORK_SYNC_MIN_LEAD_MS) {
+            return false;
+        }
+        int64_t start = esp_timer_get_time() + delay_ms * 1000LL;
+        portENTER_CRITICAL(&sync_spinlock);
+        _id           = esp_random();
+        _leader_addr  = 0;
+        _leader_start = start;
+        _pings_left   = 0;
+        _ping_sent    = 0;
+        _offset       = 0;
+        _best_rtt     = 0;
+        portEXIT_CRITICAL(&sync_spinlock);
+        _armed = true;
+        for (int i = 0; i < NETWORK_SYNC_REPEATS; i++) {
+            send('S', start, 0, htonl(INADDR_BROADCAST));
+        }
+        schedule(start);
+        return true;
+    }
+
+    // Runs in the esp_timer task at the scheduled moment.
+    void Network_Sync::fire(void* arg) {
+        Network_Sync* sync = (Network_Sync*)arg;
+        sync->_armed       = false;
+        if (plan_get_current_block() != NULL) {
+            system_set_exec_state_flag(EXEC_CYCLE_START);
+        }
+        idle_power_wake();
+    }
+
+    void Network_Sync::schedule(int64_t local_start) {
+        int64_t delay = local_start - esp_timer_get_time();
+        if (delay <= 0) {
+            grbl_sendf(CLIENT_ALL, "[MSG:Sync start missed by %lld us, still armed]\r\n", -delay);
+            return;
+        }
+        esp_timer_stop(_timer);
+        esp_timer_start_once(_timer, delay);
+        grbl_sendf(CLIENT_ALL, "[MSG:Sync start in %lld ms, offset %lld us, round trip %u us]\r\n", delay / 1000, _offset, _best_rtt);
+    }
+
+    void Network_Sync::send(uint8_t type, int64_t a, int64_t b, uint32_t addr) {
+        int sock = _sock;
+        if (sock < 0) {
+            return;
+        }
+        uint8_t packet[SYNC_PACKET_SIZE];
+        packet[0] = type;
+        memcpy(&packet[1], &_id, sizeof(_id));
+        memcpy(&packet[5], &a, sizeof(a));
+        memcpy(&packet[13], &b, sizeof(b));
+        sockaddr_in to     = {};
+        to.sin_family      = AF_INET;
+        to.sin_port        = htons(NETWORK_SYNC_PORT);
+        to.sin_addr.s_addr = addr;
+        sendto(sock, packet, type == 'Q' ? SYNC_PACKET_SIZE : SYNC_PACKET_SIZE - 8, 0, (sockaddr*)&to, sizeof(to));
+    }
+
+    void Network_Sync::send_ping() {
+        _ping_sent = esp_timer_get_time();
+        send('P', _ping_sent, 0, _leader_addr);
+    }
+
+    // Schedules the start with the best round trip, once all are done.
+    void Network_Sync::finish() {
+        if (_best_rtt == UINT32_MAX) {
+            grbl_send(CLIENT_ALL, "[MSG:Sync leader did not answer, still armed]\r\n");
+            return;
+        }
+        schedule(_leader_start - _offset);
+    }
+
+    void Network_Sync::receive(const uint8_t* packet, int len, const void* from) {
+        if (len < SYNC_PACKET_SIZE - 8) {
+            return;
+        }
+        uint32_t id;
+        int64_t  a;
+        memcpy(&id, &packet[1], sizeof(id));
+        memcpy(&a, &packet[5], sizeof(a));
+        uint32_t from_addr = ((const sockaddr_in*)from)->sin_addr.s_addr;
+        switch (packet[0]) {
+            case 'S':
+                if (id == _id) {
+                    return;  // A repeat
+                }
+                if (_timer) {
+                    esp_timer_stop(_timer);
+                }
+                portENTER_CRITICAL(&sync_spinlock);
+                _id           = id;
+                _leader_addr  = from_addr;
+                _leader_start = a;
+                _pings_left   = NETWORK_SYNC_PINGS;
+                _best_rtt     = UINT32_MAX;
+                portEXIT_CRITICAL(&sync_spinlock);
+                _armed = true;
+                send_ping();
+                break;
+            case 'P':
+                if (id == _id && _leader_addr == 0) {
+                    send('Q', a, esp_timer_get_time(), from_addr);
+                }
+                break;
+            case 'Q': {
+                int64_t now = esp_timer_get_time();
+                int64_t leader_now;
+                if (len < SYNC_PACKET_SIZE || id != _id || !_ping_sent || a != _ping_sent) {
+                    return;  // Late, or not ours
+                }
+                memcpy(&leader_now, &packet[13], sizeof(leader_now));
+                uint32_t rtt = now - a;
+                if (rtt < _best_rtt) {
+                    _best_rtt = rtt;
+                    _offset   = leader_now - (a + now) / 2;
+                }
+                _ping_sent = 0;
+                if (--_pings_left) {
+                    send_ping();
+                } else {
+                    finish();
+                }
+                break;
+            }
+        }
+    }
+
+    void Network_Sync::receiveTask(void* pvParameters) {
+        Network_Sync* sync = (Network_Sync*)pvParameters;
+        uint8_t       packet[SYNC_PACKET_SIZE];
+        while (true) {
+            int sock = sync->_sock;
+            if (sock < 0) {
+                vTaskDelay(100 / portTICK_RATE_MS);
+                continue;
+            }
+            sockaddr_in from;
+            socklen_t   fromlen = sizeof(from);
+            task_stats_block();
+            int len = recvfrom(sock, packet, sizeof(packet), 0, (sockaddr*)&from, &fromlen);
+            task_stats_unblock();
+            if (len > 0) {
+                sync->receive(packet, len, &from);
+            }
+            // A lost round trip counts as done
+            if (sync->_ping_sent && esp_timer_get_time() - sync->_ping_sent > NETWORK_SYNC_PING_TIMEOUT_MS * 1000) {
+                sync->_ping_sent = 0;
+                if (--sync->_pings_left) {
+                    sync->send_ping();
+                } else {
+                    sync->finish();
+                }
+            }
+        }
+    }
+
+    Network_Sync::~Network_Sync() { end(); }
+}
+
+#endif
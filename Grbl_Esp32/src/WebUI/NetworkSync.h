@@ -0,0 +1,111 @@
+#pragma once
+
+/*
+  NetworkSync.h - cycle start at the same moment on several controllers
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  $Sync/Arm holds the automatic cycle start, so the program streamed next fills the planner without
+  moving. $Sync/Start=<ms> on one controller, the leader for this start, arms it too, schedules its
+  cycle start <ms> from now and broadcasts the time of the start, on its own clock, to
+  NETWORK_SYNC_PORT. Every controller on the network that hears it arms, then measures the offset of
+  its clock to the leader's with NETWORK_SYNC_PINGS round trips and keeps the one that took the least
+  time, which is the one the network delayed least. It then schedules its cycle start at the same
+  moment on its own clock. An esp_timer sets the cycle start flag at that moment; the main loop acts
+  on it in its next pass, which is what remains of the difference between the controllers.
+
+  The start must lie NETWORK_SYNC_MIN_LEAD_MS ahead, to leave time for the round trips. A controller
+  that could not measure its offset in time stays armed and says so; $Sync/Arm=0 releases it and
+  starts what it holds. A reset drops the hold. Packets, multi-byte fields little-endian:
+
+      'S' id u32 start i64       the start, broadcast by the leader, NETWORK_SYNC_REPEATS times
+      'P' id u32 sent i64        a round trip request, to the leader
+      'Q' id u32 sent i64 now i64
+                                 its answer, with the leader's clock when it was answered
+*/
+
+#include "../Config.h"
+
+#include <stdint.h>
+#include <esp_timer.h>
+
+#ifndef NETWORK_SYNC_PORT
+#    define NETWORK_SYNC_PORT 2324
+#endif
+// Shortest time from $Sync/Start to the start
+#ifndef NETWORK_SYNC_MIN_LEAD_MS
+#    define NETWORK_SYNC_MIN_LEAD_MS 200
+#endif
+// Round trips to the leader for each start, and how long one may take
+#ifndef NETWORK_SYNC_PINGS
+#    define NETWORK_SYNC_PINGS 8
+#endif
+#ifndef NETWORK_SYNC_PING_TIMEOUT_MS
+#    define NETWORK_SYNC_PING_TIMEOUT_MS 20
+#endif
+// Times the leader sends the start, as broadcasts are not acknowledged
+#ifndef NETWORK_SYNC_REPEATS
+#    define NETWORK_SYNC_REPEATS 3
+#endif
+
+namespace WebUI {
+    class Network_Sync {
+    public:
+        Network_Sync();
+
+        bool begin();
+        void end();
+
+        // Holds or releases the automatic cycle start. Releasing also drops a scheduled start.
+        void arm(bool armed);
+        // Schedules the start delay_ms from now here and on the other controllers.
+        bool start(uint32_t delay_ms);
+        // True while protocol_auto_cycle_start() must not start the cycle
+        bool holding() { return _armed; }
+        void cancel() { arm(false); }
+
+        // Offset and round trip of the last start followed, in microseconds
+        int64_t  offset() { return _offset; }
+        uint32_t round_trip() { return _best_rtt; }
+
+        ~Network_Sync();
+
+    private:
+        static void receiveTask(void* pvParameters);
+        static void fire(void* arg);
+
+        void receive(const uint8_t* packet, int len, const void* from);
+        void send_ping();
+        void finish();
+        void schedule(int64_t local_start);
+        void send(uint8_t type, int64_t a, int64_t b, uint32_t addr);
+
+        volatile int       _sock;
+        volatile bool      _armed;
+        esp_timer_handle_t _timer;
+
+        uint32_t _id;           // Of the start being followed or led
+        uint32_t _leader_addr;  // Network order, 0 when leading
+        int64_t  _leader_start;
+        int64_t  _ping_sent;  // 0 when no round trip is out
+        uint8_t  _pings_left;
+        uint32_t _best_rtt;
+        int64_t  _offset;  // Leader clock minus this clock
+    };
+
+    extern Network_Sync network_sync;
+}
@@ -48,7 +48,15 @@ namespace WebUI {
 
     NotificationsService notificationsservice;
 
+    // A queued message, with the title and the message stored after it.
+    typedef struct {
+        const char* title;
+        const char* message;
+    } notification_msg_t;
+
     NotificationsService::NotificationsService() {
+        _queue            = NULL;
+        _mutex            = NULL;
         _started          = false;
         _notificationType = 0;
         _token1           = "";
@@ -103,22 +111,68 @@ namespace WebUI {
         if (!_started) {
             return false;
         }
-        if (!((strlen(title) == 0) && (strlen(message) == 0))) {
+        bool res = false;
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+        if (_started && !((strlen(title) == 0) && (strlen(message) == 0))) {
             switch (_notificationType) {
                 case ESP_PUSHOVER_NOTIFICATION:
-                    return sendPushoverMSG(title, message);
+                    res = sendPushoverMSG(title, message);
                     break;
                 case ESP_EMAIL_NOTIFICATION:
-                    return sendEmailMSG(title, message);
+                    res = sendEmailMSG(title, message);
                     break;
                 case ESP_LINE_NOTIFICATION:
-                    return sendLineMSG(title, message);
+                    res = sendLineMSG(title, message);
                     break;
                 default:
                     break;
             }
         }
-        return false;
+        xSemaphoreGive(_mutex);
+        return res;
+    }
+
+    bool NotificationsService::queueMSG(const char* title, const char* message) {
+        if (!_started || !_queue) {
+            return false;
+        }
+        size_t              title_len = strlen(title) + 1;
+        size_t              msg_len   = strlen(message) + 1;
+        notification_msg_t* msg       = (notification_msg_t*)malloc(sizeof(notification_msg_t) + title_len + msg_len);
+        if (!msg) {
+            return false;
+        }
+        char* text = (char*)(msg + 1);
+        memcpy(text, title, title_len);
+        memcpy(text + title_len, message, msg_len);
+        msg->title   = text;
+        msg->message = text + title_len;
+        if (xQueueSend(_queue, &msg, 0) != pdTRUE) {
+            log_d("Notification queue full");
+            free(msg);
+            return false;
+        }
+        return true;
+    }
+
+    void NotificationsService::notificationTask(void* pvParameters) {
+        NotificationsService* service = (NotificationsService*)pvParameters;
+        notification_msg_t*   msg;
+        while (true) {
+            task_stats_block();
+            xQueueReceive(service->_queue, &msg, portMAX_DELAY);
+            task_stats_unblock();
+            uint32_t wait_ms = NOTIFICATION_RETRY_MS;
+            for (int attempt = 0; service->_started && !service->sendMSG(msg->title, msg->message) && attempt < NOTIFICATION_RETRIES;
+                 attempt++) {
+                log_d("Notification failed, retry in %d ms", wait_ms);
+                task_stats_block();
+                vTaskDelay(wait_ms / portTICK_PERIOD_MS);
+                task_stats_unblock();
+                wait_ms *= 2;
+            }
+            free(msg);
+        }
     }
 
     //Messages are currently limited to 1024 4-byte UTF-8 characters
@@ -312,6 +366,19 @@ namespace WebUI {
 
     bool NotificationsService::begin() {
         end();
+        if (!_mutex) {
+            _mutex = xSemaphoreCreateMutex();
+            _queue = xQueueCreate(NOTIFICATION_QUEUE_SIZE, sizeof(notification_msg_t*));
+            xTaskCreatePinnedToCore(notificationTask,    // task
+                                    "notificationTask",  // name for task
+                                    NOTIFICATION_TASK_STACK,
+                                    this,  // parameters
+                                    NOTIFICATION_TASK_PRIORITY,
+                                    NULL,
+                                    NOTIFICATION_TASK_CORE  // core
+            );
+        }
+        xSemaphoreTake(_mutex, portMAX_DELAY);
         _notificationType = notification_type->get();
         switch (_notificationType) {
             case 0:  //no notification = no error but no start
@@ -342,10 +409,11 @@ namespace WebUI {
         if (WiFi.getMode() != WIFI_STA) {
             res = false;
         }
+        _started = res;
+        xSemaphoreGive(_mutex);
         if (!res) {
             end();
         }
-        _started = res;
         return _started;
     }
 
@@ -354,6 +422,7 @@ namespace WebUI {
             return;
         }
 
+        xSemaphoreTake(_mutex, portMAX_DELAY);
         _started          = false;
         _notificationType = 0;
         _token1           = "";
@@ -361,6 +430,7 @@ namespace WebUI {
         _settings         = "";
         _serveraddress    = "";
         _port             = 0;
+        xSemaphoreGive(_mutex);
     }
 
     void NotificationsService::handle() {
@@ -20,6 +20,19 @@
   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
+// Notifications from Grbl are queued and sent by a low priority task, since a TLS connection can take
+// seconds. A message that cannot be sent is tried again NOTIFICATION_RETRIES times, waiting
+// NOTIFICATION_RETRY_MS the first time and twice as long each further time.
+#ifndef NOTIFICATION_QUEUE_SIZE
+#    define NOTIFICATION_QUEUE_SIZE 4
+#endif
+#ifndef NOTIFICATION_RETRIES
+#    define NOTIFICATION_RETRIES 3
+#endif
+#ifndef NOTIFICATION_RETRY_MS
+#    define NOTIFICATION_RETRY_MS 10000
+#endif
+
 namespace WebUI {
     class NotificationsService {
     public:
@@ -28,13 +41,19 @@ namespace WebUI {
         bool        begin();
         void        end();
         void        handle();
-        bool        sendMSG(const char* title, const char* message);
+        bool        sendMSG(const char* title, const char* message);  // Sends now and waits for the result
+        bool        queueMSG(const char* title, const char* message);  // False if the queue is full
         const char* getTypeString();
         bool        started();
 
         ~NotificationsService();
 
     private:
+        static void notificationTask(void* pvParameters);
+
+        QueueHandle_t     _queue;
+        SemaphoreHandle_t _mutex;  // Held while a message is sent and while the settings change
+
         bool     _started;
         uint8_t  _notificationType;
         String   _token1;
@@ -0,0 +1,290 @@
+/*
+  OtaWriter.cpp - firmware updates written and decompressed by a background task
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../Grbl.h"
+
+#if defined(ENABLE_WIFI) && defined(ENABLE_HTTP) && defined(ENABLE_OTA_STREAM)
+
+#    include "OtaWriter.h"
+#    include <Update.h>
+#    include <rom/miniz.h>
+#    include <freertos/queue.h>
+
+namespace WebUI {
+    enum class OtaFormat : uint8_t {
+        Unknown = 0,  // Until the first block
+        Raw,
+        Gzip,
+    };
+
+    typedef struct {
+        uint8_t index;
+        size_t  length;
+    } ota_block_t;
+
+    static uint8_t*            ota_blocks[2];
+    static uint8_t*            ota_window;  // Inflated data not yet written, and the history of the inflater
+    static tinfl_decompressor* ota_inflater;
+    static QueueHandle_t       ota_queue;  // Blocks to write
+    static QueueHandle_t       ota_done;   // Blocks given back by the task
+    static TaskHandle_t        otaWriteTaskHandle = 0;
+    static volatile bool       ota_error;
+    static bool                ota_active = false;
+    static bool                ota_owned;  // ota_block is held by the caller, not the task
+    static ota_block_t         ota_block;
+    static uint32_t            ota_size;
+    static uint32_t            ota_received;
+    static int64_t             ota_start_us;
+    static int64_t             ota_report_us;
+
+    // Only used by the task
+    static OtaFormat ota_format;
+    static size_t    ota_window_pos;
+    static bool      ota_inflated;  // The deflate stream has ended
+    static uint8_t   ota_trailer[8];
+    static uint8_t   ota_trailer_len;
+    static uint32_t  ota_written;
+
+    // Length of the gzip header at the start of data, 0 if it is not gzip, -1 if it does not fit.
+    static int ota_gzip_header(const uint8_t* data, size_t length) {
+        if (length < 10 || data[0] != 0x1f || data[1] != 0x8b || data[2] != 8) {
+            return 0;
+        }
+        uint8_t flags = data[3];
+        size_t  pos   = 10;
+        if ((flags & 0x04) && pos + 2 <= length) {  // FEXTRA
+            pos += 2 + (data[pos] | (data[pos + 1] << 8));
+        }
+        for (uint8_t flag = 0x08; flag <= 0x10; flag <<= 1) {  // FNAME and FCOMMENT, zero-terminated
+            if (flags & flag) {
+                while (pos < length && data[pos++]) {}
+            }
+        }
+        if (flags & 0x02) {  // FHCRC
+            pos += 2;
+        }
+        return pos < length ? int(pos) : -1;
+    }
+
+    static bool ota_flash(const uint8_t* data, size_t length) {
+        ota_written += length;
+        return Update.write((uint8_t*)data, length) == length;
+    }
+
+    static bool ota_inflate(const uint8_t* data, size_t length) {
+        while (!ota_inflated) {
+            size_t       in_size  = length;
+            size_t       out_size = TINFL_LZ_DICT_SIZE - ota_window_pos;
+            tinfl_status status   = tinfl_decompress(
+                ota_inflater, data, &in_size, ota_window, ota_window + ota_window_pos, &out_size, TINFL_FLAG_HAS_MORE_INPUT);
+            data += in_size;
+            length -= in_size;
+            ota_window_pos += out_size;
+            if (status < TINFL_STATUS_DONE) {
+                return false;
+            }
+            ota_inflated = status == TINFL_STATUS_DONE;
+            if (ota_window_pos == TINFL_LZ_DICT_SIZE || ota_inflated) {
+                if (!ota_flash(ota_window, ota_window_pos)) {
+                    return false;
+                }
+                ota_window_pos = 0;
+            }
+            if (status == TINFL_STATUS_NEEDS_MORE_INPUT) {
+                return true;
+            }
+        }
+        // The CRC and the length of the image follow the stream, possibly split over two blocks.
+        while (length && ota_trailer_len < sizeof(ota_trailer)) {
+            ota_trailer[ota_trailer_len++] = *data++;
+            length--;
+        }
+        return true;
+    }
+
+    static bool ota_write_block(const uint8_t* data, size_t length) {
+        if (ota_format == OtaFormat::Unknown) {
+            int header = ota_gzip_header(data, length);
+            if (header < 0) {
+                return false;
+            }
+            ota_format = header ? OtaFormat::Gzip : OtaFormat::Raw;
+            data += header;
+            length -= header;
+        }
+        return (ota_format == OtaFormat::Gzip) ? ota_inflate(data, length) : ota_flash(data, length);
+    }
+
+    static void otaWriteTask(void* pvParameters) {
+        ota_block_t block;
+        while (true) {
+            task_stats_block();
+            xQueueReceive(ota_queue, &block, portMAX_DELAY);
+            task_stats_unblock();
+            if (!ota_error && !ota_write_block(ota_blocks[block.index], block.length)) {
+                ota_error = true;
+            }
+            xQueueSend(ota_done, &block, 0);  // Never full. Only two blocks are in use
+        }
+    }
+
+    static void ota_free() {
+        for (uint8_t i = 0; i < 2; i++) {
+            free(ota_blocks[i]);
+            ota_blocks[i] = NULL;
+        }
+        free(ota_window);
+        free(ota_inflater);
+        ota_window   = NULL;
+        ota_inflater = NULL;
+    }
+
+    bool ota_begin(uint32_t size) {
+        ota_abort();  // An upload the connection dropped before it ended
+        if (!otaWriteTaskHandle) {
+            ota_queue = xQueueCreate(2, sizeof(ota_block_t));
+            ota_done  = xQueueCreate(2, sizeof(ota_block_t));
+            xTaskCreatePinnedToCore(otaWriteTask,    // task
+                                    "otaWriteTask",  // name for task
+                                    OTA_WRITE_TASK_STACK,
+                                    NULL,  // parameters
+                                    OTA_WRITE_TASK_PRIORITY,
+                                    &otaWriteTaskHandle,
+                                    OTA_WRITE_TASK_CORE  // core
+            );
+        }
+        for (uint8_t i = 0; i < 2; i++) {
+            ota_blocks[i] = (uint8_t*)malloc(OTA_BLOCK_SIZE);
+        }
+        ota_window   = (uint8_t*)malloc(TINFL_LZ_DICT_SIZE);
+        ota_inflater = (tinfl_decompressor*)malloc(sizeof(tinfl_decompressor));
+        if (!ota_blocks[0] || !ota_blocks[1] || !ota_window || !ota_inflater) {
+            ota_free();
+            return false;
+        }
+        tinfl_init(ota_inflater);
+        ota_format      = OtaFormat::Unknown;
+        ota_window_pos  = 0;
+        ota_inflated    = false;
+        ota_trailer_len = 0;
+        ota_written     = 0;
+
+        xQueueReset(ota_queue);
+        xQueueReset(ota_done);
+        for (uint8_t i = 0; i < 2; i++) {
+            ota_block_t block = { i, 0 };
+            xQueueSend(ota_done, &block, 0);
+        }
+        ota_size      = size;
+        ota_received  = 0;
+        ota_start_us  = esp_timer_get_time();
+        ota_report_us = ota_start_us;
+        ota_error     = false;
+        ota_owned     = false;
+        ota_active    = true;
+        return true;
+    }
+
+    bool ota_write(const uint8_t* data, size_t length) {
+        if (!ota_active) {
+            return false;
+        }
+        ota_received += length;
+        while (length) {
+            if (!ota_owned) {
+                xQueueReceive(ota_done, &ota_block, portMAX_DELAY);
+                ota_block.length = 0;
+                ota_owned        = true;
+            }
+            size_t n = OTA_BLOCK_SIZE - ota_block.length;
+            if (n > length) {
+                n = length;
+            }
+            memcpy(ota_blocks[ota_block.index] + ota_block.length, data, n);
+            ota_block.length += n;
+            data += n;
+            length -= n;
+            if (ota_block.length == OTA_BLOCK_SIZE) {
+                xQueueSend(ota_queue, &ota_block, portMAX_DELAY);
+                ota_owned = false;
+            }
+        }
+        int64_t now = esp_timer_get_time();
+        if (now - ota_report_us >= OTA_REPORT_MS * 1000) {
+            ota_report_us = now;
+            uint32_t ms   = (now - ota_start_us) / 1000;
+            uint32_t rate = ms ? uint32_t(uint64_t(ota_received) * 1000 / 1024 / ms) : 0;
+            if (ota_size) {
+                grbl_sendf(CLIENT_ALL, "[MSG:Update %u%%, %u KB/s]\r\n", uint32_t(uint64_t(ota_received) * 100 / ota_size), rate);
+            } else {
+                grbl_sendf(CLIENT_ALL, "[MSG:Update %u KB, %u KB/s]\r\n", ota_received / 1024, rate);
+            }
+        }
+        return !ota_error;
+    }
+
+    // Waits until the task has given back both blocks, after queueing the partly filled one if
+    // write_rest is set.
+    static void ota_finish(bool write_rest) {
+        uint8_t owned = 0;
+        if (ota_owned) {
+            if (write_rest && ota_block.length) {
+                xQueueSend(ota_queue, &ota_block, portMAX_DELAY);
+            } else {
+                owned = 1;
+            }
+            ota_owned = false;
+        }
+        ota_block_t block;
+        while (owned < 2) {
+            xQueueReceive(ota_done, &block, portMAX_DELAY);
+            owned++;
+        }
+        ota_free();
+        ota_active = false;
+    }
+
+    bool ota_end() {
+        if (!ota_active) {
+            return false;
+        }
+        ota_finish(true);
+        if (ota_error) {
+            return false;
+        }
+        if (ota_format == OtaFormat::Gzip) {
+            uint32_t length = ota_trailer[4] | (ota_trailer[5] << 8) | (ota_trailer[6] << 16) | (uint32_t(ota_trailer[7]) << 24);
+            if (!ota_inflated || ota_trailer_len < sizeof(ota_trailer) || length != ota_written) {
+                grbl_send(CLIENT_ALL, "[MSG:Update image incomplete]\r\n");
+                return false;
+            }
+        }
+        uint32_t ms = (esp_timer_get_time() - ota_start_us) / 1000;
+        grbl_sendf(CLIENT_ALL, "[MSG:Update %u KB received, %u KB written in %u ms]\r\n", ota_received / 1024, ota_written / 1024, ms);
+        return true;
+    }
+
+    void ota_abort() {
+        if (ota_active) {
+            ota_error = true;  // The task skips the blocks still queued
+            ota_finish(false);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,54 @@
+#pragma once
+
+/*
+  OtaWriter.h - firmware updates written and decompressed by a background task
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  With ENABLE_OTA_STREAM, /updatefw only copies the uploaded data into one of two blocks of
+  OTA_BLOCK_SIZE bytes and hands it to otaWriteTask, which writes it to the update partition while
+  the next block arrives. The web server waits only when both blocks are still being written, so it
+  goes on serving the WebUI and the websocket during an update.
+
+  An image compressed with gzip (gzip -9 firmware.bin) is recognized by its header and inflated by the
+  task with the ROM copy of miniz, through a 32 KB window that is written to flash each time it fills.
+  The upload is then about a third of the image, which is what counts on a weak link. The length in the
+  gzip trailer must match what was inflated, and Update.end() verifies the image as before. The blocks,
+  the window and the inflater, about 60 KB, are only allocated during an update.
+*/
+
+#include "../Config.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Each of the two blocks the upload is collected in
+#ifndef OTA_BLOCK_SIZE
+#    define OTA_BLOCK_SIZE 8192
+#endif
+// Time between the progress messages
+#ifndef OTA_REPORT_MS
+#    define OTA_REPORT_MS 2000
+#endif
+
+namespace WebUI {
+    // Called after Update.begin(). size is the expected upload length for the progress messages, or 0.
+    bool ota_begin(uint32_t size);
+    bool ota_write(const uint8_t* data, size_t length);  // False after a failed write
+    bool ota_end();                                       // Writes the rest. False if the image is incomplete
+    void ota_abort();                                     // Drops what was not written yet
+}
@@ -0,0 +1,70 @@
+/*
+  ResponsePool.cpp - fixed buffers for building web responses
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../Grbl.h"
+
+#if defined(ENABLE_WIFI) && defined(ENABLE_HTTP)
+
+#    include "ResponsePool.h"
+
+static_assert(RESPONSE_POOL_BUFFERS <= 32, "RESPONSE_POOL_BUFFERS must be at most 32");
+
+namespace WebUI {
+    static char                  pool[RESPONSE_POOL_BUFFERS][RESPONSE_POOL_BUFFER_SIZE];
+    static uint32_t              pool_used = 0;  // Bit per buffer
+    static response_pool_stats_t pool_stats;
+    static portMUX_TYPE          pool_mux = portMUX_INITIALIZER_UNLOCKED;
+
+    char* response_pool_acquire() {
+        char* buffer = NULL;
+        portENTER_CRITICAL(&pool_mux);
+        for (int i = 0; i < RESPONSE_POOL_BUFFERS; i++) {
+            if (!(pool_used & (1u << i))) {
+                pool_used |= 1u << i;
+                buffer = pool[i];
+                pool_stats.acquired++;
+                if (++pool_stats.in_use > pool_stats.most_in_use) {
+                    pool_stats.most_in_use = pool_stats.in_use;
+                }
+                break;
+            }
+        }
+        if (buffer == NULL) {
+            pool_stats.misses++;
+        }
+        portEXIT_CRITICAL(&pool_mux);
+        return buffer;
+    }
+
+    void response_pool_release(char* buffer) {
+        if (buffer == NULL) {
+            return;
+        }
+        int i = (buffer - pool[0]) / RESPONSE_POOL_BUFFER_SIZE;
+        portENTER_CRITICAL(&pool_mux);
+        if (pool_used & (1u << i)) {
+            pool_used &= ~(1u << i);
+            pool_stats.in_use--;
+        }
+        portEXIT_CRITICAL(&pool_mux);
+    }
+
+    const response_pool_stats_t* response_pool_get_stats() { return &pool_stats; }
+}
+
+#endif
@@ -0,0 +1,51 @@
+#pragma once
+
+/*
+  ResponsePool.h - fixed buffers for building web responses
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  A response to the web server is collected in a buffer of RESPONSE_POOL_BUFFER_SIZE bytes and sent
+  in chunks of that size. The buffers are allocated statically and handed out for one response at a
+  time, so serving requests does not allocate from the heap and cannot fragment it, however long the
+  machine runs. When all of them are in use, the response is sent unbuffered, in smaller chunks.
+*/
+
+// About one TCP segment
+#ifndef RESPONSE_POOL_BUFFER_SIZE
+#    define RESPONSE_POOL_BUFFER_SIZE 1200
+#endif
+
+// Responses that can be built at the same time
+#ifndef RESPONSE_POOL_BUFFERS
+#    define RESPONSE_POOL_BUFFERS 2
+#endif
+
+namespace WebUI {
+    typedef struct {
+        uint8_t  in_use;
+        uint8_t  most_in_use;
+        uint32_t acquired;
+        uint32_t misses;  // Responses that found no free buffer
+    } response_pool_stats_t;
+
+    // Returns a free buffer of RESPONSE_POOL_BUFFER_SIZE bytes, or NULL when all are in use.
+    char* response_pool_acquire();
+    void  response_pool_release(char* buffer);
+
+    const response_pool_stats_t* response_pool_get_stats();
+}
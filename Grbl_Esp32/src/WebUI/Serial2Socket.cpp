@@ -30,23 +30,25 @@
 namespace WebUI {
     Serial_2_Socket Serial2Socket;
 
-    Serial_2_Socket::Serial_2_Socket() {
+    Serial_2_Socket::Serial_2_Socket() : _RXbuffer(SERIAL2SOCKET_RX_BUFFER_SIZE) {
         _web_socket   = NULL;
         _TXbufferSize = 0;
-        _RXbufferSize = 0;
-        _RXbufferpos  = 0;
+        reset_stats();
+    }
+
+    void Serial_2_Socket::reset_stats() {
+        memset(&_stats, 0, sizeof(_stats));
+        _stats.since_ms = millis();
     }
 
     void Serial_2_Socket::begin(long speed) {
         _TXbufferSize = 0;
-        _RXbufferSize = 0;
-        _RXbufferpos  = 0;
+        _RXbuffer.begin();
     }
 
     void Serial_2_Socket::end() {
         _TXbufferSize = 0;
-        _RXbufferSize = 0;
-        _RXbufferpos  = 0;
+        _RXbuffer.begin();
     }
 
     long Serial_2_Socket::baudRate() { return 0; }
@@ -67,7 +69,7 @@ namespace WebUI {
 
     Serial_2_Socket::operator bool() const { return true; }
 
-    int Serial_2_Socket::available() { return _RXbufferSize; }
+    int Serial_2_Socket::available() { return _RXbuffer.available(); }
 
     size_t Serial_2_Socket::write(uint8_t c) {
         if (!_web_socket) {
@@ -98,65 +100,41 @@ namespace WebUI {
             flush();
         }
 
-        //need periodic check to force to flush in case of no end
-        for (int i = 0; i < size; i++) {
-            _TXbuffer[_TXbufferSize] = buffer[i];
-            _TXbufferSize++;
+        // Output that would fill the buffer by itself, like a settings listing, goes out as it is.
+        // The library only reads the payload when it is not asked to put the header in front of it.
+        if (size >= TXBUFFERSIZE) {
+            _web_socket->broadcastBIN((uint8_t*)buffer, size);
+            _stats.bytes += size;
+            _stats.frames++;
+            _stats.direct_frames++;
+            return size;
         }
+
+        //need periodic check to force to flush in case of no end
+        memcpy(&_TXbuffer[TXHEADERSIZE + _TXbufferSize], buffer, size);
+        _TXbufferSize += size;
         log_i("[SOCKET]buffer size %d", _TXbufferSize);
         handle_flush();
 #    endif
         return size;
     }
 
-    int Serial_2_Socket::peek(void) {
-        if (_RXbufferSize > 0) {
-            return _RXbuffer[_RXbufferpos];
-        } else {
-            return -1;
-        }
-    }
+    int Serial_2_Socket::peek(void) { return _RXbuffer.peek(); }
 
+    // The whole command or nothing, so a partial line never reaches the parser.
     bool Serial_2_Socket::push(const char* data) {
 #    if defined(ENABLE_SERIAL2SOCKET_IN)
-        int data_size = strlen(data);
-        if ((data_size + _RXbufferSize) <= RXBUFFERSIZE) {
-            int current = _RXbufferpos + _RXbufferSize;
-            if (current > RXBUFFERSIZE) {
-                current = current - RXBUFFERSIZE;
-            }
-
-            for (int i = 0; i < data_size; i++) {
-                if (current > (RXBUFFERSIZE - 1)) {
-                    current = 0;
-                }
-                _RXbuffer[current] = data[i];
-                current++;
-            }
-
-            _RXbufferSize += strlen(data);
-            return true;
+        if (!_RXbuffer.push(data)) {
+            return false;
         }
-        return false;
-#    else
-        return true;
+        serial_notify();
 #    endif
+        return true;
     }
 
-    int Serial_2_Socket::read(void) {
-        if (_RXbufferSize > 0) {
-            int v = _RXbuffer[_RXbufferpos];
-            _RXbufferpos++;
+    int Serial_2_Socket::read(void) { return _RXbuffer.read(); }
 
-            if (_RXbufferpos > (RXBUFFERSIZE - 1)) {
-                _RXbufferpos = 0;
-            }
-            _RXbufferSize--;
-            return v;
-        } else {
-            return -1;
-        }
-    }
+    size_t Serial_2_Socket::read(uint8_t* buffer, size_t size) { return _RXbuffer.read(buffer, size); }
 
     void Serial_2_Socket::handle_flush() {
         if (_TXbufferSize > 0 && ((_TXbufferSize >= TXBUFFERSIZE) || ((millis() - _lastflush) > FLUSHTIMEOUT))) {
@@ -165,9 +143,13 @@ namespace WebUI {
         }
     }
     void Serial_2_Socket::flush(void) {
-        if (_TXbufferSize > 0) {
+        static_assert(TXHEADERSIZE == WEBSOCKETS_MAX_HEADER_SIZE, "TXHEADERSIZE must match the websocket library");
+        if (_TXbufferSize > 0 && _web_socket) {
             log_i("[SOCKET]flush data, buffer size %d", _TXbufferSize);
-            _web_socket->broadcastBIN(_TXbuffer, _TXbufferSize);
+            // The header is written into the room in front of the data and sent with it.
+            _web_socket->broadcastBIN(_TXbuffer, _TXbufferSize, true);
+            _stats.bytes += _TXbufferSize;
+            _stats.frames++;
 
             //refresh timout
             _lastflush = millis();
@@ -182,8 +164,6 @@ namespace WebUI {
             detachWS();
         }
         _TXbufferSize = 0;
-        _RXbufferSize = 0;
-        _RXbufferpos  = 0;
     }
 }
 #endif  // ENABLE_WIFI
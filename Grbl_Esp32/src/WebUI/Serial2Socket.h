@@ -20,16 +20,43 @@
   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
+#include "InputBuffer.h"
+
 #include <Print.h>
 #include <cstring>
 
 class WebSocketsServer;
 
+// Output is sent to the websockets when this many bytes are waiting, or this long after the first one.
+#ifndef SERIAL2SOCKET_TX_BUFFER_SIZE
+#    define SERIAL2SOCKET_TX_BUFFER_SIZE 1200
+#endif
+#ifndef SERIAL2SOCKET_FLUSH_MS
+#    define SERIAL2SOCKET_FLUSH_MS 500
+#endif
+// Commands pushed by the WebUI wait here for serialCheckTask, which moves them to the WebUI client
+// buffer in blocks. A power of 2 up to 32768.
+#ifndef SERIAL2SOCKET_RX_BUFFER_SIZE
+#    define SERIAL2SOCKET_RX_BUFFER_SIZE 1024
+#endif
+static_assert((SERIAL2SOCKET_RX_BUFFER_SIZE & (SERIAL2SOCKET_RX_BUFFER_SIZE - 1)) == 0 && SERIAL2SOCKET_RX_BUFFER_SIZE <= 32768,
+              "SERIAL2SOCKET_RX_BUFFER_SIZE must be a power of 2 up to 32768");
+
 namespace WebUI {
+    // Websocket output counters reported by $Socket/Stats.
+    typedef struct {
+        uint32_t bytes;
+        uint32_t frames;
+        uint32_t direct_frames;  // Frames sent from the caller's buffer without collecting them
+        uint32_t since_ms;       // millis() when the counters were reset
+    } serial2socket_stats_t;
+
     class Serial_2_Socket : public Print {
-        static const int TXBUFFERSIZE = 1200;
-        static const int RXBUFFERSIZE = 128;
-        static const int FLUSHTIMEOUT = 500;
+        static const int TXBUFFERSIZE = SERIAL2SOCKET_TX_BUFFER_SIZE;
+        static const int FLUSHTIMEOUT = SERIAL2SOCKET_FLUSH_MS;
+        // Room kept in front of the output for the frame header, WEBSOCKETS_MAX_HEADER_SIZE in
+        // WebSockets.h, so the library can send header and data with one write and no copy.
+        static const int TXHEADERSIZE = 14;
 
     public:
         Serial_2_Socket();
@@ -48,13 +75,17 @@ namespace WebUI {
         void end();
         int  available();
         int  peek(void);
-        int  read(void);
-        bool push(const char* data);
+        int    read(void);
+        size_t read(uint8_t* buffer, size_t size);
+        bool   push(const char* data);
         void flush(void);
         void handle_flush();
         bool attachWS(WebSocketsServer* web_socket);
         bool detachWS();
 
+        const serial2socket_stats_t* stats() { return &_stats; }
+        void                         reset_stats();
+
         operator bool() const;
 
         ~Serial_2_Socket();
@@ -63,12 +94,13 @@ namespace WebUI {
         uint32_t          _lastflush;
         WebSocketsServer* _web_socket;
 
-        uint8_t  _TXbuffer[TXBUFFERSIZE];
-        uint16_t _TXbufferSize;
+        uint8_t  _TXbuffer[TXHEADERSIZE + TXBUFFERSIZE];
+        uint16_t _TXbufferSize;  // Bytes of output after the header room
+
+        serial2socket_stats_t _stats;
 
-        uint8_t  _RXbuffer[RXBUFFERSIZE];
-        uint16_t _RXbufferSize;
-        uint16_t _RXbufferpos;
+        // Filled by the web server and read by serialCheckTask
+        InputBuffer _RXbuffer;
     };
 
     extern Serial_2_Socket Serial2Socket;
@@ -40,15 +40,18 @@ namespace WebUI {
 #    endif
 
     Telnet_Server::Telnet_Server() {
-        _RXbufferSize = 0;
-        _RXbufferpos  = 0;
+        for (uint8_t i = 0; i < MAX_TLNT_CLIENTS; i++) {
+            _rx[i].head      = 0;
+            _rx[i].tail      = 0;
+            _rx[i].connected = false;
+        }
+        _rx_client  = 0;
+        _rx_in_line = false;
     }
 
     bool Telnet_Server::begin() {
         bool no_error = true;
         end();
-        _RXbufferSize = 0;
-        _RXbufferpos  = 0;
 
         if (telnet_enable->get() == 0) {
             return false;
@@ -57,7 +60,7 @@ namespace WebUI {
 
         //create instance
         _telnetserver = new WiFiServer(_port, MAX_TLNT_CLIENTS);
-        _telnetserver->setNoDelay(true);
+        _telnetserver->setNoDelay(TELNET_NO_DELAY);
         String s = "[MSG:TELNET Started " + String(_port) + "]\r\n";
         grbl_send(CLIENT_ALL, (char*)s.c_str());
         //start telnet server
@@ -67,9 +70,7 @@ namespace WebUI {
     }
 
     void Telnet_Server::end() {
-        _setupdone    = false;
-        _RXbufferSize = 0;
-        _RXbufferpos  = 0;
+        _setupdone = false;
         if (_telnetserver) {
             delete _telnetserver;
             _telnetserver = NULL;
@@ -90,6 +91,7 @@ namespace WebUI {
                         _telnetClients[i].stop();
                     }
                     _telnetClients[i] = _telnetserver->available();
+                    _telnetClients[i].setNoDelay(TELNET_NO_DELAY);
                     break;
                 }
             }
@@ -121,6 +123,36 @@ namespace WebUI {
         return wsize;
     }
 
+    // Reads what fits of the data of connection i into its buffer, dropping carriage returns.
+    void Telnet_Server::receive(uint8_t i) {
+        rx_buffer_t& rx      = _rx[i];
+        int          readlen = _telnetClients[i].available();
+        while (readlen > 0) {
+            uint16_t head = rx.head;
+            uint16_t tail = __atomic_load_n(&rx.tail, __ATOMIC_ACQUIRE);
+            // Contiguous room after head. One byte stays free so a full buffer differs from an empty one.
+            int room = (tail > head) ? (tail - head - 1) : (TELNETRXBUFFERSIZE - head - (tail == 0));
+            if (room <= 0) {
+                break;
+            }
+            if (room > readlen) {
+                room = readlen;
+            }
+            int n = _telnetClients[i].read(&rx.data[head], room);
+            if (n <= 0) {
+                break;
+            }
+            readlen -= n;
+            int kept = 0;
+            for (int k = 0; k < n; k++) {
+                if (rx.data[head + k] != '\r') {
+                    rx.data[head + kept++] = rx.data[head + k];
+                }
+            }
+            __atomic_store_n(&rx.head, (head + kept) & (TELNETRXBUFFERSIZE - 1), __ATOMIC_RELEASE);
+        }
+    }
+
     void Telnet_Server::handle() {
         COMMANDS::wait(0);
         //check if can read
@@ -129,9 +161,10 @@ namespace WebUI {
         }
         clearClients();
         //check clients for data
-        //uint8_t c;
+        bool received = false;
         for (uint8_t i = 0; i < MAX_TLNT_CLIENTS; i++) {
             if (_telnetClients[i] && _telnetClients[i].connected()) {
+                _rx[i].connected = true;
 #    ifdef ENABLE_TELNET_WELCOME_MSG
                 if (_telnetClientsIP[i] != _telnetClients[i].remoteIP()) {
                     report_init_message(CLIENT_TELNET);
@@ -139,23 +172,11 @@ namespace WebUI {
                 }
 #    endif
                 if (_telnetClients[i].available()) {
-                    uint8_t buf[1024];
-                    COMMANDS::wait(0);
-                    int readlen  = _telnetClients[i].available();
-                    int writelen = TELNETRXBUFFERSIZE - available();
-                    if (readlen > 1024) {
-                        readlen = 1024;
-                    }
-                    if (readlen > writelen) {
-                        readlen = writelen;
-                    }
-                    if (readlen > 0) {
-                        _telnetClients[i].read(buf, readlen);
-                        push(buf, readlen);
-                    }
-                    return;
+                    receive(i);
+                    received = true;
                 }
             } else {
+                _rx[i].connected = false;
                 if (_telnetClients[i]) {
 #    ifdef ENABLE_TELNET_WELCOME_MSG
                     _telnetClientsIP[i] = IPAddress(0, 0, 0, 0);
@@ -165,76 +186,70 @@ namespace WebUI {
             }
             COMMANDS::wait(0);
         }
+        if (received) {
+            serial_notify();
+        }
+    }
+
+    int Telnet_Server::rx_count(const rx_buffer_t& rx) {
+        return (__atomic_load_n(&rx.head, __ATOMIC_ACQUIRE) - rx.tail) & (TELNETRXBUFFERSIZE - 1);
+    }
+
+    // Returns the bytes read() can take now and sets client to their connection. A started line is
+    // finished before another connection is served, unless its connection has closed.
+    int Telnet_Server::rx_next(uint8_t* client) {
+        *client   = _rx_client;
+        int count = rx_count(_rx[_rx_client]);
+        if (count || (_rx_in_line && _rx[_rx_client].connected)) {
+            return count;
+        }
+        for (uint8_t n = 1; n < MAX_TLNT_CLIENTS; n++) {
+            uint8_t i = (_rx_client + n) % MAX_TLNT_CLIENTS;
+            count     = rx_count(_rx[i]);
+            if (count) {
+                *client = i;
+                return count;
+            }
+        }
+        return 0;
     }
 
     int Telnet_Server::peek(void) {
-        if (_RXbufferSize > 0) {
-            return _RXbuffer[_RXbufferpos];
-        } else {
+        uint8_t client;
+        if (!rx_next(&client)) {
             return -1;
         }
+        return _rx[client].data[_rx[client].tail];
     }
 
-    int Telnet_Server::available() { return _RXbufferSize; }
-
-    int Telnet_Server::get_rx_buffer_available() { return TELNETRXBUFFERSIZE - _RXbufferSize; }
-
-    bool Telnet_Server::push(uint8_t data) {
-        log_i("[TELNET]push %c", data);
-        if ((1 + _RXbufferSize) <= TELNETRXBUFFERSIZE) {
-            int current = _RXbufferpos + _RXbufferSize;
-            if (current > TELNETRXBUFFERSIZE) {
-                current = current - TELNETRXBUFFERSIZE;
-            }
-            if (current > (TELNETRXBUFFERSIZE - 1)) {
-                current = 0;
-            }
-            _RXbuffer[current] = data;
-            _RXbufferSize++;
-            log_i("[TELNET]buffer size %d", _RXbufferSize);
-            return true;
-        }
-        return false;
+    int Telnet_Server::available() {
+        uint8_t client;
+        return rx_next(&client);
     }
 
-    bool Telnet_Server::push(const uint8_t* data, int data_size) {
-        if ((data_size + _RXbufferSize) <= TELNETRXBUFFERSIZE) {
-            int data_processed = 0;
-            int current        = _RXbufferpos + _RXbufferSize;
-            if (current > TELNETRXBUFFERSIZE) {
-                current = current - TELNETRXBUFFERSIZE;
-            }
-            for (int i = 0; i < data_size; i++) {
-                if (current > (TELNETRXBUFFERSIZE - 1)) {
-                    current = 0;
-                }
-                if (char(data[i]) != '\r') {
-                    _RXbuffer[current] = data[i];
-                    current++;
-                    data_processed++;
-                }
-                COMMANDS::wait(0);
-                //vTaskDelay(1 / portTICK_RATE_MS);  // Yield to other tasks
+    bool Telnet_Server::has_clients() {
+        for (uint8_t i = 0; i < MAX_TLNT_CLIENTS; i++) {
+            if (_rx[i].connected) {
+                return true;
             }
-            _RXbufferSize += data_processed;
-            return true;
         }
         return false;
     }
 
+    int Telnet_Server::get_rx_buffer_available() { return TELNETRXBUFFERSIZE - 1 - rx_count(_rx[_rx_client]); }
+
+    // Only called by serialCheckTask.
     int Telnet_Server::read(void) {
-        if (_RXbufferSize > 0) {
-            int v = _RXbuffer[_RXbufferpos];
-            //log_d("[TELNET]read %c",char(v));
-            _RXbufferpos++;
-            if (_RXbufferpos > (TELNETRXBUFFERSIZE - 1)) {
-                _RXbufferpos = 0;
-            }
-            _RXbufferSize--;
-            return v;
-        } else {
+        uint8_t client;
+        if (!rx_next(&client)) {
             return -1;
         }
+        rx_buffer_t& rx = _rx[client];
+        uint8_t      v  = rx.data[rx.tail];
+        __atomic_store_n(&rx.tail, (rx.tail + 1) & (TELNETRXBUFFERSIZE - 1), __ATOMIC_RELEASE);
+        _rx_client  = client;
+        _rx_in_line = v != '\n';
+        return v;
     }
 
     Telnet_Server::~Telnet_Server() { end(); }
@@ -25,14 +25,38 @@
 class WiFiServer;
 class WiFiClient;
 
+// How many clients can telnet to this ESP32. They share the telnet client of Grbl, so each connection
+// has its own receive buffer and read() switches connections only between lines.
+#ifndef TELNET_MAX_CLIENTS
+#    define TELNET_MAX_CLIENTS 1
+#endif
+// Receive buffer of each connection. Enough for the data in flight over one round trip of the link.
+#ifndef TELNET_RX_BUFFER_SIZE
+#    define TELNET_RX_BUFFER_SIZE 2048
+#endif
+// Sends responses right away instead of letting TCP combine them.
+#ifndef TELNET_NO_DELAY
+#    define TELNET_NO_DELAY true
+#endif
+
+static_assert((TELNET_RX_BUFFER_SIZE & (TELNET_RX_BUFFER_SIZE - 1)) == 0 && TELNET_RX_BUFFER_SIZE <= 32768,
+              "TELNET_RX_BUFFER_SIZE must be a power of 2 up to 32768");
+
 namespace WebUI {
     class Telnet_Server {
-        //how many clients should be able to telnet to this ESP32
-        static const int MAX_TLNT_CLIENTS = 1;
-
-        static const int TELNETRXBUFFERSIZE = 1200;
+        static const int MAX_TLNT_CLIENTS   = TELNET_MAX_CLIENTS;
+        static const int TELNETRXBUFFERSIZE = TELNET_RX_BUFFER_SIZE;
         static const int FLUSHTIMEOUT       = 500;
 
+        // Filled by handle() in the services task and read by serialCheckTask. Only handle() moves head
+        // and only read() moves tail.
+        typedef struct {
+            uint8_t           data[TELNETRXBUFFERSIZE];
+            volatile uint16_t head;
+            volatile uint16_t tail;
+            volatile bool     connected;
+        } rx_buffer_t;
+
     public:
         Telnet_Server();
 
@@ -44,8 +68,7 @@ namespace WebUI {
         int    peek(void);
         int    available();
         int    get_rx_buffer_available();
-        bool   push(uint8_t data);
-        bool   push(const uint8_t* data, int datasize);
+        bool   has_clients();
 
         static uint16_t port() { return _port; }
 
@@ -61,11 +84,15 @@ namespace WebUI {
         static uint16_t _port;
 
         void clearClients();
+        void receive(uint8_t i);
+
+        static int rx_count(const rx_buffer_t& rx);
+        int        rx_next(uint8_t* client);
 
-        uint32_t _lastflush;
-        uint8_t  _RXbuffer[TELNETRXBUFFERSIZE];
-        uint16_t _RXbufferSize;
-        uint16_t _RXbufferpos;
+        uint32_t    _lastflush;
+        rx_buffer_t _rx[MAX_TLNT_CLIENTS];
+        uint8_t     _rx_client;   // Connection read() takes data from
+        bool        _rx_in_line;  // read() has returned part of a line of _rx_client
     };
 
     extern Telnet_Server telnet_server;
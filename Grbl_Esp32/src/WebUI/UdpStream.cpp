@@ -0,0 +1,323 @@
+/*
+  UdpStream.cpp - streaming client over UDP
+  Part of Grbl_ESP32
+
+  TCP holds every byte behind a lost segment and delays small segments and their acknowledgements,
+  which adds up on each round trip of a sender over WiFi. Here lost packets do not hold the ones after
+  them, the window tells the sender how much it may have in flight, and realtime commands and status
+  reports do not wait behind the stream at all.
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../Grbl.h"
+
+#if defined(ENABLE_WIFI) && defined(ENABLE_UDP_STREAM)
+
+#    include <lwip/sockets.h>
+#    include "UdpStream.h"
+#    include "WifiServices.h"
+
+namespace WebUI {
+    Udp_Stream udp_stream;
+
+    static TaskHandle_t udpTaskHandle = NULL;
+
+    Udp_Stream::Udp_Stream() {
+        _sock       = -1;
+        _peer_addr  = 0;
+        _peer_port  = 0;
+        _rx_head    = 0;
+        _rx_tail    = 0;
+        _rt_head    = 0;
+        _rt_tail    = 0;
+        _next_seq   = 0;
+        _acked_free = 0;
+        _out_seq    = 0;
+        memset(_slots, 0, sizeof(_slots));
+        memset(&_stats, 0, sizeof(_stats));
+    }
+
+    bool Udp_Stream::begin() {
+        end();
+        if (udp_enable->get() == 0) {
+            return false;
+        }
+        uint16_t port = udp_port->get();
+        int      sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (sock < 0) {
+            grbl_send(CLIENT_ALL, "[MSG:Cannot start UDP]\r\n");
+            return false;
+        }
+        sockaddr_in addr     = {};
+        addr.sin_family      = AF_INET;
+        addr.sin_port        = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(sock, (sockaddr*)&addr, sizeof(addr)) < 0) {
+            close(sock);
+            grbl_send(CLIENT_ALL, "[MSG:Cannot start UDP]\r\n");
+            return false;
+        }
+        // The receive task also wakes without traffic, to tell the sender when the window opens
+        timeval timeout = { 0, UDP_STREAM_POLL_MS * 1000 };
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        _sock = sock;
+        if (!udpTaskHandle) {
+            xTaskCreatePinnedToCore(receiveTask,  // task
+                                    "udpTask",    // name for task
+                                    UDP_STREAM_TASK_STACK,
+                                    this,  // parameters
+                                    UDP_STREAM_TASK_PRIORITY,
+                                    &udpTaskHandle,
+                                    UDP_STREAM_TASK_CORE  // core
+            );
+        }
+        grbl_sendf(CLIENT_ALL, "[MSG:UDP Started %d]\r\n", port);
+        return true;
+    }
+
+    void Udp_Stream::end() {
+        int sock   = _sock;
+        _sock      = -1;
+        _peer_addr = 0;
+        if (sock >= 0) {
+            close(sock);
+        }
+    }
+
+    void Udp_Stream::reset_stats() { memset(&_stats, 0, sizeof(_stats)); }
+
+    int Udp_Stream::rx_free() {
+        return (__atomic_load_n(&_rx_tail, __ATOMIC_ACQUIRE) - _rx_head - 1) & (UDP_STREAM_RX_BUFFER_SIZE - 1);
+    }
+
+    // Appends data to the receive buffer if all of it fits. Called by the receive task only.
+    bool Udp_Stream::deliver(const uint8_t* data, uint16_t len) {
+        if (len > rx_free()) {
+            return false;
+        }
+        uint16_t head  = _rx_head;
+        uint16_t first = MIN(len, UDP_STREAM_RX_BUFFER_SIZE - head);
+        memcpy(&_rx[head], data, first);
+        memcpy(_rx, data + first, len - first);
+        __atomic_store_n(&_rx_head, (head + len) & (UDP_STREAM_RX_BUFFER_SIZE - 1), __ATOMIC_RELEASE);
+        return true;
+    }
+
+    // Delivers the held packets that the next expected one unblocks, as far as they fit.
+    void Udp_Stream::deliver_held() {
+        for (;;) {
+            slot_t* slot = &_slots[_next_seq % UDP_STREAM_REORDER_SLOTS];
+            if (!slot->held || slot->seq != _next_seq || !deliver(slot->data, slot->len)) {
+                return;
+            }
+            slot->held = false;
+            _next_seq++;
+            _stats.packets++;
+        }
+    }
+
+    void Udp_Stream::send_ack() {
+        uint32_t sack = 0;
+        for (uint16_t i = 0; i + 1 < UDP_STREAM_REORDER_SLOTS; i++) {
+            uint16_t      seq  = _next_seq + 1 + i;
+            const slot_t* slot = &_slots[seq % UDP_STREAM_REORDER_SLOTS];
+            if (slot->held && slot->seq == seq) {
+                sack |= 1UL << i;
+            }
+        }
+        int     window = rx_free();
+        uint8_t ack[10];
+        ack[0]      = 'A';
+        ack[1]      = _next_seq;
+        ack[2]      = _next_seq >> 8;
+        ack[3]      = window;
+        ack[4]      = window >> 8;
+        ack[5]      = plan_get_block_buffer_available();
+        ack[6]      = sack;
+        ack[7]      = sack >> 8;
+        ack[8]      = sack >> 16;
+        ack[9]      = sack >> 24;
+        _acked_free = window;
+        send_packet(ack[0], false, ack + 1, sizeof(ack) - 1);
+        _stats.acks++;
+    }
+
+    // Sends one packet to the sender. Safe from any task, the socket layer serializes the sends.
+    void Udp_Stream::send_packet(uint8_t type, bool numbered, const uint8_t* data, size_t size) {
+        int sock = _sock;
+        if (sock < 0 || !_peer_addr) {
+            return;
+        }
+        uint8_t header[3]  = { type };
+        size_t  header_len = 1;
+        if (numbered) {
+            uint16_t seq = __atomic_fetch_add(&_out_seq, 1, __ATOMIC_RELAXED);
+            header[1]    = seq;
+            header[2]    = seq >> 8;
+            header_len   = 3;
+        }
+        sockaddr_in to     = {};
+        to.sin_family      = AF_INET;
+        to.sin_port        = _peer_port;
+        to.sin_addr.s_addr = _peer_addr;
+
+        iovec iov[2] = { { header, header_len }, { (void*)data, size } };
+
+        msghdr msg      = {};
+        msg.msg_name    = &to;
+        msg.msg_namelen = sizeof(to);
+        msg.msg_iov     = iov;
+        msg.msg_iovlen  = 2;
+        sendmsg(sock, &msg, 0);
+    }
+
+    void Udp_Stream::receive(const uint8_t* packet, int len, const void* from) {
+        const sockaddr_in* addr = (const sockaddr_in*)from;
+        bool               peer = _peer_addr == addr->sin_addr.s_addr && _peer_port == addr->sin_port;
+        switch (packet[0]) {
+            case 'H':
+                _peer_addr = addr->sin_addr.s_addr;
+                _peer_port = addr->sin_port;
+                _next_seq  = 0;
+                _out_seq   = 0;
+                for (uint8_t i = 0; i < UDP_STREAM_REORDER_SLOTS; i++) {
+                    _slots[i].held = false;
+                }
+                send_ack();
+                break;
+            case 'R':
+                if (!peer) {
+                    break;
+                }
+                for (int i = 1; i < len; i++) {
+                    uint8_t next = (_rt_head + 1) % sizeof(_rt);
+                    if (!is_realtime_command(packet[i]) || next == __atomic_load_n(&_rt_tail, __ATOMIC_ACQUIRE)) {
+                        continue;
+                    }
+                    _rt[_rt_head] = packet[i];
+                    __atomic_store_n(&_rt_head, next, __ATOMIC_RELEASE);
+                    _stats.realtime++;
+                }
+                serial_notify();
+                break;
+            case 'D': {
+                if (!peer || len < 3 || len - 3 > UDP_STREAM_MAX_PAYLOAD) {
+                    break;
+                }
+                uint16_t seq   = packet[1] | (packet[2] << 8);
+                uint16_t ahead = seq - _next_seq;
+                if (ahead == 0) {
+                    if (deliver(packet + 3, len - 3)) {
+                        _next_seq++;
+                        _stats.packets++;
+                        deliver_held();
+                    } else {
+                        _stats.dropped++;
+                    }
+                } else if (ahead < UDP_STREAM_REORDER_SLOTS) {
+                    slot_t* slot = &_slots[seq % UDP_STREAM_REORDER_SLOTS];
+                    if (slot->held && slot->seq == seq) {
+                        _stats.duplicates++;
+                    } else {
+                        slot->held = true;
+                        slot->seq  = seq;
+                        slot->len  = len - 3;
+                        memcpy(slot->data, packet + 3, len - 3);
+                        _stats.out_of_order++;
+                    }
+                } else if (ahead >= 0x8000) {
+                    _stats.duplicates++;  // Delivered already, its acknowledgement was lost
+                } else {
+                    _stats.dropped++;
+                }
+                send_ack();
+                serial_notify();
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    void Udp_Stream::receiveTask(void* pvParameters) {
+        Udp_Stream*    stream = (Udp_Stream*)pvParameters;
+        static uint8_t packet[UDP_STREAM_MAX_PAYLOAD + 3];
+        while (true) {
+            int sock = stream->_sock;
+            if (sock < 0) {
+                vTaskDelay(100 / portTICK_RATE_MS);
+                continue;
+            }
+            sockaddr_in from;
+            socklen_t   fromlen = sizeof(from);
+            task_stats_block();
+            int len = recvfrom(sock, packet, sizeof(packet), 0, (sockaddr*)&from, &fromlen);
+            task_stats_unblock();
+            if (len > 0) {
+                stream->receive(packet, len, &from);
+            }
+            if (!stream->_peer_addr) {
+                continue;
+            }
+            // serialCheckTask may have made room for held packets, and for more in flight
+            stream->deliver_held();
+            int window = stream->rx_free();
+            if (window >= stream->_acked_free + UDP_STREAM_ACK_STEP ||
+                (window > stream->_acked_free && window == UDP_STREAM_RX_BUFFER_SIZE - 1)) {
+                stream->send_ack();
+            }
+        }
+    }
+
+    size_t Udp_Stream::write(const uint8_t* buffer, size_t size) {
+        if (_sock < 0 || !_peer_addr) {
+            return 0;
+        }
+        // Status reports may be lost, the next one replaces them
+        bool status = size && buffer[0] == '<';
+        for (size_t sent = 0; sent < size;) {
+            size_t len = MIN(size - sent, size_t(UDP_STREAM_MAX_PAYLOAD));
+            send_packet(status ? 'S' : 'O', !status, buffer + sent, len);
+            sent += len;
+            _stats.sent++;
+        }
+        return size;
+    }
+
+    int Udp_Stream::read(void) {
+        uint8_t rt_tail = _rt_tail;
+        if (rt_tail != __atomic_load_n(&_rt_head, __ATOMIC_ACQUIRE)) {
+            uint8_t data = _rt[rt_tail];
+            __atomic_store_n(&_rt_tail, (rt_tail + 1) % sizeof(_rt), __ATOMIC_RELEASE);
+            return data;
+        }
+        uint16_t tail = _rx_tail;
+        if (tail == __atomic_load_n(&_rx_head, __ATOMIC_ACQUIRE)) {
+            return -1;
+        }
+        uint8_t data = _rx[tail];
+        __atomic_store_n(&_rx_tail, (tail + 1) & (UDP_STREAM_RX_BUFFER_SIZE - 1), __ATOMIC_RELEASE);
+        return data;
+    }
+
+    int Udp_Stream::available() {
+        int rt = (__atomic_load_n(&_rt_head, __ATOMIC_ACQUIRE) - _rt_tail + sizeof(_rt)) % sizeof(_rt);
+        return rt + ((__atomic_load_n(&_rx_head, __ATOMIC_ACQUIRE) - _rx_tail) & (UDP_STREAM_RX_BUFFER_SIZE - 1));
+    }
+
+    Udp_Stream::~Udp_Stream() { end(); }
+}
+
+#endif
@@ -0,0 +1,150 @@
+#pragma once
+
+/*
+  UdpStream.h - streaming client over UDP
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  One sender at a time streams to $UDP/Port. Each datagram starts with a type byte, multi-byte fields
+  are little-endian.
+
+  From the sender:
+
+      'H'                  hello, starts a session from this address with sequence number 0
+      'D' seq u16 data     stream data, g-code lines or binary frames, delivered in sequence order
+      'R' commands         realtime commands, executed on arrival, not sequenced nor acknowledged
+
+  To the sender:
+
+      'A' next u16 free u16 planner u8 sack u32
+                           acknowledgement. next is the sequence number expected next, all before it
+                           were delivered. free is the receive window in bytes, planner the free planner
+                           blocks. Bit i of sack is set when packet next+1+i is held, so only the
+                           missing ones need sending again.
+      'O' seq u16 text     responses and messages, numbered so the sender sees losses
+      'S' text             status reports, unsequenced, a newer one replaces a lost one
+
+  A data packet is acknowledged on arrival, and again whenever the window opens by UDP_STREAM_ACK_STEP
+  bytes. Packets up to UDP_STREAM_REORDER_SLOTS ahead of the next expected one are held until the gap
+  is filled. A packet that does not fit the window, or lies further ahead, is dropped and must be sent
+  again. Data goes through the same path as the other clients, so realtime characters in it also work.
+*/
+
+#include "../Config.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Received data waiting for serialCheckTask, the window advertised to the sender
+#ifndef UDP_STREAM_RX_BUFFER_SIZE
+#    define UDP_STREAM_RX_BUFFER_SIZE 4096
+#endif
+// Out of order packets held until the gap before them is filled
+#ifndef UDP_STREAM_REORDER_SLOTS
+#    define UDP_STREAM_REORDER_SLOTS 8
+#endif
+// Largest data payload, keeps a packet inside one Ethernet frame
+#ifndef UDP_STREAM_MAX_PAYLOAD
+#    define UDP_STREAM_MAX_PAYLOAD 1024
+#endif
+// Window growth that is worth an acknowledgement of its own
+#ifndef UDP_STREAM_ACK_STEP
+#    define UDP_STREAM_ACK_STEP 256
+#endif
+// How often the receive task wakes without traffic to check the window
+#ifndef UDP_STREAM_POLL_MS
+#    define UDP_STREAM_POLL_MS 5
+#endif
+
+static_assert((UDP_STREAM_RX_BUFFER_SIZE & (UDP_STREAM_RX_BUFFER_SIZE - 1)) == 0 && UDP_STREAM_RX_BUFFER_SIZE <= 32768,
+              "UDP_STREAM_RX_BUFFER_SIZE must be a power of 2 up to 32768");
+static_assert(UDP_STREAM_REORDER_SLOTS <= 32, "The selective acknowledgement covers 32 packets");
+
+namespace WebUI {
+    static const int DEFAULT_UDP_STATE = 0;
+    static const int DEFAULT_UDP_PORT  = 2323;
+    static const int MIN_UDP_PORT      = 1;
+    static const int MAX_UDP_PORT      = 65001;
+
+    // Counters reported by $UDP/Stats.
+    typedef struct {
+        uint32_t packets;       // Data packets delivered
+        uint32_t out_of_order;  // Held until the gap before them was filled
+        uint32_t duplicates;    // Already delivered or held
+        uint32_t dropped;       // Outside the window or the reorder slots
+        uint32_t realtime;      // Realtime commands
+        uint32_t acks;
+        uint32_t sent;  // Response and status packets
+    } udp_stream_stats_t;
+
+    class Udp_Stream {
+    public:
+        Udp_Stream();
+
+        bool   begin();
+        void   end();
+        size_t write(const uint8_t* buffer, size_t size);
+        int    read(void);
+        int    available();
+
+        const udp_stream_stats_t* stats() { return &_stats; }
+        void                      reset_stats();
+
+        ~Udp_Stream();
+
+    private:
+        typedef struct {
+            bool     held;
+            uint16_t seq;
+            uint16_t len;
+            uint8_t  data[UDP_STREAM_MAX_PAYLOAD];
+        } slot_t;
+
+        static void receiveTask(void* pvParameters);
+
+        void receive(const uint8_t* packet, int len, const void* from);
+        bool deliver(const uint8_t* data, uint16_t len);
+        void deliver_held();
+        void send_ack();
+        void send_packet(uint8_t type, bool numbered, const uint8_t* data, size_t size);
+        int  rx_free();
+
+        volatile int _sock;
+        uint32_t     _peer_addr;  // Network order, 0 without a session
+        uint16_t     _peer_port;  // Network order
+
+        // Filled by the receive task and read by serialCheckTask. Only the receive task moves head and
+        // only read() moves tail.
+        uint8_t           _rx[UDP_STREAM_RX_BUFFER_SIZE];
+        volatile uint16_t _rx_head;
+        volatile uint16_t _rx_tail;
+
+        // Realtime commands, read ahead of the data so they do not wait behind it
+        uint8_t          _rt[64];
+        volatile uint8_t _rt_head;
+        volatile uint8_t _rt_tail;
+
+        uint16_t _next_seq;  // Next data packet to deliver
+        slot_t   _slots[UDP_STREAM_REORDER_SLOTS];
+        int      _acked_free;  // Window in the last acknowledgement
+        uint16_t _out_seq;     // Next response packet
+
+        udp_stream_stats_t _stats;
+    };
+
+    extern Udp_Stream udp_stream;
+}
@@ -25,12 +25,13 @@
 #    include "WifiServices.h"
 
 #    include "ESPResponse.h"
+#    include "JSONEncoder.h"
 #    include "Serial2Socket.h"
 #    include "WebServer.h"
 #    include <WebSocketsServer.h>
 #    include <WiFi.h>
 #    include <FS.h>
-#    include <SPIFFS.h>
+#    include "../LocalFS.h"
 #    ifdef ENABLE_SD_CARD
 #        include <SD.h>
 #        include "../SDCard.h"
@@ -56,6 +57,9 @@ namespace WebUI {
 
 #    endif
 #    include <esp_ota_ops.h>
+#    ifdef ENABLE_OTA_STREAM
+#        include "OtaWriter.h"
+#    endif
 
 //embedded response file if no files on SPIFFS
 #    include "NoFile.h"
@@ -84,6 +88,176 @@ namespace WebUI {
     const int ESP_ERROR_UPLOAD_CANCELLED = 6;
     const int ESP_ERROR_FILE_CLOSE       = 7;
 
+    // Directories of a SPIFFS listing that can be told apart. SPIFFS has no real directories, so
+    // they are collected from the file names.
+    const int MAX_LIST_SUBDIRS = 64;
+
+    // Optional paging of the file lists: start is the first entry sent and count the number
+    // of entries, all of them by default. A truncated list has a "next" member with the start
+    // of the following page.
+    static void get_list_page(WebServer* webserver, uint32_t* start, uint32_t* count) {
+        *start = webserver->hasArg("start") ? webserver->arg("start").toInt() : 0;
+        *count = webserver->hasArg("count") ? webserver->arg("count").toInt() : UINT32_MAX;
+        if (*count == 0) {
+            *count = UINT32_MAX;
+        }
+    }
+
+    // FNV-1a hash of len bytes, continuing from hash.
+    static uint32_t fnv_hash(const void* data, size_t len, uint32_t hash = 2166136261u) {
+        const uint8_t* p = (const uint8_t*)data;
+        while (len--) {
+            hash = (hash ^ *p++) * 16777619u;
+        }
+        return hash;
+    }
+
+    // Static files are sent with an ETag made of a hash of their content, so a browser that has them
+    // gets a 304 instead of the file. The hashes of the last few files are kept until the files on
+    // SPIFFS are changed. Files other than pages and data may be cached by the browser for
+    // WEB_CACHE_MAX_AGE seconds without asking.
+    const int WEB_ETAG_CACHE_SIZE = 8;
+    const int WEB_CACHE_MAX_AGE   = 86400;
+    const int WEB_FILE_CHUNK_SIZE = 2048;
+
+    typedef struct {
+        uint32_t path_hash;
+        uint32_t size;
+        uint32_t content_hash;
+    } etag_entry_t;
+
+    static etag_entry_t etag_cache[WEB_ETAG_CACHE_SIZE];
+    static uint8_t      etag_count = 0;
+    static uint8_t      etag_next  = 0;
+
+    static void etag_cache_clear() { etag_count = 0; }
+
+    static uint32_t file_content_hash(File& file) {
+        uint32_t path_hash = fnv_hash(file.name(), strlen(file.name()));
+        uint32_t size      = file.size();
+        for (uint8_t i = 0; i < etag_count; i++) {
+            if (etag_cache[i].path_hash == path_hash && etag_cache[i].size == size) {
+                return etag_cache[i].content_hash;
+            }
+        }
+        uint8_t  buf[WEB_FILE_CHUNK_SIZE];
+        uint32_t hash = fnv_hash(&size, sizeof(size));
+        int      n;
+        while ((n = file.read(buf, sizeof(buf))) > 0) {
+            hash = fnv_hash(buf, n, hash);
+            COMMANDS::wait(0);
+        }
+        file.seek(0);
+        etag_cache[etag_next] = { path_hash, size, hash };
+        etag_next             = (etag_next + 1) % WEB_ETAG_CACHE_SIZE;
+        if (etag_count < WEB_ETAG_CACHE_SIZE) {
+            etag_count++;
+        }
+        return hash;
+    }
+
+    // Answers the conditional and range headers of a request for size bytes of content with the given
+    // hash, and sends the response headers. Returns false when no body is to be sent, otherwise the
+    // part to send is in start and length.
+    static bool begin_cached_response(WebServer*    webserver,
+                                      uint32_t      hash,
+                                      size_t        size,
+                                      const String& contentType,
+                                      bool          gzip,
+                                      bool          revalidate,
+                                      size_t*       start,
+                                      size_t*       length) {
+        char etag[24];
+        snprintf(etag, sizeof(etag), "\"%08x-%x\"", hash, size);
+        char cache_control[24];
+        if (revalidate) {
+            strcpy(cache_control, "no-cache");
+        } else {
+            snprintf(cache_control, sizeof(cache_control), "max-age=%d", WEB_CACHE_MAX_AGE);
+        }
+        webserver->sendHeader("ETag", etag);
+        webserver->sendHeader("Cache-Control", cache_control);
+        if (webserver->hasHeader("If-None-Match")) {
+            String match = webserver->header("If-None-Match");
+            if (match.indexOf(etag) >= 0 || match == "*") {
+                webserver->send(304);
+                return false;
+            }
+        }
+        webserver->sendHeader("Accept-Ranges", "bytes");
+        if (gzip) {
+            webserver->sendHeader("Content-Encoding", "gzip");
+        }
+
+        // A single range, unless If-Range names an older version.
+        *start       = 0;
+        *length      = size;
+        int    code  = 200;
+        String range = webserver->header("Range");
+        if (range.startsWith("bytes=") && range.indexOf(',') < 0 && size &&
+            (!webserver->hasHeader("If-Range") || webserver->header("If-Range") == etag)) {
+            const char* spec  = range.c_str() + 6;
+            char*       rest  = NULL;
+            size_t      first = 0;
+            size_t      last  = size - 1;
+            bool        valid = true;
+            if (*spec == '-') {
+                size_t suffix = strtoul(spec + 1, &rest, 10);
+                valid         = suffix > 0;
+                first         = suffix < size ? size - suffix : 0;
+            } else {
+                first = strtoul(spec, &rest, 10);
+                valid = *rest == '-' && first < size;
+                if (valid && isdigit(rest[1])) {
+                    last = strtoul(rest + 1, NULL, 10);
+                    if (last >= size) {
+                        last = size - 1;
+                    }
+                    valid = first <= last;
+                }
+            }
+            char content_range[40];
+            if (!valid) {
+                snprintf(content_range, sizeof(content_range), "bytes */%u", size);
+                webserver->sendHeader("Content-Range", content_range);
+                webserver->send(416);
+                return false;
+            }
+            snprintf(content_range, sizeof(content_range), "bytes %u-%u/%u", first, last, size);
+            webserver->sendHeader("Content-Range", content_range);
+            *start  = first;
+            *length = last - first + 1;
+            code    = 206;
+        }
+        webserver->setContentLength(*length);
+        webserver->send(code, contentType, "");
+        return webserver->method() != HTTP_HEAD;
+    }
+
+    // Sends a SPIFFS file like WebServer::streamFile(), with an ETag and range support.
+    static void stream_cached_file(WebServer* webserver, File& file, const String& contentType, bool revalidate) {
+        String name = file.name();
+        bool   gzip = name.endsWith(".gz") && contentType != "application/x-gzip" && contentType != "application/octet-stream";
+        size_t start, length;
+        if (!begin_cached_response(webserver, file_content_hash(file), file.size(), contentType, gzip, revalidate, &start, &length)) {
+            return;
+        }
+        file.seek(start);
+        uint8_t buf[WEB_FILE_CHUNK_SIZE];
+        while (length) {
+            int n = file.read(buf, length < sizeof(buf) ? length : sizeof(buf));
+            if (n <= 0 || webserver->client().write(buf, n) != size_t(n)) {
+                break;
+            }
+            length -= n;
+        }
+    }
+
+    // Pages and data change with the configuration, so the browser asks each time.
+    static bool must_revalidate(const String& path) {
+        return path.indexOf(".htm") >= 0 || path.indexOf(".json") >= 0 || path.indexOf(".txt") >= 0;
+    }
+
     Web_Server        web_server;
     bool              Web_Server::_setupdone     = false;
     uint16_t          Web_Server::_port          = 0;
@@ -92,15 +266,20 @@ namespace WebUI {
     WebServer*        Web_Server::_webserver     = NULL;
     WebSocketsServer* Web_Server::_socket_server = NULL;
 #    ifdef ENABLE_AUTHENTICATION
-    AuthenticationIP* Web_Server::_head  = NULL;
-    uint8_t           Web_Server::_nb_ip = 0;
-    const int         MAX_AUTH_IP        = 10;
+    AuthenticationIP Web_Server::_sessions[AUTH_SESSION_SLOTS];
+    uint8_t          Web_Server::_nb_ip       = 0;
+    uint32_t         Web_Server::_last_expiry = 0;
+    const int        MAX_AUTH_IP              = 10;
+    const uint32_t   AUTH_SESSION_TIMEOUT_MS  = 360000;
+    const uint32_t   AUTH_EXPIRY_PERIOD_MS    = 1000;
 #    endif
     Web_Server::Web_Server() {}
     Web_Server::~Web_Server() { end(); }
 
     long Web_Server::get_client_ID() { return _id_connection; }
 
+    bool Web_Server::has_websocket_clients() { return _setupdone && _socket_server && _socket_server->connectedClients() > 0; }
+
     bool Web_Server::begin() {
         bool no_error = true;
         _setupdone    = false;
@@ -111,13 +290,16 @@ namespace WebUI {
 
         //create instance
         _webserver = new WebServer(_port);
-#    ifdef ENABLE_AUTHENTICATION
         //here the list of headers to be recorded
-        const char* headerkeys[]   = { "Cookie" };
-        size_t      headerkeyssize = sizeof(headerkeys) / sizeof(char*);
+        const char* headerkeys[] = {
+            "If-None-Match", "Range", "If-Range",
+#    ifdef ENABLE_AUTHENTICATION
+            "Cookie",
+#    endif
+        };
+        size_t headerkeyssize = sizeof(headerkeys) / sizeof(char*);
         //ask server to track these headers
         _webserver->collectHeaders(headerkeys, headerkeyssize);
-#    endif
         _socket_server = new WebSocketsServer(_port + 1);
         _socket_server->begin();
         _socket_server->onEvent(handle_Websocket_Event);
@@ -158,8 +340,18 @@ namespace WebUI {
 #    ifdef ENABLE_SD_CARD
         //Direct SD management
         _webserver->on("/upload", HTTP_ANY, handle_direct_SDFileList, SDFile_direct_upload);
+        _webserver->on("/preview", HTTP_ANY, handle_SD_preview);
         //_webserver->on("/SD", HTTP_ANY, handle_SDCARD);
 #    endif
+#    ifdef ENABLE_TASK_STATS
+        _webserver->on("/tasks", HTTP_ANY, handle_tasks);
+#    endif
+#    ifdef ENABLE_TIMELINE
+        _webserver->on("/timeline.csv", HTTP_ANY, handle_timeline);
+#    endif
+#    ifdef ENABLE_METRICS
+        _webserver->on("/metrics", HTTP_GET, handle_metrics);
+#    endif
 
 #    ifdef ENABLE_CAPTIVE_PORTAL
         if (WiFi.getMode() == WIFI_AP) {
@@ -212,6 +404,9 @@ namespace WebUI {
 
     void Web_Server::end() {
         _setupdone = false;
+#    ifdef ENABLE_POSITION_STREAM
+        subscribe_positions(0xff, 0);
+#    endif
 #    ifdef ENABLE_SSDP
         SSDP.end();
 #    endif  //ENABLE_SSDP
@@ -230,10 +425,8 @@ namespace WebUI {
         }
 
 #    ifdef ENABLE_AUTHENTICATION
-        while (_head) {
-            AuthenticationIP* current = _head;
-            _head                     = _head->_next;
-            delete current;
+        for (int i = 0; i < AUTH_SESSION_SLOTS; i++) {
+            _sessions[i].state = AuthSlot::FREE;
         }
         _nb_ip = 0;
 #    endif
@@ -246,21 +439,24 @@ namespace WebUI {
         String contentType = getContentType(path);
         String pathWithGz  = path + ".gz";
         //if have a index.html or gzip version this is default root page
-        if ((SPIFFS.exists(pathWithGz) || SPIFFS.exists(path)) && !_webserver->hasArg("forcefallback") &&
+        if ((LocalFS.exists(pathWithGz) || LocalFS.exists(path)) && !_webserver->hasArg("forcefallback") &&
             _webserver->arg("forcefallback") != "yes") {
-            if (SPIFFS.exists(pathWithGz)) {
+            if (LocalFS.exists(pathWithGz)) {
                 path = pathWithGz;
             }
 
-            File file = SPIFFS.open(path, FILE_READ);
-            _webserver->streamFile(file, contentType);
+            File file = LocalFS.open(path, FILE_READ);
+            stream_cached_file(_webserver, file, contentType, true);
             file.close();
             return;
         }
 
         //if no lets launch the default content
-        _webserver->sendHeader("Content-Encoding", "gzip");
-        _webserver->send_P(200, "text/html", PAGE_NOFILES, PAGE_NOFILES_SIZE);
+        static uint32_t nofiles_hash = fnv_hash(PAGE_NOFILES, PAGE_NOFILES_SIZE);
+        size_t          start, length;
+        if (begin_cached_response(_webserver, nofiles_hash, PAGE_NOFILES_SIZE, "text/html", true, true, &start, &length)) {
+            _webserver->sendContent_P(PAGE_NOFILES + start, length);
+        }
     }
 
     //Handle not registred path on SPIFFS neither SD ///////////////////////
@@ -280,52 +476,47 @@ namespace WebUI {
         if ((path.substring(0, 4) == "/SD/")) {
             //remove /SD
             path = path.substring(3);
+            if (!sd_lock_for_read()) {
+                _webserver->send(503, "text/plain", "SD card busy");
+                return;
+            }
             if (SD.exists(pathWithGz) || SD.exists(path)) {
                 if (SD.exists(pathWithGz)) {
                     path = pathWithGz;
                 }
-                File datafile = SD.open(path);
-                if (datafile) {
-                    vTaskDelay(1 / portTICK_RATE_MS);
-                    size_t totalFileSize = datafile.size();
-                    size_t i             = 0;
-                    bool   done          = false;
-                    _webserver->setContentLength(totalFileSize);
-                    _webserver->send(200, contentType, "");
-                    uint8_t buf[1024];
-                    while (!done) {
-                        vTaskDelay(1 / portTICK_RATE_MS);
-                        int v = datafile.read(buf, 1024);
-                        if ((v == -1) || (v == 0)) {
-                            done = true;
-                        } else {
-                            _webserver->client().write(buf, 1024);
-                            i += v;
-                        }
-
-                        if (i >= totalFileSize) {
-                            done = true;
-                        }
-                    }
-                    datafile.close();
-                    if (i != totalFileSize) {
-                        //error: TBD
-                    }
+                // The file is read ahead in large blocks by the SD transfer task.
+                uint32_t totalFileSize;
+                if (!sd_download_begin(SD, path.c_str(), &totalFileSize)) {
+                    sd_unlock_for_read();
+                    _webserver->send(503, "text/plain", "SD card busy");
                     return;
                 }
+                _webserver->setContentLength(totalFileSize);
+                _webserver->send(200, contentType, "");
+                const uint8_t* block;
+                size_t         length;
+                while ((block = sd_download_next(&length)) != NULL && length) {
+                    if (_webserver->client().write(block, length) != length) {
+                        break;
+                    }
+                }
+                sd_download_end();
+                sd_unlock_for_read();
+                return;
             }
+            sd_unlock_for_read();
             String content = "cannot find ";
             content += path;
             _webserver->send(404, "text/plain", content);
             return;
         } else
 #    endif
-            if (SPIFFS.exists(pathWithGz) || SPIFFS.exists(path)) {
-            if (SPIFFS.exists(pathWithGz)) {
+            if (LocalFS.exists(pathWithGz) || LocalFS.exists(path)) {
+            if (LocalFS.exists(pathWithGz)) {
                 path = pathWithGz;
             }
-            File file = SPIFFS.open(path, FILE_READ);
-            _webserver->streamFile(file, contentType);
+            File file = LocalFS.open(path, FILE_READ);
+            stream_cached_file(_webserver, file, contentType, must_revalidate(path));
             file.close();
             return;
         } else {
@@ -356,12 +547,12 @@ namespace WebUI {
             path        = "/404.htm";
             contentType = getContentType(path);
             pathWithGz  = path + ".gz";
-            if (SPIFFS.exists(pathWithGz) || SPIFFS.exists(path)) {
-                if (SPIFFS.exists(pathWithGz)) {
+            if (LocalFS.exists(pathWithGz) || LocalFS.exists(path)) {
+                if (LocalFS.exists(pathWithGz)) {
                     path = pathWithGz;
                 }
-                File file = SPIFFS.open(path, FILE_READ);
-                _webserver->streamFile(file, contentType);
+                File file = LocalFS.open(path, FILE_READ);
+                stream_cached_file(_webserver, file, contentType, true);
                 file.close();
 
             } else {
@@ -486,20 +677,11 @@ namespace WebUI {
         if (ESPpos > -1) {
             char line[256];
             strncpy(line, cmd.c_str(), 255);
-            ESPResponseStream* espresponse = silent ? NULL : new ESPResponseStream(_webserver);
+            ESPResponseStream  stream(_webserver);
+            ESPResponseStream* espresponse = silent ? NULL : &stream;
             Error              err         = system_execute_line(line, espresponse, auth_level);
-            String             answer;
-            if (err == Error::Ok) {
-                answer = "ok";
-            } else {
-                const char* msg = errorString(err);
-                answer          = "Error: ";
-                if (msg) {
-                    answer += msg;
-                } else {
-                    answer += static_cast<int>(err);
-                }
-            }
+            char               answer[64];
+            command_answer(err, answer, sizeof(answer));
             if (silent || !espresponse->anyOutput()) {
                 _webserver->send(err != Error::Ok ? 401 : 200, "text/plain", answer);
             } else {
@@ -510,34 +692,61 @@ namespace WebUI {
                 _webserver->send(401, "text/plain", "Authentication failed!\n");
                 return;
             }
-            //Instead of send several commands one by one by web  / send full set and split here
-            String      scmd;
-            const char* res    = "";
-            uint8_t     sindex = 0;
-            // TODO Settings - this is very inefficient.  get_Splited_Value() is O(n^2)
-            // when it could easily be O(n).  Also, it would be just as easy to push
-            // the entire string into Serial2Socket and pull off lines from there.
-            for (uint8_t sindex = 0; (scmd = get_Splited_Value(cmd, '\n', sindex)) != ""; sindex++) {
-                // 0xC2 is an HTML encoding prefix that, in UTF-8 mode,
-                // precede 0x90 and 0xa0-0bf, which are GRBL realtime commands.
-                // There are other encodings for 0x91-0x9f, so I am not sure
-                // how - or whether - those commands work.
-                // Ref: https://www.w3schools.com/tags/ref_urlencode.ASP
-                if (!silent && (scmd.length() == 2) && (scmd[0] == 0xC2)) {
-                    scmd[0] = scmd[1];
-                    scmd.remove(1, 1);
-                }
-                if (scmd.length() > 1) {
-                    scmd += "\n";
-                } else if (!is_realtime_cmd(scmd[0])) {
-                    scmd += "\n";
-                }
-                if (!Serial2Socket.push(scmd.c_str())) {
-                    res = "Error";
-                }
+            _webserver->send(200, "text/plain", push_commands(cmd.c_str(), !silent) ? "" : "Error");
+        }
+    }
+
+    void Web_Server::command_answer(Error err, char* answer, size_t size) {
+        if (err == Error::Ok) {
+            strncpy(answer, "ok", size);
+            return;
+        }
+        const char* msg = errorString(err);
+        if (msg) {
+            snprintf(answer, size, "Error: %s", msg);
+        } else {
+            snprintf(answer, size, "Error: %d", static_cast<int>(err));
+        }
+    }
+
+    // Several commands can be sent at once, one per line. They are pushed to Serial2Socket one by one,
+    // copied out of the request in a fixed buffer instead of a String each. Returns false if one did
+    // not fit.
+    bool Web_Server::push_commands(const char* cmd, bool utf8) {
+        bool        res  = true;
+        const char* next = cmd;
+        char        line[256];
+        while (*next) {
+            const char* end  = strchr(next, '\n');
+            size_t      len  = end ? end - next : strlen(next);
+            const char* from = next;
+            next             = end ? end + 1 : next + len;
+            if (len == 0) {
+                continue;
+            }
+            if (len > sizeof(line) - 2) {
+                res = false;  // Longer than Serial2Socket can take
+                continue;
+            }
+            memcpy(line, from, len);
+            // 0xC2 is an HTML encoding prefix that, in UTF-8 mode,
+            // precede 0x90 and 0xa0-0bf, which are GRBL realtime commands.
+            // There are other encodings for 0x91-0x9f, so I am not sure
+            // how - or whether - those commands work.
+            // Ref: https://www.w3schools.com/tags/ref_urlencode.ASP
+            if (utf8 && len == 2 && line[0] == char(0xC2)) {
+                line[0] = line[1];
+                len     = 1;
+            }
+            if (len > 1 || !is_realtime_cmd(line[0])) {
+                line[len++] = '\n';
+            }
+            line[len] = '\0';
+            if (!Serial2Socket.push(line)) {
+                res = false;
             }
-            _webserver->send(200, "text/plain", res);
         }
+        return res;
     }
 
     //login status check
@@ -645,13 +854,15 @@ namespace WebUI {
                 }
                 //create Session
                 if ((current_auth_level != auth_level) || (auth_level == AuthenticationLevel::LEVEL_GUEST)) {
-                    AuthenticationIP* current_auth = new AuthenticationIP;
-                    current_auth->level            = current_auth_level;
-                    current_auth->ip               = _webserver->client().remoteIP();
-                    strcpy(current_auth->sessionID, create_session_ID());
-                    strcpy(current_auth->userID, sUser.c_str());
-                    current_auth->last_time = millis();
-                    if (AddAuthIP(current_auth)) {
+                    AuthenticationIP new_auth;
+                    new_auth.level = current_auth_level;
+                    new_auth.ip    = _webserver->client().remoteIP();
+                    strcpy(new_auth.sessionID, create_session_ID());
+                    strncpy(new_auth.userID, sUser.c_str(), sizeof(new_auth.userID) - 1);
+                    new_auth.userID[sizeof(new_auth.userID) - 1] = '\0';
+                    new_auth.last_time                           = millis();
+                    AuthenticationIP* current_auth               = AddAuthIP(new_auth);
+                    if (current_auth) {
                         String tmps = "ESPSESSIONID=";
                         tmps += current_auth->sessionID;
                         _webserver->sendHeader("Set-Cookie", tmps);
@@ -668,7 +879,6 @@ namespace WebUI {
                                 break;
                         }
                     } else {
-                        delete current_auth;
                         msg_alert_error = true;
                         code            = 500;
                         smsg            = "Error: Too many connections";
@@ -749,6 +959,7 @@ namespace WebUI {
 
         //check if query need some action
         if (_webserver->hasArg("action")) {
+            etag_cache_clear();
             //delete a file
             if (_webserver->arg("action") == "delete" && _webserver->hasArg("filename")) {
                 String filename;
@@ -756,10 +967,10 @@ namespace WebUI {
                 shortname.replace("/", "");
                 filename = path + _webserver->arg("filename");
                 filename.replace("//", "/");
-                if (!SPIFFS.exists(filename)) {
+                if (!LocalFS.exists(filename)) {
                     status = shortname + " does not exists!";
                 } else {
-                    if (SPIFFS.remove(filename)) {
+                    if (LocalFS.remove(filename)) {
                         status = shortname + " deleted";
                         //what happen if no "/." and no other subfiles ?
                         String ptmp = path;
@@ -767,11 +978,11 @@ namespace WebUI {
                             ptmp = path.substring(0, path.length() - 1);
                         }
 
-                        File dir        = SPIFFS.open(ptmp);
+                        File dir        = LocalFS.open(ptmp);
                         File dircontent = dir.openNextFile();
                         if (!dircontent) {
                             //keep directory alive even empty
-                            File r = SPIFFS.open(path + "/.", FILE_WRITE);
+                            File r = LocalFS.open(path + "/.", FILE_WRITE);
                             if (r) {
                                 r.close();
                             }
@@ -792,12 +1003,12 @@ namespace WebUI {
                 filename.replace("//", "/");
                 if (filename != "/") {
                     bool delete_error = false;
-                    File dir          = SPIFFS.open(path + shortname);
+                    File dir          = LocalFS.open(path + shortname);
                     {
                         File file2deleted = dir.openNextFile();
                         while (file2deleted) {
                             String fullpath = file2deleted.name();
-                            if (!SPIFFS.remove(fullpath)) {
+                            if (!LocalFS.remove(fullpath)) {
                                 delete_error = true;
                                 status       = "Cannot deleted ";
                                 status += fullpath;
@@ -819,10 +1030,10 @@ namespace WebUI {
                 String shortname = _webserver->arg("filename");
                 shortname.replace("/", "");
                 filename.replace("//", "/");
-                if (SPIFFS.exists(filename)) {
+                if (LocalFS.exists(filename)) {
                     status = shortname + " already exists!";
                 } else {
-                    File r = SPIFFS.open(filename, FILE_WRITE);
+                    File r = LocalFS.open(filename, FILE_WRITE);
                     if (!r) {
                         status = "Cannot create ";
                         status += shortname;
@@ -834,80 +1045,91 @@ namespace WebUI {
             }
         }
 
-        String jsonfile = "{";
-        String ptmp     = path;
+        String ptmp = path;
         if ((path != "/") && (path[path.length() - 1] = '/')) {
             ptmp = path.substring(0, path.length() - 1);
         }
 
-        File dir = SPIFFS.open(ptmp);
-        jsonfile += "\"files\":[";
-        bool   firstentry = true;
-        String subdirlist = "";
-        File   fileparsed = dir.openNextFile();
+        uint32_t start, count;
+        get_list_page(_webserver, &start, &count);
+
+        ESPResponseStream stream(_webserver, "application/json");
+        JSONencoder       j(false, &stream);
+        j.begin();
+        j.begin_array("files");
+        uint32_t subdirs[MAX_LIST_SUBDIRS];
+        int      n_subdirs = 0;
+        uint32_t index     = 0;
+        bool     more      = false;
+        char     name[64];
+        char     size[16];
+        File     dir        = LocalFS.open(ptmp);
+        File     fileparsed = dir.openNextFile();
         while (fileparsed) {
-            String filename  = fileparsed.name();
-            String size      = "";
-            bool   addtolist = true;
             //remove path from name
-            filename = filename.substring(path.length(), filename.length());
-            //check if file or subfile
-            if (filename.indexOf("/") > -1) {
+            const char* filename  = fileparsed.name() + path.length();
+            const char* slash     = strchr(filename, '/');
+            bool        addtolist = true;
+            if (slash) {
                 //Do not rely on "/." to define directory as SPIFFS upload won't create it but directly files
                 //and no need to overload SPIFFS if not necessary to create "/." if no need
                 //it will reduce SPIFFS available space so limit it to creation
-                filename   = filename.substring(0, filename.indexOf("/"));
-                String tag = "*";
-                tag += filename + "*";
-                if (subdirlist.indexOf(tag) > -1 || filename.length() == 0) {  //already in list
-                    addtolist = false;                                         //no need to add
-                } else {
-                    size = "-1";  //it is subfile so display only directory, size will be -1 to describe it is directory
-                    if (subdirlist.length() == 0) {
-                        subdirlist += "*";
+                size_t   len  = slash - filename;
+                uint32_t hash = fnv_hash(filename, len);
+                for (int i = 0; i < n_subdirs; i++) {
+                    if (subdirs[i] == hash) {
+                        addtolist = false;  //already in list
+                        break;
                     }
-                    subdirlist += filename + "*";  //add to list
                 }
-            } else {
-                //do not add "." file
-                if (!((filename == ".") || (filename == ""))) {
-                    size = ESPResponseStream::formatBytes(fileparsed.size());
-                } else {
+                if (len == 0) {
                     addtolist = false;
                 }
+                if (addtolist) {
+                    if (n_subdirs < MAX_LIST_SUBDIRS) {
+                        subdirs[n_subdirs++] = hash;
+                    }
+                    snprintf(name, sizeof(name), "%.*s", int(len), filename);
+                    strcpy(size, "-1");  //it is subfile so display only directory, size will be -1 to describe it is directory
+                }
+            } else if ((filename[0] == '\0') || (strcmp(filename, ".") == 0)) {
+                //do not add "." file
+                addtolist = false;
+            } else {
+                snprintf(name, sizeof(name), "%s", filename);
+                ESPResponseStream::formatBytes(fileparsed.size(), size, sizeof(size));
             }
             if (addtolist) {
-                if (!firstentry) {
-                    jsonfile += ",";
-                } else {
-                    firstentry = false;
+                if (index >= start && index - start >= count) {
+                    more = true;
+                    break;
+                }
+                if (index >= start) {
+                    j.begin_object();
+                    j.member("name", name);
+                    j.member("size", size);
+                    j.end_object();
                 }
-                jsonfile += "{";
-                jsonfile += "\"name\":\"";
-                jsonfile += filename;
-                jsonfile += "\",\"size\":\"";
-                jsonfile += size;
-                jsonfile += "\"";
-                jsonfile += "}";
+                index++;
             }
             fileparsed = dir.openNextFile();
         }
-        jsonfile += "],";
-        jsonfile += "\"path\":\"" + path + "\",";
-        jsonfile += "\"status\":\"" + status + "\",";
-        size_t totalBytes;
-        size_t usedBytes;
-        totalBytes = SPIFFS.totalBytes();
-        usedBytes  = SPIFFS.usedBytes();
-        jsonfile += "\"total\":\"" + ESPResponseStream::formatBytes(totalBytes) + "\",";
-        jsonfile += "\"used\":\"" + ESPResponseStream::formatBytes(usedBytes) + "\",";
-        jsonfile.concat(F("\"occupation\":\""));
-        jsonfile += String(100 * usedBytes / totalBytes);
-        jsonfile += "\"";
-        jsonfile += "}";
-        path = "";
-        _webserver->sendHeader("Cache-Control", "no-cache");
-        _webserver->send(200, "application/json", jsonfile);
+        j.end_array();
+        if (more) {
+            j.member("next", int(index));
+        }
+        j.member("path", path);
+        j.member("status", status);
+        size_t totalBytes = LocalFS.totalBytes();
+        size_t usedBytes  = LocalFS.usedBytes();
+        ESPResponseStream::formatBytes(totalBytes, size, sizeof(size));
+        j.member("total", size);
+        ESPResponseStream::formatBytes(usedBytes, size, sizeof(size));
+        j.member("used", size);
+        snprintf(size, sizeof(size), "%u", unsigned(100 * usedBytes / totalBytes));
+        j.member("occupation", size);
+        j.end();
+        stream.flush();
         _upload_status = UploadStatusType::NONE;
     }
 
@@ -958,6 +1180,7 @@ namespace WebUI {
                 //Upload start
                 //**************
                 if (upload.status == UPLOAD_FILE_START) {
+                    etag_cache_clear();
                     _upload_status         = UploadStatusType::ONGOING;
                     String upload_filename = upload.filename;
                     if (upload_filename[0] != '/') {
@@ -972,8 +1195,8 @@ namespace WebUI {
                         filename        = "/user" + upload_filename;
                     }
 
-                    if (SPIFFS.exists(filename)) {
-                        SPIFFS.remove(filename);
+                    if (LocalFS.exists(filename)) {
+                        LocalFS.remove(filename);
                     }
                     if (fsUploadFile) {
                         fsUploadFile.close();
@@ -981,7 +1204,7 @@ namespace WebUI {
                     String sizeargname = upload.filename + "S";
                     if (_webserver->hasArg(sizeargname)) {
                         uint32_t filesize  = _webserver->arg(sizeargname).toInt();
-                        uint32_t freespace = SPIFFS.totalBytes() - SPIFFS.usedBytes();
+                        uint32_t freespace = LocalFS.totalBytes() - LocalFS.usedBytes();
                         if (filesize > freespace) {
                             _upload_status = UploadStatusType::FAILED;
                             grbl_send(CLIENT_ALL, "[MSG:Upload error]\r\n");
@@ -991,7 +1214,7 @@ namespace WebUI {
 
                     if (_upload_status != UploadStatusType::FAILED) {
                         //create file
-                        fsUploadFile = SPIFFS.open(filename, FILE_WRITE);
+                        fsUploadFile = LocalFS.open(filename, FILE_WRITE);
                         //check If creation succeed
                         if (fsUploadFile) {
                             //if yes upload is started
@@ -1030,7 +1253,7 @@ namespace WebUI {
                         fsUploadFile.close();
                         //check size
                         String sizeargname = upload.filename + "S";
-                        fsUploadFile       = SPIFFS.open(filename, FILE_READ);
+                        fsUploadFile       = LocalFS.open(filename, FILE_READ);
                         uint32_t filesize  = fsUploadFile.size();
                         fsUploadFile.close();
 
@@ -1062,8 +1285,8 @@ namespace WebUI {
 
         if (_upload_status == UploadStatusType::FAILED) {
             cancelUpload();
-            if (SPIFFS.exists(filename)) {
-                SPIFFS.remove(filename);
+            if (LocalFS.exists(filename)) {
+                LocalFS.remove(filename);
             }
         }
         COMMANDS::wait(0);
@@ -1137,6 +1360,12 @@ namespace WebUI {
                             _upload_status = UploadStatusType::FAILED;
                             grbl_send(CLIENT_ALL, "[MSG:Update cancelled]\r\n");
                             pushError(ESP_ERROR_NOT_ENOUGH_SPACE, "Upload rejected, not enough space");
+#    ifdef ENABLE_OTA_STREAM
+                        } else if (!ota_begin(maxSketchSpace)) {
+                            _upload_status = UploadStatusType::FAILED;
+                            grbl_send(CLIENT_ALL, "[MSG:Update cancelled]\r\n");
+                            pushError(ESP_ERROR_NOT_ENOUGH_SPACE, "Upload rejected, not enough memory");
+#    endif
                         } else {
                             grbl_send(CLIENT_ALL, "\n[MSG:Update 0%]\r\n");
                         }
@@ -1144,6 +1373,15 @@ namespace WebUI {
                     //Upload write
                     //**************
                 } else if (upload.status == UPLOAD_FILE_WRITE) {
+#    ifdef ENABLE_OTA_STREAM
+                    // otaWriteTask writes the data and ota_write() reports the progress. It only waits
+                    // when both blocks are still being written.
+                    if (_upload_status == UploadStatusType::ONGOING && !ota_write(upload.buf, upload.currentSize)) {
+                        _upload_status = UploadStatusType::FAILED;
+                        grbl_send(CLIENT_ALL, "[MSG:Update write failed]\r\n");
+                        pushError(ESP_ERROR_FILE_WRITE, "File write failed");
+                    }
+#    else
                     vTaskDelay(1 / portTICK_RATE_MS);
                     //check if no error
                     if (_upload_status == UploadStatusType::ONGOING) {
@@ -1165,10 +1403,15 @@ namespace WebUI {
                             pushError(ESP_ERROR_FILE_WRITE, "File write failed");
                         }
                     }
+#    endif
                     //Upload end
                     //**************
                 } else if (upload.status == UPLOAD_FILE_END) {
+#    ifdef ENABLE_OTA_STREAM
+                    if (ota_end() && Update.end(true)) {
+#    else
                     if (Update.end(true)) {  //true to set the size to the current progress
+#    endif
                         //Now Reboot
                         grbl_send(CLIENT_ALL, "[MSG:Update 100%]\r\n");
                         _upload_status = UploadStatusType::SUCCESSFUL;
@@ -1180,6 +1423,9 @@ namespace WebUI {
                 } else if (upload.status == UPLOAD_FILE_ABORTED) {
                     grbl_send(CLIENT_ALL, "[MSG:Update failed]\r\n");
                     _upload_status = UploadStatusType::FAILED;
+#    ifdef ENABLE_OTA_STREAM
+                    ota_abort();
+#    endif
                     return;
                 }
             }
@@ -1187,6 +1433,9 @@ namespace WebUI {
 
         if (_upload_status == UploadStatusType::FAILED) {
             cancelUpload();
+#    ifdef ENABLE_OTA_STREAM
+            ota_abort();
+#    endif
             Update.end();
         }
 
@@ -1195,6 +1444,207 @@ namespace WebUI {
 
 #    ifdef ENABLE_SD_CARD
 
+    // Mounts the card if needed for a download or a preview, which may also run during an SD job.
+    // Returns false if the card is missing or busy with something else.
+    bool Web_Server::sd_lock_for_read() {
+        uint8_t state = get_sd_state(false);
+        if (state == SDCARD_BUSY_PRINTING) {
+            return true;
+        }
+        if (get_sd_state(true) != SDCARD_IDLE) {
+            return false;
+        }
+        set_sd_state(SDCARD_BUSY_PARSING);
+        return true;
+    }
+
+    void Web_Server::sd_unlock_for_read() {
+        if (get_sd_state(false) == SDCARD_BUSY_PARSING) {
+            set_sd_state(SDCARD_IDLE);
+        }
+    }
+
+    // Toolpath of a job for a preview, from one pass over the file. Only the end points of the moves
+    // are followed. Arcs count as one move to their end, and moves in machine coordinates or to the
+    // predefined positions are skipped.
+    typedef struct {
+        float    position[3];
+        float    scale;  // mm per unit
+        bool     absolute;
+        uint8_t  motion;  // 0 for G0, 1 for the feed moves
+        uint32_t moves;
+    } preview_state_t;
+
+    // Returns true if the line is a move.
+    static bool preview_line(preview_state_t* st, const char* line) {
+        float target[3];
+        bool  has_axis         = false;
+        bool  non_modal        = false;
+        bool  has_axis_word[3] = { false, false, false };
+        while (*line) {
+            char c = toupper(*line);
+            if (c == '(') {
+                const char* end = strchr(line, ')');
+                if (!end) {
+                    break;
+                }
+                line = end + 1;
+                continue;
+            }
+            if (c == ';' || c == '%') {
+                break;
+            }
+            if (c < 'A' || c > 'Z') {
+                line++;
+                continue;
+            }
+            char* end;
+            float value = strtof(line + 1, &end);
+            if (end == line + 1) {
+                line++;
+                continue;
+            }
+            line = end;
+            switch (c) {
+                case 'G':
+                    switch (int(value * 10 + 0.5)) {
+                        case 0:
+                            st->motion = 0;
+                            break;
+                        case 10:
+                        case 20:
+                        case 30:
+                            st->motion = 1;
+                            break;
+                        case 200:
+                            st->scale = MM_PER_INCH;
+                            break;
+                        case 210:
+                            st->scale = 1.0;
+                            break;
+                        case 900:
+                            st->absolute = true;
+                            break;
+                        case 910:
+                            st->absolute = false;
+                            break;
+                        case 280:
+                        case 300:
+                        case 530:
+                        case 100:
+                        case 920:
+                            non_modal = true;
+                            break;
+                    }
+                    break;
+                case 'X':
+                case 'Y':
+                case 'Z': {
+                    int axis            = c - 'X';
+                    target[axis]        = value * st->scale;
+                    has_axis_word[axis] = true;
+                    has_axis            = true;
+                    break;
+                }
+            }
+        }
+        if (!has_axis || non_modal) {
+            return false;
+        }
+        for (int axis = 0; axis < 3; axis++) {
+            if (has_axis_word[axis]) {
+                st->position[axis] = st->absolute ? target[axis] : st->position[axis] + target[axis];
+            }
+        }
+        st->moves++;
+        return true;
+    }
+
+    static void preview_point(ESPResponseStream* stream, const preview_state_t* st, bool first) {
+        char point[64];
+        snprintf(point,
+                 sizeof(point),
+                 "%s[%.3f,%.3f,%.3f,%d]",
+                 first ? "" : ",",
+                 st->position[0],
+                 st->position[1],
+                 st->position[2],
+                 st->motion);
+        stream->print(point);
+    }
+
+    // /preview?path=/job.nc&every=N streams {"path":..,"every":N,"points":[[x,y,z,feed],..],"moves":M}
+    // with every Nth move of the job and its last one, in mm.
+    void Web_Server::handle_SD_preview() {
+        if (is_authenticated() == AuthenticationLevel::LEVEL_GUEST) {
+            _webserver->send(401, "application/json", "{\"status\":\"Authentication failed!\"}");
+            return;
+        }
+        String path = _webserver->arg("path");
+        if (path.length() == 0 || path[0] != '/') {
+            path = "/" + path;
+        }
+        uint32_t every = _webserver->hasArg("every") ? _webserver->arg("every").toInt() : 10;
+        if (every == 0) {
+            every = 1;
+        }
+        if (!sd_lock_for_read()) {
+            _webserver->send(503, "application/json", "{\"status\":\"SD card busy\"}");
+            return;
+        }
+        uint32_t size;
+        if (!sd_download_begin(SD, path.c_str(), &size)) {
+            sd_unlock_for_read();
+            _webserver->send(404, "application/json", "{\"status\":\"Cannot open file\"}");
+            return;
+        }
+
+        ESPResponseStream stream(_webserver, "application/json");
+        char              line[LINE_BUFFER_SIZE];
+        size_t            line_len = 0;
+        preview_state_t   st       = { { 0.0, 0.0, 0.0 }, 1.0, true, 0, 0 };
+        bool              first    = true;
+        bool              pending  = false;  // The last move has not been sent
+        snprintf(line, sizeof(line), "{\"path\":\"%s\",\"every\":%u,\"points\":[", path.c_str(), every);
+        stream.print(line);
+        const uint8_t* block;
+        size_t         length = 0;
+        size_t         pos    = 0;
+        bool           more   = true;
+        while (more) {
+            if (pos == length) {
+                block = sd_download_next(&length);
+                pos   = 0;
+                COMMANDS::wait(0);
+            }
+            more   = block && length;
+            char c = more ? block[pos++] : '\n';  // The end of the file ends the last line
+            if (c != '\n' && c != '\r') {
+                if (line_len < sizeof(line) - 1) {
+                    line[line_len++] = c;
+                }
+                continue;
+            }
+            line[line_len] = '\0';
+            line_len       = 0;
+            if (preview_line(&st, line)) {
+                pending = (st.moves - 1) % every != 0;
+                if (!pending) {
+                    preview_point(&stream, &st, first);
+                    first = false;
+                }
+            }
+        }
+        if (pending) {
+            preview_point(&stream, &st, first);
+        }
+        snprintf(line, sizeof(line), "],\"moves\":%u}", st.moves);
+        stream.print(line);
+        stream.flush();
+        sd_download_end();
+        sd_unlock_for_read();
+    }
+
     //Function to delete not empty directory on SD card
     bool Web_Server::deleteRecursive(String path) {
         bool result = true;
@@ -1336,10 +1786,6 @@ namespace WebUI {
             list_files = false;
         }
 
-        // TODO Settings - consider using the JSONEncoder class
-        String jsonfile = "{";
-        jsonfile += "\"files\":[";
-
         if (path != "/") {
             path = path.substring(0, path.length() - 1);
         }
@@ -1348,8 +1794,21 @@ namespace WebUI {
             s += path;
             s += " does not exist on SD Card\"}";
             _webserver->send(200, "application/json", s);
+            _upload_status = UploadStatusType::NONE;
+            set_sd_state(SDCARD_IDLE);
             return;
         }
+
+        uint32_t start, count;
+        get_list_page(_webserver, &start, &count);
+
+        ESPResponseStream stream(_webserver, "application/json");
+        JSONencoder       j(false, &stream);
+        char              size[16];
+        j.begin();
+        j.begin_array("files");
+        uint32_t index = 0;
+        bool     more  = false;
         if (list_files) {
             File dir = SD.open(path);
             if (!dir.isDirectory()) {
@@ -1357,81 +1816,80 @@ namespace WebUI {
             }
             dir.rewindDirectory();
             File entry = dir.openNextFile();
-            int  i     = 0;
             while (entry) {
                 COMMANDS::wait(1);
-                if (i > 0) {
-                    jsonfile += ",";
+                if (index >= start && index - start >= count) {
+                    more = true;
+                    entry.close();
+                    break;
                 }
-                jsonfile += "{\"name\":\"";
-                String tmpname = entry.name();
-                int    pos     = tmpname.lastIndexOf("/");
-                tmpname        = tmpname.substring(pos + 1);
-                jsonfile += tmpname;
-                jsonfile += "\",\"shortname\":\"";  //No need here
-                jsonfile += tmpname;
-                jsonfile += "\",\"size\":\"";
-                if (entry.isDirectory()) {
-                    jsonfile += "-1";
-                } else {
-                    // files have sizes, directories do not
-                    jsonfile += ESPResponseStream::formatBytes(entry.size());
+                if (index >= start) {
+                    const char* name  = entry.name();
+                    const char* slash = strrchr(name, '/');
+                    if (slash) {
+                        name = slash + 1;
+                    }
+                    if (entry.isDirectory()) {
+                        strcpy(size, "-1");
+                    } else {
+                        // files have sizes, directories do not
+                        ESPResponseStream::formatBytes(entry.size(), size, sizeof(size));
+                    }
+                    j.begin_object();
+                    j.member("name", name);
+                    j.member("shortname", name);  //No need here
+                    j.member("size", size);
+                    j.member("datetime", "");  //TODO - can be done later
+                    j.end_object();
                 }
-                jsonfile += "\",\"datetime\":\"";
-                //TODO - can be done later
-                jsonfile += "\"}";
-                i++;
+                index++;
                 entry.close();
                 entry = dir.openNextFile();
             }
             dir.close();
         }
-        jsonfile += "],\"path\":\"";
-        jsonfile += path + "\",";
-        jsonfile += "\"total\":\"";
-        String stotalspace, susedspace;
-        //SDCard are in GB or MB but no less
-        totalspace  = SD.totalBytes();
-        usedspace   = SD.usedBytes();
-        stotalspace = ESPResponseStream::formatBytes(totalspace);
-        susedspace  = ESPResponseStream::formatBytes(usedspace + 1);
-
-        uint32_t occupedspace = 1;
-        uint32_t usedspace2   = usedspace / (1024 * 1024);
-        uint32_t totalspace2  = totalspace / (1024 * 1024);
-        occupedspace          = (usedspace2 * 100) / totalspace2;
-        //minimum if even one byte is used is 1%
-        if (occupedspace <= 1) {
-            occupedspace = 1;
+        j.end_array();
+        if (more) {
+            j.member("next", int(index));
         }
+        j.member("path", path);
+        //SDCard are in GB or MB but no less
+        totalspace = SD.totalBytes();
+        usedspace  = SD.usedBytes();
         if (totalspace) {
-            jsonfile += stotalspace;
+            ESPResponseStream::formatBytes(totalspace, size, sizeof(size));
         } else {
-            jsonfile += "-1";
+            strcpy(size, "-1");
         }
-        jsonfile += "\",\"used\":\"";
-        jsonfile += susedspace;
-        jsonfile += "\",\"occupation\":\"";
+        j.member("total", size);
+        ESPResponseStream::formatBytes(usedspace + 1, size, sizeof(size));
+        j.member("used", size);
         if (totalspace) {
-            jsonfile += String(occupedspace);
+            uint32_t usedspace2   = usedspace / (1024 * 1024);
+            uint32_t totalspace2  = totalspace / (1024 * 1024);
+            uint32_t occupedspace = totalspace2 ? (usedspace2 * 100) / totalspace2 : 0;
+            //minimum if even one byte is used is 1%
+            if (occupedspace <= 1) {
+                occupedspace = 1;
+            }
+            snprintf(size, sizeof(size), "%u", occupedspace);
         } else {
-            jsonfile += "-1";
+            strcpy(size, "-1");
         }
-        jsonfile += "\",";
-        jsonfile += "\"mode\":\"direct\",";
-        jsonfile += "\"status\":\"";
-        jsonfile += sstatus + "\"";
-        jsonfile += "}";
-        _webserver->sendHeader("Cache-Control", "no-cache");
-        _webserver->send(200, "application/json", jsonfile);
+        j.member("occupation", size);
+        j.member("mode", "direct");
+        j.member("status", sstatus);
+        j.end();
+        stream.flush();
         _upload_status = UploadStatusType::NONE;
         set_sd_state(SDCARD_IDLE);
     }
 
     //SD File upload with direct access to SD///////////////////////////////
+    // The data is written to the card by a background task, see sd_upload_begin(), so the web server
+    // only copies each chunk.
     void Web_Server::SDFile_direct_upload() {
         static String filename;
-        static File   sdUploadFile;
         //this is only for admin and user
         if (is_authenticated() == AuthenticationLevel::LEVEL_GUEST) {
             _upload_status = UploadStatusType::FAILED;
@@ -1462,9 +1920,10 @@ namespace WebUI {
                         if (SD.exists(filename)) {
                             SD.remove(filename);
                         }
-                        String sizeargname = upload.filename + "S";
+                        String   sizeargname = upload.filename + "S";
+                        uint32_t filesize    = 0;
                         if (_webserver->hasArg(sizeargname)) {
-                            uint32_t filesize  = _webserver->arg(sizeargname).toInt();
+                            filesize           = _webserver->arg(sizeargname).toInt();
                             uint64_t freespace = SD.totalBytes() - SD.usedBytes();
                             if (filesize > freespace) {
                                 _upload_status = UploadStatusType::FAILED;
@@ -1474,9 +1933,7 @@ namespace WebUI {
                         }
                         if (_upload_status != UploadStatusType::FAILED) {
                             //Create file for writing
-                            sdUploadFile = SD.open(filename, FILE_WRITE);
-                            //check if creation succeed
-                            if (!sdUploadFile) {
+                            if (!sd_upload_begin(SD, filename.c_str(), filesize)) {
                                 //if creation failed
                                 _upload_status = UploadStatusType::FAILED;
                                 grbl_send(CLIENT_ALL, "[MSG:Upload failed]\r\n");
@@ -1491,10 +1948,9 @@ namespace WebUI {
                     //Upload write
                     //**************
                 } else if (upload.status == UPLOAD_FILE_WRITE) {
-                    vTaskDelay(1 / portTICK_RATE_MS);
-                    if (sdUploadFile && (_upload_status == UploadStatusType::ONGOING) && (get_sd_state(false) == SDCARD_BUSY_UPLOADING)) {
+                    if ((_upload_status == UploadStatusType::ONGOING) && (get_sd_state(false) == SDCARD_BUSY_UPLOADING)) {
                         //no error write post data
-                        if (upload.currentSize != sdUploadFile.write(upload.buf, upload.currentSize)) {
+                        if (!sd_upload_write(upload.buf, upload.currentSize)) {
                             _upload_status = UploadStatusType::FAILED;
                             grbl_send(CLIENT_ALL, "[MSG:Upload failed]\r\n");
                             pushError(ESP_ERROR_FILE_WRITE, "File write failed");
@@ -1508,14 +1964,11 @@ namespace WebUI {
                     //**************
                 } else if (upload.status == UPLOAD_FILE_END) {
                     //if file is open close it
-                    if (sdUploadFile) {
-                        sdUploadFile.close();
-                        //TODO Check size
+                    if (sd_upload_end()) {
                         String sizeargname = upload.filename + "S";
                         if (_webserver->hasArg(sizeargname)) {
-                            uint32_t filesize = 0;
-                            sdUploadFile      = SD.open(filename, FILE_READ);
-                            filesize          = sdUploadFile.size();
+                            File     sdUploadFile = SD.open(filename, FILE_READ);
+                            uint32_t filesize     = sdUploadFile.size();
                             sdUploadFile.close();
                             if (_webserver->arg(sizeargname) != String(filesize)) {
                                 _upload_status = UploadStatusType::FAILED;
@@ -1540,18 +1993,14 @@ namespace WebUI {
                     _upload_status = UploadStatusType::FAILED;
                     set_sd_state(SDCARD_IDLE);
                     grbl_send(CLIENT_ALL, "[MSG:Upload failed]\r\n");
-                    if (sdUploadFile) {
-                        sdUploadFile.close();
-                    }
+                    sd_upload_abort();
                     return;
                 }
             }
         }
         if (_upload_status == UploadStatusType::FAILED) {
             cancelUpload();
-            if (sdUploadFile) {
-                sdUploadFile.close();
-            }
+            sd_upload_abort();
             if (SD.exists(filename)) {
                 SD.remove(filename);
             }
@@ -1561,6 +2010,73 @@ namespace WebUI {
     }
 #    endif
 
+#    ifdef ENABLE_TASK_STATS
+    // /tasks returns {"tasks":[{"name":..,"core":..,"priority":..,"stack_free":..,"cpu_permille":..,
+    // "waits":..,"max_wait_us":..,"max_run_us":..},..]}, the data of $Tasks/Stats.
+    void Web_Server::handle_tasks() {
+        if (is_authenticated() == AuthenticationLevel::LEVEL_GUEST) {
+            _webserver->send(401, "application/json", "{\"status\":\"Authentication failed!\"}");
+            return;
+        }
+        ESPResponseStream stream(_webserver, "application/json");
+        JSONencoder       j(false, &stream);
+        task_info_t       info;
+        j.begin();
+        j.begin_array("tasks");
+        for (uint8_t i = 0; task_stats_get(i, &info); i++) {
+            j.begin_object();
+            j.member("name", info.name);
+            j.member("core", info.core);
+            j.member("priority", int(info.priority));
+            j.member("stack_free", int(info.stack_free));
+            j.member("cpu_permille", int(info.run_permille));
+            j.member("waits", int(info.waits));
+            j.member("max_wait_us", int(info.max_wait_us));
+            j.member("max_run_us", int(info.max_run_us));
+            j.end_object();
+        }
+        j.end_array();
+        j.end();
+        stream.flush();
+    }
+#    endif
+
+#    ifdef ENABLE_TIMELINE
+    // /timeline.csv sends the samples of the buffer level recorder, as $Timeline/Dump does.
+    void Web_Server::handle_timeline() {
+        if (is_authenticated() == AuthenticationLevel::LEVEL_GUEST) {
+            _webserver->send(401, "application/json", "{\"status\":\"Authentication failed!\"}");
+            return;
+        }
+        ESPResponseStream stream(_webserver, "text/csv");
+        char              line[100];
+        timeline_hold(true);
+        timeline_header(line, sizeof(line));
+        stream.println(line);
+        for (uint16_t i = 0; timeline_line(i, line, sizeof(line)); i++) {
+            stream.println(line);
+            if ((i & 63) == 63) {
+                COMMANDS::wait(0);
+            }
+        }
+        timeline_hold(false);
+        stream.flush();
+    }
+#    endif
+
+#    ifdef ENABLE_METRICS
+    // /metrics sends the counters of Metrics.h in the Prometheus text format, as $Metrics does.
+    void Web_Server::handle_metrics() {
+        if (is_authenticated() == AuthenticationLevel::LEVEL_GUEST) {
+            _webserver->send(401, "text/plain", "Authentication failed!");
+            return;
+        }
+        ESPResponseStream stream(_webserver, "text/plain; version=0.0.4");
+        metrics_write([](const char* line, void* arg) { static_cast<ESPResponseStream*>(arg)->println(line); }, &stream);
+        stream.flush();
+    }
+#    endif
+
     void Web_Server::handle() {
         static uint32_t timeout = millis();
         COMMANDS::wait(0);
@@ -1570,11 +2086,36 @@ namespace WebUI {
         }
 #    endif
         if (_webserver) {
+#    ifdef ENABLE_MEMORY_STATS
+            memory_watch_begin();
             _webserver->handleClient();
+            if (uint32_t spike = memory_watch_end()) {
+                memory_log_spike(_webserver->uri().c_str(), spike);
+            }
+#    else
+            _webserver->handleClient();
+#    endif
         }
+#    ifdef ENABLE_AUTHENTICATION
+        if (millis() - _last_expiry >= AUTH_EXPIRY_PERIOD_MS) {
+            ExpireAuthIP();
+            _last_expiry = millis();
+        }
+#    endif
         if (_socket_server && _setupdone) {
+#    ifdef ENABLE_MEMORY_STATS
+            memory_watch_begin();
             _socket_server->loop();
+            if (uint32_t spike = memory_watch_end()) {
+                memory_log_spike("websocket", spike);
+            }
+#    else
+            _socket_server->loop();
+#    endif
         }
+#    ifdef ENABLE_POSITION_STREAM
+        send_positions();
+#    endif
         if ((millis() - timeout) > 10000 && _socket_server) {
             String s = "PING:";
             s += String(_id_connection);
@@ -1583,10 +2124,83 @@ namespace WebUI {
         }
     }
 
+#    ifdef ENABLE_AUTHENTICATION
+    // Level of each websocket connection, given by the session it sent in an AUTH: frame
+    static AuthenticationLevel websocket_auth[WEBSOCKETS_SERVER_CLIENT_MAX];
+#    endif
+
+    /*
+     * Commands over the websocket, instead of an HTTP request each:
+     *   CMD:<id>:<commands>  id is a number the client picks to match the replies
+     * The output of an [ESP] command comes back in OUT:<id>:<text> frames, then its result in
+     * ACK:<id>:ok or ACK:<id>:Error: <message>. Other commands go to Serial2Socket like those of
+     * /command, their output comes on the stream, and ACK:<id>:ok tells they were queued.
+     * With authentication, a connection first sends AUTH:<session ID> of its login.
+     */
+    void Web_Server::handle_websocket_command(uint8_t num, const char* frame) {
+#    ifdef ENABLE_AUTHENTICATION
+        if (strncmp(frame, "AUTH:", 5) == 0) {
+            websocket_auth[num] = ResetAuthIP(_socket_server->remoteIP(num), frame + 5);
+            _socket_server->sendTXT(num, websocket_auth[num] == AuthenticationLevel::LEVEL_GUEST ? "AUTH:Error" : "AUTH:ok");
+            return;
+        }
+        AuthenticationLevel auth_level = websocket_auth[num];
+#    else
+        AuthenticationLevel auth_level = AuthenticationLevel::LEVEL_ADMIN;
+#    endif
+#    ifdef ENABLE_POSITION_STREAM
+        if (strncmp(frame, "POS:", 4) == 0) {
+            subscribe_positions(num, atoi(frame + 4));
+            return;
+        }
+#    endif
+        if (strncmp(frame, "CMD:", 4) != 0) {
+            return;
+        }
+        const char* id  = frame + 4;
+        const char* cmd = strchr(id, ':');
+        if (!cmd || cmd == id || cmd - id > 10) {
+            return;
+        }
+        int  id_len = cmd - id;
+        char answer[64];
+        cmd++;
+        while (isspace(*cmd)) {
+            cmd++;
+        }
+        if (strstr(cmd, "[ESP")) {
+            char line[256];
+            strncpy(line, cmd, sizeof(line) - 1);
+            line[sizeof(line) - 1] = '\0';
+            for (int len = strlen(line); len && isspace(line[len - 1]); len--) {
+                line[len - 1] = '\0';
+            }
+            char prefix[16];
+            snprintf(prefix, sizeof(prefix), "OUT:%.*s:", id_len, id);
+            ESPResponseStream espresponse(_socket_server, num, prefix);
+            Error             err = system_execute_line(line, &espresponse, auth_level);
+            espresponse.flush();
+            command_answer(err, answer, sizeof(answer));
+        } else if (auth_level == AuthenticationLevel::LEVEL_GUEST) {
+            strcpy(answer, "Error: Authentication failed");
+        } else {
+            strcpy(answer, push_commands(cmd, false) ? "ok" : "Error");
+        }
+        char reply[84];
+        snprintf(reply, sizeof(reply), "ACK:%.*s:%s", id_len, id, answer);
+        _socket_server->sendTXT(num, reply);
+    }
+
     void Web_Server::handle_Websocket_Event(uint8_t num, uint8_t type, uint8_t* payload, size_t length) {
         switch (type) {
             case WStype_DISCONNECTED:
                 //USE_SERIAL.printf("[%u] Disconnected!\n", num);
+#    ifdef ENABLE_AUTHENTICATION
+                websocket_auth[num] = AuthenticationLevel::LEVEL_GUEST;
+#    endif
+#    ifdef ENABLE_POSITION_STREAM
+                subscribe_positions(num, 0);
+#    endif
                 break;
             case WStype_CONNECTED: {
                 IPAddress ip = _socket_server->remoteIP(num);
@@ -1597,48 +2211,124 @@ namespace WebUI {
                 _socket_server->sendTXT(_id_connection, s);
                 s = "ACTIVE_ID:" + String(_id_connection);
                 _socket_server->broadcastTXT(s);
+#    ifdef ENABLE_AUTHENTICATION
+                websocket_auth[num] = AuthenticationLevel::LEVEL_GUEST;
+#    endif
             } break;
             case WStype_TEXT:
-                //USE_SERIAL.printf("[%u] get Text: %s\n", num, payload);
-
-                // send message to client
-                // webSocket.sendTXT(num, "message here");
-
-                // send data to all connected clients
-                // webSocket.broadcastTXT("message here");
-                break;
-            case WStype_BIN:
-                //USE_SERIAL.printf("[%u] get binary length: %u\n", num, length);
-                //hexdump(payload, length);
-
-                // send message to client
-                // webSocket.sendBIN(num, payload, length);
+                // The library terminates text payloads
+                handle_websocket_command(num, (const char*)payload);
                 break;
+            case WStype_BIN: {
+                // Same format as text, copied to add the terminator
+                static char frame[1024];
+                if (length < sizeof(frame)) {
+                    memcpy(frame, payload, length);
+                    frame[length] = '\0';
+                    handle_websocket_command(num, frame);
+                }
+            } break;
             default:
                 break;
         }
     }
 
-    // The separator that is passed in to this function is always '\n'
-    // The string that is returned does not contain the separator
-    // The calling code adds back the separator, unless the string is
-    // a one-character realtime command.
-    String Web_Server::get_Splited_Value(String data, char separator, int index) {
-        int found      = 0;
-        int strIndex[] = { 0, -1 };
-        int maxIndex   = data.length() - 1;
-
-        for (int i = 0; i <= maxIndex && found <= index; i++) {
-            if (data.charAt(i) == separator || i == maxIndex) {
-                found++;
-                strIndex[0] = strIndex[1] + 1;
-                strIndex[1] = (i == maxIndex) ? i + 1 : i;
+#    ifdef ENABLE_POSITION_STREAM
+    /*
+     * Position stream. A connection sends POS:<hz> to receive position samples at that rate, up to
+     * POSITION_STREAM_MAX_HZ, and POS:0 to stop. The rate is shared, the last request sets it for
+     * every subscriber, and the reply POS:<hz>:<axes> gives the rate in use. The samples come in
+     * binary frames of several samples each, little endian:
+     *   header  uint8 'P', uint8 axes, uint8 samples, uint8 State of the last sample,
+     *           uint32 number of the first sample since the subscription started
+     *   sample  uint32 ms since boot, float feed rate in mm/min, float machine position in mm per axis
+     * The services task takes the samples with system_snapshot(), so the protocol loop does no work
+     * for them, and the web server sends a frame every POSITION_STREAM_LATENCY_MS.
+     */
+    static const size_t STREAM_HEADER_SIZE = 8;
+    static const size_t STREAM_SAMPLE_MAX  = 8 + MAX_N_AXIS * sizeof(float);
+
+    static uint32_t stream_subscribers = 0;  // Bit per websocket connection
+    static uint32_t stream_period_us   = 0;
+    static int64_t  stream_next        = 0;  // Time the next sample is due
+    static int64_t  stream_first       = 0;  // Time of the first sample in the frame
+    static uint32_t stream_seq         = 0;  // Samples sent
+    static uint8_t  stream_axes        = 0;
+    static uint8_t  stream_count       = 0;  // Samples in the frame
+    static uint8_t  stream_frame[STREAM_HEADER_SIZE + POSITION_STREAM_FRAME_SAMPLES * STREAM_SAMPLE_MAX];
+
+    void Web_Server::subscribe_positions(uint8_t num, int hz) {
+        if (hz <= 0) {
+            stream_subscribers = num < 32 ? stream_subscribers & ~bit(num) : 0;
+            if (!stream_subscribers) {
+                stream_count = 0;
             }
+            return;
         }
+        hz = min(hz, POSITION_STREAM_MAX_HZ);
+        if (!stream_subscribers) {
+            stream_axes  = number_axis->get();
+            stream_seq   = 0;
+            stream_count = 0;
+            stream_next  = 0;
+        }
+        stream_subscribers |= bit(num);
+        stream_period_us   = 1000000 / hz;
+        char reply[24];
+        snprintf(reply, sizeof(reply), "POS:%d:%d", hz, stream_axes);
+        _socket_server->sendTXT(num, reply);
+    }
 
-        return found > index ? data.substring(strIndex[0], strIndex[1]) : "";
+    void Web_Server::sample_positions() {
+        if (!stream_subscribers) {
+            return;
+        }
+        int64_t now = esp_timer_get_time();
+        if (now < stream_next) {
+            return;
+        }
+        // Keep to the period on average, but do not catch up on samples missed while the task was busy
+        stream_next = max(stream_next + stream_period_us, now);
+        if (stream_count == POSITION_STREAM_FRAME_SAMPLES) {
+            return;
+        }
+        sys_snapshot_t snapshot;
+        system_snapshot(&snapshot);
+        float mpos[MAX_N_AXIS];
+        system_convert_array_steps_to_mpos(mpos, snapshot.position);
+
+        uint32_t ms     = now / 1000;
+        uint8_t* sample = stream_frame + STREAM_HEADER_SIZE + stream_count * (8 + stream_axes * sizeof(float));
+        memcpy(sample, &ms, sizeof(ms));
+        memcpy(sample + 4, &snapshot.feed_rate, sizeof(float));
+        memcpy(sample + 8, mpos, stream_axes * sizeof(float));
+        stream_frame[3] = uint8_t(snapshot.state);
+        if (stream_count++ == 0) {
+            stream_first = now;
+        }
     }
 
+    void Web_Server::send_positions() {
+        if (!stream_count || esp_timer_get_time() - stream_first < POSITION_STREAM_LATENCY_MS * 1000) {
+            return;
+        }
+        stream_frame[0] = 'P';
+        stream_frame[1] = stream_axes;
+        stream_frame[2] = stream_count;
+        memcpy(stream_frame + 4, &stream_seq, sizeof(stream_seq));
+        size_t length = STREAM_HEADER_SIZE + stream_count * (8 + stream_axes * sizeof(float));
+        for (uint32_t subscribers = stream_subscribers; subscribers; subscribers &= subscribers - 1) {
+            _socket_server->sendBIN(__builtin_ctz(subscribers), stream_frame, length);
+        }
+        stream_seq += stream_count;
+        stream_count = 0;
+    }
+#    endif
+
+    // The separator that is passed in to this function is always '\n'
+    // The string that is returned does not contain the separator
+    // The calling code adds back the separator, unless the string is
+    // a one-character realtime command.
     //helper to extract content type from file extension
     //Check what is the content tye according extension file
     String Web_Server::getContentType(String filename) {
@@ -1698,15 +2388,30 @@ namespace WebUI {
 
 #    ifdef ENABLE_AUTHENTICATION
 
-    //add the information in the linked list if possible
-    bool Web_Server::AddAuthIP(AuthenticationIP* item) {
-        if (_nb_ip > MAX_AUTH_IP) {
-            return false;
+    static uint32_t session_hash(const char* sessionID) {
+        uint32_t hash = 2166136261u;  // FNV-1a
+        while (*sessionID) {
+            hash = (hash ^ uint8_t(*sessionID++)) * 16777619u;
         }
-        item->_next = _head;
-        _head       = item;
-        _nb_ip++;
-        return true;
+        return hash;
+    }
+
+    //add the information in the session table if possible
+    AuthenticationIP* Web_Server::AddAuthIP(const AuthenticationIP& item) {
+        if (_nb_ip >= MAX_AUTH_IP) {
+            return NULL;
+        }
+        uint32_t slot = session_hash(item.sessionID);
+        for (int probe = 0; probe < AUTH_SESSION_SLOTS; probe++, slot++) {
+            AuthenticationIP* entry = &_sessions[slot & (AUTH_SESSION_SLOTS - 1)];
+            if (entry->state != AuthSlot::USED) {
+                *entry       = item;
+                entry->state = AuthSlot::USED;
+                _nb_ip++;
+                return entry;
+            }
+        }
+        return NULL;
     }
 
     //Session ID based on IP and time using 16 char
@@ -1737,82 +2442,70 @@ namespace WebUI {
     }
 
     bool Web_Server::ClearAuthIP(IPAddress ip, const char* sessionID) {
-        AuthenticationIP* current  = _head;
-        AuthenticationIP* previous = NULL;
-        bool              done     = false;
-        while (current) {
-            if ((ip == current->ip) && (strcmp(sessionID, current->sessionID) == 0)) {
-                //remove
-                done = true;
-                if (current == _head) {
-                    _head = current->_next;
-                    _nb_ip--;
-                    delete current;
-                    current = _head;
-                } else {
-                    previous->_next = current->_next;
-                    _nb_ip--;
-                    delete current;
-                    current = previous->_next;
-                }
-            } else {
-                previous = current;
-                current  = current->_next;
-            }
+        AuthenticationIP* current = GetAuth(ip, sessionID);
+        if (!current) {
+            return false;
         }
-        return done;
+        current->state = AuthSlot::DELETED;
+        _nb_ip--;
+        return true;
     }
 
     //Get info
     AuthenticationIP* Web_Server::GetAuth(IPAddress ip, const char* sessionID) {
-        AuthenticationIP* current = _head;
-        //AuthenticationIP * previous = NULL;
-        //get time
-        //uint32_t now = millis();
-        while (current) {
-            if (ip == current->ip) {
-                if (strcmp(sessionID, current->sessionID) == 0) {
-                    //found
-                    return current;
-                }
+        uint32_t slot = session_hash(sessionID);
+        for (int probe = 0; probe < AUTH_SESSION_SLOTS; probe++, slot++) {
+            AuthenticationIP* entry = &_sessions[slot & (AUTH_SESSION_SLOTS - 1)];
+            if (entry->state == AuthSlot::FREE) {
+                break;
+            }
+            if (entry->state == AuthSlot::USED && ip == entry->ip && strcmp(sessionID, entry->sessionID) == 0) {
+                // Expired sessions are only removed by ExpireAuthIP(), but never valid
+                return (millis() - entry->last_time) > AUTH_SESSION_TIMEOUT_MS ? NULL : entry;
             }
-            //previous = current;
-            current = current->_next;
         }
         return NULL;
     }
 
-    //Review all IP to reset timers
+    //reset the timer of the session
     AuthenticationLevel Web_Server::ResetAuthIP(IPAddress ip, const char* sessionID) {
-        AuthenticationIP* current  = _head;
-        AuthenticationIP* previous = NULL;
-        //get time
-        //uint32_t now = millis();
-        while (current) {
-            if ((millis() - current->last_time) > 360000) {
-                //remove
-                if (current == _head) {
-                    _head = current->_next;
-                    _nb_ip--;
-                    delete current;
-                    current = _head;
-                } else {
-                    previous->_next = current->_next;
-                    _nb_ip--;
-                    delete current;
-                    current = previous->_next;
-                }
-            } else {
-                if (ip == current->ip && strcmp(sessionID, current->sessionID) == 0) {
-                    //reset time
-                    current->last_time = millis();
-                    return (AuthenticationLevel)current->level;
-                }
-                previous = current;
-                current  = current->_next;
+        AuthenticationIP* current = GetAuth(ip, sessionID);
+        if (!current) {
+            return AuthenticationLevel::LEVEL_GUEST;
+        }
+        current->last_time = millis();
+        return current->level;
+    }
+
+    // Removes the expired sessions, then puts the others back in place so deleted slots do not
+    // lengthen the probes. Called from handle(), off the request path.
+    void Web_Server::ExpireAuthIP() {
+        uint32_t         now = millis();
+        AuthenticationIP kept[MAX_AUTH_IP];
+        int              n_kept  = 0;
+        bool             deleted = false;
+        for (int i = 0; i < AUTH_SESSION_SLOTS; i++) {
+            AuthenticationIP* entry = &_sessions[i];
+            if (entry->state == AuthSlot::USED && (now - entry->last_time) > AUTH_SESSION_TIMEOUT_MS) {
+                entry->state = AuthSlot::DELETED;
+                _nb_ip--;
+            }
+            if (entry->state == AuthSlot::DELETED) {
+                deleted = true;
+            } else if (entry->state == AuthSlot::USED && n_kept < MAX_AUTH_IP) {
+                kept[n_kept++] = *entry;
             }
         }
-        return AuthenticationLevel::LEVEL_GUEST;
+        if (!deleted) {
+            return;
+        }
+        for (int i = 0; i < AUTH_SESSION_SLOTS; i++) {
+            _sessions[i].state = AuthSlot::FREE;
+        }
+        _nb_ip = 0;
+        for (int i = 0; i < n_kept; i++) {
+            AddAuthIP(kept[i]);
+        }
     }
 #    endif
 }
@@ -26,15 +26,36 @@
 class WebSocketsServer;
 class WebServer;
 
+#ifdef ENABLE_POSITION_STREAM
+// Highest sample rate a subscriber can ask for
+#    ifndef POSITION_STREAM_MAX_HZ
+#        define POSITION_STREAM_MAX_HZ 100
+#    endif
+// A frame goes out when its first sample is this old
+#    ifndef POSITION_STREAM_LATENCY_MS
+#        define POSITION_STREAM_LATENCY_MS 50
+#    endif
+// Samples a frame can hold. Samples taken while it is full are dropped.
+#    ifndef POSITION_STREAM_FRAME_SAMPLES
+#        define POSITION_STREAM_FRAME_SAMPLES 16
+#    endif
+#endif
+
 namespace WebUI {
 #ifdef ENABLE_AUTHENTICATION
+    // Sessions live in a hash table on the session ID, with linear probing. It has room to spare over
+    // MAX_AUTH_IP so the probes stay short.
+    static const int AUTH_SESSION_SLOTS = 16;  // Power of 2
+
+    enum class AuthSlot : uint8_t { FREE = 0, USED, DELETED };
+
     struct AuthenticationIP {
         IPAddress           ip;
         AuthenticationLevel level;
         char                userID[17];
         char                sessionID[17];
         uint32_t            last_time;
-        AuthenticationIP*   _next;
+        AuthSlot            state;
     };
 #endif
 
@@ -50,7 +71,12 @@ namespace WebUI {
         void handle();
 
         static long     get_client_ID();
+        static bool     has_websocket_clients();
         static uint16_t port() { return _port; }
+#ifdef ENABLE_POSITION_STREAM
+        // Takes a position sample when one is due. Called by the services task on every poll.
+        static void sample_positions();
+#endif
 
         ~Web_Server();
 
@@ -62,16 +88,17 @@ namespace WebUI {
         static uint16_t            _port;
         static UploadStatusType    _upload_status;
         static String              getContentType(String filename);
-        static String              get_Splited_Value(String data, char separator, int index);
         static AuthenticationLevel is_authenticated();
 #ifdef ENABLE_AUTHENTICATION
-        static AuthenticationIP*   _head;
+        static AuthenticationIP    _sessions[AUTH_SESSION_SLOTS];
         static uint8_t             _nb_ip;
-        static bool                AddAuthIP(AuthenticationIP* item);
+        static uint32_t            _last_expiry;
+        static AuthenticationIP*   AddAuthIP(const AuthenticationIP& item);
         static char*               create_session_ID();
         static bool                ClearAuthIP(IPAddress ip, const char* sessionID);
         static AuthenticationIP*   GetAuth(IPAddress ip, const char* sessionID);
         static AuthenticationLevel ResetAuthIP(IPAddress ip, const char* sessionID);
+        static void                ExpireAuthIP();
 #endif
 #ifdef ENABLE_SSDP
         static void handle_SSDP();
@@ -83,6 +110,13 @@ namespace WebUI {
         static void handle_web_command() { _handle_web_command(false); }
         static void handle_web_command_silent() { _handle_web_command(true); }
         static void handle_Websocket_Event(uint8_t num, uint8_t type, uint8_t* payload, size_t length);
+        static void handle_websocket_command(uint8_t num, const char* frame);
+        static void command_answer(Error err, char* answer, size_t size);
+#ifdef ENABLE_POSITION_STREAM
+        static void subscribe_positions(uint8_t num, int hz);
+        static void send_positions();
+#endif
+        static bool push_commands(const char* cmd, bool utf8);
         static void SPIFFSFileupload();
         static void handleFileList();
         static void handleUpdate();
@@ -93,7 +127,19 @@ namespace WebUI {
 #ifdef ENABLE_SD_CARD
         static void handle_direct_SDFileList();
         static void SDFile_direct_upload();
+        static void handle_SD_preview();
         static bool deleteRecursive(String path);
+        static bool sd_lock_for_read();
+        static void sd_unlock_for_read();
+#endif
+#ifdef ENABLE_TASK_STATS
+        static void handle_tasks();
+#endif
+#ifdef ENABLE_TIMELINE
+        static void handle_timeline();
+#endif
+#ifdef ENABLE_METRICS
+        static void handle_metrics();
 #endif
     };
 
@@ -24,7 +24,7 @@
 
 #include <WiFi.h>
 #include <FS.h>
-#include <SPIFFS.h>
+#include "../LocalFS.h"
 #include <esp_wifi.h>
 #include <esp_ota_ops.h>
 
@@ -55,6 +55,7 @@ namespace WebUI {
     IntSetting*    http_port;
     EnumSetting*   telnet_enable;
     IntSetting*    telnet_port;
+    EnumSetting*   wifi_power_save;
 
     typedef std::map<const char*, int8_t, cmp_str> enum_opt_t;
 
@@ -62,6 +63,29 @@ namespace WebUI {
         { "DHCP", DHCP_MODE },
         { "Static", STATIC_MODE },
     };
+    enum_opt_t powerSaveOptions = {
+        { "Off", ESP_POWER_SAVE_OFF },
+        { "Auto", ESP_POWER_SAVE_AUTO },
+        { "On", ESP_POWER_SAVE_ON },
+    };
+#endif
+
+#if defined(ENABLE_WIFI) && defined(ENABLE_UDP_STREAM)
+    EnumSetting* udp_enable;
+    IntSetting*  udp_port;
+#endif
+
+#ifdef ENABLE_ETHERNET
+    EnumSetting*   eth_ip_mode;
+    IPaddrSetting* eth_ip;
+    IPaddrSetting* eth_gateway;
+    IPaddrSetting* eth_netmask;
+
+    enum_opt_t ethModeOptions = {
+        { "Off", ESP_ETH_OFF },
+        { "DHCP", ESP_ETH_DHCP },
+        { "Static", ESP_ETH_STATIC },
+    };
 #endif
 
 #ifdef WIFI_OR_BLUETOOTH
@@ -110,11 +134,16 @@ namespace WebUI {
         char* value;
     } keyval_t;
 
-    static keyval_t params[10];
-    bool            split_params(char* parameter) {
+    // The parameters point into the command line, which split_params cuts up in place.
+    static const int MAX_PARAMS = 10;
+    static keyval_t  params[MAX_PARAMS + 1];  // Ends with a NULL key
+    bool             split_params(char* parameter) {
         int i = 0;
         for (char* s = parameter; *s; s++) {
             if (*s == '=') {
+                if (i == MAX_PARAMS) {
+                    return false;
+                }
                 params[i].value = s + 1;
                 *s              = '\0';
                 // Search backward looking for the start of the key,
@@ -272,8 +301,8 @@ namespace WebUI {
 
     static Error SPIFFSSize(char* parameter, AuthenticationLevel auth_level) {  // ESP720
         webPrint(parameter);
-        webPrint("SPIFFS  Total:", ESPResponseStream::formatBytes(SPIFFS.totalBytes()));
-        webPrintln(" Used:", ESPResponseStream::formatBytes(SPIFFS.usedBytes()));
+        webPrint(LOCALFS_NAME "  Total:", ESPResponseStream::formatBytes(LocalFS.totalBytes()));
+        webPrintln(" Used:", ESPResponseStream::formatBytes(LocalFS.usedBytes()));
         return Error::Ok;
     }
 
@@ -283,7 +312,7 @@ namespace WebUI {
             return Error::InvalidValue;
         }
         webPrint("Formatting");
-        SPIFFS.format();
+        LocalFS.format();
         webPrintln("...Done");
         return Error::Ok;
     }
@@ -293,11 +322,11 @@ namespace WebUI {
         if ((path.length() > 0) && (path[0] != '/')) {
             path = "/" + path;
         }
-        if (!SPIFFS.exists(path)) {
+        if (!LocalFS.exists(path)) {
             webPrintln("Error: No such file!");
             return Error::SdFileNotFound;
         }
-        File currentfile = SPIFFS.open(path, FILE_READ);
+        File currentfile = LocalFS.open(path, FILE_READ);
         if (!currentfile) {  //if file open success
             return Error::SdFailedOpenFile;
         }
@@ -396,7 +425,7 @@ namespace WebUI {
         webPrintln("Flash Size: ", ESPResponseStream::formatBytes(ESP.getFlashChipSize()));
 
         // Round baudRate to nearest 100 because ESP32 can say e.g. 115201
-        webPrintln("Baud rate: ", String((Serial.baudRate() / 100) * 100));
+        webPrintln("Baud rate: ", String((serial_get_baud_rate() / 100) * 100));
         webPrintln("Sleep mode: ", WiFi.getSleep() ? "Modem" : "None");
 
 #ifdef ENABLE_WIFI
@@ -411,7 +440,7 @@ namespace WebUI {
                 }
             }
             webPrintln("Available Size for update: ", ESPResponseStream::formatBytes(flashsize));
-            webPrintln("Available Size for SPIFFS: ", ESPResponseStream::formatBytes(SPIFFS.totalBytes()));
+            webPrintln("Available Size for " LOCALFS_NAME ": ", ESPResponseStream::formatBytes(LocalFS.totalBytes()));
 
 #    if defined(ENABLE_HTTP)
             webPrintln("Web port: ", String(web_server.port()));
@@ -570,39 +599,24 @@ namespace WebUI {
 
 #ifdef ENABLE_WIFI
     static Error listAPs(char* parameter, AuthenticationLevel auth_level) {  // ESP410
-        JSONencoder* j = new JSONencoder(espresponse->client() != CLIENT_WEBUI);
-        j->begin();
-        j->begin_array("AP_LIST");
-        // An initial async scanNetworks was issued at startup, so there
-        // is a good chance that scan information is already available.
-        int n = WiFi.scanComplete();
-        switch (n) {
-            case -2:                      // Scan not triggered
-                WiFi.scanNetworks(true);  // Begin async scan
-                break;
-            case -1:  // Scan in progress
-                break;
-            default:
-                for (int i = 0; i < n; ++i) {
-                    j->begin_object();
-                    j->member("SSID", WiFi.SSID(i));
-                    j->member("SIGNAL", wifi_config.getSignal(WiFi.RSSI(i)));
-                    j->member("IS_PROTECTED", WiFi.encryptionType(i) != WIFI_AUTH_OPEN);
-                    //            j->member("IS_PROTECTED", WiFi.encryptionType(i) == WIFI_AUTH_OPEN ? "0" : "1");
-                    j->end_object();
-                }
-                WiFi.scanDelete();
-                // Restart the scan in async mode so new data will be available
-                // when we ask again.
-                n = WiFi.scanComplete();
-                if (n == -2) {
-                    WiFi.scanNetworks(true);
-                }
-                break;
+        JSONencoder j(espresponse->client() != CLIENT_WEBUI, espresponse);
+        j.begin();
+        j.begin_array("AP_LIST");
+        // The networks found by the last scan. A scan was started when the services came up, and an
+        // old list is refreshed in the background for the next time.
+        wifi_ap_t ap;
+        for (uint8_t i = 0; WiFiConfig::scan_result(i, &ap); i++) {
+            j.begin_object();
+            j.member("SSID", ap.ssid);
+            j.member("SIGNAL", wifi_config.getSignal(ap.rssi));
+            j.member("IS_PROTECTED", ap.is_protected);
+            j.end_object();
         }
-        j->end_array();
-        webPrint(j->end());
-        delete j;
+        if (WiFiConfig::scan_stale()) {
+            WiFiConfig::request_scan();
+        }
+        j.end_array();
+        j.end();
         if (espresponse->client() != CLIENT_WEBUI) {
             espresponse->println("");
         }
@@ -627,21 +641,52 @@ namespace WebUI {
     }
 
     static Error listSettings(char* parameter, AuthenticationLevel auth_level) {  // ESP400
-        JSONencoder* j = new JSONencoder(espresponse->client() != CLIENT_WEBUI);
-        j->begin();
-        j->begin_array("EEPROM");
+        JSONencoder j(espresponse->client() != CLIENT_WEBUI, espresponse);
+        j.begin();
+        j.begin_array("EEPROM");
         for (Setting* js = Setting::List; js; js = js->next()) {
             if (js->getType() == WEBSET) {
-                js->addWebui(j);
+                js->addWebui(&j);
             }
         }
-        j->end_array();
-        webPrint(j->end());
-        delete j;
+        j.end_array();
+        j.end();
         return Error::Ok;
     }
 
+    // The [name Free:... Used:... Total:...] line after a file list
+    static void webPrintUsage(const char* name, uint64_t total, uint64_t used) {
+        char free_size[16], used_size[16], total_size[16], line[80];
+        ESPResponseStream::formatBytes(total - used, free_size, sizeof(free_size));
+        ESPResponseStream::formatBytes(used, used_size, sizeof(used_size));
+        ESPResponseStream::formatBytes(total, total_size, sizeof(total_size));
+        snprintf(line, sizeof(line), "[%s Free:%s Used:%s Total:%s]", name, free_size, used_size, total_size);
+        webPrintln(line);
+    }
+
 #ifdef ENABLE_SD_CARD
+    // Starts a job from fs. The SD job runner reads it, so it streams like an SD job.
+    static Error runJob(fs::FS& fs, char* parameter) {
+        if (!openFile(fs, parameter)) {
+            report_status_message(Error::SdFailedRead, (espresponse) ? espresponse->client() : CLIENT_ALL);
+            webPrintln("");
+            return Error::Ok;
+        }
+        char fileLine[255];
+        if (!readFileLine(fileLine, 255)) {
+            //No need notification here it is just a macro
+            closeFile();
+            webPrintln("");
+            return Error::Ok;
+        }
+        SD_client = (espresponse) ? espresponse->client() : CLIENT_ALL;
+        report_status_message(sd_execute_line(fileLine, (espresponse) ? espresponse->client() : CLIENT_ALL),
+                              (espresponse) ? espresponse->client() : CLIENT_ALL);  // execute the first line
+        report_realtime_status((espresponse) ? espresponse->client() : CLIENT_ALL);
+        webPrintln("");
+        return Error::Ok;
+    }
+
     static Error runSDFile(char* parameter, AuthenticationLevel auth_level) {  // ESP220
         parameter = trim(parameter);
         if (*parameter == '\0') {
@@ -662,26 +707,203 @@ namespace WebUI {
             webPrintln("Busy");
             return Error::IdleError;
         }
-        if (!openFile(SD, parameter)) {
-            report_status_message(Error::SdFailedRead, (espresponse) ? espresponse->client() : CLIENT_ALL);
-            webPrintln("");
-            return Error::Ok;
+        return runJob(SD, parameter);
+    }
+
+    // Unlike $LocalFS/Run, which runs a macro line by line in the command task, this runs the file
+    // as a job. No SD card is needed, but a job may not be running from the card.
+    static Error runLocalJob(char* parameter, AuthenticationLevel auth_level) {  // No ESP command
+        parameter = trim(parameter);
+        if (*parameter == '\0') {
+            webPrintln("Missing file name!");
+            return Error::InvalidValue;
         }
-        char fileLine[255];
-        if (!readFileLine(fileLine, 255)) {
-            //No need notification here it is just a macro
-            closeFile();
-            webPrintln("");
+        int8_t state = get_sd_state(false);
+        if (state != SDCARD_IDLE && state != SDCARD_NOT_PRESENT) {
+            webPrintln("SD Card Busy");
+            return Error::SdFailedBusy;
+        }
+        if (sys.state != State::Idle) {
+            webPrintln("Busy");
+            return Error::IdleError;
+        }
+        if (!LocalFS.exists(parameter)) {
+            webPrintln("Error: No such file!");
+            return Error::SdFileNotFound;
+        }
+        return runJob(LocalFS, parameter);
+    }
+
+    static Error sdIdleCheck() {
+        int8_t state = get_sd_state(true);
+        if (state != SDCARD_IDLE) {
+            if (state == SDCARD_NOT_PRESENT) {
+                webPrintln("No SD Card");
+                return Error::SdFailedMount;
+            } else {
+                webPrintln("SD Card Busy");
+                return Error::SdFailedBusy;
+            }
+        }
+        if (sys.state != State::Idle) {
+            webPrintln("Busy");
+            return Error::IdleError;
+        }
+        return Error::Ok;
+    }
+
+    static Error indexSDFile(char* parameter, AuthenticationLevel auth_level) {  // No ESP command
+        parameter = trim(parameter);
+        if (*parameter == '\0') {
+            webPrintln("Missing file name!");
+            return Error::InvalidValue;
+        }
+        Error err = sdIdleCheck();
+        if (err != Error::Ok) {
+            return err;
+        }
+        return sd_build_index(SD, parameter, (espresponse) ? espresponse->client() : CLIENT_ALL);
+    }
+
+#    ifdef ENABLE_SIMULATOR
+    static Error simulateSDFile(char* parameter, AuthenticationLevel auth_level) {  // No ESP command
+        parameter = trim(parameter);
+        if (*parameter == '\0') {
+            webPrintln("Missing file name!");
+            return Error::InvalidValue;
+        }
+        // A bare file name, or P=<file> D=<expected digest> R=<golden file to record> C=<golden file to compare>
+        uint32_t    digest = 0;
+        SimTrace    trace  = SimTrace::None;
+        const char* golden = NULL;
+        if (!strncasecmp(parameter, "P=", 2)) {
+            if (!split_params(parameter)) {
+                return Error::InvalidValue;
+            }
+            parameter          = trim(get_param("P", true));
+            const char* digits = get_param("D", false);
+            char*       end    = NULL;
+            digest             = strtoul(digits, &end, 16);
+            if (*parameter == '\0' || *end) {
+                webPrintln("Missing file name or bad digest!");
+                return Error::InvalidValue;
+            }
+            const char* record  = get_param("R", true);
+            const char* compare = get_param("C", true);
+            if (*record && *compare) {
+                webPrintln("R and C are exclusive!");
+                return Error::InvalidValue;
+            }
+            if (*record || *compare) {
+                trace  = *record ? SimTrace::Record : SimTrace::Compare;
+                golden = *record ? record : compare;
+            }
+        }
+        Error err = sdIdleCheck();
+        if (err != Error::Ok) {
+            return err;
+        }
+        return sim_request(parameter, (espresponse) ? espresponse->client() : CLIENT_ALL, digest, trace, golden);
+    }
+#    endif
+
+    static Error resumeSDFile(char* parameter, AuthenticationLevel auth_level) {  // No ESP command
+        if (!split_params(parameter)) {
+            return Error::InvalidValue;
+        }
+        char*       path  = get_param("P", true);
+        const char* lines = get_param("L", false);
+        char*       end   = NULL;
+        uint32_t    line  = strtoul(lines, &end, 10);
+        if (*path == '\0' || *lines == '\0' || *end || line == 0) {
+            webPrintln("Missing file name or line!");
+            return Error::InvalidValue;
+        }
+        Error err = sdIdleCheck();
+        if (err != Error::Ok) {
+            return err;
+        }
+        err = sd_resume_job(SD, trim(path), line, (espresponse) ? espresponse->client() : CLIENT_ALL);
+        webPrintln("");
+        return err;
+    }
+
+#    ifdef SD_JOB_QUEUE
+    static Error queueSDFile(char* parameter, AuthenticationLevel auth_level) {  // No ESP command
+        uint8_t client = (espresponse) ? espresponse->client() : CLIENT_ALL;
+        if (*trim(parameter) == '\0') {
+            sd_queue_report(client);
             return Error::Ok;
         }
-        SD_client = (espresponse) ? espresponse->client() : CLIENT_ALL;
-        report_status_message(gc_execute_line(fileLine, (espresponse) ? espresponse->client() : CLIENT_ALL),
-                              (espresponse) ? espresponse->client() : CLIENT_ALL);  // execute the first line
-        report_realtime_status((espresponse) ? espresponse->client() : CLIENT_ALL);
+        if (!split_params(parameter)) {
+            return Error::InvalidValue;
+        }
+        char*       path = trim(get_param("P", true));
+        const char* wait = get_param("W", false);
+        if (*path == '\0') {
+            webPrintln("Missing file name!");
+            return Error::InvalidValue;
+        }
+        Error err = sd_queue_add(path, *wait && strcmp(wait, "0") != 0);
+        if (err != Error::Ok) {
+            webPrintln((err == Error::Overflow) ? "Queue full" : "Path too long");
+            return err;
+        }
+        // Nothing else starts the first job.
+        if (get_sd_state(true) == SDCARD_IDLE && sys.state == State::Idle) {
+            sd_queue_next(client);
+        }
         webPrintln("");
         return Error::Ok;
     }
 
+    static Error clearSDQueue(char* parameter, AuthenticationLevel auth_level) {  // No ESP command
+        sd_queue_clear();
+        return Error::Ok;
+    }
+#    endif
+
+#    ifdef SD_CAPTURE
+    // The lines are written from the protocol loop, so only a streaming client, whose commands run
+    // there too, may start or stop a capture.
+    static Error captureSDFile(char* parameter, AuthenticationLevel auth_level) {  // No ESP command
+        uint8_t client = (espresponse) ? espresponse->client() : CLIENT_ALL;
+        if (client == CLIENT_ALL || client == CLIENT_WEBUI) {
+            webPrintln("Capture from a streaming client!");
+            return Error::InvalidValue;
+        }
+        parameter = trim(parameter);
+        if (*parameter == '\0') {
+            if (sd_capture_client == CLIENT_ALL) {
+                webPrintln("Not capturing");
+            } else if (sd_capture_client != client) {
+                webPrintln("Capturing another client");
+                return Error::SdFailedBusy;
+            } else {
+                sd_capture_end();
+            }
+            return Error::Ok;
+        }
+        Error err = sd_capture_begin(SD, parameter, client);
+        if (err != Error::Ok) {
+            webPrintln((err == Error::SdFailedBusy) ? "SD Card Busy" : "Cannot create file!");
+        }
+        return err;
+    }
+#    endif
+
+#    ifdef SD_CHECKPOINT
+    static Error recoverSDFile(char* parameter, AuthenticationLevel auth_level) {  // No ESP command
+        Error err = sdIdleCheck();
+        if (err != Error::Ok) {
+            return err;
+        }
+        err = sd_recover_job((espresponse) ? espresponse->client() : CLIENT_ALL);
+        webPrintln("");
+        return err;
+    }
+#    endif
+
     static Error deleteSDObject(char* parameter, AuthenticationLevel auth_level) {  // ESP215
         parameter = trim(parameter);
         if (*parameter == '\0') {
@@ -732,23 +954,15 @@ namespace WebUI {
         }
         webPrintln("");
         listDir(SD, "/", 10, espresponse->client());
-        String ssd = "[SD Free:" + ESPResponseStream::formatBytes(SD.totalBytes() - SD.usedBytes());
-        ssd += " Used:" + ESPResponseStream::formatBytes(SD.usedBytes());
-        ssd += " Total:" + ESPResponseStream::formatBytes(SD.totalBytes());
-        ssd += "]";
-        webPrintln(ssd);
+        webPrintUsage("SD", SD.totalBytes(), SD.usedBytes());
         return Error::Ok;
     }
 #endif
 
     static Error listLocalFiles(char* parameter, AuthenticationLevel auth_level) {  // No ESP command
         webPrintln("");
-        listDir(SPIFFS, "/", 10, espresponse->client());
-        String ssd = "[Local FS Free:" + ESPResponseStream::formatBytes(SPIFFS.totalBytes() - SPIFFS.usedBytes());
-        ssd += " Used:" + ESPResponseStream::formatBytes(SPIFFS.usedBytes());
-        ssd += " Total:" + ESPResponseStream::formatBytes(SPIFFS.totalBytes());
-        ssd += "]";
-        webPrintln(ssd);
+        listDir(LocalFS, "/", 10, espresponse->client());
+        webPrintUsage("Local FS", LocalFS.totalBytes(), LocalFS.usedBytes());
         return Error::Ok;
     }
 
@@ -773,15 +987,15 @@ namespace WebUI {
     }
 
     static Error listLocalFilesJSON(char* parameter, AuthenticationLevel auth_level) {  // No ESP command
-        JSONencoder* j = new JSONencoder(espresponse->client() != CLIENT_WEBUI);
-        j->begin();
-        j->begin_array("files");
-        listDirJSON(SPIFFS, "/", 4, j);
-        j->end_array();
-        j->member("total", SPIFFS.totalBytes());
-        j->member("used", SPIFFS.usedBytes());
-        j->member("occupation", String(100 * SPIFFS.usedBytes() / SPIFFS.totalBytes()));
-        webPrint(j->end());
+        JSONencoder j(espresponse->client() != CLIENT_WEBUI, espresponse);
+        j.begin();
+        j.begin_array("files");
+        listDirJSON(LocalFS, "/", 4, &j);
+        j.end_array();
+        j.member("total", LocalFS.totalBytes());
+        j.member("used", LocalFS.usedBytes());
+        j.member("occupation", int(100 * LocalFS.usedBytes() / LocalFS.totalBytes()));
+        j.end();
         if (espresponse->client() != CLIENT_WEBUI) {
             webPrintln("");
         }
@@ -861,7 +1075,7 @@ namespace WebUI {
                 return Error::WifiFailBegin;
 
 #    else
-                wifi_config.begin();
+                wifi_config.request_begin();  // Connecting can take seconds
                 return Error::Ok;
 #    endif
             case ESP_BT:
@@ -986,6 +1200,22 @@ namespace WebUI {
 #endif
 #ifdef ENABLE_SD_CARD
         new WebCommand("path", WEBCMD, WU, "ESP220", "SD/Run", runSDFile);
+        new WebCommand("path", WEBCMD, WU, NULL, "LocalFS/Job", runLocalJob);
+        new WebCommand("path", WEBCMD, WU, NULL, "SD/Index", indexSDFile);
+        new WebCommand("P=path L=line", WEBCMD, WU, NULL, "SD/Resume", resumeSDFile);
+#    ifdef SD_CHECKPOINT
+        new WebCommand(NULL, WEBCMD, WU, NULL, "SD/Recover", recoverSDFile);
+#    endif
+#    ifdef SD_JOB_QUEUE
+        new WebCommand("P=path W=wait", WEBCMD, WU, NULL, "SD/Queue", queueSDFile);
+        new WebCommand(NULL, WEBCMD, WU, NULL, "SD/Queue/Clear", clearSDQueue);
+#    endif
+#    ifdef SD_CAPTURE
+        new WebCommand("path", WEBCMD, WU, NULL, "SD/Capture", captureSDFile);
+#    endif
+#    ifdef ENABLE_SIMULATOR
+        new WebCommand("path", WEBCMD, WU, NULL, "SD/Simulate", simulateSDFile);
+#    endif
         new WebCommand("file_or_directory_path", WEBCMD, WU, "ESP215", "SD/Delete", deleteSDObject);
         new WebCommand(NULL, WEBCMD, WU, "ESP210", "SD/List", listSDFiles);
 #endif
@@ -1068,6 +1298,10 @@ namespace WebUI {
         telnet_port = new IntSetting(
             "Telnet Port", WEBSET, WA, "ESP131", "Telnet/Port", DEFAULT_TELNETSERVER_PORT, MIN_TELNET_PORT, MAX_TELNET_PORT, NULL);
         telnet_enable = new EnumSetting("Telnet Enable", WEBSET, WA, "ESP130", "Telnet/Enable", DEFAULT_TELNET_STATE, &onoffOptions);
+#    ifdef ENABLE_UDP_STREAM
+        udp_port   = new IntSetting("UDP Stream Port", WEBSET, WA, NULL, "UDP/Port", DEFAULT_UDP_PORT, MIN_UDP_PORT, MAX_UDP_PORT, NULL);
+        udp_enable = new EnumSetting("UDP Stream Enable", WEBSET, WA, NULL, "UDP/Enable", DEFAULT_UDP_STATE, &onoffOptions);
+#    endif
         http_port =
             new IntSetting("HTTP Port", WEBSET, WA, "ESP121", "Http/Port", DEFAULT_WEBSERVER_PORT, MIN_HTTP_PORT, MAX_HTTP_PORT, NULL);
         http_enable   = new EnumSetting("HTTP Enable", WEBSET, WA, "ESP120", "Http/Enable", DEFAULT_HTTP_STATE, &onoffOptions);
@@ -1099,6 +1333,7 @@ namespace WebUI {
         wifi_sta_gateway = new IPaddrSetting("Station Static Gateway", WEBSET, WA, NULL, "Sta/Gateway", DEFAULT_STA_GW, NULL);
         wifi_sta_ip      = new IPaddrSetting("Station Static IP", WEBSET, WA, NULL, "Sta/IP", DEFAULT_STA_IP, NULL);
         wifi_sta_mode    = new EnumSetting("Station IP Mode", WEBSET, WA, "ESP102", "Sta/IPMode", DEFAULT_STA_IP_MODE, &staModeOptions);
+        wifi_power_save  = new EnumSetting("Station Power Save", WEBSET, WA, NULL, "WiFi/PowerSave", DEFAULT_POWER_SAVE, &powerSaveOptions);
         // no get, admin to set
         wifi_sta_password = new StringSetting("Station Password",
                                               WEBSET,
@@ -1118,6 +1353,13 @@ namespace WebUI {
                                           MIN_SSID_LENGTH,
                                           MAX_SSID_LENGTH,
                                           (bool (*)(char*))WiFiConfig::isSSIDValid);
+#endif
+#ifdef ENABLE_ETHERNET
+        // Read at startup, see EthConfig::begin()
+        eth_netmask = new IPaddrSetting("Ethernet Static Mask", WEBSET, WA, NULL, "Eth/Netmask", DEFAULT_ETH_MK, NULL);
+        eth_gateway = new IPaddrSetting("Ethernet Static Gateway", WEBSET, WA, NULL, "Eth/Gateway", DEFAULT_ETH_GW, NULL);
+        eth_ip      = new IPaddrSetting("Ethernet Static IP", WEBSET, WA, NULL, "Eth/IP", DEFAULT_ETH_IP, NULL);
+        eth_ip_mode = new EnumSetting("Ethernet IP Mode", WEBSET, WA, NULL, "Eth/IPMode", DEFAULT_ETH_IP_MODE, &ethModeOptions);
 #endif
     }
 }
@@ -42,6 +42,19 @@ namespace WebUI {
     extern IntSetting*    http_port;
     extern EnumSetting*   telnet_enable;
     extern IntSetting*    telnet_port;
+    extern EnumSetting*   wifi_power_save;
+#endif
+
+#if defined(ENABLE_WIFI) && defined(ENABLE_UDP_STREAM)
+    extern EnumSetting* udp_enable;
+    extern IntSetting*  udp_port;
+#endif
+
+#ifdef ENABLE_ETHERNET
+    extern EnumSetting*   eth_ip_mode;
+    extern IPaddrSetting* eth_ip;
+    extern IPaddrSetting* eth_gateway;
+    extern IPaddrSetting* eth_netmask;
 #endif
 
 #ifdef WIFI_OR_BLUETOOTH
@@ -26,9 +26,15 @@
 #    include <esp_wifi.h>
 #    include <ESPmDNS.h>
 #    include <FS.h>
-#    include <SPIFFS.h>
+#    include "../LocalFS.h"
 #    include <cstring>
 #    include "WifiServices.h"
+#    ifdef ENABLE_HTTP
+#        include "WebServer.h"
+#    endif
+#    ifdef ENABLE_TELNET
+#        include "TelnetServer.h"
+#    endif
 
 namespace WebUI {
     WiFiConfig wifi_config;
@@ -36,6 +42,23 @@ namespace WebUI {
     String WiFiConfig::_hostname          = "";
     bool   WiFiConfig::_events_registered = false;
 
+    int8_t       WiFiConfig::_power_save_applied = -1;
+    bool         WiFiConfig::_power_save_on      = true;
+    uint32_t     WiFiConfig::_last_busy_ms       = 0;
+    uint32_t     WiFiConfig::_last_sample_ms     = 0;
+    wifi_stats_t WiFiConfig::_stats              = {};
+
+    TaskHandle_t      WiFiConfig::_manager_task    = NULL;
+    SemaphoreHandle_t WiFiConfig::_scan_mutex      = NULL;
+    volatile bool     WiFiConfig::_begin_requested = false;
+    volatile bool     WiFiConfig::_scan_requested  = false;
+    bool              WiFiConfig::_scanning        = false;
+    bool              WiFiConfig::_scan_from_ap    = false;
+    uint32_t          WiFiConfig::_scan_start_ms   = 0;
+    uint32_t          WiFiConfig::_scan_done_ms    = 0;
+    wifi_ap_t         WiFiConfig::_aps[WIFI_SCAN_MAX_APS];
+    uint8_t           WiFiConfig::_n_aps = 0;
+
     WiFiConfig::WiFiConfig() {}
 
     //just simple helper to convert mac address to string
@@ -202,9 +225,12 @@ namespace WebUI {
         switch (event) {
             case SYSTEM_EVENT_STA_GOT_IP:
                 grbl_sendf(CLIENT_ALL, "[MSG:Connected with %s]\r\n", WiFi.localIP().toString().c_str());
+                _stats.connects++;
+                _power_save_applied = -1;
                 break;
             case SYSTEM_EVENT_STA_DISCONNECTED:
                 grbl_send(CLIENT_ALL, "[MSG:Disconnected]\r\n");
+                _stats.disconnects++;
                 break;
             default:
                 break;
@@ -224,6 +250,57 @@ namespace WebUI {
         return 2 * (RSSI + 100);
     }
 
+    bool WiFiConfig::machine_running() { return sys.state != State::Idle && sys.state != State::Alarm && sys.state != State::Sleep; }
+
+    void WiFiConfig::update_radio() {
+        uint32_t now  = millis();
+        bool     busy = machine_running();
+#    ifdef ENABLE_TELNET
+        busy = busy || telnet_server.has_clients();
+#    endif
+#    ifdef ENABLE_HTTP
+        busy = busy || web_server.has_websocket_clients();
+#    endif
+        if (busy) {
+            _last_busy_ms = now;
+        }
+        int8_t mode = wifi_power_save->get();
+        bool   on   = mode == ESP_POWER_SAVE_ON || (mode == ESP_POWER_SAVE_AUTO && now - _last_busy_ms >= WIFI_POWER_SAVE_IDLE_MS);
+        if (WiFi.getMode() == WIFI_STA && (_power_save_applied < 0 || on != _power_save_on)) {
+            if (esp_wifi_set_ps(on ? WIFI_PS_MIN_MODEM : WIFI_PS_NONE) == ESP_OK) {
+                if (_power_save_applied >= 0) {
+                    _stats.ps_changes++;
+                }
+                _power_save_on      = on;
+                _power_save_applied = on;
+            }
+        }
+
+        if (now - _last_sample_ms < WIFI_RSSI_SAMPLE_MS) {
+            return;
+        }
+        _last_sample_ms = now;
+        if (WiFi.getMode() != WIFI_STA || !WiFi.isConnected()) {
+            _stats.rssi = 0;
+            return;
+        }
+        int32_t rssi = WiFi.RSSI();
+        if (_stats.samples == 0 || rssi < _stats.rssi_min) {
+            _stats.rssi_min = rssi;
+        }
+        if (_stats.samples == 0 || rssi > _stats.rssi_max) {
+            _stats.rssi_max = rssi;
+        }
+        _stats.rssi = rssi;
+        _stats.rssi_sum += rssi;
+        _stats.samples++;
+    }
+
+    void WiFiConfig::reset_stats() {
+        _stats          = {};
+        _stats.since_ms = millis();
+    }
+
     /*
      * Connect client to AP
      */
@@ -254,7 +331,7 @@ namespace WebUI {
                     break;
             }
             grbl_sendf(CLIENT_ALL, "[MSG:%s]\r\n", msg.c_str());
-            COMMANDS::wait(500);
+            vTaskDelay(500 / portTICK_PERIOD_MS);  // Only called from the boot and manager tasks
             count++;
             status = WiFi.status();
         }
@@ -277,6 +354,7 @@ namespace WebUI {
         }
         WiFi.enableAP(false);
         WiFi.mode(WIFI_STA);
+        _power_save_applied = -1;
         //Get parameters for STA
         String h = wifi_hostname->get();
         WiFi.setHostname(h.c_str());
@@ -369,6 +447,8 @@ namespace WebUI {
         WiFi.enableAP(false);
         WiFi.mode(WIFI_OFF);
         grbl_send(CLIENT_ALL, "\n[MSG:WiFi Off]\r\n");
+        //the services go on for Ethernet, if it is up
+        wifi_services.begin();
     }
 
     /**
@@ -399,6 +479,8 @@ namespace WebUI {
             wifi_services.begin();
         } else {
             WiFi.mode(WIFI_OFF);
+            //start services for Ethernet, if it is up
+            wifi_services.begin();
         }
     }
 
@@ -411,27 +493,122 @@ namespace WebUI {
      * Reset ESP
      */
     void WiFiConfig::reset_settings() {
-        bool error = false;
+        Setting::begin();
         for (Setting* s = Setting::List; s; s = s->next()) {
             if (s->getDescription()) {
                 s->setDefault();
             }
         }
-        // TODO commit the changes and check that for errors
-        if (error) {
+        if (Setting::commit() != Error::Ok) {
             grbl_send(CLIENT_ALL, "[MSG:WiFi reset error]\r\n");
         }
         grbl_send(CLIENT_ALL, "[MSG:WiFi reset done]\r\n");
     }
     bool WiFiConfig::Is_WiFi_on() { return !(WiFi.getMode() == WIFI_MODE_NULL); }
 
+    void WiFiConfig::start_manager() {
+        if (_manager_task) {
+            return;
+        }
+        _scan_mutex = xSemaphoreCreateMutex();
+        xTaskCreatePinnedToCore(managerTask,        // task
+                                "wifiManagerTask",  // name for task
+                                WIFI_MANAGER_TASK_STACK,
+                                NULL,  // parameters
+                                WIFI_MANAGER_TASK_PRIORITY,
+                                &_manager_task,
+                                WIFI_MANAGER_TASK_CORE  // core
+        );
+    }
+
+    void WiFiConfig::request_begin() {
+        start_manager();
+        _begin_requested = true;
+        xTaskNotifyGive(_manager_task);
+    }
+
+    void WiFiConfig::request_scan() {
+        start_manager();
+        _scan_requested = true;
+        xTaskNotifyGive(_manager_task);
+    }
+
+    // True when the results are old and no scan is under way
+    bool WiFiConfig::scan_stale() { return !_scanning && (_scan_done_ms == 0 || millis() - _scan_done_ms >= WIFI_SCAN_CACHE_MS); }
+
+    bool WiFiConfig::scan_result(uint8_t index, wifi_ap_t* ap) {
+        if (!_scan_mutex) {
+            return false;
+        }
+        xSemaphoreTake(_scan_mutex, portMAX_DELAY);
+        bool found = index < _n_aps;
+        if (found) {
+            *ap = _aps[index];
+        }
+        xSemaphoreGive(_scan_mutex);
+        return found;
+    }
+
+    // Starts a requested scan when the machine is not running, and keeps the results when it ends.
+    void WiFiConfig::scan_step() {
+        if (!_scanning) {
+            if (!_scan_requested || machine_running() || WiFi.getMode() == WIFI_OFF) {
+                return;
+            }
+            _scan_requested = false;
+            _scan_from_ap   = WiFi.getMode() == WIFI_AP;
+            if (WiFi.scanNetworks(true) == WIFI_SCAN_FAILED) {
+                return;
+            }
+            _scanning      = true;
+            _scan_start_ms = millis();
+            return;
+        }
+        int16_t n = WiFi.scanComplete();
+        if (n == WIFI_SCAN_RUNNING && millis() - _scan_start_ms < WIFI_SCAN_TIMEOUT_MS) {
+            return;
+        }
+        _scanning = false;
+        if (n >= 0) {
+            xSemaphoreTake(_scan_mutex, portMAX_DELAY);
+            _n_aps = n < WIFI_SCAN_MAX_APS ? n : WIFI_SCAN_MAX_APS;
+            for (uint8_t i = 0; i < _n_aps; i++) {
+                strlcpy(_aps[i].ssid, WiFi.SSID(i).c_str(), sizeof(_aps[i].ssid));
+                _aps[i].rssi         = WiFi.RSSI(i);
+                _aps[i].is_protected = WiFi.encryptionType(i) != WIFI_AUTH_OPEN;
+            }
+            xSemaphoreGive(_scan_mutex);
+            _scan_done_ms = millis();
+        }
+        WiFi.scanDelete();
+        // The scan turned the station on beside the access point
+        if (_scan_from_ap && WiFi.getMode() == WIFI_AP_STA) {
+            WiFi.enableSTA(false);
+        }
+    }
+
+    // Starts and reconfigures the radio and runs the scans, which take seconds, away from the
+    // protocol loop, serialCheckTask and the web server.
+    void WiFiConfig::managerTask(void* pvParameters) {
+        while (true) {
+            if (_begin_requested) {
+                _begin_requested = false;
+                _scanning        = false;  // A restart of the radio drops the scan
+                begin();
+            }
+            scan_step();
+            task_stats_block();
+            ulTaskNotifyTake(pdTRUE, WIFI_MANAGER_POLL_MS / portTICK_PERIOD_MS);
+            task_stats_unblock();
+        }
+    }
+
     /**
      * Handle not critical actions that must be done in sync environement
      */
     void WiFiConfig::handle() {
-        //Services
+        //Services run in their own task, see WiFiServices::begin()
         COMMANDS::wait(0);
-        wifi_services.handle();
     }
 
     WiFiConfig::~WiFiConfig() { end(); }
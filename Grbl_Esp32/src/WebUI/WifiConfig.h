@@ -24,6 +24,32 @@
 
 #include <WiFi.h>
 
+// With $WiFi/PowerSave=Auto the modem sleep of the station is off while the machine is busy or a
+// sender is connected, since each sleep holds traffic for up to a beacon interval. It comes back after
+// WIFI_POWER_SAVE_IDLE_MS without either.
+#ifndef WIFI_POWER_SAVE_IDLE_MS
+#    define WIFI_POWER_SAVE_IDLE_MS 10000
+#endif
+// Period of the signal strength sample reported by $WiFi/Stats.
+#ifndef WIFI_RSSI_SAMPLE_MS
+#    define WIFI_RSSI_SAMPLE_MS 1000
+#endif
+// Networks found by the last scan are kept for ESP410, which starts a new scan in the background
+// when they are older than WIFI_SCAN_CACHE_MS. Scans wait while the machine runs, since they take
+// the station off its channel.
+#ifndef WIFI_SCAN_CACHE_MS
+#    define WIFI_SCAN_CACHE_MS 30000
+#endif
+#ifndef WIFI_SCAN_TIMEOUT_MS
+#    define WIFI_SCAN_TIMEOUT_MS 15000
+#endif
+#ifndef WIFI_SCAN_MAX_APS
+#    define WIFI_SCAN_MAX_APS 20
+#endif
+#ifndef WIFI_MANAGER_POLL_MS
+#    define WIFI_MANAGER_POLL_MS 100
+#endif
+
 namespace WebUI {
     // TODO: Clean these constants up. Some of them don't belong here.
 
@@ -35,6 +61,11 @@ namespace WebUI {
     static const int DHCP_MODE   = 0;
     static const int STATIC_MODE = 1;
 
+    //Power save
+    static const int ESP_POWER_SAVE_OFF  = 0;
+    static const int ESP_POWER_SAVE_AUTO = 1;
+    static const int ESP_POWER_SAVE_ON   = 2;
+
     //Switch
     static const int ESP_SAVE_ONLY = 0;
     static const int ESP_APPLY_NOW = 1;
@@ -64,6 +95,7 @@ namespace WebUI {
     static const char* HIDDEN_PASSWORD           = "********";
     static const char* DEFAULT_TOKEN             = "";
     static const int   DEFAULT_NOTIFICATION_TYPE = 0;
+    static const int   DEFAULT_POWER_SAVE        = ESP_POWER_SAVE_AUTO;
 
     //boundaries
     static const int MAX_SSID_LENGTH     = 32;
@@ -84,6 +116,24 @@ namespace WebUI {
     static const int MAX_NOTIFICATION_TOKEN_LENGTH   = 63;
     static const int MAX_NOTIFICATION_SETTING_LENGTH = 127;
 
+    typedef struct {
+        int32_t  rssi;  // Last sample, 0 when not connected
+        int32_t  rssi_min;
+        int32_t  rssi_max;
+        int32_t  rssi_sum;
+        uint32_t samples;
+        uint32_t disconnects;  // Station disconnects, each followed by a reconnect attempt
+        uint32_t connects;
+        uint32_t ps_changes;  // Power save switched on or off
+        uint32_t since_ms;
+    } wifi_stats_t;
+
+    typedef struct {
+        char    ssid[MAX_SSID_LENGTH + 1];
+        int32_t rssi;
+        bool    is_protected;
+    } wifi_ap_t;
+
     class WiFiConfig {
     public:
         WiFiConfig();
@@ -107,13 +157,47 @@ namespace WebUI {
         static void        reset_settings();
         static bool        Is_WiFi_on();
 
+        // Sets the power save for the machine state and samples the signal. Called by the services task.
+        static void                update_radio();
+        static bool                power_save_on() { return _power_save_on; }
+        static const wifi_stats_t* stats() { return &_stats; }
+        static void                reset_stats();
+
+        // The radio is started and networks are scanned by wifiManagerTask, so the callers, such as
+        // a command from the protocol loop, return right away.
+        static void request_begin();
+        static void request_scan();
+        static bool scan_result(uint8_t index, wifi_ap_t* ap);  // False past the last network found
+        static bool scan_stale();
+
         ~WiFiConfig();
 
     private:
+        static bool   machine_running();
+        static void   start_manager();
+        static void   managerTask(void* pvParameters);
+        static void   scan_step();
         static bool   ConnectSTA2AP();
         static void   WiFiEvent(WiFiEvent_t event);
         static String _hostname;
         static bool   _events_registered;
+
+        static int8_t       _power_save_applied;  // -1 after a mode change, so the next update sets it
+        static bool         _power_save_on;
+        static uint32_t     _last_busy_ms;
+        static uint32_t     _last_sample_ms;
+        static wifi_stats_t _stats;
+
+        static TaskHandle_t      _manager_task;
+        static SemaphoreHandle_t _scan_mutex;  // Guards the results
+        static volatile bool     _begin_requested;
+        static volatile bool     _scan_requested;
+        static bool              _scanning;
+        static bool              _scan_from_ap;  // The station was off before the scan
+        static uint32_t          _scan_start_ms;
+        static uint32_t          _scan_done_ms;  // 0 until the first scan ends
+        static wifi_ap_t         _aps[WIFI_SCAN_MAX_APS];
+        static uint8_t           _n_aps;
     };
 
     extern WiFiConfig wifi_config;
@@ -24,7 +24,7 @@
 
 #    include <WiFi.h>
 #    include <FS.h>
-#    include <SPIFFS.h>
+#    include "../LocalFS.h"
 #    include "WifiServices.h"
 #    ifdef ENABLE_MDNS
 #        include <ESPmDNS.h>
@@ -46,19 +46,45 @@
 namespace WebUI {
     WiFiServices wifi_services;
 
+    TaskHandle_t      WiFiServices::_task    = NULL;
+    SemaphoreHandle_t WiFiServices::_mutex   = NULL;
+    bool              WiFiServices::_running = false;
+
+    // The services also listen on the wired interface, with or without the radio
+    static bool ethernet_on() {
+#    ifdef ENABLE_ETHERNET
+        return EthConfig::started();
+#    else
+        return false;
+#    endif
+    }
+
     WiFiServices::WiFiServices() {}
     WiFiServices::~WiFiServices() { end(); }
 
     bool WiFiServices::begin() {
         bool no_error = true;
         //Sanity check
-        if (WiFi.getMode() == WIFI_OFF) {
+        if (WiFi.getMode() == WIFI_OFF && !ethernet_on()) {
             return false;
         }
         String h = wifi_hostname->get();
 
+        if (!_task) {
+            _mutex = xSemaphoreCreateRecursiveMutex();
+            xTaskCreatePinnedToCore(servicesTask,    // task
+                                    "wifiServices",  // name for task
+                                    WIFI_SERVICES_TASK_STACK,
+                                    NULL,  // parameters
+                                    WIFI_SERVICES_TASK_PRIORITY,
+                                    &_task,
+                                    WIFI_SERVICES_TASK_CORE  // core
+            );
+        }
+        xSemaphoreTakeRecursive(_mutex, portMAX_DELAY);
+
         //Start SPIFFS
-        SPIFFS.begin(true);
+        LocalFS.begin(true);
 #    ifdef ENABLE_OTA
         ArduinoOTA
             .onStart([]() {
@@ -66,9 +92,9 @@ namespace WebUI {
                 if (ArduinoOTA.getCommand() == U_FLASH) {
                     type = "sketch";
                 } else {  // U_SPIFFS
-                    // NOTE: if updating SPIFFS this would be the place to unmount SPIFFS using SPIFFS.end()
+                    // NOTE: if updating SPIFFS this would be the place to unmount SPIFFS using LocalFS.end()
                     type = "filesystem";
-                    SPIFFS.end();
+                    LocalFS.end();
                 }
                 grbl_sendf(CLIENT_ALL, "[MSG:Start OTA updating %s]\r\n", type.c_str());
             })
@@ -100,7 +126,7 @@ namespace WebUI {
 #    endif
 #    ifdef ENABLE_MDNS
         //no need in AP mode
-        if (WiFi.getMode() == WIFI_STA) {
+        if (WiFi.getMode() == WIFI_STA || ethernet_on()) {
             //start mDns
             if (!MDNS.begin(h.c_str())) {
                 grbl_send(CLIENT_ALL, "[MSG:Cannot start mDNS]\r\n");
@@ -116,17 +142,38 @@ namespace WebUI {
 #    ifdef ENABLE_TELNET
         telnet_server.begin();
 #    endif
+#    ifdef ENABLE_UDP_STREAM
+        udp_stream.begin();
+#    endif
+#    ifdef ENABLE_NETWORK_SYNC
+        network_sync.begin();
+#    endif
 #    ifdef ENABLE_NOTIFICATIONS
         notificationsservice.begin();
 #    endif
-        //be sure we are not is mixed mode in setup
-        WiFi.scanNetworks(true);
+        // So ESP410 has networks to list
+        if (WiFi.getMode() != WIFI_OFF) {
+            WiFiConfig::request_scan();
+        }
+        _running = true;
+        xSemaphoreGiveRecursive(_mutex);
         return no_error;
     }
     void WiFiServices::end() {
+        if (!_mutex) {
+            return;
+        }
+        xSemaphoreTakeRecursive(_mutex, portMAX_DELAY);
+        _running = false;
 #    ifdef ENABLE_NOTIFICATIONS
         notificationsservice.end();
 #    endif
+#    ifdef ENABLE_NETWORK_SYNC
+        network_sync.end();
+#    endif
+#    ifdef ENABLE_UDP_STREAM
+        udp_stream.end();
+#    endif
 #    ifdef ENABLE_TELNET
         telnet_server.end();
 #    endif
@@ -138,24 +185,44 @@ namespace WebUI {
         ArduinoOTA.end();
 #    endif
         //Stop SPIFFS
-        SPIFFS.end();
+        LocalFS.end();
 #    ifdef ENABLE_MDNS
         //Stop mDNS
         MDNS.end();
 #    endif
+        xSemaphoreGiveRecursive(_mutex);
     }
 
-    void WiFiServices::handle() {
-        COMMANDS::wait(0);
-        //to avoid mixed mode due to scan network
-        if (WiFi.getMode() == WIFI_AP_STA) {
-            // In principle it should be sufficient to check for != WIFI_SCAN_RUNNING,
-            // but that does not work well.  Doing so makes scans in AP mode unreliable.
-            // Sometimes the first try works, but subsequent scans fail.
-            if (WiFi.scanComplete() >= 0) {
-                WiFi.enableSTA(false);
+    void WiFiServices::servicesTask(void* pvParameters) {
+        int64_t next_web = 0;
+        while (true) {
+            task_stats_block();
+            xSemaphoreTakeRecursive(_mutex, portMAX_DELAY);
+            task_stats_unblock();
+            if (_running) {
+                WiFiConfig::update_radio();
+                int64_t now = esp_timer_get_time();
+                if (sys.state != State::Cycle || now >= next_web) {
+                    handle();
+                    next_web = now + WIFI_SERVICES_CYCLE_MS * 1000;
+                } else {
+#    ifdef ENABLE_TELNET
+                    telnet_server.handle();
+#    endif
+                }
+#    if defined(ENABLE_HTTP) && defined(ENABLE_POSITION_STREAM)
+                web_server.sample_positions();  // At the poll rate, even while handle() is throttled
+#    endif
             }
+            xSemaphoreGiveRecursive(_mutex);
+            task_stats_block();
+            vTaskDelay(WIFI_SERVICES_POLL_MS / portTICK_RATE_MS);
+            task_stats_unblock();
         }
+    }
+
+    void WiFiServices::handle() {
+        COMMANDS::wait(0);
 #    ifdef ENABLE_OTA
         ArduinoOTA.handle();
 #    endif
@@ -20,6 +20,17 @@
   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
+// The web server, the websocket and telnet run in their own task, away from the core of the protocol
+// loop. While a cycle runs the web server is only serviced every WIFI_SERVICES_CYCLE_MS, so large
+// requests like file lists or the embedded page cannot hold the task for long. Telnet is serviced
+// every WIFI_SERVICES_POLL_MS at all times, since it may be streaming the job.
+#ifndef WIFI_SERVICES_POLL_MS
+#    define WIFI_SERVICES_POLL_MS 2
+#endif
+#ifndef WIFI_SERVICES_CYCLE_MS
+#    define WIFI_SERVICES_CYCLE_MS 50
+#endif
+
 namespace WebUI {
     class WiFiServices {
     public:
@@ -30,6 +41,13 @@ namespace WebUI {
         static void handle();
 
         ~WiFiServices();
+
+    private:
+        static void servicesTask(void* pvParameters);
+
+        static TaskHandle_t      _task;
+        static SemaphoreHandle_t _mutex;  // Recursive, web commands may restart the services from the task
+        static bool              _running;
     };
 
     extern WiFiServices wifi_services;
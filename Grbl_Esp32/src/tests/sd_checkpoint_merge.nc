@@ -0,0 +1,19 @@
+(MSG, SD checkpoint across a merged block. Needs SD_CHECKPOINT and PLANNER_MERGE_LINES)
+(MSG, Run it with $SD/Run, reset after about 20 s, then run $SD/Recover)
+(The eight X moves below merge into one block that takes 40 s)
+(Recovery must restart at line N10, the first one merged, and end at X40 Y0)
+G21
+G90
+G0X0Y0
+G4P0.1
+N10G1X5F60
+N11G1X10
+N12G1X15
+N13G1X20
+N14G1X25
+N15G1X30
+N16G1X35
+N17G1X40
+(MSG, Merged block done)
+G0Y10
+G0X0Y0
@@ -0,0 +1,21 @@
+(MSG, Laser zero power test. Needs $32=1 and a scope on the PWM pin)
+(Each S0 move must hold the pin low for its whole length, with no pulses)
+G21
+G90
+G0X0Y0
+M4 S1000
+G1X10F600
+S0
+G1X20
+S500
+G1X30
+S0
+G1X40
+S1000
+G1X50
+G1X60S0
+G1X70S250
+G1X80S0
+(MSG, S0 inside a move must switch the output fully off)
+M5
+G0X0Y0